@@ -43,7 +43,20 @@ parameter string MCFILENAME = "",
 parameter string VRFILENAME = "",
 parameter string TIFILENAME = "",
 parameter string SWFILENAME = "",
-parameter STANDALONE = 0 
+parameter STANDALONE = 0,
+parameter VARDATA_WORD_BITS = 1,
+// Synthesis style of each memory: "auto" leaves it to the tool, otherwise
+// "distributed" (LUT RAM), "block" (block RAM) or "registers" (flip-flops)
+parameter string MC_MEM_STYLE = "auto",
+parameter string VR_MEM_STYLE = "auto",
+parameter string SW_MEM_STYLE = "auto",
+// Register the microcode read, taking the ROM out of the next-address path;
+// the program needs the delay slots of c_parser --pipeline (PIPELINED in its .vh)
+parameter PIPELINED = 0,
+// Take the conditions of varSel NUM_VARSEL and up from logic_lhs instead of
+// the vardata ROM: the <base>_varsel_logic module of c_parser --varsel-logic,
+// with NUM_VARSEL set to VARSEL_ROM_BLOCKS from its .vh
+parameter VARSEL_LOGIC = 0
 )(
     input [NUM_VARS-1:0] variables,
     output [NUM_STATES-1:0] states,
@@ -63,7 +76,9 @@ parameter STANDALONE = 0
     output [NUM_SWITCH_BITS-1:0] switch_sel,
     output [NUM_ADR_BITS-1:0] debug_adr,
     input interrupt,
-    input [NUM_ADR_BITS-1:0] interrupt_address
+    input [NUM_ADR_BITS-1:0] interrupt_address,
+    output [NUM_VARSEL_BITS-1:0] logic_var_sel,
+    input logic_lhs
     );
 
 wire  [(2*NUM_STATES)-1:0] statedata;
@@ -71,6 +86,7 @@ wire  [NUM_CTL_BITS-1:0] ctldata;
 wire  lhs;
 wire forced_jmp;
 wire [NUM_ADR_BITS-1:0] address;
+wire [NUM_ADR_BITS-1:0] fetch_address;
 assign debug_adr = address;
 wire [NUM_ADR_BITS-1:0] returnadr;
 wire [NUM_ADR_BITS-1:0] jadr;
@@ -78,6 +94,8 @@ wire [NUM_ADR_BITS -1:0] switch_adr;
 wire sub_push;
 wire sub_pop;
 wire [NUM_VARSEL_BITS-1:0] varSel;
+wire rom_lhs;
+assign logic_var_sel = varSel;
 //generate
 //if (NUM_TIMERS != 0) begin
 wire [NUM_TIMERS-1:0] timer_done;
@@ -111,7 +129,9 @@ variable #(.NUM_VARS(NUM_VARS),
            .NUM_VARSEL(NUM_VARSEL),
            .NUM_VARSEL_BITS(NUM_VARSEL_BITS),
            .FILENAME(VRFILENAME),
-           .STANDALONE (STANDALONE)
+           .STANDALONE (STANDALONE),
+           .VARDATA_WORD_BITS (VARDATA_WORD_BITS),
+           .MEM_STYLE (VR_MEM_STYLE)
       ) Variable (
      .variable(variables),
      .uberLUT_data(uberLUT_tdata),
@@ -120,15 +140,16 @@ variable #(.NUM_VARS(NUM_VARS),
      .clk(clk),
      .ready(uberLUT_ready),
      .rst(rst),
-     .lhs(lhs)
+     .lhs(rom_lhs)
      ); 
+assign lhs = (VARSEL_LOGIC != 0 && varSel >= NUM_VARSEL) ? logic_lhs : rom_lhs;
 end
 else begin : gen_lhs_assign
 assign lhs = 1;
 end
 endgenerate
 
-next_address #(.BUS_WIDTH(NUM_ADR_BITS)) Next_addr (
+next_address #(.BUS_WIDTH(NUM_ADR_BITS), .PIPELINED(PIPELINED)) Next_addr (
      .address(address),
      .jmpadr(jadr),
      .jadr(jmpadr),
@@ -143,7 +164,8 @@ next_address #(.BUS_WIDTH(NUM_ADR_BITS)) Next_addr (
      .clk(clk),
      .interrupt_address(interrupt_address),
      .interrupt(interrupt),
-     .nextadr(address) 
+     .nextadr(address),
+     .fetchadr(fetch_address)
      );
       
 
@@ -156,10 +178,15 @@ microcode #(
       .NUM_SWITCH_BITS(NUM_SWITCH_BITS),
       .NUM_WORDS(NUM_WORDS),
       .FILENAME(MCFILENAME),
-      .STANDALONE (STANDALONE)
+      .STANDALONE (STANDALONE),
+      .MEM_STYLE (MC_MEM_STYLE),
+      .PIPELINED (PIPELINED)
       ) Microcode (
       .smdata_word(sm_tdata),
      .address(address),
+     .fetch_address(fetch_address),
+     .flush(rst || !ready),
+     .hlt(hlt),
      .varSel(varSel),
      .timerLd(timerLd),
      .var_or_timer(var_or_timer),
@@ -237,7 +264,8 @@ switch #(.ADR_BUS_WIDTH(NUM_ADR_BITS),
          .SWITCH_MEM_BITS(SWITCH_OFFSET_BITS),
          .SWITCH_MEM_WORDS(SWITCH_MEM_WORDS),
          .FILENAME(SWFILENAME),
-         .STANDALONE (STANDALONE)
+         .STANDALONE (STANDALONE),
+         .MEM_STYLE (SW_MEM_STYLE)
          ) Switch (
 .switch_tvalid (switch_tvalid),
 .switch_tdata(switch_tdata),
@@ -31,10 +31,15 @@
                parameter NUM_SWITCH_BITS = 1,  
                parameter NUM_CONTROL_BITS = 32,
                parameter string FILENAME = "",
-               parameter STANDALONE = 0
+               parameter STANDALONE = 0,
+               parameter string MEM_STYLE = "auto",  // Synthesis style of code (c_parser --mem-style)
+               parameter PIPELINED = 0  // Registered read of fetch_address; needs c_parser --pipeline
                )(
                input [NUM_CONTROL_BITS+(2*NUM_STATE_BITS)-1:0] smdata_word,
                input [NUM_ADDRESS_LINES-1:0] address,
+               input [NUM_ADDRESS_LINES-1:0] fetch_address,
+               input flush,
+               input hlt,
                input smload,
                input rst,
                input clk,
@@ -53,6 +58,7 @@
                output ready
     );
 
+(* rom_style = MEM_STYLE, ram_style = MEM_STYLE *)
 reg [NUM_CONTROL_BITS+(2*NUM_STATE_BITS)-1:0] code [NUM_WORDS-1:0] ;
 if (STANDALONE == 1) begin : gen_standalone
 initial $readmemh(FILENAME,code,0,NUM_WORDS-1);
@@ -77,7 +83,21 @@ generate
       assign ready = rst?0:address_1 >= NUM_WORDS;
    end
 endgenerate
-assign microcode_bits = code[address];
+generate
+   if (PIPELINED == 0) begin : gen_async_read
+      assign microcode_bits = code[address];
+   end
+   else begin : gen_registered_read
+      // The word at address, read a clock ahead from fetch_address. It
+      // starts empty, so the first edge out of reset only fetches word 0.
+      reg [NUM_CONTROL_BITS+(2*NUM_STATE_BITS)-1:0] word_r;
+      always @ (posedge clk) begin
+         if (flush == 1) word_r <= 0;
+         else if (hlt == 0) word_r <= code[fetch_address];
+      end
+      assign microcode_bits = word_r;
+   end
+endgenerate
 assign state_value = microcode_bits[NUM_STATE_BITS-1:0];
 assign transition_value = microcode_bits[(2*NUM_STATE_BITS)-1:NUM_STATE_BITS];
 assign ctl_out = microcode_bits[(NUM_CONTROL_BITS+(2*NUM_STATE_BITS))-1:2*NUM_STATE_BITS];
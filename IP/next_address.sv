@@ -14,7 +14,7 @@
 //////////////////////////////////////////////////////////////////////////////////
 `timescale 10ns / 1ns
 
-module next_address#(BUS_WIDTH = 8)(
+module next_address#(BUS_WIDTH = 8, PIPELINED = 0)(
     input [BUS_WIDTH-1:0] address,
     input [BUS_WIDTH-1:0] jmpadr,
     input [BUS_WIDTH-1:0] returnadr,
@@ -29,16 +29,28 @@ module next_address#(BUS_WIDTH = 8)(
     input sub_pop,
     input interrupt,
     input clk,
-    output reg [BUS_WIDTH-1:0] nextadr
+    output reg [BUS_WIDTH-1:0] nextadr,
+    output [BUS_WIDTH-1:0] fetchadr
     );
     
+    wire [BUS_WIDTH-1:0] target = switch_active?switch_adr:(fired?interrupt_address:(jadr ? jmpadr: (sub_pop ? returnadr : address + 1)));
   
+    // PIPELINED: address is the word in microcode's output register and
+    // fetchadr the word being read into it. A jump's target is fetched
+    // while the word after the jump (its delay slot) runs.
+    reg [BUS_WIDTH-1:0] fetch_r;
     always @(posedge clk) begin
         if (rst == 1||ready == 0) begin 
         nextadr <= 0;
+        fetch_r <= 0;
         end
         else if (hlt == 1) nextadr <= address;
-        else
-          nextadr <=  switch_active?switch_adr:(fired?interrupt_address:(jadr ? jmpadr: (sub_pop ? returnadr : address + 1)));
+        else if (PIPELINED == 0)
+          nextadr <=  target;
+        else begin
+          nextadr <= fetch_r;
+          fetch_r <= (target == address + 1) ? fetch_r + 1 : target;
+        end
     end
+    assign fetchadr = (PIPELINED == 0) ? nextadr : fetch_r;
 endmodule
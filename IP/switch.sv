@@ -26,7 +26,8 @@ module switch #(parameter ADR_BUS_WIDTH = 8,
                 parameter SWITCH_MEM_BITS = 8, 
                 parameter SWITCH_MEM_WORDS = 256,
                 parameter string FILENAME = "",
-                parameter STANDALONE = 0
+                parameter STANDALONE = 0,
+                parameter string MEM_STYLE = "auto"  // Synthesis style of switch_mem (c_parser --mem-style)
                 )(
     input [ADR_BUS_WIDTH - 1:0] switch_tdata,
     input switch_tvalid,
@@ -40,6 +41,7 @@ module switch #(parameter ADR_BUS_WIDTH = 8,
     );
     
      
+    (* rom_style = MEM_STYLE, ram_style = MEM_STYLE *)
     reg [ADR_BUS_WIDTH-1:0] switch_mem [SWITCH_MEM_WORDS - 1:0];
     if (STANDALONE == 1) begin : gen_standalone
     initial $readmemh(FILENAME,switch_mem, 0,SWITCH_MEM_WORDS -1); 
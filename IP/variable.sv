@@ -26,7 +26,9 @@ module variable #(
                parameter NUM_VARSEL = 2,
                parameter NUM_VARSEL_BITS = 3,
                parameter string FILENAME = "",
-               parameter STANDALONE = 0
+               parameter STANDALONE = 0,
+               parameter VARDATA_WORD_BITS = 1,  // LUT bits per FILENAME word (c_parser --vardata-bits)
+               parameter string MEM_STYLE = "auto"  // Synthesis style of code (c_parser --mem-style)
                )(
                input clk,
                input rst,
@@ -39,9 +41,20 @@ module variable #(
                );
 
 
-reg [0:0] code [(NUM_VARSEL*2**(NUM_VARS))-1:0] ;
+// The LUT is held VARDATA_WORD_BITS entries per word: entry a is bit
+// a % VARDATA_WORD_BITS of word a / VARDATA_WORD_BITS
+localparam WORD_SHIFT = $clog2(VARDATA_WORD_BITS);
+localparam NUM_CODE_WORDS = ((NUM_VARSEL*2**(NUM_VARS)) + VARDATA_WORD_BITS - 1) / VARDATA_WORD_BITS;
+
+(* rom_style = MEM_STYLE, ram_style = MEM_STYLE *)
+reg [VARDATA_WORD_BITS-1:0] code [NUM_CODE_WORDS-1:0] ;
 if (STANDALONE == 1) begin : gen_standalone
-initial $readmemb(FILENAME,code,0,(NUM_VARSEL*2**(NUM_VARS))-1);
+initial begin
+   // Words a sparse file (--vardata-sparse) skips with @address lines stay zero
+   for (int i = 0; i < NUM_CODE_WORDS; i++) code[i] = 0;
+   if (VARDATA_WORD_BITS == 1) $readmemb(FILENAME,code,0,NUM_CODE_WORDS-1);
+   else $readmemh(FILENAME,code,0,NUM_CODE_WORDS-1);
+end
 end
 
 wire [NUM_VARS+NUM_VARSEL_BITS-1:0] var_ram_address;
@@ -52,7 +65,7 @@ if (STANDALONE == 0) begin : gen_not_standalone
    always @ (posedge clk) begin
       if (rst == 1) load_addr <= 0;
       else if (uberLUT_load == 1) begin 
-         code[load_addr] <= uberLUT_data;
+         code[load_addr >> WORD_SHIFT][load_addr % VARDATA_WORD_BITS] <= uberLUT_data;
          if (load_addr <= NUM_VARSEL*2**(NUM_VARS)) load_addr <= load_addr + 1;
       end
 end
@@ -62,7 +75,7 @@ end
 endgenerate
 
 assign var_ram_address = {varSel,variable};
-assign lhs =  code[var_ram_address];
+assign lhs =  code[var_ram_address >> WORD_SHIFT][var_ram_address % VARDATA_WORD_BITS];
 
 
 endmodule
@@ -0,0 +1,218 @@
+// Synthetic hotstate C program generator for the compiler benchmark.
+//
+// Writes a controller to stdout in the style of the test programs: global
+// state variables, global inputs and a main() that loops forever over a
+// sequence of top-level blocks. Every size knob is a command line option,
+// so a benchmark can grow one dimension at a time:
+//
+//   gen_program --blocks 200 --depth 3 --switches 10 --cases 8 --goto-density 5
+//
+// The output depends only on the options, so runs are repeatable.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    int states;        // Global state variables (outputs)
+    int inputs;        // Global inputs
+    int blocks;        // Top-level blocks in the main loop
+    int depth;         // Maximum if/while nesting depth inside a block
+    int switches;      // Switch statements, spread over the blocks
+    int cases;         // Cases per switch (fan-out)
+    int goto_density;  // Percent of top-level blocks that end in a forward goto
+    int complex_pct;   // Percent of conditions that are && / || expressions
+    unsigned seed;
+} GenOptions;
+
+static unsigned long long rng_state;
+
+// xorshift64*: small, fast and the same on every platform
+static unsigned next_random(void) {
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return (unsigned)((rng_state * 2685821657736338717ULL) >> 32);
+}
+
+static int random_below(int n) {
+    return n > 0 ? (int)(next_random() % (unsigned)n) : 0;
+}
+
+static void indent(int level) {
+    for (int i = 0; i < level; i++) {
+        fputs("    ", stdout);
+    }
+}
+
+static void emit_condition(const GenOptions* opt) {
+    int a = random_below(opt->inputs);
+    if (opt->inputs < 2 || random_below(100) >= opt->complex_pct) {
+        printf("a%d", a);
+        return;
+    }
+    int b = (a + 1 + random_below(opt->inputs - 1)) % opt->inputs;
+    switch (random_below(3)) {
+        case 0:  printf("a%d && a%d", a, b); break;
+        case 1:  printf("a%d || a%d", a, b); break;
+        default: printf("a%d && !a%d", a, b); break;
+    }
+}
+
+static void emit_assignment(const GenOptions* opt, int level) {
+    indent(level);
+    int s = random_below(opt->states);
+    if (random_below(4) == 0) {
+        printf("state%d = a%d;\n", s, random_below(opt->inputs));
+    } else {
+        printf("state%d = %d;\n", s, random_below(2));
+    }
+}
+
+// A nested if/else or while, down to depth levels below this one
+static void emit_nested(const GenOptions* opt, int level, int depth) {
+    if (depth <= 0) {
+        emit_assignment(opt, level);
+        return;
+    }
+
+    indent(level);
+    if (random_below(3) == 0) {
+        fputs("while (", stdout);
+        emit_condition(opt);
+        fputs(") {\n", stdout);
+        emit_nested(opt, level + 1, depth - 1);
+        indent(level);
+        fputs("}\n", stdout);
+        return;
+    }
+
+    fputs("if (", stdout);
+    emit_condition(opt);
+    fputs(") {\n", stdout);
+    emit_nested(opt, level + 1, depth - 1);
+    emit_assignment(opt, level + 1);
+    indent(level);
+    fputs("} else {\n", stdout);
+    emit_nested(opt, level + 1, depth - 1);
+    indent(level);
+    fputs("}\n", stdout);
+}
+
+static void emit_switch(const GenOptions* opt, int level) {
+    indent(level);
+    printf("switch (a%d) {\n", random_below(opt->inputs));
+    for (int c = 0; c < opt->cases; c++) {
+        indent(level + 1);
+        printf("case %d: {\n", c);
+        emit_assignment(opt, level + 2);
+        indent(level + 2);
+        fputs(random_below(4) == 0 ? "continue;\n" : "break;\n", stdout);
+        indent(level + 1);
+        fputs("}\n", stdout);
+    }
+    indent(level + 1);
+    fputs("default: {\n", stdout);
+    emit_assignment(opt, level + 2);
+    indent(level + 2);
+    fputs("break;\n", stdout);
+    indent(level + 1);
+    fputs("}\n", stdout);
+    indent(level);
+    fputs("}\n", stdout);
+}
+
+static void generate(const GenOptions* opt) {
+    printf("/* Generated by gen_program: states=%d inputs=%d blocks=%d depth=%d "
+           "switches=%d cases=%d goto_density=%d complex=%d seed=%u */\n\n",
+           opt->states, opt->inputs, opt->blocks, opt->depth, opt->switches,
+           opt->cases, opt->goto_density, opt->complex_pct, opt->seed);
+
+    for (int s = 0; s < opt->states; s++) {
+        printf("int state%d = 0;\n", s);
+    }
+    printf("\nint ");
+    for (int a = 0; a < opt->inputs; a++) {
+        printf("%sa%d", a ? ", " : "", a);
+    }
+    printf(";\n\nvoid main() {\n    while (1) {\n");
+
+    // Switches go into evenly spaced blocks; gotos jump to a later block's label
+    int switches_left = opt->switches;
+    for (int b = 0; b < opt->blocks; b++) {
+        if (opt->goto_density > 0) {
+            // The label carries its own statement so the block stays whole
+            printf("    L%d: state%d = 0;\n", b, random_below(opt->states));
+        }
+        int blocks_left = opt->blocks - b;
+        if (switches_left > 0 && random_below(blocks_left) < switches_left) {
+            emit_switch(opt, 2);
+            switches_left--;
+        } else {
+            emit_nested(opt, 2, opt->depth);
+        }
+        if (b + 1 < opt->blocks && random_below(100) < opt->goto_density) {
+            int target = b + 1 + random_below(opt->blocks - b - 1);
+            printf("        goto L%d;\n", target);
+        }
+    }
+
+    printf("    }\n}\n");
+}
+
+static void usage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --states N        State variables [8]\n"
+            "  --inputs N        Input variables [4]\n"
+            "  --blocks N        Top-level blocks in the main loop [20]\n"
+            "  --depth N         if/while nesting depth per block [2]\n"
+            "  --switches N      Switch statements [2]\n"
+            "  --cases N         Cases per switch [4]\n"
+            "  --goto-density P  Percent of blocks ending in a forward goto [0]\n"
+            "  --complex P       Percent of && / || conditions [30]\n"
+            "  --seed N          Random seed [1]\n",
+            program);
+}
+
+int main(int argc, char** argv) {
+    GenOptions opt = {8, 4, 20, 2, 2, 4, 0, 30, 1};
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--help") == 0) {
+            usage(argv[0]);
+            return 0;
+        }
+        if (i + 1 >= argc) {
+            fprintf(stderr, "Error: %s needs a value\n", argv[i]);
+            usage(argv[0]);
+            return 1;
+        }
+        int value = atoi(argv[i + 1]);
+        if (strcmp(argv[i], "--states") == 0) opt.states = value;
+        else if (strcmp(argv[i], "--inputs") == 0) opt.inputs = value;
+        else if (strcmp(argv[i], "--blocks") == 0) opt.blocks = value;
+        else if (strcmp(argv[i], "--depth") == 0) opt.depth = value;
+        else if (strcmp(argv[i], "--switches") == 0) opt.switches = value;
+        else if (strcmp(argv[i], "--cases") == 0) opt.cases = value;
+        else if (strcmp(argv[i], "--goto-density") == 0) opt.goto_density = value;
+        else if (strcmp(argv[i], "--complex") == 0) opt.complex_pct = value;
+        else if (strcmp(argv[i], "--seed") == 0) opt.seed = (unsigned)value;
+        else {
+            fprintf(stderr, "Error: Unknown option %s\n", argv[i]);
+            usage(argv[0]);
+            return 1;
+        }
+        i++;
+    }
+
+    if (opt.states < 1 || opt.inputs < 1 || opt.blocks < 1 || opt.depth < 0 ||
+        opt.switches < 0 || opt.cases < 1 || opt.goto_density < 0 || opt.complex_pct < 0) {
+        fprintf(stderr, "Error: sizes must be positive\n");
+        return 1;
+    }
+
+    rng_state = 0x9E3779B97F4A7C15ULL ^ opt.seed;
+    generate(&opt);
+    return 0;
+}
@@ -0,0 +1,62 @@
+#!/bin/bash
+# Compiler scalability benchmark (make bench).
+#
+# usage: run_bench.sh C_PARSER GEN_PROGRAM WORKDIR
+#
+# Generates synthetic programs with GEN_PROGRAM, growing one dimension at a
+# time from a common base, and compiles each with
+# C_PARSER --dot --microcode-hs --time-passes --stats-json. Prints one CSV
+# row per program with its size and the wall time of the passes that
+# matter for scaling. Times are in milliseconds:
+#
+#   sweep,value,lines,microcode_words,parse_ms,build_cfg_ms,
+#   ast_to_compact_microcode_ms,conditional_luts_ms,
+#   generate_output_files_ms,total_ms
+
+set -e
+
+C_PARSER=$(realpath "$1")
+GEN_PROGRAM=$(realpath "$2")
+WORKDIR=$3
+
+BASE="--states 8 --inputs 4 --blocks 50 --depth 2 --switches 4 --cases 4 --goto-density 0"
+
+# sweep name, option, values
+SWEEPS="
+blocks --blocks 50 200 1000 4000
+depth --depth 1 3 5 7
+switches --switches 4 12 25 50
+cases --cases 4 16 64 256
+gotos --goto-density 0 10 50 100
+inputs --inputs 4 8 12 16
+states --states 8 16 24 30
+"
+
+mkdir -p "$WORKDIR"
+cd "$WORKDIR"
+
+# Wall time of one pass from the --stats-json output, 0 if it did not run
+pass_ms() {
+    sed -n "s/.*\"name\": \"$2\", \"wall_ms\": \\([0-9.]*\\).*/\\1/p" "$1" | awk '{ t += $1 } END { printf "%.3f", t }'
+}
+
+echo "sweep,value,lines,microcode_words,parse_ms,build_cfg_ms,ast_to_compact_microcode_ms,conditional_luts_ms,generate_output_files_ms,total_ms"
+echo "$SWEEPS" | while read -r sweep option values; do
+    [ -n "$sweep" ] || continue
+    for value in $values; do
+        name="${sweep}_${value}"
+        # Later options override the base
+        "$GEN_PROGRAM" $BASE "$option" "$value" > "$name.c"
+        if ! "$C_PARSER" "$name.c" --dot --microcode-hs --time-passes --stats-json \
+                > "$name.out" 2> "$name.stats"; then
+            echo "$sweep,$value,failed" >&2
+            continue
+        fi
+        lines=$(wc -l < "$name.c")
+        words=$(grep -c . "${name}_smdata.mem" 2>/dev/null || echo 0)
+        total=$(sed -n 's/.*"total_ms": \([0-9.]*\).*/\1/p' "$name.stats")
+        echo "$sweep,$value,$lines,$words,$(pass_ms "$name.stats" parse),$(pass_ms "$name.stats" build_cfg)," \
+             "$(pass_ms "$name.stats" ast_to_compact_microcode),$(pass_ms "$name.stats" conditional_luts)," \
+             "$(pass_ms "$name.stats" generate_output_files),${total:-0}" | tr -d ' '
+    done
+done
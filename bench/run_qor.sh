@@ -0,0 +1,199 @@
+#!/bin/bash
+# Quality-of-results report (make qor).
+#
+# usage: run_qor.sh C_PARSER SIM WORKDIR OUTPUT [BASELINE]
+#
+# Compiles every program in test/*.c and examples/ with
+# C_PARSER --microcode-hs $QOR_FLAGS (default --narrow-fields, the layout
+# SIM decodes), runs each on SIM for the same generated stimulus and writes
+# one JSON object per program to OUTPUT:
+#
+#   name             source path from the repository root
+#   words            microcode words
+#   instr_width      bits per microcode word
+#   vardata_bits     vardata LUT bits
+#   switchdata_bits  switch table bits, jadr wide entries
+#   bram_bits        all ROMs with each depth rounded up to a power of two
+#   settle_cycles    cycles the states took to settle, summed over the
+#                    stimulus's input changes
+#   latency          the most any one input change took
+#
+# A stretch of constant inputs has settled from the cycle after which the
+# states take no value other than those held in its second half, as
+# hotstate_sim --autotune scores latency. A program that failed to compile
+# or run is written as {"name": ..., "failed": true}.
+#
+# With BASELINE, an earlier OUTPUT (or OUTPUT itself, read before it is
+# rewritten), every field that changed is printed, and the script exits 1
+# if any grew or a program no longer builds.
+
+set -e
+
+C_PARSER=$(realpath "$1")
+SIM=$(realpath "$2")
+WORKDIR=$3
+OUTPUT=$(realpath -m "$4")
+BASELINE=${5:+$(realpath "$5")}
+REPO=$(cd "$(dirname "$0")/.." && pwd)
+FLAGS=${QOR_FLAGS---narrow-fields}
+
+CYCLES=4000
+STRETCH=50
+FIELDS="words instr_width vardata_bits switchdata_bits bram_bits settle_cycles latency"
+
+mkdir -p "$WORKDIR"
+WORKDIR=$(realpath "$WORKDIR")
+
+# Inputs change every STRETCH cycles, each of 16 to a bit of a fixed
+# pseudo-random sequence; programs with fewer inputs ignore the rest
+awk -v cycles=$CYCLES -v stretch=$STRETCH 'BEGIN {
+    x = 1
+    for (c = 0; c < cycles; c += stretch) {
+        x = (x * 75 + 74) % 65537
+        printf "%d", c
+        for (i = 0; i < 16; i++) printf ",%d", int(x / 2 ^ i) % 2
+        printf "\n"
+    }
+}' > "$WORKDIR/stimulus.txt"
+
+# A localparam of a _params.vh, 0 if absent
+param() {
+    sed -n "s/^localparam $2 = \\([0-9]*\\);/\\1/p" "$1" | head -1 | awk '{ print $1 + 0 } END { if (NR == 0) print 0 }'
+}
+
+# Bits of a ROM of depth entries of width bits, its depth rounded up to a
+# power of two as a block RAM would be addressed
+rom_bits() {
+    awk -v depth="$1" -v width="$2" 'BEGIN { d = 1; while (d < depth) d *= 2; print (depth > 0 ? d * width : 0) }'
+}
+
+# Prints "settle_cycles latency" for a CSV trace with the states in fields
+# 6 to 5+STATES
+settle() {
+    awk -F, -v states="$2" -v stretch=$STRETCH '
+    function score(   half, c, i, steady, last) {
+        if (n == 0) return
+        half = start + int(n / 2)
+        for (c = half; c < start + n; c++) steady[value[c]] = 1
+        last = start
+        for (c = start; c < start + n; c++) if (!(value[c] in steady)) last = c + 1
+        total += last - start
+        if (last - start > worst) worst = last - start
+        delete value
+        n = 0
+    }
+    NR > 1 {
+        c = $1
+        if (c % stretch == 0) { score(); start = c }
+        v = ""
+        for (i = 6; i < 6 + states; i++) v = v $i
+        value[c] = v
+        n++
+    }
+    END { score(); printf "%d %d\n", total, worst }' "$1"
+}
+
+# One "name field value" line per field of each program
+flatten() {
+    sed -n 's/^ *{"name": "\([^"]*\)", \(.*\)},\{0,1\}$/\1 \2/p' "$1" |
+        awk '{ name = $1; for (i = 2; i < NF; i += 2) { f = $i; gsub(/[":]/, "", f); v = $(i + 1); sub(/,$/, "", v); print name, f, v } }'
+}
+
+# Read first, so the baseline may be OUTPUT itself
+if [ -n "$BASELINE" ]; then
+    flatten "$BASELINE" > "$WORKDIR/baseline.txt"
+fi
+
+# The sources, each copied next to the headers it may include
+SOURCES=$(cd "$REPO" && ls test/*.c examples/*/*.c)
+for dir in $(echo "$SOURCES" | xargs -n1 dirname | sort -u); do
+    mkdir -p "$WORKDIR/$dir"
+    cp "$REPO/$dir"/*.c "$WORKDIR/$dir/"
+    cp "$REPO/$dir"/*.h "$WORKDIR/$dir/" 2>/dev/null || true
+done
+
+{
+    echo "["
+    first=1
+    for source in $SOURCES; do
+        name=$(basename "$source" .c)
+        dir="$WORKDIR/$(dirname "$source")"
+        [ $first = 1 ] || echo ","
+        first=0
+
+        cd "$dir"
+        for suffix in smdata.mem vardata.mem switchdata.mem timdata.mem params.vh; do
+            rm -f "${name}_$suffix"
+        done
+        # The braces keep the shell's report of a crash out of the output
+        if ! { timeout 30 "$C_PARSER" "$name.c" --microcode-hs $FLAGS > "$name.out" 2>&1; } 2>/dev/null ||
+           [ ! -s "${name}_smdata.mem" ] ||
+           ! { timeout 60 "$SIM" -b "$name" -s "$WORKDIR/stimulus.txt" -m $CYCLES -f csv -o "$name.csv" -q \
+                > "$name.sim" 2>&1; } 2>/dev/null; then
+            printf '  {"name": "%s", "failed": true}' "$source"
+            continue
+        fi
+
+        params="${name}_params.vh"
+        words=$(grep -c . "${name}_smdata.mem")
+        width=$(sed -n 's/^localparam \([A-Z_]*\)_WIDTH = \([0-9]*\);/\1 \2/p' "$params" |
+                awk '$1 != "TIM" { w += $2 } END { print w + 0 }')
+        vardata_entries=$(grep -c . "${name}_vardata.mem" 2>/dev/null || true)
+        vardata_word=$(param "$params" VARDATA_WORD_BITS)
+        [ "$vardata_word" -gt 0 ] || vardata_word=1
+        switch_entries=$(grep -c . "${name}_switchdata.mem" 2>/dev/null || true)
+        jadr=$(param "$params" JADR_WIDTH)
+
+        vardata_bits=$((${vardata_entries:-0} * vardata_word))
+        switch_bits=$((${switch_entries:-0} * jadr))
+        bram=$(( $(rom_bits "$words" "$width") +
+                 $(rom_bits "${vardata_entries:-0}" "$vardata_word") +
+                 $(rom_bits "${switch_entries:-0}" "$jadr") +
+                 $(rom_bits "$(param "$params" TIM_MEM_WORDS)" "$(param "$params" TIM_WIDTH)") ))
+        states=$(param "$params" NUM_STATES)
+        [ "$states" -gt 0 ] || states=$(param "$params" STATE_WIDTH)
+        read -r settle_cycles latency <<< "$(settle "$name.csv" "$states")"
+
+        printf '  {"name": "%s", "words": %d, "instr_width": %d, "vardata_bits": %d, "switchdata_bits": %d, "bram_bits": %d, "settle_cycles": %d, "latency": %d}' \
+            "$source" "$words" "$width" "$vardata_bits" "$switch_bits" "$bram" "$settle_cycles" "$latency"
+    done
+    echo
+    echo "]"
+} > "$OUTPUT.tmp"
+mv "$OUTPUT.tmp" "$OUTPUT"
+
+built=$(grep -c '"words"' "$OUTPUT" || true)
+failed=$(grep -c '"failed"' "$OUTPUT" || true)
+echo "QoR of $built programs written to $OUTPUT ($failed failed to build or run)"
+
+[ -n "$BASELINE" ] || exit 0
+
+echo "Compared with $BASELINE:"
+flatten "$OUTPUT" > "$WORKDIR/current.txt"
+status=0
+awk -v fields="$FIELDS" '
+    BEGIN { n = split(fields, list, " "); for (i = 1; i <= n; i++) scored[list[i]] = 1 }
+    FILENAME == ARGV[1] { now[$1 " " $2] = $3; next }
+    { was[$1 " " $2] = $3 }
+    END {
+        for (key in was) {
+            split(key, k, " ")
+            if (k[2] == "failed") continue
+            if ((k[1] " failed") in now) {
+                if (!(k[1] in reported)) { print "  REGRESSION " k[1] ": no longer builds"; bad++ }
+                reported[k[1]] = 1
+            } else if ((key in now) && (k[2] in scored) && now[key] != was[key]) {
+                grew = now[key] > was[key]
+                printf "  %s %s %s: %s -> %s\n", grew ? "REGRESSION" : "improved  ", k[1], k[2], was[key], now[key]
+                bad += grew
+            }
+        }
+        exit (bad > 0)
+    }' "$WORKDIR/current.txt" "$WORKDIR/baseline.txt" > "$WORKDIR/changes.txt" || status=1
+sort "$WORKDIR/changes.txt"
+if [ $status = 0 ]; then
+    echo "No regressions"
+else
+    echo "$(grep -c REGRESSION "$WORKDIR/changes.txt") regression(s)"
+fi
+exit $status
@@ -0,0 +1,44 @@
+// Linked into hotstate_sim_bench and hotstate_sim_stats only: counts heap
+// allocations. The bench build reports the total on stderr at exit, so
+// run_bench.sh can derive allocations per cycle; the stats build reads the
+// count for --stats instead. Not part of the regular hotstate_sim build.
+#include "run_stats.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+std::atomic<unsigned long long> allocationCount{0};
+
+#ifndef HOTSTATE_STATS
+struct AllocationReport {
+    ~AllocationReport() {
+        std::fprintf(stderr, "bench_allocations=%llu\n", allocationCount.load());
+    }
+} report;
+#endif
+
+void* countedAlloc(std::size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+} // namespace
+
+#ifdef HOTSTATE_STATS
+uint64_t HotstateSim::heapAllocationCount() {
+    return allocationCount.load(std::memory_order_relaxed);
+}
+#endif
+
+void* operator new(std::size_t size) { return countedAlloc(size); }
+void* operator new[](std::size_t size) { return countedAlloc(size); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
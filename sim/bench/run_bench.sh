@@ -0,0 +1,67 @@
+#!/bin/bash
+# Simulator throughput benchmark (make bench).
+#
+# usage: run_bench.sh SIM C_PARSER WORKDIR CYCLES
+#
+# Compiles each benchmark program with C_PARSER, then times SIM (built with
+# bench/alloc_counter.cpp) for CYCLES and 2*CYCLES cycles in every logging
+# mode. Costs are the difference between the two runs, so loading and
+# startup drop out. Prints one CSV row per program and mode:
+#
+#   program,mode,cycles,ns_per_cycle,cycles_per_sec,allocs_per_cycle
+
+set -e
+
+SIM=$(realpath "$1")
+C_PARSER=$(realpath "$2")
+WORKDIR=$3
+CYCLES=$4
+REPO=$(cd "$(dirname "$0")/../.." && pwd)
+
+PROGRAMS="examples/switches/switches.c examples/while/while.c examples/if_else/if_else.c test/test_hybrid_varsel.c"
+MODES="off console vcd csv"
+
+mkdir -p "$WORKDIR"
+WORKDIR=$(realpath "$WORKDIR")
+
+# Run one mode for N cycles; prints "nanoseconds allocations"
+run_sim() {
+    local name=$1 mode=$2 cycles=$3
+    local args=(-b "$name" -s stimulus.txt -m "$cycles")
+    case $mode in
+        off)     args+=(--no-log) ;;
+        console) args+=(-f console) ;;
+        vcd)     args+=(-f vcd -o "$name.vcd") ;;
+        csv)     args+=(-f csv -o "$name.csv") ;;
+    esac
+    local start end allocs
+    start=$(date +%s%N)
+    allocs=$("$SIM" "${args[@]}" 2>&1 >/dev/null | sed -n 's/^bench_allocations=//p')
+    end=$(date +%s%N)
+    echo "$((end - start)) ${allocs:-0}"
+}
+
+echo "program,mode,cycles,ns_per_cycle,cycles_per_sec,allocs_per_cycle"
+for source in $PROGRAMS; do
+    name=$(basename "$source" .c)
+    dir="$WORKDIR/$name"
+    mkdir -p "$dir"
+    cp "$REPO/$source" "$dir/"
+    (cd "$dir" && "$C_PARSER" "$name.c" --microcode-hs >/dev/null 2>&1)
+
+    # Inputs change every few cycles for the first 10000 cycles, then hold
+    awk 'BEGIN { for (c = 0; c < 10000; c += 7) printf "%d,%d,%d,%d,%d\n", c, c % 2, (c / 7) % 2, (c / 13) % 3 == 0, (c / 29) % 2 }' \
+        > "$dir/stimulus.txt"
+
+    cd "$dir"
+    for mode in $MODES; do
+        read -r t1 a1 <<< "$(run_sim "$name" "$mode" "$CYCLES")"
+        read -r t2 a2 <<< "$(run_sim "$name" "$mode" $((CYCLES * 2)))"
+        awk -v p="$name" -v m="$mode" -v n="$CYCLES" -v t1="$t1" -v t2="$t2" -v a1="$a1" -v a2="$a2" 'BEGIN {
+            ns = (t2 - t1) / n
+            if (ns <= 0) ns = t2 / (2 * n)
+            printf "%s,%s,%d,%.2f,%.0f,%.4f\n", p, m, n, ns, 1e9 / ns, (a2 - a1) / n
+        }'
+    done
+    cd - >/dev/null
+done
@@ -0,0 +1,221 @@
+// Lockstep co-simulation of HotstateModel against the Verilated design.
+// Built by the cosim target of the Makefile.sim the compiler generates
+// (c_parser --all-hdl), with verilator_cosim.h naming the Verilated
+// <module>_cosim wrapper, which brings the packed states and the hotstate
+// address out as ports.
+//
+// Both sides get the same reset and stimulus every cycle. Rather than
+// comparing them cycle by cycle, each side keeps a TraceSignature and the
+// two are compared every window cycles; only a window whose signatures
+// differ is replayed from reset with per-cycle comparisons, to report the
+// first cycle where the state or address differ.
+
+#include <verilated.h>
+#include "verilator_cosim.h"
+#include "hotstate_model.h"
+#include "memory_loader.h"
+#include "stimulus_parser.h"
+#include "trace_signature.h"
+#include "utils.h"
+#include <getopt.h>
+#include <iostream>
+#include <memory>
+
+using namespace HotstateSim;
+
+namespace {
+
+constexpr uint32_t RESET_CYCLES = 2;  // One clock period, as in the generated testbench
+
+// Verilator ports are integers up to 64 bits and VlWide arrays of 32-bit
+// words above; states are read into StateBits' 64-bit words either way
+template <typename T>
+void readPort(const T& port, std::vector<uint64_t>& words) {
+    words.assign(1, static_cast<uint64_t>(port));
+}
+
+template <std::size_t N>
+void readPort(const VlWide<N>& port, std::vector<uint64_t>& words) {
+    words.assign((N + 1) / 2, 0);
+    for (std::size_t i = 0; i < N; ++i) {
+        words[i / 2] |= static_cast<uint64_t>(port[i]) << (32 * (i % 2));
+    }
+}
+
+template <typename T>
+void writePort(T& port, const std::vector<uint8_t>& bits) {
+    uint64_t value = 0;
+    for (std::size_t i = 0; i < bits.size() && i < 64; ++i) {
+        value |= static_cast<uint64_t>(bits[i] & 1) << i;
+    }
+    port = static_cast<T>(value);
+}
+
+template <std::size_t N>
+void writePort(VlWide<N>& port, const std::vector<uint8_t>& bits) {
+    for (std::size_t w = 0; w < N; ++w) {
+        port[w] = 0;
+    }
+    for (std::size_t i = 0; i < bits.size() && i < 32 * N; ++i) {
+        port[i / 32] |= static_cast<EData>(bits[i] & 1) << (i % 32);
+    }
+}
+
+// The two implementations from reset, clocked together
+class Lockstep {
+public:
+    Lockstep(const MemoryLoader& memory, const StimulusParser& stimulus)
+        : stimulus(stimulus)
+        , context(std::make_unique<VerilatedContext>())
+        , rtl(std::make_unique<V_cosim>(context.get()))
+        , model(std::make_unique<HotstateModel>(memory))
+        , idleInputs(model->getInputs().size(), 0)
+    {
+        model->reset();
+        rtl->clk = 0;
+        rtl->rst = 1;
+        writePort(rtl->variables, idleInputs);
+        rtl->eval();
+    }
+
+    ~Lockstep() { rtl->final(); }
+
+    // One clock edge on both sides; the RTL clock follows the model's
+    void clock(uint32_t cycle) {
+        bool reset = cycle < RESET_CYCLES;
+        const std::vector<uint8_t>& inputs = stimulus.isEmpty() ? idleInputs : stimulus.getInputs(cycle);
+        model->setReset(reset);
+        model->setInputs(inputs);
+        model->clock();
+
+        rtl->rst = reset;
+        writePort(rtl->variables, inputs);
+        rtl->clk = model->getClock();
+        rtl->eval();
+        context->timeInc(1);
+        readPort(rtl->states, rtlStates);
+    }
+
+    const HotstateModel& getModel() const { return *model; }
+    uint32_t rtlAddress() const { return static_cast<uint32_t>(rtl->address); }
+    const std::vector<uint64_t>& getRtlStates() const { return rtlStates; }
+
+    bool matches() const {
+        return model->getCurrentAddress() == rtlAddress() && model->getStates().getWords() == rtlStates;
+    }
+
+private:
+    const StimulusParser& stimulus;
+    std::unique_ptr<VerilatedContext> context;
+    std::unique_ptr<V_cosim> rtl;
+    std::unique_ptr<HotstateModel> model;
+    std::vector<uint8_t> idleInputs;
+    std::vector<uint64_t> rtlStates;
+};
+
+void printUsage(const char* programName) {
+    std::cout << "Usage: " << programName << " -b BASE [-s STIMULUS] [-m CYCLES] [-w WINDOW]" << std::endl;
+    std::cout << "  -b, --base PATH         Base path of the compiled program's memory files" << std::endl;
+    std::cout << "  -s, --stimulus FILE     Input stimulus file [default: inputs held low]" << std::endl;
+    std::cout << "  -m, --max-cycles NUM    Cycles to co-simulate [default: 1000]" << std::endl;
+    std::cout << "  -w, --window NUM        Cycles between signature comparisons [default: 1024]" << std::endl;
+}
+
+void printSide(const char* name, uint32_t address, const std::vector<uint64_t>& states) {
+    std::cout << "  " << name << ": address 0x" << std::hex << address << std::dec
+              << ", states 0x" << wideHexString(states.data(), static_cast<uint32_t>(states.size())) << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Verilated::commandArgs(argc, argv);
+
+    std::string basePath, stimulusFile;
+    uint32_t maxCycles = 1000;
+    uint32_t window = 1024;
+
+    static struct option longOptions[] = {
+        {"base", required_argument, 0, 'b'},
+        {"stimulus", required_argument, 0, 's'},
+        {"max-cycles", required_argument, 0, 'm'},
+        {"window", required_argument, 0, 'w'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+    int c;
+    try {
+        while ((c = getopt_long(argc, argv, "b:s:m:w:h", longOptions, nullptr)) != -1) {
+            switch (c) {
+                case 'b': basePath = optarg; break;
+                case 's': stimulusFile = optarg; break;
+                case 'm': maxCycles = static_cast<uint32_t>(std::stoul(optarg)); break;
+                case 'w': window = static_cast<uint32_t>(std::stoul(optarg)); break;
+                case 'h': printUsage(argv[0]); return 0;
+                default: printUsage(argv[0]); return 2;
+            }
+        }
+    } catch (const std::exception&) {
+        std::cerr << "Invalid number: " << optarg << std::endl;
+        return 2;
+    }
+    if (basePath.empty() || window == 0) {
+        printUsage(argv[0]);
+        return 2;
+    }
+
+    try {
+        MemoryLoader memory;
+        if (!memory.loadProgram(basePath, "")) {
+            std::cerr << "Failed to load memory files from base path: " << basePath << std::endl;
+            return 1;
+        }
+        StimulusParser stimulus;
+        if (!stimulusFile.empty() && !stimulus.loadStimulus(stimulusFile)) {
+            std::cerr << "Failed to load stimulus file: " << stimulusFile << std::endl;
+            return 1;
+        }
+
+        // Signatures compared once a window
+        uint32_t windowStart = 0;
+        bool diverged = false;
+        {
+            Lockstep sides(memory, stimulus);
+            TraceSignature modelSignature, rtlSignature;
+            for (uint32_t cycle = 0; cycle < maxCycles; ++cycle) {
+                sides.clock(cycle);
+                modelSignature.record(cycle, sides.getModel());
+                rtlSignature.record(cycle, sides.rtlAddress(), sides.getRtlStates());
+                if ((cycle + 1) % window == 0 || cycle + 1 == maxCycles) {
+                    if (modelSignature.value() != rtlSignature.value()) {
+                        diverged = true;
+                        break;
+                    }
+                    windowStart = cycle + 1;
+                }
+            }
+        }
+        if (!diverged) {
+            std::cout << "Co-simulation matched for " << maxCycles << " cycles" << std::endl;
+            return 0;
+        }
+
+        // Replay up to the window, then compare every cycle of it
+        Lockstep sides(memory, stimulus);
+        for (uint32_t cycle = 0; cycle < maxCycles; ++cycle) {
+            sides.clock(cycle);
+            if (cycle >= windowStart && !sides.matches()) {
+                std::cout << "Co-simulation mismatch at cycle " << cycle << std::endl;
+                printSide("model", sides.getModel().getCurrentAddress(), sides.getModel().getStates().getWords());
+                printSide("rtl  ", sides.rtlAddress(), sides.getRtlStates());
+                return 1;
+            }
+        }
+        std::cerr << "Signatures differ from cycle " << windowStart
+                  << " but the replay matched: the design is not deterministic" << std::endl;
+        return 1;
+    } catch (const SimulatorException& e) {
+        std::cerr << "Co-simulation failed: " << e.what() << std::endl;
+        return 1;
+    }
+}
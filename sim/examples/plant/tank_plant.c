@@ -0,0 +1,156 @@
+/*
+ * Example --plant: a tank filled by a pump and drained at a steady rate.
+ *
+ * The program's pump state fills the tank while it is set; the low and
+ * high inputs are level switches. The level is worked out from the time
+ * since the last call rather than stepped every cycle, and the plant wakes
+ * the simulator only at the cycle the level next crosses a switch, so
+ * with --fast-forward the run only simulates the cycles around each
+ * switch change and pump change.
+ *
+ *   cc -shared -fPIC -I../../include tank_plant.c -o tank_plant.so
+ *   hotstate_sim -b tank --plant ./tank_plant.so --plant-args "fill=3,drain=1" --fast-forward
+ *
+ * Arguments (comma separated, all optional):
+ *   pump=NAME   state that runs the pump           [default: pump, else state 0]
+ *   low=NAME    input set while the level is low   [default: low, else input 0]
+ *   high=NAME   input set while the level is high  [default: high, else input 1]
+ *   fill=N      level gained per cycle with the pump on, less drain  [3]
+ *   drain=N     level lost per cycle                                 [1]
+ *   low_mark=N, high_mark=N, capacity=N, level=N  [1000, 9000, 10000, 5000]
+ */
+
+#include "hotstate_plant.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct tank {
+    uint32_t pump, low, high;
+    int64_t fill, drain;
+    int64_t low_mark, high_mark, capacity, start_level;
+    int64_t level;
+    uint64_t last_cycle;
+    int pumping;
+} tank;
+
+static uint32_t find_name(const char* const* names, uint32_t count, const char* name, uint32_t fallback) {
+    for (uint32_t i = 0; i < count; ++i) {
+        if (strcmp(names[i], name) == 0) {
+            return i;
+        }
+    }
+    return fallback;
+}
+
+static void write_inputs(const tank* t, uint8_t* inputs) {
+    inputs[t->low] = t->level <= t->low_mark;
+    inputs[t->high] = t->level >= t->high_mark;
+}
+
+/* The next cycle after now at which a switch changes, at the current rate */
+static uint64_t next_crossing(const tank* t, uint64_t now) {
+    int64_t rate = (t->pumping ? t->fill : 0) - t->drain;
+    int64_t target;
+    if (rate > 0 && t->level < t->high_mark) {
+        target = t->level <= t->low_mark ? t->low_mark + 1 : t->high_mark;
+    } else if (rate < 0 && t->level > t->low_mark) {
+        target = t->level >= t->high_mark ? t->high_mark - 1 : t->low_mark;
+    } else {
+        return HOTSTATE_PLANT_NO_WAKE;
+    }
+    int64_t distance = target > t->level ? target - t->level : t->level - target;
+    int64_t speed = rate > 0 ? rate : -rate;
+    return now + (uint64_t)((distance + speed - 1) / speed);
+}
+
+static uint64_t tank_reset(void* context, uint8_t* inputs) {
+    tank* t = (tank*)context;
+    t->level = t->start_level;
+    t->last_cycle = 0;
+    t->pumping = 0;
+    write_inputs(t, inputs);
+    return next_crossing(t, 0);
+}
+
+static uint64_t tank_update(void* context, uint64_t cycle, const uint64_t* states, uint8_t* inputs) {
+    tank* t = (tank*)context;
+    int64_t rate = (t->pumping ? t->fill : 0) - t->drain;
+    t->level += rate * (int64_t)(cycle - t->last_cycle);
+    if (t->level < 0) {
+        t->level = 0;
+    }
+    if (t->level > t->capacity) {
+        t->level = t->capacity;
+    }
+    t->last_cycle = cycle;
+    t->pumping = (states[t->pump / 64] >> (t->pump % 64)) & 1;
+    write_inputs(t, inputs);
+    return next_crossing(t, cycle);
+}
+
+static void tank_destroy(void* context) {
+    free(context);
+}
+
+int hotstate_plant_create(const hotstate_plant_info* info, hotstate_plant* plant) {
+    if (info->num_states < 1 || info->num_inputs < 2) {
+        fprintf(stderr, "tank_plant: the program needs a pump state and low and high inputs\n");
+        return 1;
+    }
+    tank* t = (tank*)calloc(1, sizeof(tank));
+    if (!t) {
+        return 1;
+    }
+    t->pump = find_name(info->state_names, info->num_states, "pump", 0);
+    t->low = find_name(info->input_names, info->num_inputs, "low", 0);
+    t->high = find_name(info->input_names, info->num_inputs, "high", 1);
+    t->fill = 3;
+    t->drain = 1;
+    t->low_mark = 1000;
+    t->high_mark = 9000;
+    t->capacity = 10000;
+    t->start_level = 5000;
+
+    char* args = strdup(info->args);
+    for (char* item = strtok(args, ","); item; item = strtok(NULL, ",")) {
+        char* value = strchr(item, '=');
+        if (!value) {
+            continue;
+        }
+        *value++ = '\0';
+        if (strcmp(item, "pump") == 0) {
+            t->pump = find_name(info->state_names, info->num_states, value, info->num_states);
+        } else if (strcmp(item, "low") == 0) {
+            t->low = find_name(info->input_names, info->num_inputs, value, info->num_inputs);
+        } else if (strcmp(item, "high") == 0) {
+            t->high = find_name(info->input_names, info->num_inputs, value, info->num_inputs);
+        } else if (strcmp(item, "fill") == 0) {
+            t->fill = atoll(value);
+        } else if (strcmp(item, "drain") == 0) {
+            t->drain = atoll(value);
+        } else if (strcmp(item, "low_mark") == 0) {
+            t->low_mark = atoll(value);
+        } else if (strcmp(item, "high_mark") == 0) {
+            t->high_mark = atoll(value);
+        } else if (strcmp(item, "capacity") == 0) {
+            t->capacity = atoll(value);
+        } else if (strcmp(item, "level") == 0) {
+            t->start_level = atoll(value);
+        }
+    }
+    free(args);
+    if (t->pump >= info->num_states || t->low >= info->num_inputs || t->high >= info->num_inputs) {
+        fprintf(stderr, "tank_plant: no such pump state or level input in the program\n");
+        free(t);
+        return 1;
+    }
+
+    plant->abi_version = HOTSTATE_PLANT_ABI_VERSION;
+    plant->context = t;
+    plant->reset = tank_reset;
+    plant->update = tank_update;
+    plant->last_error = NULL;
+    plant->destroy = tank_destroy;
+    return 0;
+}
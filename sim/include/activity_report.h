@@ -0,0 +1,25 @@
+#ifndef ACTIVITY_REPORT_H
+#define ACTIVITY_REPORT_H
+
+#include "hotstate_model.h"
+#include "memory_loader.h"
+#include <ostream>
+#include <string>
+
+namespace HotstateSim {
+
+// Switching activity of a model run with activity counting on (--activity)
+// as SAIF 2.0, the toggle file power tools read in place of a VCD: T0, T1
+// and TC of every bit of the states register and of the microcode fields,
+// under the generated testbench's path to the Microcode instance, with one
+// clock period of the testbench (10 ns) per rising edge.
+void writeActivitySaif(std::ostream& out, const HotstateModel& model, const MemoryLoader& memory,
+                       const std::string& design);
+
+// Toggles per microcode field and per state output, with the share of the
+// run each state was high
+void writeActivityReport(std::ostream& out, const HotstateModel& model, const MemoryLoader& memory);
+
+} // namespace HotstateSim
+
+#endif // ACTIVITY_REPORT_H
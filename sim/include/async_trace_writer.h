@@ -0,0 +1,57 @@
+#ifndef ASYNC_TRACE_WRITER_H
+#define ASYNC_TRACE_WRITER_H
+
+#include "output_logger.h"
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <vector>
+#include <cstdint>
+
+namespace HotstateSim {
+
+// Moves trace formatting off the simulation thread. push() copies an entry
+// into a single-producer/single-consumer byte ring without locking, and a
+// background thread rebuilds the LogView and hands it to the format
+// callback in push order. Only one thread may push.
+class AsyncTraceWriter {
+public:
+    using FormatFn = std::function<void(const LogView&)>;
+    
+    static constexpr size_t DEFAULT_CAPACITY = 4 << 20;  // Bytes; rounded up to a power of two
+    
+private:
+    FormatFn format;
+    std::vector<uint8_t> ring;
+    size_t mask;
+    
+    // Byte positions only ever increase; a position's slot is pos & mask
+    alignas(64) std::atomic<size_t> head;   // Advanced by the writer thread
+    alignas(64) std::atomic<size_t> tail;   // Advanced by push()
+    std::atomic<bool> stopping;
+    std::thread writer;
+    
+    // Writer thread scratch for the entry being formatted
+    std::vector<uint64_t> stateScratch;
+    std::vector<uint8_t> outputScratch;
+    std::vector<uint8_t> inputScratch;
+    
+    void copyIn(size_t pos, const void* data, size_t size);
+    void copyOut(size_t pos, void* data, size_t size) const;
+    void writeLoop();
+    
+public:
+    explicit AsyncTraceWriter(FormatFn format, size_t capacity = DEFAULT_CAPACITY);
+    ~AsyncTraceWriter();  // Formats everything pushed, then stops the thread
+    AsyncTraceWriter(const AsyncTraceWriter&) = delete;
+    AsyncTraceWriter& operator=(const AsyncTraceWriter&) = delete;
+    
+    // Waits only while the ring is full
+    void push(const LogView& entry);
+    // Returns once every pushed entry has been formatted
+    void drain();
+};
+
+} // namespace HotstateSim
+
+#endif // ASYNC_TRACE_WRITER_H
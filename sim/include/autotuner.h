@@ -0,0 +1,79 @@
+#ifndef AUTOTUNER_H
+#define AUTOTUNER_H
+
+#include "simulator.h"
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace HotstateSim {
+
+// Compile settings search (--autotune). The --from-source program is
+// compiled in-process under every combination of the compiler options that
+// trade microcode words and LUT bits for cycles, and each result is run on
+// the -s stimulus, on --jobs worker threads. Compiling stays on the calling
+// thread, since the compiler keeps its options in globals.
+//
+// A run is scored by its microcode words, its vardata LUT bytes and its
+// latency: the most cycles any input change takes to settle the states,
+// from the change to the last state change before the next one. The states
+// each change settles to are compared with those of the default settings,
+// and settings that settle differently (a slower program that has not
+// settled before the next input change, or inputs numbered differently
+// from the stimulus by --prune-inputs) are left out of the choice.
+//
+// The report lists the settings no other one beats on all three scores,
+// marking those within the --rom-budget, --lut-budget and --latency-budget
+// limits.
+class Autotuner {
+public:
+    // Values of the state register, as StateBits words, sorted
+    using StateSet = std::vector<std::vector<uint64_t>>;
+
+    struct Result {
+        std::string flags;           // c_parser options, "" for the defaults
+        uint32_t flagCount;
+        bool success;
+        std::string error;
+        uint32_t words;
+        uint32_t lutBytes;
+        uint32_t latency;
+        std::vector<StateSet> settled;  // What the states settle into after each input change
+        bool matches;                // Settles as the defaults do
+        bool optimal;                // On the Pareto front of the matching results
+        bool withinBudget;
+
+        Result() : flagCount(0), success(false), words(0), lutBytes(0), latency(0),
+                   matches(false), optimal(false), withinBudget(false) {}
+    };
+
+    explicit Autotuner(const SimulatorConfig& config);
+    ~Autotuner();
+
+    bool run();  // False, with getLastError, if the default settings fail
+    void writeReport(std::ostream& out) const;
+
+    const std::vector<Result>& getResults() const { return results; }
+    const std::string& getLastError() const { return lastError; }
+
+private:
+    struct Setting;
+
+    void compileAll();
+    void simulateAll();
+    void simulate(uint32_t index, Result& result) const;
+    void rank();
+    bool dominates(const Result& a, const Result& b) const;
+
+    SimulatorConfig config;
+    uint32_t jobs;
+    std::vector<std::unique_ptr<Setting>> settings;  // In results order, with the program compiled for each
+    std::vector<Result> results;
+    std::string lastError;
+};
+
+} // namespace HotstateSim
+
+#endif // AUTOTUNER_H
@@ -0,0 +1,87 @@
+#ifndef BATCH_SIMULATOR_H
+#define BATCH_SIMULATOR_H
+
+#include "simulator.h"
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <memory>
+
+namespace HotstateSim {
+
+// Runs many stimulus files against one compiled controller. The memory image
+// is loaded and predecoded once, and every stimulus file becomes a lane of a
+// structure-of-arrays model, so each clock advances all lanes in one pass
+// over the same microcode table. Lanes follow HotstateModel::clock exactly.
+class BatchSimulator {
+private:
+    SimulatorConfig config;
+    std::vector<std::string> stimulusFiles;
+    std::string lastError;
+
+    // Shared, read-only after initialize()
+    MemoryLoader memoryLoader;
+    std::vector<DecodedMicrocode> decoded;
+    VardataImage lut;
+    uint32_t laneCount;
+    uint32_t stateWordCount;   // uint64_t words per lane state register
+    uint32_t numVars;
+    uint32_t numTimers;
+    uint32_t stackDepth;       // Parameters::STACK_DEPTH, as HotstateModel
+
+    // Per-lane stimulus and output
+    std::vector<StimulusParser> stimuli;
+    std::vector<std::unique_ptr<OutputLogger>> loggers;
+    std::vector<const std::vector<uint8_t>*> laneInputs;  // Inputs applied this cycle
+    std::vector<uint8_t> laneOutputs;                     // Scratch for logLanes
+
+    // Lane state, one array per register; lane i owns element i, or the
+    // slice [i * stride, (i + 1) * stride) for multi-word registers
+    std::vector<uint64_t> states;       // stateWordCount words per lane
+    std::vector<uint64_t> inputBits;    // Inputs packed as HotstateModel packs them
+    std::vector<uint32_t> stack;        // stackDepth per lane
+    std::vector<uint32_t> timers;       // numTimers counts per lane
+    std::vector<uint32_t> address;
+    std::vector<uint32_t> stackPointer;
+    std::vector<uint64_t> cycleCount;
+    std::vector<uint8_t> clk;
+    std::vector<uint8_t> rst;
+    std::vector<uint8_t> ready;
+    std::vector<uint8_t> lhs;
+    std::vector<uint8_t> fired;
+    std::vector<uint8_t> switchActive;
+
+    bool loadMemoryFiles();
+    bool loadStimulusFiles();
+    bool initializeLoggers();
+    void allocateLanes();
+    void resetLane(uint32_t lane);
+    void applyStimulus(uint32_t cycle);
+    void clockLanes();
+    void executeLane(uint32_t lane);
+    void logLanes(uint32_t cycle);
+
+public:
+    BatchSimulator(const SimulatorConfig& cfg, const std::vector<std::string>& stimulusFiles);
+
+    bool initialize();
+    bool run();
+
+    uint32_t getLaneCount() const { return laneCount; }
+    uint32_t getLaneAddress(uint32_t lane) const { return address[lane]; }
+    const std::string& getLastError() const { return lastError; }
+    void printSummary() const;
+
+    // The stimulus set for --batch: the files in a directory (sorted, trace
+    // outputs excluded), or a list file with one path per line; blank lines and '#' comments are skipped
+    static std::vector<std::string> readStimulusList(const std::string& path);
+
+    // Trace file for run index of a batch: -o trace.csv gives trace_<index>.csv,
+    // otherwise the stimulus file name with the output format's extension
+    static std::string outputFileFor(const SimulatorConfig& config, const std::string& stimulusFile,
+                                     uint32_t index);
+};
+
+} // namespace HotstateSim
+
+#endif // BATCH_SIMULATOR_H
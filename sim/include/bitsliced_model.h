@@ -0,0 +1,142 @@
+#ifndef BITSLICED_MODEL_H
+#define BITSLICED_MODEL_H
+
+#include "hotstate_model.h"
+#include <string>
+#include <vector>
+#include <array>
+#include <map>
+#include <tuple>
+#include <cstdint>
+
+namespace HotstateSim {
+
+// 64 copies of one program stepped together, each register a uint64_t
+// lane mask: bit L of a state, input or group mask belongs to lane L.
+// Lanes only differ by their inputs, so every control decision is a mask
+// operation; the one thing lanes cannot share is the address, so the lanes
+// are kept in groups by address, and a rising edge executes each group's
+// word once for all its lanes. Branch conditions are evaluated on the
+// input masks through a reduced decision diagram of each varSel's LUT
+// entries, one AND-OR per node, instead of 64 LUT lookups.
+//
+// Return stacks and timer counts are kept per lane, and only the words
+// that use them loop over their lanes. Each lane follows HotstateModel::clock
+// exactly, except that a lane that would make HotstateModel throw (an
+// address past the microcode, a stack overflow) stops there and is
+// reported by getFaultedLanes, and there is no interrupt input. PIPELINED
+// programs are not supported.
+class BitSlicedModel {
+public:
+    static constexpr uint32_t LANES = 64;
+    static constexpr uint64_t ALL_LANES = ~0ULL;
+
+    // Throws SimulatorException for a PIPELINED program
+    explicit BitSlicedModel(const MemoryLoader& memory);
+
+    // Every lane to the reset registers, as HotstateModel::reset; the
+    // inputs take their vardata initial values in all lanes
+    void reset();
+    void clock();  // One edge for every lane; a clock period is two calls
+
+    void setClock(bool clkVal) { clk = clkVal; }
+    void setReset(bool rstVal) { rst = rstVal; }
+    bool getClock() const { return clk; }
+
+    // Input i is 1 in the lanes of the mask and 0 in the others
+    void setInput(uint32_t input, uint64_t lanes);
+    uint64_t getInput(uint32_t input) const { return inputs[input]; }
+    uint32_t getNumInputs() const { return static_cast<uint32_t>(inputs.size()); }
+
+    // Lanes with the state set
+    uint64_t getState(uint32_t state) const { return states[state]; }
+    uint32_t getNumStates() const { return static_cast<uint32_t>(states.size()); }
+
+    // The lanes at each address, in no particular order; every running lane
+    // is in exactly one group
+    struct Group {
+        uint32_t address;
+        uint64_t lanes;
+    };
+    const std::vector<Group>& getGroups() const { return groups; }
+    uint32_t getAddress(uint32_t lane) const;  // UINT32_MAX for a stopped lane
+    uint64_t getLanesAt(uint32_t address) const;
+
+    // Stop lanes: they leave their groups and no edge runs them until a reset
+    void retire(uint64_t lanes);
+    uint64_t getRunningLanes() const { return running; }
+
+    // Lanes stopped where HotstateModel would throw, with its message
+    uint64_t getFaultedLanes() const { return faulted; }
+    const std::string& getFault(uint32_t lane) const { return faults[lane]; }
+
+    // Profiling, as HotstateModel's: lane edges per word and branch direction
+    void enableProfiling();
+    const std::vector<uint64_t>& getAddressHits() const { return addressHits; }
+    const std::vector<uint64_t>& getBranchTaken() const { return branchTaken; }
+    const std::vector<uint64_t>& getBranchNotTaken() const { return branchNotTaken; }
+
+    uint64_t getCycleCount() const { return cycleCount; }
+
+private:
+    // Decision diagram node: the lanes where node is true are
+    // (input var & hi) | (~input var & lo). Nodes 0 and 1 are the
+    // constants; a node's children always come before it.
+    struct DecisionNode {
+        uint32_t var;
+        uint32_t lo;
+        uint32_t hi;
+    };
+    static constexpr uint32_t FALSE_NODE = 0;
+    static constexpr uint32_t TRUE_NODE = 1;
+
+    const std::vector<uint32_t>& vardata;
+    const std::vector<uint32_t>& timdata;
+    const Parameters& params;
+    std::vector<DecodedMicrocode> decoded;
+    VardataImage lut;
+    uint32_t numVars;     // Inputs the LUT is indexed by, at most 64
+    uint32_t numTimers;
+    uint32_t stackDepth;
+
+    // Conditions: a root per varSel, built the first time a word uses it,
+    // and the nodes under each root in evaluation order
+    std::vector<DecisionNode> nodes;
+    std::map<std::tuple<uint32_t, uint32_t, uint32_t>, uint32_t> uniqueNodes;  // (var, lo, hi) to node
+    std::vector<uint32_t> roots;                     // UINT32_MAX until built
+    std::vector<std::vector<uint32_t>> rootOrder;
+    std::vector<uint64_t> nodeLanes;                 // Scratch for evaluate
+
+    // Registers
+    std::vector<uint64_t> states;       // One mask per state
+    std::vector<uint64_t> inputs;       // One mask per input
+    std::vector<Group> groups;
+    std::vector<uint64_t> nextLanes;    // Scratch: lanes bound for each address
+    std::vector<uint32_t> nextTargets;  // Scratch: addresses with nextLanes set
+    std::vector<uint32_t> stack;        // stackDepth per lane
+    std::array<uint32_t, LANES> stackPointer;
+    std::vector<uint32_t> timerCounts;  // numTimers per lane
+    uint64_t running;
+    uint64_t faulted;
+    std::array<std::string, LANES> faults;
+
+    bool clk;
+    bool rst;
+    uint64_t cycleCount;
+
+    bool profiling;
+    std::vector<uint64_t> addressHits;
+    std::vector<uint64_t> branchTaken;
+    std::vector<uint64_t> branchNotTaken;
+
+    uint32_t buildCondition(uint32_t varSel);
+    uint32_t buildNode(uint32_t varSel, uint32_t level, uint64_t offset);
+    uint64_t evaluate(uint32_t varSel, uint64_t lanes);
+    void executeGroup(const Group& group);
+    void fault(uint64_t lanes, const std::string& message);
+    void sendTo(uint32_t address, uint64_t lanes);
+};
+
+} // namespace HotstateSim
+
+#endif // BITSLICED_MODEL_H
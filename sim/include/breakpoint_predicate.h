@@ -0,0 +1,61 @@
+#ifndef BREAKPOINT_PREDICATE_H
+#define BREAKPOINT_PREDICATE_H
+
+#include "hotstate_model.h"
+#include "memory_loader.h"
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace HotstateSim {
+
+class PredicateCompiler;
+
+// A breakpoint condition or watch expression compiled once against the
+// loaded program, so checking it every cycle is a short loop over
+// bytecode with no names, parsing or allocation left:
+//
+//   expr  := and ('||' and)*
+//   and   := unary ('&&' unary)*
+//   unary := '!' unary | cmp
+//   cmp   := value [('==' | '!=' | '<' | '<=' | '>' | '>=') value]
+//          | value 'in' '[' NUM ',' NUM (')' | ']')
+//   value := NUM | 'addr' | 'state' '[' NUM ']' | 'input' '[' NUM ']'
+//          | 'state' NAME | 'input' NAME | NAME | '(' expr ')'
+//
+// e.g. "state[3] && input a2 == 1 && addr in [0x40,0x50)". A bare NAME is
+// a state variable, or an input when no state has that name. Numbers are
+// decimal or 0x hex; comparisons and logic give 0 or 1.
+class BreakpointPredicate {
+public:
+    // Throws SimulatorException on a syntax error, an unknown name or an
+    // index outside the model
+    BreakpointPredicate(const std::string& text, const MemoryLoader& memory, const HotstateModel& model);
+
+    uint32_t evaluate(const HotstateModel& model) const;
+    const std::string& getText() const { return text; }
+
+private:
+    friend class PredicateCompiler;
+
+    enum class Op : uint8_t {
+        PUSH, STATE, INPUT, ADDR,
+        EQ, NE, LT, LE, GT, GE,
+        AND, OR, NOT, IN_RANGE
+    };
+
+    struct Instruction {
+        Op op;
+        uint32_t a;  // Constant, state or input index, or range start
+        uint32_t b;  // Range end, exclusive
+    };
+
+    static constexpr size_t MAX_DEPTH = 32;
+
+    std::string text;
+    std::vector<Instruction> code;
+};
+
+} // namespace HotstateSim
+
+#endif // BREAKPOINT_PREDICATE_H
@@ -0,0 +1,68 @@
+#ifndef DEBUG_SCRIPT_H
+#define DEBUG_SCRIPT_H
+
+#include "simulator.h"
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace HotstateSim {
+
+// A debugger session written down (--script), for replaying a field
+// failure without typing it into the debugger. One command per line, #
+// starts a comment:
+//
+//   run                   run to a breakpoint or the end
+//   run-to CYCLE          run to a breakpoint or CYCLE (k, M, G suffixes)
+//   step [N]              run N cycles [1]
+//   back [N], goto CYCLE  go back N cycles, or back to CYCLE
+//   checkpoint            keep a checkpoint here for later back and goto
+//   break-if EXPR         break when EXPR holds (see BreakpointPredicate)
+//   break-on-change EXPR  break when the value of EXPR changes
+//   break-state N, break-addr HEX, break-clear
+//   set-input NAME|N VALUE
+//   dump [WHAT ...]       print state, vars, inputs, stack, signals,
+//                         microcode, memory or stats [state inputs]
+//   expect EXPR           fail the script unless EXPR holds
+//   echo TEXT, reset, load BASE, patch FILE, quit
+//
+// run, run-to and step go at full speed, as a run without -d does:
+// nothing is printed per cycle, and --fast-forward still skips idle
+// stretches. Each stop prints the cycle and why.
+class DebugScript {
+public:
+    // Throws SimulatorException for an unreadable file, an unknown command
+    // or a malformed argument, naming the line
+    static DebugScript load(const std::string& path);
+
+    // Run the commands on an initialized simulator. False at the first
+    // command that fails or expect that does not hold, with the reason on
+    // stderr; quit ends the script early with true.
+    bool run(Simulator& simulator) const;
+
+private:
+    enum class Op {
+        RUN, RUN_TO, STEP, BACK, GOTO, CHECKPOINT,
+        BREAK_IF, BREAK_ON_CHANGE, BREAK_STATE, BREAK_ADDR, BREAK_CLEAR,
+        SET_INPUT, DUMP, EXPECT, ECHO, RESET, LOAD, PATCH, QUIT
+    };
+
+    struct Command {
+        uint32_t line;
+        Op op;
+        uint64_t number;                 // Cycle, count, state, address or value
+        std::string text;                // Expression, name, path or echo text
+        std::vector<std::string> words;  // dump's list
+    };
+
+    std::string path;
+    std::vector<Command> commands;
+
+    static Command parse(const std::string& line);
+    bool execute(Simulator& simulator, const Command& command) const;
+    bool fail(const Command& command, const std::string& message) const;
+};
+
+} // namespace HotstateSim
+
+#endif // DEBUG_SCRIPT_H
@@ -0,0 +1,67 @@
+#ifndef EXHAUSTIVE_RUNNER_H
+#define EXHAUSTIVE_RUNNER_H
+
+#include "simulator.h"
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace HotstateSim {
+
+// A sequence that stopped early: the cycle a single run of it would stop
+// at, and why
+struct SequenceFailure {
+    uint64_t sequence;
+    uint32_t cycle;
+    std::string reason;
+};
+
+// Every input sequence of a few clock periods (--exhaustive K): after
+// reset, each of the K periods applies one of the 2^NUM_VARS input
+// vectors, so there are 2^(NUM_VARS * K) sequences. Sequence s gives input
+// i in period p the value of bit p * NUM_VARS + i of s. The sequences run
+// 64 at a time in a BitSlicedModel, so the low six bits of s are the lanes
+// of a block and the rest pick the block; blocks go to --jobs threads.
+//
+// As with --random-runs, a sequence fails at the first cycle its lane
+// runs past the microcode, overflows the return stack, or meets a
+// --breakpoint-state or --breakpoint-addr, and the coverage of all of them
+// is merged for the summary and --profile.
+class ExhaustiveRunner {
+public:
+    static constexpr uint32_t MAX_SEQUENCE_BITS = 40;
+
+    ExhaustiveRunner(const SimulatorConfig& cfg, uint32_t periods);
+
+    bool initialize();
+    bool run();   // False if any sequence failed
+
+    const std::vector<SequenceFailure>& getFailures() const { return failures; }
+    const std::string& getLastError() const { return lastError; }
+    void printSummary() const;
+    bool writeProfile(const std::string& filename) const;  // As Simulator::writeProfile
+
+private:
+    SimulatorConfig config;
+    uint32_t periods;
+    uint32_t jobs;
+    std::string lastError;
+
+    MemoryLoader memoryLoader;
+    uint32_t numInputs;
+    uint32_t sequenceBits;    // numInputs * periods
+    uint64_t blockCount;
+    std::vector<DecodedMicrocode> decoded;  // For the summary's branch count
+
+    std::vector<SequenceFailure> failures;  // By sequence
+    std::vector<uint64_t> hits;
+    std::vector<uint64_t> taken;
+    std::vector<uint64_t> notTaken;
+    double elapsed;
+
+    std::string describe(uint64_t sequence) const;  // The input vector of each period
+};
+
+} // namespace HotstateSim
+
+#endif // EXHAUSTIVE_RUNNER_H
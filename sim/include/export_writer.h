@@ -0,0 +1,64 @@
+#ifndef EXPORT_WRITER_H
+#define EXPORT_WRITER_H
+
+#include "output_logger.h"
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace HotstateSim {
+
+// Writes an --export file (csv, json or trace) one entry at a time, so a
+// run can be exported while it is logged instead of from the trace window
+// afterwards. Memory is bounded by the format buffer: CSV and JSON rows are
+// formatted by hand into it and written out whenever it fills. The CSV
+// header and the trace signals take their widths from the first entry.
+class ExportWriter {
+public:
+    static constexpr size_t BUFFER_SIZE = 1 << 20;
+
+private:
+    OutputFormat format;
+    std::string filename;
+    std::ofstream file;
+    std::vector<char> fileBuffer;            // The stream's buffer, for trace output
+    std::unique_ptr<TraceWriter> traceWriter;
+    std::vector<char> text;                  // Formatted CSV or JSON not yet written
+    uint64_t entries;
+
+    void put(const char* literal);
+    void put(char c) { text.push_back(c); }
+    void putDecimal(uint32_t value);
+    void putHex(uint32_t value);
+    void putBool(bool value, const char* yes, const char* no) { put(value ? yes : no); }
+
+    void writeCSVHeader(const LogRecord& rec);
+    void appendCSV(const LogView& entry);
+    void appendJSON(const LogView& entry);
+    void writeText();
+
+public:
+    ExportWriter();
+    ~ExportWriter();  // Finishes the file if finish() was not called
+    ExportWriter(const ExportWriter&) = delete;
+    ExportWriter& operator=(const ExportWriter&) = delete;
+
+    // Fails, with a message on stderr, for a file that cannot be created
+    // or a format other than csv, json and trace
+    bool open(const std::string& exportFilename, OutputFormat exportFormat);
+    bool isOpen() const { return file.is_open(); }
+
+    void append(const LogView& entry);
+    void restart();  // Cycles start over (trace blocks leave the index)
+    // Closes the JSON array or writes the trace footer, then the file;
+    // false if any write failed
+    bool finish();
+
+    const std::string& getFilename() const { return filename; }
+    uint64_t getEntryCount() const { return entries; }
+};
+
+} // namespace HotstateSim
+
+#endif // EXPORT_WRITER_H
@@ -2,27 +2,143 @@
 #define HOTSTATE_MODEL_H
 
 #include "memory_loader.h"
+#include "utils.h"
 #include <vector>
+#include <array>
+#include <functional>
+#include <utility>
 #include <cstdint>
 
 namespace HotstateSim {
 
+// One smdata word with every field already extracted. The whole microcode
+// memory is decoded once when the model is built, so a clock is a table
+// lookup instead of a bit-by-bit parse of the word.
+struct DecodedMicrocode {
+    StateBits stateValue;
+    StateBits transitionValue;
+    uint64_t captureValue;   // Word 0 of stateValue & transitionValue
+    uint64_t captureMask;    // Word 0 of transitionValue
+    uint32_t jadr;
+    uint32_t varSel;
+    uint32_t timerSel;
+    uint32_t timerLd;
+    uint32_t switchSel;
+    uint32_t switchAdr;
+    bool stateCapture;
+    bool varOrTimer;
+    bool branch;
+    bool forcedJmp;
+    bool sub;
+    bool rtn;
+};
+
+// What one rising edge did to the timer bank (IP/timer.sv)
+struct TimerEdge {
+    bool done = false;              // A selected, not loading timer was at zero (timer_done)
+    bool reloaded = false;          // A load changed a count
+    uint32_t countdown = UINT32_MAX; // Smallest count a decrement left; UINT32_MAX if none counted
+};
+
+// The Uber LUT of IP/variable.sv, one bit per entry. A branch word reads
+// entry {varSel, inputs}: varSel << NUM_VARS with the inputs packed below
+// it, bit i for input i. Entries past the vardata image read 0.
+class VardataImage {
+public:
+    VardataImage() = default;
+    VardataImage(const std::vector<uint32_t>& vardata, uint32_t numVars);
+
+    bool lookup(uint32_t varSel, uint64_t inputs) const {
+        uint64_t entry = (static_cast<uint64_t>(varSel) << numVars) | inputs;
+        return entry < entries && ((bits[entry >> 6] >> (entry & 63)) & 1);
+    }
+
+    // Packed inputs that give varSel's lhs value, or -1 if none does
+    int64_t witness(uint32_t varSel, bool value) const;
+    bool isConstant(uint32_t varSel) const { return witness(varSel, false) < 0 || witness(varSel, true) < 0; }
+
+    uint64_t size() const { return entries; }
+    uint32_t getNumVars() const { return numVars; }
+    const std::vector<uint64_t>& getWords() const { return bits; }
+
+    // The inputs of a variables vector, packed bit i for input i
+    static uint64_t packInputs(const std::vector<uint8_t>& variables);
+
+private:
+    std::vector<uint64_t> bits;
+    uint64_t entries = 0;
+    uint32_t numVars = 0;
+};
+
+// A state change event: the edge count the change happened at (as
+// getCycleCount), the state register after it, which is also the outputs,
+// and the bits that changed since the subscriber was last called, packed
+// as in StateBits
+using StateChangeCallback = std::function<void(uint64_t cycle, const StateBits& states,
+                                               const std::vector<uint64_t>& changed)>;
+
+// Switching activity of one register bit: the rising edges it toggled on
+// and the edges it spent high, for power estimation (--activity)
+struct BitActivity {
+    uint64_t toggles = 0;
+    uint64_t highEdges = 0;
+    uint64_t since = 0;  // Edge of the last change; highEdges is closed there
+};
+
+// Every register a clock can change, so restoring a snapshot into a model
+// of the same program resumes it exactly where the snapshot was taken.
+// The single-bit registers are packed into flags.
+struct HotstateSnapshot {
+    StateBits states;
+    std::vector<uint8_t> variables;
+    std::vector<uint32_t> timerCounts;
+    uint64_t cycleCount = 0;
+    uint32_t address = 0;
+    uint32_t fetchAddress = 0;
+    uint32_t returnAddress = 0;
+    std::vector<uint32_t> stack;
+    uint32_t stackPointer = 0;
+    uint32_t fields[6] = {};  // jadr, varSel, timerSel, timerLd, switchSel, switchAdr
+    uint32_t settledEdges = 0;
+    uint32_t flags = 0;
+};
+
 class HotstateModel {
 private:
+    // Threaded code: every smdata word gets a handler specialized on its
+    // control bits when the program is decoded, so a rising edge is one
+    // indirect call with no per-field dispatch. Handlers are also specialized
+    // on the state register size: registers of up to 64 states (any program
+    // whose smdata fits a 64-bit word) capture a single word with
+    // compile-time indexing, and wider ones take the generic word loop.
+    using EdgeHandler = void (HotstateModel::*)(const DecodedMicrocode&);
+    static constexpr size_t EDGE_KINDS = 64;  // stateCapture, branch, forcedJmp, sub, rtn, one word
+    
     // Memory references
     const std::vector<uint32_t>& vardata;
     const std::vector<uint32_t>& switchdata;
+    const std::vector<uint32_t>& timdata;
     const std::vector<uint64_t>& smdata;
     const Parameters& params;
+    std::vector<DecodedMicrocode> decoded;  // smdata, predecoded
+    std::vector<EdgeHandler> handlers;      // Per address, parallel to decoded
+    VardataImage lut;                       // vardata, bit-packed
     
     // State registers
-    std::vector<bool> states;
+    StateBits states;
     std::vector<uint8_t> variables;
+    uint64_t inputBits;  // variables packed for the LUT; setInputs keeps it in step
     uint32_t address;
     uint32_t returnAddress;
-    uint32_t stack[16];  // Simple stack implementation
+    std::vector<uint32_t> stack;  // Parameters::STACK_DEPTH entries; a call with all in use throws
     uint32_t stackPointer;
     
+    // Timers: one count per timer, reloaded from timdata[jadr] by timerLd
+    // and decremented on every edge that selects them. A countdown is not
+    // ticked while nothing else changes; see settledCycles.
+    std::vector<uint32_t> timerCounts;
+    bool timerDone;
+    
     // Control signals
     bool ready;
     bool lhs;
@@ -36,6 +152,22 @@ private:
     bool fired;
     bool varOrTimer;
     
+    // Interrupt (IP/control.sv): the input, its registered copy interrupt_r,
+    // and fired, set on the edge that sees the input rise. The edge after
+    // that jumps to interruptAddress and pushes the word's address plus one.
+    bool interrupt;
+    bool interruptR;
+    bool interruptFired;
+    uint32_t interruptAddress;  // The interrupt_address input; Parameters::INTERRUPT_ADDRESS by default
+    
+    // Parameters::PIPELINED (next_address.sv, microcode.sv): address is the
+    // word in the registered read and fetchAddress the one read into it, so
+    // the word after a jump runs before the target. Out of reset the
+    // register is empty (bubble) and the first edge only fetches.
+    bool pipelined;
+    bool bubble;
+    uint32_t fetchAddress;
+    
     // Microcode fields
     uint32_t jadr;
     uint32_t varSel;
@@ -43,8 +175,6 @@ private:
     uint32_t timerLd;
     uint32_t switchSel;
     uint32_t switchAdr;
-    std::vector<bool> stateValue;
-    std::vector<bool> transitionValue;
     
     // Timing and control
     bool clk;
@@ -52,34 +182,163 @@ private:
     bool hlt;
     uint64_t cycleCount;
     
+    // Idle detection, updated on every rising edge
+    bool settled;         // The last edge left every register unchanged
+    bool lastEdgeReset;   // The last edge was a reset
+    uint32_t settledEdges; // Edges that repeat the last one; UINT32_MAX without a countdown
+    
+    // Profiling: rising edges that executed each address, and which way
+    // each branch word went. Kept across resets and checkpoint restores.
+    bool profiling;
+    std::vector<uint64_t> addressHits;
+    std::vector<uint64_t> branchTaken;
+    std::vector<uint64_t> branchNotTaken;
+    
+    // Switching activity of the state register and of the microcode word at
+    // address (the RTL's microcode_bits), as they were after the last edge.
+    // Edges count from enableActivity on, across resets and checkpoint
+    // restores; a restore moves the baseline without counting toggles.
+    bool activity;
+    uint64_t activityEdges;
+    std::vector<uint64_t> activityStates;
+    std::vector<uint64_t> activityWord;
+    std::vector<uint64_t> emptyWord;  // The pipeline's flushed word
+    std::vector<BitActivity> stateActivity;
+    std::vector<BitActivity> wordActivity;
+    
+    // State change subscribers, and the register as they were last told it
+    std::vector<std::pair<uint32_t, StateChangeCallback>> stateSubscribers;
+    uint32_t nextSubscriberId = 1;
+    std::vector<uint64_t> reportedStates;
+    std::vector<uint64_t> changedStates;
+    
     // Helper methods
-    void executeMicrocode();
-    void updateStates();
-    void handleControlLogic();
+    template <bool Capture, bool Branch, bool ForcedJmp, bool Sub, bool Rtn, bool OneWord>
+    void executeEdge(const DecodedMicrocode& mc);
+    template <size_t... Kinds>
+    static std::array<EdgeHandler, sizeof...(Kinds)> makeHandlerTable(std::index_sequence<Kinds...>);
+    static EdgeHandler selectHandler(const DecodedMicrocode& mc, bool oneWord);
     void handleSwitch();
-    void handleVariables();
-    void handleNextAddress();
-    void extractMicrocodeFields(uint64_t microcode);
+    void predecodeMicrocode();
+    static DecodedMicrocode decodeMicrocodeWord(const uint64_t* microcode, uint32_t words,
+                                                const Parameters& params);
     uint32_t calculateSwitchAddress();
+    void skipTimers(uint64_t edges);
+    void recordProfile(uint32_t pc, uint64_t edges);
+    void runWatchedEdge(uint32_t pc, uint64_t edge);
+    void recordActivity(bool counted);
+    void accumulateActivity(const uint64_t* now, std::vector<uint64_t>& last,
+                            std::vector<BitActivity>& bits, bool counted);
+    void notifyStateChange();
+    
+    // The registers HotstateSnapshot packs, in flags bit and fields order
+    static bool HotstateModel::* const SNAPSHOT_FLAGS[];
+    static uint32_t HotstateModel::* const SNAPSHOT_FIELDS[];
     
 public:
     HotstateModel(const MemoryLoader& memory);
     
+    // Decode a whole smdata image of params.SMDATA_WORDS uint64s per entry;
+    // shared by models and the batch engine
+    static std::vector<DecodedMicrocode> decodeProgram(const std::vector<uint64_t>& smdata,
+                                                       const Parameters& params);
+    
+    // Timer bank of IP/timer.sv: the number of timers, the value a load at
+    // jadr gives, and one rising edge for the word mc; shared by models,
+    // the batch engine and the model generator
+    static uint32_t timerCount(const Parameters& params);
+    static uint32_t timerLoadValue(uint32_t jadr, const std::vector<uint32_t>& timdata, const Parameters& params);
+    static TimerEdge clockTimers(const DecodedMicrocode& mc, uint32_t* counts, uint32_t numTimers,
+                                 const std::vector<uint32_t>& timdata, const Parameters& params);
+    
     // Reset and clock
     void reset();
-    void clock();
+    void clock();  // One edge; a clock period is two calls, and cycleCount counts both
+    
+    // Whole clock periods, each the same as two clock() calls from the
+    // clock low. Halt and reset are read once for the whole run, so they
+    // must not change during it; the edges themselves are a tight loop of
+    // word handlers with no per-edge halt, reset or phase checks.
+    void tick() { run(1); }
+    void run(uint64_t periods);  // Throws SimulatorException with the clock high
+    
+    // After a settled rising edge, the registers are a fixed point: with the
+    // inputs held, every later clock repeats the one before it. skipCycles
+    // then advances an even number of clocks without executing them. A
+    // timer counting down also settles the model: the edges repeat, minus
+    // the count, until it reaches zero, and skipCycles takes them in one step.
+    bool isSettled() const { return settled; }
+    uint64_t settledCycles() const;  // Cycles skipCycles may advance; UINT64_MAX when unbounded
+    void skipCycles(uint64_t count);
+    
+    // Periodic runs: a hash of every register a snapshot holds except the
+    // cycle count, so two edges with equal registers hash the same. Once the
+    // registers after a rising edge repeat with the inputs held, every edge
+    // in between repeats too; repeatCycles then advances count cycles, a
+    // whole number of such periods, without executing them. Only the cycle
+    // count moves: profile and activity counts are not advanced, and state
+    // change subscribers are not called for the skipped edges.
+    uint64_t registerHash() const;
+    void repeatCycles(uint64_t count);
+    
+    // Profiling; off until enabled, and then one counter update per edge
+    void enableProfiling();
+    bool isProfiling() const { return profiling; }
+    const std::vector<uint64_t>& getAddressHits() const { return addressHits; }
+    const std::vector<uint64_t>& getBranchTaken() const { return branchTaken; }
+    const std::vector<uint64_t>& getBranchNotTaken() const { return branchNotTaken; }
+    // Adds another run's counts of the same program, as --coordinator
+    // merges its workers'; throws SimulatorException for another size
+    void addProfileCounts(const std::vector<uint64_t>& hits, const std::vector<uint64_t>& taken,
+                          const std::vector<uint64_t>& notTaken);
+    
+    // Switching activity; off until enabled, and then one compare of the
+    // packed state and microcode words per edge, with per-bit work only for
+    // the bits that toggled. The counts index state and microcode_bits bits.
+    void enableActivity();
+    bool isCountingActivity() const { return activity; }
+    uint64_t getActivityEdges() const { return activityEdges; }
+    std::vector<BitActivity> getStateActivity() const;
+    std::vector<BitActivity> getWordActivity() const;
+    
+    // State change events, instead of comparing getStates() every cycle: a
+    // subscriber is called after each edge, reset or snapshot restore that
+    // changes the state register, and an edge that changes nothing costs
+    // nothing extra. An exception from a subscriber leaves clock() or
+    // run() as a microcode fault does, after the edge. Subscribers must not
+    // subscribe or unsubscribe from the callback.
+    uint32_t subscribeStates(StateChangeCallback callback);  // Returns the id for unsubscribeStates
+    void unsubscribeStates(uint32_t id);
+    
+    // Checkpoints
+    HotstateSnapshot saveSnapshot() const;
+    void restoreSnapshot(const HotstateSnapshot& snapshot);
     
     // Input/Output
     void setInputs(const std::vector<uint8_t>& inputs);
+    const std::vector<uint8_t>& getInputs() const { return variables; }
+    uint64_t getInputBits() const { return inputBits; }
+    const VardataImage& getVardataImage() const { return lut; }
     std::vector<uint8_t> getOutputs() const;
-    std::vector<bool> getStates() const { return states; }
+    uint32_t getNumOutputs() const { return states.size(); }
+    void copyOutputs(uint8_t* dest) const;  // getNumOutputs() bytes, without allocating
+    const StateBits& getStates() const { return states; }
     uint32_t getCurrentAddress() const { return address; }
+    bool isPipelined() const { return pipelined; }
+    uint32_t getStackDepth() const { return static_cast<uint32_t>(stack.size()); }
+    const std::vector<DecodedMicrocode>& getDecodedMicrocode() const { return decoded; }
     bool isReady() const { return ready; }
     
     // Control
     void setClock(bool clkVal) { clk = clkVal; }
     void setReset(bool rstVal) { rst = rstVal; }
     void setHalt(bool hltVal) { hlt = hltVal; }
+    void setInterrupt(bool level) { interrupt = level; }
+    void setInterruptAddress(uint32_t adr) { interruptAddress = adr; }
+    bool getClock() const { return clk; }
+    bool getInterrupt() const { return interrupt; }
+    bool getInterruptFired() const { return interruptFired; }
+    uint32_t getInterruptAddress() const { return interruptAddress; }
     
     // Status
     uint64_t getCycleCount() const { return cycleCount; }
@@ -93,6 +352,8 @@ public:
     bool getSwitchActive() const { return switchActive; }
     bool getFired() const { return fired; }
     bool getVarOrTimer() const { return varOrTimer; }
+    bool getTimerDone() const { return timerDone; }
+    const std::vector<uint32_t>& getTimerCounts() const { return timerCounts; }
     
     // Debug
     void printState() const;
@@ -0,0 +1,72 @@
+#ifndef HOTSTATE_PLANT_H
+#define HOTSTATE_PLANT_H
+
+/*
+ * Plant plugin interface for closed-loop runs (hotstate_sim --plant).
+ *
+ * A plant is a shared object that models what the program controls
+ * (motors, valves, sensors) and drives all of the program's inputs in
+ * place of a stimulus file. It exports hotstate_plant_create, which fills
+ * in a hotstate_plant. The simulator calls update whenever the states
+ * (the program's outputs) have changed, and at the wake cycle the plant
+ * last asked for. Between those calls the inputs hold, so --fast-forward
+ * can skip idle stretches up to the next wake cycle.
+ *
+ * This header is plain C so that plants can be built with any compiler
+ * and without the simulator's headers.
+ */
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HOTSTATE_PLANT_ABI_VERSION 2u
+
+/* Returned by reset and update: no wake cycle, call again on a change only */
+#define HOTSTATE_PLANT_NO_WAKE 0xFFFFFFFFFFFFFFFFull
+/* Returned by update: stop the run as failed, with the message from last_error */
+#define HOTSTATE_PLANT_ERROR 0xFFFFFFFFFFFFFFFEull
+
+/* The program the plant is attached to. Valid for the life of the plant. */
+typedef struct hotstate_plant_info {
+    uint32_t num_inputs;
+    uint32_t num_states;
+    const char* const* input_names;  /* num_inputs names, "" when unnamed */
+    const char* const* state_names;  /* num_states names, "" when unnamed */
+    const char* args;                /* --plant-args, "" when not given */
+} hotstate_plant_info;
+
+typedef struct hotstate_plant {
+    uint32_t abi_version;  /* HOTSTATE_PLANT_ABI_VERSION */
+    void* context;
+
+    /* Start of the run, and again on every reset or program swap: write the
+     * num_inputs inputs of cycle 0 (each 0 or 1) and return the first wake
+     * cycle. */
+    uint64_t (*reset)(void* context, uint8_t* inputs);
+
+    /* Before cycle is simulated, when the states changed on the cycles
+     * before it or cycle is the wake cycle or later. states holds
+     * (num_states + 63) / 64 words, state i in bit i % 64 of word i / 64.
+     * Rewrite the inputs for cycle onwards and return the next wake cycle,
+     * HOTSTATE_PLANT_NO_WAKE or HOTSTATE_PLANT_ERROR. */
+    uint64_t (*update)(void* context, uint64_t cycle, const uint64_t* states, uint8_t* inputs);
+
+    /* Message for HOTSTATE_PLANT_ERROR; may be NULL */
+    const char* (*last_error)(void* context);
+
+    void (*destroy)(void* context);
+} hotstate_plant;
+
+/* Exported by the plugin: fill in plant for info and return 0, or nonzero
+ * if the plant cannot run (bad args, unsupported program). */
+typedef int (*hotstate_plant_create_fn)(const hotstate_plant_info* info, hotstate_plant* plant);
+int hotstate_plant_create(const hotstate_plant_info* info, hotstate_plant* plant);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HOTSTATE_PLANT_H */
@@ -2,10 +2,12 @@
 #define MEMORY_LOADER_H
 
 #include <string>
+#include <istream>
 #include <vector>
-#include <map>
 #include <cstdint>
 
+struct HotstateOptions;  // libhotstate's, from hotstate.h
+
 namespace HotstateSim {
 
 // Structure to hold parameters from .vh files
@@ -43,40 +45,129 @@ struct Parameters {
     uint32_t NUM_CTL_BITS = 0;
     uint32_t SMDATA_WIDTH = 0;
     uint32_t STACK_DEPTH = 0;
+    uint32_t SMDATA_WORDS = 0;  // uint64 words per smdata entry, from the widest .mem line
+    uint32_t VARDATA_WORD_BITS = 0;  // LUT entries per vardata .mem word (--vardata-bits); 0 is one per line
+    uint32_t INTERRUPT_ADDRESS = 0;  // The first interrupt handler; 0 when the program has none
+    uint32_t PIPELINED = 0;  // Compiled with delay slots (c_parser --pipeline) for the registered fetch
     
     bool isValid() const;
     void print() const;
 };
 
+// Binary memory image written by the compiler next to the .mem files
+// (BASE_image.bin). Little-endian: MAGIC, uint32 version, uint32 parameter
+// count, uint32 offset and count of the vardata, switchdata and smdata
+// sections, the parameters as uint32 in Parameters field order, then the
+// 8-byte aligned sections (vardata and switchdata uint32, smdata uint64).
+// Entries wider than 64 bits take SMDATA_WORDS consecutive uint64s, least
+// significant first; the smdata count is in uint64s. Timer memory is not
+// part of the image and is always read from BASE_timdata.mem.
+struct MemoryImageHeader {
+    static constexpr char MAGIC[9] = "HSIMAGE1";
+    static constexpr uint32_t VERSION = 1;
+    static constexpr size_t SIZE = 40;
+};
+
+// Names of one kind of symbol: a dense vector of names indexed by ID, and
+// an open-addressing table from name to ID for the per-cycle lookups of
+// named stimulus and debugger commands. A name added again moves to the
+// new ID, and an ID named again takes the new name, as with std::map.
+class SymbolTable {
+public:
+    void add(const std::string& name, uint32_t index);
+    uint32_t find(const std::string& name) const;  // UINT32_MAX if not a symbol
+    const std::string& nameAt(uint32_t index) const;  // Empty if unnamed
+    size_t size() const { return entries.size(); }
+    uint32_t idCount() const { return static_cast<uint32_t>(names.size()); }  // One past the highest ID
+    bool empty() const { return entries.empty(); }
+
+private:
+    struct Entry {
+        std::string name;
+        uint32_t index;
+    };
+    uint32_t findSlot(const std::string& name) const;  // The name's slot, or the empty one it belongs in
+    void grow();
+
+    std::vector<std::string> names;  // By ID
+    std::vector<Entry> entries;      // In the order added
+    std::vector<uint32_t> slots;     // Entry index + 1, or 0 for empty; a power of two
+};
+
 class MemoryLoader {
 private:
     std::vector<uint32_t> vardata;
     std::vector<uint32_t> switchdata;
+    std::vector<uint32_t> timdata;
     std::vector<uint64_t> smdata;
     Parameters params;
     bool loaded = false;
 
     // Symbol table data
-    std::map<std::string, uint32_t> inputNameToIndex;
-    std::map<std::string, uint32_t> stateNameToIndex;
-    std::map<uint32_t, std::string> inputIndexToName;
-    std::map<uint32_t, std::string> stateIndexToName;
+    SymbolTable inputSymbols;
+    SymbolTable stateSymbols;
+    
+    // Source text of each smdata word, from the compiler's debug labels;
+    // only a program compiled in-process has them
+    std::vector<std::string> sourceLabels;
     
     // Helper methods
-    bool loadMemoryFile(const std::string& filename, std::vector<uint32_t>& data);
-    bool loadSmdataFile(const std::string& filename, std::vector<uint64_t>& data);
+    // hex: every value is hex, as $readmemh reads it, even when all digits
+    bool loadMemoryFile(const std::string& filename, std::vector<uint32_t>& data, bool hex = false);
+    bool loadSmdataFile(const std::string& filename, std::vector<uint64_t>& data, uint32_t& words);
     bool parseParameterFile(const std::string& filename);
     std::string extractParameterValue(const std::string& line);
+    void deriveParameters();
+    void unpackVardata();
+    bool parseSymbolTableTOML(std::istream& file, const std::string& name);
+
+    static std::string imageCacheDir;
+    static bool programCacheKey(const std::string& basePath, const std::string& sourceFile, uint64_t& key);
+    bool loadCachedProgram(const std::string& path);
+    void storeCachedProgram(const std::string& path) const;
     
 public:
     MemoryLoader() = default;
     
-    // Load memory files from a base path
+    // Load memory files from a base path; BASE_image.bin is used in place
+    // of the .mem and .vh files when present
     bool loadFromBasePath(const std::string& basePath);
-    
+    bool loadImage(const std::string& filename);
+
+    // Compile a C source in-process with libhotstate and load the result
+    // from memory, with no files written or read back (--from-source).
+    // options are the compiler's; nullptr for the c_parser defaults.
+    bool loadFromSource(const std::string& sourceFile, const HotstateOptions* options = nullptr);
+
+    // loadFromSource when sourceFile is set, loadFromBasePath otherwise,
+    // through the image cache when one is set
+    bool loadProgram(const std::string& basePath, const std::string& sourceFile);
+
+    // Image cache (--image-cache DIR), for every loadProgram of the process.
+    // A loaded program is saved to DIR under a hash of the files it was
+    // read from (or the preprocessed source it was compiled from) and the
+    // simulator binary, and later loads of the same files, in this process
+    // or any other, copy it back from one mapping instead of parsing the
+    // .mem files or compiling. Entries are only read by the binary that
+    // wrote them, and stale ones are never removed. "" turns it off.
+    static void setImageCache(const std::string& dir);
+
+    // A memory image or TOML symbol table already in memory; name is only
+    // used in messages
+    bool loadImageData(const uint8_t* data, size_t size, const std::string& name);
+    bool loadSymbolTableTOMLText(const std::string& text, const std::string& name);
+
+    // Write a c_parser --diff-against patch (BASE_patch.txt) over the loaded
+    // memories: each "memory @address values" line replaces a run of words,
+    // growing the memory if it ends past it. The parameters are kept, so the
+    // patch must be against a build with the same _params.vh. On an error
+    // the memories are left partly patched.
+    bool applyPatch(const std::string& filename);
+
     // Individual file loading methods
     bool loadVardata(const std::string& filename);
     bool loadSwitchdata(const std::string& filename);
+    bool loadTimdata(const std::string& filename);
     bool loadSmdata(const std::string& filename);
     bool loadParams(const std::string& filename);
     bool loadSymbolTable(const std::string& filename);
@@ -88,21 +179,35 @@ public:
     // Access methods
     const std::vector<uint32_t>& getVardata() const { return vardata; }
     const std::vector<uint32_t>& getSwitchdata() const { return switchdata; }
+    // Timer reload values (IP/timer.sv timer_mem), indexed by jadr; empty without timers
+    const std::vector<uint32_t>& getTimdata() const { return timdata; }
+    // smdata holds getSmdataWords() uint64s per entry, least significant first
     const std::vector<uint64_t>& getSmdata() const { return smdata; }
+    uint32_t getSmdataWords() const { return params.SMDATA_WORDS > 0 ? params.SMDATA_WORDS : 1; }
+    const uint64_t* getSmdataEntry(size_t index) const { return smdata.data() + index * getSmdataWords(); }
     const Parameters& getParams() const { return params; }
 
     // Symbol table access methods (supports TOML format)
-    bool hasSymbolTable() const { return !inputNameToIndex.empty() || !stateNameToIndex.empty(); }
+    bool hasSymbolTable() const { return !inputSymbols.empty() || !stateSymbols.empty(); }
     uint32_t getInputIndexByName(const std::string& name) const;
     uint32_t getStateIndexByName(const std::string& name) const;
     const std::string& getInputNameByIndex(uint32_t index) const;
     const std::string& getStateNameByIndex(uint32_t index) const;
+    const SymbolTable& getInputSymbols() const { return inputSymbols; }
+    
+    // Empty unless loaded with loadFromSource
+    const std::vector<std::string>& getSourceLabels() const { return sourceLabels; }
+    
+    // Hash of the parameters and memories, to check that two processes
+    // loaded the same program
+    uint64_t fingerprint() const;
     
     // Status
     bool isLoaded() const { return loaded; }
     size_t getVardataSize() const { return vardata.size(); }
     size_t getSwitchdataSize() const { return switchdata.size(); }
-    size_t getSmdataSize() const { return smdata.size(); }
+    size_t getTimdataSize() const { return timdata.size(); }
+    size_t getSmdataSize() const { return smdata.size() / getSmdataWords(); }
     
     // Debug
     void printMemoryInfo() const;
@@ -0,0 +1,45 @@
+#ifndef MODEL_GENERATOR_H
+#define MODEL_GENERATOR_H
+
+#include "memory_loader.h"
+#include "hotstate_model.h"
+#include <string>
+#include <vector>
+#include <ostream>
+
+namespace HotstateSim {
+
+// Emits a standalone C++ header that runs one compiled program (--emit-cpp).
+// Microcode words become cases of a switch on the address with their fields
+// folded into constants, the state masks are compile-time literals, and the
+// model clocks exactly like HotstateModel, so a host compiler can optimize
+// the whole design and software-in-the-loop tests can link it directly.
+class ModelGenerator {
+private:
+    const MemoryLoader& memory;
+    std::vector<DecodedMicrocode> decoded;
+    std::string className;
+    uint32_t stateWords;
+    uint32_t numTimers;
+    VardataImage lut;
+    bool readsLut;  // Some word's lhs depends on the inputs, so the model carries the LUT
+
+    void writeHeader(std::ostream& os, const std::string& guard) const;
+    void writeReset(std::ostream& os) const;
+    void writeClock(std::ostream& os) const;
+    void writeLookup(std::ostream& os) const;
+    void writeWord(std::ostream& os, uint32_t address) const;
+
+public:
+    ModelGenerator(const MemoryLoader& memory, const std::string& className);
+
+    void generate(std::ostream& os) const;
+    void generateFile(const std::string& filename) const;  // Throws SimulatorException
+
+    // "build/test_all_loops_model.h" -> "TestAllLoopsModel"
+    static std::string classNameFor(const std::string& filename);
+};
+
+} // namespace HotstateSim
+
+#endif // MODEL_GENERATOR_H
@@ -3,6 +3,7 @@
 
 #include "hotstate_model.h"
 #include "stimulus_parser.h"
+#include <deque>
 #include <string>
 #include <vector>
 #include <fstream>
@@ -10,17 +11,22 @@
 
 namespace HotstateSim {
 
+class AsyncTraceWriter;
+class ExportWriter;
+class TraceWriter;
+
 enum class OutputFormat {
     CONSOLE,
     VCD,
     CSV,
-    JSON
+    JSON,
+    TRACE   // Compressed columnar, see trace_format.h
 };
 
 struct LogEntry {
-    uint32_t cycle;
+    uint64_t cycle;
     uint32_t address;
-    std::vector<bool> states;
+    StateBits states;
     std::vector<uint8_t> outputs;
     std::vector<uint8_t> inputs;
     bool ready;
@@ -32,34 +38,139 @@ struct LogEntry {
     LogEntry() : cycle(0), address(0), ready(false), lhs(false), fired(false), jmpadr(false), switchActive(false) {}
 };
 
+// Fixed-size part of one logged cycle; the variable-width fields live in
+// the owning LogRing's per-slot arrays
+struct LogRecord {
+    uint64_t cycle;
+    uint32_t address;
+    uint32_t numStates;
+    uint32_t numOutputs;
+    uint32_t numInputs;
+    bool ready;
+    bool lhs;
+    bool fired;
+    bool jmpadr;
+    bool switchActive;
+};
+
+// One buffered entry in place: the record plus its slices of the slot arrays
+struct LogView {
+    const LogRecord& record;
+    const uint64_t* states;
+    const uint8_t* outputs;
+    const uint8_t* inputs;
+    
+    bool state(uint32_t i) const { return (states[i >> 6] >> (i & 63)) & 1ULL; }
+};
+
+// A slot handed out by LogRing::append for the caller to fill
+struct LogSlot {
+    LogRecord& record;
+    uint64_t* states;
+    uint8_t* outputs;
+    uint8_t* inputs;
+};
+
+// Circular buffer of the most recent logged cycles. Every slot has the same
+// stride for state words, outputs and inputs, so once the buffer is full a
+// push overwrites the oldest slot in place. Capacity 0 keeps every entry.
+class LogRing {
+private:
+    uint32_t capacity = 0;
+    size_t head = 0;           // Slot of the oldest entry
+    size_t count = 0;
+    size_t stateStride = 0;    // uint64_t words per slot
+    size_t outputStride = 0;
+    size_t inputStride = 0;
+    std::vector<LogRecord> records;
+    std::vector<uint64_t> stateWords;
+    std::vector<uint8_t> outputBytes;
+    std::vector<uint8_t> inputBytes;
+    
+    size_t slot(size_t index) const { return (head + index) % records.size(); }
+    // Copy the newest entries into slots [0, count) of a new layout
+    void relayout(size_t slots, size_t states, size_t outputs, size_t inputs);
+    
+public:
+    void setCapacity(uint32_t entries);  // Keeps the newest entries that fit
+    void clear();
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    
+    // Claim the slot for a new newest entry, zeroed and wide enough for the
+    // given sizes; it allocates only while the buffer grows or widens
+    LogSlot append(size_t stateWordCount, size_t numOutputs, size_t numInputs);
+    void push(const LogEntry& entry);
+    
+    // Index 0 is the oldest buffered entry
+    const LogRecord& record(size_t index) const { return records[slot(index)]; }
+    const uint64_t* states(size_t index) const { return stateWords.data() + slot(index) * stateStride; }
+    const uint8_t* outputs(size_t index) const { return outputBytes.data() + slot(index) * outputStride; }
+    const uint8_t* inputs(size_t index) const { return inputBytes.data() + slot(index) * inputStride; }
+    uint32_t activeStates(size_t index) const;
+    bool sameStates(size_t a, size_t b) const;
+    LogView view(size_t index) const { return {record(index), states(index), outputs(index), inputs(index)}; }
+    LogEntry entry(size_t index) const;
+};
+
 class OutputLogger {
 private:
     OutputFormat format;
     std::string filename;
     std::ofstream file;
     bool fileOpen;
-    std::vector<LogEntry> logEntries;
+    LogRing logRing;
     bool realTime;
     uint32_t maxLogEntries;
     
-    // VCD specific
+    // File output goes through a large stream buffer, and with asyncOutput
+    // is formatted on a writer thread instead of the simulation thread
+    static constexpr size_t FILE_BUFFER_SIZE = 1 << 20;
+    std::vector<char> fileBuffer;
+    bool asyncOutput;
+    std::unique_ptr<AsyncTraceWriter> asyncWriter;
+    
+    // VCD specific. Signals are the states, then address, then the control
+    // signals; only values that differ from vcdPrevious are written.
+    static constexpr uint32_t VCD_CONTROL_SIGNALS = 5;  // ready, lhs, fired, jmpadr, switch_active
     bool vcdHeaderWritten;
-    std::vector<std::string> vcdSignalNames;
-    std::vector<std::string> vcdSignalCodes;
+    std::vector<std::string> vcdSignalCodes;  // Identifier code plus newline, per signal
+    std::vector<uint32_t> vcdPrevious;        // Last value written, per signal
+    std::vector<char> vcdBuffer;              // Changes for the cycle being written
+    uint64_t vcdLastCycle;                    // Last cycle logged
+    bool vcdCycleWritten;                     // vcdLastCycle has a timestamp in the file
+    
+    // Trace specific
+    std::unique_ptr<TraceWriter> traceWriter;
+    
+    // Streaming export (startExport): every logged entry is appended as it
+    // is written, so the export covers the whole run however small the
+    // trace window is
+    std::unique_ptr<ExportWriter> exportWriter;
+    
+    // Analysis indexes, kept up to date as entries are logged: the cycles of
+    // the buffered entries whose states or address differ from the entry
+    // before them. Entries are logged in cycle order, so both are sorted.
+    std::deque<uint64_t> stateTransitionCycles;
+    std::deque<uint64_t> addressTransitionCycles;
     
     // Helper methods
-    void writeConsoleEntry(const LogEntry& entry, const HotstateModel& model);
-    void writeVCDEntry(const LogEntry& entry, const HotstateModel& model);
-    void writeCSVEntry(const LogEntry& entry, const HotstateModel& model);
-    void writeJSONEntry(const LogEntry& entry, const HotstateModel& model);
-    
-    void writeVCDHeader(const HotstateModel& model);
-    void writeVCDValueChange(const std::string& code, const std::string& value);
-    void writeVCDTime(uint64_t time);
+    void indexNewestEntry();  // After each append to logRing
+    void trimIndexes();       // Drop transitions into entries no longer buffered
+    size_t findCycle(uint64_t cycle) const;  // First buffered entry at or after cycle
+    void dispatchEntry(const LogView& entry);  // To the writer thread, or written here
+    void writeEntry(const LogView& entry);     // In the configured format, and to the export
+    void writeConsoleEntry(const LogView& entry);
+    void writeVCDEntry(const LogView& entry);
+    void writeCSVEntry(const LogView& entry);
+    void writeJSONEntry(const LogView& entry);
+    
+    void writeVCDHeader(uint32_t numStates);
+    void appendVCDBit(uint32_t signal, bool value);
+    void appendVCDByte(uint32_t signal, uint8_t value);
+    void writeVCDEnd();
     
     std::string generateVCDCode(uint32_t index);
-    std::string boolToVCDString(bool value);
-    std::string uint8ToVCDString(uint8_t value);
     
 public:
     OutputLogger();
@@ -69,41 +180,57 @@ public:
     void setFormat(OutputFormat fmt) { format = fmt; }
     void setFilename(const std::string& fname) { filename = fname; }
     void setRealTime(bool rt) { realTime = rt; }
-    void setMaxLogEntries(uint32_t maxEntries) { maxLogEntries = maxEntries; }
+    void setAsyncOutput(bool async) { asyncOutput = async; }  // Takes effect at openFile
+    void setMaxLogEntries(uint32_t maxEntries) {
+        maxLogEntries = maxEntries;
+        logRing.setCapacity(maxEntries);
+        trimIndexes();
+    }
     
     // Access methods
     OutputFormat getFormat() const { return format; }
     const std::string& getFilename() const { return filename; }
     bool isRealTime() const { return realTime; }
-    size_t getLogSize() const { return logEntries.size(); }
+    size_t getLogSize() const { return logRing.size(); }
     
     // File operations
     bool openFile();
     void closeFile();
     bool isFileOpen() const { return fileOpen; }
     
-    // Logging operations
-    void logCycle(uint32_t cycle, const HotstateModel& model, const std::vector<uint8_t>& inputs = {});
+    // Logging operations. logCycle and logRecord copy straight into the trace
+    // window's preallocated slots, so they do not allocate per cycle.
+    void logCycle(uint64_t cycle, const HotstateModel& model, const std::vector<uint8_t>& inputs = {});
+    void logRecord(const LogRecord& record, const uint64_t* states, const uint8_t* outputs, const uint8_t* inputs);
     void logEntry(const LogEntry& entry, const HotstateModel& model);
-    void logEntry(const LogEntry& entry);
+    void logEntry(const LogEntry& entry);  // Record and write, for entries not built from a model
     
     // Batch operations
     void flush();
     void clear();
     
-    // Analysis
-    std::vector<LogEntry> getEntriesInRange(uint32_t startCycle, uint32_t endCycle) const;
-    LogEntry getEntryAtCycle(uint32_t cycle) const;
-    std::vector<uint32_t> getStateTransitionCycles() const;
-    std::vector<uint32_t> getAddressTransitions() const;
+    // Analysis over the buffered entries. Lookups by cycle are binary
+    // searches (direct indexing while no cycles were skipped), and the
+    // transition lists come from indexes built while logging.
+    std::vector<LogEntry> getEntriesInRange(uint64_t startCycle, uint64_t endCycle) const;  // Inclusive
+    LogEntry getEntryAtCycle(uint64_t cycle) const;  // Latest entry at or before cycle; empty if none
+    std::vector<uint64_t> getStateTransitionCycles() const;
+    std::vector<uint64_t> getAddressTransitions() const;
+    size_t getStateTransitionCount() const { return stateTransitionCycles.size(); }
+    size_t getAddressTransitionCount() const { return addressTransitionCycles.size(); }
     
     // Statistics
     void printStatistics() const;
-    uint32_t getTotalCycles() const;
-    uint32_t getActiveCycles() const;
+    uint64_t getTotalCycles() const;
+    uint64_t getActiveCycles() const;
     double getAverageStateActivity() const;
     
-    // Export
+    // Export. startExport streams every entry logged from then on to the
+    // file, and finishExport (or closeFile) completes it; exportToFile
+    // writes only the entries still in the trace window.
+    bool startExport(const std::string& exportFilename, OutputFormat exportFormat);
+    bool finishExport();
+    bool isExporting() const { return exportWriter != nullptr; }
     bool exportToFile(const std::string& exportFilename, OutputFormat exportFormat);
     bool exportToCSV(const std::string& filename);
     bool exportToJSON(const std::string& filename);
@@ -118,6 +245,7 @@ public:
     static std::unique_ptr<OutputLogger> createVCDLogger(const std::string& filename);
     static std::unique_ptr<OutputLogger> createCSVLogger(const std::string& filename);
     static std::unique_ptr<OutputLogger> createJSONLogger(const std::string& filename);
+    static std::unique_ptr<OutputLogger> createTraceLogger(const std::string& filename);
 };
 
 } // namespace HotstateSim
@@ -0,0 +1,36 @@
+#ifndef PERIOD_DETECTOR_H
+#define PERIOD_DETECTOR_H
+
+#include "hotstate_model.h"
+#include <cstdint>
+
+namespace HotstateSim {
+
+// Brent's cycle detection over a model's registers (--periodic), sampled
+// after each rising edge while the inputs are held. The registers decide
+// every later edge, so once they repeat, the edges in between repeat until
+// an input changes. Each sample costs a registerHash; only the sample at
+// the last power of two is kept, as a snapshot that confirms a matching
+// hash, so the memory used does not grow with the period.
+class PeriodDetector {
+public:
+    // Forget every sample, as when the inputs change
+    void restart() { started = false; }
+
+    // Sample the model after a rising edge: the period in rising edges once
+    // these registers repeat an earlier sample's, else 0
+    uint64_t observe(const HotstateModel& model);
+
+private:
+    static bool sameRegisters(const HotstateSnapshot& a, const HotstateSnapshot& b);
+
+    bool started = false;
+    HotstateSnapshot tortoise;  // The sample the later ones are compared with
+    uint64_t tortoiseHash = 0;
+    uint64_t power = 1;         // Samples until the tortoise moves up to the current one
+    uint64_t length = 0;        // Samples since the tortoise
+};
+
+} // namespace HotstateSim
+
+#endif // PERIOD_DETECTOR_H
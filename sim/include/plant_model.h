@@ -0,0 +1,51 @@
+#ifndef PLANT_MODEL_H
+#define PLANT_MODEL_H
+
+#include "hotstate_plant.h"
+#include "memory_loader.h"
+#include "utils.h"
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace HotstateSim {
+
+// A plant plugin (--plant, hotstate_plant.h) loaded from a shared object
+// and attached to one program. The simulator owns one per closed-loop run;
+// it keeps the inputs the plant writes and asks for new ones only when the
+// states change or the plant's wake cycle comes.
+class PlantModel {
+public:
+    // Throws SimulatorException if the library cannot be loaded, has no
+    // hotstate_plant_create, or the plant refuses the program
+    PlantModel(const std::string& library, const std::string& args, const MemoryLoader& memory);
+    ~PlantModel();
+
+    PlantModel(const PlantModel&) = delete;
+    PlantModel& operator=(const PlantModel&) = delete;
+
+    // The plant's reset and update, writing its inputs; each returns the
+    // wake cycle. update throws SimulatorException for HOTSTATE_PLANT_ERROR.
+    uint64_t reset(std::vector<uint8_t>& inputs);
+    uint64_t update(uint64_t cycle, const StateBits& states, std::vector<uint8_t>& inputs);
+
+    uint32_t getNumInputs() const { return info.num_inputs; }
+    const std::string& getLibrary() const { return library; }
+
+private:
+    std::string library;
+    std::string args;
+    void* handle;
+    hotstate_plant plant;
+    hotstate_plant_info info;
+
+    // Storage behind info's names
+    std::vector<std::string> inputNames;
+    std::vector<std::string> stateNames;
+    std::vector<const char*> inputNamePointers;
+    std::vector<const char*> stateNamePointers;
+};
+
+} // namespace HotstateSim
+
+#endif // PLANT_MODEL_H
@@ -0,0 +1,24 @@
+#ifndef PROFILE_REPORT_H
+#define PROFILE_REPORT_H
+
+#include "hotstate_model.h"
+#include "memory_loader.h"
+#include <ostream>
+
+namespace HotstateSim {
+
+// Coverage and hot spot report for a model run with profiling on
+// (--profile): words and branch directions the run exercised, the words
+// and backward jumps (loops) the edges went to, and the words and branch
+// directions it never reached. Each address is followed by its source
+// text when the program was compiled in-process (--from-source).
+void writeProfileReport(std::ostream& out, const HotstateModel& model, const MemoryLoader& memory);
+
+// The counts behind the report as JSON, for c_parser --profile-use:
+// {"words": N, "edges": E, "hits": [...], "taken": [...], "not_taken": [...]}
+// with each array indexed by microcode address
+void writeProfileJson(std::ostream& out, const HotstateModel& model);
+
+} // namespace HotstateSim
+
+#endif // PROFILE_REPORT_H
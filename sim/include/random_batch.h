@@ -0,0 +1,80 @@
+#ifndef RANDOM_BATCH_H
+#define RANDOM_BATCH_H
+
+#include "simulator.h"
+#include "random_stimulus.h"
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace HotstateSim {
+
+// A run that stopped early: the cycle a single --random-stimulus run of its
+// seed would stop at, and why
+struct RandomRunFailure {
+    uint64_t seed;
+    uint32_t cycle;
+    std::string reason;
+};
+
+// Many constrained-random runs of one program (--random-runs N with
+// --random-stimulus SEED): run i is the single run of seed SEED + i, with
+// the same --random-input rules, for --max-cycles. The program is decoded
+// once and shared read-only. Runs go through the structure-of-arrays lane
+// kernel of BatchSimulator in blocks of BLOCK_LANES, each lane generating
+// its own stimulus, and the blocks are spread over --jobs worker threads.
+// A block is one pass over the microcode table per clock period for all of
+// its lanes, with no per-run model, parser or logger.
+//
+// A lane stops at the first cycle it overruns the microcode memory,
+// overflows the return stack, or meets a --breakpoint-state or
+// --breakpoint-addr, which act as assertions. Every lane adds its words
+// and branch directions to one merged coverage count (--profile).
+class RandomBatch {
+public:
+    static constexpr uint32_t BLOCK_LANES = 1024;
+
+    RandomBatch(const SimulatorConfig& cfg, uint32_t runs);
+
+    bool initialize();
+    bool run();   // False if any run failed
+
+    const std::vector<RandomRunFailure>& getFailures() const { return failures; }
+    const std::string& getLastError() const { return lastError; }
+    void printSummary() const;
+    bool writeProfile(const std::string& filename) const;  // As Simulator::writeProfile
+
+private:
+    struct Block;   // One worker's lane registers, reused for each block it runs
+
+    SimulatorConfig config;
+    uint32_t runCount;
+    uint32_t jobs;
+    std::string lastError;
+
+    // Shared, read-only after initialize()
+    MemoryLoader memoryLoader;
+    std::vector<DecodedMicrocode> decoded;
+    VardataImage lut;
+    std::vector<RandomInputRule> rules;
+    uint32_t stateWordCount;
+    uint32_t numTimers;
+    uint32_t stackDepth;
+    std::vector<uint64_t> breakStates;     // --breakpoint-state, one bit per state
+    std::vector<uint64_t> breakAddresses;  // --breakpoint-addr, one bit per address
+
+    // Results, merged from the workers
+    std::vector<RandomRunFailure> failures;   // By seed
+    std::vector<uint64_t> hits;
+    std::vector<uint64_t> taken;
+    std::vector<uint64_t> notTaken;
+    double elapsed;                           // Seconds run() took
+
+    void runBlock(Block& block, uint32_t first, uint32_t lanes) const;
+    bool executeLane(Block& block, uint32_t lane, std::string& reason) const;
+    bool breakpointHit(const Block& block, uint32_t lane, std::string& reason) const;
+};
+
+} // namespace HotstateSim
+
+#endif // RANDOM_BATCH_H
@@ -0,0 +1,57 @@
+#ifndef RANDOM_STIMULUS_H
+#define RANDOM_STIMULUS_H
+
+#include "stimulus_parser.h"
+#include "memory_loader.h"
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace HotstateSim {
+
+// How RandomStimulus drives one input: a new value after a random number
+// of cycles, drawn either per cycle with probability toggle or uniformly
+// from [holdMin, holdMax], and values drawn uniformly from [low, high].
+struct RandomInputRule {
+    double toggle = 0.05;
+    uint32_t holdMin = 0;  // Replaces toggle when holdMax is set
+    uint32_t holdMax = 0;
+    uint8_t low = 0;
+    uint8_t high = 1;
+};
+
+// Constrained-random stimulus generated in-process (--random-stimulus),
+// for StimulusParser::openSource. Entries are only made for cycles where
+// an input changes, so fast-forward still skips the stretches between
+// them. The same seed and rules always give the same entries.
+class RandomStimulus : public StimulusSource {
+public:
+    RandomStimulus(uint64_t seed, const std::vector<RandomInputRule>& rules);
+
+    bool next(StimulusEntry& entry) override;
+
+    // One rule per input from specs of the form NAME:KEY=VALUE,..., where
+    // NAME is an input name from the symbol table, an input index, or *
+    // for every input not named. Keys: toggle=P, hold=N or hold=MIN..MAX,
+    // range=LO..HI, value=V. Throws SimulatorException.
+    static std::vector<RandomInputRule> parseRules(const std::vector<std::string>& specs,
+                                                   const MemoryLoader& memory, uint32_t numInputs);
+
+private:
+    static constexpr uint64_t NEVER = UINT64_MAX;
+
+    uint64_t nextRandom();
+    uint32_t below(uint32_t bound);
+    uint64_t gap(const RandomInputRule& rule);
+    uint8_t draw(const RandomInputRule& rule, uint8_t current);
+
+    uint64_t state;
+    bool started;
+    std::vector<RandomInputRule> rules;
+    std::vector<uint8_t> values;
+    std::vector<uint64_t> changeAt;  // Next cycle each input changes
+};
+
+} // namespace HotstateSim
+
+#endif // RANDOM_STIMULUS_H
@@ -0,0 +1,105 @@
+#ifndef REGRESSION_FARM_H
+#define REGRESSION_FARM_H
+
+#include "simulator.h"
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+
+namespace HotstateSim {
+
+struct FarmResult {
+    std::string stimulusFile;
+    std::string worker;         // Host and port of the connection that ran it
+    bool success;
+    std::string error;
+    uint64_t cycles;
+    uint32_t finalAddress;
+    uint32_t activeStates;
+    uint64_t signature;         // TraceSignature::value of the run
+
+    FarmResult() : success(false), cycles(0), finalAddress(0), activeStates(0), signature(0) {}
+};
+
+// Regression farm over TCP (--coordinator, --worker). The coordinator holds
+// the --batch stimulus set and hands one file at a time to each worker
+// connection; a worker process loads the program once, opens --jobs
+// connections and runs what each is given with a fresh HotstateModel, as
+// SweepRunner does, returning the run's summary, trace signature and, with
+// --profile, its coverage counts. The coordinator merges the counts into one
+// profile report and writes the signatures with --signature.
+//
+// The protocol is lines of text; a stimulus file travels as its bytes:
+//
+//   worker:      HELLO <program fingerprint>
+//   coordinator: RUN <index> <max cycles> <profile 0|1> <bytes>\n<file>
+//                DONE                  (no more runs)
+//                REJECT <reason>       (a different program)
+//   worker:      RESULT <index> ok <cycles> <address> <states> <signature>
+//                COUNTS <words> <hits ...> <taken ...> <not taken ...>   (with profile)
+//                RESULT <index> failed <error>
+//
+// Both sides must load the same program, which the fingerprint checks. A
+// run whose worker disconnects before answering goes back on the queue for
+// the next connection.
+class FarmCoordinator {
+private:
+    SimulatorConfig config;
+    std::vector<std::string> stimulusFiles;
+    MemoryLoader memoryLoader;
+    std::vector<FarmResult> results;
+    std::string lastError;
+
+    // Merged coverage, in a model that never runs
+    std::unique_ptr<HotstateModel> coverage;
+
+    std::mutex mutex;             // Guards the queue, the counts and coverage
+    std::condition_variable runsChanged;  // A run was queued or finished
+    std::deque<uint32_t> pending; // Runs not yet handed out, or handed back
+    uint32_t finished;
+
+    void serve(int fd, const std::string& peer);
+    bool nextRun(uint32_t& index);
+    void requeue(uint32_t index);
+
+public:
+    FarmCoordinator(const SimulatorConfig& cfg, const std::vector<std::string>& files);
+
+    bool initialize();
+    bool run();   // False if any run failed
+
+    const std::vector<FarmResult>& getResults() const { return results; }
+    const std::string& getLastError() const { return lastError; }
+    void printSummary() const;
+    bool writeSignatures(const std::string& filename) const;
+    bool writeProfile(const std::string& filename) const;  // As Simulator::writeProfile
+};
+
+class FarmWorker {
+private:
+    SimulatorConfig config;
+    std::string host;
+    std::string port;
+    uint32_t jobs;
+    MemoryLoader memoryLoader;
+    std::string lastError;
+
+    bool serve(uint32_t& runs, std::string& error) const;
+    std::string runOne(const std::string& stimulusFile, uint32_t index, uint64_t maxCycles, bool profile) const;
+
+public:
+    explicit FarmWorker(const SimulatorConfig& cfg);
+
+    bool initialize();
+    bool run();   // False if no connection could be made or a connection failed
+
+    const std::string& getLastError() const { return lastError; }
+};
+
+} // namespace HotstateSim
+
+#endif // REGRESSION_FARM_H
@@ -0,0 +1,95 @@
+#ifndef RUN_STATS_H
+#define RUN_STATS_H
+
+#include <cstdint>
+#include <chrono>
+#include <ostream>
+
+namespace HotstateSim {
+
+// Where a run's time goes (--stats). Loading and initializing are timed
+// once each and the run as a whole with the steady clock, which costs a few
+// clock reads per run. The parts of each cycle are timed with ScopedTimer,
+// which only counts in the stats build (make stats, -DHOTSTATE_STATS); the
+// regular build compiles it to nothing, so the hot loop pays for it only
+// there. The stats build also counts heap allocations.
+enum class RunPart {
+    LOAD,         // Memory files and stimulus
+    INITIALIZE,   // Logger, model and breakpoints
+    MODEL,        // Clocking the model
+    STIMULUS,     // Looking up and applying the cycle's inputs
+    BREAKPOINTS,  // Checking breakpoints
+    LOGGING,      // Logging and signing the cycle
+    COUNT
+};
+
+class RunStats {
+public:
+    static constexpr bool PARTS_TIMED =
+#ifdef HOTSTATE_STATS
+        true;
+#else
+        false;
+#endif
+
+    // Cycle timer: the time stamp counter where there is one, else steady
+    // clock nanoseconds. Converted to seconds against the steady clock over
+    // the run.
+    static uint64_t ticks();
+
+    void addTicks(RunPart part, uint64_t count) { partTicks[static_cast<int>(part)] += count; }
+    void addSeconds(RunPart part, double seconds) { partSeconds[static_cast<int>(part)] += seconds; }
+
+    // Around each stretch of cycles (run, step); cycles counts those simulated
+    void startRun();
+    void endRun(uint64_t cycles);
+
+    void print(std::ostream& out) const;
+
+private:
+    uint64_t partTicks[static_cast<int>(RunPart::COUNT)] = {};
+    double partSeconds[static_cast<int>(RunPart::COUNT)] = {};
+    double runSeconds = 0;
+    uint64_t runTicks = 0;
+    uint64_t runCycles = 0;
+    uint64_t runAllocations = 0;
+    std::chrono::steady_clock::time_point runStart;
+    uint64_t runStartTicks = 0;
+    uint64_t runStartAllocations = 0;
+};
+
+#ifdef HOTSTATE_STATS
+// Heap allocations so far, from bench/alloc_counter.cpp
+uint64_t heapAllocationCount();
+#endif
+
+// Adds the time from construction to destruction to part of stats, which
+// may be null, in the stats build; nothing at all otherwise
+class ScopedTimer {
+#ifdef HOTSTATE_STATS
+public:
+    ScopedTimer(RunStats* stats, RunPart part)
+        : stats(stats), part(part), start(stats ? RunStats::ticks() : 0) {}
+    ~ScopedTimer() {
+        if (stats) {
+            stats->addTicks(part, RunStats::ticks() - start);
+        }
+    }
+
+private:
+    RunStats* stats;
+    RunPart part;
+    uint64_t start;
+#else
+public:
+    ScopedTimer(RunStats*, RunPart) {}
+#endif
+
+public:
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+};
+
+} // namespace HotstateSim
+
+#endif // RUN_STATS_H
@@ -5,10 +5,16 @@
 #include "hotstate_model.h"
 #include "stimulus_parser.h"
 #include "output_logger.h"
+#include "trace_signature.h"
+#include "breakpoint_predicate.h"
+#include "plant_model.h"
+#include "run_stats.h"
+#include "period_detector.h"
 #include <string>
 #include <vector>
 #include <cstdint>
 #include <memory>
+#include <chrono>
 
 namespace HotstateSim {
 
@@ -22,19 +28,76 @@ enum class SimulatorState {
     ERROR
 };
 
+// --periodic: what a run does once its registers repeat with the inputs held
+enum class PeriodicMode {
+    OFF,
+    STOP,  // End the run there if no stimulus change follows: it has converged
+    SKIP   // Skip whole periods up to the next stimulus change (not logged)
+};
+
 struct SimulatorConfig {
+    static constexpr uint32_t NO_INTERRUPT = UINT32_MAX;
+    
     std::string basePath;
+    std::string sourceFile;     // --from-source: compile this .c in-process instead of loading basePath
     std::string stimulusFile;
     std::string outputFile;
     OutputFormat outputFormat;
-    uint32_t maxCycles;
+    uint64_t maxCycles;
     bool debugMode;
     bool verbose;
     bool realTimeOutput;
     bool enableBreakpoints;
     std::vector<uint32_t> breakpointStates;
     std::vector<uint32_t> breakpointAddresses;
+    std::vector<std::string> breakpointConditions;  // --break-if: BreakpointPredicate text
+    std::vector<std::string> breakpointWatches;     // --break-on-change: break when the value changes
     uint32_t cycleStep;
+    uint32_t checkpointInterval;  // --checkpoint-every: cycles between checkpoints, 0 for none
+    std::string profileFile;      // --profile: coverage and hot spot report, "-" for stdout
+    std::string signatureFile;        // --signature: write the run's TraceSignature here
+    std::string goldenSignatureFile;  // --compare-signature: check the run against this one
+    uint32_t signatureInterval;       // --signature-every: cycles between signature checkpoints, 0 for
+                                      // the golden signature's
+    std::string batchListFile;  // --batch: stimulus directory or list file
+    bool threadedBatch;         // --jobs: run the batch on worker threads
+    uint32_t jobs;
+    bool streamStimulus;        // --stream-stimulus: read stimulus on a background thread
+    bool randomStimulus;        // --random-stimulus: generate stimulus in-process instead of -s
+    uint64_t randomSeed;
+    std::vector<std::string> randomInputRules;  // --random-input: RandomStimulus::parseRules specs
+    uint32_t randomRuns;        // --random-runs: seeds from randomSeed to run in RandomBatch, 0 for one run
+    uint32_t exhaustivePeriods; // --exhaustive: run every input sequence of this many periods, 0 for none
+    bool fastForward;           // --fast-forward: skip idle cycles up to the next stimulus change
+    PeriodicMode periodic;      // --periodic: stop or skip ahead once the run repeats itself
+    bool logging;               // --no-log clears this: run without a logger
+    uint32_t logWindow;         // --log-window: logged cycles kept in memory, 0 for all
+    std::string exportFile;     // --export: stream every logged cycle here
+    OutputFormat exportFormat;  // --export-format
+    std::string convertStimulusFile;  // --convert-stimulus: write -s as binary here and exit
+    std::string dumpTraceFile;        // --dump-trace: print this .hst trace and exit
+    std::string emitCppFile;          // --emit-cpp: write the -b program as a C++ model and exit
+    bool explore;                     // --explore: report the program's reachable states and exit
+    uint64_t exploreLimit;            // --explore-limit: states to visit before giving up
+    uint32_t cores;                   // --cores N: run BASE_p0 .. BASE_p<N-1> from --partition together
+    uint32_t interruptInput;          // --interrupt: the input wired to the interrupt pin, or NO_INTERRUPT
+    uint32_t interruptAddress;        // --interrupt-address: the vector, or NO_INTERRUPT for the program's
+    uint64_t dumpFirstCycle;          // --dump-cycles A:B
+    uint64_t dumpLastCycle;
+    bool autotune;                    // --autotune: compare compile settings for --from-source on -s and exit
+    uint32_t romBudget;               // --rom-budget: microcode words, 0 for no limit
+    uint32_t lutBudget;               // --lut-budget: vardata LUT bytes, 0 for no limit
+    uint32_t latencyBudget;           // --latency-budget: cycles, 0 for no limit
+    std::string patchFile;            // --patch: c_parser --diff-against patch applied to the loaded program
+    std::string imageCacheDir;        // --image-cache: MemoryLoader::setImageCache, "" for none
+    uint32_t coordinatorPort;         // --coordinator: serve the --batch runs to workers on this port, 0 for none
+    std::string workerAddress;        // --worker HOST:PORT: run a coordinator's stimulus
+    std::string plantLibrary;         // --plant: shared object that drives the inputs in a closed loop
+    std::string plantArgs;            // --plant-args: passed to the plant as hotstate_plant_info::args
+    uint32_t soakInterval;            // --soak: seconds between throughput and coverage reports, 0 for none
+    std::string scriptFile;           // --script: debugger commands to run in place of the console
+    bool stats;                       // --stats: time the run's parts (RunStats)
+    std::string activityFile;         // --activity: switching activity, SAIF for a .saif file, "-" for stdout
     
     SimulatorConfig() 
         : outputFormat(OutputFormat::CONSOLE)
@@ -44,10 +107,41 @@ struct SimulatorConfig {
         , realTimeOutput(true)
         , enableBreakpoints(false)
         , cycleStep(1)
+        , checkpointInterval(0)
+        , signatureInterval(0)
+        , threadedBatch(false)
+        , jobs(0)
+        , streamStimulus(false)
+        , randomStimulus(false)
+        , randomSeed(0)
+        , randomRuns(0)
+        , exhaustivePeriods(0)
+        , fastForward(false)
+        , periodic(PeriodicMode::OFF)
+        , logging(true)
+        , logWindow(10000)
+        , exportFormat(OutputFormat::CSV)
+        , explore(false)
+        , exploreLimit(10000000)
+        , cores(0)
+        , interruptInput(NO_INTERRUPT)
+        , interruptAddress(NO_INTERRUPT)
+        , dumpFirstCycle(0)
+        , dumpLastCycle(UINT64_MAX)
+        , autotune(false)
+        , romBudget(0)
+        , lutBudget(0)
+        , latencyBudget(0)
+        , coordinatorPort(0)
+        , soakInterval(0)
+        , stats(false)
     {}
 };
 
 class Simulator {
+public:
+    static constexpr uint32_t RESET_CYCLES = 2;  // Reset is held one clock period, as in the generated testbench
+
 private:
     SimulatorConfig config;
     SimulatorState state;
@@ -55,12 +149,78 @@ private:
     std::unique_ptr<HotstateModel> hotstate;
     std::unique_ptr<StimulusParser> stimulus;
     std::unique_ptr<OutputLogger> logger;
+    std::unique_ptr<TraceSignature> signature;  // With --signature or --compare-signature
+    std::unique_ptr<TraceSignature> goldenSignature;
     
-    uint32_t currentCycle;
-    uint32_t cyclesSinceStart;
+    uint64_t currentCycle;
+    uint64_t cyclesSinceStart;
+    uint64_t skippedCycles;     // Fast-forwarded, not simulated or logged
     bool breakpointHit;
     std::string lastError;
     std::string breakpointReason;
+    
+    // config's breakpoint lists packed one bit per state and per smdata
+    // address, so checkBreakpoints tests them without walking the lists;
+    // rebuilt by indexBreakpoints whenever the lists change
+    std::vector<uint64_t> breakpointStateMask;
+    std::vector<uint64_t> breakpointAddressMap;
+    
+    // config's condition and watch breakpoints, compiled once the model
+    // exists; a watch keeps the value it had after the last check
+    struct ValueWatch {
+        BreakpointPredicate expr;
+        uint32_t value;
+    };
+    std::vector<BreakpointPredicate> conditionBreakpoints;
+    std::vector<ValueWatch> watchBreakpoints;
+    
+    // Model snapshots for restoreToCycle, oldest first. The first is always
+    // cycle 0, and one is added every config.checkpointInterval cycles.
+    struct Checkpoint {
+        uint64_t cycle;
+        uint64_t cyclesSinceStart;
+        uint64_t skippedCycles;
+        uint64_t periodicSkipped;
+        HotstateSnapshot model;
+    };
+    std::vector<Checkpoint> checkpoints;
+    uint64_t nextCheckpointCycle;
+    uint64_t recordedCycles;  // Cycles below this are logged and signed; replaying them records nothing
+    
+    // State change subscribers, served by one subscription to the model
+    // that is made again whenever the model is rebuilt
+    std::vector<std::pair<uint32_t, StateChangeCallback>> stateSubscribers;
+    uint32_t nextSubscriberId = 1;
+    uint32_t modelSubscription = 0;
+
+    // Closed-loop plant (--plant): its inputs replace the stimulus, and it is
+    // asked for new ones before the cycle after a state change or at its
+    // wake cycle, whichever comes first
+    std::unique_ptr<PlantModel> plant;
+    std::vector<uint8_t> plantInputs;
+    uint64_t plantWake = HOTSTATE_PLANT_NO_WAKE;
+    bool plantDue = false;
+    
+    // Soak reports (--soak). The clock is only read every SOAK_CHECK_CYCLES
+    // cycles; state changes are counted through a model subscription.
+    static constexpr uint64_t SOAK_CHECK_CYCLES = 1 << 16;
+    std::chrono::steady_clock::time_point soakStart;
+    std::chrono::steady_clock::time_point soakLast;
+    uint64_t soakLastCycle = 0;
+    uint64_t soakNextCheck = 0;
+    uint64_t soakStateChanges = 0;
+    
+    // Periodic runs (--periodic): the rising edges since the inputs last
+    // changed go through the detector until it finds the period
+    PeriodDetector periodDetector;
+    uint64_t periodHeldUntil = 0;  // Next stimulus change after the detector's first edge
+    bool periodFound = false;      // Nothing more to find until then
+    uint64_t period = 0;           // Cycles of the last period found, 0 for none
+    uint64_t convergedCycle = 0;   // Where STOP ended the run, 0 if it did not
+    uint64_t periodicSkipped = 0;  // Cycles SKIP advanced, also in skippedCycles
+    
+    // With --stats; null otherwise, which the hot loop's timers test
+    std::unique_ptr<RunStats> runStats;
 
     // Debugger state
     bool debugMode;
@@ -72,16 +232,31 @@ private:
     // Internal methods
     bool loadMemoryFiles();
     bool loadStimulusFile();
+    void loadRandomStimulus();  // Throws SimulatorException for bad rules
     bool initializeLogger();
     void initializeHotstate();
-    void advanceClock();
-    void applyStimulus(uint32_t cycle);
+    void subscribeModel();
+    void resetPlant();
+    void startSoak();
+    void checkSoak();
+    void printSoakReport(std::chrono::steady_clock::time_point now);
+    bool restartProgram(MemoryLoader& memory);
+    bool runTo(uint64_t stopCycle);
+    void simulateCycle();
+    void fastForward(uint64_t stopCycle);
+    void checkPeriodic(uint64_t stopCycle);
     void checkBreakpoints();
+    void indexBreakpoints();
+    void compileBreakpointExpressions();
+    void resetWatchValues();
+    void resetCheckpoints();
+    void takeCheckpoint();
+    void scheduleCheckpoint();
     void updateState();
     
     // Debug and analysis
-    void printDebugInfo(uint32_t cycle);
-    void printCycleInfo(uint32_t cycle);
+    void printDebugInfo(uint64_t cycle);
+    void printCycleInfo(uint64_t cycle);
     bool validateConfiguration();
     
 public:
@@ -89,7 +264,7 @@ public:
     ~Simulator() = default;
     
     // Configuration
-    void setConfig(const SimulatorConfig& cfg) { config = cfg; }
+    void setConfig(const SimulatorConfig& cfg) { config = cfg; indexBreakpoints(); }
     const SimulatorConfig& getConfig() const { return config; }
     
     // Simulation control
@@ -97,11 +272,39 @@ public:
     bool run();
     bool runToCompletion();
     bool step(uint32_t numCycles = 1);
-    bool stepToCycle(uint32_t targetCycle);
+    // As run, at full speed, but paused at targetCycle if nothing stops it
+    // before
+    bool stepToCycle(uint64_t targetCycle);
     void pause();
     void reset();
     void stop();
     
+    // Time travel: restore the newest checkpoint at or before cycle and
+    // replay the stimulus up to it. Only earlier cycles can be restored, and
+    // inputs set by hand in the debugger are not replayed.
+    bool restoreToCycle(uint64_t cycle);
+    bool stepBack(uint32_t numCycles = 1);
+    // Keep a checkpoint of the current cycle for restoreToCycle, whatever
+    // the --checkpoint-every interval
+    void addCheckpoint();
+    
+    // Hot swap for sweeps over builds of one design: replace the program of
+    // an initialized simulator and start it again from cycle 0, as reset
+    // does, without reloading the stimulus or reopening the logger. The
+    // stimulus stays as parsed, so the new program must number its inputs
+    // as the old one did. On failure the old program is kept.
+    bool swapProgram(const std::string& basePath, const std::string& sourceFile = "");
+    bool swapProgram(const MemoryLoader& memory);
+    // Apply a c_parser --diff-against patch (MemoryLoader::applyPatch) to the
+    // running program and start it again the same way
+    bool applyPatch(const std::string& patchFile);
+    
+    // State change events (HotstateModel::subscribeStates), given the cycle
+    // of the run instead of the model's edge count; subscribers stay
+    // subscribed across reset and program swaps
+    uint32_t subscribeStates(StateChangeCallback callback);
+    void unsubscribeStates(uint32_t id);
+    
     // Status
     SimulatorState getState() const { return state; }
     bool isRunning() const { return state == SimulatorState::RUNNING; }
@@ -110,8 +313,14 @@ public:
     const std::string& getLastError() const { return lastError; }
     
     // Progress
-    uint32_t getCurrentCycle() const { return currentCycle; }
-    uint32_t getCyclesSinceStart() const { return cyclesSinceStart; }
+    uint64_t getCurrentCycle() const { return currentCycle; }
+    uint64_t getCyclesSinceStart() const { return cyclesSinceStart; }
+    uint64_t getSkippedCycles() const { return skippedCycles; }
+    // --periodic: the last period found in cycles (0 for none), and the
+    // cycle the run converged at with --periodic stop (0 if it did not)
+    uint64_t getPeriod() const { return period; }
+    bool hasConverged() const { return convergedCycle > 0; }
+    uint64_t getConvergedCycle() const { return convergedCycle; }
     double getProgress() const;
     
     // Access to components
@@ -122,6 +331,7 @@ public:
     
     // Analysis
     void printStatistics() const;
+    void printRunStats() const;  // --stats
     void printSummary() const;
     void printCurrentState() const;
     void printMemoryInfo() const;
@@ -129,6 +339,9 @@ public:
     // Breakpoints
     void addStateBreakpoint(uint32_t stateValue);
     void addAddressBreakpoint(uint32_t address);
+    // Throw SimulatorException for an invalid expression once loaded
+    void addConditionBreakpoint(const std::string& expression);
+    void addWatchBreakpoint(const std::string& expression);
     void clearBreakpoints();
     void listBreakpoints() const;
 
@@ -172,9 +385,16 @@ public:
     std::string getBreakpointReason() const;
     
     // Export
-    bool exportResults(const std::string& filename, OutputFormat format = OutputFormat::CSV);
+    bool exportResults(const std::string& filename, OutputFormat format = OutputFormat::CSV);  // The trace window
+    bool finishExport();  // Complete the --export file streamed during the run
     bool exportTrace(const std::string& filename);
     bool exportSummary(const std::string& filename);
+    bool writeProfile(const std::string& filename);  // "-" for stdout; counts as JSON for a .json file
+    bool writeActivity(const std::string& filename);  // "-" for stdout; SAIF for a .saif file
+    bool writeSignature(const std::string& filename);
+    // False when the run differs from --compare-signature, with the
+    // first divergent cycles in the last error
+    bool compareSignature();
     
     // Static utility methods
     static SimulatorConfig createDefaultConfig();
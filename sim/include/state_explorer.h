@@ -0,0 +1,81 @@
+#ifndef STATE_EXPLORER_H
+#define STATE_EXPLORER_H
+
+#include "hotstate_model.h"
+#include "memory_loader.h"
+#include <ostream>
+#include <vector>
+#include <cstdint>
+
+namespace HotstateSim {
+
+// Exhaustive breadth-first search of the states a program can reach from
+// reset under every input sequence (--explore). A state is what the next
+// rising edge depends on: the address, the stack, the state register and
+// the timer counts. An edge reads the inputs only through the Uber LUT
+// entry {varSel, inputs}, and only on a branch word that is not waiting on
+// a timer, so every combination of the NUM_VARS inputs leads to one of at
+// most two successors: one for an input vector that makes the entry 0 and
+// one for a vector that makes it 1, where the LUT block has such vectors.
+//
+// States are bit-packed into fixed-size keys kept in one array, in the
+// order found, so each BFS level is a contiguous range of it, and looked
+// up through an open-addressing table of indices. A level is expanded on
+// worker threads, each with its own model, and merged in order, so the
+// result does not depend on the thread count.
+class StateExplorer {
+public:
+    StateExplorer(const MemoryLoader& memory, uint32_t jobs, uint64_t stateLimit);
+
+    void run();  // Throws SimulatorException if the model does
+    void writeReport(std::ostream& out) const;
+
+    uint64_t getStateCount() const { return stateCount; }
+    bool isComplete() const { return complete; }
+
+private:
+    void expandBatch(uint64_t first, uint64_t count, std::vector<uint64_t>& successors,
+                     std::vector<uint8_t>& successorCounts) const;
+    uint8_t expand(HotstateModel& model, HotstateSnapshot& scratch, uint64_t state, uint64_t* successors) const;
+    void pack(const HotstateSnapshot& snapshot, uint64_t* key) const;
+    void unpack(const uint64_t* key, HotstateSnapshot& snapshot) const;
+    uint32_t keyAddress(const uint64_t* key) const;
+    uint32_t keyStackPointer(const uint64_t* key) const;
+    uint64_t find(const uint64_t* key, bool& found) const;  // The key's slot, or the empty one it belongs in
+    void add(const uint64_t* key, uint64_t slot);
+    void grow();
+    uint64_t hashKey(const uint64_t* key) const;
+    const uint64_t* keyAt(uint64_t state) const { return keys.data() + state * keyWords; }
+
+    const MemoryLoader& memory;
+    uint32_t jobs;
+    uint64_t stateLimit;
+    HotstateModel prototype;  // Copied for each worker thread
+
+    // Key layout: address, stack pointer, stack slots, states, timer counts
+    uint32_t addressBits;
+    uint32_t stackDepth;  // The model's STACK_DEPTH; a key holds every slot
+    uint32_t stackPointerBits;
+    uint32_t timerBits;
+    uint32_t numStates;
+    uint32_t numTimers;
+    uint32_t keyWords;
+    HotstateSnapshot initial;  // Registers a key does not hold
+    std::vector<int64_t> inputChoices;  // Per address: packed inputs for lhs 0 and for lhs 1, -1 where none gives it
+
+    std::vector<uint64_t> keys;
+    std::vector<uint32_t> slots;  // State index + 1, or 0 for empty
+    uint64_t stateCount;
+    uint32_t levels;
+    bool complete;
+
+    // Findings
+    std::vector<bool> reachedAddress;
+    std::vector<uint64_t> deadlocksAt;  // Per address: states every input leaves unchanged
+    uint32_t maxStackDepth;
+    std::vector<bool> overflowAt;  // Per address: a call made with the stack full, where the model throws
+};
+
+} // namespace HotstateSim
+
+#endif // STATE_EXPLORER_H
@@ -4,49 +4,210 @@
 #include <string>
 #include <vector>
 #include <cstdint>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <functional>
+#include "memory_loader.h"
 
 namespace HotstateSim {
 
 struct StimulusEntry {
-    uint32_t cycle;
+    uint64_t cycle;
     std::vector<uint8_t> inputs;
     std::string comment;
     
     StimulusEntry() : cycle(0) {}
-    StimulusEntry(uint32_t c, const std::vector<uint8_t>& in, const std::string& comm = "")
+    StimulusEntry(uint64_t c, const std::vector<uint8_t>& in, const std::string& comm = "")
         : cycle(c), inputs(in), comment(comm) {}
 };
 
+// A named stimulus file starts with a header line "cycle, NAME, NAME, ..."
+// naming the program's inputs. The names are resolved to input indices once,
+// through the symbol table, so every row after the header is numbers only.
+// A blank cell keeps that input's value from the row above, so a row needs
+// only the inputs that change; cycles must not go backwards.
+class StimulusColumns {
+public:
+    static bool isHeader(const std::string& line);
+    
+    // Throws SimulatorException for a name the symbol table does not have
+    StimulusColumns(const std::string& header, const SymbolTable& symbols);
+    
+    // Parse one row; false if it holds no entry (blank or comment only)
+    bool parseRow(const std::string& line, StimulusEntry& entry);
+    
+private:
+    std::vector<uint32_t> columnInputs;  // Input index of each column after the cycle
+    std::vector<uint8_t> values;         // Every input's value after the last row
+    uint64_t lastCycle = 0;
+};
+
+// Entries for StimulusParser's streaming mode, in increasing cycle order
+class StimulusSource {
+public:
+    virtual ~StimulusSource() = default;
+    
+    // Next entry; false when there are no more
+    virtual bool next(StimulusEntry& entry) = 0;
+};
+
+// Reads a stimulus file on a background thread, keeping at most readAhead
+// parsed entries queued. Entries come out in file order.
+class StimulusStream : public StimulusSource {
+private:
+    std::string filename;
+    std::ifstream file;
+    size_t readAhead;
+    const SymbolTable* symbols;  // For a named file's header; may be null
+    
+    std::thread reader;
+    std::mutex mutex;
+    std::condition_variable notFull;
+    std::condition_variable notEmpty;
+    std::deque<StimulusEntry> queue;
+    bool done = false;       // Reader reached end of file or an error
+    bool stopping = false;   // Owner is shutting the reader down
+    std::string error;
+    
+    void readLoop();
+    
+public:
+    StimulusStream(const std::string& filename, size_t readAhead, const SymbolTable* symbols = nullptr);
+    ~StimulusStream();
+    StimulusStream(const StimulusStream&) = delete;
+    StimulusStream& operator=(const StimulusStream&) = delete;
+    
+    // Next entry in file order; false at end of file. Parse errors are rethrown here.
+    bool next(StimulusEntry& entry) override;
+};
+
+// Binary stimulus format (little-endian). A 24-byte header:
+//   magic "HSSTIMB1", uint32 entry count, uint32 inputs per entry,
+//   uint8 bits per input value (1-8), uint8 flags, uint16 reserved,
+//   uint32 bytes per record
+// followed by fixed-width records: uint32 cycle delta from the previous
+// entry (from cycle 0 for the first), a uint16 input count when
+// BINARY_FLAG_RAGGED is set, then the input values packed LSB-first.
+// Comments are not kept.
+struct BinaryStimulusHeader {
+    static constexpr char MAGIC[9] = "HSSTIMB1";
+    static constexpr size_t SIZE = 24;
+    static constexpr uint8_t FLAG_RAGGED = 0x01;  // Entries have differing input counts
+    
+    uint32_t entryCount = 0;
+    uint32_t numInputs = 0;
+    uint8_t valueBits = 1;
+    uint8_t flags = 0;
+    uint32_t recordBytes = 0;
+};
+
+// Testbench stimulus format: the $readmemh file the generated Verilog
+// testbench (<base>_tb.v) streams its inputs from. "//" comments, then one
+// hex word per entry: 8 digits of the entry's cycle, then 2 digits per
+// input, the last input first, so input 0 is the low byte. Every word has
+// the program's input count; a file is recognised by its .mem extension.
+struct ReadmemhStimulus {
+    static constexpr const char* EXTENSION = ".mem";
+    static constexpr uint64_t MAX_CYCLE = 0xFFFFFFFEu;  // All ones ends the testbench's memory
+};
+
 class StimulusParser {
+public:
+    static constexpr size_t STREAM_READ_AHEAD = 4096;  // Entries queued by the reader thread
+    
 private:
-    std::vector<StimulusEntry> stimulus;
+    friend class StimulusColumns;  // Shares the cell parsers
+    
+    std::vector<StimulusEntry> stimulus;  // Always sorted by cycle
     bool loaded = false;
     uint32_t numInputs = 0;
+    const SymbolTable* inputSymbols = nullptr;  // Resolves a named file's header
+    std::unique_ptr<StimulusColumns> columns;    // Set while loading a named file
+    
+    // Lookup state for getInputs. Simulation asks for cycles in order, so the
+    // cursor usually only moves forward by one entry.
+    mutable size_t cursor = 0;
+    mutable std::vector<uint8_t> paddedInputs;
+    
+    // Streaming mode (openStream, openSource): only the entry in effect and
+    // the one after it are held, instead of the whole file
+    std::string streamName;
+    std::function<std::unique_ptr<StimulusSource>()> streamFactory;
+    mutable std::unique_ptr<StimulusSource> stream;
+    mutable StimulusEntry streamHeld;
+    mutable StimulusEntry streamNext;
+    mutable bool streamHasHeld = false;
+    mutable bool streamHasNext = false;
+    mutable size_t streamConsumed = 0;
+    mutable uint32_t streamNumInputs = 0;
     
     // Helper methods
+    size_t findHeldEntry(uint64_t cycle) const;
+    void restartStream() const;
+    void advanceStream(uint64_t cycle) const;
     bool parseLine(const std::string& line, uint32_t lineNumber);
-    std::vector<uint8_t> parseInputValues(const std::string& valuesStr);
-    uint32_t parseCycle(const std::string& cycleStr);
-    std::string extractComment(const std::string& line);
+    static std::vector<uint8_t> parseInputValues(const std::string& valuesStr);
+    static uint8_t parseInputValue(const std::string& valueStr);
+    static uint64_t parseCycle(const std::string& cycleStr);
+    static std::string extractComment(const std::string& line);
+    bool loadBinaryStimulus(const std::string& filename);
+    bool loadReadmemhStimulus(const std::string& filename);
     
 public:
     StimulusParser() = default;
     
-    // Load stimulus from file
+    // Load stimulus from file; binary files are recognised by their magic,
+    // testbench files by their extension
     bool loadStimulus(const std::string& filename);
     
-    // Access methods
+    // Binary format: save the loaded entries, or test a file's magic
+    bool saveBinaryStimulus(const std::string& filename) const;
+    static bool isBinaryStimulus(const std::string& filename);
+    
+    // Testbench format: save the loaded entries with inputCount values each
+    // (missing ones 0), or test a file's name
+    bool saveReadmemhStimulus(const std::string& filename, uint32_t inputCount) const;
+    static bool isReadmemhStimulus(const std::string& filename);
+    
+    // Read the file lazily instead. Cycles must be strictly increasing in the
+    // file; a request for an earlier cycle than the last one restarts the read.
+    // numInputs only counts the entries read so far. Binary and testbench
+    // files are loaded as by loadStimulus.
+    bool openStream(const std::string& filename, size_t readAhead = STREAM_READ_AHEAD);
+    // Stream from the sources factory makes instead, such as a RandomStimulus;
+    // name is for messages. A restart makes a new source, so each must give
+    // the same entries. Throws SimulatorException if the first has none.
+    void openSource(const std::string& name, std::function<std::unique_ptr<StimulusSource>()> factory);
+    bool isStreaming() const { return static_cast<bool>(streamFactory); }
+    
+    // Parse one positional data line; false if it holds no entry (blank or comment only)
+    static bool parseEntry(const std::string& line, StimulusEntry& entry);
+    
+    // Access methods (getStimulus is empty while streaming; size counts entries read)
     const std::vector<StimulusEntry>& getStimulus() const { return stimulus; }
-    size_t size() const { return stimulus.size(); }
-    bool isEmpty() const { return stimulus.empty(); }
+    size_t size() const { return isStreaming() ? streamConsumed : stimulus.size(); }
+    bool isEmpty() const { return isStreaming() ? false : stimulus.empty(); }
     
     // Get stimulus for specific cycle
-    const StimulusEntry* getEntry(uint32_t cycle) const;
-    std::vector<uint8_t> getInputs(uint32_t cycle) const;
+    const StimulusEntry* getEntry(uint64_t cycle) const;
+    // Inputs in effect at cycle: the entry for that cycle, else the last
+    // earlier entry padded to numInputs, else all zeros. The reference is
+    // valid until the next call; a parser must not be shared between threads.
+    const std::vector<uint8_t>& getInputs(uint64_t cycle) const;
+    // First cycle after cycle that has an entry (UINT64_MAX if none): the
+    // inputs getInputs returns stay the same until then
+    uint64_t getNextChangeCycle(uint64_t cycle) const;
     
     // Configuration
     void setNumInputs(uint32_t num) { numInputs = num; }
-    uint32_t getNumInputs() const { return numInputs; }
+    // Input names for named files (MemoryLoader::getInputSymbols); the table
+    // has to outlive the loads. Without one, a named file is an error.
+    void setInputSymbols(const SymbolTable* symbols) { inputSymbols = symbols; }
+    uint32_t getNumInputs() const { return isStreaming() ? streamNumInputs : numInputs; }
     
     // Status
     bool isLoaded() const { return loaded; }
@@ -0,0 +1,51 @@
+#ifndef SWEEP_RUNNER_H
+#define SWEEP_RUNNER_H
+
+#include "simulator.h"
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace HotstateSim {
+
+struct SweepResult {
+    std::string stimulusFile;
+    std::string outputFile;     // Empty for console sweeps
+    bool success;
+    std::string error;
+    uint64_t cycles;
+    uint32_t finalAddress;
+    uint32_t activeStates;
+
+    SweepResult() : success(false), cycles(0), finalAddress(0), activeStates(0) {}
+};
+
+// Runs a set of stimulus files on worker threads. The MemoryLoader image is
+// loaded once and only read afterwards; every run gets its own
+// HotstateModel, StimulusParser and OutputLogger, so runs share no mutable
+// state and their results are collected in input order.
+class SweepRunner {
+private:
+    SimulatorConfig config;
+    std::vector<std::string> stimulusFiles;
+    uint32_t jobs;
+    MemoryLoader memoryLoader;
+    std::vector<SweepResult> results;
+    std::string lastError;
+
+    void runOne(uint32_t index, SweepResult& result) const;
+
+public:
+    SweepRunner(const SimulatorConfig& cfg, const std::vector<std::string>& files, uint32_t numJobs);
+
+    bool initialize();
+    bool run();   // False if any run failed
+
+    const std::vector<SweepResult>& getResults() const { return results; }
+    const std::string& getLastError() const { return lastError; }
+    void printSummary() const;
+};
+
+} // namespace HotstateSim
+
+#endif // SWEEP_RUNNER_H
@@ -0,0 +1,79 @@
+#ifndef SYSTEM_SIMULATOR_H
+#define SYSTEM_SIMULATOR_H
+
+#include "hotstate_model.h"
+#include "memory_loader.h"
+#include "stimulus_parser.h"
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace HotstateSim {
+
+// A partitioned design under one clock (--cores N): the images c_parser
+// --partition writes as BASE_p0 .. BASE_p<N-1>, wired as its generated
+// module wires them. Every core reads the same input bus; each state on
+// the output bus is driven by the first core whose microcode assigns it
+// after the reset word, or by core 0 when none does.
+//
+// Cores only meet on those buses. The inputs come from the stimulus and
+// no core reads another's outputs, so the inputs of every cycle are known
+// before any core runs. A span of cycles is therefore simulated one core
+// at a time, on worker threads, each core recording its registers per
+// cycle; the output bus is merged from the records afterwards. A settled
+// core skips ahead to its next input change, as with --fast-forward, so an
+// idle core costs next to nothing.
+class SystemSimulator {
+public:
+    static constexpr uint32_t RESET_CYCLES = 2;  // One clock period, as in the generated testbench
+    static constexpr uint32_t SPAN_CYCLES = 4096;  // Cycles simulated per core between merges
+
+    // Throws SimulatorException if a core does not load
+    SystemSimulator(const std::string& basePath, uint32_t coreCount, uint32_t jobs);
+
+    // Cycle cycle's output bus and the address each core is at after it
+    using CycleObserver = std::function<void(uint32_t cycle, const StateBits& outputs,
+                                             const std::vector<uint32_t>& addresses)>;
+
+    // Simulate cycles [0, cycles) from reset on the stimulus (an empty one
+    // leaves the inputs at their vardata values), calling observer for each
+    // cycle in order. Throws SimulatorException if a core does.
+    void run(const StimulusParser& stimulus, uint32_t cycles, const CycleObserver& observer);
+
+    size_t size() const { return cores.size(); }
+    const MemoryLoader& getMemory(size_t core) const { return *memories[core]; }
+    uint32_t getOwner(uint32_t state) const { return owners[state]; }
+    uint32_t getNumOutputs() const { return numOutputs; }
+    uint64_t getSkippedCycles() const { return skippedCycles; }  // Core cycles not executed
+
+private:
+    // The inputs from cycle on, for one span
+    struct InputChange {
+        uint32_t cycle;
+        std::vector<uint8_t> inputs;
+        bool changed;  // False for those carried into the span from before it
+    };
+
+    void runCore(size_t core, uint32_t start, uint32_t end, const std::vector<InputChange>& changes);
+    void mergeOutputs(uint32_t offset, StateBits& outputs) const;
+
+    std::vector<std::unique_ptr<MemoryLoader>> memories;  // Outlive the models referring to them
+    std::vector<std::unique_ptr<HotstateModel>> cores;
+    std::vector<uint32_t> owners;            // Per state
+    std::vector<std::vector<uint64_t>> ownedMasks;  // Per core: the output bus words it drives
+    uint32_t numOutputs;
+    uint32_t outputWords;
+    uint32_t jobs;
+
+    // Per core, SPAN_CYCLES records of outputWords state words and one address
+    std::vector<std::vector<uint64_t>> stateRecords;
+    std::vector<std::vector<uint32_t>> addressRecords;
+    std::vector<uint64_t> coreSkipped;
+    uint64_t skippedCycles;
+};
+
+} // namespace HotstateSim
+
+#endif // SYSTEM_SIMULATOR_H
@@ -0,0 +1,131 @@
+#ifndef TRACE_FORMAT_H
+#define TRACE_FORMAT_H
+
+#include "output_logger.h"
+#include <string>
+#include <vector>
+#include <fstream>
+#include <functional>
+#include <cstdint>
+
+namespace HotstateSim {
+
+// Compressed columnar trace (-f trace, .hst). Little-endian throughout.
+//
+//   "HSTRACE1", uint32 version, uint32 cycles per block
+//   blocks, each: varint start cycle, varint cycle count, varint signal
+//     count, per signal (varint value before the block, varint column
+//     bytes), then the columns
+//   footer: uint32 signal count, per signal (uint8 width, uint16 name
+//     length, name); uint32 block count, per block (uint64 first cycle,
+//     uint64 last cycle, uint64 file offset)
+//   trailer: uint64 footer offset, "HSTRIDX1"
+//
+// A column holds one signal's changes within the block as runs of
+// (varint cycle delta since the previous change, zigzag varint value delta
+// for signals wider than 1 bit, varint repeat count). Periodic signals
+// collapse into a single run, and a block can be decoded on its own, so a
+// reader seeks through the index instead of scanning the file.
+struct TraceSignal {
+    std::string name;
+    uint8_t width;
+};
+
+class TraceWriter {
+public:
+    static constexpr uint32_t VERSION = 1;
+    static constexpr uint32_t BLOCK_CYCLES = 65536;
+
+private:
+    struct Column {
+        uint32_t value = 0;
+        uint32_t blockInitial = 0;
+        uint64_t lastChange = 0;     // Cycle of the last change, or the block start
+        uint64_t runDelta = 0;
+        int64_t runValueDelta = 0;
+        uint64_t runCount = 0;       // 0: no run pending
+        std::vector<uint8_t> bytes;
+    };
+
+    struct BlockIndex {
+        uint64_t firstCycle;
+        uint64_t lastCycle;
+        uint64_t offset;
+    };
+
+    std::ostream& out;
+    uint64_t written;                // Bytes of the file so far
+    std::vector<TraceSignal> signals;
+    std::vector<Column> columns;
+    std::vector<BlockIndex> index;
+    std::vector<uint8_t> blockBytes;
+
+    uint32_t numStates;              // Layout taken from the first entry
+    uint32_t numOutputs;
+    uint32_t inputBase;              // Signal index of input[0]
+    bool inBlock;
+    uint64_t blockStart;
+    uint64_t lastCycle;
+
+    void defineSignals(const LogRecord& rec);
+    void record(uint32_t signal, uint32_t value, uint64_t cycle);
+    void flushRun(uint32_t signal);
+    void finishBlock();
+    void writeBytes(const void* data, size_t size);
+
+public:
+    explicit TraceWriter(std::ostream& stream);
+
+    void append(const LogView& entry);
+    void restart();   // Cycles start over; blocks written so far leave the index
+    void finish();    // Write the last block and the footer
+};
+
+class TraceReader {
+private:
+    struct BlockIndex {
+        uint64_t firstCycle;
+        uint64_t lastCycle;
+        uint64_t offset;
+    };
+
+    std::string filename;
+    std::ifstream file;
+    uint32_t blockCycles;
+    uint64_t footerOffset;          // Also the end of the last block
+    std::vector<TraceSignal> signals;
+    std::vector<BlockIndex> index;
+
+    // Decoded block: per signal, the value before the block and its changes
+    struct Change {
+        uint64_t cycle;
+        uint32_t value;
+    };
+    struct DecodedBlock {
+        std::vector<uint32_t> initial;
+        std::vector<std::vector<Change>> changes;
+    };
+    DecodedBlock decodeBlock(size_t block);
+
+public:
+    explicit TraceReader(const std::string& filename);  // Throws SimulatorException
+
+    const std::vector<TraceSignal>& getSignals() const { return signals; }
+    size_t getBlockCount() const { return index.size(); }
+    uint32_t getBlockCycles() const { return blockCycles; }
+    bool isEmpty() const { return index.empty(); }
+    uint64_t getFirstCycle() const { return index.empty() ? 0 : index.front().firstCycle; }
+    uint64_t getLastCycle() const { return index.empty() ? 0 : index.back().lastCycle; }
+
+    // Calls visit for every logged cycle in [first, last] with all signal
+    // values; only the blocks overlapping the range are read
+    void readCycles(uint64_t first, uint64_t last,
+                    const std::function<void(uint64_t, const std::vector<uint32_t>&)>& visit);
+
+    // Print a summary, then the cycles in [first, last] as CSV
+    void dump(std::ostream& os, uint64_t first, uint64_t last);
+};
+
+} // namespace HotstateSim
+
+#endif // TRACE_FORMAT_H
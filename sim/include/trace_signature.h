@@ -0,0 +1,102 @@
+#ifndef TRACE_SIGNATURE_H
+#define TRACE_SIGNATURE_H
+
+#include "hotstate_model.h"
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace HotstateSim {
+
+// Rolling 64-bit hash of a run's trace (--signature), for comparing a
+// regression run against a golden one without storing either trace. Each
+// cycle where the address or the state registers (the outputs) change
+// folds the cycle number and the new values in with xxHash64 rounds, so
+// cycles the model idles through, fast-forwarded or not, cost nothing.
+//
+// With an interval, the hash is also kept every interval cycles. Those
+// are cumulative, so once two runs diverge every later checkpoint differs
+// too, and compare() bisects them to the interval the first difference is
+// in. The file is text:
+//
+//   HSSIG1
+//   cycles N
+//   interval I
+//   final HASH
+//   HASH             one per checkpoint, the hash of cycles below k * I
+class TraceSignature {
+public:
+    explicit TraceSignature(uint32_t interval = 0);
+
+    // Cycles are recorded in increasing order, after their clock
+    void record(uint64_t cycle, const HotstateModel& model) {
+        record(cycle, model.getCurrentAddress(), model.getStates().getWords());
+    }
+
+    // The same for another implementation of the design, with the states
+    // packed as in StateBits
+    void record(uint64_t cycle, uint32_t address, const std::vector<uint64_t>& states) {
+        while (cycle >= nextCheckpoint) {
+            takeCheckpoint();
+        }
+        if (address == lastAddress && states == lastStates) {
+            return;
+        }
+        lastAddress = address;
+        lastStates = states;
+        hash = round(hash, cycle);
+        hash = round(hash, address);
+        for (uint64_t word : lastStates) {
+            hash = round(hash, word);
+        }
+    }
+
+    // End of the run: checkpoints up to cycles, which were all recorded
+    void finish(uint64_t cycles);
+
+    uint64_t value() const { return hash; }
+    uint64_t getCycles() const { return cycles; }
+    uint32_t getInterval() const { return interval; }
+
+    bool save(const std::string& filename) const;
+    static TraceSignature load(const std::string& filename);  // Throws SimulatorException
+
+    // Where run first differs from golden: [firstCycle, lastCycle), or
+    // match when the signatures agree. Throws SimulatorException when
+    // the intervals differ.
+    struct Divergence {
+        bool match;
+        uint64_t firstCycle;
+        uint64_t lastCycle;
+    };
+    static Divergence compare(const TraceSignature& golden, const TraceSignature& run);
+
+private:
+    static constexpr uint64_t PRIME1 = 0x9E3779B185EBCA87ULL;
+    static constexpr uint64_t PRIME2 = 0xC2B2AE3D27D4EB4FULL;
+    static constexpr uint64_t PRIME4 = 0x85EBCA77C2B2AE63ULL;
+    static constexpr uint64_t SEED = 0x27D4EB2F165667C5ULL;
+
+    static uint64_t rotl(uint64_t v, int bits) { return (v << bits) | (v >> (64 - bits)); }
+
+    // xxHash64's accumulator round, merged into the running hash
+    static uint64_t round(uint64_t h, uint64_t value) {
+        value *= PRIME2;
+        value = rotl(value, 31) * PRIME1;
+        return rotl(h ^ value, 27) * PRIME1 + PRIME4;
+    }
+
+    void takeCheckpoint();
+
+    uint32_t interval;
+    uint64_t nextCheckpoint;  // Past every cycle without an interval
+    uint64_t hash;
+    uint64_t cycles;
+    uint32_t lastAddress;
+    std::vector<uint64_t> lastStates;
+    std::vector<uint64_t> checkpoints;
+};
+
+} // namespace HotstateSim
+
+#endif // TRACE_SIGNATURE_H
@@ -1,6 +1,7 @@
 #ifndef UTILS_H
 #define UTILS_H
 
+#include <algorithm>
 #include <cstdint>
 #include <string>
 #include <vector>
@@ -17,18 +18,100 @@ std::vector<std::string> split(const std::string& str, char delimiter);
 uint32_t parseHex(const std::string& hexStr);
 uint64_t parseHex64(const std::string& hexStr);
 uint32_t parseDecimal(const std::string& decStr);
+uint64_t parseDecimal64(const std::string& decStr);
+// A cycle count with an optional k, M, G or T suffix: 5000, 250k, 40M, 10G
+uint64_t parseCycleCount(const std::string& text);
 
 // File utilities
 bool fileExists(const std::string& filename);
 std::string getFileExtension(const std::string& filename);
 std::string getBaseFilename(const std::string& filename);
 
+// Read-only mapping of a whole file, unmapped on destruction. kind names
+// the file in errors ("stimulus file"). Throws SimulatorException.
+class MappedFile {
+private:
+    const uint8_t* data = nullptr;
+    size_t length = 0;
+    
+public:
+    MappedFile(const std::string& filename, const std::string& kind);
+    ~MappedFile();
+    
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    
+    const uint8_t* bytes() const { return data; }
+    size_t size() const { return length; }
+};
+
 // Bit manipulation utilities
 bool getBit(uint64_t value, uint32_t bit);
 uint64_t setBit(uint64_t value, uint32_t bit, bool bitValue);
 uint64_t extractBits(uint64_t value, uint32_t start, uint32_t width);
 uint64_t signExtend(uint64_t value, uint32_t bitWidth);
 
+// Wide values, such as smdata words over 64 bits, as count little-endian
+// uint64 words: bit i is in words[i / 64]. Bits past the last word read 0.
+bool getWideBit(const uint64_t* words, uint32_t count, uint32_t bit);
+uint64_t extractWideBits(const uint64_t* words, uint32_t count, uint32_t start, uint32_t width);
+std::string wideHexString(const uint64_t* words, uint32_t count);
+
+// Packed state register: bit i of words[i / 64] is state i. Sized once from
+// NUM_STATES, so whole-register updates and comparisons work a word at a time.
+class StateBits {
+private:
+    std::vector<uint64_t> words;
+    uint32_t bitCount;
+public:
+    StateBits() : bitCount(0) {}
+    explicit StateBits(uint32_t numBits) : words((numBits + 63) / 64, 0), bitCount(numBits) {}
+    StateBits(const uint64_t* src, uint32_t numBits) : words(src, src + (numBits + 63) / 64), bitCount(numBits) {}
+    
+    uint32_t size() const { return bitCount; }
+    bool operator[](uint32_t i) const { return (words[i >> 6] >> (i & 63)) & 1ULL; }
+    void set(uint32_t i, bool value) {
+        if (value) {
+            words[i >> 6] |= 1ULL << (i & 63);
+        } else {
+            words[i >> 6] &= ~(1ULL << (i & 63));
+        }
+    }
+    void clear() { std::fill(words.begin(), words.end(), 0); }
+    
+    // states = (states & ~mask) | (value & mask), for registers of the same
+    // size; true if any bit changed
+    bool capture(const StateBits& value, const StateBits& mask) {
+        uint64_t changed = 0;
+        for (size_t w = 0; w < words.size(); ++w) {
+            uint64_t next = (words[w] & ~mask.words[w]) | (value.words[w] & mask.words[w]);
+            changed |= next ^ words[w];
+            words[w] = next;
+        }
+        return changed != 0;
+    }
+    
+    // capture() on one word, with value already masked
+    bool captureWord(size_t w, uint64_t value, uint64_t mask) {
+        uint64_t next = (words[w] & ~mask) | value;
+        bool changed = next != words[w];
+        words[w] = next;
+        return changed;
+    }
+    
+    uint32_t count() const {
+        uint32_t total = 0;
+        for (uint64_t word : words) {
+            total += __builtin_popcountll(word);
+        }
+        return total;
+    }
+    
+    const std::vector<uint64_t>& getWords() const { return words; }
+    bool operator==(const StateBits& other) const { return bitCount == other.bitCount && words == other.words; }
+    bool operator!=(const StateBits& other) const { return !(*this == other); }
+};
+
 // Error handling
 class SimulatorException : public std::exception {
 private:
@@ -0,0 +1,1304 @@
+// The hotstate Python module, built by make python: MemoryLoader, Model
+// (HotstateModel) and Simulator for test scripts that would otherwise run
+// hotstate_sim as a subprocess and parse its CSV.
+//
+// Registers and counters are handed to Python as read-only memoryviews of
+// the C++ vectors themselves, so numpy.asarray(model.states) is a view
+// that follows the model with no copy. Every view keeps its owner alive
+// and counts itself in the owner's exports; a call that would move the
+// memory (Simulator.swap_program) refuses while any view is alive, as
+// bytearray does. Runs release the GIL, so several simulations can run
+// on Python threads at once; an object is busy for the length of its run
+// and calls on it from other threads raise RuntimeError. State change
+// subscribers are Python callables, called with the GIL during the run,
+// and may set the inputs for a closed loop.
+//
+// Written against the CPython C API and the buffer protocol, with no
+// binding library or NumPy needed to build it.
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include "simulator.h"
+#include "hotstate_model.h"
+#include "memory_loader.h"
+#include "utils.h"
+#include <pythread.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace HotstateSim;
+
+namespace {
+
+PyObject* arrayType = nullptr;
+PyObject* loaderType = nullptr;
+PyObject* modelType = nullptr;
+PyObject* traceType = nullptr;
+PyObject* simulatorType = nullptr;
+
+// The start of every object that lends out its memory
+struct Owner {
+    PyObject_HEAD
+    Py_ssize_t exports;        // Live views
+    bool busy;                 // Running, with the GIL released but for subscribers
+    unsigned long busyThread;  // The thread running it
+    PyObject* errorType;       // A subscriber's exception, for the call to raise
+    PyObject* errorValue;
+    PyObject* errorTrace;
+};
+
+// For calls that clock, reset or rebuild the model
+bool claim(Owner* owner) {
+    if (owner->busy) {
+        PyErr_SetString(PyExc_RuntimeError, "object is running");
+        return false;
+    }
+    return true;
+}
+
+// For calls that only set inputs, which a subscriber may do mid-run
+bool claimInputs(Owner* owner) {
+    if (owner->busy && owner->busyThread != PyThread_get_thread_ident()) {
+        PyErr_SetString(PyExc_RuntimeError, "object is running on another thread");
+        return false;
+    }
+    return true;
+}
+
+void setBusy(Owner* owner, bool busy) {
+    owner->busy = busy;
+    owner->busyThread = PyThread_get_thread_ident();
+}
+
+// Raises the exception a subscriber stopped the call with, or message
+PyObject* raise(Owner* owner, const std::string& message) {
+    if (owner->errorType != nullptr) {
+        PyErr_Restore(owner->errorType, owner->errorValue, owner->errorTrace);
+        owner->errorType = owner->errorValue = owner->errorTrace = nullptr;
+    } else {
+        PyErr_SetString(PyExc_RuntimeError, message.c_str());
+    }
+    return nullptr;
+}
+
+void releaseOwner(Owner* owner) {
+    Py_XDECREF(owner->errorType);
+    Py_XDECREF(owner->errorValue);
+    Py_XDECREF(owner->errorTrace);
+}
+
+template <typename T>
+PyCFunction method(T* function) {
+    return reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)(void)>(function));
+}
+
+template <typename T>
+void* slot(T* function) {
+    return reinterpret_cast<void*>(function);
+}
+
+void freeObject(PyObject* self) {
+    PyTypeObject* type = Py_TYPE(self);
+    type->tp_free(self);
+    Py_DECREF(type);
+}
+
+// ---------------------------------------------------------------------
+// Views: the exporter behind each memoryview, one or two dimensions of
+// C-contiguous items
+// ---------------------------------------------------------------------
+
+struct ArrayObject {
+    PyObject_HEAD
+    Owner* owner;
+    void* data;
+    const char* format;
+    Py_ssize_t itemsize;
+    int ndim;
+    Py_ssize_t shape[2];
+    Py_ssize_t strides[2];
+};
+
+int arrayGetBuffer(PyObject* self, Py_buffer* view, int flags) {
+    ArrayObject* array = reinterpret_cast<ArrayObject*>(self);
+    if (flags & PyBUF_WRITABLE) {
+        PyErr_SetString(PyExc_BufferError, "hotstate views are read-only");
+        view->obj = nullptr;
+        return -1;
+    }
+    view->buf = array->data;
+    view->obj = self;
+    Py_INCREF(self);
+    view->len = array->shape[0] * (array->ndim == 2 ? array->shape[1] : 1) * array->itemsize;
+    view->readonly = 1;
+    view->itemsize = array->itemsize;
+    view->format = (flags & PyBUF_FORMAT) ? const_cast<char*>(array->format) : nullptr;
+    view->ndim = array->ndim;
+    view->shape = (flags & PyBUF_ND) ? array->shape : nullptr;
+    view->strides = (flags & PyBUF_STRIDES) ? array->strides : nullptr;
+    view->suboffsets = nullptr;
+    view->internal = nullptr;
+    return 0;
+}
+
+void arrayDealloc(PyObject* self) {
+    ArrayObject* array = reinterpret_cast<ArrayObject*>(self);
+    array->owner->exports--;
+    Py_DECREF(array->owner);
+    freeObject(self);
+}
+
+// A memoryview of rows x cols items at data (cols 0 for one dimension)
+template <typename T>
+PyObject* makeView(Owner* owner, const T* data, const char* format, size_t rows, size_t cols = 0) {
+    static T empty[1] = {};
+    PyTypeObject* type = reinterpret_cast<PyTypeObject*>(arrayType);
+    ArrayObject* array = reinterpret_cast<ArrayObject*>(type->tp_alloc(type, 0));
+    if (array == nullptr) {
+        return nullptr;
+    }
+    Py_INCREF(owner);
+    owner->exports++;
+    array->owner = owner;
+    array->data = const_cast<T*>(data != nullptr ? data : empty);
+    array->format = format;
+    array->itemsize = sizeof(T);
+    array->ndim = cols == 0 ? 1 : 2;
+    array->shape[0] = static_cast<Py_ssize_t>(rows);
+    array->shape[1] = static_cast<Py_ssize_t>(cols);
+    array->strides[0] = static_cast<Py_ssize_t>(sizeof(T) * (cols == 0 ? 1 : cols));
+    array->strides[1] = static_cast<Py_ssize_t>(sizeof(T));
+    PyObject* view = PyMemoryView_FromObject(reinterpret_cast<PyObject*>(array));
+    Py_DECREF(array);
+    return view;
+}
+
+PyObject* viewOf(Owner* owner, const std::vector<uint8_t>& data) {
+    return makeView(owner, data.data(), "B", data.size());
+}
+
+PyObject* viewOf(Owner* owner, const std::vector<uint32_t>& data) {
+    return makeView(owner, data.data(), "I", data.size());
+}
+
+PyObject* viewOf(Owner* owner, const std::vector<uint64_t>& data) {
+    return makeView(owner, data.data(), "Q", data.size());
+}
+
+// ---------------------------------------------------------------------
+// Shared helpers
+// ---------------------------------------------------------------------
+
+std::vector<std::string> stringList(PyObject* sequence, const char* what) {
+    std::vector<std::string> strings;
+    if (sequence == nullptr || sequence == Py_None) {
+        return strings;
+    }
+    PyObject* fast = PySequence_Fast(sequence, what);
+    if (fast == nullptr) {
+        throw SimulatorException("");
+    }
+    for (Py_ssize_t i = 0; i < PySequence_Fast_GET_SIZE(fast); ++i) {
+        const char* text = PyUnicode_AsUTF8(PySequence_Fast_GET_ITEM(fast, i));
+        if (text == nullptr) {
+            Py_DECREF(fast);
+            throw SimulatorException("");
+        }
+        strings.push_back(text);
+    }
+    Py_DECREF(fast);
+    return strings;
+}
+
+std::vector<uint32_t> indexList(PyObject* sequence, const char* what) {
+    std::vector<uint32_t> values;
+    if (sequence == nullptr || sequence == Py_None) {
+        return values;
+    }
+    PyObject* fast = PySequence_Fast(sequence, what);
+    if (fast == nullptr) {
+        throw SimulatorException("");
+    }
+    for (Py_ssize_t i = 0; i < PySequence_Fast_GET_SIZE(fast); ++i) {
+        unsigned long value = PyLong_AsUnsignedLong(PySequence_Fast_GET_ITEM(fast, i));
+        if (PyErr_Occurred()) {
+            Py_DECREF(fast);
+            throw SimulatorException("");
+        }
+        values.push_back(static_cast<uint32_t>(value));
+    }
+    Py_DECREF(fast);
+    return values;
+}
+
+// The input a Python index or symbol name refers to, or UINT32_MAX with
+// an exception set
+uint32_t inputIndex(const MemoryLoader& memory, PyObject* key) {
+    uint32_t count = memory.getParams().NUM_VARS;
+    if (PyUnicode_Check(key)) {
+        const char* name = PyUnicode_AsUTF8(key);
+        uint32_t index = name != nullptr ? memory.getInputIndexByName(name) : UINT32_MAX;
+        if (name != nullptr && index == UINT32_MAX) {
+            PyErr_Format(PyExc_KeyError, "no input named '%s'", name);
+        }
+        return index;
+    }
+    unsigned long index = PyLong_AsUnsignedLong(key);
+    if (PyErr_Occurred()) {
+        return UINT32_MAX;
+    }
+    if (index >= count) {
+        PyErr_Format(PyExc_IndexError, "input %lu out of range (%u inputs)", index, count);
+        return UINT32_MAX;
+    }
+    return static_cast<uint32_t>(index);
+}
+
+// One byte per input from a bytes-like object or a sequence of ints
+bool readInputs(PyObject* values, uint32_t count, std::vector<uint8_t>& inputs) {
+    inputs.assign(count, 0);
+    if (PyObject_CheckBuffer(values)) {
+        Py_buffer buffer;
+        if (PyObject_GetBuffer(values, &buffer, PyBUF_C_CONTIGUOUS) < 0) {
+            return false;
+        }
+        bool ok = buffer.itemsize == 1 && buffer.len == static_cast<Py_ssize_t>(count);
+        if (ok) {
+            const uint8_t* bytes = static_cast<const uint8_t*>(buffer.buf);
+            inputs.assign(bytes, bytes + count);
+        } else {
+            PyErr_Format(PyExc_ValueError, "inputs need %u one-byte items", count);
+        }
+        PyBuffer_Release(&buffer);
+        return ok;
+    }
+    PyObject* fast = PySequence_Fast(values, "inputs must be a sequence or a bytes-like object");
+    if (fast == nullptr) {
+        return false;
+    }
+    bool ok = PySequence_Fast_GET_SIZE(fast) == static_cast<Py_ssize_t>(count);
+    if (!ok) {
+        PyErr_Format(PyExc_ValueError, "inputs need %u values", count);
+    }
+    for (uint32_t i = 0; ok && i < count; ++i) {
+        long value = PyLong_AsLong(PySequence_Fast_GET_ITEM(fast, i));
+        ok = !PyErr_Occurred();
+        inputs[i] = static_cast<uint8_t>(value);
+    }
+    Py_DECREF(fast);
+    return ok;
+}
+
+// The changed bits as one int, bit i for state i
+PyObject* maskToInt(const std::vector<uint64_t>& words) {
+    PyObject* mask = PyLong_FromLong(0);
+    PyObject* shift = PyLong_FromLong(64);
+    for (size_t w = words.size(); w-- > 0 && mask != nullptr;) {
+        PyObject* shifted = PyNumber_Lshift(mask, shift);
+        PyObject* word = PyLong_FromUnsignedLongLong(words[w]);
+        Py_DECREF(mask);
+        mask = shifted != nullptr && word != nullptr ? PyNumber_Or(shifted, word) : nullptr;
+        Py_XDECREF(shifted);
+        Py_XDECREF(word);
+    }
+    Py_XDECREF(shift);
+    return mask;
+}
+
+// A subscriber that calls function(cycle, changed) with the GIL held. An
+// exception stops the run at that edge and is kept in owner for the call
+// to raise.
+StateChangeCallback pythonSubscriber(Owner* owner, PyObject* function) {
+    Py_INCREF(function);
+    std::shared_ptr<PyObject> held(function, [](PyObject* callable) {
+        PyGILState_STATE gil = PyGILState_Ensure();
+        Py_DECREF(callable);
+        PyGILState_Release(gil);
+    });
+    return [owner, held](uint64_t cycle, const StateBits&, const std::vector<uint64_t>& changed) {
+        PyGILState_STATE gil = PyGILState_Ensure();
+        PyObject* mask = maskToInt(changed);
+        PyObject* result = mask != nullptr ? PyObject_CallFunction(held.get(), "KO", cycle, mask) : nullptr;
+        Py_XDECREF(mask);
+        bool failed = result == nullptr;
+        Py_XDECREF(result);
+        if (failed && owner->errorType == nullptr) {
+            PyErr_Fetch(&owner->errorType, &owner->errorValue, &owner->errorTrace);
+        } else if (failed) {
+            PyErr_Clear();
+        }
+        PyGILState_Release(gil);
+        if (failed) {
+            throw SimulatorException("A state change subscriber raised an exception");
+        }
+    };
+}
+
+// ---------------------------------------------------------------------
+// MemoryLoader: one loaded program, fixed once constructed so that models
+// can refer to its memories
+// ---------------------------------------------------------------------
+
+struct LoaderObject {
+    Owner owner;
+    MemoryLoader* memory;
+};
+
+#define PARAMETER(name) {#name, &Parameters::name}
+const struct {
+    const char* name;
+    uint32_t Parameters::* field;
+} PARAMETER_FIELDS[] = {
+    PARAMETER(STATE_WIDTH), PARAMETER(MASK_WIDTH), PARAMETER(JADR_WIDTH), PARAMETER(VARSEL_WIDTH),
+    PARAMETER(TIMERSEL_WIDTH), PARAMETER(TIMERLD_WIDTH), PARAMETER(SWITCH_SEL_WIDTH),
+    PARAMETER(SWITCH_ADR_WIDTH), PARAMETER(STATE_CAPTURE_WIDTH), PARAMETER(VAR_OR_TIMER_WIDTH),
+    PARAMETER(BRANCH_WIDTH), PARAMETER(FORCED_JMP_WIDTH), PARAMETER(SUB_WIDTH), PARAMETER(RTN_WIDTH),
+    PARAMETER(INSTR_WIDTH), PARAMETER(NUM_STATES), PARAMETER(NUM_VARSEL), PARAMETER(NUM_VARSEL_BITS),
+    PARAMETER(NUM_VARS), PARAMETER(NUM_TIMERS), PARAMETER(NUM_SWITCHES), PARAMETER(SWITCH_OFFSET_BITS),
+    PARAMETER(SWITCH_MEM_WORDS), PARAMETER(NUM_SWITCH_BITS), PARAMETER(NUM_ADR_BITS), PARAMETER(NUM_WORDS),
+    PARAMETER(TIM_WIDTH), PARAMETER(TIM_MEM_WORDS), PARAMETER(NUM_CTL_BITS), PARAMETER(SMDATA_WIDTH),
+    PARAMETER(STACK_DEPTH), PARAMETER(SMDATA_WORDS), PARAMETER(VARDATA_WORD_BITS),
+    PARAMETER(INTERRUPT_ADDRESS), PARAMETER(PIPELINED),
+};
+#undef PARAMETER
+
+PyObject* loaderNew(PyTypeObject* type, PyObject* args, PyObject* kwargs) {
+    static const char* keywords[] = {"base", "source", nullptr};
+    const char* base = "";
+    const char* source = "";
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|zz", const_cast<char**>(keywords), &base, &source)) {
+        return nullptr;
+    }
+    std::string basePath = base != nullptr ? base : "";
+    std::string sourceFile = source != nullptr ? source : "";
+    if (basePath.empty() && sourceFile.empty()) {
+        PyErr_SetString(PyExc_TypeError, "MemoryLoader needs base or source");
+        return nullptr;
+    }
+    if (basePath.empty()) {
+        basePath = getBaseFilename(sourceFile);
+    }
+
+    LoaderObject* self = reinterpret_cast<LoaderObject*>(type->tp_alloc(type, 0));
+    if (self == nullptr) {
+        return nullptr;
+    }
+    self->memory = new MemoryLoader();
+    bool loaded;
+    Py_BEGIN_ALLOW_THREADS
+    loaded = self->memory->loadProgram(basePath, sourceFile) && self->memory->isLoaded();
+    Py_END_ALLOW_THREADS
+    if (!loaded) {
+        PyErr_Format(PyExc_RuntimeError, "failed to load %s", (sourceFile.empty() ? basePath : sourceFile).c_str());
+        Py_DECREF(self);
+        return nullptr;
+    }
+    return reinterpret_cast<PyObject*>(self);
+}
+
+void loaderDealloc(PyObject* self) {
+    delete reinterpret_cast<LoaderObject*>(self)->memory;
+    releaseOwner(reinterpret_cast<Owner*>(self));
+    freeObject(self);
+}
+
+PyObject* loaderParams(PyObject* self, void*) {
+    const Parameters& params = reinterpret_cast<LoaderObject*>(self)->memory->getParams();
+    PyObject* dict = PyDict_New();
+    for (const auto& field : PARAMETER_FIELDS) {
+        PyObject* value = PyLong_FromUnsignedLong(params.*field.field);
+        if (value == nullptr || PyDict_SetItemString(dict, field.name, value) < 0) {
+            Py_XDECREF(value);
+            Py_DECREF(dict);
+            return nullptr;
+        }
+        Py_DECREF(value);
+    }
+    return dict;
+}
+
+PyObject* nameList(const MemoryLoader& memory, uint32_t count, bool inputs) {
+    PyObject* list = PyList_New(count);
+    for (uint32_t i = 0; list != nullptr && i < count; ++i) {
+        const std::string& name = inputs ? memory.getInputNameByIndex(i) : memory.getStateNameByIndex(i);
+        PyList_SET_ITEM(list, i, PyUnicode_FromString(name.c_str()));
+    }
+    return list;
+}
+
+PyObject* loaderInputNames(PyObject* self, void*) {
+    const MemoryLoader& memory = *reinterpret_cast<LoaderObject*>(self)->memory;
+    return nameList(memory, memory.getParams().NUM_VARS, true);
+}
+
+PyObject* loaderStateNames(PyObject* self, void*) {
+    const MemoryLoader& memory = *reinterpret_cast<LoaderObject*>(self)->memory;
+    return nameList(memory, memory.getParams().NUM_STATES, false);
+}
+
+PyObject* loaderFingerprint(PyObject* self, void*) {
+    return PyLong_FromUnsignedLongLong(reinterpret_cast<LoaderObject*>(self)->memory->fingerprint());
+}
+
+PyObject* loaderVardata(PyObject* self, void*) {
+    return viewOf(reinterpret_cast<Owner*>(self), reinterpret_cast<LoaderObject*>(self)->memory->getVardata());
+}
+
+PyObject* loaderSwitchdata(PyObject* self, void*) {
+    return viewOf(reinterpret_cast<Owner*>(self), reinterpret_cast<LoaderObject*>(self)->memory->getSwitchdata());
+}
+
+PyObject* loaderTimdata(PyObject* self, void*) {
+    return viewOf(reinterpret_cast<Owner*>(self), reinterpret_cast<LoaderObject*>(self)->memory->getTimdata());
+}
+
+PyObject* loaderSmdata(PyObject* self, void*) {
+    const MemoryLoader& memory = *reinterpret_cast<LoaderObject*>(self)->memory;
+    return makeView(reinterpret_cast<Owner*>(self), memory.getSmdata().data(), "Q", memory.getSmdataSize(),
+                    memory.getSmdataWords());
+}
+
+PyObject* loaderInputIndex(PyObject* self, PyObject* name) {
+    uint32_t index = inputIndex(*reinterpret_cast<LoaderObject*>(self)->memory, name);
+    return index == UINT32_MAX ? nullptr : PyLong_FromUnsignedLong(index);
+}
+
+PyObject* loaderStateIndex(PyObject* self, PyObject* name) {
+    const char* text = PyUnicode_AsUTF8(name);
+    if (text == nullptr) {
+        return nullptr;
+    }
+    uint32_t index = reinterpret_cast<LoaderObject*>(self)->memory->getStateIndexByName(text);
+    if (index == UINT32_MAX) {
+        PyErr_Format(PyExc_KeyError, "no state named '%s'", text);
+        return nullptr;
+    }
+    return PyLong_FromUnsignedLong(index);
+}
+
+PyMethodDef loaderMethods[] = {
+    {"input_index", method(loaderInputIndex), METH_O, "The input with a symbol name"},
+    {"state_index", method(loaderStateIndex), METH_O, "The state with a symbol name"},
+    {nullptr, nullptr, 0, nullptr}
+};
+
+PyGetSetDef loaderGetters[] = {
+    {"params", loaderParams, nullptr, "The _params.vh parameters, by name", nullptr},
+    {"input_names", loaderInputNames, nullptr, "Symbol name of each input, '' if unnamed", nullptr},
+    {"state_names", loaderStateNames, nullptr, "Symbol name of each state, '' if unnamed", nullptr},
+    {"fingerprint", loaderFingerprint, nullptr, "Hash of the parameters and memories", nullptr},
+    {"vardata", loaderVardata, nullptr, "The vardata memory (uint32 view)", nullptr},
+    {"switchdata", loaderSwitchdata, nullptr, "The switchdata memory (uint32 view)", nullptr},
+    {"timdata", loaderTimdata, nullptr, "The timer reload values (uint32 view)", nullptr},
+    {"smdata", loaderSmdata, nullptr, "The microcode, one row of uint64 words per entry", nullptr},
+    {nullptr, nullptr, nullptr, nullptr, nullptr}
+};
+
+PyType_Slot loaderSlots[] = {
+    {Py_tp_new, slot(loaderNew)},
+    {Py_tp_dealloc, slot(loaderDealloc)},
+    {Py_tp_methods, loaderMethods},
+    {Py_tp_getset, loaderGetters},
+    {Py_tp_doc, const_cast<char*>("MemoryLoader(base=None, source=None): a program loaded from BASE's files, "
+                                  "or compiled from a C source in-process")},
+    {0, nullptr}
+};
+
+// ---------------------------------------------------------------------
+// Trace: what Model.run(trace=True) recorded, owned by the trace itself
+// ---------------------------------------------------------------------
+
+struct TraceObject {
+    Owner owner;
+    std::vector<uint64_t>* states;     // words per period
+    std::vector<uint32_t>* addresses;  // One per period
+    uint32_t words;
+};
+
+void traceDealloc(PyObject* self) {
+    TraceObject* trace = reinterpret_cast<TraceObject*>(self);
+    delete trace->states;
+    delete trace->addresses;
+    freeObject(self);
+}
+
+PyObject* traceStates(PyObject* self, void*) {
+    TraceObject* trace = reinterpret_cast<TraceObject*>(self);
+    return makeView(&trace->owner, trace->states->data(), "Q", trace->addresses->size(), trace->words);
+}
+
+PyObject* traceAddresses(PyObject* self, void*) {
+    TraceObject* trace = reinterpret_cast<TraceObject*>(self);
+    return viewOf(&trace->owner, *trace->addresses);
+}
+
+Py_ssize_t traceLength(PyObject* self) {
+    return static_cast<Py_ssize_t>(reinterpret_cast<TraceObject*>(self)->addresses->size());
+}
+
+PyGetSetDef traceGetters[] = {
+    {"states", traceStates, nullptr, "State register after each period, one row of uint64 words per period", nullptr},
+    {"addresses", traceAddresses, nullptr, "Microcode address after each period (uint32 view)", nullptr},
+    {nullptr, nullptr, nullptr, nullptr, nullptr}
+};
+
+PyType_Slot traceSlots[] = {
+    {Py_tp_dealloc, slot(traceDealloc)},
+    {Py_tp_getset, traceGetters},
+    {Py_sq_length, slot(traceLength)},
+    {Py_tp_doc, const_cast<char*>("The registers after each period of a Model.run(trace=True)")},
+    {0, nullptr}
+};
+
+// ---------------------------------------------------------------------
+// Model: a HotstateModel of a MemoryLoader's program
+// ---------------------------------------------------------------------
+
+struct ModelObject {
+    Owner owner;
+    LoaderObject* loader;
+    HotstateModel* model;
+    std::vector<uint8_t>* outputs;  // getOutputs(), refreshed after every call that clocks
+
+    HotstateModel* target() { return model; }
+};
+
+void refreshOutputs(ModelObject* self) {
+    self->model->copyOutputs(self->outputs->data());
+}
+
+PyObject* modelNew(PyTypeObject* type, PyObject* args, PyObject* kwargs) {
+    static const char* keywords[] = {"loader", nullptr};
+    PyObject* loader;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O!", const_cast<char**>(keywords),
+                                     reinterpret_cast<PyTypeObject*>(loaderType), &loader)) {
+        return nullptr;
+    }
+    ModelObject* self = reinterpret_cast<ModelObject*>(type->tp_alloc(type, 0));
+    if (self == nullptr) {
+        return nullptr;
+    }
+    Py_INCREF(loader);
+    self->loader = reinterpret_cast<LoaderObject*>(loader);
+    try {
+        self->model = new HotstateModel(*self->loader->memory);
+    } catch (const SimulatorException& e) {
+        PyErr_SetString(PyExc_RuntimeError, e.what());
+        Py_DECREF(self);
+        return nullptr;
+    }
+    self->model->reset();
+    self->model->setReset(false);
+    self->outputs = new std::vector<uint8_t>(self->model->getNumOutputs());
+    refreshOutputs(self);
+    return reinterpret_cast<PyObject*>(self);
+}
+
+void modelDealloc(PyObject* self) {
+    ModelObject* model = reinterpret_cast<ModelObject*>(self);
+    delete model->model;
+    delete model->outputs;
+    Py_XDECREF(model->loader);
+    releaseOwner(&model->owner);
+    freeObject(self);
+}
+
+PyObject* modelReset(PyObject* self, PyObject*) {
+    ModelObject* model = reinterpret_cast<ModelObject*>(self);
+    if (!claim(&model->owner)) {
+        return nullptr;
+    }
+    try {
+        model->model->reset();
+    } catch (const SimulatorException& e) {
+        return raise(&model->owner, e.what());
+    }
+    refreshOutputs(model);
+    Py_RETURN_NONE;
+}
+
+PyObject* modelClock(PyObject* self, PyObject*) {
+    ModelObject* model = reinterpret_cast<ModelObject*>(self);
+    if (!claim(&model->owner)) {
+        return nullptr;
+    }
+    try {
+        model->model->clock();
+    } catch (const SimulatorException& e) {
+        refreshOutputs(model);
+        return raise(&model->owner, e.what());
+    }
+    refreshOutputs(model);
+    Py_RETURN_NONE;
+}
+
+// run(periods, inputs=None, trace=False): whole clock periods with the GIL
+// released. inputs, if given, is a C-contiguous bytes-like object of
+// periods x NUM_VARS bytes, one row applied before each period.
+PyObject* modelRun(PyObject* self, PyObject* args, PyObject* kwargs) {
+    static const char* keywords[] = {"periods", "inputs", "trace", nullptr};
+    ModelObject* model = reinterpret_cast<ModelObject*>(self);
+    unsigned long long periods;
+    PyObject* inputs = Py_None;
+    int trace = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "K|Op", const_cast<char**>(keywords), &periods, &inputs, &trace) ||
+        !claim(&model->owner)) {
+        return nullptr;
+    }
+    HotstateModel& hotstate = *model->model;
+    uint32_t numInputs = static_cast<uint32_t>(hotstate.getInputs().size());
+
+    Py_buffer stimulus;
+    stimulus.obj = nullptr;
+    if (inputs != Py_None) {
+        if (PyObject_GetBuffer(inputs, &stimulus, PyBUF_C_CONTIGUOUS) < 0) {
+            return nullptr;
+        }
+        if (stimulus.itemsize != 1 || stimulus.len != static_cast<Py_ssize_t>(periods * numInputs)) {
+            PyBuffer_Release(&stimulus);
+            PyErr_Format(PyExc_ValueError, "inputs need periods x %u one-byte items", numInputs);
+            return nullptr;
+        }
+    }
+
+    TraceObject* recorded = nullptr;
+    if (trace) {
+        PyTypeObject* type = reinterpret_cast<PyTypeObject*>(traceType);
+        recorded = reinterpret_cast<TraceObject*>(type->tp_alloc(type, 0));
+        if (recorded == nullptr) {
+            if (stimulus.obj != nullptr) {
+                PyBuffer_Release(&stimulus);
+            }
+            return nullptr;
+        }
+        recorded->words = static_cast<uint32_t>(hotstate.getStates().getWords().size());
+        recorded->states = new std::vector<uint64_t>();
+        recorded->addresses = new std::vector<uint32_t>();
+        recorded->states->reserve(periods * recorded->words);
+        recorded->addresses->reserve(periods);
+    }
+
+    std::string error;
+    setBusy(&model->owner, true);
+    Py_BEGIN_ALLOW_THREADS
+    try {
+        if (stimulus.obj == nullptr && recorded == nullptr) {
+            hotstate.run(periods);
+        } else {
+            std::vector<uint8_t> row(numInputs);
+            const uint8_t* next = stimulus.obj != nullptr ? static_cast<const uint8_t*>(stimulus.buf) : nullptr;
+            for (unsigned long long i = 0; i < periods; ++i) {
+                if (next != nullptr) {
+                    row.assign(next, next + numInputs);
+                    hotstate.setInputs(row);
+                    next += numInputs;
+                }
+                hotstate.run(1);
+                if (recorded != nullptr) {
+                    const std::vector<uint64_t>& words = hotstate.getStates().getWords();
+                    recorded->states->insert(recorded->states->end(), words.begin(), words.end());
+                    recorded->addresses->push_back(hotstate.getCurrentAddress());
+                }
+            }
+        }
+    } catch (const SimulatorException& e) {
+        error = e.what();
+    }
+    Py_END_ALLOW_THREADS
+    setBusy(&model->owner, false);
+
+    if (stimulus.obj != nullptr) {
+        PyBuffer_Release(&stimulus);
+    }
+    refreshOutputs(model);
+    if (!error.empty()) {
+        Py_XDECREF(recorded);
+        return raise(&model->owner, error);
+    }
+    if (recorded != nullptr) {
+        return reinterpret_cast<PyObject*>(recorded);
+    }
+    Py_RETURN_NONE;
+}
+
+PyObject* modelSetInputs(PyObject* self, PyObject* values) {
+    ModelObject* model = reinterpret_cast<ModelObject*>(self);
+    std::vector<uint8_t> inputs;
+    if (!claimInputs(&model->owner) ||
+        !readInputs(values, static_cast<uint32_t>(model->model->getInputs().size()), inputs)) {
+        return nullptr;
+    }
+    model->model->setInputs(inputs);
+    Py_RETURN_NONE;
+}
+
+PyObject* modelSetInput(PyObject* self, PyObject* args) {
+    ModelObject* model = reinterpret_cast<ModelObject*>(self);
+    PyObject* key;
+    int value;
+    if (!PyArg_ParseTuple(args, "Oi", &key, &value) || !claimInputs(&model->owner)) {
+        return nullptr;
+    }
+    uint32_t index = inputIndex(*model->loader->memory, key);
+    if (index == UINT32_MAX) {
+        return nullptr;
+    }
+    std::vector<uint8_t> inputs = model->model->getInputs();
+    if (index < inputs.size()) {
+        inputs[index] = static_cast<uint8_t>(value);
+        model->model->setInputs(inputs);
+    }
+    Py_RETURN_NONE;
+}
+
+// set_reset, set_halt and set_interrupt: one level each
+template <void (HotstateModel::*Setter)(bool)>
+PyObject* modelSetLevel(PyObject* self, PyObject* level) {
+    ModelObject* model = reinterpret_cast<ModelObject*>(self);
+    int value = PyObject_IsTrue(level);
+    if (value < 0 || !claimInputs(&model->owner)) {
+        return nullptr;
+    }
+    (model->model->*Setter)(value != 0);
+    Py_RETURN_NONE;
+}
+
+PyObject* modelEnableProfiling(PyObject* self, PyObject*) {
+    ModelObject* model = reinterpret_cast<ModelObject*>(self);
+    if (!claim(&model->owner)) {
+        return nullptr;
+    }
+    // Enabling again would clear the counters under any views of them
+    if (!model->model->isProfiling()) {
+        model->model->enableProfiling();
+    }
+    Py_RETURN_NONE;
+}
+
+// subscribe(function): function(cycle, changed) after every change of the
+// states; returns the id for unsubscribe
+template <typename Object>
+PyObject* subscribe(PyObject* self, PyObject* function) {
+    Object* object = reinterpret_cast<Object*>(self);
+    if (!PyCallable_Check(function)) {
+        PyErr_SetString(PyExc_TypeError, "subscribe needs a callable");
+        return nullptr;
+    }
+    if (!claim(&object->owner)) {
+        return nullptr;
+    }
+    uint32_t id = object->target()->subscribeStates(pythonSubscriber(&object->owner, function));
+    return PyLong_FromUnsignedLong(id);
+}
+
+template <typename Object>
+PyObject* unsubscribe(PyObject* self, PyObject* id) {
+    Object* object = reinterpret_cast<Object*>(self);
+    unsigned long value = PyLong_AsUnsignedLong(id);
+    if (PyErr_Occurred() || !claim(&object->owner)) {
+        return nullptr;
+    }
+    object->target()->unsubscribeStates(static_cast<uint32_t>(value));
+    Py_RETURN_NONE;
+}
+
+PyObject* modelStates(PyObject* self, void*) {
+    ModelObject* model = reinterpret_cast<ModelObject*>(self);
+    return viewOf(&model->owner, model->model->getStates().getWords());
+}
+
+PyObject* modelOutputs(PyObject* self, void*) {
+    ModelObject* model = reinterpret_cast<ModelObject*>(self);
+    return viewOf(&model->owner, *model->outputs);
+}
+
+PyObject* modelInputs(PyObject* self, void*) {
+    ModelObject* model = reinterpret_cast<ModelObject*>(self);
+    return viewOf(&model->owner, model->model->getInputs());
+}
+
+PyObject* modelTimerCounts(PyObject* self, void*) {
+    ModelObject* model = reinterpret_cast<ModelObject*>(self);
+    return viewOf(&model->owner, model->model->getTimerCounts());
+}
+
+template <const std::vector<uint64_t>& (HotstateModel::*Counts)() const>
+PyObject* modelProfileCounts(PyObject* self, void*) {
+    ModelObject* model = reinterpret_cast<ModelObject*>(self);
+    if (!model->model->isProfiling()) {
+        Py_RETURN_NONE;
+    }
+    return viewOf(&model->owner, (model->model->*Counts)());
+}
+
+PyObject* modelAddress(PyObject* self, void*) {
+    return PyLong_FromUnsignedLong(reinterpret_cast<ModelObject*>(self)->model->getCurrentAddress());
+}
+
+PyObject* modelCycle(PyObject* self, void*) {
+    return PyLong_FromUnsignedLongLong(reinterpret_cast<ModelObject*>(self)->model->getCycleCount());
+}
+
+PyObject* modelLoader(PyObject* self, void*) {
+    PyObject* loader = reinterpret_cast<PyObject*>(reinterpret_cast<ModelObject*>(self)->loader);
+    Py_INCREF(loader);
+    return loader;
+}
+
+PyMethodDef modelMethods[] = {
+    {"reset", method(modelReset), METH_NOARGS, "Every register to its reset value"},
+    {"clock", method(modelClock), METH_NOARGS, "One clock edge; a period is two"},
+    {"run", method(modelRun), METH_VARARGS | METH_KEYWORDS,
+     "run(periods, inputs=None, trace=False): whole clock periods with the GIL released; inputs is "
+     "periods x NUM_VARS bytes applied a row per period, and trace=True returns a Trace"},
+    {"set_inputs", method(modelSetInputs), METH_O, "Every input, from a sequence or bytes-like object"},
+    {"set_input", method(modelSetInput), METH_VARARGS, "set_input(index or name, value)"},
+    {"set_reset", method(modelSetLevel<&HotstateModel::setReset>), METH_O, "The reset input"},
+    {"set_halt", method(modelSetLevel<&HotstateModel::setHalt>), METH_O, "The halt input"},
+    {"set_interrupt", method(modelSetLevel<&HotstateModel::setInterrupt>), METH_O, "The interrupt input"},
+    {"enable_profiling", method(modelEnableProfiling), METH_NOARGS, "Count the edges at each address"},
+    {"subscribe", method(subscribe<ModelObject>), METH_O,
+     "subscribe(function): call function(cycle, changed) after each edge that changes the states; "
+     "changed is an int of the changed bits. Returns an id for unsubscribe"},
+    {"unsubscribe", method(unsubscribe<ModelObject>), METH_O, "unsubscribe(id)"},
+    {nullptr, nullptr, 0, nullptr}
+};
+
+PyGetSetDef modelGetters[] = {
+    {"states", modelStates, nullptr, "The state register, as uint64 words (bit i is state i)", nullptr},
+    {"outputs", modelOutputs, nullptr, "One byte per state (uint8 view)", nullptr},
+    {"inputs", modelInputs, nullptr, "One byte per input (uint8 view)", nullptr},
+    {"timer_counts", modelTimerCounts, nullptr, "The timer counts (uint32 view)", nullptr},
+    {"address_hits", modelProfileCounts<&HotstateModel::getAddressHits>, nullptr,
+     "Edges executed at each address, or None without profiling", nullptr},
+    {"branch_taken", modelProfileCounts<&HotstateModel::getBranchTaken>, nullptr,
+     "Taken count of each branch word, or None without profiling", nullptr},
+    {"branch_not_taken", modelProfileCounts<&HotstateModel::getBranchNotTaken>, nullptr,
+     "Not-taken count of each branch word, or None without profiling", nullptr},
+    {"address", modelAddress, nullptr, "The microcode address", nullptr},
+    {"cycle", modelCycle, nullptr, "Clock edges since construction", nullptr},
+    {"loader", modelLoader, nullptr, "The MemoryLoader of the program", nullptr},
+    {nullptr, nullptr, nullptr, nullptr, nullptr}
+};
+
+PyType_Slot modelSlots[] = {
+    {Py_tp_new, slot(modelNew)},
+    {Py_tp_dealloc, slot(modelDealloc)},
+    {Py_tp_methods, modelMethods},
+    {Py_tp_getset, modelGetters},
+    {Py_tp_doc, const_cast<char*>("Model(loader): the hotstate machine of a program, out of reset with the "
+                                  "clock low")},
+    {0, nullptr}
+};
+
+// ---------------------------------------------------------------------
+// Simulator: a whole hotstate_sim run, with stimulus, breakpoints and
+// logging as the command line would set them up
+// ---------------------------------------------------------------------
+
+struct SimulatorObject {
+    Owner owner;
+    Simulator* simulator;
+
+    Simulator* target() { return simulator; }
+};
+
+const struct {
+    const char* name;
+    OutputFormat format;
+} OUTPUT_FORMATS[] = {
+    {"console", OutputFormat::CONSOLE}, {"vcd", OutputFormat::VCD}, {"csv", OutputFormat::CSV},
+    {"json", OutputFormat::JSON}, {"trace", OutputFormat::TRACE},
+};
+
+PyObject* simulatorNew(PyTypeObject* type, PyObject* args, PyObject* kwargs) {
+    static const char* keywords[] = {"base", "source", "stimulus", "max_cycles", "random_seed", "random_inputs",
+                                     "breakpoint_states", "breakpoint_addresses", "break_if", "profile",
+                                     "output", "format", "log_window", "checkpoint_every", "fast_forward",
+                                     nullptr};
+    const char* base = nullptr;
+    const char* source = nullptr;
+    const char* stimulus = nullptr;
+    unsigned long long maxCycles = 1000;
+    PyObject* seed = Py_None;
+    PyObject* randomInputs = nullptr;
+    PyObject* breakStates = nullptr;
+    PyObject* breakAddresses = nullptr;
+    PyObject* breakIf = nullptr;
+    int profile = 0;
+    const char* output = nullptr;
+    const char* format = "csv";
+    unsigned int logWindow = 10000;
+    unsigned int checkpointEvery = 0;
+    int fastForward = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|zzzKOOOOOpzsIIp", const_cast<char**>(keywords), &base,
+                                     &source, &stimulus, &maxCycles, &seed, &randomInputs, &breakStates,
+                                     &breakAddresses, &breakIf, &profile, &output, &format, &logWindow,
+                                     &checkpointEvery, &fastForward)) {
+        return nullptr;
+    }
+
+    SimulatorConfig config;
+    config.basePath = base != nullptr ? base : "";
+    config.sourceFile = source != nullptr ? source : "";
+    if (config.basePath.empty() && config.sourceFile.empty()) {
+        PyErr_SetString(PyExc_TypeError, "Simulator needs base or source");
+        return nullptr;
+    }
+    if (config.basePath.empty()) {
+        config.basePath = getBaseFilename(config.sourceFile);
+    }
+    config.stimulusFile = stimulus != nullptr ? stimulus : "";
+    config.maxCycles = maxCycles;
+    config.realTimeOutput = false;
+    config.profileFile = profile ? "-" : "";
+    config.logWindow = logWindow;
+    config.checkpointInterval = checkpointEvery;
+    config.fastForward = fastForward != 0;
+    // No console logging from a script: only a file logs
+    config.logging = output != nullptr;
+    if (output != nullptr) {
+        config.outputFile = output;
+        config.outputFormat = OutputFormat::CONSOLE;
+        bool known = false;
+        for (const auto& entry : OUTPUT_FORMATS) {
+            if (format == std::string(entry.name)) {
+                config.outputFormat = entry.format;
+                known = true;
+            }
+        }
+        if (!known) {
+            PyErr_Format(PyExc_ValueError, "invalid output format: %s", format);
+            return nullptr;
+        }
+    }
+    if (seed != Py_None) {
+        config.randomStimulus = true;
+        config.randomSeed = PyLong_AsUnsignedLongLong(seed);
+        if (PyErr_Occurred()) {
+            return nullptr;
+        }
+    }
+    try {
+        config.randomInputRules = stringList(randomInputs, "random_inputs must be a sequence of str");
+        config.breakpointStates = indexList(breakStates, "breakpoint_states must be a sequence of int");
+        config.breakpointAddresses = indexList(breakAddresses, "breakpoint_addresses must be a sequence of int");
+        config.breakpointConditions = stringList(breakIf, "break_if must be a sequence of str");
+    } catch (const SimulatorException&) {
+        return nullptr;
+    }
+    config.enableBreakpoints = !config.breakpointStates.empty() || !config.breakpointAddresses.empty() ||
+                               !config.breakpointConditions.empty();
+
+    SimulatorObject* self = reinterpret_cast<SimulatorObject*>(type->tp_alloc(type, 0));
+    if (self == nullptr) {
+        return nullptr;
+    }
+    self->simulator = new Simulator(config);
+    bool initialized;
+    std::string error;
+    Py_BEGIN_ALLOW_THREADS
+    try {
+        initialized = self->simulator->initialize();
+        error = self->simulator->getLastError();
+    } catch (const SimulatorException& e) {
+        initialized = false;
+        error = e.what();
+    }
+    Py_END_ALLOW_THREADS
+    if (!initialized) {
+        PyErr_SetString(PyExc_RuntimeError, error.c_str());
+        Py_DECREF(self);
+        return nullptr;
+    }
+    return reinterpret_cast<PyObject*>(self);
+}
+
+void simulatorDealloc(PyObject* self) {
+    delete reinterpret_cast<SimulatorObject*>(self)->simulator;
+    releaseOwner(reinterpret_cast<Owner*>(self));
+    freeObject(self);
+}
+
+PyObject* simulatorResult(SimulatorObject* sim, bool ok) {
+    if (!ok) {
+        return raise(&sim->owner, sim->simulator->getLastError());
+    }
+    Py_RETURN_NONE;
+}
+
+// A call that may reset or restore the model, and so run subscribers
+template <typename Call>
+PyObject* simulatorCall(SimulatorObject* sim, Call call) {
+    try {
+        return simulatorResult(sim, call());
+    } catch (const SimulatorException& e) {
+        return raise(&sim->owner, e.what());
+    }
+}
+
+// run() and step(n): to max_cycles, a breakpoint or n cycles, with the GIL
+// released
+PyObject* simulatorRun(PyObject* self, PyObject*) {
+    SimulatorObject* sim = reinterpret_cast<SimulatorObject*>(self);
+    if (!claim(&sim->owner)) {
+        return nullptr;
+    }
+    bool ok;
+    setBusy(&sim->owner, true);
+    Py_BEGIN_ALLOW_THREADS
+    ok = sim->simulator->run();
+    Py_END_ALLOW_THREADS
+    setBusy(&sim->owner, false);
+    return simulatorResult(sim, ok);
+}
+
+PyObject* simulatorStep(PyObject* self, PyObject* args) {
+    SimulatorObject* sim = reinterpret_cast<SimulatorObject*>(self);
+    unsigned int cycles = 1;
+    if (!PyArg_ParseTuple(args, "|I", &cycles) || !claim(&sim->owner)) {
+        return nullptr;
+    }
+    bool ok;
+    setBusy(&sim->owner, true);
+    Py_BEGIN_ALLOW_THREADS
+    ok = sim->simulator->step(cycles);
+    Py_END_ALLOW_THREADS
+    setBusy(&sim->owner, false);
+    return simulatorResult(sim, ok);
+}
+
+PyObject* simulatorReset(PyObject* self, PyObject*) {
+    SimulatorObject* sim = reinterpret_cast<SimulatorObject*>(self);
+    if (!claim(&sim->owner)) {
+        return nullptr;
+    }
+    return simulatorCall(sim, [sim]() {
+        sim->simulator->reset();
+        return true;
+    });
+}
+
+PyObject* simulatorRestore(PyObject* self, PyObject* args) {
+    SimulatorObject* sim = reinterpret_cast<SimulatorObject*>(self);
+    unsigned long long cycle;
+    if (!PyArg_ParseTuple(args, "K", &cycle) || !claim(&sim->owner)) {
+        return nullptr;
+    }
+    return simulatorCall(sim, [sim, cycle]() { return sim->simulator->restoreToCycle(cycle); });
+}
+
+// swap_program and apply_patch rebuild the model, so no view of it may be alive
+bool claimModel(SimulatorObject* sim) {
+    if (!claim(&sim->owner)) {
+        return false;
+    }
+    if (sim->owner.exports > 0) {
+        PyErr_SetString(PyExc_BufferError, "the simulator's registers have views; release them first");
+        return false;
+    }
+    return true;
+}
+
+PyObject* simulatorSwapProgram(PyObject* self, PyObject* args, PyObject* kwargs) {
+    static const char* keywords[] = {"base", "source", nullptr};
+    SimulatorObject* sim = reinterpret_cast<SimulatorObject*>(self);
+    const char* base = nullptr;
+    const char* source = nullptr;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|zz", const_cast<char**>(keywords), &base, &source) ||
+        !claimModel(sim)) {
+        return nullptr;
+    }
+    std::string basePath = base != nullptr ? base : "";
+    std::string sourceFile = source != nullptr ? source : "";
+    if (basePath.empty() && !sourceFile.empty()) {
+        basePath = getBaseFilename(sourceFile);
+    }
+    return simulatorCall(sim, [&]() { return sim->simulator->swapProgram(basePath, sourceFile); });
+}
+
+PyObject* simulatorApplyPatch(PyObject* self, PyObject* args) {
+    SimulatorObject* sim = reinterpret_cast<SimulatorObject*>(self);
+    const char* patch;
+    if (!PyArg_ParseTuple(args, "s", &patch) || !claimModel(sim)) {
+        return nullptr;
+    }
+    return simulatorCall(sim, [sim, patch]() { return sim->simulator->applyPatch(patch); });
+}
+
+PyObject* simulatorSetInput(PyObject* self, PyObject* args) {
+    SimulatorObject* sim = reinterpret_cast<SimulatorObject*>(self);
+    PyObject* key;
+    int value;
+    if (!PyArg_ParseTuple(args, "Oi", &key, &value) || !claimInputs(&sim->owner)) {
+        return nullptr;
+    }
+    uint32_t index = inputIndex(sim->simulator->getMemoryLoader(), key);
+    if (index == UINT32_MAX) {
+        return nullptr;
+    }
+    sim->simulator->setInputValue(index, static_cast<uint8_t>(value));
+    Py_RETURN_NONE;
+}
+
+PyObject* simulatorWriteProfile(PyObject* self, PyObject* args) {
+    SimulatorObject* sim = reinterpret_cast<SimulatorObject*>(self);
+    const char* filename;
+    if (!PyArg_ParseTuple(args, "s", &filename) || !claim(&sim->owner)) {
+        return nullptr;
+    }
+    return simulatorResult(sim, sim->simulator->writeProfile(filename));
+}
+
+PyObject* simulatorStates(PyObject* self, void*) {
+    SimulatorObject* sim = reinterpret_cast<SimulatorObject*>(self);
+    return viewOf(&sim->owner, sim->simulator->getHotstateModel().getStates().getWords());
+}
+
+PyObject* simulatorInputs(PyObject* self, void*) {
+    SimulatorObject* sim = reinterpret_cast<SimulatorObject*>(self);
+    return viewOf(&sim->owner, sim->simulator->getHotstateModel().getInputs());
+}
+
+template <const std::vector<uint64_t>& (HotstateModel::*Counts)() const>
+PyObject* simulatorProfileCounts(PyObject* self, void*) {
+    SimulatorObject* sim = reinterpret_cast<SimulatorObject*>(self);
+    const HotstateModel& model = sim->simulator->getHotstateModel();
+    if (!model.isProfiling()) {
+        Py_RETURN_NONE;
+    }
+    return viewOf(&sim->owner, (model.*Counts)());
+}
+
+PyObject* simulatorAddress(PyObject* self, void*) {
+    return PyLong_FromUnsignedLong(
+        reinterpret_cast<SimulatorObject*>(self)->simulator->getHotstateModel().getCurrentAddress());
+}
+
+PyObject* simulatorCycle(PyObject* self, void*) {
+    return PyLong_FromUnsignedLongLong(reinterpret_cast<SimulatorObject*>(self)->simulator->getCurrentCycle());
+}
+
+PyObject* simulatorStatus(PyObject* self, void*) {
+    return PyUnicode_FromString(stateToString(reinterpret_cast<SimulatorObject*>(self)->simulator->getState()).c_str());
+}
+
+PyObject* simulatorFinished(PyObject* self, void*) {
+    return PyBool_FromLong(reinterpret_cast<SimulatorObject*>(self)->simulator->isFinished());
+}
+
+PyObject* simulatorBreakpoint(PyObject* self, void*) {
+    Simulator& simulator = *reinterpret_cast<SimulatorObject*>(self)->simulator;
+    if (!simulator.isBreakpointHit()) {
+        Py_RETURN_NONE;
+    }
+    return PyUnicode_FromString(simulator.getBreakpointReason().c_str());
+}
+
+PyMethodDef simulatorMethods[] = {
+    {"run", method(simulatorRun), METH_NOARGS, "Run to max_cycles or a breakpoint, with the GIL released"},
+    {"step", method(simulatorStep), METH_VARARGS, "step(cycles=1), with the GIL released"},
+    {"reset", method(simulatorReset), METH_NOARGS, "Back to cycle 0"},
+    {"restore", method(simulatorRestore), METH_VARARGS, "restore(cycle): back to an earlier cycle"},
+    {"swap_program", method(simulatorSwapProgram), METH_VARARGS | METH_KEYWORDS,
+     "swap_program(base=None, source=None): another build of the program, from cycle 0"},
+    {"apply_patch", method(simulatorApplyPatch), METH_VARARGS, "apply_patch(file): a c_parser --diff-against patch"},
+    {"set_input", method(simulatorSetInput), METH_VARARGS, "set_input(index or name, value)"},
+    {"write_profile", method(simulatorWriteProfile), METH_VARARGS, "write_profile(file), as --profile"},
+    {"subscribe", method(subscribe<SimulatorObject>), METH_O,
+     "subscribe(function): call function(cycle, changed) after each cycle that changes the states; "
+     "changed is an int of the changed bits. Returns an id for unsubscribe"},
+    {"unsubscribe", method(unsubscribe<SimulatorObject>), METH_O, "unsubscribe(id)"},
+    {nullptr, nullptr, 0, nullptr}
+};
+
+PyGetSetDef simulatorGetters[] = {
+    {"states", simulatorStates, nullptr, "The state register, as uint64 words (bit i is state i)", nullptr},
+    {"inputs", simulatorInputs, nullptr, "One byte per input (uint8 view)", nullptr},
+    {"address_hits", simulatorProfileCounts<&HotstateModel::getAddressHits>, nullptr,
+     "Edges executed at each address, or None without profile=True", nullptr},
+    {"branch_taken", simulatorProfileCounts<&HotstateModel::getBranchTaken>, nullptr,
+     "Taken count of each branch word, or None without profile=True", nullptr},
+    {"branch_not_taken", simulatorProfileCounts<&HotstateModel::getBranchNotTaken>, nullptr,
+     "Not-taken count of each branch word, or None without profile=True", nullptr},
+    {"address", simulatorAddress, nullptr, "The microcode address", nullptr},
+    {"cycle", simulatorCycle, nullptr, "The current cycle", nullptr},
+    {"status", simulatorStatus, nullptr, "READY, PAUSED, FINISHED, ...", nullptr},
+    {"finished", simulatorFinished, nullptr, "max_cycles reached", nullptr},
+    {"breakpoint", simulatorBreakpoint, nullptr, "Why the run stopped at a breakpoint, or None", nullptr},
+    {nullptr, nullptr, nullptr, nullptr, nullptr}
+};
+
+PyType_Slot simulatorSlots[] = {
+    {Py_tp_new, slot(simulatorNew)},
+    {Py_tp_dealloc, slot(simulatorDealloc)},
+    {Py_tp_methods, simulatorMethods},
+    {Py_tp_getset, simulatorGetters},
+    {Py_tp_doc, const_cast<char*>("Simulator(base=None, source=None, stimulus=None, max_cycles=1000, "
+                                  "random_seed=None, random_inputs=(), breakpoint_states=(), "
+                                  "breakpoint_addresses=(), break_if=(), profile=False, output=None, "
+                                  "format='csv', log_window=10000, checkpoint_every=0, fast_forward=False)")},
+    {0, nullptr}
+};
+
+PyType_Slot arraySlots[] = {
+    {Py_tp_dealloc, slot(arrayDealloc)},
+    {Py_bf_getbuffer, slot(arrayGetBuffer)},
+    {0, nullptr}
+};
+
+PyObject* setImageCache(PyObject*, PyObject* args) {
+    const char* dir;
+    if (!PyArg_ParseTuple(args, "s", &dir)) {
+        return nullptr;
+    }
+    MemoryLoader::setImageCache(dir);
+    Py_RETURN_NONE;
+}
+
+PyMethodDef moduleMethods[] = {
+    {"set_image_cache", method(setImageCache), METH_VARARGS, "set_image_cache(dir), as --image-cache; '' for none"},
+    {nullptr, nullptr, 0, nullptr}
+};
+
+PyModuleDef moduleDef = {
+    PyModuleDef_HEAD_INIT, "hotstate", "In-process hotstate simulation", -1, moduleMethods,
+    nullptr, nullptr, nullptr, nullptr
+};
+
+// The types, with the size of each object
+PyObject* makeType(PyObject* module, const char* name, const char* attribute, int size, PyType_Slot* slots,
+                   unsigned int flags) {
+    PyType_Spec spec = {name, size, 0, flags, slots};
+    PyObject* type = PyType_FromSpec(&spec);
+    if (type != nullptr && attribute != nullptr && PyModule_AddObjectRef(module, attribute, type) < 0) {
+        Py_DECREF(type);
+        return nullptr;
+    }
+    return type;
+}
+
+} // namespace
+
+PyMODINIT_FUNC PyInit_hotstate() {
+    PyObject* module = PyModule_Create(&moduleDef);
+    if (module == nullptr) {
+        return nullptr;
+    }
+    arrayType = makeType(module, "hotstate._View", nullptr, sizeof(ArrayObject), arraySlots,
+                         Py_TPFLAGS_DEFAULT | Py_TPFLAGS_DISALLOW_INSTANTIATION);
+    loaderType = makeType(module, "hotstate.MemoryLoader", "MemoryLoader", sizeof(LoaderObject), loaderSlots,
+                          Py_TPFLAGS_DEFAULT);
+    traceType = makeType(module, "hotstate.Trace", "Trace", sizeof(TraceObject), traceSlots,
+                         Py_TPFLAGS_DEFAULT | Py_TPFLAGS_DISALLOW_INSTANTIATION);
+    modelType = makeType(module, "hotstate.Model", "Model", sizeof(ModelObject), modelSlots, Py_TPFLAGS_DEFAULT);
+    simulatorType = makeType(module, "hotstate.Simulator", "Simulator", sizeof(SimulatorObject), simulatorSlots,
+                             Py_TPFLAGS_DEFAULT);
+    if (arrayType == nullptr || loaderType == nullptr || traceType == nullptr || modelType == nullptr ||
+        simulatorType == nullptr) {
+        Py_DECREF(module);
+        return nullptr;
+    }
+    return module;
+}
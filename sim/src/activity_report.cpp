@@ -0,0 +1,143 @@
+#include "activity_report.h"
+#include <iomanip>
+#include <iterator>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+namespace HotstateSim {
+
+namespace {
+
+// The testbench's forever #5 clk = ~clk, in its 1 ns timescale
+constexpr uint64_t CLOCK_PERIOD_NS = 10;
+
+// A field of microcode_bits as IP/microcode.sv names it, in the order
+// decodeMicrocodeWord reads them
+struct Field {
+    const char* name;
+    uint32_t offset;
+    uint32_t width;
+    bool vector;  // Declared [N-1:0] even when N is 1
+};
+
+std::vector<Field> microcodeFields(const Parameters& params) {
+    const std::pair<const char*, uint32_t> widths[] = {
+        {"state_value", params.NUM_STATES},     {"transition_value", params.NUM_STATES},
+        {"jadr", params.JADR_WIDTH},            {"varSel", params.VARSEL_WIDTH},
+        {"timerSel", params.TIMERSEL_WIDTH},    {"timerLd", params.TIMERLD_WIDTH},
+        {"switch_sel", params.SWITCH_SEL_WIDTH}, {"switch_active", params.SWITCH_ADR_WIDTH},
+        {"state_capture", params.STATE_CAPTURE_WIDTH}, {"var_or_timer", params.VAR_OR_TIMER_WIDTH},
+        {"branch", params.BRANCH_WIDTH},        {"forced_jmp", params.FORCED_JMP_WIDTH},
+        {"sub", params.SUB_WIDTH},              {"rtn", params.RTN_WIDTH},
+    };
+    std::vector<Field> fields;
+    uint32_t offset = 0;
+    for (size_t i = 0; i < std::size(widths); ++i) {
+        if (widths[i].second > 0) {
+            fields.push_back({widths[i].first, offset, widths[i].second, i < 7});
+        }
+        offset += widths[i].second;
+    }
+    return fields;
+}
+
+// SAIF escapes the brackets of a bit select
+std::string netName(const char* name, uint32_t bit, bool vector) {
+    return vector ? std::string(name) + "\\[" + std::to_string(bit) + "\\]" : std::string(name);
+}
+
+void writeNet(std::ostream& out, const std::string& name, const BitActivity& bit, uint64_t edges) {
+    out << "          (" << name << std::endl
+        << "            (T0 " << (edges - bit.highEdges) * CLOCK_PERIOD_NS << ") (T1 "
+        << bit.highEdges * CLOCK_PERIOD_NS << ") (TX 0)" << std::endl
+        << "            (TC " << bit.toggles << ") (IG 0)" << std::endl
+        << "          )" << std::endl;
+}
+
+std::string perEdge(uint64_t toggles, uint64_t edges) {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(4) << (edges ? static_cast<double>(toggles) / edges : 0.0);
+    return out.str();
+}
+
+} // namespace
+
+void writeActivitySaif(std::ostream& out, const HotstateModel& model, const MemoryLoader& memory,
+                       const std::string& design) {
+    const uint64_t edges = model.getActivityEdges();
+    const std::vector<BitActivity> states = model.getStateActivity();
+    const std::vector<BitActivity> word = model.getWordActivity();
+
+    out << "(SAIFILE" << std::endl
+        << "(SAIFVERSION \"2.0\")" << std::endl
+        << "(DIRECTION \"backward\")" << std::endl
+        << "(DESIGN \"" << design << "\")" << std::endl
+        << "(PROGRAM_NAME \"hotstate_sim\")" << std::endl
+        << "(DIVIDER / )" << std::endl
+        << "(TIMESCALE 1 ns)" << std::endl
+        << "(DURATION " << edges * CLOCK_PERIOD_NS << ")" << std::endl
+        << "(INSTANCE " << design << "_tb" << std::endl
+        << "  (INSTANCE dut" << std::endl
+        << "    (INSTANCE hotstate_inst" << std::endl
+        << "      (INSTANCE Microcode" << std::endl
+        << "        (NET" << std::endl;
+    for (uint32_t i = 0; i < states.size(); ++i) {
+        writeNet(out, netName("states", i, true), states[i], edges);
+    }
+    for (const Field& field : microcodeFields(memory.getParams())) {
+        for (uint32_t b = 0; b < field.width && field.offset + b < word.size(); ++b) {
+            writeNet(out, netName(field.name, b, field.vector), word[field.offset + b], edges);
+        }
+    }
+    out << "        )" << std::endl
+        << "      )" << std::endl
+        << "    )" << std::endl
+        << "  )" << std::endl
+        << ")" << std::endl
+        << ")" << std::endl;
+}
+
+void writeActivityReport(std::ostream& out, const HotstateModel& model, const MemoryLoader& memory) {
+    const uint64_t edges = model.getActivityEdges();
+    const std::vector<BitActivity> states = model.getStateActivity();
+    const std::vector<BitActivity> word = model.getWordActivity();
+    const std::vector<Field> fields = microcodeFields(memory.getParams());
+
+    uint64_t stateToggles = 0, wordToggles = 0;
+    for (const BitActivity& bit : states) {
+        stateToggles += bit.toggles;
+    }
+    for (const BitActivity& bit : word) {
+        wordToggles += bit.toggles;
+    }
+    out << "Switching activity: " << edges << " edges, " << stateToggles << " state toggles, "
+        << wordToggles << " microcode toggles" << std::endl;
+
+    out << std::endl << "Microcode fields" << std::endl;
+    out << "  field              bits       toggles  per edge" << std::endl;
+    for (const Field& field : fields) {
+        uint64_t toggles = 0;
+        for (uint32_t b = 0; b < field.width && field.offset + b < word.size(); ++b) {
+            toggles += word[field.offset + b].toggles;
+        }
+        out << "  " << std::left << std::setw(17) << field.name << std::right << std::setw(6) << field.width
+            << std::setw(14) << toggles << std::setw(10) << perEdge(toggles, edges) << std::endl;
+    }
+
+    out << std::endl << "State outputs" << std::endl;
+    out << "  state            toggles  per edge    high" << std::endl;
+    for (uint32_t i = 0; i < states.size(); ++i) {
+        std::string name = memory.getStateNameByIndex(i);
+        if (name.empty()) {
+            name = "state[" + std::to_string(i) + "]";
+        }
+        std::ostringstream high;
+        high << std::fixed << std::setprecision(1)
+             << (edges ? 100.0 * states[i].highEdges / edges : 0.0) << "%";
+        out << "  " << std::left << std::setw(12) << name << std::right << std::setw(12) << states[i].toggles
+            << std::setw(10) << perEdge(states[i].toggles, edges) << std::setw(8) << high.str() << std::endl;
+    }
+}
+
+} // namespace HotstateSim
@@ -0,0 +1,129 @@
+#include "async_trace_writer.h"
+#include "utils.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace HotstateSim {
+
+namespace {
+
+size_t roundUpPowerOfTwo(size_t value) {
+    size_t result = 1;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+// Spin briefly, then back off to short sleeps so an idle writer costs no CPU
+void backOff(uint32_t& spins) {
+    if (++spins < 64) {
+        std::this_thread::yield();
+    } else {
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+}
+
+} // namespace
+
+AsyncTraceWriter::AsyncTraceWriter(FormatFn fn, size_t capacity)
+    : format(std::move(fn))
+    , ring(roundUpPowerOfTwo(std::max<size_t>(capacity, 4096)))
+    , mask(ring.size() - 1)
+    , head(0)
+    , tail(0)
+    , stopping(false)
+{
+    writer = std::thread(&AsyncTraceWriter::writeLoop, this);
+}
+
+AsyncTraceWriter::~AsyncTraceWriter() {
+    stopping.store(true, std::memory_order_release);
+    if (writer.joinable()) {
+        writer.join();
+    }
+}
+
+void AsyncTraceWriter::copyIn(size_t pos, const void* data, size_t size) {
+    if (size == 0) return;
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    size_t offset = pos & mask;
+    size_t first = std::min(size, ring.size() - offset);
+    std::memcpy(ring.data() + offset, bytes, first);
+    std::memcpy(ring.data(), bytes + first, size - first);
+}
+
+void AsyncTraceWriter::copyOut(size_t pos, void* data, size_t size) const {
+    if (size == 0) return;
+    uint8_t* bytes = static_cast<uint8_t*>(data);
+    size_t offset = pos & mask;
+    size_t first = std::min(size, ring.size() - offset);
+    std::memcpy(bytes, ring.data() + offset, first);
+    std::memcpy(bytes + first, ring.data(), size - first);
+}
+
+void AsyncTraceWriter::push(const LogView& entry) {
+    const LogRecord& rec = entry.record;
+    size_t stateBytes = ((rec.numStates + 63) / 64) * sizeof(uint64_t);
+    size_t total = sizeof(LogRecord) + stateBytes + rec.numOutputs + rec.numInputs;
+    if (total > ring.size()) {
+        throw SimulatorException("Trace entry of " + std::to_string(total) + " bytes exceeds the writer queue");
+    }
+    
+    size_t pos = tail.load(std::memory_order_relaxed);
+    uint32_t spins = 0;
+    while (pos + total - head.load(std::memory_order_acquire) > ring.size()) {
+        backOff(spins);
+    }
+    
+    copyIn(pos, &rec, sizeof(LogRecord));
+    copyIn(pos + sizeof(LogRecord), entry.states, stateBytes);
+    copyIn(pos + sizeof(LogRecord) + stateBytes, entry.outputs, rec.numOutputs);
+    copyIn(pos + sizeof(LogRecord) + stateBytes + rec.numOutputs, entry.inputs, rec.numInputs);
+    tail.store(pos + total, std::memory_order_release);
+}
+
+void AsyncTraceWriter::drain() {
+    uint32_t spins = 0;
+    while (head.load(std::memory_order_acquire) != tail.load(std::memory_order_relaxed)) {
+        backOff(spins);
+    }
+}
+
+void AsyncTraceWriter::writeLoop() {
+    size_t pos = head.load(std::memory_order_relaxed);
+    uint32_t spins = 0;
+    
+    while (true) {
+        if (pos == tail.load(std::memory_order_acquire)) {
+            // Check stopping before the final look at tail so nothing pushed
+            // before the destructor ran is left behind
+            if (stopping.load(std::memory_order_acquire) && pos == tail.load(std::memory_order_acquire)) {
+                return;
+            }
+            backOff(spins);
+            continue;
+        }
+        spins = 0;
+        
+        LogRecord rec;
+        copyOut(pos, &rec, sizeof(LogRecord));
+        size_t stateWords = (rec.numStates + 63) / 64;
+        size_t stateBytes = stateWords * sizeof(uint64_t);
+        
+        stateScratch.resize(std::max(stateScratch.size(), stateWords));
+        outputScratch.resize(std::max<size_t>(outputScratch.size(), rec.numOutputs));
+        inputScratch.resize(std::max<size_t>(inputScratch.size(), rec.numInputs));
+        copyOut(pos + sizeof(LogRecord), stateScratch.data(), stateBytes);
+        copyOut(pos + sizeof(LogRecord) + stateBytes, outputScratch.data(), rec.numOutputs);
+        copyOut(pos + sizeof(LogRecord) + stateBytes + rec.numOutputs, inputScratch.data(), rec.numInputs);
+        
+        format(LogView{rec, stateScratch.data(), outputScratch.data(), inputScratch.data()});
+        
+        pos += sizeof(LogRecord) + stateBytes + rec.numOutputs + rec.numInputs;
+        head.store(pos, std::memory_order_release);
+    }
+}
+
+} // namespace HotstateSim
@@ -0,0 +1,329 @@
+#include "autotuner.h"
+#include "utils.h"
+#include <algorithm>
+#include <atomic>
+#include <iomanip>
+#include <iostream>
+#include <streambuf>
+#include <thread>
+
+extern "C" {
+#include "hotstate.h"
+}
+
+namespace HotstateSim {
+
+struct Autotuner::Setting {
+    HotstateOptions options;
+    MemoryLoader memory;
+};
+
+namespace {
+
+// The values tried for the options that take one; the first is c_parser's
+// default. --switch-bits is left to the compiler, which picks the fewest
+// that fit, and --vardata-bits only changes how the LUT is packed, not its
+// size.
+const int INLINE_WORDS[] = {2, 1, 8};
+const int MERGE_TAILS[] = {0, MERGE_TAILS_SPEED, MERGE_TAILS_SIZE};
+
+// Drops what is written to it: loading and running a program reports each
+// step on std::cout, which for hundreds of settings would bury the report
+class DiscardBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override { return traits_type::not_eof(c); }
+    std::streamsize xsputn(const char*, std::streamsize count) override { return count; }
+};
+
+// The values the states took over one stretch of constant inputs, each
+// with the cycle it was taken on; the first is the value at the start
+using StateTrace = std::vector<std::pair<uint32_t, StateBits>>;
+
+// Scores the stretch of trace that ends before cycle end. The values held
+// in its second half are what the inputs settle the states into, a single
+// one or a repeating few for a program that keeps toggling some; the
+// stretch has settled from the cycle after which no other value is taken.
+void addStretch(Autotuner::Result& result, const StateTrace& trace, uint32_t end) {
+    uint32_t start = trace[0].first;
+    uint32_t half = start + (end - start) / 2;
+    Autotuner::StateSet steady;
+    for (size_t i = 0; i < trace.size(); ++i) {
+        uint32_t until = i + 1 < trace.size() ? trace[i + 1].first : end;
+        if (until > half) {
+            steady.push_back(trace[i].second.getWords());
+        }
+    }
+    std::sort(steady.begin(), steady.end());
+    steady.erase(std::unique(steady.begin(), steady.end()), steady.end());
+
+    uint32_t settled = start;
+    for (size_t i = trace.size(); i-- > 0;) {
+        if (!std::binary_search(steady.begin(), steady.end(), trace[i].second.getWords())) {
+            settled = i + 1 < trace.size() ? trace[i + 1].first : end;
+            break;
+        }
+    }
+    result.latency = std::max(result.latency, settled - start);
+    result.settled.push_back(steady);
+}
+
+void addFlag(std::string& flags, uint32_t& count, const std::string& flag) {
+    if (!flags.empty()) {
+        flags += ' ';
+    }
+    flags += flag;
+    count++;
+}
+
+} // namespace
+
+Autotuner::Autotuner(const SimulatorConfig& cfg)
+    : config(cfg)
+    , jobs(cfg.jobs)
+{
+    if (jobs == 0) {
+        jobs = std::max(1u, std::thread::hardware_concurrency());
+    }
+}
+
+Autotuner::~Autotuner() = default;
+
+void Autotuner::compileAll() {
+    for (int compact = 0; compact <= 1; ++compact) {
+        for (int fuse = 0; fuse <= 1; ++fuse) {
+            for (int merge : MERGE_TAILS) {
+                for (int rotate = 0; rotate <= 1; ++rotate) {
+                    for (int inlineWords : INLINE_WORDS) {
+                        for (int prune = 0; prune <= 1; ++prune) {
+                            for (int fold = 0; fold <= 1; ++fold) {
+                                auto setting = std::make_unique<Setting>();
+                                HotstateOptions& options = setting->options;
+                                options = HotstateOptions();
+                                options.compact_words = compact;
+                                options.fuse_conditions = fuse;
+                                options.merge_tails = merge;
+                                options.rotate_loops = rotate;
+                                options.inline_words = inlineWords;
+                                options.prune_inputs = prune;
+                                options.fold_constants = fold;
+                                // The simulator decodes words by the image's field
+                                // widths, which only narrow fields always match
+                                options.narrow_fields = 1;
+
+                                Result result;
+                                if (compact) addFlag(result.flags, result.flagCount, "--compact-words");
+                                if (fuse) addFlag(result.flags, result.flagCount, "--fuse-conditions");
+                                if (merge == MERGE_TAILS_SPEED) addFlag(result.flags, result.flagCount, "--merge-tails");
+                                if (merge == MERGE_TAILS_SIZE) addFlag(result.flags, result.flagCount, "--merge-tails-size");
+                                if (rotate) addFlag(result.flags, result.flagCount, "--rotate-loops");
+                                if (inlineWords != INLINE_WORDS[0]) {
+                                    addFlag(result.flags, result.flagCount, "--inline-words " + std::to_string(inlineWords));
+                                }
+                                if (prune) addFlag(result.flags, result.flagCount, "--prune-inputs");
+                                if (fold) addFlag(result.flags, result.flagCount, "--fold-constants");
+
+                                if (setting->memory.loadFromSource(config.sourceFile, &options)) {
+                                    result.success = true;
+                                    result.words = static_cast<uint32_t>(setting->memory.getSmdataSize());
+                                    result.lutBytes = static_cast<uint32_t>((setting->memory.getVardataSize() + 7) / 8);
+                                } else {
+                                    result.error = "Failed to compile";
+                                }
+                                settings.push_back(std::move(setting));
+                                results.push_back(result);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+bool Autotuner::run() {
+    DiscardBuffer discard;
+    std::streambuf* shown = config.verbose ? nullptr : std::cout.rdbuf(&discard);
+    compileAll();
+    if (results[0].success) {
+        simulateAll();
+    }
+    if (shown) {
+        std::cout.rdbuf(shown);
+    }
+
+    if (!results[0].success) {
+        lastError = "The default settings failed: " + results[0].error;
+        return false;
+    }
+    rank();
+    return true;
+}
+
+void Autotuner::simulateAll() {
+    // On worker threads, as SweepRunner does; every setting has its own
+    // program, so runs share nothing mutable
+    std::atomic<uint32_t> nextRun(0);
+    uint32_t runCount = static_cast<uint32_t>(results.size());
+    auto worker = [&]() {
+        for (uint32_t index = nextRun++; index < runCount; index = nextRun++) {
+            simulate(index, results[index]);
+        }
+    };
+    uint32_t threadCount = std::min(jobs, runCount);
+    std::vector<std::thread> threads;
+    for (uint32_t t = 1; t < threadCount; ++t) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+void Autotuner::simulate(uint32_t index, Result& result) const {
+    if (!result.success) {
+        return;
+    }
+    result.success = false;
+
+    try {
+        const MemoryLoader& memory = settings[index]->memory;
+        StimulusParser stimulus;
+        // --prune-inputs renumbers the inputs, so each program reads the
+        // stimulus through its own symbols
+        stimulus.setInputSymbols(&memory.getInputSymbols());
+        if (!stimulus.loadStimulus(config.stimulusFile)) {
+            result.error = "Failed to load stimulus file: " + config.stimulusFile;
+            return;
+        }
+
+        HotstateModel model(memory);
+        model.reset();
+
+        // One edge at a time, so every value the states take is seen
+        std::vector<StateTrace::value_type> trace;
+        uint64_t nextInputChange = 0;
+        for (uint32_t cycle = 0; cycle < config.maxCycles; ++cycle) {
+            if (cycle == nextInputChange) {
+                if (cycle > 0) {
+                    addStretch(result, trace, cycle);
+                }
+                trace.assign(1, {cycle, model.getStates()});
+                if (!stimulus.isEmpty()) {
+                    model.setInputs(stimulus.getInputs(cycle));
+                }
+                nextInputChange = stimulus.getNextChangeCycle(cycle);
+            }
+            model.setReset(cycle < Simulator::RESET_CYCLES);
+            model.clock();
+            if (model.getStates() != trace.back().second) {
+                trace.emplace_back(cycle + 1, model.getStates());
+            }
+        }
+        addStretch(result, trace, config.maxCycles);
+        result.success = true;
+
+    } catch (const SimulatorException& e) {
+        result.error = e.what();
+    }
+}
+
+bool Autotuner::dominates(const Result& a, const Result& b) const {
+    return a.words <= b.words && a.lutBytes <= b.lutBytes && a.latency <= b.latency &&
+           (a.words < b.words || a.lutBytes < b.lutBytes || a.latency < b.latency);
+}
+
+void Autotuner::rank() {
+    const Result& defaults = results[0];
+    for (Result& result : results) {
+        result.matches = result.success && result.settled == defaults.settled;
+        result.withinBudget = result.matches &&
+                              (config.romBudget == 0 || result.words <= config.romBudget) &&
+                              (config.lutBudget == 0 || result.lutBytes <= config.lutBudget) &&
+                              (config.latencyBudget == 0 || result.latency <= config.latencyBudget);
+    }
+
+    // Of settings that score the same, only the one with the fewest
+    // options (the first of those) is listed
+    for (size_t i = 0; i < results.size(); ++i) {
+        Result& result = results[i];
+        result.optimal = result.matches;
+        for (size_t j = 0; j < results.size() && result.optimal; ++j) {
+            const Result& other = results[j];
+            if (j == i || !other.matches) {
+                continue;
+            }
+            bool same = other.words == result.words && other.lutBytes == result.lutBytes &&
+                        other.latency == result.latency;
+            bool preferred = other.flagCount < result.flagCount ||
+                             (other.flagCount == result.flagCount && j < i);
+            if (dominates(other, result) || (same && preferred)) {
+                result.optimal = false;
+            }
+        }
+    }
+}
+
+void Autotuner::writeReport(std::ostream& out) const {
+    uint32_t compiled = 0;
+    uint32_t matching = 0;
+    for (const Result& result : results) {
+        compiled += result.success ? 1 : 0;
+        matching += result.matches ? 1 : 0;
+    }
+
+    out << "=== Autotune: " << config.sourceFile << " ===" << std::endl;
+    out << results.size() << " settings, " << compiled << " compiled and run for " << config.maxCycles
+        << " cycles of " << config.stimulusFile << ", " << matching << " settling as the defaults do" << std::endl;
+
+    auto writeRow = [&](const Result& result, const std::string& mark) {
+        out << std::setw(2) << mark << std::setw(7) << result.words << std::setw(11) << result.lutBytes
+            << std::setw(9) << result.latency << "  " << (result.flags.empty() ? "(defaults)" : result.flags)
+            << std::endl;
+    };
+
+    out << "Pareto-optimal settings (* within budget):" << std::endl;
+    out << "    words  LUT bytes  latency  options" << std::endl;
+    std::vector<const Result*> front;
+    for (const Result& result : results) {
+        if (result.optimal) {
+            front.push_back(&result);
+        }
+    }
+    std::stable_sort(front.begin(), front.end(), [](const Result* a, const Result* b) {
+        return a->words != b->words ? a->words < b->words : a->latency < b->latency;
+    });
+    for (const Result* result : front) {
+        writeRow(*result, result->withinBudget ? "*" : "");
+    }
+
+    // The fastest in budget, then the smallest
+    const Result* best = nullptr;
+    for (const Result* result : front) {
+        if (result->withinBudget &&
+            (!best || result->latency < best->latency ||
+             (result->latency == best->latency && result->words < best->words))) {
+            best = result;
+        }
+    }
+    if (best) {
+        out << "Best within budget: " << (best->flags.empty() ? "(defaults)" : best->flags) << std::endl;
+    } else {
+        out << "No setting is within budget" << std::endl;
+    }
+
+    if (config.verbose) {
+        out << "All settings:" << std::endl;
+        for (const Result& result : results) {
+            if (!result.success) {
+                out << "  FAILED: " << (result.flags.empty() ? "(defaults)" : result.flags) << ": "
+                    << result.error << std::endl;
+            } else {
+                writeRow(result, result.matches ? "" : "!=");
+            }
+        }
+        out << "(!= settles differently from the defaults)" << std::endl;
+    }
+}
+
+} // namespace HotstateSim
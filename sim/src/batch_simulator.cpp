@@ -0,0 +1,409 @@
+#include "batch_simulator.h"
+#include "utils.h"
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <filesystem>
+
+namespace HotstateSim {
+
+BatchSimulator::BatchSimulator(const SimulatorConfig& cfg, const std::vector<std::string>& files)
+    : config(cfg)
+    , stimulusFiles(files)
+    , laneCount(static_cast<uint32_t>(files.size()))
+    , stateWordCount(0)
+    , numVars(0)
+    , numTimers(0)
+    , stackDepth(0)
+{
+}
+
+bool BatchSimulator::initialize() {
+    try {
+        if (laneCount == 0) {
+            lastError = "Batch has no stimulus files";
+            return false;
+        }
+
+        if (!loadMemoryFiles() || !loadStimulusFiles() || !initializeLoggers()) {
+            return false;
+        }
+
+        allocateLanes();
+        for (uint32_t lane = 0; lane < laneCount; ++lane) {
+            resetLane(lane);
+        }
+
+        if (config.verbose) {
+            std::cout << "Batch initialized with " << laneCount << " lanes" << std::endl;
+        }
+        return true;
+
+    } catch (const SimulatorException& e) {
+        lastError = e.what();
+        return false;
+    }
+}
+
+bool BatchSimulator::loadMemoryFiles() {
+    if (config.basePath.empty()) {
+        lastError = "Base path not specified";
+        return false;
+    }
+
+    if (!memoryLoader.loadProgram(config.basePath, config.sourceFile) || !memoryLoader.isLoaded()) {
+        lastError = "Failed to load memory files from base path: " + config.basePath;
+        return false;
+    }
+
+    if (config.verbose) {
+        memoryLoader.printMemoryInfo();
+    }
+
+    if (memoryLoader.getParams().PIPELINED) {
+        lastError = "Batch mode does not support PIPELINED programs";
+        return false;
+    }
+    decoded = HotstateModel::decodeProgram(memoryLoader.getSmdata(), memoryLoader.getParams());
+    lut = VardataImage(memoryLoader.getVardata(), memoryLoader.getParams().NUM_VARS);
+    return true;
+}
+
+bool BatchSimulator::loadStimulusFiles() {
+    stimuli.resize(laneCount);
+    for (uint32_t lane = 0; lane < laneCount; ++lane) {
+        stimuli[lane].setInputSymbols(&memoryLoader.getInputSymbols());
+        if (!stimuli[lane].loadStimulus(stimulusFiles[lane])) {
+            lastError = "Failed to load stimulus file: " + stimulusFiles[lane];
+            return false;
+        }
+    }
+    return true;
+}
+
+bool BatchSimulator::initializeLoggers() {
+    loggers.clear();
+    if (config.outputFormat == OutputFormat::CONSOLE) {
+        return true; // Console batches only print the per-lane summary
+    }
+
+    for (uint32_t lane = 0; lane < laneCount; ++lane) {
+        std::unique_ptr<OutputLogger> logger;
+        std::string filename = outputFileFor(config, stimulusFiles[lane], lane);
+        switch (config.outputFormat) {
+            case OutputFormat::VCD:
+                logger = OutputLogger::createVCDLogger(filename);
+                break;
+            case OutputFormat::CSV:
+                logger = OutputLogger::createCSVLogger(filename);
+                break;
+            case OutputFormat::JSON:
+                logger = OutputLogger::createJSONLogger(filename);
+                break;
+            case OutputFormat::TRACE:
+                logger = OutputLogger::createTraceLogger(filename);
+                break;
+            default:
+                break;
+        }
+
+        if (!logger) {
+            lastError = "Failed to create logger";
+            return false;
+        }
+
+        // Traces stream to disk; keep only the latest entry in memory per lane
+        logger->setMaxLogEntries(1);
+        if (!logger->openFile()) {
+            lastError = "Failed to open output file: " + filename;
+            return false;
+        }
+        loggers.push_back(std::move(logger));
+    }
+    return true;
+}
+
+void BatchSimulator::allocateLanes() {
+    const Parameters& params = memoryLoader.getParams();
+    stateWordCount = (params.NUM_STATES + 63) / 64;
+    numVars = params.NUM_VARS;
+    numTimers = HotstateModel::timerCount(params);
+    stackDepth = params.STACK_DEPTH;
+
+    states.assign(static_cast<size_t>(laneCount) * stateWordCount, 0);
+    inputBits.assign(laneCount, 0);
+    stack.assign(static_cast<size_t>(laneCount) * stackDepth, 0);
+    timers.assign(static_cast<size_t>(laneCount) * numTimers, 0);
+    address.assign(laneCount, 0);
+    stackPointer.assign(laneCount, 0);
+    cycleCount.assign(laneCount, 0);
+    clk.assign(laneCount, 0);
+    rst.assign(laneCount, 1);
+    ready.assign(laneCount, 0);
+    lhs.assign(laneCount, 0);
+    fired.assign(laneCount, 0);
+    switchActive.assign(laneCount, 0);
+    laneInputs.assign(laneCount, nullptr);
+    laneOutputs.assign(params.NUM_STATES, 0);
+}
+
+void BatchSimulator::resetLane(uint32_t lane) {
+    const std::vector<uint32_t>& vardata = memoryLoader.getVardata();
+
+    std::fill_n(states.begin() + static_cast<size_t>(lane) * stateWordCount, stateWordCount, 0);
+    // HotstateModel::reset loads the inputs from vardata
+    for (size_t i = 0; i < numVars && i < vardata.size() && i < 64; ++i) {
+        uint64_t bit = 1ULL << i;
+        inputBits[lane] = (vardata[i] & 0xFF) ? inputBits[lane] | bit : inputBits[lane] & ~bit;
+    }
+
+    address[lane] = 0;
+    stackPointer[lane] = 0;
+    std::fill_n(stack.begin() + static_cast<size_t>(lane) * stackDepth, stackDepth, 0);
+    std::fill_n(timers.begin() + static_cast<size_t>(lane) * numTimers, numTimers, 0);
+
+    ready[lane] = 0;
+    lhs[lane] = 0;
+    fired[lane] = 0;
+    switchActive[lane] = 0;
+    cycleCount[lane] = 0;
+}
+
+bool BatchSimulator::run() {
+    try {
+        for (uint32_t cycle = 0; cycle < config.maxCycles; ++cycle) {
+            applyStimulus(cycle);
+            clockLanes();
+            logLanes(cycle);
+
+            if (config.verbose && (cycle % 100 == 0)) {
+                std::cout << "Cycle: " << cycle << std::endl;
+            }
+        }
+
+        for (auto& logger : loggers) {
+            logger->closeFile();
+        }
+        return true;
+
+    } catch (const SimulatorException& e) {
+        lastError = e.what();
+        return false;
+    }
+}
+
+void BatchSimulator::applyStimulus(uint32_t cycle) {
+    for (uint32_t lane = 0; lane < laneCount; ++lane) {
+        laneInputs[lane] = &stimuli[lane].getInputs(cycle);
+        if (stimuli[lane].isEmpty()) continue;
+
+        const std::vector<uint8_t>& inputs = *laneInputs[lane];
+        for (size_t i = 0; i < inputs.size() && i < numVars && i < 64; ++i) {
+            uint64_t bit = 1ULL << i;
+            inputBits[lane] = inputs[i] ? inputBits[lane] | bit : inputBits[lane] & ~bit;
+        }
+    }
+}
+
+void BatchSimulator::clockLanes() {
+    for (uint32_t lane = 0; lane < laneCount; ++lane) {
+        cycleCount[lane]++;
+
+        // On rising edge
+        if (!clk[lane]) {
+            clk[lane] = 1;
+            if (rst[lane]) {
+                resetLane(lane);
+            } else {
+                executeLane(lane);
+            }
+        } else {
+            clk[lane] = 0;
+        }
+    }
+}
+
+void BatchSimulator::executeLane(uint32_t lane) {
+    const Parameters& params = memoryLoader.getParams();
+    const std::vector<uint32_t>& switchdata = memoryLoader.getSwitchdata();
+
+    uint32_t pc = address[lane];
+    if (pc >= decoded.size()) {
+        throw SimulatorException("Lane " + std::to_string(lane) + ": address " + std::to_string(pc) +
+                               " exceeds microcode memory size " + std::to_string(decoded.size()));
+    }
+    const DecodedMicrocode& mc = decoded[pc];
+    if (mc.sub && stackPointer[lane] >= stackDepth) {
+        throw SimulatorException("Lane " + std::to_string(lane) + ": call at address " + std::to_string(pc) +
+                               " overflows the " + std::to_string(stackDepth) + "-entry stack");
+    }
+
+    // Switch lookup, as in HotstateModel::handleSwitch
+    uint32_t switchAdr = mc.switchAdr;
+    if (switchActive[lane] && params.NUM_SWITCHES > 0) {
+        uint32_t switchAddr = (mc.jadr << params.SWITCH_OFFSET_BITS) | switchAdr;
+        switchAdr = switchAddr < switchdata.size() ? switchdata[switchAddr] : 0;
+    }
+
+    // State capture: states = (states & ~mask) | (value & mask)
+    if (mc.stateCapture) {
+        uint64_t* laneStates = states.data() + static_cast<size_t>(lane) * stateWordCount;
+        if (stateWordCount == 1) {
+            laneStates[0] = (laneStates[0] & ~mc.captureMask) | mc.captureValue;
+        } else {
+            const std::vector<uint64_t>& value = mc.stateValue.getWords();
+            const std::vector<uint64_t>& mask = mc.transitionValue.getWords();
+            for (uint32_t w = 0; w < stateWordCount; ++w) {
+                laneStates[w] = (laneStates[w] & ~mask[w]) | (value[w] & mask[w]);
+            }
+        }
+    }
+
+    // Timers, as in HotstateModel::clockTimers
+    bool timerDone = false;
+    if (mc.timerSel != 0 && numTimers > 0) {
+        timerDone = HotstateModel::clockTimers(mc, timers.data() + static_cast<size_t>(lane) * numTimers, numTimers,
+                                               memoryLoader.getTimdata(), params).done;
+    }
+
+    // Control logic
+    bool laneLhs = lut.lookup(mc.varSel, inputBits[lane]);
+    bool taken = mc.varOrTimer ? !timerDone : laneLhs;
+    bool laneFired = (taken && mc.branch) || mc.forcedJmp || mc.rtn || switchActive[lane];
+    lhs[lane] = laneLhs;
+    fired[lane] = laneFired;
+
+    // Next address
+    uint32_t* laneStack = stack.data() + static_cast<size_t>(lane) * stackDepth;
+    uint32_t nextAddress = pc;
+    if (laneFired) {
+        if (switchActive[lane]) {
+            nextAddress = switchAdr;
+        } else if (mc.rtn && stackPointer[lane] > 0) {
+            stackPointer[lane]--;
+            nextAddress = laneStack[stackPointer[lane]];
+        } else {
+            nextAddress = mc.jadr;
+        }
+    } else {
+        nextAddress = pc + 1;
+    }
+
+    if (mc.sub) {
+        laneStack[stackPointer[lane]] = pc + 1;
+        stackPointer[lane]++;
+    }
+
+    if (nextAddress >= params.NUM_WORDS) {
+        nextAddress = 0;
+    }
+
+    address[lane] = nextAddress;
+    ready[lane] = 1;
+}
+
+void BatchSimulator::logLanes(uint32_t cycle) {
+    const Parameters& params = memoryLoader.getParams();
+
+    for (uint32_t lane = 0; lane < loggers.size(); ++lane) {
+        const uint64_t* laneStates = states.data() + static_cast<size_t>(lane) * stateWordCount;
+        const std::vector<uint8_t>& inputs = *laneInputs[lane];
+
+        LogRecord record;
+        record.cycle = cycle;
+        record.address = address[lane];
+        record.numStates = params.NUM_STATES;
+        record.numOutputs = params.NUM_STATES;
+        record.numInputs = static_cast<uint32_t>(inputs.size());
+        record.ready = ready[lane];
+        record.lhs = lhs[lane];
+        record.fired = fired[lane];
+        record.jmpadr = fired[lane];
+        record.switchActive = switchActive[lane];
+
+        // Outputs mirror the state bits, as in HotstateModel::copyOutputs
+        for (uint32_t i = 0; i < params.NUM_STATES; ++i) {
+            laneOutputs[i] = (laneStates[i >> 6] >> (i & 63)) & 1ULL;
+        }
+        loggers[lane]->logRecord(record, laneStates, laneOutputs.data(), inputs.data());
+    }
+}
+
+void BatchSimulator::printSummary() const {
+    const Parameters& params = memoryLoader.getParams();
+
+    std::cout << "=== Batch Summary ===" << std::endl;
+    std::cout << "Lanes: " << laneCount << ", cycles: " << config.maxCycles << std::endl;
+    for (uint32_t lane = 0; lane < laneCount; ++lane) {
+        const uint64_t* laneStates = states.data() + static_cast<size_t>(lane) * stateWordCount;
+        uint32_t active = 0;
+        for (uint32_t w = 0; w < stateWordCount; ++w) {
+            active += __builtin_popcountll(laneStates[w]);
+        }
+
+        std::cout << "[" << lane << "] " << stimulusFiles[lane]
+                  << ": Addr 0x" << std::hex << address[lane] << std::dec
+                  << ", active states " << active << "/" << params.NUM_STATES;
+        if (!loggers.empty()) {
+            std::cout << " -> " << outputFileFor(config, stimulusFiles[lane], lane);
+        }
+        std::cout << std::endl;
+    }
+    std::cout << "=====================" << std::endl;
+}
+
+std::vector<std::string> BatchSimulator::readStimulusList(const std::string& path) {
+    std::vector<std::string> files;
+
+    std::error_code ec;
+    if (std::filesystem::is_directory(path, ec)) {
+        for (const auto& dirEntry : std::filesystem::directory_iterator(path, ec)) {
+            // Skip traces a previous batch wrote next to its stimulus files
+            std::string ext = dirEntry.path().extension().string();
+            if (dirEntry.is_regular_file() && ext != ".csv" && ext != ".vcd" && ext != ".json" &&
+                ext != ".hst") {
+                files.push_back(dirEntry.path().string());
+            }
+        }
+        if (ec) {
+            throw SimulatorException("Cannot read stimulus directory: " + path);
+        }
+        std::sort(files.begin(), files.end());
+        return files;
+    }
+
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        throw SimulatorException("Cannot open batch list file: " + path);
+    }
+
+    std::string line;
+    while (std::getline(file, line)) {
+        line = trim(line);
+        if (line.empty() || line[0] == '#') continue;
+        files.push_back(line);
+    }
+    return files;
+}
+
+std::string BatchSimulator::outputFileFor(const SimulatorConfig& config, const std::string& stimulusFile,
+                                          uint32_t index) {
+    if (!config.outputFile.empty()) {
+        // trace.csv -> trace_0.csv, trace_1.csv, ...
+        std::string ext = getFileExtension(config.outputFile);
+        std::string stem = config.outputFile.substr(0, config.outputFile.size() - ext.size());
+        return stem + "_" + std::to_string(index) + ext;
+    }
+
+    // Default: next to the stimulus file, with the output format's extension
+    std::string ext = getFileExtension(stimulusFile);
+    std::string stem = stimulusFile.substr(0, stimulusFile.size() - ext.size());
+    switch (config.outputFormat) {
+        case OutputFormat::VCD: return stem + ".vcd";
+        case OutputFormat::JSON: return stem + ".json";
+        case OutputFormat::TRACE: return stem + ".hst";
+        default: return stem + ".csv";
+    }
+}
+
+} // namespace HotstateSim
@@ -0,0 +1,311 @@
+#include "bitsliced_model.h"
+#include <algorithm>
+
+namespace HotstateSim {
+
+BitSlicedModel::BitSlicedModel(const MemoryLoader& memory)
+    : vardata(memory.getVardata())
+    , timdata(memory.getTimdata())
+    , params(memory.getParams())
+    , decoded(HotstateModel::decodeProgram(memory.getSmdata(), memory.getParams()))
+    , lut(memory.getVardata(), memory.getParams().NUM_VARS)
+    , numVars(std::min(memory.getParams().NUM_VARS, 64u))
+    , numTimers(HotstateModel::timerCount(memory.getParams()))
+    , stackDepth(memory.getParams().STACK_DEPTH)
+    , running(ALL_LANES)
+    , faulted(0)
+    , clk(false)
+    , rst(false)
+    , cycleCount(0)
+    , profiling(false)
+{
+    if (params.PIPELINED) {
+        throw SimulatorException("The bit-sliced model does not support PIPELINED programs");
+    }
+
+    nodes.push_back({0, FALSE_NODE, FALSE_NODE});
+    nodes.push_back({0, TRUE_NODE, TRUE_NODE});
+    uint32_t varSels = 0;
+    for (const DecodedMicrocode& mc : decoded) {
+        varSels = std::max(varSels, mc.varSel + 1);
+    }
+    roots.assign(varSels, UINT32_MAX);
+    rootOrder.resize(varSels);
+
+    states.assign(params.NUM_STATES, 0);
+    inputs.assign(params.NUM_VARS, 0);
+    nextLanes.assign(std::max<size_t>({params.NUM_WORDS, decoded.size(), 1}), 0);
+    stack.assign(static_cast<size_t>(LANES) * stackDepth, 0);
+    timerCounts.assign(static_cast<size_t>(LANES) * numTimers, 0);
+    reset();
+}
+
+void BitSlicedModel::reset() {
+    std::fill(states.begin(), states.end(), 0);
+    for (size_t i = 0; i < inputs.size() && i < vardata.size(); ++i) {
+        inputs[i] = (vardata[i] & 0xFF) ? ALL_LANES : 0;
+    }
+    groups.assign(1, Group{0, ALL_LANES});
+    stackPointer.fill(0);
+    std::fill(stack.begin(), stack.end(), 0);
+    std::fill(timerCounts.begin(), timerCounts.end(), 0);
+    running = ALL_LANES;
+    faulted = 0;
+    for (std::string& message : faults) {
+        message.clear();
+    }
+    cycleCount = 0;
+}
+
+void BitSlicedModel::clock() {
+    cycleCount++;
+    if (clk) {
+        clk = false;
+        return;
+    }
+    clk = true;
+    if (rst) {
+        reset();
+        return;
+    }
+
+    for (const Group& group : groups) {
+        executeGroup(group);
+    }
+    groups.clear();
+    for (uint32_t address : nextTargets) {
+        groups.push_back({address, nextLanes[address]});
+        nextLanes[address] = 0;
+    }
+    nextTargets.clear();
+}
+
+void BitSlicedModel::setInput(uint32_t input, uint64_t lanes) {
+    if (input < inputs.size()) {
+        inputs[input] = lanes;
+    }
+}
+
+uint32_t BitSlicedModel::getAddress(uint32_t lane) const {
+    for (const Group& group : groups) {
+        if ((group.lanes >> lane) & 1) {
+            return group.address;
+        }
+    }
+    return UINT32_MAX;
+}
+
+uint64_t BitSlicedModel::getLanesAt(uint32_t address) const {
+    for (const Group& group : groups) {
+        if (group.address == address) {
+            return group.lanes;
+        }
+    }
+    return 0;
+}
+
+void BitSlicedModel::retire(uint64_t lanes) {
+    running &= ~lanes;
+    for (Group& group : groups) {
+        group.lanes &= ~lanes;
+    }
+    groups.erase(std::remove_if(groups.begin(), groups.end(), [](const Group& group) { return group.lanes == 0; }),
+                 groups.end());
+}
+
+void BitSlicedModel::enableProfiling() {
+    profiling = true;
+    addressHits.assign(decoded.size(), 0);
+    branchTaken.assign(decoded.size(), 0);
+    branchNotTaken.assign(decoded.size(), 0);
+}
+
+// The word at the group's address, once for all of its lanes, as
+// HotstateModel::executeEdge
+void BitSlicedModel::executeGroup(const Group& group) {
+    uint32_t pc = group.address;
+    uint64_t lanes = group.lanes;
+    if (pc >= decoded.size()) {
+        fault(lanes, "Address " + std::to_string(pc) + " exceeds microcode memory size " +
+                     std::to_string(decoded.size()));
+        return;
+    }
+    const DecodedMicrocode& mc = decoded[pc];
+
+    if (mc.sub) {
+        uint64_t overflow = 0;
+        for (uint64_t rest = lanes; rest != 0; rest &= rest - 1) {
+            uint32_t lane = static_cast<uint32_t>(__builtin_ctzll(rest));
+            if (stackPointer[lane] >= stackDepth) {
+                overflow |= 1ULL << lane;
+            }
+        }
+        if (overflow != 0) {
+            fault(overflow, "Call at address " + std::to_string(pc) + " overflows the " +
+                            std::to_string(stackDepth) + "-entry stack (STACK_DEPTH)");
+            lanes &= ~overflow;
+            if (lanes == 0) {
+                return;
+            }
+        }
+    }
+
+    // Timers see the counts from before this edge
+    uint64_t timerDone = 0;
+    if (mc.timerSel != 0 && numTimers > 0) {
+        for (uint64_t rest = lanes; rest != 0; rest &= rest - 1) {
+            uint32_t lane = static_cast<uint32_t>(__builtin_ctzll(rest));
+            if (HotstateModel::clockTimers(mc, timerCounts.data() + static_cast<size_t>(lane) * numTimers,
+                                           numTimers, timdata, params).done) {
+                timerDone |= 1ULL << lane;
+            }
+        }
+    }
+
+    // State capture: every state the word's transition mask covers takes
+    // the word's value in all of the group's lanes
+    if (mc.stateCapture) {
+        const std::vector<uint64_t>& mask = mc.transitionValue.getWords();
+        const std::vector<uint64_t>& value = mc.stateValue.getWords();
+        for (size_t w = 0; w < mask.size(); ++w) {
+            for (uint64_t rest = mask[w]; rest != 0; rest &= rest - 1) {
+                uint32_t bit = static_cast<uint32_t>(__builtin_ctzll(rest));
+                uint32_t state = static_cast<uint32_t>(w * 64 + bit);
+                if (state < states.size()) {
+                    states[state] = ((value[w] >> bit) & 1) ? states[state] | lanes : states[state] & ~lanes;
+                }
+            }
+        }
+    }
+
+    uint64_t fired = 0;
+    if (mc.forcedJmp || mc.rtn) {
+        fired = lanes;
+    } else if (mc.branch) {
+        fired = mc.varOrTimer ? lanes & ~timerDone : evaluate(mc.varSel, lanes);
+    }
+
+    if (profiling) {
+        addressHits[pc] += __builtin_popcountll(lanes);
+        if (mc.branch) {
+            branchTaken[pc] += __builtin_popcountll(fired);
+            branchNotTaken[pc] += __builtin_popcountll(lanes & ~fired);
+        }
+    }
+
+    sendTo(pc + 1, lanes & ~fired);
+    if (mc.rtn) {
+        for (uint64_t rest = fired; rest != 0; rest &= rest - 1) {
+            uint32_t lane = static_cast<uint32_t>(__builtin_ctzll(rest));
+            uint32_t target = mc.jadr;
+            if (stackPointer[lane] > 0) {
+                target = stack[static_cast<size_t>(lane) * stackDepth + --stackPointer[lane]];
+            }
+            sendTo(target, 1ULL << lane);
+        }
+    } else {
+        sendTo(mc.jadr, fired);
+    }
+    if (mc.sub) {
+        for (uint64_t rest = lanes; rest != 0; rest &= rest - 1) {
+            uint32_t lane = static_cast<uint32_t>(__builtin_ctzll(rest));
+            stack[static_cast<size_t>(lane) * stackDepth + stackPointer[lane]++] = pc + 1;
+        }
+    }
+}
+
+void BitSlicedModel::fault(uint64_t lanes, const std::string& message) {
+    faulted |= lanes;
+    running &= ~lanes;
+    for (uint64_t rest = lanes; rest != 0; rest &= rest - 1) {
+        faults[__builtin_ctzll(rest)] = message;
+    }
+}
+
+// Lanes leave for address on this edge, wrapping past the end as the model does
+void BitSlicedModel::sendTo(uint32_t address, uint64_t lanes) {
+    if (lanes == 0) {
+        return;
+    }
+    if (address >= params.NUM_WORDS) {
+        address = 0;
+    }
+    if (nextLanes[address] == 0) {
+        nextTargets.push_back(address);
+    }
+    nextLanes[address] |= lanes;
+}
+
+// The lanes of lanes where varSel's LUT entry for the lane's inputs is 1
+uint64_t BitSlicedModel::evaluate(uint32_t varSel, uint64_t lanes) {
+    uint32_t root = buildCondition(varSel);
+    if (root == FALSE_NODE) {
+        return 0;
+    }
+    if (root == TRUE_NODE) {
+        return lanes;
+    }
+    for (uint32_t id : rootOrder[varSel]) {
+        const DecisionNode& node = nodes[id];
+        uint64_t in = inputs[node.var];
+        nodeLanes[id] = (in & nodeLanes[node.hi]) | (~in & nodeLanes[node.lo]);
+    }
+    return nodeLanes[root] & lanes;
+}
+
+uint32_t BitSlicedModel::buildCondition(uint32_t varSel) {
+    if (varSel >= roots.size()) {
+        return FALSE_NODE;
+    }
+    if (roots[varSel] != UINT32_MAX) {
+        return roots[varSel];
+    }
+    uint32_t root = buildNode(varSel, numVars, 0);
+    roots[varSel] = root;
+
+    // The nodes under root, children first
+    std::vector<uint32_t>& order = rootOrder[varSel];
+    std::vector<bool> seen(nodes.size(), false);
+    std::vector<std::pair<uint32_t, bool>> pending{{root, false}};
+    while (!pending.empty()) {
+        auto [id, expanded] = pending.back();
+        pending.pop_back();
+        if (id <= TRUE_NODE || (seen[id] && !expanded)) {
+            continue;
+        }
+        if (expanded) {
+            order.push_back(id);
+            continue;
+        }
+        seen[id] = true;
+        pending.push_back({id, true});
+        pending.push_back({nodes[id].hi, false});
+        pending.push_back({nodes[id].lo, false});
+    }
+
+    nodeLanes.resize(nodes.size(), 0);
+    nodeLanes[FALSE_NODE] = 0;
+    nodeLanes[TRUE_NODE] = ALL_LANES;
+    return root;
+}
+
+// The node for varSel's LUT entries [offset, offset + 2^level), split on
+// input level - 1; a split whose halves are the same node is that node
+uint32_t BitSlicedModel::buildNode(uint32_t varSel, uint32_t level, uint64_t offset) {
+    if (level == 0) {
+        return lut.lookup(varSel, offset) ? TRUE_NODE : FALSE_NODE;
+    }
+    uint32_t var = level - 1;
+    uint32_t lo = buildNode(varSel, var, offset);
+    uint32_t hi = buildNode(varSel, var, offset | (1ULL << var));
+    if (lo == hi) {
+        return lo;
+    }
+    auto inserted = uniqueNodes.emplace(std::make_tuple(var, lo, hi), static_cast<uint32_t>(nodes.size()));
+    if (inserted.second) {
+        nodes.push_back({var, lo, hi});
+    }
+    return inserted.first->second;
+}
+
+} // namespace HotstateSim
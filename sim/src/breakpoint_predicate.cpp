@@ -0,0 +1,241 @@
+#include "breakpoint_predicate.h"
+#include "utils.h"
+#include <cctype>
+
+namespace HotstateSim {
+
+// Recursive descent over the expression text, emitting postfix code
+class PredicateCompiler {
+public:
+    using Op = BreakpointPredicate::Op;
+
+    PredicateCompiler(const std::string& text, const MemoryLoader& memory, const HotstateModel& model,
+                      std::vector<BreakpointPredicate::Instruction>& code)
+        : text(text), pos(0), memory(memory)
+        , numStates(model.getNumOutputs())
+        , numInputs(static_cast<uint32_t>(model.getInputs().size()))
+        , code(code), depth(0), maxDepth(0) {}
+
+    void compile() {
+        parseOr();
+        skipSpace();
+        if (pos != text.size()) {
+            fail("unexpected '" + text.substr(pos, 1) + "'");
+        }
+        if (maxDepth > BreakpointPredicate::MAX_DEPTH) {
+            fail("nested too deeply");
+        }
+    }
+
+private:
+    const std::string& text;
+    size_t pos;
+    const MemoryLoader& memory;
+    uint32_t numStates;
+    uint32_t numInputs;
+    std::vector<BreakpointPredicate::Instruction>& code;
+    size_t depth;
+    size_t maxDepth;
+
+    [[noreturn]] void fail(const std::string& why) const {
+        throw SimulatorException("Invalid breakpoint expression '" + text + "': " + why);
+    }
+
+    void emit(Op op, uint32_t a = 0, uint32_t b = 0) {
+        if (op <= Op::ADDR) {
+            depth++;
+            if (depth > maxDepth) maxDepth = depth;
+        } else if (op != Op::NOT && op != Op::IN_RANGE) {
+            depth--;
+        }
+        code.push_back({op, a, b});
+    }
+
+    void skipSpace() {
+        while (pos < text.size() && std::isspace(static_cast<unsigned char>(text[pos]))) pos++;
+    }
+
+    bool accept(const char* token) {
+        skipSpace();
+        size_t len = std::char_traits<char>::length(token);
+        if (text.compare(pos, len, token) != 0) return false;
+        pos += len;
+        return true;
+    }
+
+    void expect(const char* token) {
+        if (!accept(token)) fail(std::string("expected '") + token + "'");
+    }
+
+    bool peekIdentifier() {
+        skipSpace();
+        return pos < text.size() && (std::isalpha(static_cast<unsigned char>(text[pos])) || text[pos] == '_');
+    }
+
+    std::string identifier() {
+        size_t start = pos;
+        while (pos < text.size() && (std::isalnum(static_cast<unsigned char>(text[pos])) || text[pos] == '_')) pos++;
+        return text.substr(start, pos - start);
+    }
+
+    uint32_t number() {
+        skipSpace();
+        size_t start = pos;
+        while (pos < text.size() && std::isalnum(static_cast<unsigned char>(text[pos]))) pos++;
+        std::string digits = text.substr(start, pos - start);
+        try {
+            size_t used = 0;
+            unsigned long value = std::stoul(digits, &used, 0);
+            if (used == digits.size() && value <= UINT32_MAX) {
+                return static_cast<uint32_t>(value);
+            }
+        } catch (const std::exception&) {
+        }
+        fail(digits.empty() ? "expected a number" : "bad number '" + digits + "'");
+    }
+
+    uint32_t checkedIndex(uint32_t index, uint32_t limit, const char* what) const {
+        if (index >= limit) {
+            fail(std::string(what) + " " + std::to_string(index) + " out of range (" +
+                 std::to_string(limit) + " available)");
+        }
+        return index;
+    }
+
+    void parseOr() {
+        parseAnd();
+        while (accept("||")) {
+            parseAnd();
+            emit(Op::OR);
+        }
+    }
+
+    void parseAnd() {
+        parseUnary();
+        while (accept("&&")) {
+            parseUnary();
+            emit(Op::AND);
+        }
+    }
+
+    void parseUnary() {
+        skipSpace();
+        if (text.compare(pos, 1, "!") == 0 && text.compare(pos, 2, "!=") != 0) {
+            pos++;
+            parseUnary();
+            emit(Op::NOT);
+        } else {
+            parseComparison();
+        }
+    }
+
+    void parseComparison() {
+        parseValue();
+        static const struct { const char* token; Op op; } comparisons[] = {
+            {"==", Op::EQ}, {"!=", Op::NE}, {"<=", Op::LE}, {">=", Op::GE}, {"<", Op::LT}, {">", Op::GT}
+        };
+        for (const auto& c : comparisons) {
+            if (accept(c.token)) {
+                parseValue();
+                emit(c.op);
+                return;
+            }
+        }
+        size_t save = pos;
+        if (peekIdentifier() && identifier() == "in") {
+            expect("[");
+            uint32_t first = number();
+            expect(",");
+            uint32_t last = number();
+            uint32_t end = last;
+            if (accept("]")) {
+                if (last == UINT32_MAX) fail("range end too large");
+                end = last + 1;
+            } else {
+                expect(")");
+            }
+            emit(Op::IN_RANGE, first, end);
+            return;
+        }
+        pos = save;
+    }
+
+    void parseValue() {
+        if (accept("(")) {
+            parseOr();
+            expect(")");
+            return;
+        }
+        if (!peekIdentifier()) {
+            emit(Op::PUSH, number());
+            return;
+        }
+        std::string word = identifier();
+        if (word == "addr") {
+            emit(Op::ADDR);
+        } else if (word == "state" || word == "input") {
+            bool isState = word == "state";
+            uint32_t index;
+            if (accept("[")) {
+                index = number();
+                expect("]");
+            } else if (peekIdentifier()) {
+                std::string name = identifier();
+                index = isState ? memory.getStateIndexByName(name) : memory.getInputIndexByName(name);
+                if (index == UINT32_MAX) fail("no " + word + " named '" + name + "'");
+            } else {
+                fail("expected '[' or a name after '" + word + "'");
+            }
+            if (isState) {
+                emit(Op::STATE, checkedIndex(index, numStates, "state"));
+            } else {
+                emit(Op::INPUT, checkedIndex(index, numInputs, "input"));
+            }
+        } else {
+            uint32_t index = memory.getStateIndexByName(word);
+            if (index != UINT32_MAX) {
+                emit(Op::STATE, checkedIndex(index, numStates, "state"));
+            } else if ((index = memory.getInputIndexByName(word)) != UINT32_MAX) {
+                emit(Op::INPUT, checkedIndex(index, numInputs, "input"));
+            } else {
+                fail("unknown name '" + word + "'");
+            }
+        }
+    }
+};
+
+BreakpointPredicate::BreakpointPredicate(const std::string& text, const MemoryLoader& memory,
+                                         const HotstateModel& model)
+    : text(text)
+{
+    PredicateCompiler(this->text, memory, model, code).compile();
+}
+
+uint32_t BreakpointPredicate::evaluate(const HotstateModel& model) const {
+    // Indices were checked against the model when compiling
+    uint32_t stack[MAX_DEPTH];
+    size_t sp = 0;
+    for (const Instruction& in : code) {
+        switch (in.op) {
+            case Op::PUSH:  stack[sp++] = in.a; break;
+            case Op::STATE: stack[sp++] = model.getStates()[in.a]; break;
+            case Op::INPUT: stack[sp++] = model.getInputs()[in.a]; break;
+            case Op::ADDR:  stack[sp++] = model.getCurrentAddress(); break;
+            case Op::EQ:  sp--; stack[sp - 1] = stack[sp - 1] == stack[sp]; break;
+            case Op::NE:  sp--; stack[sp - 1] = stack[sp - 1] != stack[sp]; break;
+            case Op::LT:  sp--; stack[sp - 1] = stack[sp - 1] < stack[sp]; break;
+            case Op::LE:  sp--; stack[sp - 1] = stack[sp - 1] <= stack[sp]; break;
+            case Op::GT:  sp--; stack[sp - 1] = stack[sp - 1] > stack[sp]; break;
+            case Op::GE:  sp--; stack[sp - 1] = stack[sp - 1] >= stack[sp]; break;
+            case Op::AND: sp--; stack[sp - 1] = stack[sp - 1] && stack[sp]; break;
+            case Op::OR:  sp--; stack[sp - 1] = stack[sp - 1] || stack[sp]; break;
+            case Op::NOT: stack[sp - 1] = !stack[sp - 1]; break;
+            case Op::IN_RANGE:
+                stack[sp - 1] = stack[sp - 1] >= in.a && stack[sp - 1] < in.b;
+                break;
+        }
+    }
+    return stack[0];
+}
+
+} // namespace HotstateSim
@@ -0,0 +1,324 @@
+#include "debug_script.h"
+#include "breakpoint_predicate.h"
+#include "utils.h"
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <cctype>
+
+namespace HotstateSim {
+
+namespace {
+
+uint32_t parseCount(const std::string& text) {
+    uint64_t count = parseCycleCount(text);
+    if (count > UINT32_MAX) {
+        throw SimulatorException("Count out of range: " + text);
+    }
+    return static_cast<uint32_t>(count);
+}
+
+void printStop(const Simulator& simulator) {
+    if (simulator.isFinished()) {
+        std::cout << "Finished at cycle " << simulator.getCurrentCycle() << std::endl;
+    } else if (simulator.isBreakpointHit()) {
+        std::cout << "Breakpoint at cycle " << simulator.getCurrentCycle() << ": "
+                  << simulator.getBreakpointReason() << std::endl;
+    } else {
+        std::cout << "At cycle " << simulator.getCurrentCycle() << std::endl;
+    }
+}
+
+} // namespace
+
+DebugScript DebugScript::load(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        throw SimulatorException("Cannot open debugger script: " + path);
+    }
+    DebugScript script;
+    script.path = path;
+    std::string line;
+    for (uint32_t number = 1; std::getline(file, line); ++number) {
+        std::string text = trim(line.substr(0, line.find('#')));
+        if (text.empty()) {
+            continue;
+        }
+        try {
+            Command command = parse(text);
+            command.line = number;
+            script.commands.push_back(std::move(command));
+        } catch (const SimulatorException& e) {
+            throw SimulatorException(path + ":" + std::to_string(number) + ": " + e.what());
+        }
+    }
+    return script;
+}
+
+DebugScript::Command DebugScript::parse(const std::string& line) {
+    static const struct {
+        const char* name;
+        Op op;
+    } names[] = {
+        {"run", Op::RUN}, {"run-to", Op::RUN_TO}, {"step", Op::STEP}, {"back", Op::BACK},
+        {"goto", Op::GOTO}, {"checkpoint", Op::CHECKPOINT}, {"break-if", Op::BREAK_IF},
+        {"break-on-change", Op::BREAK_ON_CHANGE}, {"break-state", Op::BREAK_STATE},
+        {"break-addr", Op::BREAK_ADDR}, {"break-clear", Op::BREAK_CLEAR}, {"set-input", Op::SET_INPUT},
+        {"dump", Op::DUMP}, {"expect", Op::EXPECT}, {"echo", Op::ECHO}, {"reset", Op::RESET},
+        {"load", Op::LOAD}, {"patch", Op::PATCH}, {"quit", Op::QUIT},
+    };
+
+    std::istringstream in(line);
+    std::string name;
+    in >> name;
+    std::string rest;
+    std::getline(in, rest);
+    rest = trim(rest);
+    std::vector<std::string> words;
+    std::istringstream args(rest);
+    for (std::string word; args >> word;) {
+        words.push_back(word);
+    }
+
+    Command command{0, Op::QUIT, 0, "", {}};
+    bool known = false;
+    for (const auto& entry : names) {
+        if (name == entry.name) {
+            command.op = entry.op;
+            known = true;
+            break;
+        }
+    }
+    if (!known) {
+        throw SimulatorException("Unknown debugger command: " + name);
+    }
+
+    auto expectWords = [&](size_t least, size_t most) {
+        if (words.size() < least || words.size() > most) {
+            throw SimulatorException(name + " takes " +
+                                     (least == most ? std::to_string(least)
+                                                    : std::to_string(least) + " to " + std::to_string(most)) +
+                                     " argument" + (most == 1 ? "" : "s"));
+        }
+    };
+
+    switch (command.op) {
+        case Op::RUN:
+        case Op::CHECKPOINT:
+        case Op::BREAK_CLEAR:
+        case Op::RESET:
+        case Op::QUIT:
+            expectWords(0, 0);
+            break;
+
+        case Op::RUN_TO:
+        case Op::GOTO:
+            expectWords(1, 1);
+            command.number = parseCycleCount(words[0]);
+            break;
+
+        case Op::STEP:
+        case Op::BACK:
+            expectWords(0, 1);
+            command.number = words.empty() ? 1 : parseCount(words[0]);
+            break;
+
+        case Op::BREAK_STATE:
+            expectWords(1, 1);
+            command.number = parseCount(words[0]);
+            break;
+
+        case Op::BREAK_ADDR:
+            expectWords(1, 1);
+            command.number = parseHex(words[0]);
+            break;
+
+        case Op::SET_INPUT:
+            expectWords(2, 2);
+            command.text = words[0];
+            command.number = parseCount(words[1]);
+            if (command.number > UINT8_MAX) {
+                throw SimulatorException("Input value out of range: " + words[1]);
+            }
+            break;
+
+        case Op::LOAD:
+        case Op::PATCH:
+            expectWords(1, 1);
+            command.text = words[0];
+            break;
+
+        case Op::BREAK_IF:
+        case Op::BREAK_ON_CHANGE:
+        case Op::EXPECT:
+            // Checked against the program when the command runs
+            if (rest.empty()) {
+                throw SimulatorException(name + " needs an expression");
+            }
+            command.text = rest;
+            break;
+
+        case Op::ECHO:
+            command.text = rest;
+            break;
+
+        case Op::DUMP:
+            for (const std::string& word : words) {
+                if (word != "state" && word != "vars" && word != "inputs" && word != "stack" &&
+                    word != "signals" && word != "microcode" && word != "memory" && word != "stats") {
+                    throw SimulatorException("Cannot dump " + word +
+                                             "; use state, vars, inputs, stack, signals, microcode, memory or stats");
+                }
+            }
+            command.words = words.empty() ? std::vector<std::string>{"state", "inputs"} : words;
+            break;
+    }
+    return command;
+}
+
+bool DebugScript::run(Simulator& simulator) const {
+    for (const Command& command : commands) {
+        if (command.op == Op::QUIT) {
+            return true;
+        }
+        if (!execute(simulator, command)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool DebugScript::fail(const Command& command, const std::string& message) const {
+    std::cerr << path << ":" << command.line << ": " << message << std::endl;
+    return false;
+}
+
+bool DebugScript::execute(Simulator& simulator, const Command& command) const {
+    try {
+        switch (command.op) {
+            case Op::RUN:
+            case Op::RUN_TO:
+            case Op::STEP: {
+                if (simulator.isFinished()) {
+                    printStop(simulator);
+                    break;
+                }
+                bool ok = command.op == Op::RUN ? simulator.run()
+                        : command.op == Op::RUN_TO ? simulator.stepToCycle(command.number)
+                        : simulator.step(static_cast<uint32_t>(command.number));
+                if (!ok || simulator.hasError()) {
+                    return fail(command, simulator.getLastError());
+                }
+                if (command.op == Op::STEP && simulator.getCurrentCycle() >= simulator.getConfig().maxCycles) {
+                    std::cout << "Finished at cycle " << simulator.getCurrentCycle() << std::endl;
+                } else {
+                    printStop(simulator);
+                }
+                break;
+            }
+
+            case Op::BACK:
+            case Op::GOTO: {
+                bool ok = command.op == Op::BACK ? simulator.stepBack(static_cast<uint32_t>(command.number))
+                                                 : simulator.restoreToCycle(command.number);
+                if (!ok) {
+                    return fail(command, simulator.getLastError());
+                }
+                std::cout << "At cycle " << simulator.getCurrentCycle() << std::endl;
+                break;
+            }
+
+            case Op::CHECKPOINT:
+                simulator.addCheckpoint();
+                break;
+
+            case Op::BREAK_IF:
+                simulator.addConditionBreakpoint(command.text);
+                break;
+
+            case Op::BREAK_ON_CHANGE:
+                simulator.addWatchBreakpoint(command.text);
+                break;
+
+            case Op::BREAK_STATE:
+                simulator.addStateBreakpoint(static_cast<uint32_t>(command.number));
+                break;
+
+            case Op::BREAK_ADDR:
+                simulator.addAddressBreakpoint(static_cast<uint32_t>(command.number));
+                break;
+
+            case Op::BREAK_CLEAR:
+                simulator.clearBreakpoints();
+                break;
+
+            case Op::SET_INPUT: {
+                uint8_t value = static_cast<uint8_t>(command.number);
+                if (std::isdigit(static_cast<unsigned char>(command.text[0]))) {
+                    simulator.setInputValue(parseDecimal(command.text), value);
+                } else if (!simulator.setInputValueByName(command.text, value)) {
+                    return fail(command, "No input named " + command.text);
+                }
+                break;
+            }
+
+            case Op::DUMP:
+                std::cout << "Cycle: " << simulator.getCurrentCycle() << std::endl;
+                for (const std::string& what : command.words) {
+                    if (what == "state") {
+                        simulator.inspectState();
+                    } else if (what == "vars") {
+                        simulator.inspectVariables();
+                    } else if (what == "inputs") {
+                        simulator.inspectInputs();
+                    } else if (what == "stack") {
+                        simulator.inspectStack();
+                    } else if (what == "signals") {
+                        simulator.inspectControlSignals();
+                    } else if (what == "microcode") {
+                        simulator.inspectMicrocode();
+                    } else if (what == "memory") {
+                        simulator.inspectMemory();
+                    } else {
+                        simulator.printStatistics();
+                    }
+                }
+                break;
+
+            case Op::EXPECT: {
+                BreakpointPredicate expression(command.text, simulator.getMemoryLoader(), simulator.getHotstateModel());
+                if (!expression.evaluate(simulator.getHotstateModel())) {
+                    return fail(command, "expect failed at cycle " + std::to_string(simulator.getCurrentCycle()) +
+                                             ": " + command.text);
+                }
+                break;
+            }
+
+            case Op::ECHO:
+                std::cout << command.text << std::endl;
+                break;
+
+            case Op::RESET:
+                simulator.reset();
+                break;
+
+            case Op::LOAD:
+            case Op::PATCH: {
+                bool ok = command.op == Op::LOAD ? simulator.swapProgram(command.text)
+                                                 : simulator.applyPatch(command.text);
+                if (!ok) {
+                    return fail(command, simulator.getLastError());
+                }
+                break;
+            }
+
+            case Op::QUIT:
+                break;
+        }
+    } catch (const SimulatorException& e) {
+        return fail(command, e.what());
+    }
+    return true;
+}
+
+} // namespace HotstateSim
@@ -0,0 +1,231 @@
+#include "exhaustive_runner.h"
+#include "bitsliced_model.h"
+#include "profile_report.h"
+#include "utils.h"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+
+namespace HotstateSim {
+
+namespace {
+
+constexpr size_t MAX_FAILURES_SHOWN = 20;
+
+// Bit j of each lane's index, for the six bits that select a lane
+constexpr uint64_t LANE_BITS[6] = {
+    0xAAAAAAAAAAAAAAAAULL, 0xCCCCCCCCCCCCCCCCULL, 0xF0F0F0F0F0F0F0F0ULL,
+    0xFF00FF00FF00FF00ULL, 0xFFFF0000FFFF0000ULL, 0xFFFFFFFF00000000ULL
+};
+
+} // namespace
+
+ExhaustiveRunner::ExhaustiveRunner(const SimulatorConfig& cfg, uint32_t numPeriods)
+    : config(cfg)
+    , periods(numPeriods)
+    , jobs(cfg.jobs)
+    , numInputs(0)
+    , sequenceBits(0)
+    , blockCount(0)
+    , elapsed(0)
+{
+    if (jobs == 0) {
+        jobs = std::max(1u, std::thread::hardware_concurrency());
+    }
+}
+
+bool ExhaustiveRunner::initialize() {
+    if (config.basePath.empty()) {
+        lastError = "Base path not specified";
+        return false;
+    }
+    if (!memoryLoader.loadProgram(config.basePath, config.sourceFile) || !memoryLoader.isLoaded()) {
+        lastError = "Failed to load memory files from base path: " + config.basePath;
+        return false;
+    }
+    if (config.verbose) {
+        memoryLoader.printMemoryInfo();
+    }
+
+    const Parameters& params = memoryLoader.getParams();
+    if (params.PIPELINED) {
+        lastError = "--exhaustive does not support PIPELINED programs";
+        return false;
+    }
+    numInputs = params.NUM_VARS;
+    if (numInputs > 64 || static_cast<uint64_t>(numInputs) * periods > MAX_SEQUENCE_BITS) {
+        lastError = "--exhaustive " + std::to_string(periods) + " would run 2^" +
+                    std::to_string(static_cast<uint64_t>(numInputs) * periods) + " sequences of " +
+                    std::to_string(numInputs) + " inputs; at most 2^" + std::to_string(MAX_SEQUENCE_BITS) +
+                    " are allowed";
+        return false;
+    }
+    sequenceBits = numInputs * periods;
+    blockCount = sequenceBits > 6 ? 1ULL << (sequenceBits - 6) : 1;
+
+    decoded = HotstateModel::decodeProgram(memoryLoader.getSmdata(), params);
+    hits.assign(decoded.size(), 0);
+    taken.assign(decoded.size(), 0);
+    notTaken.assign(decoded.size(), 0);
+    return true;
+}
+
+bool ExhaustiveRunner::run() {
+    const uint32_t cycles = Simulator::RESET_CYCLES + 2 * periods;
+    // Fewer than 64 sequences leave the high lanes as copies; they are retired
+    const uint64_t valid = sequenceBits >= 6 ? BitSlicedModel::ALL_LANES : (1ULL << (1u << sequenceBits)) - 1;
+    std::atomic<uint64_t> nextBlock(0);
+    std::mutex merge;
+
+    auto worker = [&]() {
+        BitSlicedModel model(memoryLoader);
+        model.enableProfiling();
+        std::vector<SequenceFailure> found;
+
+        // Records lanes as failed at cycle and stops them
+        auto fail = [&](uint64_t block, uint64_t lanes, uint32_t cycle, const std::string& reason) {
+            for (uint64_t rest = lanes; rest != 0; rest &= rest - 1) {
+                found.push_back({block * BitSlicedModel::LANES + __builtin_ctzll(rest), cycle, reason});
+            }
+            model.retire(lanes);
+        };
+
+        for (uint64_t block = nextBlock++; block < blockCount; block = nextBlock++) {
+            model.reset();
+            model.setClock(false);
+            uint64_t faulted = 0;
+
+            for (uint32_t cycle = 0; cycle < cycles; ++cycle) {
+                // Breakpoints before each cycle, as Simulator::run checks them
+                for (uint32_t state : config.breakpointStates) {
+                    uint64_t lanes = state < model.getNumStates() ? model.getState(state) & model.getRunningLanes() & valid : 0;
+                    if (lanes != 0) {
+                        fail(block, lanes, cycle, "State[" + std::to_string(state) + "] = 1");
+                    }
+                }
+                for (uint32_t addr : config.breakpointAddresses) {
+                    uint64_t lanes = model.getLanesAt(addr) & valid;
+                    if (lanes != 0) {
+                        fail(block, lanes, cycle, "Address = " + toHexString(addr));
+                    }
+                }
+
+                if (cycle == Simulator::RESET_CYCLES && valid != BitSlicedModel::ALL_LANES) {
+                    model.retire(~valid);
+                }
+                if (cycle >= Simulator::RESET_CYCLES && (cycle - Simulator::RESET_CYCLES) % 2 == 0) {
+                    uint32_t period = (cycle - Simulator::RESET_CYCLES) / 2;
+                    for (uint32_t i = 0; i < numInputs; ++i) {
+                        uint32_t bit = period * numInputs + i;
+                        model.setInput(i, bit < 6 ? LANE_BITS[bit]
+                                                  : (((block >> (bit - 6)) & 1) ? BitSlicedModel::ALL_LANES : 0));
+                    }
+                }
+                model.setReset(cycle < Simulator::RESET_CYCLES);
+                model.clock();
+
+                uint64_t newFaults = model.getFaultedLanes() & ~faulted & valid;
+                faulted = model.getFaultedLanes();
+                for (uint64_t rest = newFaults; rest != 0; rest &= rest - 1) {
+                    uint32_t lane = static_cast<uint32_t>(__builtin_ctzll(rest));
+                    found.push_back({block * BitSlicedModel::LANES + lane, cycle, model.getFault(lane)});
+                }
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(merge);
+        for (size_t pc = 0; pc < decoded.size(); ++pc) {
+            hits[pc] += model.getAddressHits()[pc];
+            taken[pc] += model.getBranchTaken()[pc];
+            notTaken[pc] += model.getBranchNotTaken()[pc];
+        }
+        failures.insert(failures.end(), found.begin(), found.end());
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    uint32_t threadCount = static_cast<uint32_t>(std::min<uint64_t>(jobs, blockCount));
+    std::vector<std::thread> threads;
+    for (uint32_t t = 1; t < threadCount; ++t) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::sort(failures.begin(), failures.end(),
+              [](const SequenceFailure& a, const SequenceFailure& b) { return a.sequence < b.sequence; });
+    return failures.empty();
+}
+
+std::string ExhaustiveRunner::describe(uint64_t sequence) const {
+    std::string text;
+    for (uint32_t period = 0; period < periods; ++period) {
+        text += period == 0 ? "[" : " [";
+        for (uint32_t i = 0; i < numInputs; ++i) {
+            text += i == 0 ? "" : " ";
+            text += ((sequence >> (period * numInputs + i)) & 1) ? '1' : '0';
+        }
+        text += "]";
+    }
+    return text;
+}
+
+void ExhaustiveRunner::printSummary() const {
+    uint32_t words = static_cast<uint32_t>(decoded.size());
+    uint32_t reached = 0;
+    uint32_t branches = 0;
+    uint32_t directions = 0;
+    for (uint32_t pc = 0; pc < words; ++pc) {
+        reached += hits[pc] != 0;
+        if (decoded[pc].branch) {
+            branches++;
+            directions += (taken[pc] != 0) + (notTaken[pc] != 0);
+        }
+    }
+    uint64_t sequences = 1ULL << sequenceBits;
+
+    std::cout << "=== Exhaustive Sequences ===" << std::endl;
+    std::cout << "Sequences: " << sequences << " (" << numInputs << " inputs, " << periods
+              << " periods), blocks of " << BitSlicedModel::LANES << ": " << blockCount
+              << ", jobs: " << std::min<uint64_t>(jobs, blockCount) << std::endl;
+    std::cout << "Coverage: " << reached << "/" << words << " words, " << directions << "/" << 2 * branches
+              << " branch directions" << std::endl;
+    std::cout << "Failed: " << failures.size() << std::endl;
+    for (size_t i = 0; i < failures.size() && i < MAX_FAILURES_SHOWN; ++i) {
+        std::cout << "  sequence " << failures[i].sequence << " " << describe(failures[i].sequence)
+                  << ": cycle " << failures[i].cycle << ": " << failures[i].reason << std::endl;
+    }
+    if (failures.size() > MAX_FAILURES_SHOWN) {
+        std::cout << "  ... " << failures.size() - MAX_FAILURES_SHOWN << " more" << std::endl;
+    }
+    std::cout << "Time: " << std::fixed << std::setprecision(3) << elapsed << " s" << std::defaultfloat << std::endl;
+    std::cout << "============================" << std::endl;
+}
+
+bool ExhaustiveRunner::writeProfile(const std::string& filename) const {
+    HotstateModel model(memoryLoader);
+    model.addProfileCounts(hits, taken, notTaken);
+    if (filename == "-") {
+        writeProfileReport(std::cout, model, memoryLoader);
+        return true;
+    }
+    std::ofstream file(filename);
+    if (!file.is_open()) {
+        return false;
+    }
+    if (endsWith(filename, ".json")) {
+        writeProfileJson(file, model);
+    } else {
+        writeProfileReport(file, model, memoryLoader);
+    }
+    return true;
+}
+
+} // namespace HotstateSim
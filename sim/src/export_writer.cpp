@@ -0,0 +1,214 @@
+#include "export_writer.h"
+#include "trace_format.h"
+#include <iostream>
+
+namespace HotstateSim {
+
+ExportWriter::ExportWriter()
+    : format(OutputFormat::CSV)
+    , entries(0)
+{
+}
+
+ExportWriter::~ExportWriter() {
+    if (file.is_open()) {
+        finish();
+    }
+}
+
+bool ExportWriter::open(const std::string& exportFilename, OutputFormat exportFormat) {
+    if (exportFormat != OutputFormat::CSV && exportFormat != OutputFormat::JSON &&
+        exportFormat != OutputFormat::TRACE) {
+        std::cerr << "Export format must be csv, json or trace" << std::endl;
+        return false;
+    }
+
+    format = exportFormat;
+    filename = exportFilename;
+    entries = 0;
+    if (format == OutputFormat::TRACE) {
+        fileBuffer.resize(BUFFER_SIZE);
+        file.rdbuf()->pubsetbuf(fileBuffer.data(), fileBuffer.size());
+        file.open(filename, std::ios::out | std::ios::binary);
+    } else {
+        // CSV and JSON are buffered in text, so the stream needs none
+        file.rdbuf()->pubsetbuf(nullptr, 0);
+        file.open(filename, std::ios::out);
+        text.reserve(BUFFER_SIZE + 4096);
+    }
+    if (!file.is_open()) {
+        std::cerr << "Failed to open export file: " << filename << std::endl;
+        return false;
+    }
+
+    if (format == OutputFormat::TRACE) {
+        traceWriter = std::make_unique<TraceWriter>(file);
+    } else if (format == OutputFormat::JSON) {
+        put("[\n");
+    }
+    return true;
+}
+
+void ExportWriter::put(const char* literal) {
+    while (*literal) {
+        text.push_back(*literal++);
+    }
+}
+
+void ExportWriter::putDecimal(uint32_t value) {
+    char digits[10];
+    int count = 0;
+    do {
+        digits[count++] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+    while (count > 0) {
+        text.push_back(digits[--count]);
+    }
+}
+
+void ExportWriter::putHex(uint32_t value) {
+    static const char hexDigits[] = "0123456789abcdef";
+    char digits[8];
+    int count = 0;
+    do {
+        digits[count++] = hexDigits[value & 0xF];
+        value >>= 4;
+    } while (value > 0);
+    while (count > 0) {
+        text.push_back(digits[--count]);
+    }
+}
+
+void ExportWriter::writeText() {
+    file.write(text.data(), static_cast<std::streamsize>(text.size()));
+    text.clear();
+}
+
+void ExportWriter::writeCSVHeader(const LogRecord& rec) {
+    put("Cycle,Address,Ready,LHS,Fired");
+    for (uint32_t i = 0; i < rec.numStates; ++i) {
+        put(",State");
+        putDecimal(i);
+    }
+    for (uint32_t i = 0; i < rec.numOutputs; ++i) {
+        put(",Output");
+        putDecimal(i);
+    }
+    for (uint32_t i = 0; i < rec.numInputs; ++i) {
+        put(",Input");
+        putDecimal(i);
+    }
+    put('\n');
+}
+
+void ExportWriter::appendCSV(const LogView& entry) {
+    const LogRecord& rec = entry.record;
+    if (entries == 0) {
+        writeCSVHeader(rec);
+    }
+
+    putDecimal(rec.cycle);
+    put(',');
+    putDecimal(rec.address);
+    put(rec.ready ? ",1" : ",0");
+    put(rec.lhs ? ",1" : ",0");
+    put(rec.fired ? ",1" : ",0");
+    for (uint32_t i = 0; i < rec.numStates; ++i) {
+        put(entry.state(i) ? ",1" : ",0");
+    }
+    for (uint32_t i = 0; i < rec.numOutputs; ++i) {
+        put(",0x");
+        putHex(entry.outputs[i]);
+    }
+    for (uint32_t i = 0; i < rec.numInputs; ++i) {
+        put(",0x");
+        putHex(entry.inputs[i]);
+    }
+    put('\n');
+}
+
+// Entries are separated as they come, so the last one needs no lookahead
+void ExportWriter::appendJSON(const LogView& entry) {
+    const LogRecord& rec = entry.record;
+    if (entries > 0) {
+        put(",\n");
+    }
+
+    put("  {\n    \"cycle\": ");
+    putDecimal(rec.cycle);
+    put(",\n    \"address\": ");
+    putDecimal(rec.address);
+    put(",\n    \"ready\": ");
+    putBool(rec.ready, "true", "false");
+    put(",\n    \"lhs\": ");
+    putBool(rec.lhs, "true", "false");
+    put(",\n    \"fired\": ");
+    putBool(rec.fired, "true", "false");
+
+    put(",\n    \"states\": [");
+    for (uint32_t i = 0; i < rec.numStates; ++i) {
+        if (i > 0) put(", ");
+        putBool(entry.state(i), "true", "false");
+    }
+    put("],\n    \"outputs\": [");
+    for (uint32_t i = 0; i < rec.numOutputs; ++i) {
+        if (i > 0) put(", ");
+        putDecimal(entry.outputs[i]);
+    }
+    put("],\n    \"inputs\": [");
+    for (uint32_t i = 0; i < rec.numInputs; ++i) {
+        if (i > 0) put(", ");
+        putDecimal(entry.inputs[i]);
+    }
+    put("]\n  }");
+}
+
+void ExportWriter::append(const LogView& entry) {
+    if (!file.is_open()) return;
+
+    if (traceWriter) {
+        traceWriter->append(entry);
+    } else {
+        if (format == OutputFormat::CSV) {
+            appendCSV(entry);
+        } else {
+            appendJSON(entry);
+        }
+        if (text.size() >= BUFFER_SIZE) {
+            writeText();
+        }
+    }
+    entries++;
+}
+
+void ExportWriter::restart() {
+    if (traceWriter) {
+        traceWriter->restart();
+    }
+}
+
+bool ExportWriter::finish() {
+    if (!file.is_open()) return false;
+
+    if (traceWriter) {
+        traceWriter->finish();
+        traceWriter.reset();
+    } else if (format == OutputFormat::CSV) {
+        if (entries == 0) {
+            put("Cycle,Address,Ready,LHS,Fired\n");
+        }
+    } else {
+        put(entries > 0 ? "\n]\n" : "]\n");
+    }
+    writeText();
+
+    file.close();
+    bool ok = !file.fail();
+    if (!ok) {
+        std::cerr << "Failed to write export file: " << filename << std::endl;
+    }
+    return ok;
+}
+
+} // namespace HotstateSim
@@ -3,17 +3,62 @@
 #include <iostream>
 #include <iomanip>
 #include <algorithm>
+#include <iterator>
 
 namespace HotstateSim {
 
+VardataImage::VardataImage(const std::vector<uint32_t>& vardata, uint32_t numVars) {
+    // A LUT addressed by 64 or more inputs cannot be built; every entry reads 0
+    if (numVars >= 64) {
+        return;
+    }
+    this->numVars = numVars;
+    entries = vardata.size();
+    bits.assign((entries + 63) / 64, 0);
+    for (uint64_t i = 0; i < entries; ++i) {
+        if (vardata[i] & 1) {
+            bits[i >> 6] |= 1ULL << (i & 63);
+        }
+    }
+}
+
+int64_t VardataImage::witness(uint32_t varSel, bool value) const {
+    uint64_t block = 1ULL << numVars;
+    uint64_t first = static_cast<uint64_t>(varSel) << numVars;
+    for (uint64_t inputs = 0; inputs < block; ++inputs) {
+        if (first + inputs >= entries) {
+            // The rest of the block is past the image and reads 0
+            return value ? -1 : static_cast<int64_t>(inputs);
+        }
+        if (lookup(varSel, inputs) == value) {
+            return static_cast<int64_t>(inputs);
+        }
+    }
+    return -1;
+}
+
+uint64_t VardataImage::packInputs(const std::vector<uint8_t>& variables) {
+    uint64_t packed = 0;
+    for (size_t i = 0; i < variables.size() && i < 64; ++i) {
+        if (variables[i] != 0) {
+            packed |= 1ULL << i;
+        }
+    }
+    return packed;
+}
+
 HotstateModel::HotstateModel(const MemoryLoader& memory)
     : vardata(memory.getVardata())
     , switchdata(memory.getSwitchdata())
+    , timdata(memory.getTimdata())
     , smdata(memory.getSmdata())
     , params(memory.getParams())
+    , lut(memory.getVardata(), memory.getParams().NUM_VARS)
+    , inputBits(0)
     , address(0)
     , returnAddress(0)
     , stackPointer(0)
+    , timerDone(false)
     , ready(false)
     , lhs(false)
     , forcedJmp(false)
@@ -25,10 +70,23 @@ HotstateModel::HotstateModel(const MemoryLoader& memory)
     , switchActive(false)
     , fired(false)
     , varOrTimer(false)
+    , interrupt(false)
+    , interruptR(false)
+    , interruptFired(false)
+    , interruptAddress(memory.getParams().INTERRUPT_ADDRESS)
+    , pipelined(memory.getParams().PIPELINED != 0)
+    , bubble(false)
+    , fetchAddress(0)
     , clk(false)
     , rst(true)
     , hlt(false)
     , cycleCount(0)
+    , settled(false)
+    , lastEdgeReset(false)
+    , settledEdges(UINT32_MAX)
+    , profiling(false)
+    , activity(false)
+    , activityEdges(0)
     , jadr(0)
     , varSel(0)
     , timerSel(0)
@@ -37,15 +95,19 @@ HotstateModel::HotstateModel(const MemoryLoader& memory)
     , switchAdr(0)
 {
     // Initialize states
-    states.resize(params.NUM_STATES, false);
-    stateValue.resize(params.NUM_STATES, false);
-    transitionValue.resize(params.NUM_STATES, false);
+    states = StateBits(params.NUM_STATES);
+    
+    // Decode all of smdata up front
+    predecodeMicrocode();
     
     // Initialize variables
     variables.resize(params.NUM_VARS, 0);
     
     // Initialize stack
-    std::fill(std::begin(stack), std::end(stack), 0);
+    stack.assign(params.STACK_DEPTH, 0);
+    
+    // Initialize timers
+    timerCounts.assign(timerCount(params), 0);
     
     std::cout << "HotstateModel initialized with " << params.NUM_STATES << " states and " 
               << params.NUM_VARS << " variables" << std::endl;
@@ -53,20 +115,25 @@ HotstateModel::HotstateModel(const MemoryLoader& memory)
 
 void HotstateModel::reset() {
     // Reset all states to false
-    std::fill(states.begin(), states.end(), false);
-    std::fill(stateValue.begin(), stateValue.end(), false);
-    std::fill(transitionValue.begin(), transitionValue.end(), false);
+    states.clear();
     
     // Reset variables to initial values from vardata
     for (size_t i = 0; i < variables.size() && i < vardata.size(); ++i) {
         variables[i] = static_cast<uint8_t>(vardata[i] & 0xFF);
     }
+    inputBits = VardataImage::packInputs(variables);
     
     // Reset address and stack
     address = 0;
+    fetchAddress = 0;
+    bubble = pipelined;
     returnAddress = 0;
     stackPointer = 0;
-    std::fill(std::begin(stack), std::end(stack), 0);
+    std::fill(stack.begin(), stack.end(), 0);
+    
+    // Timers count from zero until loaded
+    std::fill(timerCounts.begin(), timerCounts.end(), 0);
+    timerDone = false;
     
     // Reset control signals
     ready = false;
@@ -80,6 +147,8 @@ void HotstateModel::reset() {
     switchActive = false;
     fired = false;
     varOrTimer = false;
+    interruptR = false;
+    interruptFired = false;
     
     // Reset microcode fields
     jadr = 0;
@@ -91,10 +160,81 @@ void HotstateModel::reset() {
     
     // Reset timing
     cycleCount = 0;
+    settled = false;
+    settledEdges = UINT32_MAX;
+    
+    if (!stateSubscribers.empty()) {
+        notifyStateChange();
+    }
     
     std::cout << "HotstateModel reset" << std::endl;
 }
 
+bool HotstateModel::* const HotstateModel::SNAPSHOT_FLAGS[] = {
+    &HotstateModel::timerDone, &HotstateModel::ready, &HotstateModel::lhs,
+    &HotstateModel::forcedJmp, &HotstateModel::jmpadr, &HotstateModel::sub,
+    &HotstateModel::rtn, &HotstateModel::branch, &HotstateModel::stateCapture,
+    &HotstateModel::switchActive, &HotstateModel::fired, &HotstateModel::varOrTimer,
+    &HotstateModel::clk, &HotstateModel::rst, &HotstateModel::hlt,
+    &HotstateModel::settled, &HotstateModel::lastEdgeReset, &HotstateModel::interrupt,
+    &HotstateModel::interruptR, &HotstateModel::interruptFired, &HotstateModel::bubble
+};
+
+uint32_t HotstateModel::* const HotstateModel::SNAPSHOT_FIELDS[] = {
+    &HotstateModel::jadr, &HotstateModel::varSel, &HotstateModel::timerSel,
+    &HotstateModel::timerLd, &HotstateModel::switchSel, &HotstateModel::switchAdr
+};
+
+HotstateSnapshot HotstateModel::saveSnapshot() const {
+    static_assert(sizeof(SNAPSHOT_FIELDS) / sizeof(SNAPSHOT_FIELDS[0]) ==
+                  sizeof(HotstateSnapshot::fields) / sizeof(HotstateSnapshot::fields[0]),
+                  "every microcode field has a snapshot slot");
+    HotstateSnapshot snapshot;
+    snapshot.states = states;
+    snapshot.variables = variables;
+    snapshot.timerCounts = timerCounts;
+    snapshot.cycleCount = cycleCount;
+    snapshot.address = address;
+    snapshot.fetchAddress = fetchAddress;
+    snapshot.returnAddress = returnAddress;
+    snapshot.stack = stack;
+    snapshot.stackPointer = stackPointer;
+    for (size_t i = 0; i < std::size(SNAPSHOT_FIELDS); ++i) {
+        snapshot.fields[i] = this->*SNAPSHOT_FIELDS[i];
+    }
+    snapshot.settledEdges = settledEdges;
+    for (size_t i = 0; i < std::size(SNAPSHOT_FLAGS); ++i) {
+        snapshot.flags |= static_cast<uint32_t>(this->*SNAPSHOT_FLAGS[i]) << i;
+    }
+    return snapshot;
+}
+
+void HotstateModel::restoreSnapshot(const HotstateSnapshot& snapshot) {
+    states = snapshot.states;
+    variables = snapshot.variables;
+    inputBits = VardataImage::packInputs(variables);
+    timerCounts = snapshot.timerCounts;
+    cycleCount = snapshot.cycleCount;
+    address = snapshot.address;
+    fetchAddress = snapshot.fetchAddress;
+    returnAddress = snapshot.returnAddress;
+    stack = snapshot.stack;
+    stackPointer = snapshot.stackPointer;
+    for (size_t i = 0; i < std::size(SNAPSHOT_FIELDS); ++i) {
+        this->*SNAPSHOT_FIELDS[i] = snapshot.fields[i];
+    }
+    settledEdges = snapshot.settledEdges;
+    for (size_t i = 0; i < std::size(SNAPSHOT_FLAGS); ++i) {
+        this->*SNAPSHOT_FLAGS[i] = (snapshot.flags >> i) & 1;
+    }
+    if (activity) {
+        recordActivity(false);
+    }
+    if (!stateSubscribers.empty()) {
+        notifyStateChange();
+    }
+}
+
 void HotstateModel::clock() {
     if (hlt) {
         return; // Halted, don't do anything
@@ -107,121 +247,576 @@ void HotstateModel::clock() {
         clk = true;
         
         if (rst) {
+            // Held in reset, every edge after the first gives the same registers
+            bool repeated = lastEdgeReset;
             reset();
+            settled = repeated;
+            lastEdgeReset = true;
+            if (activity) {
+                recordActivity(true);
+            }
             return;
         }
         
-        // Execute microcode at current address
-        executeMicrocode();
-        
-        // Update states based on microcode
-        updateStates();
-        
-        // Handle control logic
-        handleControlLogic();
-        
-        // Calculate next address
-        handleNextAddress();
+        if (bubble) {
+            // The empty word falls through: word 0 is read, nothing runs
+            address = fetchAddress;
+            fetchAddress = address + 1;
+            bubble = false;
+            ready = true;
+            settled = false;
+            lastEdgeReset = false;
+            if (activity) {
+                recordActivity(true);
+            }
+            return;
+        }
+        if (address >= decoded.size()) {
+            throw SimulatorException("Address " + std::to_string(address) + 
+                                   " exceeds microcode memory size " + std::to_string(decoded.size()));
+        }
+        // Execute the microcode at the current address
+        uint32_t pc = address;
+        (this->*handlers[pc])(decoded[pc]);
+        if (profiling) {
+            recordProfile(pc, 1);
+        }
+        if (activity) {
+            recordActivity(true);
+        }
     } else {
         clk = false;
     }
 }
 
-void HotstateModel::executeMicrocode() {
-    if (address >= smdata.size()) {
-        throw SimulatorException("Address " + std::to_string(address) + 
-                               " exceeds microcode memory size " + std::to_string(smdata.size()));
+void HotstateModel::run(uint64_t periods) {
+    if (periods == 0 || hlt) {
+        return;
     }
-    
-    uint64_t microcode = smdata[address];
-    extractMicrocodeFields(microcode);
-    
-    // Handle switch if active
-    if (switchActive) {
-        handleSwitch();
+    if (clk) {
+        throw SimulatorException("run() needs the clock low, between clock periods");
+    }
+    // Held in reset every edge gives the same registers; the pipeline's
+    // bubble is only ever the first edge out of reset
+    if (rst || bubble) {
+        clock();
+        clock();
+        if (rst || --periods == 0) {
+            return;
+        }
     }
     
-    // Handle variable selection and comparison
-    handleVariables();
+    const uint32_t words = static_cast<uint32_t>(decoded.size());
+    const bool profile = profiling;
+    const bool counting = activity;
+    const bool watched = !stateSubscribers.empty();
+    for (uint64_t i = 0; i < periods; ++i) {
+        uint32_t pc = address;
+        if (pc >= words) {
+            // Where clock() would have stopped: on this period's rising edge
+            cycleCount += 2 * i + 1;
+            clk = true;
+            throw SimulatorException("Address " + std::to_string(pc) +
+                                     " exceeds microcode memory size " + std::to_string(words));
+        }
+        if (watched) {
+            runWatchedEdge(pc, cycleCount + 2 * i + 1);
+        } else {
+            (this->*handlers[pc])(decoded[pc]);
+        }
+        if (profile) {
+            recordProfile(pc, 1);
+        }
+        if (counting) {
+            recordActivity(true);
+        }
+    }
+    cycleCount += 2 * periods;
+}
+
+// One run() edge with subscribers: they see the cycle count clock() would
+// give the edge, and one that throws leaves the model as a fault does
+void HotstateModel::runWatchedEdge(uint32_t pc, uint64_t edge) {
+    uint64_t periodStart = cycleCount;
+    cycleCount = edge;
+    try {
+        (this->*handlers[pc])(decoded[pc]);
+    } catch (...) {
+        clk = true;
+        throw;
+    }
+    cycleCount = periodStart;
+}
+
+void HotstateModel::predecodeMicrocode() {
+    decoded = decodeProgram(smdata, params);
+    handlers.clear();
+    handlers.reserve(decoded.size());
+    bool oneWord = states.getWords().size() == 1;
+    for (const DecodedMicrocode& mc : decoded) {
+        handlers.push_back(selectHandler(mc, oneWord));
+    }
+}
+
+std::vector<DecodedMicrocode> HotstateModel::decodeProgram(const std::vector<uint64_t>& smdata,
+                                                           const Parameters& params) {
+    uint32_t words = params.SMDATA_WORDS > 0 ? params.SMDATA_WORDS : 1;
+    std::vector<DecodedMicrocode> program;
+    program.reserve(smdata.size() / words);
+    for (size_t entry = 0; entry + words <= smdata.size(); entry += words) {
+        program.push_back(decodeMicrocodeWord(smdata.data() + entry, words, params));
+    }
+    return program;
 }
 
-void HotstateModel::extractMicrocodeFields(uint64_t microcode) {
+// Fields are read straight out of the multi-word entry, so an entry wider
+// than 64 bits costs only the extra words it spans, and only at load time.
+DecodedMicrocode HotstateModel::decodeMicrocodeWord(const uint64_t* microcode, uint32_t words,
+                                                    const Parameters& params) {
+    DecodedMicrocode mc{};
+    mc.stateValue = StateBits(params.NUM_STATES);
+    mc.transitionValue = StateBits(params.NUM_STATES);
+    
     // Extract state bits (lower 2*NUM_STATES bits)
     for (uint32_t i = 0; i < params.NUM_STATES; ++i) {
-        stateValue[i] = getBit(microcode, i);
-        transitionValue[i] = getBit(microcode, params.NUM_STATES + i);
+        mc.stateValue.set(i, getWideBit(microcode, words, i));
+        mc.transitionValue.set(i, getWideBit(microcode, words, params.NUM_STATES + i));
+    }
+    if (params.NUM_STATES > 0) {
+        mc.captureMask = mc.transitionValue.getWords()[0];
+        mc.captureValue = mc.stateValue.getWords()[0] & mc.captureMask;
     }
     
-    // Extract control bits (remaining bits)
-    uint64_t controlBits = microcode >> (2 * params.NUM_STATES);
-    
-    // Extract control fields based on parameter widths
-    uint32_t bitOffset = 0;
+    // Extract control fields (remaining bits) based on parameter widths
+    uint32_t bitOffset = 2 * params.NUM_STATES;
     
-    jadr = extractBits(controlBits, bitOffset, params.JADR_WIDTH);
+    mc.jadr = extractWideBits(microcode, words, bitOffset, params.JADR_WIDTH);
     bitOffset += params.JADR_WIDTH;
     
-    varSel = extractBits(controlBits, bitOffset, params.VARSEL_WIDTH);
+    mc.varSel = extractWideBits(microcode, words, bitOffset, params.VARSEL_WIDTH);
     bitOffset += params.VARSEL_WIDTH;
     
-    timerSel = extractBits(controlBits, bitOffset, params.TIMERSEL_WIDTH);
+    mc.timerSel = extractWideBits(microcode, words, bitOffset, params.TIMERSEL_WIDTH);
     bitOffset += params.TIMERSEL_WIDTH;
     
-    timerLd = extractBits(controlBits, bitOffset, params.TIMERLD_WIDTH);
+    mc.timerLd = extractWideBits(microcode, words, bitOffset, params.TIMERLD_WIDTH);
     bitOffset += params.TIMERLD_WIDTH;
     
-    switchSel = extractBits(controlBits, bitOffset, params.SWITCH_SEL_WIDTH);
+    mc.switchSel = extractWideBits(microcode, words, bitOffset, params.SWITCH_SEL_WIDTH);
     bitOffset += params.SWITCH_SEL_WIDTH;
     
-    switchAdr = extractBits(controlBits, bitOffset, params.SWITCH_ADR_WIDTH);
+    mc.switchAdr = extractWideBits(microcode, words, bitOffset, params.SWITCH_ADR_WIDTH);
     bitOffset += params.SWITCH_ADR_WIDTH;
     
-    stateCapture = getBit(controlBits, bitOffset);
+    mc.stateCapture = getWideBit(microcode, words, bitOffset);
     bitOffset += params.STATE_CAPTURE_WIDTH;
     
-    varOrTimer = getBit(controlBits, bitOffset);
+    mc.varOrTimer = getWideBit(microcode, words, bitOffset);
     bitOffset += params.VAR_OR_TIMER_WIDTH;
     
-    branch = getBit(controlBits, bitOffset);
+    mc.branch = getWideBit(microcode, words, bitOffset);
     bitOffset += params.BRANCH_WIDTH;
     
-    forcedJmp = getBit(controlBits, bitOffset);
+    mc.forcedJmp = getWideBit(microcode, words, bitOffset);
     bitOffset += params.FORCED_JMP_WIDTH;
     
-    sub = getBit(controlBits, bitOffset);
+    mc.sub = getWideBit(microcode, words, bitOffset);
     bitOffset += params.SUB_WIDTH;
     
-    rtn = getBit(controlBits, bitOffset);
+    mc.rtn = getWideBit(microcode, words, bitOffset);
     bitOffset += params.RTN_WIDTH;
+    
+    return mc;
 }
 
-void HotstateModel::updateStates() {
-    if (stateCapture) {
-        for (uint32_t i = 0; i < params.NUM_STATES; ++i) {
-            if (transitionValue[i]) {
-                states[i] = stateValue[i];
-            }
+// One rising edge for a word with the given control bits. The control bits
+// are constants here, so the branches on them fold away in each instantiation.
+// OneWord: the state register is a single word, captured without the loop.
+template <bool Capture, bool Branch, bool ForcedJmp, bool Sub, bool Rtn, bool OneWord>
+void HotstateModel::executeEdge(const DecodedMicrocode& mc) {
+    if (Sub && stackPointer >= stack.size()) {
+        throw SimulatorException("Call at address " + std::to_string(address) + " overflows the " +
+                                 std::to_string(stack.size()) + "-entry stack (STACK_DEPTH)");
+    }
+    uint32_t previousAddress = address;
+    uint32_t previousStackPointer = stackPointer;
+    
+    // Microcode fields
+    jadr = mc.jadr;
+    varSel = mc.varSel;
+    timerSel = mc.timerSel;
+    timerLd = mc.timerLd;
+    switchSel = mc.switchSel;
+    switchAdr = mc.switchAdr;
+    varOrTimer = mc.varOrTimer;
+    stateCapture = Capture;
+    branch = Branch;
+    forcedJmp = ForcedJmp;
+    sub = Sub;
+    rtn = Rtn;
+    
+    if (switchActive) {
+        handleSwitch();
+    }
+    
+    // Timers see the counts from before this edge, as the registers do
+    TimerEdge timers;
+    if (mc.timerSel != 0 && !timerCounts.empty()) {
+        timers = clockTimers(mc, timerCounts.data(), static_cast<uint32_t>(timerCounts.size()),
+                             timdata, params);
+    }
+    timerDone = timers.done;
+    
+    // Update states based on microcode
+    bool statesChanged = false;
+    if (Capture) {
+        statesChanged = OneWord ? states.captureWord(0, mc.captureValue, mc.captureMask)
+                                : states.capture(mc.stateValue, mc.transitionValue);
+    }
+    
+    // variable.sv: lhs is the Uber LUT entry {varSel, inputs}
+    lhs = lut.lookup(varSel, inputBits);
+    // control.sv: with var_or_timer the branch is taken until a selected
+    // timer is done, so a word that branches to itself waits out the count
+    bool taken = mc.varOrTimer ? !timerDone : lhs;
+    fired = (Branch && taken) || ForcedJmp || Rtn || switchActive;
+    jmpadr = fired;
+    
+    // Calculate next address
+    uint32_t nextAddress;
+    if (interruptFired) {
+        // next_address.sv puts the vector ahead of every jump but a switch,
+        // and sub_push = fired pushes address + 1 once, ahead of a pop
+        if (stackPointer >= stack.size()) {
+            throw SimulatorException("Interrupt at address " + std::to_string(address) + " overflows the " +
+                                     std::to_string(stack.size()) + "-entry stack (STACK_DEPTH)");
+        }
+        stack[stackPointer] = address + 1;
+        stackPointer++;
+        nextAddress = switchActive ? switchAdr : interruptAddress;
+    } else {
+        if (!fired) {
+            nextAddress = address + 1;
+        } else if (switchActive) {
+            nextAddress = switchAdr;
+        } else if (Rtn && stackPointer > 0) {
+            stackPointer--;
+            nextAddress = stack[stackPointer];
+        } else {
+            nextAddress = jadr;
+        }
+        
+        // Handle subroutine call
+        if (Sub) {
+            stack[stackPointer] = address + 1;
+            stackPointer++;
+        }
+    }
+    bool interruptChanged = interruptFired || interruptR != interrupt;
+    interruptFired = interrupt && !interruptR;
+    interruptR = interrupt;
+    
+    // Wrap around if we exceed memory size
+    if (nextAddress >= params.NUM_WORDS) {
+        nextAddress = 0;
+    }
+    
+    uint32_t previousFetchAddress = fetchAddress;
+    if (pipelined) {
+        // The word already fetched runs next; a jump redirects the fetch.
+        // Falling off the end wraps, as above, without redirecting.
+        uint32_t fetched = fetchAddress;
+        uint32_t following = address + 1 >= params.NUM_WORDS ? 0 : address + 1;
+        fetchAddress = nextAddress == following ? fetchAddress + 1 : nextAddress;
+        if (fetchAddress >= params.NUM_WORDS) {
+            fetchAddress = 0;
         }
+        nextAddress = fetched;
     }
+    address = nextAddress;
+    ready = true;
+    
+    // Control signals and microcode fields follow from the address and
+    // variables, and sub/rtn move the stack pointer, so these cover every
+    // register the next edge reads but the timers. A countdown that has not
+    // reached zero leaves the next edge the same but for the count.
+    settled = !statesChanged && address == previousAddress && fetchAddress == previousFetchAddress &&
+              stackPointer == previousStackPointer &&
+              !timers.reloaded && timers.countdown != 0 && !interruptChanged;
+    settledEdges = timers.countdown;
+    lastEdgeReset = false;
+    
+    if (statesChanged && !stateSubscribers.empty()) {
+        notifyStateChange();
+    }
+}
+
+// Kind bits: 1 stateCapture, 2 branch, 4 forcedJmp, 8 sub, 16 rtn, 32 one word
+template <size_t... Kinds>
+std::array<HotstateModel::EdgeHandler, sizeof...(Kinds)>
+HotstateModel::makeHandlerTable(std::index_sequence<Kinds...>) {
+    return {{&HotstateModel::executeEdge<(Kinds & 1) != 0, (Kinds & 2) != 0, (Kinds & 4) != 0,
+                                         (Kinds & 8) != 0, (Kinds & 16) != 0, (Kinds & 32) != 0>...}};
 }
 
-void HotstateModel::handleControlLogic() {
-    // Calculate lhs (left-hand side) based on variable selection
-    if (params.NUM_VARS > 0) {
-        if (varSel < variables.size()) {
-            lhs = (variables[varSel] != 0);
+HotstateModel::EdgeHandler HotstateModel::selectHandler(const DecodedMicrocode& mc, bool oneWord) {
+    static const std::array<EdgeHandler, EDGE_KINDS> table = makeHandlerTable(std::make_index_sequence<EDGE_KINDS>());
+    size_t kind = (mc.stateCapture ? 1 : 0) | (mc.branch ? 2 : 0) | (mc.forcedJmp ? 4 : 0) |
+                  (mc.sub ? 8 : 0) | (mc.rtn ? 16 : 0) | (oneWord ? 32 : 0);
+    return table[kind];
+}
+
+uint32_t HotstateModel::timerCount(const Parameters& params) {
+    // timerSel has one bit per timer; older parameter files only give its width
+    uint32_t numTimers = params.NUM_TIMERS > 0 ? params.NUM_TIMERS : params.TIMERSEL_WIDTH;
+    return std::min<uint32_t>(numTimers, 32);
+}
+
+// timer_mem[jadr]: TIM_MEM_WORDS words of TIM_WIDTH bits
+uint32_t HotstateModel::timerLoadValue(uint32_t jadr, const std::vector<uint32_t>& timdata,
+                                       const Parameters& params) {
+    size_t memWords = params.TIM_MEM_WORDS > 0 ? std::min<size_t>(params.TIM_MEM_WORDS, timdata.size())
+                                               : timdata.size();
+    uint32_t mask = params.TIM_WIDTH == 0 || params.TIM_WIDTH >= 32 ? UINT32_MAX : (1u << params.TIM_WIDTH) - 1;
+    return jadr < memWords ? timdata[jadr] & mask : 0;
+}
+
+TimerEdge HotstateModel::clockTimers(const DecodedMicrocode& mc, uint32_t* counts, uint32_t numTimers,
+                                     const std::vector<uint32_t>& timdata, const Parameters& params) {
+    TimerEdge edge;
+    uint32_t loadValue = timerLoadValue(mc.jadr, timdata, params);
+    for (uint32_t i = 0; i < numTimers; ++i) {
+        if (((mc.timerSel >> i) & 1) == 0) {
+            continue;
+        }
+        if ((mc.timerLd >> i) & 1) {
+            edge.reloaded |= counts[i] != loadValue;
+            counts[i] = loadValue;
+        } else if (counts[i] == 0) {
+            edge.done = true;
         } else {
-            lhs = true; // Default if varSel is out of range
+            counts[i]--;
+            edge.countdown = std::min(edge.countdown, counts[i]);
         }
-    } else {
-        lhs = true; // No variables, always true
     }
-    
-    // Calculate fired signal based on various conditions
-    fired = (lhs && branch) || forcedJmp || rtn || switchActive;
-    
-    // Calculate jmpadr signal
-    jmpadr = fired;
+    return edge;
+}
+
+uint64_t HotstateModel::settledCycles() const {
+    if (hlt || !settled) {
+        return 0;
+    }
+    if (lastEdgeReset || settledEdges == UINT32_MAX) {
+        return UINT64_MAX;
+    }
+    return 2 * static_cast<uint64_t>(settledEdges);
+}
+
+void HotstateModel::skipCycles(uint64_t count) {
+    if (hlt || !settled) {
+        return;
+    }
+    if (count % 2 != 0) {
+        throw SimulatorException("skipCycles needs an even cycle count, got " + std::to_string(count));
+    }
+    if (count > settledCycles()) {
+        throw SimulatorException("skipCycles past a timer running out: " + std::to_string(count) +
+                                 " cycles, " + std::to_string(settledCycles()) + " settled");
+    }
+    // Nothing toggles on the skipped edges
+    activityEdges += activity ? count / 2 : 0;
+    // A whole clock period ends in the same phase; a reset edge zeroes the count
+    if (!lastEdgeReset) {
+        cycleCount += count;
+        skipTimers(count / 2);
+        if (profiling) {
+            recordProfile(address, count / 2);
+        }
+    }
+}
+
+uint64_t HotstateModel::registerHash() const {
+    // xxHash64 accumulator rounds, as TraceSignature folds its values
+    uint64_t hash = 0x27D4EB2F165667C5ULL;
+    auto round = [&hash](uint64_t value) {
+        value *= 0xC2B2AE3D27D4EB4FULL;
+        value = ((value << 31) | (value >> 33)) * 0x9E3779B185EBCA87ULL;
+        hash ^= value;
+        hash = ((hash << 27) | (hash >> 37)) * 0x9E3779B185EBCA87ULL + 0x85EBCA77C2B2AE63ULL;
+    };
+    for (uint64_t word : states.getWords()) {
+        round(word);
+    }
+    round(inputBits);
+    for (uint32_t count : timerCounts) {
+        round(count);
+    }
+    round(address | static_cast<uint64_t>(fetchAddress) << 32);
+    round(returnAddress | static_cast<uint64_t>(stackPointer) << 32);
+    for (uint32_t entry : stack) {
+        round(entry);
+    }
+    for (size_t i = 0; i < std::size(SNAPSHOT_FIELDS); ++i) {
+        round(this->*SNAPSHOT_FIELDS[i]);
+    }
+    uint64_t flags = settledEdges;
+    for (size_t i = 0; i < std::size(SNAPSHOT_FLAGS); ++i) {
+        flags |= static_cast<uint64_t>(this->*SNAPSHOT_FLAGS[i]) << (32 + i);
+    }
+    round(flags);
+    return hash;
+}
+
+void HotstateModel::repeatCycles(uint64_t count) {
+    if (count % 2 != 0) {
+        throw SimulatorException("repeatCycles needs an even cycle count, got " + std::to_string(count));
+    }
+    cycleCount += count;
+}
+
+void HotstateModel::enableProfiling() {
+    profiling = true;
+    addressHits.assign(decoded.size(), 0);
+    branchTaken.assign(decoded.size(), 0);
+    branchNotTaken.assign(decoded.size(), 0);
+}
+
+void HotstateModel::addProfileCounts(const std::vector<uint64_t>& hits, const std::vector<uint64_t>& taken,
+                                     const std::vector<uint64_t>& notTaken) {
+    if (!profiling) {
+        enableProfiling();
+    }
+    if (hits.size() != decoded.size() || taken.size() != decoded.size() || notTaken.size() != decoded.size()) {
+        throw SimulatorException("Profile counts for " + std::to_string(hits.size()) + " words, not " +
+                                 std::to_string(decoded.size()));
+    }
+    for (size_t pc = 0; pc < decoded.size(); pc++) {
+        addressHits[pc] += hits[pc];
+        branchTaken[pc] += taken[pc];
+        branchNotTaken[pc] += notTaken[pc];
+    }
+}
+
+void HotstateModel::enableActivity() {
+    activity = true;
+    activityEdges = 0;
+    emptyWord.assign(params.SMDATA_WORDS > 0 ? params.SMDATA_WORDS : 1, 0);
+    activityStates.assign(states.getWords().size(), 0);
+    activityWord.assign(emptyWord.size(), 0);
+    stateActivity.assign(activityStates.size() * 64, BitActivity{});
+    wordActivity.assign(activityWord.size() * 64, BitActivity{});
+    // The registers as they are now are the baseline, not toggles
+    recordActivity(false);
+}
+
+// The counts with each bit's high time closed at the current edge
+std::vector<BitActivity> HotstateModel::getStateActivity() const {
+    std::vector<BitActivity> bits(stateActivity.begin(), stateActivity.begin() + states.size());
+    for (uint32_t i = 0; i < bits.size(); ++i) {
+        if ((activityStates[i / 64] >> (i % 64)) & 1) {
+            bits[i].highEdges += activityEdges - bits[i].since;
+        }
+        bits[i].since = activityEdges;
+    }
+    return bits;
+}
+
+std::vector<BitActivity> HotstateModel::getWordActivity() const {
+    std::vector<BitActivity> bits(wordActivity);
+    for (uint32_t i = 0; i < bits.size(); ++i) {
+        if ((activityWord[i / 64] >> (i % 64)) & 1) {
+            bits[i].highEdges += activityEdges - bits[i].since;
+        }
+        bits[i].since = activityEdges;
+    }
+    return bits;
+}
+
+uint32_t HotstateModel::subscribeStates(StateChangeCallback callback) {
+    if (stateSubscribers.empty()) {
+        reportedStates = states.getWords();
+        changedStates.assign(reportedStates.size(), 0);
+    }
+    stateSubscribers.emplace_back(nextSubscriberId, std::move(callback));
+    return nextSubscriberId++;
+}
+
+void HotstateModel::unsubscribeStates(uint32_t id) {
+    stateSubscribers.erase(std::remove_if(stateSubscribers.begin(), stateSubscribers.end(),
+                                          [id](const auto& subscriber) { return subscriber.first == id; }),
+                           stateSubscribers.end());
+}
+
+// Calls the subscribers if the register differs from what they were last
+// told; between edges that is always the register as it is
+void HotstateModel::notifyStateChange() {
+    const std::vector<uint64_t>& words = states.getWords();
+    uint64_t any = 0;
+    for (size_t w = 0; w < words.size(); ++w) {
+        changedStates[w] = words[w] ^ reportedStates[w];
+        any |= changedStates[w];
+    }
+    if (any == 0) {
+        return;
+    }
+    std::copy(words.begin(), words.end(), reportedStates.begin());
+    for (const auto& subscriber : stateSubscribers) {
+        subscriber.second(cycleCount, states, changedStates);
+    }
+}
+
+// edges rising edges executed the word at pc, all going the way the last did
+void HotstateModel::recordProfile(uint32_t pc, uint64_t edges) {
+    addressHits[pc] += edges;
+    if (decoded[pc].branch) {
+        (fired ? branchTaken : branchNotTaken)[pc] += edges;
+    }
+}
+
+// After an edge (counted) or a restore: compares the state register and
+// the microcode word now at address with the last ones recorded
+void HotstateModel::recordActivity(bool counted) {
+    activityEdges += counted;
+    const uint64_t* word = emptyWord.data();
+    if (!bubble && address < decoded.size()) {
+        word = smdata.data() + static_cast<size_t>(address) * emptyWord.size();
+    }
+    accumulateActivity(states.getWords().data(), activityStates, stateActivity, counted);
+    accumulateActivity(word, activityWord, wordActivity, counted);
+}
+
+// An unchanged word costs the compare; a changed one the bits that toggled
+void HotstateModel::accumulateActivity(const uint64_t* now, std::vector<uint64_t>& last,
+                                       std::vector<BitActivity>& bits, bool counted) {
+    for (size_t w = 0; w < last.size(); ++w) {
+        uint64_t changed = now[w] ^ last[w];
+        for (uint64_t rest = changed; rest != 0; rest &= rest - 1) {
+            uint32_t bit = static_cast<uint32_t>(__builtin_ctzll(rest));
+            BitActivity& counts = bits[w * 64 + bit];
+            if ((last[w] >> bit) & 1) {
+                counts.highEdges += activityEdges - counts.since;
+            }
+            counts.since = activityEdges;
+            counts.toggles += counted;
+        }
+        last[w] = now[w];
+    }
+}
+
+// The skipped edges all execute the word at address, so they decrement the
+// timers it selects without loading
+void HotstateModel::skipTimers(uint64_t edges) {
+    if (settledEdges == UINT32_MAX || edges == 0) {
+        return;
+    }
+    const DecodedMicrocode& mc = decoded[address];
+    for (uint32_t i = 0; i < timerCounts.size(); ++i) {
+        if (((mc.timerSel >> i) & 1) && !((mc.timerLd >> i) & 1)) {
+            timerCounts[i] -= static_cast<uint32_t>(std::min<uint64_t>(timerCounts[i], edges));
+        }
+    }
+    settledEdges -= static_cast<uint32_t>(edges);
+    settled = settledEdges != 0;
 }
 
 void HotstateModel::handleSwitch() {
@@ -244,57 +839,27 @@ uint32_t HotstateModel::calculateSwitchAddress() {
     return addr;
 }
 
-void HotstateModel::handleVariables() {
-    // Variable handling is done in handleControlLogic
-    // Additional variable operations could be added here
-}
-
-void HotstateModel::handleNextAddress() {
-    uint32_t nextAddress = address;
-    
-    if (fired) {
-        if (switchActive) {
-            nextAddress = switchAdr;
-        } else if (rtn && stackPointer > 0) {
-            stackPointer--;
-            nextAddress = stack[stackPointer];
-        } else if (jmpadr) {
-            nextAddress = jadr;
-        }
-    } else {
-        nextAddress = address + 1;
-    }
-    
-    // Handle subroutine call
-    if (sub && stackPointer < 16) {
-        stack[stackPointer] = address + 1;
-        stackPointer++;
-    }
-    
-    // Wrap around if we exceed memory size
-    if (nextAddress >= params.NUM_WORDS) {
-        nextAddress = 0;
-    }
-    
-    address = nextAddress;
-    
-    // Update ready signal (simplified)
-    ready = true;
-}
-
 void HotstateModel::setInputs(const std::vector<uint8_t>& inputs) {
+    // Only inputs that change touch the packed copy
     for (size_t i = 0; i < inputs.size() && i < variables.size(); ++i) {
+        if ((inputs[i] != 0) != (variables[i] != 0) && i < 64) {
+            inputBits ^= 1ULL << i;
+        }
         variables[i] = inputs[i];
     }
 }
 
 std::vector<uint8_t> HotstateModel::getOutputs() const {
+    std::vector<uint8_t> outputs(getNumOutputs());
+    copyOutputs(outputs.data());
+    return outputs;
+}
+
+void HotstateModel::copyOutputs(uint8_t* dest) const {
     // For now, return the current state as output
-    std::vector<uint8_t> outputs;
-    for (bool state : states) {
-        outputs.push_back(state ? 1 : 0);
+    for (uint32_t i = 0; i < states.size(); ++i) {
+        dest[i] = states[i] ? 1 : 0;
     }
-    return outputs;
 }
 
 void HotstateModel::printState() const {
@@ -331,6 +896,9 @@ void HotstateModel::printControlSignals() const {
     std::cout << "jmpadr: " << (jmpadr ? "1" : "0") << std::endl;
     std::cout << "switchActive: " << (switchActive ? "1" : "0") << std::endl;
     std::cout << "varOrTimer: " << (varOrTimer ? "1" : "0") << std::endl;
+    std::cout << "timerDone: " << (timerDone ? "1" : "0") << std::endl;
+    std::cout << "interrupt: " << (interrupt ? "1" : "0") << " (fired " << (interruptFired ? "1" : "0")
+              << ", vector 0x" << std::hex << interruptAddress << std::dec << ")" << std::endl;
     std::cout << "========================" << std::endl;
 }
 
@@ -353,10 +921,10 @@ void HotstateModel::printStack() const {
 }
 
 bool HotstateModel::validateState() const {
-    if (address >= smdata.size()) {
+    if (address >= decoded.size()) {
         return false;
     }
-    if (stackPointer > 16) {
+    if (stackPointer > stack.size()) {
         return false;
     }
     return true;
@@ -367,8 +935,8 @@ std::string HotstateModel::getStateString() const {
                         " Addr:0x" + std::to_string(address) +
                         " Ready:" + (ready ? "1" : "0") +
                         " States:";
-    for (bool state : states) {
-        result += state ? "1" : "0";
+    for (uint32_t i = 0; i < states.size(); ++i) {
+        result += states[i] ? "1" : "0";
     }
     return result;
 }
@@ -1,5 +1,16 @@
 #include "simulator.h"
+#include "batch_simulator.h"
+#include "sweep_runner.h"
 #include "utils.h"
+#include "trace_format.h"
+#include "model_generator.h"
+#include "state_explorer.h"
+#include "system_simulator.h"
+#include "autotuner.h"
+#include "regression_farm.h"
+#include "random_batch.h"
+#include "exhaustive_runner.h"
+#include "debug_script.h"
 #include <iostream>
 #include <iomanip>
 #include <getopt.h>
@@ -13,28 +24,82 @@ void printUsage(const char* programName) {
     std::cout << std::endl;
     std::cout << "Required Options:" << std::endl;
     std::cout << "  -b, --base PATH          Base path for memory files (without extension)" << std::endl;
+    std::cout << "  --from-source FILE       Compile the C program FILE in-process instead of loading -b files" << std::endl;
     std::cout << std::endl;
     std::cout << "Optional Options:" << std::endl;
     std::cout << "  -s, --stimulus FILE      Input stimulus file" << std::endl;
     std::cout << "  -o, --output FILE        Output file (for non-console formats)" << std::endl;
-    std::cout << "  -f, --format FORMAT      Output format (console|vcd|csv|json) [default: console]" << std::endl;
-    std::cout << "  -m, --max-cycles NUM     Maximum number of cycles to simulate [default: 1000]" << std::endl;
+    std::cout << "  -f, --format FORMAT      Output format (console|vcd|csv|json|trace) [default: console]" << std::endl;
+    std::cout << "  -m, --max-cycles NUM     Maximum number of cycles to simulate, with an optional k, M, G or T suffix [default: 1000]" << std::endl;
     std::cout << "  -d, --debug              Enable interactive debug mode" << std::endl;
     std::cout << "  -v, --verbose            Enable verbose output" << std::endl;
     std::cout << "  -q, --quiet              Suppress non-error output" << std::endl;
     std::cout << "  --no-realtime            Disable real-time output" << std::endl;
+    std::cout << "  --no-log                 Run without logging any cycles (for benchmarking)" << std::endl;
+    std::cout << "  --log-window NUM         Keep only the last NUM logged cycles in memory (0: all) [default: 10000]" << std::endl;
     std::cout << "  --breakpoint-state N     Add state breakpoint" << std::endl;
     std::cout << "  --breakpoint-addr ADDR   Add address breakpoint (hex)" << std::endl;
+    std::cout << "  --break-if EXPR          Break when EXPR holds, e.g. \"state[3] && input a2 == 1 && addr in [0x40,0x50)\"" << std::endl;
+    std::cout << "  --break-on-change EXPR   Break when the value of EXPR changes, e.g. LED5" << std::endl;
     std::cout << "  --step NUM               Step mode: run NUM cycles at a time" << std::endl;
-    std::cout << "  --export FILE            Export results to FILE" << std::endl;
-    std::cout << "  --export-format FORMAT   Export format (csv|json) [default: csv]" << std::endl;
+    std::cout << "  --profile FILE           Count microcode word and branch executions; write a coverage report to FILE (- for stdout), or the counts to a .json FILE" << std::endl;
+    std::cout << "  --activity FILE          Count state and microcode bit toggles; write a toggle report to FILE (- for stdout), or SAIF to a .saif FILE" << std::endl;
+    std::cout << "  --checkpoint-every NUM   Checkpoint every NUM cycles for the debugger's back/goto [default: 1000 with -d, else off]" << std::endl;
+    std::cout << "  --signature FILE         Write a rolling hash of the run's address and states to FILE" << std::endl;
+    std::cout << "  --compare-signature FILE Check the run against the signature in FILE; fail at the first divergent cycles" << std::endl;
+    std::cout << "  --signature-every NUM    Keep signature checkpoints every NUM cycles to locate divergence [default: the golden's, else off]" << std::endl;
+    std::cout << "  --export FILE            Export every logged cycle to FILE, written while the simulation runs" << std::endl;
+    std::cout << "  --export-format FORMAT   Export format (csv|json|trace) [default: csv]" << std::endl;
+    std::cout << "  --batch PATH             Run every stimulus file in directory PATH, or listed in file PATH, in lockstep" << std::endl;
+    std::cout << "  --jobs N                 Run the --batch files, --random-runs, --exhaustive, --explore or --cores on N worker threads, or open N --worker connections (0: one per CPU)" << std::endl;
+    std::cout << "  --stream-stimulus        Read the stimulus file incrementally instead of loading it whole" << std::endl;
+    std::cout << "  --random-stimulus SEED   Generate random stimulus in-process from SEED instead of -s" << std::endl;
+    std::cout << "  --random-input RULE      Constrain a random input, e.g. a2:toggle=0.01 or mode:range=0..3,hold=50..200 (* for all)" << std::endl;
+    std::cout << "  --random-runs N          Run N --random-stimulus seeds from SEED in lockstep; report coverage and failing seeds" << std::endl;
+    std::cout << "  --exhaustive K           Run every input sequence of K clock periods after reset, 64 per bit-sliced model" << std::endl;
+    std::cout << "  --fast-forward           Skip idle cycles up to the next stimulus change (not logged)" << std::endl;
+    std::cout << "  --periodic MODE          Once the run repeats itself with the inputs held: stop (when no stimulus" << std::endl;
+    std::cout << "                           change follows) or skip whole periods to the next change (not logged)" << std::endl;
+    std::cout << "  --convert-stimulus FILE  Convert the -s stimulus file to binary format in FILE, or to the" << std::endl;
+    std::cout << "                           Verilog testbench's $readmemh format for a .mem FILE, and exit" << std::endl;
+    std::cout << "  --dump-trace FILE        Print a -f trace file as CSV and exit" << std::endl;
+    std::cout << "  --dump-cycles A:B        Only print cycles A to B of --dump-trace" << std::endl;
+    std::cout << "  --emit-cpp FILE          Write the -b program as a standalone C++ model header and exit" << std::endl;
+    std::cout << "  --explore                Search every state reachable under any inputs; report unreachable words, deadlocks and stack depth" << std::endl;
+    std::cout << "  --explore-limit NUM      Stop --explore after NUM states [default: 10000000]" << std::endl;
+    std::cout << "  --cores N                Run the N cores c_parser --partition wrote as BASE_p0 .. BASE_p<N-1> together" << std::endl;
+    std::cout << "  --interrupt N            Drive the interrupt pin from input N; its rising edges enter the program's isr_ handler" << std::endl;
+    std::cout << "  --interrupt-address ADDR Interrupt vector in place of the program's INTERRUPT_ADDRESS" << std::endl;
+    std::cout << "  --autotune               Compile --from-source under many compiler settings, run each on -s, report the Pareto-optimal ones" << std::endl;
+    std::cout << "  --rom-budget NUM         Mark --autotune settings of at most NUM microcode words" << std::endl;
+    std::cout << "  --lut-budget NUM         Mark --autotune settings of at most NUM vardata LUT bytes" << std::endl;
+    std::cout << "  --latency-budget NUM     Mark --autotune settings whose inputs settle within NUM cycles" << std::endl;
+    std::cout << "  --patch FILE             Apply a c_parser --diff-against patch to the program before running" << std::endl;
+    std::cout << "  --image-cache DIR        Load programs from, and save them to, a cache in DIR shared with other processes" << std::endl;
+    std::cout << "  --coordinator PORT       Hand the --batch runs to --worker processes connecting on PORT; merge their results" << std::endl;
+    std::cout << "  --worker HOST:PORT       Run stimulus from the coordinator at HOST:PORT on --jobs connections" << std::endl;
+    std::cout << "  --plant LIB              Drive the inputs from the plant model in shared object LIB, closing the loop on the states" << std::endl;
+    std::cout << "  --plant-args TEXT        Arguments for the --plant model" << std::endl;
+    std::cout << "  --script FILE            Run the debugger commands in FILE (run-to, break-if, dump, expect, ...) instead of the console" << std::endl;
+    std::cout << "  --soak SECONDS           Long run: report throughput and coverage every SECONDS instead of printing cycles" << std::endl;
+    std::cout << "  --stats                  Report load, initialize and run times, cycles/s and peak RSS; the make stats" << std::endl;
+    std::cout << "                           build also splits the run between model, stimulus, breakpoints and logging" << std::endl;
     std::cout << "  -h, --help               Show this help message" << std::endl;
     std::cout << std::endl;
     std::cout << "Examples:" << std::endl;
     std::cout << "  " << programName << " -b test_hybrid_varsel -s stimulus.txt" << std::endl;
     std::cout << "  " << programName << " -b test_hybrid_varsel -f vcd -o trace.vcd" << std::endl;
     std::cout << "  " << programName << " -b test_hybrid_varsel -d" << std::endl;
+    std::cout << "  " << programName << " --from-source test_hybrid_varsel.c -s stimulus.txt" << std::endl;
     std::cout << "  " << programName << " -b test_hybrid_varsel -m 10000 --export results.csv" << std::endl;
+    std::cout << "  " << programName << " -b test_hybrid_varsel --batch stimuli.txt -f csv -o trace.csv" << std::endl;
+    std::cout << "  " << programName << " -b test_hybrid_varsel --batch vectors/ --jobs 8 -f csv" << std::endl;
+    std::cout << "  " << programName << " -s stimulus.txt --convert-stimulus stimulus.bin" << std::endl;
+    std::cout << "  " << programName << " --dump-trace trace.hst --dump-cycles 1000:1100" << std::endl;
+    std::cout << "  " << programName << " -b test_hybrid_varsel --emit-cpp test_hybrid_varsel_model.h" << std::endl;
+    std::cout << "  " << programName << " --from-source test_hybrid_varsel.c --explore --jobs 8" << std::endl;
+    std::cout << "  " << programName << " -b test_hybrid_varsel --cores 3 -s stimulus.txt" << std::endl;
+    std::cout << "  " << programName << " --from-source test_hybrid_varsel.c -s stimulus.txt --autotune --rom-budget 64" << std::endl;
 }
 
 OutputFormat parseOutputFormat(const std::string& format) {
@@ -42,12 +107,22 @@ OutputFormat parseOutputFormat(const std::string& format) {
     if (format == "vcd") return OutputFormat::VCD;
     if (format == "csv") return OutputFormat::CSV;
     if (format == "json") return OutputFormat::JSON;
+    if (format == "trace") return OutputFormat::TRACE;
     
     throw SimulatorException("Invalid output format: " + format);
 }
 
+uint32_t parseBudget(const std::string& text) {
+    try {
+        return static_cast<uint32_t>(std::stoul(text));
+    } catch (const std::exception& e) {
+        throw SimulatorException("Invalid budget: " + text);
+    }
+}
+
 SimulatorConfig parseCommandLine(int argc, char* argv[]) {
     SimulatorConfig config;
+    bool checkpointIntervalSet = false;
     
     static struct option long_options[] = {
         {"base", required_argument, 0, 'b'},
@@ -64,6 +139,48 @@ SimulatorConfig parseCommandLine(int argc, char* argv[]) {
         {"step", required_argument, 0, 1004},
         {"export", required_argument, 0, 1005},
         {"export-format", required_argument, 0, 1006},
+        {"batch", required_argument, 0, 1007},
+        {"jobs", required_argument, 0, 1008},
+        {"stream-stimulus", no_argument, 0, 1009},
+        {"convert-stimulus", required_argument, 0, 1010},
+        {"dump-trace", required_argument, 0, 1011},
+        {"dump-cycles", required_argument, 0, 1012},
+        {"fast-forward", no_argument, 0, 1013},
+        {"emit-cpp", required_argument, 0, 1014},
+        {"no-log", no_argument, 0, 1015},
+        {"from-source", required_argument, 0, 1016},
+        {"break-if", required_argument, 0, 1017},
+        {"break-on-change", required_argument, 0, 1018},
+        {"checkpoint-every", required_argument, 0, 1019},
+        {"profile", required_argument, 0, 1020},
+        {"signature", required_argument, 0, 1021},
+        {"compare-signature", required_argument, 0, 1022},
+        {"signature-every", required_argument, 0, 1023},
+        {"random-stimulus", required_argument, 0, 1024},
+        {"random-input", required_argument, 0, 1025},
+        {"explore", no_argument, 0, 1026},
+        {"explore-limit", required_argument, 0, 1027},
+        {"cores", required_argument, 0, 1028},
+        {"interrupt", required_argument, 0, 1029},
+        {"interrupt-address", required_argument, 0, 1030},
+        {"log-window", required_argument, 0, 1031},
+        {"autotune", no_argument, 0, 1032},
+        {"rom-budget", required_argument, 0, 1033},
+        {"lut-budget", required_argument, 0, 1034},
+        {"latency-budget", required_argument, 0, 1035},
+        {"patch", required_argument, 0, 1036},
+        {"image-cache", required_argument, 0, 1037},
+        {"coordinator", required_argument, 0, 1038},
+        {"worker", required_argument, 0, 1039},
+        {"random-runs", required_argument, 0, 1040},
+        {"exhaustive", required_argument, 0, 1041},
+        {"plant", required_argument, 0, 1042},
+        {"plant-args", required_argument, 0, 1043},
+        {"soak", required_argument, 0, 1044},
+        {"script", required_argument, 0, 1045},
+        {"stats", no_argument, 0, 1046},
+        {"activity", required_argument, 0, 1047},
+        {"periodic", required_argument, 0, 1048},
         {"help", no_argument, 0, 'h'},
         {0, 0, 0, 0}
     };
@@ -94,11 +211,7 @@ SimulatorConfig parseCommandLine(int argc, char* argv[]) {
                 break;
                 
             case 'm':
-                try {
-                    config.maxCycles = static_cast<uint32_t>(std::stoul(optarg));
-                } catch (const std::exception& e) {
-                    throw SimulatorException("Invalid max-cycles value: " + std::string(optarg));
-                }
+                config.maxCycles = parseCycleCount(optarg);
                 break;
                 
             case 'd':
@@ -139,6 +252,97 @@ SimulatorConfig parseCommandLine(int argc, char* argv[]) {
                 }
                 break;
                 
+            case 1017: // --break-if
+                config.breakpointConditions.push_back(optarg);
+                config.enableBreakpoints = true;
+                break;
+                
+            case 1018: // --break-on-change
+                config.breakpointWatches.push_back(optarg);
+                config.enableBreakpoints = true;
+                break;
+                
+            case 1019: // --checkpoint-every
+                try {
+                    config.checkpointInterval = static_cast<uint32_t>(std::stoul(optarg));
+                    checkpointIntervalSet = true;
+                } catch (const std::exception& e) {
+                    throw SimulatorException("Invalid checkpoint interval: " + std::string(optarg));
+                }
+                break;
+                
+            case 1020: // --profile
+                config.profileFile = optarg;
+                break;
+                
+            case 1021: // --signature
+                config.signatureFile = optarg;
+                break;
+                
+            case 1022: // --compare-signature
+                config.goldenSignatureFile = optarg;
+                break;
+                
+            case 1024: // --random-stimulus
+                try {
+                    config.randomSeed = std::stoull(optarg, nullptr, 0);
+                    config.randomStimulus = true;
+                } catch (const std::exception& e) {
+                    throw SimulatorException("Invalid random seed: " + std::string(optarg));
+                }
+                break;
+                
+            case 1025: // --random-input
+                config.randomInputRules.push_back(optarg);
+                break;
+                
+            case 1026: // --explore
+                config.explore = true;
+                break;
+                
+            case 1027: // --explore-limit
+                try {
+                    config.exploreLimit = std::stoull(optarg);
+                } catch (const std::exception& e) {
+                    throw SimulatorException("Invalid state limit: " + std::string(optarg));
+                }
+                break;
+                
+            case 1028: // --cores
+                try {
+                    config.cores = static_cast<uint32_t>(std::stoul(optarg));
+                } catch (const std::exception& e) {
+                    throw SimulatorException("Invalid core count: " + std::string(optarg));
+                }
+                if (config.cores == 0) {
+                    throw SimulatorException("--cores needs at least one core.");
+                }
+                break;
+                
+            case 1029: // --interrupt
+                try {
+                    config.interruptInput = static_cast<uint32_t>(std::stoul(optarg));
+                } catch (const std::exception& e) {
+                    throw SimulatorException("Invalid interrupt input: " + std::string(optarg));
+                }
+                break;
+                
+            case 1030: // --interrupt-address
+                try {
+                    config.interruptAddress = static_cast<uint32_t>(std::stoul(optarg, nullptr, 0));
+                } catch (const std::exception& e) {
+                    throw SimulatorException("Invalid interrupt address: " + std::string(optarg));
+                }
+                break;
+                
+            case 1023: // --signature-every
+                try {
+                    config.signatureInterval = static_cast<uint32_t>(std::stoul(optarg));
+                } catch (const std::exception& e) {
+                    throw SimulatorException("Invalid signature interval: " + std::string(optarg));
+                }
+                break;
+                
             case 1004: // --step
                 try {
                     config.cycleStep = static_cast<uint32_t>(std::stoul(optarg));
@@ -148,11 +352,186 @@ SimulatorConfig parseCommandLine(int argc, char* argv[]) {
                 break;
                 
             case 1005: // --export
-                // Store for later use after simulation
+                config.exportFile = optarg;
                 break;
                 
             case 1006: // --export-format
-                // Store for later use after simulation
+                try {
+                    config.exportFormat = parseOutputFormat(optarg);
+                } catch (const SimulatorException& e) {
+                    std::cerr << "Warning: Invalid export format, using CSV" << std::endl;
+                }
+                break;
+                
+            case 1007: // --batch
+                config.batchListFile = optarg;
+                break;
+                
+            case 1008: // --jobs
+                try {
+                    config.jobs = static_cast<uint32_t>(std::stoul(optarg));
+                    config.threadedBatch = true;
+                } catch (const std::exception& e) {
+                    throw SimulatorException("Invalid jobs value: " + std::string(optarg));
+                }
+                break;
+                
+            case 1009: // --stream-stimulus
+                config.streamStimulus = true;
+                break;
+                
+            case 1010: // --convert-stimulus
+                config.convertStimulusFile = optarg;
+                break;
+                
+            case 1011: // --dump-trace
+                config.dumpTraceFile = optarg;
+                break;
+                
+            case 1012: { // --dump-cycles
+                std::string range = optarg;
+                size_t colon = range.find(':');
+                try {
+                    if (colon == std::string::npos) {
+                        config.dumpFirstCycle = config.dumpLastCycle = std::stoull(range);
+                    } else {
+                        if (colon > 0) config.dumpFirstCycle = std::stoull(range.substr(0, colon));
+                        if (colon + 1 < range.size()) config.dumpLastCycle = std::stoull(range.substr(colon + 1));
+                    }
+                } catch (const std::exception& e) {
+                    throw SimulatorException("Invalid cycle range: " + range);
+                }
+                break;
+            }
+                
+            case 1013: // --fast-forward
+                config.fastForward = true;
+                break;
+                
+            case 1014: // --emit-cpp
+                config.emitCppFile = optarg;
+                break;
+                
+            case 1015: // --no-log
+                config.logging = false;
+                break;
+                
+            case 1031: // --log-window
+                try {
+                    config.logWindow = static_cast<uint32_t>(std::stoul(optarg));
+                } catch (const std::exception& e) {
+                    throw SimulatorException("Invalid log window: " + std::string(optarg));
+                }
+                break;
+                
+            case 1016: // --from-source
+                config.sourceFile = optarg;
+                break;
+                
+            case 1032: // --autotune
+                config.autotune = true;
+                break;
+                
+            case 1033: // --rom-budget
+                config.romBudget = parseBudget(optarg);
+                break;
+                
+            case 1034: // --lut-budget
+                config.lutBudget = parseBudget(optarg);
+                break;
+                
+            case 1035: // --latency-budget
+                config.latencyBudget = parseBudget(optarg);
+                break;
+                
+            case 1036: // --patch
+                config.patchFile = optarg;
+                break;
+                
+            case 1037: // --image-cache
+                config.imageCacheDir = optarg;
+                break;
+                
+            case 1038: { // --coordinator
+                uint32_t port = 0;
+                try {
+                    port = static_cast<uint32_t>(std::stoul(optarg));
+                } catch (const std::exception&) {
+                }
+                if (port == 0 || port > 65535) {
+                    throw SimulatorException("Invalid coordinator port: " + std::string(optarg));
+                }
+                config.coordinatorPort = port;
+                break;
+            }
+                
+            case 1039: // --worker
+                config.workerAddress = optarg;
+                break;
+                
+            case 1040: // --random-runs
+                try {
+                    unsigned long runs = std::stoul(optarg);
+                    if (runs == 0 || runs > UINT32_MAX) {
+                        throw SimulatorException("out of range");
+                    }
+                    config.randomRuns = static_cast<uint32_t>(runs);
+                } catch (const std::exception& e) {
+                    throw SimulatorException("Invalid random run count: " + std::string(optarg));
+                }
+                break;
+                
+            case 1041: // --exhaustive
+                try {
+                    unsigned long periods = std::stoul(optarg);
+                    if (periods == 0 || periods > ExhaustiveRunner::MAX_SEQUENCE_BITS) {
+                        throw SimulatorException("out of range");
+                    }
+                    config.exhaustivePeriods = static_cast<uint32_t>(periods);
+                } catch (const std::exception& e) {
+                    throw SimulatorException("Invalid exhaustive period count: " + std::string(optarg));
+                }
+                break;
+                
+            case 1042: // --plant
+                config.plantLibrary = optarg;
+                break;
+                
+            case 1043: // --plant-args
+                config.plantArgs = optarg;
+                break;
+                
+            case 1044: // --soak
+                try {
+                    config.soakInterval = static_cast<uint32_t>(std::stoul(optarg));
+                } catch (const std::exception& e) {
+                    throw SimulatorException("Invalid soak interval: " + std::string(optarg));
+                }
+                if (config.soakInterval == 0) {
+                    throw SimulatorException("--soak needs a report interval of at least one second.");
+                }
+                break;
+                
+            case 1045: // --script
+                config.scriptFile = optarg;
+                break;
+                
+            case 1046: // --stats
+                config.stats = true;
+                break;
+                
+            case 1047: // --activity
+                config.activityFile = optarg;
+                break;
+                
+            case 1048: // --periodic
+                if (std::string(optarg) == "stop") {
+                    config.periodic = PeriodicMode::STOP;
+                } else if (std::string(optarg) == "skip") {
+                    config.periodic = PeriodicMode::SKIP;
+                } else {
+                    throw SimulatorException("Invalid --periodic mode: " + std::string(optarg) + " (stop or skip)");
+                }
                 break;
                 
             case 'h':
@@ -167,9 +546,192 @@ SimulatorConfig parseCommandLine(int argc, char* argv[]) {
         }
     }
     
+    if (config.debugMode && !checkpointIntervalSet) {
+        config.checkpointInterval = 1000;
+    }
+    
     // Check required options
+    if (!config.dumpTraceFile.empty()) {
+        return config;
+    }
+    if (!config.convertStimulusFile.empty()) {
+        if (config.stimulusFile.empty()) {
+            throw SimulatorException("--convert-stimulus needs a stimulus file from -s.");
+        }
+        return config;
+    }
+    if (config.basePath.empty() && !config.sourceFile.empty()) {
+        // Names derived from the base path (model class, reports) follow the source
+        config.basePath = getBaseFilename(config.sourceFile);
+    }
     if (config.basePath.empty()) {
-        throw SimulatorException("Base path is required. Use --help for usage information.");
+        throw SimulatorException("Base path or --from-source is required. Use --help for usage information.");
+    }
+    if (config.interruptAddress != SimulatorConfig::NO_INTERRUPT &&
+        config.interruptInput == SimulatorConfig::NO_INTERRUPT) {
+        throw SimulatorException("--interrupt-address needs the interrupt input from --interrupt.");
+    }
+    if (config.interruptInput != SimulatorConfig::NO_INTERRUPT &&
+        (config.explore || config.cores > 0 || !config.batchListFile.empty() || !config.workerAddress.empty() ||
+         config.randomRuns > 0 || config.exhaustivePeriods > 0)) {
+        throw SimulatorException("--interrupt drives a single run; it does not apply to --explore, --cores, --batch, --worker, --random-runs or --exhaustive.");
+    }
+    if (!config.plantArgs.empty() && config.plantLibrary.empty()) {
+        throw SimulatorException("--plant-args needs a plant from --plant.");
+    }
+    if (!config.plantLibrary.empty()) {
+        if (!config.emitCppFile.empty() || config.explore || config.autotune || config.cores > 0 ||
+            !config.batchListFile.empty() || config.coordinatorPort > 0 || !config.workerAddress.empty() ||
+            config.randomRuns > 0 || config.exhaustivePeriods > 0) {
+            throw SimulatorException("--plant closes the loop of a single run; it does not apply to --emit-cpp, --explore, --autotune, --cores, --batch, --coordinator, --worker, --random-runs or --exhaustive.");
+        }
+        if (!config.stimulusFile.empty() || config.randomStimulus) {
+            throw SimulatorException("--plant drives the inputs itself; it takes no -s or --random-stimulus.");
+        }
+    }
+    if (config.maxCycles > UINT32_MAX &&
+        (config.autotune || config.cores > 0 || !config.batchListFile.empty() || config.randomRuns > 0)) {
+        throw SimulatorException("-m is limited to " + std::to_string(UINT32_MAX) +
+                                 " cycles for --autotune, --cores, --batch and --random-runs.");
+    }
+    if (config.soakInterval > 0) {
+        if (!config.emitCppFile.empty() || config.explore || config.autotune || config.cores > 0 ||
+            !config.batchListFile.empty() || config.coordinatorPort > 0 || !config.workerAddress.empty() ||
+            config.randomRuns > 0 || config.exhaustivePeriods > 0) {
+            throw SimulatorException("--soak reports on a single run; it does not apply to --emit-cpp, --explore, --autotune, --cores, --batch, --coordinator, --worker, --random-runs or --exhaustive.");
+        }
+        if (config.debugMode || config.cycleStep > 1 || checkpointIntervalSet) {
+            throw SimulatorException("--soak runs unattended; it does not apply to -d, --step or --checkpoint-every.");
+        }
+        if (config.logging && config.logWindow == 0) {
+            throw SimulatorException("--soak would keep every cycle in memory with --log-window 0; give a window or --no-log.");
+        }
+        if (config.outputFormat == OutputFormat::CONSOLE) {
+            // The reports replace the per-cycle lines
+            config.realTimeOutput = false;
+        }
+    }
+    if (config.stats &&
+        (!config.emitCppFile.empty() || config.explore || config.autotune || config.cores > 0 ||
+         !config.batchListFile.empty() || config.coordinatorPort > 0 || !config.workerAddress.empty() ||
+         config.randomRuns > 0 || config.exhaustivePeriods > 0)) {
+        throw SimulatorException("--stats measures a single run; it does not apply to --emit-cpp, --explore, --autotune, --cores, --batch, --coordinator, --worker, --random-runs or --exhaustive.");
+    }
+    if (!config.activityFile.empty() &&
+        (!config.emitCppFile.empty() || config.explore || config.autotune || config.cores > 0 ||
+         !config.batchListFile.empty() || config.coordinatorPort > 0 || !config.workerAddress.empty() ||
+         config.randomRuns > 0 || config.exhaustivePeriods > 0)) {
+        throw SimulatorException("--activity counts the toggles of a single run; it does not apply to --emit-cpp, --explore, --autotune, --cores, --batch, --coordinator, --worker, --random-runs or --exhaustive.");
+    }
+    if (config.periodic != PeriodicMode::OFF) {
+        if (!config.emitCppFile.empty() || config.explore || config.autotune || config.cores > 0 ||
+            !config.batchListFile.empty() || config.coordinatorPort > 0 || !config.workerAddress.empty() ||
+            config.randomRuns > 0 || config.exhaustivePeriods > 0) {
+            throw SimulatorException("--periodic shortens a single run; it does not apply to --emit-cpp, --explore, --autotune, --cores, --batch, --coordinator, --worker, --random-runs or --exhaustive.");
+        }
+        if (!config.plantLibrary.empty()) {
+            throw SimulatorException("--periodic needs inputs held by the stimulus; it does not apply to --plant.");
+        }
+        if (!config.signatureFile.empty() || !config.goldenSignatureFile.empty()) {
+            throw SimulatorException("--periodic leaves cycles out of the trace; it does not apply to --signature or --compare-signature.");
+        }
+        if (config.periodic == PeriodicMode::SKIP && (!config.profileFile.empty() || !config.activityFile.empty())) {
+            throw SimulatorException("--periodic skip does not count the cycles it skips; it does not apply to --profile or --activity.");
+        }
+    }
+    if (!config.scriptFile.empty()) {
+        if (!config.emitCppFile.empty() || config.explore || config.autotune || config.cores > 0 ||
+            !config.batchListFile.empty() || config.coordinatorPort > 0 || !config.workerAddress.empty() ||
+            config.randomRuns > 0 || config.exhaustivePeriods > 0) {
+            throw SimulatorException("--script drives a single run; it does not apply to --emit-cpp, --explore, --autotune, --cores, --batch, --coordinator, --worker, --random-runs or --exhaustive.");
+        }
+        if (config.debugMode || config.cycleStep > 1 || config.soakInterval > 0) {
+            throw SimulatorException("--script replaces the console; it does not apply to -d, --step or --soak.");
+        }
+        if (config.outputFormat == OutputFormat::CONSOLE) {
+            // Stops print what the script asks for instead of every cycle
+            config.realTimeOutput = false;
+        }
+    }
+    if (!config.patchFile.empty() &&
+        (!config.emitCppFile.empty() || config.explore || config.autotune || config.cores > 0 ||
+         !config.batchListFile.empty() || config.randomRuns > 0 || config.exhaustivePeriods > 0)) {
+        throw SimulatorException("--patch applies to a single run; it does not apply to --emit-cpp, --explore, --autotune, --cores, --batch, --random-runs or --exhaustive.");
+    }
+    if (!config.emitCppFile.empty()) {
+        return config;
+    }
+    if (config.explore) {
+        return config;
+    }
+    if (config.autotune) {
+        if (config.sourceFile.empty()) {
+            throw SimulatorException("--autotune compiles the program itself; it needs --from-source.");
+        }
+        if (config.stimulusFile.empty()) {
+            throw SimulatorException("--autotune needs a stimulus file from -s.");
+        }
+        return config;
+    }
+    if (config.cores > 0) {
+        if (!config.sourceFile.empty()) {
+            throw SimulatorException("--cores loads the -b BASE_p<i> files c_parser --partition wrote; it cannot use --from-source.");
+        }
+        return config;
+    }
+    if (config.coordinatorPort > 0 && !config.workerAddress.empty()) {
+        throw SimulatorException("--coordinator and --worker are the two ends of a farm; give one or the other.");
+    }
+    if (config.coordinatorPort > 0) {
+        if (config.batchListFile.empty()) {
+            throw SimulatorException("--coordinator needs a stimulus set from --batch.");
+        }
+        if (config.threadedBatch) {
+            throw SimulatorException("--coordinator runs nothing itself; give --jobs to the workers.");
+        }
+        return config;
+    }
+    if (!config.workerAddress.empty()) {
+        if (!config.batchListFile.empty() || !config.stimulusFile.empty() || config.randomStimulus) {
+            throw SimulatorException("--worker runs the coordinator's stimulus; it takes no -s, --random-stimulus or --batch.");
+        }
+        return config;
+    }
+    if (config.exhaustivePeriods > 0) {
+        if (!config.stimulusFile.empty() || config.randomStimulus || !config.batchListFile.empty() ||
+            config.debugMode) {
+            throw SimulatorException("--exhaustive generates every input sequence itself; it takes no -s, --random-stimulus, --batch or -d.");
+        }
+        if (!config.breakpointConditions.empty() || !config.breakpointWatches.empty()) {
+            throw SimulatorException("--exhaustive stops sequences at --breakpoint-state and --breakpoint-addr only; --break-if and --break-on-change need a single run.");
+        }
+        if (config.outputFormat != OutputFormat::CONSOLE || !config.exportFile.empty()) {
+            throw SimulatorException("--exhaustive writes no traces; it does not apply to -f or --export.");
+        }
+        return config;
+    }
+    if (config.threadedBatch && config.batchListFile.empty() && config.randomRuns == 0) {
+        throw SimulatorException("--jobs needs a stimulus set from --batch, --random-runs, --exhaustive or --explore.");
+    }
+    if (config.randomStimulus && !config.stimulusFile.empty()) {
+        throw SimulatorException("--random-stimulus replaces the -s stimulus file; give one or the other.");
+    }
+    if (!config.randomInputRules.empty() && !config.randomStimulus) {
+        throw SimulatorException("--random-input needs --random-stimulus.");
+    }
+    if (config.randomRuns > 0) {
+        if (!config.randomStimulus) {
+            throw SimulatorException("--random-runs needs the first seed from --random-stimulus.");
+        }
+        if (!config.batchListFile.empty() || config.debugMode) {
+            throw SimulatorException("--random-runs generates its own stimulus set; it does not apply to --batch or -d.");
+        }
+        if (!config.breakpointConditions.empty() || !config.breakpointWatches.empty()) {
+            throw SimulatorException("--random-runs stops runs at --breakpoint-state and --breakpoint-addr only; --break-if and --break-on-change need a single run.");
+        }
+        if (config.outputFormat != OutputFormat::CONSOLE || !config.exportFile.empty()) {
+            throw SimulatorException("--random-runs writes no traces; it does not apply to -f or --export.");
+        }
     }
     
     return config;
@@ -194,9 +756,13 @@ int runInteractiveMode(Simulator& simulator) {
             std::cout << "Simulation Control:" << std::endl;
             std::cout << "  run              - Run simulation until breakpoint or end" << std::endl;
             std::cout << "  step [N]         - Step N cycles (default: 1)" << std::endl;
+            std::cout << "  back [N]         - Step back N cycles (default: 1)" << std::endl;
+            std::cout << "  goto N           - Go back to cycle N" << std::endl;
             std::cout << "  continue         - Continue from breakpoint" << std::endl;
             std::cout << "  pause            - Pause simulation" << std::endl;
             std::cout << "  reset            - Reset simulation" << std::endl;
+            std::cout << "  load BASE        - Swap in the program BASE and reset, keeping the stimulus and log" << std::endl;
+            std::cout << "  patch FILE       - Apply a c_parser --diff-against patch to the program and reset" << std::endl;
             std::cout << "  quit             - Exit simulator" << std::endl;
             std::cout << "  exit             - Exit simulator (alias for quit)" << std::endl;
             std::cout << std::endl;
@@ -213,6 +779,8 @@ int runInteractiveMode(Simulator& simulator) {
             std::cout << "Breakpoint Commands:" << std::endl;
             std::cout << "  bp state N       - Add state breakpoint" << std::endl;
             std::cout << "  bp addr HEX      - Add address breakpoint" << std::endl;
+            std::cout << "  bp if EXPR       - Break when EXPR holds (see --break-if)" << std::endl;
+            std::cout << "  bp change EXPR   - Break when the value of EXPR changes" << std::endl;
             std::cout << "  bp clear         - Clear all breakpoints" << std::endl;
             std::cout << "  bp list          - List breakpoints" << std::endl;
             std::cout << std::endl;
@@ -241,6 +809,16 @@ int runInteractiveMode(Simulator& simulator) {
                 if (!simulator.debugStep()) break;
             }
 
+        } else if (command == "back" || command == "goto") {
+            uint32_t cycles = 1;
+            iss >> cycles;
+            bool restored = command == "back" ? simulator.stepBack(cycles) : simulator.restoreToCycle(cycles);
+            if (restored) {
+                std::cout << "At cycle " << simulator.getCurrentCycle() << std::endl;
+            } else {
+                std::cout << "Error: " << simulator.getLastError() << std::endl;
+            }
+
         } else if (command == "continue") {
             simulator.debugContinue();
             simulator.run();
@@ -251,6 +829,14 @@ int runInteractiveMode(Simulator& simulator) {
         } else if (command == "reset") {
             simulator.reset();
 
+        } else if (command == "load" || command == "patch") {
+            std::string path;
+            iss >> path;
+            bool swapped = command == "load" ? simulator.swapProgram(path) : simulator.applyPatch(path);
+            if (!swapped) {
+                std::cout << "Error: " << simulator.getLastError() << std::endl;
+            }
+
         } else if (command == "state") {
             simulator.inspectState();
 
@@ -359,6 +945,21 @@ int runInteractiveMode(Simulator& simulator) {
                     std::cout << "Error: " << e.what() << std::endl;
                 }
                 
+            } else if (type == "if" || type == "change") {
+                std::string expression;
+                std::getline(iss, expression);
+                expression.erase(0, expression.find_first_not_of(" \t"));
+                try {
+                    if (type == "if") {
+                        simulator.addConditionBreakpoint(expression);
+                    } else {
+                        simulator.addWatchBreakpoint(expression);
+                    }
+                    std::cout << "Added " << (type == "if" ? "condition" : "watch") << " breakpoint: " << expression << std::endl;
+                } catch (const SimulatorException& e) {
+                    std::cout << "Error: " << e.what() << std::endl;
+                }
+                
             } else if (type == "clear") {
                 simulator.clearBreakpoints();
                 std::cout << "Cleared all breakpoints" << std::endl;
@@ -367,7 +968,7 @@ int runInteractiveMode(Simulator& simulator) {
                 simulator.listBreakpoints();
                 
             } else {
-                std::cout << "Unknown breakpoint command. Use 'bp state', 'bp addr', 'bp clear', or 'bp list'" << std::endl;
+                std::cout << "Unknown breakpoint command. Use 'bp state', 'bp addr', 'bp if', 'bp change', 'bp clear', or 'bp list'" << std::endl;
             }
             
         } else if (command == "quit" || command == "exit") {
@@ -381,6 +982,274 @@ int runInteractiveMode(Simulator& simulator) {
     return 0;
 }
 
+int runConvertStimulus(const SimulatorConfig& config) {
+    try {
+        // A named stimulus file needs the program for its input names
+        MemoryLoader memory;
+        StimulusParser stimulus;
+        if (!config.basePath.empty() || !config.sourceFile.empty()) {
+            if (!memory.loadProgram(config.basePath, config.sourceFile)) {
+                std::cerr << "Error: Failed to load the program for its input names" << std::endl;
+                return 1;
+            }
+            stimulus.setInputSymbols(&memory.getInputSymbols());
+        }
+        stimulus.loadStimulus(config.stimulusFile);
+        if (StimulusParser::isReadmemhStimulus(config.convertStimulusFile)) {
+            // The testbench reads words of the program's width
+            uint32_t inputCount = memory.isLoaded() ? memory.getParams().NUM_VARS : stimulus.getNumInputs();
+            stimulus.saveReadmemhStimulus(config.convertStimulusFile, inputCount);
+            std::cout << "Wrote " << stimulus.size() << " testbench stimulus entries to "
+                      << config.convertStimulusFile << std::endl;
+        } else {
+            stimulus.saveBinaryStimulus(config.convertStimulusFile);
+            std::cout << "Wrote " << stimulus.size() << " binary stimulus entries to "
+                      << config.convertStimulusFile << std::endl;
+        }
+    } catch (const SimulatorException& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+int runDumpTrace(const SimulatorConfig& config) {
+    try {
+        TraceReader reader(config.dumpTraceFile);
+        reader.dump(std::cout, config.dumpFirstCycle, config.dumpLastCycle);
+    } catch (const SimulatorException& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+int runEmitCpp(const SimulatorConfig& config) {
+    MemoryLoader memory;
+    if (!memory.loadProgram(config.basePath, config.sourceFile)) {
+        std::cerr << "Error: Failed to load memory files from base path: " << config.basePath << std::endl;
+        return 1;
+    }
+    try {
+        std::string className = ModelGenerator::classNameFor(config.emitCppFile);
+        ModelGenerator generator(memory, className);
+        generator.generateFile(config.emitCppFile);
+        std::cout << "Wrote " << className << " (" << memory.getSmdataSize() << " microcode words) to "
+                  << config.emitCppFile << std::endl;
+    } catch (const SimulatorException& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+int runExplore(const SimulatorConfig& config) {
+    MemoryLoader memory;
+    if (!memory.loadProgram(config.basePath, config.sourceFile)) {
+        std::cerr << "Error: Failed to load memory files from base path: " << config.basePath << std::endl;
+        return 1;
+    }
+    try {
+        StateExplorer explorer(memory, config.jobs, config.exploreLimit);
+        explorer.run();
+        explorer.writeReport(std::cout);
+        return explorer.isComplete() ? 0 : 1;
+    } catch (const SimulatorException& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+}
+
+int runAutotune(const SimulatorConfig& config) {
+    try {
+        Autotuner tuner(config);
+        if (!tuner.run()) {
+            std::cerr << "Error: " << tuner.getLastError() << std::endl;
+            return 1;
+        }
+        tuner.writeReport(std::cout);
+        return 0;
+    } catch (const SimulatorException& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+}
+
+// --cores: the partitioned cores under one clock on the -s inputs,
+// printing the output bus on every cycle that changes it
+int runCores(const SimulatorConfig& config) {
+    try {
+        SystemSimulator system(config.basePath, config.cores, config.jobs);
+        StimulusParser stimulus;
+        stimulus.setInputSymbols(&system.getMemory(0).getInputSymbols());
+        if (!config.stimulusFile.empty() && !stimulus.loadStimulus(config.stimulusFile)) {
+            std::cerr << "Error: Failed to load stimulus file: " << config.stimulusFile << std::endl;
+            return 1;
+        }
+        
+        const MemoryLoader& symbols = system.getMemory(0);
+        uint32_t numStates = system.getNumOutputs();
+        std::cout << "System: " << system.size() << " cores; state owners:";
+        for (uint32_t s = 0; s < numStates; ++s) {
+            const std::string& name = symbols.getStateNameByIndex(s);
+            std::cout << " " << (name.empty() ? "state" + std::to_string(s) : name) << "->p" << system.getOwner(s);
+        }
+        std::cout << std::endl;
+        
+        StateBits last;
+        system.run(stimulus, config.maxCycles,
+                   [&](uint32_t cycle, const StateBits& outputs, const std::vector<uint32_t>& addresses) {
+            if (!config.verbose && cycle != 0 && outputs == last) {
+                return;
+            }
+            last = outputs;
+            std::cout << "Cycle " << std::setw(6) << cycle << ":";
+            for (size_t i = 0; i < addresses.size(); ++i) {
+                std::cout << " p" << i << "@0x" << std::hex << std::setw(2) << std::setfill('0')
+                          << addresses[i] << std::dec << std::setfill(' ');
+            }
+            std::cout << "  states ";
+            for (uint32_t s = numStates; s-- > 0;) {
+                std::cout << (outputs[s] ? '1' : '0');
+            }
+            std::cout << std::endl;
+        });
+        std::cout << "Ran " << config.maxCycles << " cycles on " << system.size() << " cores ("
+                  << system.getSkippedCycles() << " core cycles skipped while settled)" << std::endl;
+        return 0;
+    } catch (const SimulatorException& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+}
+
+int runCoordinator(const SimulatorConfig& config) {
+    std::vector<std::string> files;
+    try {
+        files = BatchSimulator::readStimulusList(config.batchListFile);
+    } catch (const SimulatorException& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    
+    FarmCoordinator coordinator(config, files);
+    if (!coordinator.initialize() || !coordinator.run()) {
+        if (!coordinator.getLastError().empty()) {
+            std::cerr << "Farm failed: " << coordinator.getLastError() << std::endl;
+            return 1;
+        }
+    }
+    coordinator.printSummary();
+    
+    int status = 0;
+    if (!config.signatureFile.empty()) {
+        if (coordinator.writeSignatures(config.signatureFile)) {
+            std::cout << "Signatures written to " << config.signatureFile << std::endl;
+        } else {
+            std::cerr << "Failed to write signatures to " << config.signatureFile << std::endl;
+            status = 1;
+        }
+    }
+    if (!config.profileFile.empty()) {
+        if (!coordinator.writeProfile(config.profileFile)) {
+            std::cerr << "Failed to write profile to " << config.profileFile << std::endl;
+            status = 1;
+        } else if (config.profileFile != "-") {
+            std::cout << "Merged profile written to " << config.profileFile << std::endl;
+        }
+    }
+    bool allPassed = std::all_of(coordinator.getResults().begin(), coordinator.getResults().end(),
+                                 [](const FarmResult& result) { return result.success; });
+    return allPassed ? status : 1;
+}
+
+int runWorker(const SimulatorConfig& config) {
+    FarmWorker worker(config);
+    if (!worker.initialize() || !worker.run()) {
+        std::cerr << "Worker failed: " << worker.getLastError() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+int runRandomRuns(const SimulatorConfig& config) {
+    RandomBatch batch(config, config.randomRuns);
+    if (!batch.initialize()) {
+        std::cerr << "Failed to initialize random runs: " << batch.getLastError() << std::endl;
+        return 1;
+    }
+    
+    bool allPassed = batch.run();
+    batch.printSummary();
+    if (!config.profileFile.empty()) {
+        if (!batch.writeProfile(config.profileFile)) {
+            std::cerr << "Failed to write profile to " << config.profileFile << std::endl;
+            return 1;
+        }
+        if (config.profileFile != "-") {
+            std::cout << "Merged profile written to " << config.profileFile << std::endl;
+        }
+    }
+    return allPassed ? 0 : 1;
+}
+
+int runExhaustive(const SimulatorConfig& config) {
+    ExhaustiveRunner runner(config, config.exhaustivePeriods);
+    if (!runner.initialize()) {
+        std::cerr << "Failed to initialize exhaustive run: " << runner.getLastError() << std::endl;
+        return 1;
+    }
+    
+    bool allPassed = runner.run();
+    runner.printSummary();
+    if (!config.profileFile.empty()) {
+        if (!runner.writeProfile(config.profileFile)) {
+            std::cerr << "Failed to write profile to " << config.profileFile << std::endl;
+            return 1;
+        }
+        if (config.profileFile != "-") {
+            std::cout << "Merged profile written to " << config.profileFile << std::endl;
+        }
+    }
+    return allPassed ? 0 : 1;
+}
+
+int runBatchMode(const SimulatorConfig& config) {
+    std::vector<std::string> files;
+    try {
+        files = BatchSimulator::readStimulusList(config.batchListFile);
+    } catch (const SimulatorException& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    
+    if (config.threadedBatch) {
+        SweepRunner sweep(config, files, config.jobs);
+        if (!sweep.initialize()) {
+            std::cerr << "Failed to initialize sweep: " << sweep.getLastError() << std::endl;
+            return 1;
+        }
+        
+        bool allPassed = sweep.run();
+        sweep.printSummary();
+        return allPassed ? 0 : 1;
+    }
+    
+    BatchSimulator batch(config, files);
+    if (!batch.initialize()) {
+        std::cerr << "Failed to initialize batch: " << batch.getLastError() << std::endl;
+        return 1;
+    }
+    
+    if (!batch.run()) {
+        std::cerr << "Batch simulation failed: " << batch.getLastError() << std::endl;
+        return 1;
+    }
+    
+    batch.printSummary();
+    return 0;
+}
+
 } // namespace HotstateSim
 
 int main(int argc, char* argv[]) {
@@ -396,6 +1265,56 @@ int main(int argc, char* argv[]) {
             printUsage(argv[0]);
             return 1;
         }
+        MemoryLoader::setImageCache(config.imageCacheDir);
+        
+        if (!config.convertStimulusFile.empty()) {
+            return runConvertStimulus(config);
+        }
+        if (!config.dumpTraceFile.empty()) {
+            return runDumpTrace(config);
+        }
+        if (!config.emitCppFile.empty()) {
+            return runEmitCpp(config);
+        }
+        if (config.explore) {
+            return runExplore(config);
+        }
+        if (config.autotune) {
+            return runAutotune(config);
+        }
+        if (config.cores > 0) {
+            return runCores(config);
+        }
+        
+        if (config.coordinatorPort > 0) {
+            return runCoordinator(config);
+        }
+        if (!config.workerAddress.empty()) {
+            return runWorker(config);
+        }
+        
+        if (config.exhaustivePeriods > 0) {
+            return runExhaustive(config);
+        }
+        if (config.randomRuns > 0) {
+            return runRandomRuns(config);
+        }
+        
+        // Batch mode shares one memory image across all listed stimulus files
+        if (!config.batchListFile.empty()) {
+            return runBatchMode(config);
+        }
+        
+        // A script is checked before the program is loaded
+        DebugScript script;
+        if (!config.scriptFile.empty()) {
+            try {
+                script = DebugScript::load(config.scriptFile);
+            } catch (const SimulatorException& e) {
+                std::cerr << "Error: " << e.what() << std::endl;
+                return 1;
+            }
+        }
         
         // Create and initialize simulator
         Simulator simulator(config);
@@ -410,26 +1329,16 @@ int main(int argc, char* argv[]) {
             return runInteractiveMode(simulator);
         }
         
-        // Check for export options
-        std::string exportFile;
-        OutputFormat exportFormat = OutputFormat::CSV;
-        
-        // Re-parse command line for export options
-        for (int i = 1; i < argc; i++) {
-            if (std::string(argv[i]) == "--export" && i + 1 < argc) {
-                exportFile = argv[i + 1];
-            } else if (std::string(argv[i]) == "--export-format" && i + 1 < argc) {
-                try {
-                    exportFormat = parseOutputFormat(argv[i + 1]);
-                } catch (const SimulatorException& e) {
-                    std::cerr << "Warning: Invalid export format, using CSV" << std::endl;
-                }
-            }
-        }
-        
         // Run simulation
         bool success = false;
-        if (config.cycleStep > 1) {
+        if (!config.scriptFile.empty()) {
+            // A failed command or expect has been reported by the script
+            if (!script.run(simulator)) {
+                return 1;
+            }
+            success = true;
+            
+        } else if (config.cycleStep > 1) {
             // Step mode
             std::cout << "Running in step mode with step size " << config.cycleStep << std::endl;
             
@@ -470,12 +1379,53 @@ int main(int argc, char* argv[]) {
         // Print summary if verbose
         if (config.verbose) {
             simulator.printSummary();
+        } else if (simulator.hasConverged()) {
+            std::cout << "Converged at cycle " << simulator.getConvergedCycle() << " with a period of "
+                      << simulator.getPeriod() << " cycles" << std::endl;
+        }
+        if (config.stats) {
+            simulator.printRunStats();
+        }
+        
+        if (!config.profileFile.empty()) {
+            if (!simulator.writeProfile(config.profileFile)) {
+                std::cerr << "Failed to write profile: " << simulator.getLastError() << std::endl;
+                return 1;
+            }
+            if (config.profileFile != "-") {
+                std::cout << "Profile written to: " << config.profileFile << std::endl;
+            }
+        }
+        
+        if (!config.activityFile.empty()) {
+            if (!simulator.writeActivity(config.activityFile)) {
+                std::cerr << "Failed to write switching activity: " << simulator.getLastError() << std::endl;
+                return 1;
+            }
+            if (config.activityFile != "-") {
+                std::cout << "Switching activity written to: " << config.activityFile << std::endl;
+            }
+        }
+        
+        if (!config.signatureFile.empty()) {
+            if (!simulator.writeSignature(config.signatureFile)) {
+                std::cerr << "Failed to write signature: " << simulator.getLastError() << std::endl;
+                return 1;
+            }
+            std::cout << "Signature written to: " << config.signatureFile << std::endl;
+        }
+        if (!config.goldenSignatureFile.empty()) {
+            if (!simulator.compareSignature()) {
+                std::cerr << "Signature mismatch: " << simulator.getLastError() << std::endl;
+                return 1;
+            }
+            std::cout << "Signature matches: " << config.goldenSignatureFile << std::endl;
         }
         
-        // Export results if requested
-        if (!exportFile.empty()) {
-            if (simulator.exportResults(exportFile, exportFormat)) {
-                std::cout << "Results exported to: " << exportFile << std::endl;
+        // The export was written as the run went; finish the file
+        if (!config.exportFile.empty()) {
+            if (simulator.finishExport()) {
+                std::cout << "Results exported to: " << config.exportFile << std::endl;
             } else {
                 std::cerr << "Failed to export results: " << simulator.getLastError() << std::endl;
                 return 1;
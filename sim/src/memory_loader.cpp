@@ -4,9 +4,259 @@
 #include <sstream>
 #include <iostream>
 #include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <cerrno>
+#include <sys/stat.h>
+#include <unistd.h>
+
+extern "C" {
+#include "hotstate.h"
+#include "preprocessor.h"
+}
 
 namespace HotstateSim {
 
+namespace {
+
+bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+// Value of one hex digit, -1 for any other character
+int hexDigit(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    } else if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    } else if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+const char* skipHexPrefix(const char* p, const char* end) {
+    if (end - p >= 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) {
+        p += 2;
+    }
+    return p;
+}
+
+// End of the run of hex digits starting at p
+const char* hexDigitsEnd(const char* p, const char* end) {
+    while (p < end && hexDigit(*p) >= 0) {
+        ++p;
+    }
+    return p;
+}
+
+// Hex digits after an optional 0x, up to the first other character, as
+// parseHex reads them; false without digits or past 64 bits
+bool scanHex(const char* p, const char* end, uint64_t& value) {
+    p = skipHexPrefix(p, end);
+    value = 0;
+    const char* digits = p;
+    for (; p < end; ++p) {
+        int digit = hexDigit(*p);
+        if (digit < 0) {
+            break;
+        }
+        if (value >> 60) {
+            return false;
+        }
+        value = (value << 4) | static_cast<uint64_t>(digit);
+    }
+    return p > digits;
+}
+
+// A line of only decimal digits; false past 64 bits
+bool scanDecimal(const char* p, const char* end, uint64_t& value) {
+    value = 0;
+    for (; p < end; ++p) {
+        uint64_t digit = *p - '0';
+        if (value > (UINT64_MAX - digit) / 10) {
+            return false;
+        }
+        value = value * 10 + digit;
+    }
+    return true;
+}
+
+// Hands every value line of a mapped .mem file to parse as a trimmed
+// [begin, end) range, in one pass over the mapping. Empty lines and lines
+// starting with '#' or '/' are skipped; parse errors gain the line number.
+template <typename Parse>
+void scanMemoryText(const MappedFile& mapped, const std::string& filename, Parse parse) {
+    const char* p = reinterpret_cast<const char*>(mapped.bytes());
+    const char* end = p + mapped.size();
+    uint32_t lineNumber = 0;
+    
+    while (p < end) {
+        const char* newline = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        const char* lineEnd = newline ? newline : end;
+        lineNumber++;
+        
+        const char* begin = p;
+        const char* last = lineEnd;
+        while (begin < last && isBlank(*begin)) {
+            begin++;
+        }
+        while (last > begin && isBlank(last[-1])) {
+            last--;
+        }
+        p = newline ? newline + 1 : end;
+        
+        if (begin == last || *begin == '#' || *begin == '/') {
+            continue;
+        }
+        try {
+            parse(begin, last);
+        } catch (const SimulatorException& e) {
+            throw SimulatorException("Error parsing line " + std::to_string(lineNumber) + 
+                                   " in " + filename + ": " + e.what());
+        }
+    }
+}
+
+// FNV-1a, for SymbolTable and image cache keys
+constexpr uint64_t FNV_OFFSET = 0xCBF29CE484222325ULL;
+
+uint64_t hashBytes(uint64_t hash, const void* data, size_t size) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ p[i]) * 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+template <typename T>
+uint64_t hashValue(uint64_t hash, T value) {
+    return hashBytes(hash, &value, sizeof(value));
+}
+
+uint64_t hashName(const std::string& name) {
+    return hashBytes(FNV_OFFSET, name.data(), name.size());
+}
+
+// Image cache entries (--image-cache): the magic, then Parameters, vardata,
+// switchdata, timdata and smdata, the input and state symbols and the
+// source labels, all in the writing simulator's own memory layout. A
+// vector or list is a uint32 count and its items, a symbol a uint32 ID and
+// a string, a string a uint32 length and its bytes.
+constexpr char IMAGE_CACHE_MAGIC[8] = {'H', 'S', 'I', 'C', 'A', 'C', 'H', '1'};
+
+void appendBytes(std::vector<uint8_t>& out, const void* data, size_t size) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    out.insert(out.end(), p, p + size);
+}
+
+void appendString(std::vector<uint8_t>& out, const std::string& text) {
+    uint32_t size = static_cast<uint32_t>(text.size());
+    appendBytes(out, &size, sizeof(size));
+    appendBytes(out, text.data(), text.size());
+}
+
+template <typename T>
+void appendVector(std::vector<uint8_t>& out, const std::vector<T>& values) {
+    uint32_t count = static_cast<uint32_t>(values.size());
+    appendBytes(out, &count, sizeof(count));
+    appendBytes(out, values.data(), values.size() * sizeof(T));
+}
+
+// Reads an entry back; throws at the first field that runs past its end
+class CacheReader {
+public:
+    CacheReader(const uint8_t* data, size_t size) : p(data), end(data + size) {}
+    
+    const uint8_t* take(size_t size) {
+        if (size > static_cast<size_t>(end - p)) {
+            throw SimulatorException("Truncated image cache entry");
+        }
+        const uint8_t* at = p;
+        p += size;
+        return at;
+    }
+    uint32_t word() {
+        uint32_t value;
+        std::memcpy(&value, take(sizeof(value)), sizeof(value));
+        return value;
+    }
+    // A count of items of at least itemSize bytes each, checked against
+    // what is left before anything is allocated for them
+    uint32_t count(size_t itemSize) {
+        uint32_t items = word();
+        if (items > static_cast<size_t>(end - p) / itemSize) {
+            throw SimulatorException("Truncated image cache entry");
+        }
+        return items;
+    }
+    std::string string() {
+        uint32_t size = word();
+        return std::string(reinterpret_cast<const char*>(take(size)), size);
+    }
+    template <typename T>
+    void vector(std::vector<T>& out) {
+        out.resize(count(sizeof(T)));
+        if (!out.empty()) {
+            std::memcpy(out.data(), take(out.size() * sizeof(T)), out.size() * sizeof(T));
+        }
+    }
+
+private:
+    const uint8_t* p;
+    const uint8_t* end;
+};
+
+// Parameters in the order a memory image stores them
+constexpr uint32_t Parameters::* IMAGE_PARAMETERS[] = {
+    &Parameters::STATE_WIDTH, &Parameters::MASK_WIDTH, &Parameters::JADR_WIDTH,
+    &Parameters::VARSEL_WIDTH, &Parameters::TIMERSEL_WIDTH, &Parameters::TIMERLD_WIDTH,
+    &Parameters::SWITCH_SEL_WIDTH, &Parameters::SWITCH_ADR_WIDTH, &Parameters::STATE_CAPTURE_WIDTH,
+    &Parameters::VAR_OR_TIMER_WIDTH, &Parameters::BRANCH_WIDTH, &Parameters::FORCED_JMP_WIDTH,
+    &Parameters::SUB_WIDTH, &Parameters::RTN_WIDTH, &Parameters::INSTR_WIDTH,
+    &Parameters::NUM_STATES, &Parameters::NUM_VARSEL, &Parameters::NUM_VARSEL_BITS,
+    &Parameters::NUM_VARS, &Parameters::NUM_TIMERS, &Parameters::NUM_SWITCHES,
+    &Parameters::SWITCH_OFFSET_BITS, &Parameters::SWITCH_MEM_WORDS, &Parameters::NUM_SWITCH_BITS,
+    &Parameters::NUM_ADR_BITS, &Parameters::NUM_WORDS, &Parameters::TIM_WIDTH,
+    &Parameters::TIM_MEM_WORDS, &Parameters::NUM_CTL_BITS, &Parameters::SMDATA_WIDTH,
+    &Parameters::STACK_DEPTH, &Parameters::SMDATA_WORDS, &Parameters::INTERRUPT_ADDRESS,
+    &Parameters::PIPELINED,
+};
+
+uint32_t imageWord(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+// Copies count little-endian words at offset into out; a single memcpy on
+// little-endian hosts. Throws if the section runs past the image.
+template <typename T>
+void copyImageSection(const uint8_t* image, size_t size, uint32_t offset, uint32_t count,
+                      std::vector<T>& out, const std::string& name) {
+    if (offset % sizeof(T) != 0 ||
+        offset > size || count > (size - offset) / sizeof(T)) {
+        throw SimulatorException("Truncated " + name + " section");
+    }
+    const uint8_t* p = image + offset;
+    out.resize(count);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    if (count > 0) {
+        std::memcpy(out.data(), p, count * sizeof(T));
+    }
+#else
+    for (uint32_t i = 0; i < count; i++) {
+        T value = 0;
+        for (size_t byte = 0; byte < sizeof(T); byte++) {
+            value |= static_cast<T>(p[i * sizeof(T) + byte]) << (8 * byte);
+        }
+        out[i] = value;
+    }
+#endif
+}
+
+} // namespace
+
 bool Parameters::isValid() const {
     return STATE_WIDTH > 0 && 
            MASK_WIDTH > 0 && 
@@ -31,6 +281,7 @@ void Parameters::print() const {
     std::cout << "NUM_TIMERS: " << NUM_TIMERS << std::endl;
     std::cout << "INSTR_WIDTH: " << INSTR_WIDTH << std::endl;
     std::cout << "SMDATA_WIDTH: " << SMDATA_WIDTH << std::endl;
+    std::cout << "SMDATA_WORDS: " << SMDATA_WORDS << std::endl;
     std::cout << "=================" << std::endl;
 }
 
@@ -38,10 +289,19 @@ bool MemoryLoader::loadFromBasePath(const std::string& basePath) {
     std::string baseFilename = getBaseFilename(basePath);
     
     bool success = true;
-    success &= loadVardata(baseFilename + "_vardata.mem");
-    success &= loadSwitchdata(baseFilename + "_switchdata.mem");
-    success &= loadSmdata(baseFilename + "_smdata.mem");
-    success &= loadParams(baseFilename + "_params.vh");
+    if (fileExists(baseFilename + "_image.bin")) {
+        success = loadImage(baseFilename + "_image.bin");
+    } else {
+        success &= loadVardata(baseFilename + "_vardata.mem");
+        success &= loadSwitchdata(baseFilename + "_switchdata.mem");
+        success &= loadSmdata(baseFilename + "_smdata.mem");
+        success &= loadParams(baseFilename + "_params.vh");
+    }
+    
+    // Timer memory is optional: programs without timers have none
+    if (fileExists(baseFilename + "_timdata.mem")) {
+        success &= loadTimdata(baseFilename + "_timdata.mem");
+    }
 
     // Try to load symbol table (TOML format preferred, with fallback to text format)
     if (!loadSymbolTable(baseFilename + "_symbols.toml")) {
@@ -59,9 +319,269 @@ bool MemoryLoader::loadFromBasePath(const std::string& basePath) {
     return success;
 }
 
+bool MemoryLoader::loadFromSource(const std::string& sourceFile, const HotstateOptions* options) {
+    // #include is expanded from the source's directory, as c_parser does
+    char* source = preprocess_includes(sourceFile.c_str());
+    if (!source) {
+        std::cerr << "Error: Failed to preprocess " << sourceFile << std::endl;
+        return false;
+    }
+    
+    HotstateContext* compiler = hotstate_create();
+    HotstateResult* result = compiler ? hotstate_compile(compiler, source, options) : nullptr;
+    free(source);
+    if (!result) {
+        std::cerr << "Error: Failed to compile " << sourceFile << ": "
+                  << (compiler ? hotstate_error(compiler) : "out of memory") << std::endl;
+        hotstate_destroy(compiler);
+        return false;
+    }
+    
+    bool success = loadImageData(reinterpret_cast<const uint8_t*>(result->image.data), result->image.size,
+                                 sourceFile);
+    loadSymbolTableTOMLText(std::string(result->symbols.data, result->symbols.size), sourceFile);
+    sourceLabels.clear();
+    // Labels are built from the AST, which the release below frees
+    for (int i = 0; i < result->microcode->instruction_count; ++i) {
+        const char* label = compact_word_label(result->microcode, i);
+        sourceLabels.emplace_back(label ? label : "");
+    }
+    // The delays' timer counts, which the image does not carry
+    timdata.assign(result->microcode->timdata, result->microcode->timdata + result->microcode->timdata_count);
+    hotstate_release(compiler, result);
+    hotstate_destroy(compiler);
+    
+    if (success) {
+        loaded = true;
+        std::cout << "Successfully compiled and loaded " << sourceFile << std::endl;
+    }
+    return success;
+}
+
+uint64_t MemoryLoader::fingerprint() const {
+    uint64_t hash = hashBytes(FNV_OFFSET, &params, sizeof(params));
+    hash = hashBytes(hash, vardata.data(), vardata.size() * sizeof(vardata[0]));
+    hash = hashBytes(hash, switchdata.data(), switchdata.size() * sizeof(switchdata[0]));
+    hash = hashBytes(hash, timdata.data(), timdata.size() * sizeof(timdata[0]));
+    return hashBytes(hash, smdata.data(), smdata.size() * sizeof(smdata[0]));
+}
+
+std::string MemoryLoader::imageCacheDir;
+
+bool MemoryLoader::loadProgram(const std::string& basePath, const std::string& sourceFile) {
+    uint64_t key;
+    if (imageCacheDir.empty() || !programCacheKey(basePath, sourceFile, key)) {
+        return sourceFile.empty() ? loadFromBasePath(basePath) : loadFromSource(sourceFile);
+    }
+    
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.hsimg", static_cast<unsigned long long>(key));
+    std::string path = imageCacheDir + "/" + name;
+    if (fileExists(path) && loadCachedProgram(path)) {
+        std::cout << "Loaded " << (sourceFile.empty() ? basePath : sourceFile) << " from image cache " << path << std::endl;
+        return true;
+    }
+    
+    bool success = sourceFile.empty() ? loadFromBasePath(basePath) : loadFromSource(sourceFile);
+    if (success) {
+        storeCachedProgram(path);
+    }
+    return success;
+}
+
+void MemoryLoader::setImageCache(const std::string& dir) {
+    imageCacheDir = dir;
+}
+
+// The files a base path load reads, or the preprocessed source of a
+// compile, and the simulator binary that parses them: a rebuilt simulator
+// may decode them differently, and entries are in its own memory layout
+bool MemoryLoader::programCacheKey(const std::string& basePath, const std::string& sourceFile, uint64_t& key) {
+    struct stat exe;
+    if (stat("/proc/self/exe", &exe) != 0) {
+        return false;
+    }
+    key = hashBytes(FNV_OFFSET, IMAGE_CACHE_MAGIC, sizeof(IMAGE_CACHE_MAGIC));
+    key = hashValue(key, static_cast<uint64_t>(exe.st_size));
+    key = hashValue(key, static_cast<uint64_t>(exe.st_mtim.tv_sec));
+    key = hashValue(key, static_cast<uint64_t>(exe.st_mtim.tv_nsec));
+    
+    if (!sourceFile.empty()) {
+        char* source = preprocess_includes(sourceFile.c_str());
+        if (!source) {
+            return false;
+        }
+        key = hashBytes(key, "source", 7);
+        key = hashBytes(key, source, std::strlen(source));
+        free(source);
+        return true;
+    }
+    
+    // Each file's suffix, whether it exists, and its contents
+    std::string base = getBaseFilename(basePath);
+    for (const char* suffix : {"_image.bin", "_vardata.mem", "_switchdata.mem", "_smdata.mem", "_params.vh",
+                               "_timdata.mem", "_symbols.toml", "_symbols.txt"}) {
+        key = hashBytes(key, suffix, std::strlen(suffix) + 1);
+        std::string filename = base + suffix;
+        bool exists = fileExists(filename);
+        key = hashValue(key, exists);
+        if (exists) {
+            try {
+                MappedFile mapped(filename, "file");
+                key = hashValue(key, mapped.size());
+                key = hashBytes(key, mapped.bytes(), mapped.size());
+            } catch (const SimulatorException&) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool MemoryLoader::loadCachedProgram(const std::string& path) {
+    try {
+        MappedFile mapped(path, "image cache entry");
+        CacheReader in(mapped.bytes(), mapped.size());
+        if (in.take(sizeof(IMAGE_CACHE_MAGIC)) == nullptr ||
+            std::memcmp(mapped.bytes(), IMAGE_CACHE_MAGIC, sizeof(IMAGE_CACHE_MAGIC)) != 0) {
+            throw SimulatorException("Not an image cache entry");
+        }
+        std::memcpy(&params, in.take(sizeof(params)), sizeof(params));
+        in.vector(vardata);
+        in.vector(switchdata);
+        in.vector(timdata);
+        in.vector(smdata);
+        for (SymbolTable* table : {&inputSymbols, &stateSymbols}) {
+            *table = SymbolTable();
+            for (uint32_t i = 0, count = in.count(8); i < count; i++) {
+                uint32_t index = in.word();
+                table->add(in.string(), index);
+            }
+        }
+        sourceLabels.assign(in.count(4), std::string());
+        for (std::string& label : sourceLabels) {
+            label = in.string();
+        }
+    } catch (const SimulatorException& e) {
+        std::cerr << "Warning: Ignoring image cache entry " << path << ": " << e.what() << std::endl;
+        return false;
+    }
+    loaded = true;
+    return true;
+}
+
+// Written to a private name and published with one rename, so processes
+// loading the same program at once never see half an entry; a failure
+// only costs the next process the parse
+void MemoryLoader::storeCachedProgram(const std::string& path) const {
+    std::vector<uint8_t> out(IMAGE_CACHE_MAGIC, IMAGE_CACHE_MAGIC + sizeof(IMAGE_CACHE_MAGIC));
+    appendBytes(out, &params, sizeof(params));
+    appendVector(out, vardata);
+    appendVector(out, switchdata);
+    appendVector(out, timdata);
+    appendVector(out, smdata);
+    for (const SymbolTable* table : {&inputSymbols, &stateSymbols}) {
+        uint32_t count = 0;
+        for (uint32_t index = 0; index < table->idCount(); index++) {
+            count += !table->nameAt(index).empty();
+        }
+        appendBytes(out, &count, sizeof(count));
+        for (uint32_t index = 0; index < table->idCount(); index++) {
+            if (!table->nameAt(index).empty()) {
+                appendBytes(out, &index, sizeof(index));
+                appendString(out, table->nameAt(index));
+            }
+        }
+    }
+    uint32_t labels = static_cast<uint32_t>(sourceLabels.size());
+    appendBytes(out, &labels, sizeof(labels));
+    for (const std::string& label : sourceLabels) {
+        appendString(out, label);
+    }
+    
+    if (mkdir(imageCacheDir.c_str(), 0777) != 0 && errno != EEXIST) {
+        std::cerr << "Warning: Cannot create image cache directory " << imageCacheDir << std::endl;
+        return;
+    }
+    std::string tmp = path + ".tmp." + std::to_string(getpid());
+    std::ofstream file(tmp, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(out.data()), static_cast<std::streamsize>(out.size()));
+    file.close();
+    if (!file || std::rename(tmp.c_str(), path.c_str()) != 0) {
+        std::remove(tmp.c_str());
+        std::cerr << "Warning: Cannot write image cache entry " << path << std::endl;
+    }
+}
+
+bool MemoryLoader::loadImage(const std::string& filename) {
+    try {
+        MappedFile mapped(filename, "memory image");
+        return loadImageData(mapped.bytes(), mapped.size(), filename);
+    } catch (const SimulatorException& e) {
+        std::cerr << "Error loading memory image " << filename << ": " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool MemoryLoader::loadImageData(const uint8_t* data, size_t size, const std::string& name) {
+    try {
+        if (size < MemoryImageHeader::SIZE ||
+            std::memcmp(data, MemoryImageHeader::MAGIC, 8) != 0) {
+            throw SimulatorException("Not a memory image");
+        }
+        uint32_t version = imageWord(data + 8);
+        if (version != MemoryImageHeader::VERSION) {
+            throw SimulatorException("Unsupported memory image version " + std::to_string(version));
+        }
+        
+        // Images from other versions of the compiler may carry fewer or more
+        // parameters; missing ones are derived as for a .vh file
+        uint32_t paramCount = imageWord(data + 12);
+        if (paramCount > (size - MemoryImageHeader::SIZE) / 4) {
+            throw SimulatorException("Truncated parameter section");
+        }
+        params = Parameters();
+        size_t known = sizeof(IMAGE_PARAMETERS) / sizeof(IMAGE_PARAMETERS[0]);
+        for (uint32_t i = 0; i < paramCount && i < known; i++) {
+            params.*IMAGE_PARAMETERS[i] = imageWord(data + MemoryImageHeader::SIZE + 4 * i);
+        }
+        
+        copyImageSection(data, size, imageWord(data + 16), imageWord(data + 20), vardata, "vardata");
+        copyImageSection(data, size, imageWord(data + 24), imageWord(data + 28), switchdata, "switchdata");
+        copyImageSection(data, size, imageWord(data + 32), imageWord(data + 36), smdata, "smdata");
+        deriveParameters();
+    } catch (const SimulatorException& e) {
+        std::cerr << "Error loading memory image " << name << ": " << e.what() << std::endl;
+        return false;
+    }
+    
+    std::cout << "Loaded " << vardata.size() << " vardata, " << switchdata.size() << " switchdata and "
+              << getSmdataSize() << " microcode words from " << name << std::endl;
+    return true;
+}
+
 bool MemoryLoader::loadVardata(const std::string& filename) {
     try {
-        return loadMemoryFile(filename, vardata);
+        // c_parser --vardata-bits starts the file with "// VARDATA_WORD_BITS = N"
+        // and writes hex words of N entries
+        uint32_t bits = 0;
+        std::ifstream file(filename);
+        std::string first;
+        if (file && std::getline(file, first) && startsWith(first, "// VARDATA_WORD_BITS =")) {
+            bits = parseDecimal(trim(first.substr(first.find('=') + 1)));
+            if (bits == 0 || bits > 32) {
+                throw SimulatorException("Unsupported VARDATA_WORD_BITS " + std::to_string(bits));
+            }
+        }
+        if (!loadMemoryFile(filename, vardata, bits > 1)) {
+            return false;
+        }
+        if (bits > 1) {
+            params.VARDATA_WORD_BITS = bits;
+            unpackVardata();
+            std::cout << "Unpacked " << vardata.size() << " vardata entries (" << bits << " per word)" << std::endl;
+        }
+        return true;
     } catch (const SimulatorException& e) {
         std::cerr << "Error loading vardata from " << filename << ": " << e.what() << std::endl;
         return false;
@@ -77,9 +597,18 @@ bool MemoryLoader::loadSwitchdata(const std::string& filename) {
     }
 }
 
+bool MemoryLoader::loadTimdata(const std::string& filename) {
+    try {
+        return loadMemoryFile(filename, timdata);
+    } catch (const SimulatorException& e) {
+        std::cerr << "Error loading timdata from " << filename << ": " << e.what() << std::endl;
+        return false;
+    }
+}
+
 bool MemoryLoader::loadSmdata(const std::string& filename) {
     try {
-        return loadSmdataFile(filename, smdata);
+        return loadSmdataFile(filename, smdata, params.SMDATA_WORDS);
     } catch (const SimulatorException& e) {
         std::cerr << "Error loading smdata from " << filename << ": " << e.what() << std::endl;
         return false;
@@ -95,89 +624,182 @@ bool MemoryLoader::loadParams(const std::string& filename) {
     }
 }
 
-bool MemoryLoader::loadMemoryFile(const std::string& filename, std::vector<uint32_t>& data) {
+bool MemoryLoader::loadMemoryFile(const std::string& filename, std::vector<uint32_t>& data, bool hex) {
     if (!fileExists(filename)) {
         throw SimulatorException("File not found: " + filename);
     }
     
-    std::ifstream file(filename);
-    if (!file.is_open()) {
-        throw SimulatorException("Cannot open file: " + filename);
-    }
-    
+    MappedFile mapped(filename, "file");
     data.clear();
-    std::string line;
-    uint32_t lineNumber = 0;
-    
-    while (std::getline(file, line)) {
-        lineNumber++;
-        line = trim(line);
-        
-        // Skip empty lines and comments
-        if (line.empty() || line[0] == '#' || line[0] == '/') {
-            continue;
+    size_t next = 0;
+    scanMemoryText(mapped, filename, [&](const char* begin, const char* end) {
+        // "@address" (hex, as $readmemh reads it) moves to that entry;
+        // entries skipped over are zero
+        uint64_t value;
+        if (*begin == '@') {
+            if (!scanHex(begin + 1, end, value) || value > UINT32_MAX) {
+                throw SimulatorException("Failed to parse address: " + std::string(begin, end));
+            }
+            next = static_cast<size_t>(value);
+            if (next > data.size()) {
+                data.resize(next, 0);
+            }
+            return;
         }
         
-        try {
-            // Try to parse as hex first, then decimal
-            uint32_t value;
-            if (line.find("0x") == 0 || line.find("0X") == 0) {
-                value = parseHex(line);
-            } else if (line.find_first_not_of("0123456789") == std::string::npos) {
-                // Pure decimal
-                value = parseDecimal(line);
-            } else {
-                // Try hex parsing
-                value = parseHex(line);
-            }
-            data.push_back(value);
-        } catch (const SimulatorException& e) {
-            throw SimulatorException("Error parsing line " + std::to_string(lineNumber) + 
-                                   " in " + filename + ": " + e.what());
+        // 0x-prefixed or containing letters: hex; only digits: decimal
+        bool decimal = !hex && std::all_of(begin, end, [](char c) { return c >= '0' && c <= '9'; });
+        if (decimal ? !scanDecimal(begin, end, value) : !scanHex(begin, end, value)) {
+            throw SimulatorException(std::string(decimal ? "Failed to parse decimal value: "
+                                                         : "Failed to parse hex value: ") +
+                                     std::string(begin, end));
         }
-    }
+        if (next < data.size()) {
+            data[next] = static_cast<uint32_t>(value);
+        } else {
+            data.push_back(static_cast<uint32_t>(value));
+        }
+        next++;
+    });
     
     std::cout << "Loaded " << data.size() << " values from " << filename << std::endl;
     return true;
 }
 
-bool MemoryLoader::loadSmdataFile(const std::string& filename, std::vector<uint64_t>& data) {
+bool MemoryLoader::loadSmdataFile(const std::string& filename, std::vector<uint64_t>& data, uint32_t& words) {
     if (!fileExists(filename)) {
         throw SimulatorException("File not found: " + filename);
     }
     
-    std::ifstream file(filename);
-    if (!file.is_open()) {
-        throw SimulatorException("Cannot open file: " + filename);
-    }
-    
+    MappedFile mapped(filename, "file");
     data.clear();
-    std::string line;
-    uint32_t lineNumber = 0;
     
-    while (std::getline(file, line)) {
-        lineNumber++;
-        line = trim(line);
-        
-        // Skip empty lines and comments
-        if (line.empty() || line[0] == '#' || line[0] == '/') {
-            continue;
+    // Every entry gets as many uint64s as the widest line needs, so a first
+    // pass finds that width before any line is stored
+    size_t maxDigits = 1;
+    scanMemoryText(mapped, filename, [&](const char* begin, const char* end) {
+        const char* digits = skipHexPrefix(begin, end);
+        maxDigits = std::max(maxDigits, static_cast<size_t>(hexDigitsEnd(digits, end) - digits));
+    });
+    words = static_cast<uint32_t>((maxDigits + 15) / 16);
+    
+    size_t entries = 0;
+    scanMemoryText(mapped, filename, [&](const char* begin, const char* end) {
+        const char* digits = skipHexPrefix(begin, end);
+        const char* last = hexDigitsEnd(digits, end);
+        if (last == digits) {
+            throw SimulatorException("Failed to parse hex value: " + std::string(begin, end));
         }
-        
-        try {
-            // Parse as 64-bit hex
-            uint64_t value = parseHex64(line);
-            data.push_back(value);
-        } catch (const SimulatorException& e) {
-            throw SimulatorException("Error parsing line " + std::to_string(lineNumber) + 
-                                   " in " + filename + ": " + e.what());
+        data.resize(data.size() + words, 0);
+        uint64_t* entry = data.data() + entries * words;
+        uint32_t bit = 0;
+        for (const char* p = last; p > digits; --p, bit += 4) {
+            entry[bit / 64] |= static_cast<uint64_t>(hexDigit(p[-1])) << (bit % 64);
         }
-    }
+        entries++;
+    });
     
-    std::cout << "Loaded " << data.size() << " microcode instructions from " << filename << std::endl;
+    std::cout << "Loaded " << entries << " microcode instructions (" << words * 64
+              << "-bit words) from " << filename << std::endl;
     return true;
 }
 
+bool MemoryLoader::applyPatch(const std::string& filename) {
+    try {
+        if (!loaded) {
+            throw SimulatorException("No program loaded to patch");
+        }
+        if (!fileExists(filename)) {
+            throw SimulatorException("File not found: " + filename);
+        }
+        
+        MappedFile mapped(filename, "memory patch");
+        const uint32_t words = getSmdataWords();
+        const uint32_t vardataBits = params.VARDATA_WORD_BITS;
+        size_t patched = 0;
+        scanMemoryText(mapped, filename, [&](const char* begin, const char* end) {
+            // "memory @address value ...": the run's values from address on,
+            // each read as that memory's .mem file is
+            std::vector<std::pair<const char*, const char*>> tokens;
+            for (const char* p = begin; p < end; ) {
+                const char* token = p;
+                while (p < end && !isBlank(*p)) {
+                    ++p;
+                }
+                tokens.emplace_back(token, p);
+                while (p < end && isBlank(*p)) {
+                    ++p;
+                }
+            }
+            uint64_t address;
+            if (tokens.size() < 3 || *tokens[1].first != '@' ||
+                !scanHex(tokens[1].first + 1, tokens[1].second, address)) {
+                throw SimulatorException("Expected \"memory @address values\": " + std::string(begin, end));
+            }
+            std::string memory(tokens[0].first, tokens[0].second);
+            
+            for (size_t i = 2; i < tokens.size(); ++i, ++address) {
+                const char* value = tokens[i].first;
+                const char* valueEnd = tokens[i].second;
+                if (memory == "smdata") {
+                    const char* digits = skipHexPrefix(value, valueEnd);
+                    const char* last = hexDigitsEnd(digits, valueEnd);
+                    if (last == digits || last != valueEnd) {
+                        throw SimulatorException("Failed to parse hex value: " + std::string(value, valueEnd));
+                    }
+                    if (static_cast<size_t>(last - digits) > words * 16) {
+                        throw SimulatorException("smdata word wider than the loaded program's; load the new build instead");
+                    }
+                    if ((address + 1) * words > smdata.size()) {
+                        smdata.resize((address + 1) * words, 0);
+                    }
+                    uint64_t* entry = smdata.data() + address * words;
+                    std::fill(entry, entry + words, 0);
+                    uint32_t bit = 0;
+                    for (const char* p = last; p > digits; --p, bit += 4) {
+                        entry[bit / 64] |= static_cast<uint64_t>(hexDigit(p[-1])) << (bit % 64);
+                    }
+                    continue;
+                }
+                
+                std::vector<uint32_t>* data = memory == "vardata" ? &vardata
+                                            : memory == "switchdata" ? &switchdata
+                                            : memory == "timdata" ? &timdata : nullptr;
+                if (!data) {
+                    throw SimulatorException("Unknown memory " + memory);
+                }
+                // Packed vardata words are hex, as loadVardata reads them
+                bool packed = data == &vardata && vardataBits > 1;
+                uint64_t number;
+                bool decimal = !packed && std::all_of(value, valueEnd, [](char c) { return c >= '0' && c <= '9'; });
+                if (decimal ? !scanDecimal(value, valueEnd, number) : !scanHex(value, valueEnd, number)) {
+                    throw SimulatorException("Failed to parse value: " + std::string(value, valueEnd));
+                }
+                if (packed) {
+                    if ((address + 1) * vardataBits > data->size()) {
+                        data->resize((address + 1) * vardataBits, 0);
+                    }
+                    for (uint32_t bit = 0; bit < vardataBits; bit++) {
+                        (*data)[address * vardataBits + bit] = (number >> bit) & 1;
+                    }
+                } else {
+                    if (address >= data->size()) {
+                        data->resize(address + 1, 0);
+                    }
+                    (*data)[address] = static_cast<uint32_t>(number);
+                }
+            }
+            patched += tokens.size() - 2;
+        });
+        
+        std::cout << "Patched " << patched << " words from " << filename << std::endl;
+        return true;
+    } catch (const SimulatorException& e) {
+        std::cerr << "Error applying memory patch " << filename << ": " << e.what() << std::endl;
+        return false;
+    }
+}
+
 bool MemoryLoader::parseParameterFile(const std::string& filename) {
     if (!fileExists(filename)) {
         throw SimulatorException("File not found: " + filename);
@@ -282,9 +904,33 @@ bool MemoryLoader::parseParameterFile(const std::string& filename) {
             else if (paramName == "NUM_CTL_BITS") params.NUM_CTL_BITS = value;
             else if (paramName == "SMDATA_WIDTH") params.SMDATA_WIDTH = value;
             else if (paramName == "STACK_DEPTH") params.STACK_DEPTH = value;
+            else if (paramName == "SMDATA_WORDS") params.SMDATA_WORDS = value;
+            else if (paramName == "VARDATA_WORD_BITS") params.VARDATA_WORD_BITS = value;
+            else if (paramName == "INTERRUPT_ADDRESS") params.INTERRUPT_ADDRESS = value;
+            else if (paramName == "PIPELINED") params.PIPELINED = value;
         }
     }
     
+    deriveParameters();
+    std::cout << "Loaded parameters from " << filename << std::endl;
+    return true;
+}
+
+// A packed vardata file holds VARDATA_WORD_BITS LUT entries per word, the
+// first in the least significant bit; the model wants one entry per value
+void MemoryLoader::unpackVardata() {
+    uint32_t bits = params.VARDATA_WORD_BITS;
+    std::vector<uint32_t> entries;
+    entries.reserve(vardata.size() * bits);
+    for (uint32_t word : vardata) {
+        for (uint32_t bit = 0; bit < bits; bit++) {
+            entries.push_back((word >> bit) & 1);
+        }
+    }
+    vardata.swap(entries);
+}
+
+void MemoryLoader::deriveParameters() {
     // Calculate derived parameters if not explicitly set
     if (params.INSTR_WIDTH == 0) {
         params.INSTR_WIDTH = params.STATE_WIDTH + params.MASK_WIDTH + params.JADR_WIDTH + 
@@ -336,18 +982,23 @@ bool MemoryLoader::parseParameterFile(const std::string& filename) {
         std::cout << "DEBUG: Calculated NUM_ADR_BITS = " << params.NUM_ADR_BITS << std::endl;
     }
 
+    if (params.SMDATA_WORDS == 0) {
+        params.SMDATA_WORDS = 1;
+    }
+    if (smdata.size() % params.SMDATA_WORDS != 0) {
+        throw SimulatorException("smdata size " + std::to_string(smdata.size()) +
+                                 " is not a multiple of SMDATA_WORDS " + std::to_string(params.SMDATA_WORDS));
+    }
+
     if (params.NUM_WORDS == 0) {
         // Estimate from smdata size
         if (!smdata.empty()) {
-            params.NUM_WORDS = std::min(static_cast<uint32_t>(smdata.size()), static_cast<uint32_t>(64));
+            params.NUM_WORDS = std::min(static_cast<uint32_t>(getSmdataSize()), static_cast<uint32_t>(64));
         } else {
             params.NUM_WORDS = 32; // Default
         }
         std::cout << "DEBUG: Estimated NUM_WORDS = " << params.NUM_WORDS << std::endl;
     }
-
-    std::cout << "Loaded parameters from " << filename << std::endl;
-    return true;
 }
 
 std::string MemoryLoader::extractParameterValue(const std::string& valueStr) {
@@ -379,7 +1030,9 @@ void MemoryLoader::printMemoryInfo() const {
     std::cout << "=== Memory Information ===" << std::endl;
     std::cout << "Vardata size: " << vardata.size() << " entries" << std::endl;
     std::cout << "Switchdata size: " << switchdata.size() << " entries" << std::endl;
-    std::cout << "Smdata size: " << smdata.size() << " entries" << std::endl;
+    std::cout << "Timdata size: " << timdata.size() << " entries" << std::endl;
+    std::cout << "Smdata size: " << getSmdataSize() << " entries of " << getSmdataWords() * 64
+              << " bits" << std::endl;
     std::cout << "Loaded: " << (loaded ? "Yes" : "No") << std::endl;
     std::cout << "========================" << std::endl;
 }
@@ -409,13 +1062,14 @@ void MemoryLoader::printSwitchdata(size_t maxEntries) const {
 }
 
 void MemoryLoader::printSmdata(size_t maxEntries) const {
-    std::cout << "=== Smdata (" << smdata.size() << " entries) ===" << std::endl;
-    size_t entriesToShow = std::min(maxEntries, smdata.size());
+    size_t entries = getSmdataSize();
+    std::cout << "=== Smdata (" << entries << " entries) ===" << std::endl;
+    size_t entriesToShow = std::min(maxEntries, entries);
     for (size_t i = 0; i < entriesToShow; ++i) {
-        std::cout << "[" << i << "] = 0x" << std::hex << smdata[i] << std::dec << std::endl;
+        std::cout << "[" << i << "] = 0x" << wideHexString(getSmdataEntry(i), getSmdataWords()) << std::endl;
     }
-    if (smdata.size() > maxEntries) {
-        std::cout << "... (" << (smdata.size() - maxEntries) << " more entries)" << std::endl;
+    if (entries > maxEntries) {
+        std::cout << "... (" << (entries - maxEntries) << " more entries)" << std::endl;
     }
     std::cout << "========================" << std::endl;
 }
@@ -457,7 +1111,15 @@ bool MemoryLoader::loadSymbolTableTOML(const std::string& filename) {
     if (!file.is_open()) {
         return false;
     }
+    return parseSymbolTableTOML(file, filename);
+}
 
+bool MemoryLoader::loadSymbolTableTOMLText(const std::string& text, const std::string& name) {
+    std::istringstream stream(text);
+    return parseSymbolTableTOML(stream, name);
+}
+
+bool MemoryLoader::parseSymbolTableTOML(std::istream& file, const std::string& name) {
     std::string line;
     std::string current_section;
     bool in_state_vars = false;
@@ -480,6 +1142,12 @@ bool MemoryLoader::loadSymbolTableTOML(const std::string& filename) {
             in_state_vars = false;
             in_input_vars = true;
             continue;
+        } else if (line[0] == '[') {
+            // Interrupt handlers, subroutines: not variables
+            current_section = line;
+            in_state_vars = false;
+            in_input_vars = false;
+            continue;
         }
 
         // Parse variable entries (format: "index" = { name = "var_name", type = "input/output" })
@@ -504,21 +1172,17 @@ bool MemoryLoader::loadSymbolTableTOML(const std::string& filename) {
 
             // Add to appropriate map
             if (in_state_vars) {
-                stateNameToIndex[name] = index;
-                stateIndexToName[index] = name;
+                stateSymbols.add(name, index);
             } else if (in_input_vars) {
-                inputNameToIndex[name] = index;
-                inputIndexToName[index] = name;
+                inputSymbols.add(name, index);
             }
         }
     }
 
-    file.close();
-
-    if (!inputNameToIndex.empty() || !stateNameToIndex.empty()) {
-        std::cout << "Loaded TOML symbol table from " << filename << std::endl;
-        std::cout << "  Input variables: " << inputNameToIndex.size() << std::endl;
-        std::cout << "  State variables: " << stateNameToIndex.size() << std::endl;
+    if (!inputSymbols.empty() || !stateSymbols.empty()) {
+        std::cout << "Loaded TOML symbol table from " << name << std::endl;
+        std::cout << "  Input variables: " << inputSymbols.size() << std::endl;
+        std::cout << "  State variables: " << stateSymbols.size() << std::endl;
     }
 
     return true;
@@ -551,11 +1215,9 @@ bool MemoryLoader::loadSymbolTableText(const std::string& filename) {
         }
 
         if (type == "INPUT") {
-            inputNameToIndex[name] = index;
-            inputIndexToName[index] = name;
+            inputSymbols.add(name, index);
         } else if (type == "STATE") {
-            stateNameToIndex[name] = index;
-            stateIndexToName[index] = name;
+            stateSymbols.add(name, index);
         } else {
             std::cerr << "Warning: Unknown symbol type at line " << lineNumber << ": " << type << std::endl;
         }
@@ -563,36 +1225,79 @@ bool MemoryLoader::loadSymbolTableText(const std::string& filename) {
 
     file.close();
 
-    if (!inputNameToIndex.empty() || !stateNameToIndex.empty()) {
+    if (!inputSymbols.empty() || !stateSymbols.empty()) {
         std::cout << "Loaded text symbol table from " << filename << std::endl;
-        std::cout << "  Input variables: " << inputNameToIndex.size() << std::endl;
-        std::cout << "  State variables: " << stateNameToIndex.size() << std::endl;
+        std::cout << "  Input variables: " << inputSymbols.size() << std::endl;
+        std::cout << "  State variables: " << stateSymbols.size() << std::endl;
     }
 
     return true;
 }
 
+void SymbolTable::add(const std::string& name, uint32_t index) {
+    if (index >= names.size()) {
+        names.resize(static_cast<size_t>(index) + 1);
+    }
+    names[index] = name;
+    if (slots.empty()) {
+        slots.assign(16, 0);
+    }
+    uint32_t slot = findSlot(name);
+    if (slots[slot] != 0) {
+        entries[slots[slot] - 1].index = index;
+        return;
+    }
+    entries.push_back({name, index});
+    slots[slot] = static_cast<uint32_t>(entries.size());
+    if (entries.size() * 2 > slots.size()) {
+        grow();
+    }
+}
+
+uint32_t SymbolTable::findSlot(const std::string& name) const {
+    uint32_t mask = static_cast<uint32_t>(slots.size() - 1);
+    for (uint32_t slot = static_cast<uint32_t>(hashName(name)) & mask;; slot = (slot + 1) & mask) {
+        if (slots[slot] == 0 || entries[slots[slot] - 1].name == name) {
+            return slot;
+        }
+    }
+}
+
+void SymbolTable::grow() {
+    slots.assign(slots.size() * 2, 0);
+    for (uint32_t i = 0; i < entries.size(); ++i) {
+        slots[findSlot(entries[i].name)] = i + 1;
+    }
+}
+
+uint32_t SymbolTable::find(const std::string& name) const {
+    if (slots.empty()) {
+        return UINT32_MAX;
+    }
+    uint32_t entry = slots[findSlot(name)];
+    return entry != 0 ? entries[entry - 1].index : UINT32_MAX;
+}
+
+const std::string& SymbolTable::nameAt(uint32_t index) const {
+    static const std::string empty;
+    return index < names.size() ? names[index] : empty;
+}
+
 // Symbol table accessor methods
 uint32_t MemoryLoader::getInputIndexByName(const std::string& name) const {
-    auto it = inputNameToIndex.find(name);
-    return (it != inputNameToIndex.end()) ? it->second : UINT32_MAX;
+    return inputSymbols.find(name);
 }
 
 uint32_t MemoryLoader::getStateIndexByName(const std::string& name) const {
-    auto it = stateNameToIndex.find(name);
-    return (it != stateNameToIndex.end()) ? it->second : UINT32_MAX;
+    return stateSymbols.find(name);
 }
 
 const std::string& MemoryLoader::getInputNameByIndex(uint32_t index) const {
-    auto it = inputIndexToName.find(index);
-    static std::string empty = "";
-    return (it != inputIndexToName.end()) ? it->second : empty;
+    return inputSymbols.nameAt(index);
 }
 
 const std::string& MemoryLoader::getStateNameByIndex(uint32_t index) const {
-    auto it = stateIndexToName.find(index);
-    static std::string empty = "";
-    return (it != stateIndexToName.end()) ? it->second : empty;
+    return stateSymbols.nameAt(index);
 }
 
-} // namespace HotstateSim
\ No newline at end of file
+} // namespace HotstateSim
@@ -0,0 +1,341 @@
+#include "model_generator.h"
+#include "utils.h"
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cctype>
+#include <algorithm>
+
+namespace HotstateSim {
+
+namespace {
+
+std::string hexLiteral(uint64_t value) {
+    std::ostringstream ss;
+    ss << "0x" << std::hex << std::uppercase << value << "ULL";
+    return ss.str();
+}
+
+// "TestAllLoopsModel" -> "HOTSTATE_TEST_ALL_LOOPS_MODEL_H"
+std::string guardFor(const std::string& className) {
+    std::string guard = "HOTSTATE_";
+    for (size_t i = 0; i < className.size(); ++i) {
+        char c = className[i];
+        if (i > 0 && std::isupper(static_cast<unsigned char>(c)) &&
+            std::islower(static_cast<unsigned char>(className[i - 1]))) {
+            guard += '_';
+        }
+        guard += static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+    }
+    return guard + "_H";
+}
+
+} // namespace
+
+ModelGenerator::ModelGenerator(const MemoryLoader& memory, const std::string& className)
+    : memory(memory), className(className) {
+    const Parameters& params = memory.getParams();
+    if (params.PIPELINED) {
+        throw SimulatorException("Generated models do not support PIPELINED programs");
+    }
+    decoded = HotstateModel::decodeProgram(memory.getSmdata(), params);
+    stateWords = std::max<uint32_t>(1, (params.NUM_STATES + 63) / 64);
+    numTimers = HotstateModel::timerCount(params);
+    lut = VardataImage(memory.getVardata(), params.NUM_VARS);
+    readsLut = std::any_of(decoded.begin(), decoded.end(),
+                           [&](const DecodedMicrocode& mc) { return !lut.isConstant(mc.varSel); });
+}
+
+std::string ModelGenerator::classNameFor(const std::string& filename) {
+    std::string stem = filename;
+    size_t slash = stem.find_last_of("/\\");
+    if (slash != std::string::npos) {
+        stem = stem.substr(slash + 1);
+    }
+    size_t dot = stem.find('.');
+    if (dot != std::string::npos) {
+        stem = stem.substr(0, dot);
+    }
+
+    std::string name;
+    bool upper = true;
+    for (char c : stem) {
+        if (!std::isalnum(static_cast<unsigned char>(c))) {
+            upper = true;
+            continue;
+        }
+        name += upper ? static_cast<char>(std::toupper(static_cast<unsigned char>(c))) : c;
+        upper = false;
+    }
+    if (name.empty() || std::isdigit(static_cast<unsigned char>(name[0]))) {
+        name = "Model" + name;
+    }
+    if (name.size() < 5 || name.compare(name.size() - 5, 5, "Model") != 0) {
+        name += "Model";
+    }
+    return name;
+}
+
+void ModelGenerator::generate(std::ostream& os) const {
+    std::string guard = guardFor(className);
+    writeHeader(os, guard);
+    writeReset(os);
+    writeClock(os);
+    os << "} // namespace hotstate_generated\n\n";
+    os << "#endif // " << guard << "\n";
+}
+
+void ModelGenerator::generateFile(const std::string& filename) const {
+    std::ofstream out(filename);
+    if (!out) {
+        throw SimulatorException("Cannot open model output file: " + filename);
+    }
+    generate(out);
+    out.close();
+    if (!out) {
+        throw SimulatorException("Failed writing model output file: " + filename);
+    }
+}
+
+void ModelGenerator::writeHeader(std::ostream& os, const std::string& guard) const {
+    const Parameters& params = memory.getParams();
+
+    os << "// Generated by hotstate_sim --emit-cpp; do not edit.\n"
+       << "//\n"
+       << "// Standalone model of one compiled program. It clocks like hotstate_sim:\n"
+       << "// every clock() call is one cycle, microcode runs on the rising edge\n"
+       << "// (every other call), and the model comes up held in reset.\n"
+       << "#ifndef " << guard << "\n"
+       << "#define " << guard << "\n\n"
+       << "#include <cstdint>\n"
+       << "#include <cstddef>\n"
+       << "#include <stdexcept>\n"
+       << "#include <string>\n\n"
+       << "namespace hotstate_generated {\n\n"
+       << "class " << className << " {\n"
+       << "public:\n"
+       << "    static constexpr uint32_t NUM_STATES = " << params.NUM_STATES << ";\n"
+       << "    static constexpr uint32_t NUM_VARS = " << params.NUM_VARS << ";\n"
+       << "    static constexpr uint32_t NUM_WORDS = " << params.NUM_WORDS << ";      // Addresses wrap here\n"
+       << "    static constexpr uint32_t PROGRAM_WORDS = " << decoded.size() << ";  // smdata words\n"
+       << "    static constexpr uint32_t STACK_DEPTH = " << params.STACK_DEPTH << ";\n"
+       << "    static constexpr uint32_t STATE_WORDS = " << stateWords << ";\n"
+       << "    static constexpr uint32_t NUM_TIMERS = " << numTimers << ";\n\n"
+       << "    " << className << "() { reset(); }\n\n"
+       << "    void reset();\n"
+       << "    void clock();\n"
+       << "    void setReset(bool value) { rst = value; }\n"
+       << "    void setHalt(bool value) { hlt = value; }\n\n"
+       << "    // Variables in input order; extra inputs are ignored\n"
+       << "    void setInputs(const uint8_t* inputs, size_t count) {\n"
+       << "        for (size_t i = 0; i < count && i < NUM_VARS; ++i) {\n"
+       << "            if (i < 64 && (inputs[i] != 0) != (variables[i] != 0)) {\n"
+       << "                inputBits ^= 1ULL << i;\n"
+       << "            }\n"
+       << "            variables[i] = inputs[i];\n"
+       << "        }\n"
+       << "    }\n\n"
+       << "    // Bit i of getStateWords()[i / 64] is state i\n"
+       << "    bool getState(uint32_t i) const { return (states[i >> 6] >> (i & 63)) & 1ULL; }\n"
+       << "    const uint64_t* getStateWords() const { return states; }\n"
+       << "    uint32_t getAddress() const { return address; }\n"
+       << "    bool isReady() const { return ready; }\n"
+       << "    bool getLhs() const { return lhs; }\n"
+       << "    bool getFired() const { return fired; }\n"
+       << "    uint32_t getTimerCount(uint32_t i) const { return timers[i]; }\n"
+       << "    uint64_t getCycleCount() const { return cycleCount; }\n\n"
+       << "private:\n"
+       << "    uint64_t states[STATE_WORDS] = {};\n"
+       << "    uint8_t variables[NUM_VARS > 0 ? NUM_VARS : 1] = {};\n"
+       << "    uint64_t inputBits = 0;  // variables, bit i for input i\n"
+       << "    uint32_t stack[STACK_DEPTH > 0 ? STACK_DEPTH : 1] = {};\n"
+       << "    uint32_t stackPointer = 0;\n"
+       << "    uint32_t timers[NUM_TIMERS > 0 ? NUM_TIMERS : 1] = {};\n"
+       << "    bool timerDone = false;\n"
+       << "    uint32_t address = 0;\n"
+       << "    uint64_t cycleCount = 0;\n"
+       << "    bool ready = false;\n"
+       << "    bool lhs = false;\n"
+       << "    bool fired = false;\n"
+       << "    bool clk = false;\n"
+       << "    bool rst = true;\n"
+       << "    bool hlt = false;\n";
+    if (readsLut) {
+        writeLookup(os);
+    }
+    os << "};\n\n";
+}
+
+// The vardata Uber LUT, bit-packed, as HotstateModel's VardataImage holds it
+void ModelGenerator::writeLookup(std::ostream& os) const {
+    const std::vector<uint64_t>& words = lut.getWords();
+    os << "\n"
+       << "    // variable.sv: lhs is bit {varSel, inputs} of the vardata LUT\n"
+       << "    static bool lookup(uint32_t varSel, uint64_t inputs) {\n"
+       << "        static const uint64_t bits[" << words.size() << "] = {";
+    for (size_t i = 0; i < words.size(); ++i) {
+        os << (i % 4 == 0 ? "\n            " : " ") << hexLiteral(words[i]) << ",";
+    }
+    os << "\n        };\n"
+       << "        uint64_t entry = (static_cast<uint64_t>(varSel) << NUM_VARS) | inputs;\n"
+       << "        return entry < " << lut.size() << "ULL && ((bits[entry >> 6] >> (entry & 63)) & 1);\n"
+       << "    }\n";
+}
+
+void ModelGenerator::writeReset(std::ostream& os) const {
+    const Parameters& params = memory.getParams();
+    const std::vector<uint32_t>& vardata = memory.getVardata();
+
+    os << "inline void " << className << "::reset() {\n"
+       << "    for (uint32_t w = 0; w < STATE_WORDS; ++w) {\n"
+       << "        states[w] = 0;\n"
+       << "    }\n";
+    // Like HotstateModel, variables without vardata keep their value
+    size_t initialized = std::min<size_t>(params.NUM_VARS, vardata.size());
+    for (size_t i = 0; i < initialized; ++i) {
+        os << "    variables[" << i << "] = " << (vardata[i] & 0xFF) << ";\n";
+    }
+    os << "    inputBits = 0;\n"
+       << "    for (uint32_t i = 0; i < NUM_VARS && i < 64; ++i) {\n"
+       << "        inputBits |= static_cast<uint64_t>(variables[i] != 0) << i;\n"
+       << "    }\n";
+    os << "    for (uint32_t i = 0; i < STACK_DEPTH; ++i) {\n"
+       << "        stack[i] = 0;\n"
+       << "    }\n"
+       << "    stackPointer = 0;\n"
+       << "    for (uint32_t i = 0; i < NUM_TIMERS; ++i) {\n"
+       << "        timers[i] = 0;\n"
+       << "    }\n"
+       << "    timerDone = false;\n"
+       << "    address = 0;\n"
+       << "    cycleCount = 0;\n"
+       << "    ready = false;\n"
+       << "    lhs = false;\n"
+       << "    fired = false;\n"
+       << "}\n\n";
+}
+
+void ModelGenerator::writeClock(std::ostream& os) const {
+    os << "inline void " << className << "::clock() {\n"
+       << "    if (hlt) {\n"
+       << "        return;\n"
+       << "    }\n"
+       << "    cycleCount++;\n"
+       << "    if (clk) {\n"
+       << "        clk = false;\n"
+       << "        return;\n"
+       << "    }\n"
+       << "    clk = true;\n"
+       << "    if (rst) {\n"
+       << "        reset();\n"
+       << "        return;\n"
+       << "    }\n\n"
+       << "    uint32_t next;\n"
+       << "    switch (address) {\n";
+    for (uint32_t address = 0; address < decoded.size(); ++address) {
+        writeWord(os, address);
+    }
+    os << "    default:\n"
+       << "        throw std::out_of_range(\"Address \" + std::to_string(address) +\n"
+       << "                                \" exceeds microcode memory size " << decoded.size() << "\");\n"
+       << "    }\n"
+       << "    address = next;\n"
+       << "    ready = true;\n"
+       << "}\n\n";
+}
+
+// One rising edge of HotstateModel::executeEdge with this word's fields as
+// constants. The interpreter never raises switchActive, so switches fold away.
+void ModelGenerator::writeWord(std::ostream& os, uint32_t address) const {
+    const Parameters& params = memory.getParams();
+    const DecodedMicrocode& mc = decoded[address];
+    auto wrap = [&](uint32_t target) { return target < params.NUM_WORDS ? target : 0; };
+
+    os << "    case " << address << ":\n";
+    if (mc.sub) {
+        // Before any register changes, as HotstateModel checks it
+        os << "        if (stackPointer >= STACK_DEPTH) {\n"
+           << "            throw std::overflow_error(\"Call at address " << address << " overflows the stack\");\n"
+           << "        }\n";
+    }
+    if (mc.stateCapture) {
+        const std::vector<uint64_t>& value = mc.stateValue.getWords();
+        const std::vector<uint64_t>& mask = mc.transitionValue.getWords();
+        for (size_t w = 0; w < mask.size(); ++w) {
+            if (mask[w] == 0) {
+                continue;
+            }
+            os << "        states[" << w << "] = (states[" << w << "] & ~" << hexLiteral(mask[w])
+               << ") | " << hexLiteral(value[w] & mask[w]) << ";\n";
+        }
+    }
+
+    // Timers, as in HotstateModel::clockTimers, with the reload value folded in
+    uint32_t selected = numTimers < 32 ? mc.timerSel & ((1u << numTimers) - 1) : mc.timerSel;
+    if (selected != 0) {
+        uint32_t loadValue = HotstateModel::timerLoadValue(mc.jadr, memory.getTimdata(), params);
+        os << "        timerDone = false;\n";
+        for (uint32_t i = 0; i < numTimers; ++i) {
+            if (((selected >> i) & 1) == 0) {
+                continue;
+            }
+            if ((mc.timerLd >> i) & 1) {
+                os << "        timers[" << i << "] = " << loadValue << "u;\n";
+            } else {
+                os << "        if (timers[" << i << "] == 0) {\n"
+                   << "            timerDone = true;\n"
+                   << "        } else {\n"
+                   << "            timers[" << i << "]--;\n"
+                   << "        }\n";
+            }
+        }
+    } else if (numTimers > 0) {
+        os << "        timerDone = false;\n";
+    }
+
+    // A LUT block that reads the same for every input vector folds to a constant
+    bool constantLhs = lut.isConstant(mc.varSel);
+    bool lhsValue = lut.witness(mc.varSel, true) >= 0;
+    if (constantLhs) {
+        os << "        lhs = " << (lhsValue ? "true" : "false") << ";\n";
+    } else {
+        os << "        lhs = lookup(" << mc.varSel << ", inputBits);\n";
+    }
+
+    uint32_t sequential = wrap(address + 1);
+    uint32_t jump = wrap(mc.jadr);
+    if (mc.forcedJmp || mc.rtn) {
+        os << "        fired = true;\n";
+        if (mc.rtn) {
+            os << "        next = stackPointer > 0 ? stack[--stackPointer] : " << jump << ";\n"
+               << "        if (next >= NUM_WORDS) {\n"
+               << "            next = 0;\n"
+               << "        }\n";
+        } else {
+            os << "        next = " << jump << ";\n";
+        }
+    } else if (mc.branch && mc.varOrTimer && selected != 0) {
+        // Taken until a selected timer is done
+        os << "        fired = !timerDone;\n"
+           << "        next = timerDone ? " << sequential << " : " << jump << ";\n";
+    } else if (mc.branch && (mc.varOrTimer || (constantLhs && lhsValue))) {
+        os << "        fired = true;\n"
+           << "        next = " << jump << ";\n";
+    } else if (mc.branch && constantLhs) {
+        os << "        fired = false;\n"
+           << "        next = " << sequential << ";\n";
+    } else if (mc.branch) {
+        os << "        fired = lhs;\n"
+           << "        next = lhs ? " << jump << " : " << sequential << ";\n";
+    } else {
+        os << "        fired = false;\n"
+           << "        next = " << sequential << ";\n";
+    }
+
+    if (mc.sub) {
+        os << "        stack[stackPointer++] = " << (address + 1) << ";\n";
+    }
+    os << "        break;\n";
+}
+
+} // namespace HotstateSim
@@ -1,108 +1,272 @@
 #include "output_logger.h"
 #include "utils.h"
+#include "async_trace_writer.h"
+#include "export_writer.h"
+#include "trace_format.h"
 #include <iostream>
 #include <iomanip>
-#include <sstream>
 #include <algorithm>
 #include <numeric>
-#include <bitset>
 
 namespace HotstateSim {
 
+void LogRing::setCapacity(uint32_t entries) {
+    capacity = entries;
+    if (capacity > 0 && records.size() > capacity) {
+        relayout(capacity, stateStride, outputStride, inputStride);
+    }
+}
+
+void LogRing::clear() {
+    head = 0;
+    count = 0;
+}
+
+void LogRing::relayout(size_t slots, size_t states, size_t outputs, size_t inputs) {
+    size_t keep = std::min(count, slots);
+    size_t first = count - keep;
+    
+    std::vector<LogRecord> newRecords(slots);
+    std::vector<uint64_t> newStates(slots * states, 0);
+    std::vector<uint8_t> newOutputs(slots * outputs, 0);
+    std::vector<uint8_t> newInputs(slots * inputs, 0);
+    
+    for (size_t k = 0; k < keep; ++k) {
+        size_t from = slot(first + k);
+        newRecords[k] = records[from];
+        std::copy_n(stateWords.begin() + from * stateStride, stateStride, newStates.begin() + k * states);
+        std::copy_n(outputBytes.begin() + from * outputStride, outputStride, newOutputs.begin() + k * outputs);
+        std::copy_n(inputBytes.begin() + from * inputStride, inputStride, newInputs.begin() + k * inputs);
+    }
+    
+    records.swap(newRecords);
+    stateWords.swap(newStates);
+    outputBytes.swap(newOutputs);
+    inputBytes.swap(newInputs);
+    stateStride = states;
+    outputStride = outputs;
+    inputStride = inputs;
+    head = 0;
+    count = keep;
+}
+
+LogSlot LogRing::append(size_t stateWordCount, size_t numOutputs, size_t numInputs) {
+    // A wider entry than any before widens every slot; rare after the first append
+    if (stateWordCount > stateStride || numOutputs > outputStride || numInputs > inputStride) {
+        relayout(records.size(), std::max(stateStride, stateWordCount),
+                 std::max(outputStride, numOutputs), std::max(inputStride, numInputs));
+    }
+    
+    size_t pos;
+    if (count < records.size()) {
+        pos = slot(count);
+        count++;
+    } else if (capacity == 0 || records.size() < capacity) {
+        // Not yet wrapped, so the entries are already in slots [0, count)
+        size_t slots = std::max<size_t>(64, records.size() * 2);
+        if (capacity > 0) {
+            slots = std::min<size_t>(slots, capacity);
+        }
+        relayout(slots, stateStride, outputStride, inputStride);
+        pos = count++;
+    } else {
+        pos = head;
+        head = (head + 1) % records.size();
+    }
+    
+    // Zero the whole slot so unused tails compare equal word for word
+    uint64_t* stateSlot = stateWords.data() + pos * stateStride;
+    uint8_t* outputSlot = outputBytes.data() + pos * outputStride;
+    uint8_t* inputSlot = inputBytes.data() + pos * inputStride;
+    std::fill(stateSlot, stateSlot + stateStride, 0);
+    std::fill(outputSlot, outputSlot + outputStride, 0);
+    std::fill(inputSlot, inputSlot + inputStride, 0);
+    
+    return {records[pos], stateSlot, outputSlot, inputSlot};
+}
+
+void LogRing::push(const LogEntry& entry) {
+    const std::vector<uint64_t>& words = entry.states.getWords();
+    LogSlot slot = append(words.size(), entry.outputs.size(), entry.inputs.size());
+    
+    LogRecord& rec = slot.record;
+    rec.cycle = entry.cycle;
+    rec.address = entry.address;
+    rec.numStates = entry.states.size();
+    rec.numOutputs = static_cast<uint32_t>(entry.outputs.size());
+    rec.numInputs = static_cast<uint32_t>(entry.inputs.size());
+    rec.ready = entry.ready;
+    rec.lhs = entry.lhs;
+    rec.fired = entry.fired;
+    rec.jmpadr = entry.jmpadr;
+    rec.switchActive = entry.switchActive;
+    
+    std::copy(words.begin(), words.end(), slot.states);
+    std::copy(entry.outputs.begin(), entry.outputs.end(), slot.outputs);
+    std::copy(entry.inputs.begin(), entry.inputs.end(), slot.inputs);
+}
+
+uint32_t LogRing::activeStates(size_t index) const {
+    const uint64_t* words = states(index);
+    uint32_t total = 0;
+    for (size_t w = 0; w < stateStride; ++w) {
+        total += __builtin_popcountll(words[w]);
+    }
+    return total;
+}
+
+bool LogRing::sameStates(size_t a, size_t b) const {
+    return record(a).numStates == record(b).numStates &&
+           std::equal(states(a), states(a) + stateStride, states(b));
+}
+
+LogEntry LogRing::entry(size_t index) const {
+    const LogRecord& rec = record(index);
+    LogEntry result;
+    result.cycle = rec.cycle;
+    result.address = rec.address;
+    result.states = StateBits(states(index), rec.numStates);
+    result.outputs.assign(outputs(index), outputs(index) + rec.numOutputs);
+    result.inputs.assign(inputs(index), inputs(index) + rec.numInputs);
+    result.ready = rec.ready;
+    result.lhs = rec.lhs;
+    result.fired = rec.fired;
+    result.jmpadr = rec.jmpadr;
+    result.switchActive = rec.switchActive;
+    return result;
+}
+
 OutputLogger::OutputLogger()
     : format(OutputFormat::CONSOLE)
     , filename("")
     , fileOpen(false)
     , realTime(true)
     , maxLogEntries(10000)
+    , asyncOutput(false)
     , vcdHeaderWritten(false)
+    , vcdLastCycle(0)
+    , vcdCycleWritten(false)
 {
+    logRing.setCapacity(maxLogEntries);
 }
 
 OutputLogger::~OutputLogger() {
     closeFile();
 }
 
-void OutputLogger::logCycle(uint32_t cycle, const HotstateModel& model, const std::vector<uint8_t>& inputs) {
-    LogEntry entry;
-    entry.cycle = cycle;
-    entry.address = model.getCurrentAddress();
-    entry.states = model.getStates();
-    entry.outputs = model.getOutputs();
-    entry.inputs = inputs;
-    entry.ready = model.isReady();
-    entry.lhs = model.getLhs();
-    entry.fired = model.getFired();
-    entry.jmpadr = model.getJmpadr();
-    entry.switchActive = model.getSwitchActive();
+void OutputLogger::logCycle(uint64_t cycle, const HotstateModel& model, const std::vector<uint8_t>& inputs) {
+    const StateBits& states = model.getStates();
+    const std::vector<uint64_t>& words = states.getWords();
+    LogSlot slot = logRing.append(words.size(), model.getNumOutputs(), inputs.size());
+    
+    LogRecord& rec = slot.record;
+    rec.cycle = cycle;
+    rec.address = model.getCurrentAddress();
+    rec.numStates = states.size();
+    rec.numOutputs = model.getNumOutputs();
+    rec.numInputs = static_cast<uint32_t>(inputs.size());
+    rec.ready = model.isReady();
+    rec.lhs = model.getLhs();
+    rec.fired = model.getFired();
+    rec.jmpadr = model.getJmpadr();
+    rec.switchActive = model.getSwitchActive();
+    
+    std::copy(words.begin(), words.end(), slot.states);
+    model.copyOutputs(slot.outputs);
+    std::copy(inputs.begin(), inputs.end(), slot.inputs);
+    
+    indexNewestEntry();
+    dispatchEntry(logRing.view(logRing.size() - 1));
+}
+
+void OutputLogger::logRecord(const LogRecord& record, const uint64_t* states, const uint8_t* outputs, const uint8_t* inputs) {
+    size_t stateWordCount = (record.numStates + 63) / 64;
+    LogSlot slot = logRing.append(stateWordCount, record.numOutputs, record.numInputs);
+    
+    slot.record = record;
+    std::copy_n(states, stateWordCount, slot.states);
+    std::copy_n(outputs, record.numOutputs, slot.outputs);
+    std::copy_n(inputs, record.numInputs, slot.inputs);
     
-    logEntry(entry, model);
+    indexNewestEntry();
+    dispatchEntry(logRing.view(logRing.size() - 1));
 }
 
 void OutputLogger::logEntry(const LogEntry& entry, const HotstateModel& model) {
-    // Add to log entries
-    logEntries.push_back(entry);
-    
-    // Limit log size if needed
-    if (maxLogEntries > 0 && logEntries.size() > maxLogEntries) {
-        logEntries.erase(logEntries.begin());
+    (void)model;
+    logEntry(entry);
+}
+
+void OutputLogger::logEntry(const LogEntry& entry) {
+    // Add to the trace window, replacing the oldest entry once it is full
+    logRing.push(entry);
+    indexNewestEntry();
+    dispatchEntry(logRing.view(logRing.size() - 1));
+}
+
+void OutputLogger::dispatchEntry(const LogView& entry) {
+    if (asyncWriter) {
+        asyncWriter->push(entry);
+    } else {
+        writeEntry(entry);
     }
-    
+}
+
+void OutputLogger::writeEntry(const LogView& entry) {
     // Write output based on format
     switch (format) {
         case OutputFormat::CONSOLE:
             if (realTime) {
-                writeConsoleEntry(entry, model);
+                writeConsoleEntry(entry);
             }
             break;
         case OutputFormat::VCD:
             if (fileOpen) {
-                writeVCDEntry(entry, model);
+                writeVCDEntry(entry);
             }
             break;
         case OutputFormat::CSV:
             if (fileOpen) {
-                writeCSVEntry(entry, model);
+                writeCSVEntry(entry);
             }
             break;
         case OutputFormat::JSON:
             if (fileOpen) {
-                writeJSONEntry(entry, model);
+                writeJSONEntry(entry);
+            }
+            break;
+        case OutputFormat::TRACE:
+            if (traceWriter) {
+                traceWriter->append(entry);
             }
             break;
     }
-}
-
-void OutputLogger::logEntry(const LogEntry& entry) {
-    logEntries.push_back(entry);
-    
-    // Limit log size if needed
-    if (maxLogEntries > 0 && logEntries.size() > maxLogEntries) {
-        logEntries.erase(logEntries.begin());
+    if (exportWriter) {
+        exportWriter->append(entry);
     }
 }
 
-void OutputLogger::writeConsoleEntry(const LogEntry& entry, const HotstateModel& model) {
-    std::cout << "Cycle: " << std::setw(6) << entry.cycle 
-              << ", Addr: 0x" << std::hex << std::setw(4) << entry.address << std::dec
-              << ", Ready: " << (entry.ready ? "1" : "0")
-              << ", LHS: " << (entry.lhs ? "1" : "0")
-              << ", Fired: " << (entry.fired ? "1" : "0")
+void OutputLogger::writeConsoleEntry(const LogView& entry) {
+    std::cout << "Cycle: " << std::setw(6) << entry.record.cycle 
+              << ", Addr: 0x" << std::hex << std::setw(4) << entry.record.address << std::dec
+              << ", Ready: " << (entry.record.ready ? "1" : "0")
+              << ", LHS: " << (entry.record.lhs ? "1" : "0")
+              << ", Fired: " << (entry.record.fired ? "1" : "0")
               << ", States: ";
     
-    for (size_t i = 0; i < entry.states.size(); ++i) {
-        std::cout << entry.states[i];
+    for (size_t i = 0; i < entry.record.numStates; ++i) {
+        std::cout << entry.state(i);
     }
     
     std::cout << ", Outputs: [";
-    for (size_t i = 0; i < entry.outputs.size(); ++i) {
+    for (size_t i = 0; i < entry.record.numOutputs; ++i) {
         if (i > 0) std::cout << ", ";
         std::cout << "0x" << std::hex << static_cast<uint32_t>(entry.outputs[i]) << std::dec;
     }
     
-    if (!entry.inputs.empty()) {
+    if (entry.record.numInputs > 0) {
         std::cout << "], Inputs: [";
-        for (size_t i = 0; i < entry.inputs.size(); ++i) {
+        for (size_t i = 0; i < entry.record.numInputs; ++i) {
             if (i > 0) std::cout << ", ";
             std::cout << "0x" << std::hex << static_cast<uint32_t>(entry.inputs[i]) << std::dec;
         }
@@ -111,137 +275,164 @@ void OutputLogger::writeConsoleEntry(const LogEntry& entry, const HotstateModel&
     std::cout << "]" << std::endl;
 }
 
-void OutputLogger::writeVCDEntry(const LogEntry& entry, const HotstateModel& model) {
+void OutputLogger::writeVCDEntry(const LogView& entry) {
+    const LogRecord& rec = entry.record;
     if (!vcdHeaderWritten) {
-        writeVCDHeader(model);
+        writeVCDHeader(rec.numStates);
         vcdHeaderWritten = true;
     }
     
-    // Write time
-    writeVCDTime(entry.cycle);
+    // Collect this cycle's changes
+    vcdBuffer.clear();
+    for (uint32_t i = 0; i < rec.numStates; ++i) {
+        appendVCDBit(i, entry.state(i));
+    }
+    appendVCDByte(rec.numStates, rec.address & 0xFF);
+    
+    uint32_t control = rec.numStates + 1;
+    appendVCDBit(control, rec.ready);
+    appendVCDBit(control + 1, rec.lhs);
+    appendVCDBit(control + 2, rec.fired);
+    appendVCDBit(control + 3, rec.jmpadr);
+    appendVCDBit(control + 4, rec.switchActive);
     
-    // Write signal changes
-    for (size_t i = 0; i < entry.states.size(); ++i) {
-        writeVCDValueChange(vcdSignalCodes[i], boolToVCDString(entry.states[i]));
+    // Cycles where nothing changed get no timestamp at all
+    vcdLastCycle = rec.cycle;
+    vcdCycleWritten = !vcdBuffer.empty();
+    if (vcdCycleWritten) {
+        file << '#' << rec.cycle << '\n';
+        file.write(vcdBuffer.data(), static_cast<std::streamsize>(vcdBuffer.size()));
     }
+}
+
+void OutputLogger::appendVCDBit(uint32_t signal, bool value) {
+    if (vcdPrevious[signal] == value) return;
+    vcdPrevious[signal] = value;
     
-    // Write address
-    writeVCDValueChange(vcdSignalCodes[entry.states.size()], uint8ToVCDString(entry.address & 0xFF));
+    const std::string& code = vcdSignalCodes[signal];
+    vcdBuffer.push_back(value ? '1' : '0');
+    vcdBuffer.insert(vcdBuffer.end(), code.begin(), code.end());
+}
+
+void OutputLogger::appendVCDByte(uint32_t signal, uint8_t value) {
+    if (vcdPrevious[signal] == value) return;
+    vcdPrevious[signal] = value;
     
-    // Write control signals
-    size_t controlOffset = entry.states.size() + 1;
-    writeVCDValueChange(vcdSignalCodes[controlOffset], boolToVCDString(entry.ready));
-    writeVCDValueChange(vcdSignalCodes[controlOffset + 1], boolToVCDString(entry.lhs));
-    writeVCDValueChange(vcdSignalCodes[controlOffset + 2], boolToVCDString(entry.fired));
+    // "b" + 8 bits + " " + code
+    vcdBuffer.push_back('b');
+    for (int bit = 7; bit >= 0; --bit) {
+        vcdBuffer.push_back((value >> bit) & 1 ? '1' : '0');
+    }
+    vcdBuffer.push_back(' ');
+    const std::string& code = vcdSignalCodes[signal];
+    vcdBuffer.insert(vcdBuffer.end(), code.begin(), code.end());
+}
+
+// Timestamp the last cycle so viewers show the full run, even when it
+// ended with a stretch of unchanged cycles
+void OutputLogger::writeVCDEnd() {
+    if (vcdHeaderWritten && !vcdCycleWritten) {
+        file << '#' << vcdLastCycle << '\n';
+        vcdCycleWritten = true;
+    }
 }
 
-void OutputLogger::writeCSVEntry(const LogEntry& entry, const HotstateModel& model) {
-    file << entry.cycle << "," << entry.address << "," << (entry.ready ? "1" : "0") 
-         << "," << (entry.lhs ? "1" : "0") << "," << (entry.fired ? "1" : "0");
+void OutputLogger::writeCSVEntry(const LogView& entry) {
+    file << entry.record.cycle << "," << entry.record.address << "," << (entry.record.ready ? "1" : "0") 
+         << "," << (entry.record.lhs ? "1" : "0") << "," << (entry.record.fired ? "1" : "0");
     
     // Write states
-    for (bool state : entry.states) {
-        file << "," << (state ? "1" : "0");
+    for (uint32_t i = 0; i < entry.record.numStates; ++i) {
+        file << "," << (entry.state(i) ? "1" : "0");
     }
     
     // Write outputs
-    for (uint8_t output : entry.outputs) {
-        file << ",0x" << std::hex << static_cast<uint32_t>(output) << std::dec;
+    for (uint32_t i = 0; i < entry.record.numOutputs; ++i) {
+        file << ",0x" << std::hex << static_cast<uint32_t>(entry.outputs[i]) << std::dec;
     }
     
     // Write inputs
-    for (uint8_t input : entry.inputs) {
-        file << ",0x" << std::hex << static_cast<uint32_t>(input) << std::dec;
+    for (uint32_t i = 0; i < entry.record.numInputs; ++i) {
+        file << ",0x" << std::hex << static_cast<uint32_t>(entry.inputs[i]) << std::dec;
     }
     
-    file << std::endl;
+    file << '\n';
 }
 
-void OutputLogger::writeJSONEntry(const LogEntry& entry, const HotstateModel& model) {
-    file << "{" << std::endl;
-    file << "  \"cycle\": " << entry.cycle << "," << std::endl;
-    file << "  \"address\": " << entry.address << "," << std::endl;
-    file << "  \"ready\": " << (entry.ready ? "true" : "false") << "," << std::endl;
-    file << "  \"lhs\": " << (entry.lhs ? "true" : "false") << "," << std::endl;
-    file << "  \"fired\": " << (entry.fired ? "true" : "false") << "," << std::endl;
+void OutputLogger::writeJSONEntry(const LogView& entry) {
+    file << "{" << '\n';
+    file << "  \"cycle\": " << entry.record.cycle << "," << '\n';
+    file << "  \"address\": " << entry.record.address << "," << '\n';
+    file << "  \"ready\": " << (entry.record.ready ? "true" : "false") << "," << '\n';
+    file << "  \"lhs\": " << (entry.record.lhs ? "true" : "false") << "," << '\n';
+    file << "  \"fired\": " << (entry.record.fired ? "true" : "false") << "," << '\n';
     
     // Write states
     file << "  \"states\": [";
-    for (size_t i = 0; i < entry.states.size(); ++i) {
+    for (size_t i = 0; i < entry.record.numStates; ++i) {
         if (i > 0) file << ", ";
-        file << (entry.states[i] ? "true" : "false");
+        file << (entry.state(i) ? "true" : "false");
     }
-    file << "]," << std::endl;
+    file << "]," << '\n';
     
     // Write outputs
     file << "  \"outputs\": [";
-    for (size_t i = 0; i < entry.outputs.size(); ++i) {
+    for (size_t i = 0; i < entry.record.numOutputs; ++i) {
         if (i > 0) file << ", ";
         file << static_cast<uint32_t>(entry.outputs[i]);
     }
-    file << "]," << std::endl;
+    file << "]," << '\n';
     
     // Write inputs
     file << "  \"inputs\": [";
-    for (size_t i = 0; i < entry.inputs.size(); ++i) {
+    for (size_t i = 0; i < entry.record.numInputs; ++i) {
         if (i > 0) file << ", ";
         file << static_cast<uint32_t>(entry.inputs[i]);
     }
-    file << "]" << std::endl;
+    file << "]" << '\n';
     
-    file << "}" << std::endl;
+    file << "}" << '\n';
 }
 
-void OutputLogger::writeVCDHeader(const HotstateModel& model) {
-    file << "$timescale 1ns $end" << std::endl;
-    file << "$scope module hotstate $end" << std::endl;
+void OutputLogger::writeVCDHeader(uint32_t numStates) {
+    file << "$timescale 1ns $end" << '\n';
+    file << "$scope module hotstate $end" << '\n';
     
-    // Generate signal names and codes
-    vcdSignalNames.clear();
+    // Generate signal codes once; every later line reuses them
     vcdSignalCodes.clear();
     
     // Add state signals
-    for (size_t i = 0; i < model.getStates().size(); ++i) {
-        std::string name = "state[" + std::to_string(i) + "]";
-        std::string code = generateVCDCode(i);
-        vcdSignalNames.push_back(name);
-        vcdSignalCodes.push_back(code);
-        file << "$var wire 1 " << code << " " << name << " $end" << std::endl;
+    for (size_t i = 0; i < numStates; ++i) {
+        std::string code = generateVCDCode(vcdSignalCodes.size());
+        vcdSignalCodes.push_back(code + '\n');
+        file << "$var wire 1 " << code << " state[" << i << "] $end" << '\n';
     }
     
     // Add address signal
-    std::string addrCode = generateVCDCode(vcdSignalNames.size());
-    vcdSignalNames.push_back("address");
-    vcdSignalCodes.push_back(addrCode);
-    file << "$var wire 8 " << addrCode << " address $end" << std::endl;
+    std::string addrCode = generateVCDCode(vcdSignalCodes.size());
+    vcdSignalCodes.push_back(addrCode + '\n');
+    file << "$var wire 8 " << addrCode << " address $end" << '\n';
     
     // Add control signals
-    std::vector<std::string> controlNames = {"ready", "lhs", "fired", "jmpadr", "switch_active"};
-    for (const std::string& name : controlNames) {
-        std::string code = generateVCDCode(vcdSignalNames.size());
-        vcdSignalNames.push_back(name);
-        vcdSignalCodes.push_back(code);
-        file << "$var wire 1 " << code << " " << name << " $end" << std::endl;
+    static const char* const controlNames[VCD_CONTROL_SIGNALS] = {"ready", "lhs", "fired", "jmpadr", "switch_active"};
+    for (const char* name : controlNames) {
+        std::string code = generateVCDCode(vcdSignalCodes.size());
+        vcdSignalCodes.push_back(code + '\n');
+        file << "$var wire 1 " << code << " " << name << " $end" << '\n';
     }
     
-    file << "$upscope $end" << std::endl;
-    file << "$enddefinitions $end" << std::endl;
-    file << "$dumpvars" << std::endl;
+    file << "$upscope $end" << '\n';
+    file << "$enddefinitions $end" << '\n';
+    file << "$dumpvars" << '\n';
     
-    // Write initial values
+    // Write initial values; later cycles only write what differs from these
     for (size_t i = 0; i < vcdSignalCodes.size(); ++i) {
-        writeVCDValueChange(vcdSignalCodes[i], "0");
+        file << '0' << vcdSignalCodes[i];
     }
+    vcdPrevious.assign(vcdSignalCodes.size(), 0);
+    vcdCycleWritten = true;
     
-    file << "$end" << std::endl;
-}
-
-void OutputLogger::writeVCDValueChange(const std::string& code, const std::string& value) {
-    file << value << code << std::endl;
-}
-
-void OutputLogger::writeVCDTime(uint64_t time) {
-    file << "#" << time << std::endl;
+    file << "$end" << '\n';
 }
 
 std::string OutputLogger::generateVCDCode(uint32_t index) {
@@ -258,22 +449,14 @@ std::string OutputLogger::generateVCDCode(uint32_t index) {
     return code;
 }
 
-std::string OutputLogger::boolToVCDString(bool value) {
-    return value ? "1" : "0";
-}
-
-std::string OutputLogger::uint8ToVCDString(uint8_t value) {
-    std::stringstream ss;
-    ss << "b" << std::bitset<8>(value) << " ";
-    return ss.str();
-}
-
 bool OutputLogger::openFile() {
     if (filename.empty()) {
         return false;
     }
     
-    file.open(filename);
+    fileBuffer.resize(FILE_BUFFER_SIZE);
+    file.rdbuf()->pubsetbuf(fileBuffer.data(), fileBuffer.size());
+    file.open(filename, format == OutputFormat::TRACE ? std::ios::out | std::ios::binary : std::ios::out);
     if (!file.is_open()) {
         std::cerr << "Failed to open output file: " << filename << std::endl;
         return false;
@@ -281,6 +464,9 @@ bool OutputLogger::openFile() {
     
     fileOpen = true;
     vcdHeaderWritten = false;
+    if (format == OutputFormat::TRACE) {
+        traceWriter = std::make_unique<TraceWriter>(file);
+    }
     
     // Write header for CSV and JSON formats
     if (format == OutputFormat::CSV) {
@@ -297,18 +483,29 @@ bool OutputLogger::openFile() {
         for (size_t i = 0; i < 8; ++i) { // Assume max 8 inputs for header
             file << ",Input" << i;
         }
-        file << std::endl;
+        file << '\n';
     } else if (format == OutputFormat::JSON) {
-        file << "[" << std::endl;
+        file << "[" << '\n';
+    }
+    
+    if (asyncOutput) {
+        asyncWriter = std::make_unique<AsyncTraceWriter>([this](const LogView& entry) { writeEntry(entry); });
     }
     
     return true;
 }
 
 void OutputLogger::closeFile() {
+    asyncWriter.reset();  // Writes out everything still queued
+    finishExport();
     if (fileOpen) {
-        if (format == OutputFormat::JSON && !logEntries.empty()) {
-            file << "]" << std::endl;
+        if (format == OutputFormat::JSON && !logRing.empty()) {
+            file << "]" << '\n';
+        } else if (format == OutputFormat::VCD) {
+            writeVCDEnd();
+        } else if (traceWriter) {
+            traceWriter->finish();
+            traceWriter.reset();
         }
         file.close();
         fileOpen = false;
@@ -316,18 +513,32 @@ void OutputLogger::closeFile() {
 }
 
 void OutputLogger::flush() {
+    if (asyncWriter) {
+        asyncWriter->drain();
+    }
     if (fileOpen) {
         file.flush();
     }
 }
 
 void OutputLogger::clear() {
-    logEntries.clear();
+    if (asyncWriter) {
+        asyncWriter->drain();
+    }
+    logRing.clear();
+    stateTransitionCycles.clear();
+    addressTransitionCycles.clear();
     vcdHeaderWritten = false;
+    if (traceWriter) {
+        traceWriter->restart();
+    }
+    if (exportWriter) {
+        exportWriter->restart();
+    }
 }
 
 void OutputLogger::printStatistics() const {
-    if (logEntries.empty()) {
+    if (logRing.empty()) {
         std::cout << "No log entries to analyze" << std::endl;
         return;
     }
@@ -338,26 +549,22 @@ void OutputLogger::printStatistics() const {
     std::cout << "Average state activity: " << std::fixed << std::setprecision(2) 
               << (getAverageStateActivity() * 100) << "%" << std::endl;
     
-    // Count state transitions
-    auto transitions = getStateTransitionCycles();
-    std::cout << "State transitions: " << transitions.size() << std::endl;
-    
-    // Count address changes
-    auto addrChanges = getAddressTransitions();
-    std::cout << "Address changes: " << addrChanges.size() << std::endl;
+    std::cout << "State transitions: " << getStateTransitionCount() << std::endl;
+    std::cout << "Address changes: " << getAddressTransitionCount() << std::endl;
     
     std::cout << "=============================" << std::endl;
 }
 
-uint32_t OutputLogger::getTotalCycles() const {
-    if (logEntries.empty()) return 0;
-    return logEntries.back().cycle + 1;
+uint64_t OutputLogger::getTotalCycles() const {
+    if (logRing.empty()) return 0;
+    return logRing.record(logRing.size() - 1).cycle + 1;
 }
 
-uint32_t OutputLogger::getActiveCycles() const {
-    uint32_t count = 0;
-    for (const auto& entry : logEntries) {
-        if (entry.ready || entry.fired) {
+uint64_t OutputLogger::getActiveCycles() const {
+    uint64_t count = 0;
+    for (size_t i = 0; i < logRing.size(); ++i) {
+        const LogRecord& rec = logRing.record(i);
+        if (rec.ready || rec.fired) {
             count++;
         }
     }
@@ -365,46 +572,90 @@ uint32_t OutputLogger::getActiveCycles() const {
 }
 
 double OutputLogger::getAverageStateActivity() const {
-    if (logEntries.empty()) return 0.0;
+    if (logRing.empty()) return 0.0;
     
     double totalActivity = 0.0;
-    for (const auto& entry : logEntries) {
-        uint32_t activeStates = 0;
-        for (bool state : entry.states) {
-            if (state) activeStates++;
-        }
-        totalActivity += static_cast<double>(activeStates) / entry.states.size();
+    for (size_t i = 0; i < logRing.size(); ++i) {
+        uint32_t activeStates = logRing.activeStates(i);
+        totalActivity += static_cast<double>(activeStates) / logRing.record(i).numStates;
     }
     
-    return totalActivity / logEntries.size();
+    return totalActivity / logRing.size();
 }
 
-std::vector<uint32_t> OutputLogger::getStateTransitionCycles() const {
-    std::vector<uint32_t> transitions;
-    
-    if (logEntries.size() < 2) return transitions;
-    
-    for (size_t i = 1; i < logEntries.size(); ++i) {
-        if (logEntries[i].states != logEntries[i-1].states) {
-            transitions.push_back(logEntries[i].cycle);
+void OutputLogger::indexNewestEntry() {
+    size_t newest = logRing.size() - 1;
+    if (newest > 0) {
+        uint64_t cycle = logRing.record(newest).cycle;
+        if (!logRing.sameStates(newest, newest - 1)) {
+            stateTransitionCycles.push_back(cycle);
+        }
+        if (logRing.record(newest).address != logRing.record(newest - 1).address) {
+            addressTransitionCycles.push_back(cycle);
         }
     }
-    
-    return transitions;
+    trimIndexes();
 }
 
-std::vector<uint32_t> OutputLogger::getAddressTransitions() const {
-    std::vector<uint32_t> transitions;
-    
-    if (logEntries.size() < 2) return transitions;
-    
-    for (size_t i = 1; i < logEntries.size(); ++i) {
-        if (logEntries[i].address != logEntries[i-1].address) {
-            transitions.push_back(logEntries[i].cycle);
+void OutputLogger::trimIndexes() {
+    // A transition into the oldest buffered entry is from one that was overwritten
+    uint64_t oldest = logRing.empty() ? UINT64_MAX : logRing.record(0).cycle;
+    while (!stateTransitionCycles.empty() && stateTransitionCycles.front() <= oldest) {
+        stateTransitionCycles.pop_front();
+    }
+    while (!addressTransitionCycles.empty() && addressTransitionCycles.front() <= oldest) {
+        addressTransitionCycles.pop_front();
+    }
+}
+
+size_t OutputLogger::findCycle(uint64_t cycle) const {
+    size_t count = logRing.size();
+    if (count == 0) {
+        return 0;
+    }
+    uint64_t first = logRing.record(0).cycle;
+    if (cycle <= first) {
+        return 0;
+    }
+    // Every cycle logged: the entry's index is its offset
+    if (logRing.record(count - 1).cycle - first == count - 1) {
+        return static_cast<size_t>(std::min<uint64_t>(cycle - first, count));
+    }
+    size_t low = 0, high = count;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (logRing.record(mid).cycle < cycle) {
+            low = mid + 1;
+        } else {
+            high = mid;
         }
     }
-    
-    return transitions;
+    return low;
+}
+
+std::vector<LogEntry> OutputLogger::getEntriesInRange(uint64_t startCycle, uint64_t endCycle) const {
+    std::vector<LogEntry> entries;
+    for (size_t i = findCycle(startCycle); i < logRing.size() && logRing.record(i).cycle <= endCycle; ++i) {
+        entries.push_back(logRing.entry(i));
+    }
+    return entries;
+}
+
+LogEntry OutputLogger::getEntryAtCycle(uint64_t cycle) const {
+    // Cycles skipped by fast-forward kept the state of the entry before them
+    size_t index = findCycle(cycle);
+    if (index < logRing.size() && logRing.record(index).cycle == cycle) {
+        return logRing.entry(index);
+    }
+    return index > 0 ? logRing.entry(index - 1) : LogEntry();
+}
+
+std::vector<uint64_t> OutputLogger::getStateTransitionCycles() const {
+    return std::vector<uint64_t>(stateTransitionCycles.begin(), stateTransitionCycles.end());
+}
+
+std::vector<uint64_t> OutputLogger::getAddressTransitions() const {
+    return std::vector<uint64_t>(addressTransitionCycles.begin(), addressTransitionCycles.end());
 }
 
 std::unique_ptr<OutputLogger> OutputLogger::createConsoleLogger() {
@@ -438,107 +689,69 @@ std::unique_ptr<OutputLogger> OutputLogger::createJSONLogger(const std::string&
     return logger;
 }
 
+std::unique_ptr<OutputLogger> OutputLogger::createTraceLogger(const std::string& filename) {
+    auto logger = std::make_unique<OutputLogger>();
+    logger->setFormat(OutputFormat::TRACE);
+    logger->setFilename(filename);
+    logger->setRealTime(false);
+    return logger;
+}
+
+bool OutputLogger::startExport(const std::string& exportFilename, OutputFormat exportFormat) {
+    if (asyncWriter) {
+        asyncWriter->drain();
+    }
+    finishExport();
+    
+    auto writer = std::make_unique<ExportWriter>();
+    if (!writer->open(exportFilename, exportFormat)) {
+        return false;
+    }
+    exportWriter = std::move(writer);
+    return true;
+}
+
+bool OutputLogger::finishExport() {
+    if (!exportWriter) {
+        return false;
+    }
+    if (asyncWriter) {
+        asyncWriter->drain();
+    }
+    bool ok = exportWriter->finish();
+    exportWriter.reset();
+    return ok;
+}
+
 bool OutputLogger::exportToFile(const std::string& exportFilename, OutputFormat exportFormat) {
-    if (logEntries.empty()) {
+    if (logRing.empty()) {
         std::cerr << "No log entries to export" << std::endl;
         return false;
     }
     
-    std::ofstream exportFile(exportFilename);
-    if (!exportFile.is_open()) {
-        std::cerr << "Failed to open export file: " << exportFilename << std::endl;
+    ExportWriter writer;
+    if (!writer.open(exportFilename, exportFormat)) {
         return false;
     }
-    
-    // Write header based on format
-    if (exportFormat == OutputFormat::CSV) {
-        exportFile << "Cycle,Address,Ready,LHS,Fired";
-        // Add state columns
-        if (!logEntries.empty()) {
-            for (size_t i = 0; i < logEntries[0].states.size(); ++i) {
-                exportFile << ",State" << i;
-            }
-            for (size_t i = 0; i < logEntries[0].outputs.size(); ++i) {
-                exportFile << ",Output" << i;
-            }
-            for (size_t i = 0; i < logEntries[0].inputs.size(); ++i) {
-                exportFile << ",Input" << i;
-            }
-        }
-        exportFile << std::endl;
-    } else if (exportFormat == OutputFormat::JSON) {
-        exportFile << "[" << std::endl;
-    }
-    
-    // Write data entries
-    for (size_t i = 0; i < logEntries.size(); ++i) {
-        const LogEntry& entry = logEntries[i];
-        
-        if (exportFormat == OutputFormat::CSV) {
-            exportFile << entry.cycle << "," << entry.address << ","
-                      << (entry.ready ? "1" : "0") << "," << (entry.lhs ? "1" : "0") << ","
-                      << (entry.fired ? "1" : "0");
-            
-            // Write states
-            for (bool state : entry.states) {
-                exportFile << "," << (state ? "1" : "0");
-            }
-            
-            // Write outputs
-            for (uint8_t output : entry.outputs) {
-                exportFile << ",0x" << std::hex << static_cast<uint32_t>(output) << std::dec;
-            }
-            
-            // Write inputs
-            for (uint8_t input : entry.inputs) {
-                exportFile << ",0x" << std::hex << static_cast<uint32_t>(input) << std::dec;
-            }
-            
-            exportFile << std::endl;
-            
-        } else if (exportFormat == OutputFormat::JSON) {
-            exportFile << "  {" << std::endl;
-            exportFile << "    \"cycle\": " << entry.cycle << "," << std::endl;
-            exportFile << "    \"address\": " << entry.address << "," << std::endl;
-            exportFile << "    \"ready\": " << (entry.ready ? "true" : "false") << "," << std::endl;
-            exportFile << "    \"lhs\": " << (entry.lhs ? "true" : "false") << "," << std::endl;
-            exportFile << "    \"fired\": " << (entry.fired ? "true" : "false") << "," << std::endl;
-            
-            // Write states
-            exportFile << "    \"states\": [";
-            for (size_t j = 0; j < entry.states.size(); ++j) {
-                if (j > 0) exportFile << ", ";
-                exportFile << (entry.states[j] ? "true" : "false");
-            }
-            exportFile << "]," << std::endl;
-            
-            // Write outputs
-            exportFile << "    \"outputs\": [";
-            for (size_t j = 0; j < entry.outputs.size(); ++j) {
-                if (j > 0) exportFile << ", ";
-                exportFile << static_cast<uint32_t>(entry.outputs[j]);
-            }
-            exportFile << "]," << std::endl;
-            
-            // Write inputs
-            exportFile << "    \"inputs\": [";
-            for (size_t j = 0; j < entry.inputs.size(); ++j) {
-                if (j > 0) exportFile << ", ";
-                exportFile << static_cast<uint32_t>(entry.inputs[j]);
-            }
-            exportFile << "]" << std::endl;
-            
-            exportFile << "  }" << (i < logEntries.size() - 1 ? "," : "") << std::endl;
-        }
+    for (size_t i = 0; i < logRing.size(); ++i) {
+        writer.append(logRing.view(i));
     }
-    
-    if (exportFormat == OutputFormat::JSON) {
-        exportFile << "]" << std::endl;
+    if (!writer.finish()) {
+        return false;
     }
     
-    exportFile.close();
-    std::cout << "Exported " << logEntries.size() << " entries to " << exportFilename << std::endl;
+    if (exportFormat != OutputFormat::TRACE) {
+        std::cout << "Exported " << logRing.size() << " entries to " << exportFilename << std::endl;
+    }
     return true;
 }
 
+bool OutputLogger::exportToCSV(const std::string& filename) {
+    return exportToFile(filename, OutputFormat::CSV);
+}
+
+bool OutputLogger::exportToJSON(const std::string& filename) {
+    return exportToFile(filename, OutputFormat::JSON);
+}
+
 } // namespace HotstateSim
\ No newline at end of file
@@ -0,0 +1,41 @@
+#include "period_detector.h"
+#include <algorithm>
+#include <iterator>
+
+namespace HotstateSim {
+
+uint64_t PeriodDetector::observe(const HotstateModel& model) {
+    uint64_t hash = model.registerHash();
+    if (!started) {
+        started = true;
+        tortoise = model.saveSnapshot();
+        tortoiseHash = hash;
+        power = 1;
+        length = 0;
+        return 0;
+    }
+    length++;
+    if (hash == tortoiseHash && sameRegisters(model.saveSnapshot(), tortoise)) {
+        return length;
+    }
+    if (length == power) {
+        tortoise = model.saveSnapshot();
+        tortoiseHash = hash;
+        power *= 2;
+        length = 0;
+    }
+    return 0;
+}
+
+// Every register but the cycle count, which never repeats
+bool PeriodDetector::sameRegisters(const HotstateSnapshot& a, const HotstateSnapshot& b) {
+    return a.states.size() == b.states.size() && a.states.getWords() == b.states.getWords() &&
+           a.variables == b.variables && a.timerCounts == b.timerCounts &&
+           a.address == b.address && a.fetchAddress == b.fetchAddress &&
+           a.returnAddress == b.returnAddress && a.stack == b.stack &&
+           a.stackPointer == b.stackPointer &&
+           std::equal(std::begin(a.fields), std::end(a.fields), std::begin(b.fields)) &&
+           a.settledEdges == b.settledEdges && a.flags == b.flags;
+}
+
+} // namespace HotstateSim
@@ -0,0 +1,81 @@
+#include "plant_model.h"
+#include <dlfcn.h>
+
+namespace HotstateSim {
+
+PlantModel::PlantModel(const std::string& libraryPath, const std::string& plantArgs, const MemoryLoader& memory)
+    : library(libraryPath)
+    , args(plantArgs)
+    , handle(nullptr)
+    , plant{}
+    , info{}
+{
+    // A bare file name is the file here, not a search of the library path
+    std::string path = library.find('/') == std::string::npos ? "./" + library : library;
+    handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (!handle) {
+        throw SimulatorException("Cannot load plant " + library + ": " + dlerror());
+    }
+    auto create = reinterpret_cast<hotstate_plant_create_fn>(dlsym(handle, "hotstate_plant_create"));
+    if (!create) {
+        dlclose(handle);
+        throw SimulatorException("Plant " + library + " does not export hotstate_plant_create");
+    }
+
+    const Parameters& params = memory.getParams();
+    for (uint32_t i = 0; i < params.NUM_VARS; ++i) {
+        inputNames.push_back(memory.getInputNameByIndex(i));
+    }
+    for (uint32_t i = 0; i < params.NUM_STATES; ++i) {
+        stateNames.push_back(memory.getStateNameByIndex(i));
+    }
+    for (const std::string& name : inputNames) {
+        inputNamePointers.push_back(name.c_str());
+    }
+    for (const std::string& name : stateNames) {
+        stateNamePointers.push_back(name.c_str());
+    }
+    info.num_inputs = params.NUM_VARS;
+    info.num_states = params.NUM_STATES;
+    info.input_names = inputNamePointers.data();
+    info.state_names = stateNamePointers.data();
+    info.args = args.c_str();
+
+    if (create(&info, &plant) != 0) {
+        dlclose(handle);
+        throw SimulatorException("Plant " + library + " cannot run this program");
+    }
+    if (plant.abi_version != HOTSTATE_PLANT_ABI_VERSION || !plant.reset || !plant.update) {
+        if (plant.destroy) {
+            plant.destroy(plant.context);
+        }
+        dlclose(handle);
+        throw SimulatorException("Plant " + library + " was built for plant interface version " +
+                                 std::to_string(plant.abi_version) + ", not " +
+                                 std::to_string(HOTSTATE_PLANT_ABI_VERSION));
+    }
+}
+
+PlantModel::~PlantModel() {
+    if (plant.destroy) {
+        plant.destroy(plant.context);
+    }
+    dlclose(handle);
+}
+
+uint64_t PlantModel::reset(std::vector<uint8_t>& inputs) {
+    inputs.assign(info.num_inputs, 0);
+    return plant.reset(plant.context, inputs.data());
+}
+
+uint64_t PlantModel::update(uint64_t cycle, const StateBits& states, std::vector<uint8_t>& inputs) {
+    uint64_t wake = plant.update(plant.context, cycle, states.getWords().data(), inputs.data());
+    if (wake == HOTSTATE_PLANT_ERROR) {
+        const char* message = plant.last_error ? plant.last_error(plant.context) : nullptr;
+        throw SimulatorException("Plant " + library + " stopped the run at cycle " + std::to_string(cycle) +
+                                 (message ? ": " + std::string(message) : std::string()));
+    }
+    return wake;
+}
+
+} // namespace HotstateSim
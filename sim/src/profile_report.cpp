@@ -0,0 +1,141 @@
+#include "profile_report.h"
+#include <algorithm>
+#include <iomanip>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace HotstateSim {
+
+namespace {
+
+constexpr size_t TOP_ENTRIES = 10;
+
+struct Loop {
+    uint32_t from;        // The backward jump
+    uint32_t to;          // Its target, the top of the loop
+    uint64_t iterations;  // Times the jump was taken
+    uint64_t bodyEdges;   // Edges spent in [to, from]
+};
+
+std::string hexAddress(uint32_t address) {
+    std::ostringstream out;
+    out << "0x" << std::hex << std::uppercase << std::setw(2) << std::setfill('0') << address;
+    return out.str();
+}
+
+std::string percent(uint64_t part, uint64_t whole) {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(1) << (whole ? 100.0 * part / whole : 0.0) << "%";
+    return out.str();
+}
+
+void writeCounts(std::ostream& out, const char* key, const std::vector<uint64_t>& counts) {
+    out << "  \"" << key << "\": [";
+    for (size_t a = 0; a < counts.size(); ++a) {
+        out << (a > 0 ? ", " : "") << counts[a];
+    }
+    out << "]";
+}
+
+} // namespace
+
+void writeProfileReport(std::ostream& out, const HotstateModel& model, const MemoryLoader& memory) {
+    const std::vector<uint64_t>& hits = model.getAddressHits();
+    const std::vector<uint64_t>& taken = model.getBranchTaken();
+    const std::vector<uint64_t>& notTaken = model.getBranchNotTaken();
+    const std::vector<DecodedMicrocode>& code = model.getDecodedMicrocode();
+    const std::vector<std::string>& labels = memory.getSourceLabels();
+    auto source = [&](uint32_t address) {
+        std::string label = address < labels.size() ? labels[address] : "";
+        std::replace(label.begin(), label.end(), '\n', ' ');
+        return label;
+    };
+
+    uint32_t words = static_cast<uint32_t>(hits.size());
+    uint64_t edges = std::accumulate(hits.begin(), hits.end(), uint64_t{0});
+    uint32_t covered = 0, branches = 0, bothWays = 0, takenOnly = 0, notTakenOnly = 0;
+    for (uint32_t a = 0; a < words; ++a) {
+        covered += hits[a] != 0;
+        if (code[a].branch) {
+            branches++;
+            bothWays += taken[a] != 0 && notTaken[a] != 0;
+            takenOnly += taken[a] != 0 && notTaken[a] == 0;
+            notTakenOnly += taken[a] == 0 && notTaken[a] != 0;
+        }
+    }
+
+    out << "Microcode profile: " << edges << " edges over " << words << " words" << std::endl;
+    out << "Coverage: " << covered << "/" << words << " words (" << percent(covered, words) << ")" << std::endl;
+    out << "Branches: " << branches << " words, " << bothWays << " both ways, " << takenOnly
+        << " taken only, " << notTakenOnly << " not taken only, "
+        << (branches - bothWays - takenOnly - notTakenOnly) << " never reached" << std::endl;
+
+    // Hot words
+    std::vector<uint32_t> order(words);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return hits[a] > hits[b]; });
+    out << std::endl << "Hot words" << std::endl;
+    out << "  addr        edges  share  source" << std::endl;
+    for (size_t i = 0; i < order.size() && i < TOP_ENTRIES && hits[order[i]] != 0; ++i) {
+        uint32_t a = order[i];
+        out << "  " << std::left << std::setw(6) << hexAddress(a) << std::right << std::setw(11) << hits[a]
+            << std::setw(7) << percent(hits[a], edges) << "  " << source(a) << std::endl;
+    }
+
+    // Hot loops: taken backward jumps, by the edges spent in their body
+    std::vector<Loop> loops;
+    for (uint32_t a = 0; a < words; ++a) {
+        const DecodedMicrocode& mc = code[a];
+        if (!(mc.branch || mc.forcedJmp) || mc.sub || mc.rtn || mc.jadr > a) {
+            continue;
+        }
+        uint64_t iterations = mc.branch ? taken[a] : hits[a];
+        if (iterations == 0) {
+            continue;
+        }
+        uint64_t body = std::accumulate(hits.begin() + mc.jadr, hits.begin() + a + 1, uint64_t{0});
+        loops.push_back({a, mc.jadr, iterations, body});
+    }
+    std::stable_sort(loops.begin(), loops.end(), [](const Loop& x, const Loop& y) { return x.bodyEdges > y.bodyEdges; });
+    out << std::endl << "Hot loops" << std::endl;
+    out << "  jump          iterations   body edges  share  source" << std::endl;
+    for (size_t i = 0; i < loops.size() && i < TOP_ENTRIES; ++i) {
+        const Loop& loop = loops[i];
+        out << "  " << std::left << std::setw(12) << (hexAddress(loop.from) + "->" + hexAddress(loop.to))
+            << std::right << std::setw(12) << loop.iterations << std::setw(13) << loop.bodyEdges
+            << std::setw(7) << percent(loop.bodyEdges, edges) << "  " << source(loop.to) << std::endl;
+    }
+
+    // What the run missed
+    out << std::endl << "Uncovered words" << std::endl;
+    for (uint32_t a = 0; a < words; ++a) {
+        if (hits[a] == 0) {
+            out << "  " << std::left << std::setw(6) << hexAddress(a) << std::right << "  " << source(a) << std::endl;
+        }
+    }
+    out << std::endl << "Branches taken one way only" << std::endl;
+    out << "  addr        taken    not taken  source" << std::endl;
+    for (uint32_t a = 0; a < words; ++a) {
+        if (code[a].branch && hits[a] != 0 && (taken[a] == 0 || notTaken[a] == 0)) {
+            out << "  " << std::left << std::setw(6) << hexAddress(a) << std::right << std::setw(11) << taken[a]
+                << std::setw(13) << notTaken[a] << "  " << source(a) << std::endl;
+        }
+    }
+}
+
+void writeProfileJson(std::ostream& out, const HotstateModel& model) {
+    const std::vector<uint64_t>& hits = model.getAddressHits();
+    out << "{" << std::endl;
+    out << "  \"words\": " << hits.size() << "," << std::endl;
+    out << "  \"edges\": " << std::accumulate(hits.begin(), hits.end(), uint64_t{0}) << "," << std::endl;
+    writeCounts(out, "hits", hits);
+    out << "," << std::endl;
+    writeCounts(out, "taken", model.getBranchTaken());
+    out << "," << std::endl;
+    writeCounts(out, "not_taken", model.getBranchNotTaken());
+    out << std::endl << "}" << std::endl;
+}
+
+} // namespace HotstateSim
@@ -0,0 +1,360 @@
+#include "random_batch.h"
+#include "profile_report.h"
+#include "utils.h"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+
+namespace HotstateSim {
+
+namespace {
+
+constexpr size_t MAX_FAILURES_SHOWN = 20;
+
+void setBit(std::vector<uint64_t>& bits, uint32_t index) {
+    if (bits.size() <= index / 64) {
+        bits.resize(index / 64 + 1, 0);
+    }
+    bits[index / 64] |= 1ULL << (index % 64);
+}
+
+bool testBit(const std::vector<uint64_t>& bits, uint32_t index) {
+    return index / 64 < bits.size() && ((bits[index / 64] >> (index % 64)) & 1);
+}
+
+} // namespace
+
+// Lane i owns element i of each array, or the slice [i * stride,
+// (i + 1) * stride) of a multi-word one, as in BatchSimulator. The counts
+// and failures gather everything the worker's blocks did.
+struct RandomBatch::Block {
+    std::vector<RandomStimulus> stimuli;
+    std::vector<StimulusEntry> nextEntry;  // The lane's next input change
+    std::vector<uint8_t> hasNext;
+    std::vector<uint64_t> inputBits;       // Inputs in effect, packed
+    std::vector<uint64_t> states;          // stateWordCount words per lane
+    std::vector<uint32_t> stack;           // stackDepth per lane
+    std::vector<uint32_t> timers;          // numTimers per lane
+    std::vector<uint32_t> address;
+    std::vector<uint32_t> stackPointer;
+    std::vector<uint8_t> running;          // Cleared when the lane fails
+
+    std::vector<uint64_t> hits;
+    std::vector<uint64_t> taken;
+    std::vector<uint64_t> notTaken;
+    std::vector<RandomRunFailure> failures;
+};
+
+RandomBatch::RandomBatch(const SimulatorConfig& cfg, uint32_t runs)
+    : config(cfg)
+    , runCount(runs)
+    , jobs(cfg.jobs)
+    , stateWordCount(0)
+    , numTimers(0)
+    , stackDepth(0)
+    , elapsed(0)
+{
+    if (jobs == 0) {
+        jobs = std::max(1u, std::thread::hardware_concurrency());
+    }
+}
+
+bool RandomBatch::initialize() {
+    try {
+        if (runCount == 0) {
+            lastError = "No random runs requested";
+            return false;
+        }
+        if (config.basePath.empty()) {
+            lastError = "Base path not specified";
+            return false;
+        }
+        if (!memoryLoader.loadProgram(config.basePath, config.sourceFile) || !memoryLoader.isLoaded()) {
+            lastError = "Failed to load memory files from base path: " + config.basePath;
+            return false;
+        }
+        if (config.verbose) {
+            memoryLoader.printMemoryInfo();
+        }
+
+        const Parameters& params = memoryLoader.getParams();
+        if (params.PIPELINED) {
+            lastError = "--random-runs does not support PIPELINED programs";
+            return false;
+        }
+        decoded = HotstateModel::decodeProgram(memoryLoader.getSmdata(), params);
+        lut = VardataImage(memoryLoader.getVardata(), params.NUM_VARS);
+        rules = RandomStimulus::parseRules(config.randomInputRules, memoryLoader, params.NUM_VARS);
+        stateWordCount = (params.NUM_STATES + 63) / 64;
+        numTimers = HotstateModel::timerCount(params);
+        stackDepth = params.STACK_DEPTH;
+
+        for (uint32_t state : config.breakpointStates) {
+            setBit(breakStates, state);
+        }
+        for (uint32_t addr : config.breakpointAddresses) {
+            setBit(breakAddresses, addr);
+        }
+
+        hits.assign(decoded.size(), 0);
+        taken.assign(decoded.size(), 0);
+        notTaken.assign(decoded.size(), 0);
+        return true;
+
+    } catch (const SimulatorException& e) {
+        lastError = e.what();
+        return false;
+    }
+}
+
+bool RandomBatch::run() {
+    std::atomic<uint32_t> nextBlock(0);
+    uint32_t blockCount = (runCount + BLOCK_LANES - 1) / BLOCK_LANES;
+    std::mutex merge;
+
+    auto worker = [&]() {
+        Block block;
+        block.hits.assign(decoded.size(), 0);
+        block.taken.assign(decoded.size(), 0);
+        block.notTaken.assign(decoded.size(), 0);
+        for (uint32_t index = nextBlock++; index < blockCount; index = nextBlock++) {
+            uint32_t first = index * BLOCK_LANES;
+            runBlock(block, first, std::min(BLOCK_LANES, runCount - first));
+        }
+
+        std::lock_guard<std::mutex> lock(merge);
+        for (size_t pc = 0; pc < decoded.size(); ++pc) {
+            hits[pc] += block.hits[pc];
+            taken[pc] += block.taken[pc];
+            notTaken[pc] += block.notTaken[pc];
+        }
+        failures.insert(failures.end(), block.failures.begin(), block.failures.end());
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    uint32_t threadCount = std::min(jobs, blockCount);
+    std::vector<std::thread> threads;
+    for (uint32_t t = 1; t < threadCount; ++t) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::sort(failures.begin(), failures.end(),
+              [](const RandomRunFailure& a, const RandomRunFailure& b) { return a.seed < b.seed; });
+    return failures.empty();
+}
+
+// Lanes [first, first + lanes) from reset to --max-cycles, one clock period
+// per pass. Every cycle the lanes run is the one Simulator::run would: the
+// inputs in effect, then a rising edge on even cycles, reset below
+// Simulator::RESET_CYCLES; breakpoints are checked before each cycle, and a
+// falling edge changes nothing they see.
+void RandomBatch::runBlock(Block& block, uint32_t first, uint32_t lanes) const {
+    const uint32_t maxCycles = config.maxCycles;
+    const bool breakpoints = !breakStates.empty() || !breakAddresses.empty();
+
+    block.stimuli.clear();
+    block.nextEntry.assign(lanes, StimulusEntry());
+    block.hasNext.assign(lanes, 0);
+    block.inputBits.assign(lanes, 0);
+    block.states.assign(static_cast<size_t>(lanes) * stateWordCount, 0);
+    block.stack.assign(static_cast<size_t>(lanes) * stackDepth, 0);
+    block.timers.assign(static_cast<size_t>(lanes) * numTimers, 0);
+    block.address.assign(lanes, 0);
+    block.stackPointer.assign(lanes, 0);
+    block.running.assign(lanes, 1);
+
+    std::string reason;
+    for (uint32_t lane = 0; lane < lanes; ++lane) {
+        block.stimuli.emplace_back(config.randomSeed + first + lane, rules);
+        block.hasNext[lane] = block.stimuli[lane].next(block.nextEntry[lane]);
+        if (maxCycles > 0 && breakpoints && breakpointHit(block, lane, reason)) {
+            block.running[lane] = 0;
+            block.failures.push_back({config.randomSeed + first + lane, 0, reason});
+        }
+    }
+
+    for (uint32_t cycle = 0; cycle < maxCycles; cycle += 2) {
+        bool resetEdge = cycle < Simulator::RESET_CYCLES;
+        for (uint32_t lane = 0; lane < lanes; ++lane) {
+            if (!block.running[lane]) continue;
+
+            // The latest input change at or before this cycle
+            StimulusEntry& entry = block.nextEntry[lane];
+            if (block.hasNext[lane] && entry.cycle <= cycle) {
+                do {
+                    block.inputBits[lane] = VardataImage::packInputs(entry.inputs);
+                    block.hasNext[lane] = block.stimuli[lane].next(entry);
+                } while (block.hasNext[lane] && entry.cycle <= cycle);
+            }
+
+            if (resetEdge) {
+                std::fill_n(block.states.begin() + static_cast<size_t>(lane) * stateWordCount, stateWordCount, 0);
+                std::fill_n(block.stack.begin() + static_cast<size_t>(lane) * stackDepth, stackDepth, 0);
+                std::fill_n(block.timers.begin() + static_cast<size_t>(lane) * numTimers, numTimers, 0);
+                block.address[lane] = 0;
+                block.stackPointer[lane] = 0;
+            } else if (!executeLane(block, lane, reason)) {
+                block.running[lane] = 0;
+                block.failures.push_back({config.randomSeed + first + lane, cycle, reason});
+                continue;
+            }
+
+            if (breakpoints && cycle + 1 < maxCycles && breakpointHit(block, lane, reason)) {
+                block.running[lane] = 0;
+                block.failures.push_back({config.randomSeed + first + lane, cycle + 1, reason});
+            }
+        }
+    }
+}
+
+// One rising edge of the lane, as HotstateModel::executeEdge, counting the
+// word into the block's coverage. False, with the model's message, where
+// the model would throw.
+bool RandomBatch::executeLane(Block& block, uint32_t lane, std::string& reason) const {
+    const Parameters& params = memoryLoader.getParams();
+
+    uint32_t pc = block.address[lane];
+    if (pc >= decoded.size()) {
+        reason = "Address " + std::to_string(pc) + " exceeds microcode memory size " +
+                 std::to_string(decoded.size());
+        return false;
+    }
+    const DecodedMicrocode& mc = decoded[pc];
+    uint32_t& stackPointer = block.stackPointer[lane];
+    if (mc.sub && stackPointer >= stackDepth) {
+        reason = "Call at address " + std::to_string(pc) + " overflows the " + std::to_string(stackDepth) +
+                 "-entry stack (STACK_DEPTH)";
+        return false;
+    }
+
+    bool timerDone = false;
+    if (mc.timerSel != 0 && numTimers > 0) {
+        timerDone = HotstateModel::clockTimers(mc, block.timers.data() + static_cast<size_t>(lane) * numTimers,
+                                               numTimers, memoryLoader.getTimdata(), params).done;
+    }
+
+    if (mc.stateCapture) {
+        uint64_t* laneStates = block.states.data() + static_cast<size_t>(lane) * stateWordCount;
+        if (stateWordCount == 1) {
+            laneStates[0] = (laneStates[0] & ~mc.captureMask) | mc.captureValue;
+        } else {
+            const std::vector<uint64_t>& value = mc.stateValue.getWords();
+            const std::vector<uint64_t>& mask = mc.transitionValue.getWords();
+            for (uint32_t w = 0; w < stateWordCount; ++w) {
+                laneStates[w] = (laneStates[w] & ~mask[w]) | (value[w] & mask[w]);
+            }
+        }
+    }
+
+    bool lhs = lut.lookup(mc.varSel, block.inputBits[lane]);
+    bool taken = mc.varOrTimer ? !timerDone : lhs;
+    bool fired = (mc.branch && taken) || mc.forcedJmp || mc.rtn;
+
+    uint32_t* laneStack = block.stack.data() + static_cast<size_t>(lane) * stackDepth;
+    uint32_t nextAddress;
+    if (!fired) {
+        nextAddress = pc + 1;
+    } else if (mc.rtn && stackPointer > 0) {
+        nextAddress = laneStack[--stackPointer];
+    } else {
+        nextAddress = mc.jadr;
+    }
+    if (mc.sub) {
+        laneStack[stackPointer++] = pc + 1;
+    }
+    block.address[lane] = nextAddress >= params.NUM_WORDS ? 0 : nextAddress;
+
+    block.hits[pc]++;
+    if (mc.branch) {
+        (fired ? block.taken : block.notTaken)[pc]++;
+    }
+    return true;
+}
+
+// The breakpoint Simulator::checkBreakpoints would report for the lane
+bool RandomBatch::breakpointHit(const Block& block, uint32_t lane, std::string& reason) const {
+    const uint64_t* laneStates = block.states.data() + static_cast<size_t>(lane) * stateWordCount;
+    uint64_t stateHits = 0;
+    for (size_t w = 0; w < stateWordCount && w < breakStates.size(); ++w) {
+        stateHits |= laneStates[w] & breakStates[w];
+    }
+    if (stateHits != 0) {
+        for (uint32_t state : config.breakpointStates) {
+            if (testBit(breakStates, state) && state / 64 < stateWordCount &&
+                ((laneStates[state / 64] >> (state % 64)) & 1)) {
+                reason = "State[" + std::to_string(state) + "] = 1";
+                return true;
+            }
+        }
+    }
+    if (testBit(breakAddresses, block.address[lane])) {
+        reason = "Address = " + toHexString(block.address[lane]);
+        return true;
+    }
+    return false;
+}
+
+void RandomBatch::printSummary() const {
+    uint32_t words = static_cast<uint32_t>(decoded.size());
+    uint32_t reached = 0;
+    uint32_t branches = 0;
+    uint32_t directions = 0;
+    for (uint32_t pc = 0; pc < words; ++pc) {
+        reached += hits[pc] != 0;
+        if (decoded[pc].branch) {
+            branches++;
+            directions += (taken[pc] != 0) + (notTaken[pc] != 0);
+        }
+    }
+    double laneCycles = static_cast<double>(runCount) * config.maxCycles;
+
+    std::cout << "=== Random Runs ===" << std::endl;
+    std::cout << "Runs: " << runCount << " (seeds " << config.randomSeed << ".."
+              << config.randomSeed + runCount - 1 << "), cycles: " << config.maxCycles
+              << ", jobs: " << std::min(jobs, (runCount + BLOCK_LANES - 1) / BLOCK_LANES) << std::endl;
+    std::cout << "Coverage: " << reached << "/" << words << " words, " << directions << "/" << 2 * branches
+              << " branch directions" << std::endl;
+    std::cout << "Failed: " << failures.size() << std::endl;
+    for (size_t i = 0; i < failures.size() && i < MAX_FAILURES_SHOWN; ++i) {
+        std::cout << "  seed " << failures[i].seed << ": cycle " << failures[i].cycle << ": "
+                  << failures[i].reason << std::endl;
+    }
+    if (failures.size() > MAX_FAILURES_SHOWN) {
+        std::cout << "  ... " << failures.size() - MAX_FAILURES_SHOWN << " more" << std::endl;
+    }
+    std::cout << "Time: " << std::fixed << std::setprecision(3) << elapsed << " s ("
+              << std::setprecision(1) << (elapsed > 0 ? laneCycles / elapsed / 1e6 : 0.0)
+              << "M cycles/s)" << std::defaultfloat << std::endl;
+    std::cout << "===================" << std::endl;
+}
+
+bool RandomBatch::writeProfile(const std::string& filename) const {
+    HotstateModel model(memoryLoader);
+    model.addProfileCounts(hits, taken, notTaken);
+    if (filename == "-") {
+        writeProfileReport(std::cout, model, memoryLoader);
+        return true;
+    }
+    std::ofstream file(filename);
+    if (!file.is_open()) {
+        return false;
+    }
+    if (endsWith(filename, ".json")) {
+        writeProfileJson(file, model);
+    } else {
+        writeProfileReport(file, model, memoryLoader);
+    }
+    return true;
+}
+
+} // namespace HotstateSim
@@ -0,0 +1,194 @@
+#include "random_stimulus.h"
+#include "utils.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+
+namespace HotstateSim {
+
+namespace {
+
+[[noreturn]] void invalidRule(const std::string& spec, const std::string& why) {
+    throw SimulatorException("Invalid random input rule '" + spec + "': " + why);
+}
+
+uint32_t parseRuleNumber(const std::string& spec, const std::string& text, uint32_t limit) {
+    try {
+        size_t used = 0;
+        unsigned long value = std::stoul(text, &used, 0);
+        if (used == text.size() && value <= limit) {
+            return static_cast<uint32_t>(value);
+        }
+    } catch (const std::exception&) {
+    }
+    invalidRule(spec, "bad number '" + text + "'");
+}
+
+// "N" or "LO..HI"
+void parseRuleRange(const std::string& spec, const std::string& text, uint32_t limit,
+                    uint32_t& low, uint32_t& high) {
+    size_t dots = text.find("..");
+    low = parseRuleNumber(spec, text.substr(0, dots), limit);
+    high = dots == std::string::npos ? low : parseRuleNumber(spec, text.substr(dots + 2), limit);
+    if (high < low) {
+        invalidRule(spec, "empty range '" + text + "'");
+    }
+}
+
+void applyRuleSettings(const std::string& spec, const std::string& settings, RandomInputRule& rule) {
+    for (const std::string& setting : split(settings, ',')) {
+        size_t eq = setting.find('=');
+        if (eq == std::string::npos) {
+            invalidRule(spec, "expected KEY=VALUE, got '" + setting + "'");
+        }
+        std::string key = trim(setting.substr(0, eq));
+        std::string value = trim(setting.substr(eq + 1));
+        uint32_t low, high;
+        if (key == "toggle") {
+            char* end = nullptr;
+            double p = std::strtod(value.c_str(), &end);
+            if (value.empty() || *end != '\0' || !(p >= 0.0 && p <= 1.0)) {
+                invalidRule(spec, "toggle must be a probability, got '" + value + "'");
+            }
+            rule.toggle = p;
+            rule.holdMin = rule.holdMax = 0;
+        } else if (key == "hold") {
+            parseRuleRange(spec, value, UINT32_MAX, low, high);
+            if (low == 0) {
+                invalidRule(spec, "hold times start at 1 cycle");
+            }
+            rule.holdMin = low;
+            rule.holdMax = high;
+        } else if (key == "range" || key == "value") {
+            parseRuleRange(spec, value, UINT8_MAX, low, high);
+            if (key == "value" && low != high) {
+                invalidRule(spec, "value takes one number");
+            }
+            rule.low = static_cast<uint8_t>(low);
+            rule.high = static_cast<uint8_t>(high);
+        } else {
+            invalidRule(spec, "unknown key '" + key + "'");
+        }
+    }
+}
+
+} // namespace
+
+RandomStimulus::RandomStimulus(uint64_t seed, const std::vector<RandomInputRule>& rules)
+    : state(seed)
+    , started(false)
+    , rules(rules)
+    , values(rules.size(), 0)
+    , changeAt(rules.size(), NEVER)
+{
+}
+
+// SplitMix64
+uint64_t RandomStimulus::nextRandom() {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// Uniform in [0, bound)
+uint32_t RandomStimulus::below(uint32_t bound) {
+    return static_cast<uint32_t>(((nextRandom() >> 32) * bound) >> 32);
+}
+
+// Cycles until the input's next change
+uint64_t RandomStimulus::gap(const RandomInputRule& rule) {
+    if (rule.low == rule.high) {
+        return NEVER;
+    }
+    if (rule.holdMax != 0) {
+        return rule.holdMin + below(rule.holdMax - rule.holdMin + 1);
+    }
+    if (rule.toggle <= 0.0) {
+        return NEVER;
+    }
+    if (rule.toggle >= 1.0) {
+        return 1;
+    }
+    // Geometric: the first of the following cycles whose toggle fires
+    double u = static_cast<double>(nextRandom() >> 11) * 0x1.0p-53;
+    double cycles = std::floor(std::log1p(-u) / std::log1p(-rule.toggle));
+    return cycles >= 4294967296.0 ? NEVER : 1 + static_cast<uint64_t>(cycles);
+}
+
+// A value in the rule's range other than current
+uint8_t RandomStimulus::draw(const RandomInputRule& rule, uint8_t current) {
+    uint32_t span = rule.high - rule.low + 1u;
+    if (current < rule.low || current > rule.high) {
+        return static_cast<uint8_t>(rule.low + below(span));
+    }
+    uint32_t value = rule.low + below(span - 1);
+    return static_cast<uint8_t>(value >= current ? value + 1 : value);
+}
+
+bool RandomStimulus::next(StimulusEntry& entry) {
+    uint64_t cycle;
+    if (!started) {
+        started = true;
+        cycle = 0;
+        for (size_t i = 0; i < rules.size(); ++i) {
+            uint32_t span = rules[i].high - rules[i].low + 1u;
+            values[i] = static_cast<uint8_t>(rules[i].low + below(span));
+            changeAt[i] = gap(rules[i]);
+        }
+    } else {
+        cycle = changeAt.empty() ? NEVER : *std::min_element(changeAt.begin(), changeAt.end());
+        if (cycle == NEVER) {
+            return false;
+        }
+        for (size_t i = 0; i < rules.size(); ++i) {
+            if (changeAt[i] == cycle) {
+                values[i] = draw(rules[i], values[i]);
+                uint64_t wait = gap(rules[i]);
+                changeAt[i] = wait == NEVER ? NEVER : cycle + wait;
+            }
+        }
+    }
+    entry.cycle = cycle;
+    entry.inputs = values;
+    entry.comment.clear();
+    return true;
+}
+
+std::vector<RandomInputRule> RandomStimulus::parseRules(const std::vector<std::string>& specs,
+                                                        const MemoryLoader& memory, uint32_t numInputs) {
+    // Defaults first, so * applies to every input a spec does not name
+    RandomInputRule defaults;
+    for (const std::string& spec : specs) {
+        size_t colon = spec.find(':');
+        if (trim(spec.substr(0, colon)) == "*") {
+            applyRuleSettings(spec, colon == std::string::npos ? "" : spec.substr(colon + 1), defaults);
+        }
+    }
+    std::vector<RandomInputRule> rules(numInputs, defaults);
+    for (const std::string& spec : specs) {
+        size_t colon = spec.find(':');
+        std::string name = trim(spec.substr(0, colon));
+        if (name == "*") {
+            continue;
+        }
+        if (colon == std::string::npos) {
+            invalidRule(spec, "expected NAME:KEY=VALUE");
+        }
+        uint32_t index = memory.getInputIndexByName(name);
+        if (index == UINT32_MAX && !name.empty() && std::all_of(name.begin(), name.end(), ::isdigit)) {
+            index = parseRuleNumber(spec, name, UINT32_MAX);
+        }
+        if (index == UINT32_MAX) {
+            invalidRule(spec, "no input named '" + name + "'");
+        }
+        if (index >= numInputs) {
+            invalidRule(spec, "input " + std::to_string(index) + " out of range (" +
+                              std::to_string(numInputs) + " available)");
+        }
+        applyRuleSettings(spec, spec.substr(colon + 1), rules[index]);
+    }
+    return rules;
+}
+
+} // namespace HotstateSim
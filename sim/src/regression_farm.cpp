@@ -0,0 +1,591 @@
+#include "regression_farm.h"
+#include "profile_report.h"
+#include "utils.h"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace HotstateSim {
+
+namespace {
+
+// One end of a farm connection: buffered reads of lines and byte counts,
+// writes that never raise SIGPIPE. Every call is false once the peer is gone.
+class Connection {
+public:
+    explicit Connection(int socketFd) : fd(socketFd) {}
+    ~Connection() { close(fd); }
+    Connection(const Connection&) = delete;
+    Connection& operator=(const Connection&) = delete;
+
+    bool readLine(std::string& line) {
+        size_t newline;
+        while ((newline = buffer.find('\n')) == std::string::npos) {
+            if (!fill()) {
+                return false;
+            }
+        }
+        line = buffer.substr(0, newline);
+        buffer.erase(0, newline + 1);
+        return true;
+    }
+
+    bool readBytes(std::string& bytes, size_t size) {
+        while (buffer.size() < size) {
+            if (!fill()) {
+                return false;
+            }
+        }
+        bytes = buffer.substr(0, size);
+        buffer.erase(0, size);
+        return true;
+    }
+
+    bool write(const std::string& data) {
+        for (size_t sent = 0; sent < data.size(); ) {
+            ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) {
+                return false;
+            }
+            sent += static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+private:
+    bool fill() {
+        char chunk[65536];
+        ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+        if (n <= 0) {
+            return false;
+        }
+        buffer.append(chunk, static_cast<size_t>(n));
+        return true;
+    }
+
+    int fd;
+    std::string buffer;
+};
+
+std::string hexString(uint64_t value) {
+    std::ostringstream out;
+    out << std::hex << std::setw(16) << std::setfill('0') << value;
+    return out.str();
+}
+
+bool readWholeFile(const std::string& filename, std::string& contents) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    std::ostringstream bytes;
+    bytes << file.rdbuf();
+    contents = bytes.str();
+    return true;
+}
+
+// Error text on one line, as RESULT carries it
+std::string oneLine(std::string text) {
+    std::replace(text.begin(), text.end(), '\n', ' ');
+    return text;
+}
+
+std::vector<uint64_t> readCounts(std::istringstream& in, size_t count) {
+    std::vector<uint64_t> counts(count);
+    for (uint64_t& value : counts) {
+        if (!(in >> value)) {
+            throw SimulatorException("Truncated COUNTS line");
+        }
+    }
+    return counts;
+}
+
+} // namespace
+
+// --- Coordinator ---
+
+FarmCoordinator::FarmCoordinator(const SimulatorConfig& cfg, const std::vector<std::string>& files)
+    : config(cfg)
+    , stimulusFiles(files)
+    , finished(0)
+{
+}
+
+bool FarmCoordinator::initialize() {
+    if (stimulusFiles.empty()) {
+        lastError = "Farm has no stimulus files";
+        return false;
+    }
+
+    // The coordinator runs nothing, but checks that workers load the same
+    // program and needs it for the merged profile report
+    if (!memoryLoader.loadProgram(config.basePath, config.sourceFile) || !memoryLoader.isLoaded()) {
+        lastError = "Failed to load memory files from base path: " + config.basePath;
+        return false;
+    }
+    if (!config.profileFile.empty()) {
+        coverage = std::make_unique<HotstateModel>(memoryLoader);
+        coverage->enableProfiling();
+    }
+
+    results.assign(stimulusFiles.size(), FarmResult());
+    for (uint32_t i = 0; i < stimulusFiles.size(); ++i) {
+        results[i].stimulusFile = stimulusFiles[i];
+        pending.push_back(i);
+    }
+    return true;
+}
+
+bool FarmCoordinator::run() {
+    int listener = socket(AF_INET6, SOCK_STREAM, 0);
+    if (listener < 0) {
+        lastError = std::string("Cannot create the coordinator socket: ") + std::strerror(errno);
+        return false;
+    }
+    // Dual-stack, so IPv4 workers connect as well
+    int off = 0, on = 1;
+    setsockopt(listener, IPPROTO_IPV6, IPV6_V6ONLY, &off, sizeof(off));
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    sockaddr_in6 address{};
+    address.sin6_family = AF_INET6;
+    address.sin6_addr = in6addr_any;
+    address.sin6_port = htons(static_cast<uint16_t>(config.coordinatorPort));
+    if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        listen(listener, SOMAXCONN) != 0) {
+        lastError = "Cannot listen on port " + std::to_string(config.coordinatorPort) + ": " + std::strerror(errno);
+        close(listener);
+        return false;
+    }
+
+    std::cout << "Coordinating " << stimulusFiles.size() << " runs on port " << config.coordinatorPort << std::endl;
+
+    // Connections are accepted until every run has a result; each is
+    // served on its own thread, which waits for a result before the next run
+    std::vector<std::thread> connections;
+    uint32_t runCount = static_cast<uint32_t>(stimulusFiles.size());
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (finished == runCount) {
+                break;
+            }
+        }
+        pollfd waiting = {listener, POLLIN, 0};
+        if (poll(&waiting, 1, 200) <= 0) {
+            continue;
+        }
+        sockaddr_storage peerAddress{};
+        socklen_t peerSize = sizeof(peerAddress);
+        int fd = accept(listener, reinterpret_cast<sockaddr*>(&peerAddress), &peerSize);
+        if (fd < 0) {
+            continue;
+        }
+        char host[NI_MAXHOST] = "?", port[NI_MAXSERV] = "?";
+        getnameinfo(reinterpret_cast<sockaddr*>(&peerAddress), peerSize, host, sizeof(host), port, sizeof(port),
+                    NI_NUMERICHOST | NI_NUMERICSERV);
+        std::string peer = std::string(host) + ":" + port;
+        if (config.verbose) {
+            std::cout << "Worker connected from " << peer << std::endl;
+        }
+        connections.emplace_back(&FarmCoordinator::serve, this, fd, peer);
+    }
+    close(listener);
+    for (auto& connection : connections) {
+        connection.join();
+    }
+
+    return std::all_of(results.begin(), results.end(), [](const FarmResult& result) { return result.success; });
+}
+
+bool FarmCoordinator::nextRun(uint32_t& index) {
+    std::unique_lock<std::mutex> lock(mutex);
+    runsChanged.wait(lock, [this] { return !pending.empty() || finished == results.size(); });
+    if (pending.empty()) {
+        return false;
+    }
+    index = pending.front();
+    pending.pop_front();
+    return true;
+}
+
+void FarmCoordinator::requeue(uint32_t index) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.push_front(index);
+    }
+    runsChanged.notify_all();
+}
+
+void FarmCoordinator::serve(int fd, const std::string& peer) {
+    Connection connection(fd);
+    std::string line;
+    if (!connection.readLine(line) || !startsWith(line, "HELLO ")) {
+        std::cerr << "Warning: " << peer << " is not a farm worker" << std::endl;
+        return;
+    }
+    std::string expected = hexString(memoryLoader.fingerprint());
+    if (trim(line.substr(6)) != expected) {
+        std::cerr << "Warning: Rejected worker " << peer << ": it loaded a different program" << std::endl;
+        connection.write("REJECT the coordinator's program has fingerprint " + expected + "\n");
+        return;
+    }
+
+    const bool profile = coverage != nullptr;
+    uint32_t index;
+    while (nextRun(index)) {
+        FarmResult result;
+        result.stimulusFile = stimulusFiles[index];
+        result.worker = peer;
+
+        std::string stimulus;
+        if (!readWholeFile(result.stimulusFile, stimulus)) {
+            result.error = "Failed to read stimulus file: " + result.stimulusFile;
+        } else {
+            std::ostringstream header;
+            header << "RUN " << index << " " << config.maxCycles << " " << profile << " " << stimulus.size() << "\n";
+            std::string reply;
+            if (!connection.write(header.str() + stimulus) || !connection.readLine(reply)) {
+                std::cerr << "Warning: Lost worker " << peer << "; run " << index << " goes to another" << std::endl;
+                requeue(index);
+                return;
+            }
+
+            // RESULT <index> ok <cycles> <address> <states> <signature> | failed <error>
+            std::istringstream in(reply);
+            std::string tag, status;
+            uint32_t replyIndex = UINT32_MAX;
+            in >> tag >> replyIndex >> status;
+            if (tag != "RESULT" || replyIndex != index) {
+                result.error = "Unexpected reply from " + peer + ": " + reply;
+            } else if (status == "ok") {
+                std::string signature;
+                in >> result.cycles >> std::hex >> result.finalAddress >> std::dec >> result.activeStates >> signature;
+                result.signature = std::strtoull(signature.c_str(), nullptr, 16);
+                result.success = static_cast<bool>(in);
+                if (!result.success) {
+                    result.error = "Malformed result from " + peer + ": " + reply;
+                }
+            } else {
+                std::getline(in, result.error);
+                result.error = trim(result.error);
+            }
+
+            if (result.success && profile) {
+                std::string countsLine;
+                if (!connection.readLine(countsLine)) {
+                    std::cerr << "Warning: Lost worker " << peer << "; run " << index << " goes to another" << std::endl;
+                    requeue(index);
+                    return;
+                }
+                try {
+                    std::istringstream counts(countsLine);
+                    std::string countsTag;
+                    size_t words = 0;
+                    counts >> countsTag >> words;
+                    if (countsTag != "COUNTS") {
+                        throw SimulatorException("Expected COUNTS");
+                    }
+                    // Checked before readCounts sizes anything from it
+                    if (words != coverage->getAddressHits().size()) {
+                        throw SimulatorException("COUNTS for " + std::to_string(words) + " words, not " +
+                                                 std::to_string(coverage->getAddressHits().size()));
+                    }
+                    std::vector<uint64_t> hits = readCounts(counts, words);
+                    std::vector<uint64_t> taken = readCounts(counts, words);
+                    std::vector<uint64_t> notTaken = readCounts(counts, words);
+                    std::lock_guard<std::mutex> lock(mutex);
+                    coverage->addProfileCounts(hits, taken, notTaken);
+                } catch (const SimulatorException& e) {
+                    result.success = false;
+                    result.error = "Bad coverage from " + peer + ": " + e.what();
+                }
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            results[index] = result;
+            finished++;
+        }
+        runsChanged.notify_all();
+    }
+    connection.write("DONE\n");
+}
+
+void FarmCoordinator::printSummary() const {
+    uint32_t passed = 0;
+
+    std::cout << "=== Farm Summary ===" << std::endl;
+    for (size_t i = 0; i < results.size(); ++i) {
+        const FarmResult& result = results[i];
+        std::cout << "[" << i << "] " << result.stimulusFile << ": ";
+        if (result.success) {
+            passed++;
+            std::cout << result.cycles << " cycles, Addr 0x" << std::hex << result.finalAddress << std::dec
+                      << ", active states " << result.activeStates << ", signature " << hexString(result.signature)
+                      << " (" << result.worker << ")";
+        } else {
+            std::cout << "FAILED: " << result.error;
+        }
+        std::cout << std::endl;
+    }
+    std::cout << "Runs: " << results.size() << ", passed: " << passed
+              << ", failed: " << (results.size() - passed) << std::endl;
+    std::cout << "====================" << std::endl;
+}
+
+// One "<signature> <stimulus file>" line per run, in --batch order; failed
+// runs have none
+bool FarmCoordinator::writeSignatures(const std::string& filename) const {
+    std::ofstream file(filename);
+    if (!file.is_open()) {
+        return false;
+    }
+    for (const FarmResult& result : results) {
+        if (result.success) {
+            file << hexString(result.signature) << " " << result.stimulusFile << "\n";
+        }
+    }
+    return static_cast<bool>(file);
+}
+
+bool FarmCoordinator::writeProfile(const std::string& filename) const {
+    if (!coverage) {
+        return false;
+    }
+    if (filename == "-") {
+        writeProfileReport(std::cout, *coverage, memoryLoader);
+        return true;
+    }
+    std::ofstream file(filename);
+    if (!file.is_open()) {
+        return false;
+    }
+    if (endsWith(filename, ".json")) {
+        writeProfileJson(file, *coverage);
+    } else {
+        writeProfileReport(file, *coverage, memoryLoader);
+    }
+    return true;
+}
+
+// --- Worker ---
+
+FarmWorker::FarmWorker(const SimulatorConfig& cfg)
+    : config(cfg)
+    , jobs(cfg.jobs)
+{
+    if (jobs == 0) {
+        jobs = std::max(1u, std::thread::hardware_concurrency());
+    }
+    // HOST:PORT, the host in brackets for an IPv6 address
+    size_t colon = config.workerAddress.rfind(':');
+    if (colon != std::string::npos) {
+        host = config.workerAddress.substr(0, colon);
+        port = config.workerAddress.substr(colon + 1);
+        if (host.size() >= 2 && host.front() == '[' && host.back() == ']') {
+            host = host.substr(1, host.size() - 2);
+        }
+    }
+}
+
+bool FarmWorker::initialize() {
+    if (host.empty() || port.empty()) {
+        lastError = "--worker needs the coordinator as HOST:PORT, got " + config.workerAddress;
+        return false;
+    }
+    if (!memoryLoader.loadProgram(config.basePath, config.sourceFile) || !memoryLoader.isLoaded()) {
+        lastError = "Failed to load memory files from base path: " + config.basePath;
+        return false;
+    }
+    return true;
+}
+
+bool FarmWorker::run() {
+    std::vector<uint32_t> runs(jobs, 0);
+    std::vector<std::string> errors(jobs);
+    std::vector<uint8_t> ok(jobs, 0);
+
+    auto connection = [&](uint32_t job) {
+        ok[job] = serve(runs[job], errors[job]);
+    };
+    std::vector<std::thread> threads;
+    for (uint32_t job = 1; job < jobs; ++job) {
+        threads.emplace_back(connection, job);
+    }
+    connection(0);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    uint32_t total = 0;
+    for (uint32_t count : runs) {
+        total += count;
+    }
+    std::cout << "Worker ran " << total << " runs on " << jobs << " connections to " << config.workerAddress << std::endl;
+    for (uint32_t job = 0; job < jobs; ++job) {
+        if (!ok[job]) {
+            lastError = errors[job];
+            return false;
+        }
+    }
+    return true;
+}
+
+// One connection: runs until the coordinator sends DONE
+bool FarmWorker::serve(uint32_t& runs, std::string& error) const {
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* addresses = nullptr;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &addresses) != 0) {
+        error = "Cannot resolve coordinator " + config.workerAddress;
+        return false;
+    }
+    int fd = -1;
+    for (addrinfo* a = addresses; a && fd < 0; a = a->ai_next) {
+        fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (fd >= 0 && connect(fd, a->ai_addr, a->ai_addrlen) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(addresses);
+    if (fd < 0) {
+        error = "Cannot connect to coordinator " + config.workerAddress;
+        return false;
+    }
+
+    Connection connection(fd);
+    if (!connection.write("HELLO " + hexString(memoryLoader.fingerprint()) + "\n")) {
+        error = "Lost the coordinator " + config.workerAddress;
+        return false;
+    }
+    std::string line;
+    while (connection.readLine(line)) {
+        if (line == "DONE") {
+            return true;
+        }
+        if (startsWith(line, "REJECT")) {
+            error = "Coordinator rejected this worker: " + trim(line.substr(6));
+            return false;
+        }
+
+        std::istringstream in(line);
+        std::string tag;
+        uint32_t index;
+        uint64_t maxCycles;
+        int profile;
+        size_t size;
+        if (!(in >> tag >> index >> maxCycles >> profile >> size) || tag != "RUN") {
+            error = "Unexpected request from the coordinator: " + line;
+            return false;
+        }
+        std::string stimulus;
+        if (!connection.readBytes(stimulus, size)) {
+            break;
+        }
+
+        // StimulusParser reads files, so the stimulus is written to a private one
+        const char* tmpdir = std::getenv("TMPDIR");
+        std::string path = std::string(tmpdir && *tmpdir ? tmpdir : "/tmp") + "/hotstate_farm_XXXXXX";
+        std::vector<char> pathBuffer(path.begin(), path.end());
+        pathBuffer.push_back('\0');
+        int tmp = mkstemp(pathBuffer.data());
+        std::string reply;
+        if (tmp < 0 || ::write(tmp, stimulus.data(), stimulus.size()) != static_cast<ssize_t>(stimulus.size())) {
+            reply = "RESULT " + std::to_string(index) + " failed Cannot write the stimulus on the worker\n";
+        } else {
+            reply = runOne(pathBuffer.data(), index, maxCycles, profile != 0);
+        }
+        if (tmp >= 0) {
+            close(tmp);
+            std::remove(pathBuffer.data());
+        }
+
+        if (!connection.write(reply)) {
+            break;
+        }
+        runs++;
+    }
+    error = "Lost the coordinator " + config.workerAddress;
+    return false;
+}
+
+// The RESULT reply for one run, with its COUNTS line when profiling. The
+// cycle loop is Simulator::run's with --fast-forward, so the signature is
+// the one a single run with --signature writes.
+std::string FarmWorker::runOne(const std::string& stimulusFile, uint32_t index, uint64_t maxCycles,
+                               bool profile) const {
+    std::ostringstream reply;
+    reply << "RESULT " << index << " ";
+    try {
+        StimulusParser stimulus;
+        stimulus.setInputSymbols(&memoryLoader.getInputSymbols());
+        if (!stimulus.loadStimulus(stimulusFile)) {
+            reply << "failed Failed to load the stimulus\n";
+            return reply.str();
+        }
+
+        HotstateModel model(memoryLoader);
+        model.reset();
+        if (profile) {
+            model.enableProfiling();
+        }
+        TraceSignature signature;
+
+        uint64_t cycle = 0;
+        while (cycle < maxCycles) {
+            const std::vector<uint8_t>& inputs = stimulus.getInputs(cycle);
+            if (!stimulus.isEmpty()) {
+                model.setInputs(inputs);
+            }
+            model.setReset(cycle < Simulator::RESET_CYCLES);
+            model.clock();
+            signature.record(cycle, model);
+            cycle++;
+
+            // Whole settled clock periods up to the next stimulus change
+            if (model.isSettled() && model.getClock() && cycle >= Simulator::RESET_CYCLES) {
+                uint64_t end = std::min(stimulus.getNextChangeCycle(cycle - 1), maxCycles);
+                if (end > cycle) {
+                    uint64_t span = std::min<uint64_t>(end - cycle, model.settledCycles());
+                    uint64_t skip = span & ~1ULL;
+                    model.skipCycles(skip);
+                    cycle += skip;
+                }
+            }
+        }
+        signature.finish(cycle);
+
+        reply << "ok " << cycle << " " << std::hex << model.getCurrentAddress() << std::dec << " "
+              << model.getStates().count() << " " << hexString(signature.value()) << "\n";
+        if (profile) {
+            reply << "COUNTS " << model.getAddressHits().size();
+            for (const std::vector<uint64_t>* counts :
+                 {&model.getAddressHits(), &model.getBranchTaken(), &model.getBranchNotTaken()}) {
+                for (uint64_t count : *counts) {
+                    reply << " " << count;
+                }
+            }
+            reply << "\n";
+        }
+    } catch (const SimulatorException& e) {
+        return "RESULT " + std::to_string(index) + " failed " + oneLine(e.what()) + "\n";
+    }
+    return reply.str();
+}
+
+} // namespace HotstateSim
@@ -0,0 +1,102 @@
+#include "run_stats.h"
+#include <iomanip>
+#include <string>
+#include <sys/resource.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace HotstateSim {
+
+namespace {
+
+const char* const PART_NAMES[] = {"Load", "Initialize", "Model", "Stimulus", "Breakpoints", "Logging"};
+
+// Peak resident set size in bytes, 0 if unknown
+uint64_t peakResidentBytes() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+    return static_cast<uint64_t>(usage.ru_maxrss) * 1024;  // Kilobytes on Linux
+}
+
+uint64_t allocationCount() {
+#ifdef HOTSTATE_STATS
+    return heapAllocationCount();
+#else
+    return 0;
+#endif
+}
+
+} // namespace
+
+uint64_t RunStats::ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+void RunStats::startRun() {
+    runStartAllocations = allocationCount();
+    runStart = std::chrono::steady_clock::now();
+    runStartTicks = ticks();
+}
+
+void RunStats::endRun(uint64_t cycles) {
+    runTicks += ticks() - runStartTicks;
+    runSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - runStart).count();
+    runAllocations += allocationCount() - runStartAllocations;
+    runCycles += cycles;
+}
+
+void RunStats::print(std::ostream& out) const {
+    auto milliseconds = [](double seconds) { return seconds * 1e3; };
+    std::ios_base::fmtflags flags = out.flags();
+    out << std::fixed << std::setprecision(3);
+
+    out << "=== Run Statistics ===" << std::endl;
+    for (RunPart part : {RunPart::LOAD, RunPart::INITIALIZE}) {
+        out << std::left << std::setw(13) << (std::string(PART_NAMES[static_cast<int>(part)]) + ":")
+            << std::right << std::setw(12) << milliseconds(partSeconds[static_cast<int>(part)]) << " ms" << std::endl;
+    }
+    out << std::left << std::setw(13) << "Run:" << std::right << std::setw(12) << milliseconds(runSeconds)
+        << " ms for " << runCycles << " cycles";
+    if (runSeconds > 0) {
+        out << " (" << std::setprecision(2) << runCycles / runSeconds / 1e6 << "M cycles/s)" << std::setprecision(3);
+    }
+    out << std::endl;
+
+    if (PARTS_TIMED) {
+        // Ticks to seconds at the rate they went by over the run
+        double secondsPerTick = runTicks > 0 ? runSeconds / runTicks : 0;
+        double timed = 0;
+        for (RunPart part : {RunPart::MODEL, RunPart::STIMULUS, RunPart::BREAKPOINTS, RunPart::LOGGING}) {
+            double seconds = partTicks[static_cast<int>(part)] * secondsPerTick;
+            timed += seconds;
+            out << "  " << std::left << std::setw(12) << (std::string(PART_NAMES[static_cast<int>(part)]) + ":")
+                << std::right << std::setw(11) << milliseconds(seconds) << " ms " << std::setw(6)
+                << std::setprecision(1) << (runSeconds > 0 ? 100 * seconds / runSeconds : 0.0) << "%"
+                << std::setprecision(3) << std::endl;
+        }
+        double other = runSeconds > timed ? runSeconds - timed : 0;
+        out << "  " << std::left << std::setw(12) << "Other:" << std::right << std::setw(11) << milliseconds(other)
+            << " ms " << std::setw(6) << std::setprecision(1) << (runSeconds > 0 ? 100 * other / runSeconds : 0.0)
+            << "%" << std::endl;
+        out << std::left << std::setw(13) << "Allocations:" << std::right << std::setprecision(3)
+            << std::setw(12) << (runCycles > 0 ? static_cast<double>(runAllocations) / runCycles : 0.0)
+            << " per cycle (" << runAllocations << " in the run)" << std::endl;
+    } else {
+        out << "  (model, stimulus, breakpoint and logging times and allocations: make stats)" << std::endl;
+    }
+
+    out << std::left << std::setw(13) << "Peak RSS:" << std::right << std::setprecision(1)
+        << std::setw(12) << peakResidentBytes() / (1024.0 * 1024.0) << " MB" << std::endl;
+    out << "======================" << std::endl;
+    out.flags(flags);
+}
+
+} // namespace HotstateSim
@@ -1,5 +1,8 @@
 #include "simulator.h"
 #include "utils.h"
+#include "profile_report.h"
+#include "activity_report.h"
+#include "random_stimulus.h"
 #include <iostream>
 #include <iomanip>
 #include <fstream>
@@ -7,21 +10,45 @@
 
 namespace HotstateSim {
 
+namespace {
+
+void setIndexBit(std::vector<uint64_t>& bits, uint32_t i) {
+    if (bits.size() <= (i >> 6)) {
+        bits.resize((i >> 6) + 1, 0);
+    }
+    bits[i >> 6] |= 1ULL << (i & 63);
+}
+
+bool testIndexBit(const std::vector<uint64_t>& bits, uint32_t i) {
+    size_t word = i >> 6;
+    return word < bits.size() && ((bits[word] >> (i & 63)) & 1ULL);
+}
+
+} // namespace
+
 Simulator::Simulator(const SimulatorConfig& cfg)
     : config(cfg)
     , state(SimulatorState::IDLE)
     , currentCycle(0)
     , cyclesSinceStart(0)
+    , skippedCycles(0)
     , breakpointHit(false)
+    , nextCheckpointCycle(UINT64_MAX)
+    , recordedCycles(0)
     , debugMode(false)
     , debugPaused(false)
     , breakpointReason("")
 {
     stimulus = std::make_unique<StimulusParser>();
+    indexBreakpoints();
 }
 
 bool Simulator::initialize() {
     state = SimulatorState::LOADING;
+    if (config.stats) {
+        runStats = std::make_unique<RunStats>();
+    }
+    auto loadStart = std::chrono::steady_clock::now();
     
     try {
         // Validate configuration
@@ -37,27 +64,63 @@ bool Simulator::initialize() {
             return false;
         }
         
-        // Load stimulus file
-        if (!config.stimulusFile.empty()) {
+        // Load stimulus file, or generate the stimulus
+        if (config.randomStimulus) {
+            loadRandomStimulus();
+        } else if (!config.stimulusFile.empty()) {
             if (!loadStimulusFile()) {
                 state = SimulatorState::ERROR;
                 return false;
             }
         }
+        auto initializeStart = std::chrono::steady_clock::now();
         
         // Initialize logger
-        if (!initializeLogger()) {
+        if (config.logging && !initializeLogger()) {
             state = SimulatorState::ERROR;
             return false;
         }
         
+        // Golden signature: its checkpoint interval unless --signature-every gives one
+        if (!config.goldenSignatureFile.empty()) {
+            goldenSignature = std::make_unique<TraceSignature>(TraceSignature::load(config.goldenSignatureFile));
+            if (config.signatureInterval == 0) {
+                config.signatureInterval = goldenSignature->getInterval();
+            }
+        }
+        
+        // The plant first, so the model's subscription can wake it; it is
+        // loaded once and only reset if the simulator is initialized again
+        if (!config.plantLibrary.empty() && !plant) {
+            plant = std::make_unique<PlantModel>(config.plantLibrary, config.plantArgs, memoryLoader);
+        }
+        
         // Initialize hotstate model
         initializeHotstate();
+        compileBreakpointExpressions();
+        resetCheckpoints();
         
         // Reset simulation state
         currentCycle = 0;
         cyclesSinceStart = 0;
+        skippedCycles = 0;
+        periodHeldUntil = 0;
+        periodFound = false;
+        period = 0;
+        convergedCycle = 0;
+        periodicSkipped = 0;
         breakpointHit = false;
+        if (plant) {
+            resetPlant();
+        }
+        if (config.soakInterval > 0) {
+            startSoak();
+        }
+        if (runStats) {
+            auto now = std::chrono::steady_clock::now();
+            runStats->addSeconds(RunPart::LOAD, std::chrono::duration<double>(initializeStart - loadStart).count());
+            runStats->addSeconds(RunPart::INITIALIZE, std::chrono::duration<double>(now - initializeStart).count());
+        }
         
         state = SimulatorState::READY;
 
@@ -88,6 +151,16 @@ bool Simulator::initialize() {
 }
 
 bool Simulator::run() {
+    return runTo(config.maxCycles);
+}
+
+bool Simulator::stepToCycle(uint64_t targetCycle) {
+    return runTo(std::min(targetCycle, config.maxCycles));
+}
+
+// run and stepToCycle: the run loop up to stopCycle, paused there unless it
+// is the end of the run
+bool Simulator::runTo(uint64_t stopCycle) {
     if (state != SimulatorState::READY && state != SimulatorState::PAUSED) {
         lastError = "Simulator not ready to run";
         return false;
@@ -99,48 +172,81 @@ bool Simulator::run() {
         std::cout << "Starting simulation..." << std::endl;
     }
     
+    // The per-feature settings cannot change during a run
+    const bool breakpoints = config.enableBreakpoints;
+    const bool debugOutput = config.debugMode;
+    const bool progress = config.verbose && !debugOutput;
+    const bool skipIdle = config.fastForward;
+    const bool periodic = config.periodic != PeriodicMode::OFF;
+    const bool soak = config.soakInterval > 0;
+    // Resuming from a breakpoint: it stopped the run before this cycle, so
+    // it is not checked again until the next
+    bool resumed = breakpointHit;
+    breakpointHit = false;
+    RunStats* stats = runStats.get();
+    uint64_t firstCycle = cyclesSinceStart;
+    if (stats) {
+        stats->startRun();
+    }
+    
     try {
-        while (state == SimulatorState::RUNNING && currentCycle < config.maxCycles) {
+        while (state == SimulatorState::RUNNING && currentCycle < stopCycle) {
             // Check breakpoints
-            if (config.enableBreakpoints) {
-                checkBreakpoints();
+            if (breakpoints && !resumed) {
+                {
+                    ScopedTimer timer(stats, RunPart::BREAKPOINTS);
+                    checkBreakpoints();
+                }
                 if (breakpointHit) {
                     state = SimulatorState::PAUSED;
                     if (config.verbose) {
-                        std::cout << "Breakpoint hit at cycle " << currentCycle << std::endl;
+                        std::cout << "Breakpoint hit at cycle " << currentCycle << ": " << breakpointReason << std::endl;
                     }
                     break;
                 }
             }
+            resumed = false;
             
-            // Apply stimulus for current cycle
-            applyStimulus(currentCycle);
-            
-            // Advance clock
-            advanceClock();
-            
-            // Log the cycle
-            if (logger) {
-                std::vector<uint8_t> inputs = stimulus->getInputs(currentCycle);
-                logger->logCycle(currentCycle, *hotstate, inputs);
-            }
+            simulateCycle();
             
             // Debug output
-            if (config.debugMode) {
+            if (debugOutput) {
                 printDebugInfo(currentCycle);
-            } else if (config.verbose && (currentCycle % 100 == 0)) {
+            } else if (progress && (currentCycle % 100 == 0)) {
                 std::cout << "Cycle: " << currentCycle << std::endl;
             }
             
             currentCycle++;
             cyclesSinceStart++;
+            
+            if (skipIdle) {
+                fastForward(stopCycle);
+            }
+            if (periodic) {
+                checkPeriodic(stopCycle);
+            }
+            if (soak && currentCycle >= soakNextCheck) {
+                checkSoak();
+            }
         }
         
+        if (stats) {
+            stats->endRun(cyclesSinceStart - firstCycle);
+        }
+        if (soak) {
+            printSoakReport(std::chrono::steady_clock::now());
+        }
         if (currentCycle >= config.maxCycles) {
             state = SimulatorState::FINISHED;
             if (config.verbose) {
                 std::cout << "Simulation completed: Maximum cycles reached" << std::endl;
             }
+        } else if (state == SimulatorState::FINISHED && convergedCycle > 0) {
+            if (config.verbose) {
+                std::cout << "Simulation completed: converged at cycle " << convergedCycle << std::endl;
+            }
+        } else if (state == SimulatorState::RUNNING) {
+            state = SimulatorState::PAUSED;
         }
         
         return true;
@@ -173,16 +279,15 @@ bool Simulator::step(uint32_t numCycles) {
     }
     
     state = SimulatorState::RUNNING;
+    breakpointHit = false;
+    uint64_t firstCycle = cyclesSinceStart;
+    if (runStats) {
+        runStats->startRun();
+    }
     
     try {
         for (uint32_t i = 0; i < numCycles && currentCycle < config.maxCycles; ++i) {
-            applyStimulus(currentCycle);
-            advanceClock();
-            
-            if (logger) {
-                std::vector<uint8_t> inputs = stimulus->getInputs(currentCycle);
-                logger->logCycle(currentCycle, *hotstate, inputs);
-            }
+            simulateCycle();
             
             if (config.debugMode) {
                 printDebugInfo(currentCycle);
@@ -192,6 +297,9 @@ bool Simulator::step(uint32_t numCycles) {
             cyclesSinceStart++;
         }
         
+        if (runStats) {
+            runStats->endRun(cyclesSinceStart - firstCycle);
+        }
         state = SimulatorState::PAUSED;
         return true;
         
@@ -212,15 +320,31 @@ void Simulator::pause() {
 }
 
 void Simulator::reset() {
+    currentCycle = 0;
+    cyclesSinceStart = 0;
+    skippedCycles = 0;
+    periodHeldUntil = 0;
+    periodFound = false;
+    period = 0;
+    convergedCycle = 0;
+    periodicSkipped = 0;
     if (hotstate) {
         hotstate->reset();
     }
+    if (plant) {
+        resetPlant();
+    }
+    if (config.soakInterval > 0) {
+        startSoak();
+    }
     
-    currentCycle = 0;
-    cyclesSinceStart = 0;
     breakpointHit = false;
     breakpointReason = "";
     debugPaused = false;
+    if (hotstate) {
+        resetWatchValues();
+        resetCheckpoints();
+    }
 
     // Clear debugger state
     watchVariables.clear();
@@ -256,7 +380,7 @@ bool Simulator::loadMemoryFiles() {
         return false;
     }
     
-    if (!memoryLoader.loadFromBasePath(config.basePath)) {
+    if (!memoryLoader.loadProgram(config.basePath, config.sourceFile)) {
         lastError = "Failed to load memory files from base path: " + config.basePath;
         return false;
     }
@@ -265,7 +389,12 @@ bool Simulator::loadMemoryFiles() {
         lastError = "Memory files not properly loaded";
         return false;
     }
-    
+
+    if (!config.patchFile.empty() && !memoryLoader.applyPatch(config.patchFile)) {
+        lastError = "Failed to apply memory patch " + config.patchFile;
+        return false;
+    }
+
     if (config.verbose) {
         memoryLoader.printMemoryInfo();
     }
@@ -274,6 +403,19 @@ bool Simulator::loadMemoryFiles() {
 }
 
 bool Simulator::loadStimulusFile() {
+    stimulus->setInputSymbols(&memoryLoader.getInputSymbols());
+    if (config.streamStimulus) {
+        if (!stimulus->openStream(config.stimulusFile)) {
+            lastError = "Failed to open stimulus stream: " + config.stimulusFile;
+            return false;
+        }
+        if (config.verbose) {
+            std::cout << "Streaming stimulus with " << StimulusParser::STREAM_READ_AHEAD
+                      << " entries read ahead" << std::endl;
+        }
+        return true;
+    }
+    
     if (!stimulus->loadStimulus(config.stimulusFile)) {
         lastError = "Failed to load stimulus file: " + config.stimulusFile;
         return false;
@@ -286,6 +428,18 @@ bool Simulator::loadStimulusFile() {
     return true;
 }
 
+void Simulator::loadRandomStimulus() {
+    uint64_t seed = config.randomSeed;
+    std::vector<RandomInputRule> rules =
+        RandomStimulus::parseRules(config.randomInputRules, memoryLoader, memoryLoader.getParams().NUM_VARS);
+    stimulus->openSource("random stimulus (seed " + std::to_string(seed) + ")",
+                         [seed, rules] { return std::make_unique<RandomStimulus>(seed, rules); });
+    
+    if (config.verbose) {
+        std::cout << "Random stimulus over " << rules.size() << " inputs with seed " << seed << std::endl;
+    }
+}
+
 bool Simulator::initializeLogger() {
     switch (config.outputFormat) {
         case OutputFormat::CONSOLE:
@@ -300,6 +454,9 @@ bool Simulator::initializeLogger() {
         case OutputFormat::JSON:
             logger = OutputLogger::createJSONLogger(config.outputFile);
             break;
+        case OutputFormat::TRACE:
+            logger = OutputLogger::createTraceLogger(config.outputFile);
+            break;
     }
     
     if (!logger) {
@@ -308,6 +465,8 @@ bool Simulator::initializeLogger() {
     }
     
     logger->setRealTime(config.realTimeOutput);
+    logger->setAsyncOutput(true);
+    logger->setMaxLogEntries(config.logWindow);
     
     // Open file if needed
     if (config.outputFormat != OutputFormat::CONSOLE && !config.outputFile.empty()) {
@@ -317,24 +476,422 @@ bool Simulator::initializeLogger() {
         }
     }
     
+    if (!config.exportFile.empty() && !logger->startExport(config.exportFile, config.exportFormat)) {
+        lastError = "Failed to start export to " + config.exportFile;
+        return false;
+    }
+    
     return true;
 }
 
 void Simulator::initializeHotstate() {
     hotstate = std::make_unique<HotstateModel>(memoryLoader);
     hotstate->reset();
+    if (config.interruptInput != SimulatorConfig::NO_INTERRUPT) {
+        if (hotstate->isPipelined()) {
+            throw SimulatorException("--interrupt needs a program compiled without --pipeline");
+        }
+        if (config.interruptInput >= memoryLoader.getParams().NUM_VARS) {
+            throw SimulatorException("--interrupt input " + std::to_string(config.interruptInput) +
+                                     " is not one of the program's " +
+                                     std::to_string(memoryLoader.getParams().NUM_VARS) + " inputs");
+        }
+        if (config.interruptAddress != SimulatorConfig::NO_INTERRUPT) {
+            hotstate->setInterruptAddress(config.interruptAddress);
+        } else if (hotstate->getInterruptAddress() == 0) {
+            throw SimulatorException("The program has no interrupt handler (INTERRUPT_ADDRESS); give --interrupt-address");
+        }
+    }
+    if (!config.profileFile.empty() || config.soakInterval > 0) {
+        hotstate->enableProfiling();
+    }
+    if (!config.activityFile.empty()) {
+        hotstate->enableActivity();
+    }
+    if (config.soakInterval > 0) {
+        hotstate->subscribeStates([this](uint64_t, const StateBits&, const std::vector<uint64_t>&) { soakStateChanges++; });
+    }
+    if (!stateSubscribers.empty()) {
+        subscribeModel();
+    }
+    if (plant) {
+        hotstate->subscribeStates([this](uint64_t, const StateBits&, const std::vector<uint64_t>&) { plantDue = true; });
+    }
 }
 
-void Simulator::advanceClock() {
-    if (hotstate) {
+uint32_t Simulator::subscribeStates(StateChangeCallback callback) {
+    stateSubscribers.emplace_back(nextSubscriberId, std::move(callback));
+    if (stateSubscribers.size() == 1 && hotstate) {
+        subscribeModel();
+    }
+    return nextSubscriberId++;
+}
+
+void Simulator::unsubscribeStates(uint32_t id) {
+    stateSubscribers.erase(std::remove_if(stateSubscribers.begin(), stateSubscribers.end(),
+                                          [id](const auto& subscriber) { return subscriber.first == id; }),
+                           stateSubscribers.end());
+    if (stateSubscribers.empty() && hotstate) {
+        hotstate->unsubscribeStates(modelSubscription);
+    }
+}
+
+// One model subscription passes every change on, with the run's cycle
+void Simulator::subscribeModel() {
+    modelSubscription = hotstate->subscribeStates(
+        [this](uint64_t, const StateBits& states, const std::vector<uint64_t>& changed) {
+            for (const auto& subscriber : stateSubscribers) {
+                subscriber.second(currentCycle, states, changed);
+            }
+        });
+}
+
+void Simulator::resetPlant() {
+    plantWake = plant->reset(plantInputs);
+    plantDue = false;
+}
+
+void Simulator::startSoak() {
+    soakStart = std::chrono::steady_clock::now();
+    soakLast = soakStart;
+    soakLastCycle = currentCycle;
+    soakNextCheck = currentCycle + SOAK_CHECK_CYCLES;
+    soakStateChanges = 0;
+}
+
+void Simulator::checkSoak() {
+    soakNextCheck = currentCycle + SOAK_CHECK_CYCLES;
+    auto now = std::chrono::steady_clock::now();
+    if (now - soakLast >= std::chrono::seconds(config.soakInterval)) {
+        printSoakReport(now);
+    }
+}
+
+// One line of progress: the rate since the last report and since the
+// start, how much of it was fast-forwarded, and coverage so far
+void Simulator::printSoakReport(std::chrono::steady_clock::time_point now) {
+    double recent = std::chrono::duration<double>(now - soakLast).count();
+    double total = std::chrono::duration<double>(now - soakStart).count();
+    uint64_t seconds = static_cast<uint64_t>(total);
+
+    const std::vector<DecodedMicrocode>& code = hotstate->getDecodedMicrocode();
+    const std::vector<uint64_t>& hits = hotstate->getAddressHits();
+    const std::vector<uint64_t>& taken = hotstate->getBranchTaken();
+    const std::vector<uint64_t>& notTaken = hotstate->getBranchNotTaken();
+    uint32_t reached = 0, branches = 0, directions = 0;
+    for (size_t a = 0; a < code.size() && a < hits.size(); ++a) {
+        reached += hits[a] != 0;
+        if (code[a].branch) {
+            branches++;
+            directions += (taken[a] != 0) + (notTaken[a] != 0);
+        }
+    }
+
+    std::cout << "Soak: cycle " << currentCycle << " (" << std::fixed << std::setprecision(1)
+              << getProgress() * 100 << "%) after " << seconds / 3600 << ":" << std::setfill('0')
+              << std::setw(2) << seconds / 60 % 60 << ":" << std::setw(2) << seconds % 60 << std::setfill(' ')
+              << ", " << (recent > 0 ? (currentCycle - soakLastCycle) / recent / 1e6 : 0.0) << "M cycles/s ("
+              << (total > 0 ? currentCycle / total / 1e6 : 0.0) << "M average), "
+              << (currentCycle > 0 ? 100.0 * skippedCycles / currentCycle : 0.0) << "% fast-forwarded, "
+              << std::defaultfloat << soakStateChanges << " state changes, coverage " << reached << "/"
+              << code.size() << " words, " << directions << "/" << 2 * branches << " branch directions"
+              << std::endl;
+    soakLast = now;
+    soakLastCycle = currentCycle;
+}
+
+// One clock of currentCycle for run, step and debugStep. The stimulus (or
+// the plant's inputs) is looked up once and the same inputs go to the
+// model and the logger.
+void Simulator::simulateCycle() {
+    if (currentCycle >= nextCheckpointCycle) {
+        takeCheckpoint();
+    }
+    RunStats* stats = runStats.get();
+    const std::vector<uint8_t>* inputs;
+    {
+        ScopedTimer timer(stats, RunPart::STIMULUS);
+        if (plant && (plantDue || currentCycle >= plantWake)) {
+            plantDue = false;
+            plantWake = plant->update(currentCycle, hotstate->getStates(), plantInputs);
+        }
+        inputs = plant ? &plantInputs : &stimulus->getInputs(currentCycle);
+        if (plant || !stimulus->isEmpty()) {
+            hotstate->setInputs(*inputs);
+        }
+        if (config.interruptInput < inputs->size()) {
+            hotstate->setInterrupt((*inputs)[config.interruptInput] != 0);
+        }
+    }
+    {
+        ScopedTimer timer(stats, RunPart::MODEL);
+        hotstate->setReset(currentCycle < RESET_CYCLES);
         hotstate->clock();
     }
+    if (currentCycle >= recordedCycles) {
+        ScopedTimer timer(stats, RunPart::LOGGING);
+        if (logger) {
+            logger->logCycle(currentCycle, *hotstate, *inputs);
+        }
+        if (signature) {
+            signature->record(currentCycle, *hotstate);
+        }
+        recordedCycles = currentCycle + 1;
+    }
 }
 
-void Simulator::applyStimulus(uint32_t cycle) {
-    if (stimulus && !stimulus->isEmpty()) {
-        std::vector<uint8_t> inputs = stimulus->getInputs(cycle);
-        hotstate->setInputs(inputs);
+void Simulator::resetCheckpoints() {
+    checkpoints.clear();
+    recordedCycles = 0;
+    if (!config.signatureFile.empty() || !config.goldenSignatureFile.empty()) {
+        signature = std::make_unique<TraceSignature>(config.signatureInterval);
+    }
+    takeCheckpoint();
+}
+
+void Simulator::takeCheckpoint() {
+    checkpoints.push_back({currentCycle, cyclesSinceStart, skippedCycles, periodicSkipped, hotstate->saveSnapshot()});
+    scheduleCheckpoint();
+}
+
+void Simulator::addCheckpoint() {
+    if (!hotstate) {
+        return;
+    }
+    // One per cycle: a later one at the same cycle replaces the last
+    if (!checkpoints.empty() && checkpoints.back().cycle == currentCycle) {
+        checkpoints.pop_back();
+    }
+    takeCheckpoint();
+}
+
+void Simulator::scheduleCheckpoint() {
+    uint32_t interval = config.checkpointInterval;
+    nextCheckpointCycle = interval == 0 ? UINT64_MAX : currentCycle + interval;
+}
+
+bool Simulator::restoreToCycle(uint64_t cycle) {
+    if (!hotstate || checkpoints.empty()) {
+        lastError = "Simulator not initialized";
+        return false;
+    }
+    if (cycle > currentCycle) {
+        lastError = "Cannot restore cycle " + std::to_string(cycle) + ": the simulation is at cycle " +
+                    std::to_string(currentCycle);
+        return false;
+    }
+    if (stimulus->isStreaming()) {
+        lastError = "Cannot restore earlier cycles with a streamed stimulus";
+        return false;
+    }
+    if (plant) {
+        lastError = "Cannot restore earlier cycles of a closed-loop run: the plant cannot go back";
+        return false;
+    }
+    
+    // checkpoints[0] is cycle 0, so there always is one at or before cycle
+    auto it = std::upper_bound(checkpoints.begin(), checkpoints.end(), cycle,
+                               [](uint64_t c, const Checkpoint& cp) { return c < cp.cycle; });
+    --it;
+    currentCycle = it->cycle;
+    cyclesSinceStart = it->cyclesSinceStart;
+    skippedCycles = it->skippedCycles;
+    periodicSkipped = it->periodicSkipped;
+    hotstate->restoreSnapshot(it->model);
+    periodHeldUntil = 0;  // The detector starts over from the replayed cycle
+    periodFound = false;
+    convergedCycle = 0;
+    
+    // Later checkpoints are taken again as the replay passes them
+    checkpoints.erase(it + 1, checkpoints.end());
+    scheduleCheckpoint();
+    
+    try {
+        while (currentCycle < cycle) {
+            simulateCycle();
+            currentCycle++;
+            cyclesSinceStart++;
+        }
+    } catch (const SimulatorException& e) {
+        lastError = e.what();
+        state = SimulatorState::ERROR;
+        return false;
+    }
+    
+    resetWatchValues();
+    breakpointHit = false;
+    breakpointReason = "";
+    state = SimulatorState::PAUSED;
+    return true;
+}
+
+bool Simulator::stepBack(uint32_t numCycles) {
+    return restoreToCycle(numCycles < currentCycle ? currentCycle - numCycles : 0);
+}
+
+bool Simulator::swapProgram(const std::string& basePath, const std::string& sourceFile) {
+    MemoryLoader memory;
+    if (!memory.loadProgram(basePath, sourceFile)) {
+        lastError = "Failed to load the program to swap in from " + (sourceFile.empty() ? basePath : sourceFile);
+        return false;
+    }
+    if (!restartProgram(memory)) {
+        return false;
+    }
+    config.basePath = basePath;
+    config.sourceFile = sourceFile;
+    return true;
+}
+
+bool Simulator::swapProgram(const MemoryLoader& memory) {
+    MemoryLoader copy = memory;
+    return restartProgram(copy);
+}
+
+bool Simulator::applyPatch(const std::string& patchFile) {
+    // Patched on a copy, so a bad patch leaves the program as it was
+    MemoryLoader patched = memoryLoader;
+    if (!patched.applyPatch(patchFile)) {
+        lastError = "Failed to apply memory patch " + patchFile;
+        return false;
+    }
+    return restartProgram(patched);
+}
+
+// Makes memory the program, leaving the old one in it, and resets; the old
+// program comes back if the model or the breakpoints reject the new one.
+// Only the model is rebuilt: the stimulus and logger are kept as they are.
+bool Simulator::restartProgram(MemoryLoader& memory) {
+    if (!hotstate) {
+        lastError = "Simulator not initialized";
+        return false;
+    }
+    if (state == SimulatorState::RUNNING) {
+        lastError = "Cannot swap the program during a run";
+        return false;
+    }
+    
+    // The model refers to memoryLoader's memories, so it is rebuilt either way
+    std::swap(memoryLoader, memory);
+    try {
+        initializeHotstate();
+        compileBreakpointExpressions();
+    } catch (const SimulatorException& e) {
+        lastError = e.what();
+        std::swap(memoryLoader, memory);
+        initializeHotstate();
+        compileBreakpointExpressions();
+        return false;
+    }
+    
+    reset();
+    if (config.verbose) {
+        std::cout << "Swapped in a program of " << memoryLoader.getSmdataSize() << " microcode words" << std::endl;
+    }
+    return true;
+}
+
+void Simulator::fastForward(uint64_t stopCycle) {
+    // Only right after a settled rising edge: its inputs are the ones held
+    // until the next stimulus entry (or the plant's wake cycle), so every
+    // cycle before that repeats it, up to a running timer reaching zero
+    if (!hotstate->isSettled() || !hotstate->getClock() || currentCycle < RESET_CYCLES || plantDue) {
+        return;
+    }
+    
+    uint64_t nextChange = plant ? plantWake : stimulus ? stimulus->getNextChangeCycle(currentCycle - 1) : UINT64_MAX;
+    uint64_t end = std::min(nextChange, stopCycle);
+    if (end <= currentCycle) {
+        return;
+    }
+    
+    // Whole clock periods only; an odd cycle left over is simulated as usual
+    uint64_t span = std::min<uint64_t>(end - currentCycle, hotstate->settledCycles());
+    uint64_t skip = span & ~1ULL;
+    if (skip == 0) {
+        return;
+    }
+    
+    hotstate->skipCycles(skip);
+    currentCycle += skip;
+    cyclesSinceStart += skip;
+    skippedCycles += skip;
+}
+
+void Simulator::checkPeriodic(uint64_t stopCycle) {
+    // Sampled right after each rising edge out of reset, as fastForward is
+    if (!hotstate->getClock() || currentCycle < RESET_CYCLES) {
+        return;
+    }
+    uint64_t cycle = currentCycle - 1;
+    if (cycle >= periodHeldUntil) {
+        // The inputs may have changed for this edge: start over from it
+        periodDetector.restart();
+        periodFound = false;
+        periodHeldUntil = stimulus ? stimulus->getNextChangeCycle(cycle) : UINT64_MAX;
+    }
+    if (periodFound) {
+        return;
+    }
+    uint64_t edges = periodDetector.observe(*hotstate);
+    if (edges == 0) {
+        return;
+    }
+    periodFound = true;
+    period = 2 * edges;
+    if (config.verbose) {
+        std::cout << "Periodic from cycle " << currentCycle << " with a period of " << period << " cycles" << std::endl;
+    }
+    
+    if (config.periodic == PeriodicMode::STOP) {
+        // Converged only if the inputs stay held for the rest of the run
+        if (periodHeldUntil == UINT64_MAX) {
+            convergedCycle = currentCycle;
+            state = SimulatorState::FINISHED;
+        }
+        return;
+    }
+    
+    // Whole periods only; the cycles left over are simulated as usual
+    uint64_t end = std::min(periodHeldUntil, stopCycle);
+    uint64_t skip = end > currentCycle ? (end - currentCycle) / period * period : 0;
+    if (skip == 0) {
+        return;
+    }
+    hotstate->repeatCycles(skip);
+    currentCycle += skip;
+    cyclesSinceStart += skip;
+    skippedCycles += skip;
+    periodicSkipped += skip;
+}
+
+void Simulator::indexBreakpoints() {
+    breakpointStateMask.clear();
+    breakpointAddressMap.clear();
+    for (uint32_t stateValue : config.breakpointStates) {
+        setIndexBit(breakpointStateMask, stateValue);
+    }
+    for (uint32_t addr : config.breakpointAddresses) {
+        setIndexBit(breakpointAddressMap, addr);
+    }
+}
+
+void Simulator::compileBreakpointExpressions() {
+    conditionBreakpoints.clear();
+    watchBreakpoints.clear();
+    for (const std::string& text : config.breakpointConditions) {
+        conditionBreakpoints.emplace_back(text, memoryLoader, *hotstate);
+    }
+    for (const std::string& text : config.breakpointWatches) {
+        BreakpointPredicate expr(text, memoryLoader, *hotstate);
+        uint32_t value = expr.evaluate(*hotstate);
+        watchBreakpoints.push_back({std::move(expr), value});
+    }
+}
+
+void Simulator::resetWatchValues() {
+    for (ValueWatch& watch : watchBreakpoints) {
+        watch.value = watch.expr.evaluate(*hotstate);
     }
 }
 
@@ -343,36 +900,68 @@ void Simulator::checkBreakpoints() {
     
     if (!hotstate) return;
     
-    // Check state breakpoints
-    for (uint32_t stateValue : config.breakpointStates) {
-        auto states = hotstate->getStates();
-        if (stateValue < states.size() && states[stateValue]) {
-            breakpointHit = true;
-            breakpointReason = "State[" + std::to_string(stateValue) + "] = 1";
-            if (config.debugMode) {
-                std::cout << "State breakpoint hit: state[" << stateValue << "] = 1" << std::endl;
+    // Check state breakpoints: one AND per state word (a single word for up
+    // to 64 states); the list is only walked to report which one hit
+    const std::vector<uint64_t>& stateWords = hotstate->getStates().getWords();
+    size_t words = std::min(stateWords.size(), breakpointStateMask.size());
+    uint64_t stateHits = 0;
+    for (size_t w = 0; w < words; ++w) {
+        stateHits |= stateWords[w] & breakpointStateMask[w];
+    }
+    if (stateHits != 0) {
+        const auto& states = hotstate->getStates();
+        for (uint32_t stateValue : config.breakpointStates) {
+            if (stateValue < states.size() && states[stateValue]) {
+                breakpointHit = true;
+                breakpointReason = "State[" + std::to_string(stateValue) + "] = 1";
+                if (config.debugMode) {
+                    std::cout << "State breakpoint hit: state[" << stateValue << "] = 1" << std::endl;
+                }
+                break;
             }
-            break;
         }
     }
     
     // Check address breakpoints
     if (!breakpointHit) {
         uint32_t currentAddr = hotstate->getCurrentAddress();
-        for (uint32_t addr : config.breakpointAddresses) {
-            if (currentAddr == addr) {
-                breakpointHit = true;
-                breakpointReason = "Address = 0x" + toHexString(addr);
-                if (config.debugMode) {
-                    std::cout << "Address breakpoint hit: address = 0x" << std::hex << addr << std::dec << std::endl;
-                }
-                break;
+        if (testIndexBit(breakpointAddressMap, currentAddr)) {
+            breakpointHit = true;
+            breakpointReason = "Address = 0x" + toHexString(currentAddr);
+            if (config.debugMode) {
+                std::cout << "Address breakpoint hit: address = 0x" << std::hex << currentAddr << std::dec << std::endl;
+            }
+        }
+    }
+    
+    // Check condition breakpoints
+    for (size_t i = 0; !breakpointHit && i < conditionBreakpoints.size(); ++i) {
+        if (conditionBreakpoints[i].evaluate(*hotstate)) {
+            breakpointHit = true;
+            breakpointReason = conditionBreakpoints[i].getText();
+            if (config.debugMode) {
+                std::cout << "Condition breakpoint hit: " << breakpointReason << std::endl;
+            }
+        }
+    }
+    
+    // Check watch breakpoints; every watch takes its new value, so one
+    // change stops the run once
+    for (ValueWatch& watch : watchBreakpoints) {
+        uint32_t value = watch.expr.evaluate(*hotstate);
+        if (value != watch.value && !breakpointHit) {
+            breakpointHit = true;
+            breakpointReason = watch.expr.getText() + " changed from " + std::to_string(watch.value) +
+                               " to " + std::to_string(value);
+            if (config.debugMode) {
+                std::cout << "Watch breakpoint hit: " << breakpointReason << std::endl;
             }
         }
+        watch.value = value;
     }
 }
 
-void Simulator::printDebugInfo(uint32_t cycle) {
+void Simulator::printDebugInfo(uint64_t cycle) {
     std::cout << "=== Debug Info - Cycle " << cycle << " ===" << std::endl;
     if (hotstate) {
         hotstate->printState();
@@ -381,7 +970,7 @@ void Simulator::printDebugInfo(uint32_t cycle) {
     std::cout << "=================================" << std::endl;
 }
 
-void Simulator::printCycleInfo(uint32_t cycle) {
+void Simulator::printCycleInfo(uint64_t cycle) {
     std::cout << "Cycle: " << std::setw(6) << cycle;
     if (hotstate) {
         std::cout << ", Addr: 0x" << std::hex << std::setw(4) << hotstate->getCurrentAddress() << std::dec;
@@ -409,9 +998,24 @@ bool Simulator::validateConfiguration() {
     return true;
 }
 
+void Simulator::printRunStats() const {
+    if (runStats) {
+        runStats->print(std::cout);
+    }
+}
+
 void Simulator::printStatistics() const {
     std::cout << "=== Simulation Statistics ===" << std::endl;
     std::cout << "Total cycles simulated: " << cyclesSinceStart << std::endl;
+    if (config.fastForward) {
+        std::cout << "Idle cycles fast-forwarded: " << skippedCycles - periodicSkipped << std::endl;
+    }
+    if (config.periodic == PeriodicMode::SKIP) {
+        std::cout << "Periodic cycles skipped: " << periodicSkipped << std::endl;
+    }
+    if (convergedCycle > 0) {
+        std::cout << "Converged at cycle " << convergedCycle << " with a period of " << period << " cycles" << std::endl;
+    }
     std::cout << "Final state: " << stateToString(state) << std::endl;
     
     if (logger) {
@@ -453,23 +1057,49 @@ void Simulator::printMemoryInfo() const {
 void Simulator::addStateBreakpoint(uint32_t stateValue) {
     config.breakpointStates.push_back(stateValue);
     config.enableBreakpoints = true;
+    indexBreakpoints();
 }
 
 void Simulator::addAddressBreakpoint(uint32_t address) {
     config.breakpointAddresses.push_back(address);
     config.enableBreakpoints = true;
+    indexBreakpoints();
+}
+
+void Simulator::addConditionBreakpoint(const std::string& expression) {
+    if (hotstate) {
+        conditionBreakpoints.emplace_back(expression, memoryLoader, *hotstate);
+    }
+    config.breakpointConditions.push_back(expression);
+    config.enableBreakpoints = true;
+}
+
+void Simulator::addWatchBreakpoint(const std::string& expression) {
+    if (hotstate) {
+        BreakpointPredicate expr(expression, memoryLoader, *hotstate);
+        uint32_t value = expr.evaluate(*hotstate);
+        watchBreakpoints.push_back({std::move(expr), value});
+    }
+    config.breakpointWatches.push_back(expression);
+    config.enableBreakpoints = true;
 }
 
 void Simulator::clearBreakpoints() {
     config.breakpointStates.clear();
     config.breakpointAddresses.clear();
+    config.breakpointConditions.clear();
+    config.breakpointWatches.clear();
+    conditionBreakpoints.clear();
+    watchBreakpoints.clear();
     config.enableBreakpoints = false;
+    indexBreakpoints();
 }
 
 void Simulator::listBreakpoints() const {
     std::cout << "=== Breakpoints ===" << std::endl;
     
-    if (config.breakpointStates.empty() && config.breakpointAddresses.empty()) {
+    if (config.breakpointStates.empty() && config.breakpointAddresses.empty() &&
+        config.breakpointConditions.empty() && config.breakpointWatches.empty()) {
         std::cout << "No breakpoints set" << std::endl;
     } else {
         if (!config.breakpointStates.empty()) {
@@ -487,6 +1117,14 @@ void Simulator::listBreakpoints() const {
             }
             std::cout << std::endl;
         }
+        
+        for (const std::string& text : config.breakpointConditions) {
+            std::cout << "Condition: " << text << std::endl;
+        }
+        
+        for (const std::string& text : config.breakpointWatches) {
+            std::cout << "Watch: " << text << std::endl;
+        }
     }
     
     std::cout << "===================" << std::endl;
@@ -501,6 +1139,18 @@ bool Simulator::exportResults(const std::string& filename, OutputFormat format)
     return logger->exportToFile(filename, format);
 }
 
+bool Simulator::finishExport() {
+    if (!logger) {
+        lastError = "No logger available for export";
+        return false;
+    }
+    if (!logger->isExporting() || !logger->finishExport()) {
+        lastError = "Failed to write export file";
+        return false;
+    }
+    return true;
+}
+
 bool Simulator::exportTrace(const std::string& filename) {
     return exportResults(filename, OutputFormat::CSV);
 }
@@ -532,6 +1182,92 @@ bool Simulator::exportSummary(const std::string& filename) {
     return true;
 }
 
+bool Simulator::writeProfile(const std::string& filename) {
+    if (!hotstate || !hotstate->isProfiling()) {
+        lastError = "No profile: run with --profile";
+        return false;
+    }
+    if (filename == "-") {
+        writeProfileReport(std::cout, *hotstate, memoryLoader);
+        return true;
+    }
+    std::ofstream file(filename);
+    if (!file.is_open()) {
+        lastError = "Failed to open profile file: " + filename;
+        return false;
+    }
+    bool json = filename.size() >= 5 && filename.compare(filename.size() - 5, 5, ".json") == 0;
+    if (json) {
+        writeProfileJson(file, *hotstate);
+    } else {
+        writeProfileReport(file, *hotstate, memoryLoader);
+    }
+    return true;
+}
+
+bool Simulator::writeActivity(const std::string& filename) {
+    if (!hotstate || !hotstate->isCountingActivity()) {
+        lastError = "No switching activity: run with --activity";
+        return false;
+    }
+    if (filename == "-") {
+        writeActivityReport(std::cout, *hotstate, memoryLoader);
+        return true;
+    }
+    std::ofstream file(filename);
+    if (!file.is_open()) {
+        lastError = "Failed to open activity file: " + filename;
+        return false;
+    }
+    bool saif = filename.size() >= 5 && filename.compare(filename.size() - 5, 5, ".saif") == 0;
+    if (saif) {
+        // The generated testbench's module, named for the source file
+        std::string design = config.basePath.substr(config.basePath.find_last_of('/') + 1);
+        writeActivitySaif(file, *hotstate, memoryLoader, design);
+    } else {
+        writeActivityReport(file, *hotstate, memoryLoader);
+    }
+    return true;
+}
+
+bool Simulator::writeSignature(const std::string& filename) {
+    if (!signature) {
+        lastError = "No signature: run with --signature";
+        return false;
+    }
+    signature->finish(currentCycle);
+    if (!signature->save(filename)) {
+        lastError = "Failed to write signature file: " + filename;
+        return false;
+    }
+    return true;
+}
+
+bool Simulator::compareSignature() {
+    if (!signature || !goldenSignature) {
+        lastError = "No golden signature: run with --compare-signature";
+        return false;
+    }
+    signature->finish(currentCycle);
+    try {
+        const TraceSignature& golden = *goldenSignature;
+        TraceSignature::Divergence divergence = TraceSignature::compare(golden, *signature);
+        if (!divergence.match) {
+            lastError = "Run differs from " + config.goldenSignatureFile + ", first in cycles [" +
+                        std::to_string(divergence.firstCycle) + ", " + std::to_string(divergence.lastCycle) + ")";
+            if (golden.getCycles() != signature->getCycles()) {
+                lastError += " (golden ran " + std::to_string(golden.getCycles()) + " cycles, this run " +
+                             std::to_string(signature->getCycles()) + ")";
+            }
+            return false;
+        }
+    } catch (const SimulatorException& e) {
+        lastError = e.what();
+        return false;
+    }
+    return true;
+}
+
 // === DEBUGGER IMPLEMENTATION ===
 
 void Simulator::enterDebugMode() {
@@ -559,17 +1295,7 @@ bool Simulator::debugStep() {
         return false;
     }
 
-    // Apply stimulus for current cycle
-    applyStimulus(currentCycle);
-
-    // Advance clock
-    advanceClock();
-
-    // Log the cycle
-    if (logger) {
-        std::vector<uint8_t> inputs = stimulus->getInputs(currentCycle);
-        logger->logCycle(currentCycle, *hotstate, inputs);
-    }
+    simulateCycle();
 
     currentCycle++;
     cyclesSinceStart++;
@@ -600,7 +1326,7 @@ void Simulator::inspectState() const {
     std::cout << "=== State Inspection ===" << std::endl;
     std::cout << "Current Address: 0x" << std::hex << hotstate->getCurrentAddress() << std::dec << std::endl;
     std::cout << "States: ";
-    auto states = hotstate->getStates();
+    const auto& states = hotstate->getStates();
     for (size_t i = 0; i < states.size(); ++i) {
         std::cout << states[i];
     }
@@ -627,9 +1353,9 @@ void Simulator::inspectMicrocode() const {
     uint32_t addr = hotstate->getCurrentAddress();
     std::cout << "Current Address: 0x" << std::hex << addr << std::dec << std::endl;
 
-    if (addr < memoryLoader.getSmdata().size()) {
-        uint64_t microcode = memoryLoader.getSmdata()[addr];
-        std::cout << "Microcode: 0x" << std::hex << microcode << std::dec << std::endl;
+    if (addr < memoryLoader.getSmdataSize()) {
+        std::cout << "Microcode: 0x"
+                  << wideHexString(memoryLoader.getSmdataEntry(addr), memoryLoader.getSmdataWords()) << std::endl;
     }
 
     hotstate->printMicrocode();
@@ -681,7 +1407,7 @@ void Simulator::inspectInputs() const {
 
     // Show stimulus inputs if available
     if (stimulus && !stimulus->isEmpty()) {
-        std::vector<uint8_t> stimulusInputs = stimulus->getInputs(currentCycle);
+        const std::vector<uint8_t>& stimulusInputs = stimulus->getInputs(currentCycle);
         std::cout << "Stimulus Inputs: [";
         for (size_t i = 0; i < stimulusInputs.size(); ++i) {
             if (i > 0) std::cout << ", ";
@@ -802,7 +1528,7 @@ void Simulator::evaluateWatches() const {
         }
     }
 
-    auto states = hotstate->getStates();
+    const auto& states = hotstate->getStates();
     for (size_t i = 0; i < watchStates.size(); ++i) {
         uint32_t stateIndex = watchStates[i];
         if (stateIndex < states.size()) {
@@ -820,9 +1546,10 @@ void Simulator::printCurrentInstruction() const {
     uint32_t addr = hotstate->getCurrentAddress();
     std::cout << "Address: 0x" << std::hex << addr << std::dec << std::endl;
 
-    if (addr < memoryLoader.getSmdata().size()) {
-        uint64_t microcode = memoryLoader.getSmdata()[addr];
-        std::cout << "Microcode: 0x" << std::hex << microcode << std::dec << std::endl;
+    if (addr < memoryLoader.getSmdataSize()) {
+        uint64_t microcode = memoryLoader.getSmdataEntry(addr)[0];
+        std::cout << "Microcode: 0x"
+                  << wideHexString(memoryLoader.getSmdataEntry(addr), memoryLoader.getSmdataWords()) << std::endl;
 
         // Decode the microcode fields
         std::cout << "Decoded fields:" << std::endl;
@@ -843,9 +1570,9 @@ void Simulator::printCurrentInstruction() const {
 void Simulator::printMicrocodeAt(uint32_t address) const {
     std::cout << "=== Microcode at Address 0x" << std::hex << address << std::dec << " ===" << std::endl;
 
-    if (address < memoryLoader.getSmdata().size()) {
-        uint64_t microcode = memoryLoader.getSmdata()[address];
-        std::cout << "Microcode: 0x" << std::hex << microcode << std::dec << std::endl;
+    if (address < memoryLoader.getSmdataSize()) {
+        std::cout << "Microcode: 0x"
+                  << wideHexString(memoryLoader.getSmdataEntry(address), memoryLoader.getSmdataWords()) << std::endl;
     } else {
         std::cout << "Address out of range" << std::endl;
     }
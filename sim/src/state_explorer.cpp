@@ -0,0 +1,387 @@
+#include "state_explorer.h"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+
+namespace HotstateSim {
+
+namespace {
+
+constexpr uint64_t BATCH_STATES = 1 << 16;  // Expanded between merges, bounds the successor buffer
+constexpr uint64_t CHUNK_STATES = 1024;     // Claimed by a worker at a time
+constexpr uint32_t MAX_SUCCESSORS = 2;
+
+// Bits to hold every value up to and including n
+uint32_t bitsFor(uint64_t n) {
+    uint32_t bits = 1;
+    while (bits < 64 && (n >> bits) != 0) {
+        bits++;
+    }
+    return bits;
+}
+
+class BitWriter {
+public:
+    explicit BitWriter(uint64_t* words) : words(words), position(0) {}
+    void put(uint64_t value, uint32_t bits) {
+        uint32_t offset = position & 63;
+        words[position >> 6] |= value << offset;
+        if (offset + bits > 64) {
+            words[(position >> 6) + 1] |= value >> (64 - offset);
+        }
+        position += bits;
+    }
+private:
+    uint64_t* words;
+    uint32_t position;
+};
+
+class BitReader {
+public:
+    explicit BitReader(const uint64_t* words, uint32_t position = 0) : words(words), position(position) {}
+    uint64_t get(uint32_t bits) {
+        uint32_t offset = position & 63;
+        uint64_t value = words[position >> 6] >> offset;
+        if (offset + bits > 64) {
+            value |= words[(position >> 6) + 1] << (64 - offset);
+        }
+        position += bits;
+        return bits == 64 ? value : value & ((1ULL << bits) - 1);
+    }
+private:
+    const uint64_t* words;
+    uint32_t position;
+};
+
+std::string hexAddress(uint32_t address) {
+    std::ostringstream out;
+    out << "0x" << std::hex << std::uppercase << std::setw(2) << std::setfill('0') << address;
+    return out.str();
+}
+
+std::string percent(uint64_t part, uint64_t whole) {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(1) << (whole ? 100.0 * part / whole : 0.0) << "%";
+    return out.str();
+}
+
+} // namespace
+
+StateExplorer::StateExplorer(const MemoryLoader& memory, uint32_t jobs, uint64_t stateLimit)
+    : memory(memory)
+    , jobs(jobs)
+    , stateLimit(std::min<uint64_t>(stateLimit, UINT32_MAX - 1))
+    , prototype(memory)
+    , stateCount(0)
+    , levels(0)
+    , complete(false)
+    , maxStackDepth(0)
+{
+    if (this->jobs == 0) {
+        this->jobs = std::max(1u, std::thread::hardware_concurrency());
+    }
+    // A state is keyed by one address; the registered fetch adds another
+    if (memory.getParams().PIPELINED) {
+        throw SimulatorException("State exploration does not support PIPELINED programs");
+    }
+
+    // Out of reset with the clock low, so a tick() is one rising edge
+    prototype.reset();
+    prototype.setReset(false);
+    initial = prototype.saveSnapshot();
+
+    const Parameters& params = memory.getParams();
+    uint32_t words = static_cast<uint32_t>(prototype.getDecodedMicrocode().size());
+    // Addresses wrap at NUM_WORDS; return addresses can be one past the last word
+    addressBits = bitsFor(std::max(words, params.NUM_WORDS));
+    stackDepth = prototype.getStackDepth();
+    stackPointerBits = bitsFor(stackDepth);
+    timerBits = params.TIM_WIDTH == 0 || params.TIM_WIDTH >= 32 ? 32 : params.TIM_WIDTH;
+    numStates = initial.states.size();
+    numTimers = static_cast<uint32_t>(initial.timerCounts.size());
+    uint32_t keyBits = addressBits + stackPointerBits + stackDepth * addressBits + numStates +
+                       numTimers * timerBits;
+    keyWords = (keyBits + 63) / 64;
+
+    // Per address, plus one entry for addresses past the microcode
+    const VardataImage& lut = prototype.getVardataImage();
+    inputChoices.assign(2 * (words + 1), -1);
+    for (uint32_t a = 0; a <= words; ++a) {
+        const DecodedMicrocode* code = a < words ? &prototype.getDecodedMicrocode()[a] : nullptr;
+        if (code && code->branch && !code->varOrTimer) {
+            inputChoices[2 * a] = lut.witness(code->varSel, false);
+            inputChoices[2 * a + 1] = lut.witness(code->varSel, true);
+        } else {
+            inputChoices[2 * a] = 0;
+        }
+    }
+}
+
+void StateExplorer::pack(const HotstateSnapshot& snapshot, uint64_t* key) const {
+    std::fill(key, key + keyWords, 0);
+    BitWriter writer(key);
+    writer.put(snapshot.address, addressBits);
+    writer.put(snapshot.stackPointer, stackPointerBits);
+    // Slots above the stack pointer are dead: a call overwrites them before a return reads them
+    for (uint32_t i = 0; i < stackDepth; ++i) {
+        writer.put(i < snapshot.stackPointer ? snapshot.stack[i] : 0, addressBits);
+    }
+    const std::vector<uint64_t>& stateWords = snapshot.states.getWords();
+    for (uint32_t bit = 0; bit < numStates; bit += 64) {
+        writer.put(stateWords[bit / 64], std::min(64u, numStates - bit));
+    }
+    for (uint32_t count : snapshot.timerCounts) {
+        writer.put(count, timerBits);
+    }
+}
+
+void StateExplorer::unpack(const uint64_t* key, HotstateSnapshot& snapshot) const {
+    BitReader reader(key);
+    snapshot.address = static_cast<uint32_t>(reader.get(addressBits));
+    snapshot.stackPointer = static_cast<uint32_t>(reader.get(stackPointerBits));
+    for (uint32_t i = 0; i < stackDepth; ++i) {
+        snapshot.stack[i] = static_cast<uint32_t>(reader.get(addressBits));
+    }
+    std::vector<uint64_t> stateWords((numStates + 63) / 64, 0);
+    for (uint32_t bit = 0; bit < numStates; bit += 64) {
+        stateWords[bit / 64] = reader.get(std::min(64u, numStates - bit));
+    }
+    snapshot.states = StateBits(stateWords.data(), numStates);
+    for (uint32_t& count : snapshot.timerCounts) {
+        count = static_cast<uint32_t>(reader.get(timerBits));
+    }
+}
+
+uint32_t StateExplorer::keyAddress(const uint64_t* key) const {
+    return static_cast<uint32_t>(BitReader(key).get(addressBits));
+}
+
+uint32_t StateExplorer::keyStackPointer(const uint64_t* key) const {
+    return static_cast<uint32_t>(BitReader(key, addressBits).get(stackPointerBits));
+}
+
+// xxHash64 rounds over the key words
+uint64_t StateExplorer::hashKey(const uint64_t* key) const {
+    uint64_t hash = 0x27D4EB2F165667C5ULL + keyWords * 8;
+    for (uint32_t i = 0; i < keyWords; ++i) {
+        uint64_t lane = key[i] * 0xC2B2AE3D27D4EB4FULL;
+        lane = (lane << 31) | (lane >> 33);
+        hash ^= lane * 0x9E3779B185EBCA87ULL;
+        hash = ((hash << 27) | (hash >> 37)) * 0x9E3779B185EBCA87ULL + 0x85EBCA77C2B2AE63ULL;
+    }
+    hash ^= hash >> 33;
+    hash *= 0xC2B2AE3D27D4EB4FULL;
+    hash ^= hash >> 29;
+    return hash;
+}
+
+uint64_t StateExplorer::find(const uint64_t* key, bool& found) const {
+    uint64_t mask = slots.size() - 1;
+    for (uint64_t slot = hashKey(key) & mask;; slot = (slot + 1) & mask) {
+        if (slots[slot] == 0) {
+            found = false;
+            return slot;
+        }
+        if (std::equal(key, key + keyWords, keyAt(slots[slot] - 1))) {
+            found = true;
+            return slot;
+        }
+    }
+}
+
+void StateExplorer::add(const uint64_t* key, uint64_t slot) {
+    keys.insert(keys.end(), key, key + keyWords);
+    slots[slot] = static_cast<uint32_t>(++stateCount);
+    uint32_t address = keyAddress(key);
+    if (address < reachedAddress.size()) {
+        reachedAddress[address] = true;
+    }
+    maxStackDepth = std::max(maxStackDepth, keyStackPointer(key));
+    if (stateCount * 2 > slots.size()) {
+        grow();
+    }
+}
+
+void StateExplorer::grow() {
+    std::vector<uint32_t> old(slots.size() * 2, 0);
+    old.swap(slots);
+    uint64_t mask = slots.size() - 1;
+    for (uint32_t entry : old) {
+        if (entry != 0) {
+            uint64_t slot = hashKey(keyAt(entry - 1)) & mask;
+            while (slots[slot] != 0) {
+                slot = (slot + 1) & mask;
+            }
+            slots[slot] = entry;
+        }
+    }
+}
+
+// One rising edge from the state for each value of the LUT entry it reads
+uint8_t StateExplorer::expand(HotstateModel& model, HotstateSnapshot& scratch, uint64_t state,
+                              uint64_t* successors) const {
+    const uint64_t* key = keyAt(state);
+    unpack(key, scratch);
+    // An address past the microcode is left to tick() to report
+    const std::vector<DecodedMicrocode>& code = model.getDecodedMicrocode();
+    if (scratch.address < code.size() && code[scratch.address].sub && scratch.stackPointer == stackDepth) {
+        return 0;  // The call overflows the stack; run() reports it
+    }
+    // A word that does not read the inputs has one successor, taken with them all low
+    const int64_t* choices = inputChoices.data() + 2 * std::min<size_t>(scratch.address, code.size());
+    uint8_t count = 0;
+    for (uint8_t value = 0; value < MAX_SUCCESSORS; ++value) {
+        if (choices[value] < 0) {
+            continue;
+        }
+        uint64_t inputs = static_cast<uint64_t>(choices[value]);
+        for (size_t i = 0; i < scratch.variables.size(); ++i) {
+            scratch.variables[i] = i < 64 ? static_cast<uint8_t>((inputs >> i) & 1) : 0;
+        }
+        model.restoreSnapshot(scratch);
+        model.tick();
+        pack(model.saveSnapshot(), successors + count * keyWords);
+        ++count;
+    }
+    return count;
+}
+
+void StateExplorer::expandBatch(uint64_t first, uint64_t count, std::vector<uint64_t>& successors,
+                                std::vector<uint8_t>& successorCounts) const {
+    std::atomic<uint64_t> nextChunk{0};
+    std::exception_ptr failure;
+    std::atomic<bool> failed{false};
+    auto worker = [&]() {
+        HotstateModel model(prototype);
+        HotstateSnapshot scratch = initial;
+        try {
+            for (uint64_t chunk = nextChunk++; chunk * CHUNK_STATES < count && !failed; chunk = nextChunk++) {
+                uint64_t end = std::min(count, (chunk + 1) * CHUNK_STATES);
+                for (uint64_t i = chunk * CHUNK_STATES; i < end; ++i) {
+                    successorCounts[i] = expand(model, scratch, first + i,
+                                                successors.data() + i * MAX_SUCCESSORS * keyWords);
+                }
+            }
+        } catch (...) {
+            if (!failed.exchange(true)) {
+                failure = std::current_exception();
+            }
+        }
+    };
+
+    uint32_t threadCount = static_cast<uint32_t>(
+        std::min<uint64_t>(jobs, (count + CHUNK_STATES - 1) / CHUNK_STATES));
+    std::vector<std::thread> threads;
+    for (uint32_t t = 1; t < threadCount; ++t) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    if (failure) {
+        std::rethrow_exception(failure);
+    }
+}
+
+void StateExplorer::run() {
+    keys.clear();
+    slots.assign(1024, 0);
+    stateCount = 0;
+    levels = 0;
+    complete = true;
+    maxStackDepth = 0;
+    uint32_t words = static_cast<uint32_t>(prototype.getDecodedMicrocode().size());
+    reachedAddress.assign(words, false);
+    deadlocksAt.assign(words, 0);
+    overflowAt.assign(words, false);
+
+    std::vector<uint64_t> start(keyWords);
+    pack(initial, start.data());
+    bool found;
+    add(start.data(), find(start.data(), found));
+
+    // States are numbered in the order found, so a level is a range of them
+    std::vector<uint64_t> successors(BATCH_STATES * MAX_SUCCESSORS * keyWords);
+    std::vector<uint8_t> successorCounts(BATCH_STATES);
+    uint64_t levelStart = 0;
+    while (levelStart < stateCount) {
+        uint64_t levelEnd = stateCount;
+        levels++;
+        for (uint64_t first = levelStart; first < levelEnd; first += BATCH_STATES) {
+            uint64_t count = std::min(BATCH_STATES, levelEnd - first);
+            expandBatch(first, count, successors, successorCounts);
+
+            // Merged in state order, so numbering does not depend on the threads
+            for (uint64_t i = 0; i < count; ++i) {
+                const uint64_t* next = successors.data() + i * MAX_SUCCESSORS * keyWords;
+                bool absorbing = true;
+                for (uint8_t s = 0; s < successorCounts[i]; ++s, next += keyWords) {
+                    uint64_t slot = find(next, found);
+                    if (!found) {
+                        if (stateCount >= stateLimit) {
+                            complete = false;
+                            return;
+                        }
+                        add(next, slot);
+                    }
+                    absorbing &= found && slots[slot] - 1 == first + i;
+                }
+                const uint64_t* key = keyAt(first + i);
+                uint32_t address = keyAddress(key);
+                if (successorCounts[i] == 0) {
+                    overflowAt[address] = true;
+                } else if (absorbing) {
+                    deadlocksAt[address]++;
+                }
+            }
+        }
+        levelStart = levelEnd;
+    }
+}
+
+void StateExplorer::writeReport(std::ostream& out) const {
+    const std::vector<std::string>& labels = memory.getSourceLabels();
+    auto source = [&](uint32_t address) {
+        std::string label = address < labels.size() ? labels[address] : "";
+        std::replace(label.begin(), label.end(), '\n', ' ');
+        return label;
+    };
+
+    uint32_t words = static_cast<uint32_t>(reachedAddress.size());
+    uint32_t reached = static_cast<uint32_t>(std::count(reachedAddress.begin(), reachedAddress.end(), true));
+    out << "State exploration: " << stateCount << " states in " << levels << " levels, "
+        << (complete ? "complete" : "stopped at the state limit") << std::endl;
+    out << "Reachable: " << reached << "/" << words << " words (" << percent(reached, words) << ")" << std::endl;
+    out << "Max stack depth: " << maxStackDepth << "/" << stackDepth << std::endl;
+    if (!complete) {
+        out << "Unexplored states remain: unreachable words and deadlocks below are provisional" << std::endl;
+    }
+
+    out << std::endl << "Unreachable words" << std::endl;
+    for (uint32_t a = 0; a < words; ++a) {
+        if (!reachedAddress[a]) {
+            out << "  " << std::left << std::setw(6) << hexAddress(a) << std::right << "  " << source(a) << std::endl;
+        }
+    }
+    // A state no input leaves: the program stops here for good
+    out << std::endl << "Deadlocks" << std::endl;
+    out << "  addr       states  source" << std::endl;
+    for (uint32_t a = 0; a < words; ++a) {
+        if (deadlocksAt[a] != 0) {
+            out << "  " << std::left << std::setw(6) << hexAddress(a) << std::right << std::setw(11)
+                << deadlocksAt[a] << "  " << source(a) << std::endl;
+        }
+    }
+    out << std::endl << "Calls with the stack full (the simulator stops with a stack overflow)" << std::endl;
+    for (uint32_t a = 0; a < words; ++a) {
+        if (overflowAt[a]) {
+            out << "  " << std::left << std::setw(6) << hexAddress(a) << std::right << "  " << source(a) << std::endl;
+        }
+    }
+}
+
+} // namespace HotstateSim
@@ -0,0 +1,284 @@
+#include "stimulus_parser.h"
+#include "utils.h"
+#include <fstream>
+#include <iostream>
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+
+namespace HotstateSim {
+
+namespace {
+
+void put16(std::vector<uint8_t>& out, uint16_t value) {
+    out.push_back(static_cast<uint8_t>(value));
+    out.push_back(static_cast<uint8_t>(value >> 8));
+}
+
+void put32(std::vector<uint8_t>& out, uint32_t value) {
+    for (int shift = 0; shift < 32; shift += 8) {
+        out.push_back(static_cast<uint8_t>(value >> shift));
+    }
+}
+
+uint16_t get16(const uint8_t* p) {
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+uint32_t get32(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+uint32_t packedBytes(uint32_t numInputs, uint8_t valueBits) {
+    return (numInputs * valueBits + 7) / 8;
+}
+
+uint32_t recordBytesFor(const BinaryStimulusHeader& header) {
+    uint32_t countBytes = (header.flags & BinaryStimulusHeader::FLAG_RAGGED) ? 2 : 0;
+    return 4 + countBytes + packedBytes(header.numInputs, header.valueBits);
+}
+
+} // namespace
+
+bool StimulusParser::isBinaryStimulus(const std::string& filename) {
+    std::ifstream file(filename, std::ios::binary);
+    char magic[8];
+    if (!file.read(magic, sizeof(magic))) {
+        return false;
+    }
+    return std::memcmp(magic, BinaryStimulusHeader::MAGIC, sizeof(magic)) == 0;
+}
+
+bool StimulusParser::loadBinaryStimulus(const std::string& filename) {
+    MappedFile mapped(filename, "stimulus file");
+    const uint8_t* data = mapped.bytes();
+    
+    if (mapped.size() < BinaryStimulusHeader::SIZE) {
+        throw SimulatorException("Truncated binary stimulus header in " + filename);
+    }
+    
+    BinaryStimulusHeader header;
+    header.entryCount = get32(data + 8);
+    header.numInputs = get32(data + 12);
+    header.valueBits = data[16];
+    header.flags = data[17];
+    header.recordBytes = get32(data + 20);
+    
+    if (header.valueBits < 1 || header.valueBits > 8 || header.recordBytes != recordBytesFor(header)) {
+        throw SimulatorException("Corrupt binary stimulus header in " + filename);
+    }
+    if (mapped.size() != BinaryStimulusHeader::SIZE + static_cast<uint64_t>(header.entryCount) * header.recordBytes) {
+        throw SimulatorException("Binary stimulus file " + filename + " does not hold " +
+                               std::to_string(header.entryCount) + " records");
+    }
+    
+    clear();
+    stimulus.reserve(header.entryCount);
+    
+    bool ragged = header.flags & BinaryStimulusHeader::FLAG_RAGGED;
+    uint8_t valueMask = static_cast<uint8_t>((1u << header.valueBits) - 1);
+    uint64_t cycle = 0;
+    const uint8_t* record = data + BinaryStimulusHeader::SIZE;
+    
+    for (uint32_t i = 0; i < header.entryCount; ++i, record += header.recordBytes) {
+        cycle += get32(record);
+        
+        uint32_t count = header.numInputs;
+        const uint8_t* packed = record + 4;
+        if (ragged) {
+            count = get16(packed);
+            packed += 2;
+            if (count > header.numInputs) {
+                throw SimulatorException("Binary stimulus record " + std::to_string(i) + " of " + filename +
+                                       " has more inputs than the header allows");
+            }
+        }
+        
+        stimulus.emplace_back();
+        StimulusEntry& entry = stimulus.back();
+        entry.cycle = cycle;
+        entry.inputs.resize(count);
+        for (uint32_t j = 0; j < count; ++j) {
+            uint32_t bit = j * header.valueBits;
+            uint32_t word = packed[bit / 8];
+            if (bit % 8 + header.valueBits > 8) {
+                word |= static_cast<uint32_t>(packed[bit / 8 + 1]) << 8;
+            }
+            entry.inputs[j] = static_cast<uint8_t>(word >> (bit % 8)) & valueMask;
+        }
+    }
+    numInputs = header.numInputs;
+    
+    validate();
+    
+    loaded = true;
+    std::cout << "Loaded " << stimulus.size() << " stimulus entries from " << filename << std::endl;
+    
+    return true;
+}
+
+bool StimulusParser::saveBinaryStimulus(const std::string& filename) const {
+    if (stimulus.empty()) {
+        throw SimulatorException("No stimulus entries to save");
+    }
+    
+    BinaryStimulusHeader header;
+    header.entryCount = static_cast<uint32_t>(stimulus.size());
+    uint8_t maxValue = 0;
+    for (const auto& entry : stimulus) {
+        header.numInputs = std::max(header.numInputs, static_cast<uint32_t>(entry.inputs.size()));
+        if (entry.inputs.size() != stimulus.front().inputs.size()) {
+            header.flags |= BinaryStimulusHeader::FLAG_RAGGED;
+        }
+        for (uint8_t value : entry.inputs) {
+            maxValue = std::max(maxValue, value);
+        }
+    }
+    if ((header.flags & BinaryStimulusHeader::FLAG_RAGGED) && header.numInputs > UINT16_MAX) {
+        throw SimulatorException("Too many inputs per entry for the binary stimulus format");
+    }
+    while (header.valueBits < 8 && (maxValue >> header.valueBits) != 0) {
+        header.valueBits++;
+    }
+    header.recordBytes = recordBytesFor(header);
+    
+    std::vector<uint8_t> out;
+    out.reserve(BinaryStimulusHeader::SIZE + static_cast<size_t>(header.entryCount) * header.recordBytes);
+    out.insert(out.end(), BinaryStimulusHeader::MAGIC, BinaryStimulusHeader::MAGIC + 8);
+    put32(out, header.entryCount);
+    put32(out, header.numInputs);
+    out.push_back(header.valueBits);
+    out.push_back(header.flags);
+    put16(out, 0);
+    put32(out, header.recordBytes);
+    
+    uint64_t previousCycle = 0;
+    for (const auto& entry : stimulus) {
+        if (entry.cycle - previousCycle > UINT32_MAX) {
+            throw SimulatorException("Stimulus entry at cycle " + std::to_string(entry.cycle) +
+                                   " is more than 2^32 cycles after the one before; the binary format cannot hold it");
+        }
+        put32(out, static_cast<uint32_t>(entry.cycle - previousCycle));
+        previousCycle = entry.cycle;
+        if (header.flags & BinaryStimulusHeader::FLAG_RAGGED) {
+            put16(out, static_cast<uint16_t>(entry.inputs.size()));
+        }
+        
+        size_t packed = out.size();
+        out.resize(packed + packedBytes(header.numInputs, header.valueBits), 0);
+        for (size_t j = 0; j < entry.inputs.size(); ++j) {
+            uint32_t bit = static_cast<uint32_t>(j) * header.valueBits;
+            uint32_t word = static_cast<uint32_t>(entry.inputs[j]) << (bit % 8);
+            out[packed + bit / 8] |= static_cast<uint8_t>(word);
+            if (word > 0xFF) {
+                out[packed + bit / 8 + 1] |= static_cast<uint8_t>(word >> 8);
+            }
+        }
+    }
+    
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        throw SimulatorException("Cannot create binary stimulus file: " + filename);
+    }
+    file.write(reinterpret_cast<const char*>(out.data()), static_cast<std::streamsize>(out.size()));
+    if (!file) {
+        throw SimulatorException("Failed to write binary stimulus file: " + filename);
+    }
+    
+    return true;
+}
+
+// --- Testbench ($readmemh) format ---
+
+bool StimulusParser::isReadmemhStimulus(const std::string& filename) {
+    return endsWith(filename, ReadmemhStimulus::EXTENSION);
+}
+
+bool StimulusParser::loadReadmemhStimulus(const std::string& filename) {
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        throw SimulatorException("Cannot open stimulus file: " + filename);
+    }
+    
+    clear();
+    
+    std::string line;
+    uint32_t lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        size_t comment = line.find("//");
+        if (comment != std::string::npos) {
+            line.erase(comment);
+        }
+        line = trim(line);
+        if (line.empty()) {
+            continue;
+        }
+        
+        std::string where = "line " + std::to_string(lineNumber) + " of " + filename;
+        if (line.size() < 8 || line.size() % 2 != 0 ||
+            line.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos) {
+            throw SimulatorException("Expected a hex word of an 8-digit cycle and 2 digits per input at " + where);
+        }
+        StimulusEntry entry;
+        entry.cycle = std::stoull(line.substr(0, 8), nullptr, 16);
+        if (entry.cycle > ReadmemhStimulus::MAX_CYCLE) {
+            throw SimulatorException("Cycle FFFFFFFF at " + where + " is reserved for the end of the stimulus");
+        }
+        size_t count = (line.size() - 8) / 2;
+        entry.inputs.resize(count);
+        for (size_t j = 0; j < count; ++j) {
+            entry.inputs[j] = static_cast<uint8_t>(std::stoul(line.substr(line.size() - 2 * (j + 1), 2), nullptr, 16));
+        }
+        numInputs = std::max(numInputs, static_cast<uint32_t>(count));
+        addEntry(entry);
+    }
+    
+    validate();
+    
+    loaded = true;
+    std::cout << "Loaded " << stimulus.size() << " stimulus entries from " << filename << std::endl;
+    
+    return true;
+}
+
+bool StimulusParser::saveReadmemhStimulus(const std::string& filename, uint32_t inputCount) const {
+    if (stimulus.empty()) {
+        throw SimulatorException("No stimulus entries to save");
+    }
+    
+    std::ofstream file(filename);
+    if (!file.is_open()) {
+        throw SimulatorException("Cannot create stimulus file: " + filename);
+    }
+    file << "// Testbench stimulus: cycle (8 hex digits), then inputs " << (inputCount ? inputCount - 1 : 0)
+         << " down to 0 (2 digits each)\n";
+    
+    char digits[16];
+    for (const auto& entry : stimulus) {
+        if (entry.cycle > ReadmemhStimulus::MAX_CYCLE) {
+            throw SimulatorException("Stimulus entry at cycle " + std::to_string(entry.cycle) +
+                                   " is past the testbench format's 32-bit cycle count");
+        }
+        if (entry.inputs.size() > inputCount) {
+            throw SimulatorException("Stimulus entry at cycle " + std::to_string(entry.cycle) + " has " +
+                                   std::to_string(entry.inputs.size()) + " inputs; the program has " +
+                                   std::to_string(inputCount));
+        }
+        std::snprintf(digits, sizeof(digits), "%08x", static_cast<unsigned>(entry.cycle));
+        file << digits;
+        for (uint32_t j = inputCount; j-- > 0;) {
+            std::snprintf(digits, sizeof(digits), "%02x", j < entry.inputs.size() ? entry.inputs[j] : 0);
+            file << digits;
+        }
+        file << '\n';
+    }
+    if (!file) {
+        throw SimulatorException("Failed to write stimulus file: " + filename);
+    }
+    
+    return true;
+}
+
+} // namespace HotstateSim
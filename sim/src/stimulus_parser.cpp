@@ -5,6 +5,7 @@
 #include <iostream>
 #include <algorithm>
 #include <stdexcept>
+#include <cctype>
 
 namespace HotstateSim {
 
@@ -13,6 +14,13 @@ bool StimulusParser::loadStimulus(const std::string& filename) {
         throw SimulatorException("Stimulus file not found: " + filename);
     }
     
+    if (isBinaryStimulus(filename)) {
+        return loadBinaryStimulus(filename);
+    }
+    if (isReadmemhStimulus(filename)) {
+        return loadReadmemhStimulus(filename);
+    }
+    
     std::ifstream file(filename);
     if (!file.is_open()) {
         throw SimulatorException("Cannot open stimulus file: " + filename);
@@ -22,6 +30,7 @@ bool StimulusParser::loadStimulus(const std::string& filename) {
     
     std::string line;
     uint32_t lineNumber = 0;
+    bool firstData = true;
     
     while (std::getline(file, line)) {
         lineNumber++;
@@ -33,14 +42,21 @@ bool StimulusParser::loadStimulus(const std::string& filename) {
         }
         
         try {
-            if (!parseLine(line, lineNumber)) {
+            if (firstData && StimulusColumns::isHeader(line)) {
+                if (!inputSymbols) {
+                    throw SimulatorException("A named stimulus header needs the program's symbol table");
+                }
+                columns = std::make_unique<StimulusColumns>(line, *inputSymbols);
+            } else if (!parseLine(line, lineNumber)) {
                 std::cerr << "Warning: Failed to parse line " << lineNumber << ": " << line << std::endl;
             }
+            firstData = false;
         } catch (const SimulatorException& e) {
             throw SimulatorException("Error parsing line " + std::to_string(lineNumber) + 
                                    " in " + filename + ": " + e.what());
         }
     }
+    columns.reset();
     
     // Sort entries by cycle
     sortEntries();
@@ -55,6 +71,21 @@ bool StimulusParser::loadStimulus(const std::string& filename) {
 }
 
 bool StimulusParser::parseLine(const std::string& line, uint32_t lineNumber) {
+    StimulusEntry entry;
+    if (!(columns ? columns->parseRow(line, entry) : parseEntry(line, entry))) {
+        return true;
+    }
+    
+    // Update numInputs if needed
+    if (entry.inputs.size() > numInputs) {
+        numInputs = entry.inputs.size();
+    }
+    
+    stimulus.push_back(std::move(entry));
+    return true;
+}
+
+bool StimulusParser::parseEntry(const std::string& line, StimulusEntry& entry) {
     // Extract comment if present
     std::string comment = extractComment(line);
     std::string dataLine = line;
@@ -69,7 +100,7 @@ bool StimulusParser::parseLine(const std::string& line, uint32_t lineNumber) {
     
     // Skip empty lines after removing comments
     if (dataLine.empty()) {
-        return true;
+        return false;
     }
     
     // Parse the cycle and input values
@@ -80,20 +111,13 @@ bool StimulusParser::parseLine(const std::string& line, uint32_t lineNumber) {
     }
     
     // Parse cycle
-    uint32_t cycle = parseCycle(trim(parts[0]));
+    uint64_t cycle = parseCycle(trim(parts[0]));
     
     // Parse input values
     std::vector<std::string> inputParts(parts.begin() + 1, parts.end());
     std::vector<uint8_t> inputs = parseInputValues(join(inputParts, ","));
     
-    // Update numInputs if needed
-    if (inputs.size() > numInputs) {
-        numInputs = inputs.size();
-    }
-    
-    // Create and add the stimulus entry
-    stimulus.emplace_back(cycle, inputs, comment);
-    
+    entry = StimulusEntry(cycle, inputs, comment);
     return true;
 }
 
@@ -108,36 +132,107 @@ std::vector<uint8_t> StimulusParser::parseInputValues(const std::string& valuesS
             continue;
         }
         
-        try {
-            uint32_t value;
-            if (trimmed.find("0x") == 0 || trimmed.find("0X") == 0) {
-                value = parseHex(trimmed);
-            } else {
-                value = parseDecimal(trimmed);
-            }
-            
-            if (value > 255) {
-                std::cerr << "Warning: Input value " << value << " exceeds 8-bit range, truncating" << std::endl;
-                value = value & 0xFF;
-            }
-            
-            values.push_back(static_cast<uint8_t>(value));
-        } catch (const SimulatorException& e) {
-            throw SimulatorException("Invalid input value: " + trimmed + " - " + e.what());
-        }
+        values.push_back(parseInputValue(trimmed));
     }
     
     return values;
 }
 
-uint32_t StimulusParser::parseCycle(const std::string& cycleStr) {
+// One trimmed, non-empty value cell
+uint8_t StimulusParser::parseInputValue(const std::string& valueStr) {
+    try {
+        uint32_t value;
+        if (valueStr.find("0x") == 0 || valueStr.find("0X") == 0) {
+            value = parseHex(valueStr);
+        } else {
+            value = parseDecimal(valueStr);
+        }
+        
+        if (value > 255) {
+            std::cerr << "Warning: Input value " << value << " exceeds 8-bit range, truncating" << std::endl;
+            value = value & 0xFF;
+        }
+        
+        return static_cast<uint8_t>(value);
+    } catch (const SimulatorException& e) {
+        throw SimulatorException("Invalid input value: " + valueStr + " - " + e.what());
+    }
+}
+
+// --- Named columns ---
+
+// A header's first cell is "cycle" in any case, where a row has a number
+bool StimulusColumns::isHeader(const std::string& line) {
+    std::string first = trim(line.substr(0, line.find(',')));
+    if (first.size() != 5) {
+        return false;
+    }
+    std::string lower;
+    for (char c : first) {
+        lower += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    return lower == "cycle";
+}
+
+StimulusColumns::StimulusColumns(const std::string& header, const SymbolTable& symbols) {
+    std::string dataLine = trim(header.substr(0, header.find('#')));
+    std::vector<std::string> names = split(dataLine, ',');
+    uint32_t width = 0;
+    for (size_t i = 1; i < names.size(); ++i) {
+        std::string name = trim(names[i]);
+        uint32_t input = symbols.find(name);
+        if (input == UINT32_MAX) {
+            throw SimulatorException("Unknown input in stimulus header: " + name);
+        }
+        if (std::find(columnInputs.begin(), columnInputs.end(), input) != columnInputs.end()) {
+            throw SimulatorException("Input named twice in stimulus header: " + name);
+        }
+        columnInputs.push_back(input);
+        width = std::max(width, input + 1);
+    }
+    if (columnInputs.empty()) {
+        throw SimulatorException("Stimulus header names no inputs");
+    }
+    values.assign(width, 0);
+}
+
+bool StimulusColumns::parseRow(const std::string& line, StimulusEntry& entry) {
+    std::string comment = StimulusParser::extractComment(line);
+    std::string dataLine = trim(line.substr(0, line.find('#')));
+    if (dataLine.empty()) {
+        return false;
+    }
+    
+    std::vector<std::string> cells = split(dataLine, ',');
+    if (cells.size() - 1 > columnInputs.size()) {
+        throw SimulatorException("Row has " + std::to_string(cells.size() - 1) + " values for " +
+                                 std::to_string(columnInputs.size()) + " named inputs");
+    }
+    uint64_t cycle = StimulusParser::parseCycle(cells[0]);
+    if (cycle < lastCycle) {
+        throw SimulatorException("Named stimulus rows must not go back in cycles: cycle " +
+                                 std::to_string(cycle) + " follows cycle " + std::to_string(lastCycle));
+    }
+    lastCycle = cycle;
+    
+    for (size_t i = 1; i < cells.size(); ++i) {
+        std::string cell = trim(cells[i]);
+        if (!cell.empty()) {
+            values[columnInputs[i - 1]] = StimulusParser::parseInputValue(cell);
+        }
+    }
+    entry = StimulusEntry(cycle, values, comment);
+    return true;
+}
+
+uint64_t StimulusParser::parseCycle(const std::string& cycleStr) {
     std::string trimmed = trim(cycleStr);
     
     try {
         if (trimmed.find("0x") == 0 || trimmed.find("0X") == 0) {
-            return parseHex(trimmed);
+            return parseHex64(trimmed);
         } else {
-            return parseDecimal(trimmed);
+            return parseDecimal64(trimmed);
         }
     } catch (const SimulatorException& e) {
         throw SimulatorException("Invalid cycle value: " + trimmed + " - " + e.what());
@@ -153,37 +248,252 @@ std::string StimulusParser::extractComment(const std::string& line) {
     return trim(line.substr(commentPos + 1));
 }
 
-const StimulusEntry* StimulusParser::getEntry(uint32_t cycle) const {
-    // Find the entry with the exact cycle
-    for (const auto& entry : stimulus) {
-        if (entry.cycle == cycle) {
-            return &entry;
+// Index of the last entry with entry.cycle <= cycle, or stimulus.size() if none
+size_t StimulusParser::findHeldEntry(uint64_t cycle) const {
+    if (stimulus.empty() || stimulus[0].cycle > cycle) {
+        return stimulus.size();
+    }
+    
+    if (cursor < stimulus.size() && stimulus[cursor].cycle <= cycle) {
+        // Walk forward from the previous lookup
+        while (cursor + 1 < stimulus.size() && stimulus[cursor + 1].cycle <= cycle) {
+            cursor++;
         }
+    } else {
+        // Jumped backwards (or the cursor is stale); binary search
+        auto it = std::upper_bound(stimulus.begin(), stimulus.end(), cycle,
+                                   [](uint64_t c, const StimulusEntry& entry) {
+                                       return c < entry.cycle;
+                                   });
+        cursor = static_cast<size_t>(it - stimulus.begin()) - 1;
+    }
+    return cursor;
+}
+
+const StimulusEntry* StimulusParser::getEntry(uint64_t cycle) const {
+    if (isStreaming()) {
+        advanceStream(cycle);
+        return (streamHasHeld && streamHeld.cycle == cycle) ? &streamHeld : nullptr;
+    }
+    
+    size_t index = findHeldEntry(cycle);
+    if (index == stimulus.size() || stimulus[index].cycle != cycle) {
+        return nullptr;
+    }
+    
+    // Duplicate cycles (only possible through addEntry): use the first
+    while (index > 0 && stimulus[index - 1].cycle == cycle) {
+        index--;
     }
-    return nullptr;
+    return &stimulus[index];
 }
 
-std::vector<uint8_t> StimulusParser::getInputs(uint32_t cycle) const {
+const std::vector<uint8_t>& StimulusParser::getInputs(uint64_t cycle) const {
     const StimulusEntry* entry = getEntry(cycle);
     if (entry) {
         return entry->inputs;
     }
     
-    // If no exact match, find the last entry before this cycle
-    std::vector<uint8_t> lastInputs(numInputs, 0);
-    for (const auto& entry : stimulus) {
-        if (entry.cycle <= cycle) {
-            lastInputs = entry.inputs;
-            // Pad with zeros if needed
-            while (lastInputs.size() < numInputs) {
-                lastInputs.push_back(0);
+    // If no exact match, hold the last entry before this cycle
+    const StimulusEntry* held = nullptr;
+    uint32_t width = numInputs;
+    if (isStreaming()) {
+        held = streamHasHeld ? &streamHeld : nullptr;
+        width = streamNumInputs;
+    } else {
+        size_t index = findHeldEntry(cycle);
+        held = index < stimulus.size() ? &stimulus[index] : nullptr;
+    }
+    
+    if (held && held->inputs.size() >= width) {
+        return held->inputs;
+    }
+    
+    // Pad with zeros if needed
+    paddedInputs.assign(width, 0);
+    if (held) {
+        std::copy(held->inputs.begin(), held->inputs.end(), paddedInputs.begin());
+    }
+    return paddedInputs;
+}
+
+uint64_t StimulusParser::getNextChangeCycle(uint64_t cycle) const {
+    if (isStreaming()) {
+        advanceStream(cycle);
+        return streamHasNext ? streamNext.cycle : UINT64_MAX;
+    }
+    
+    size_t index = findHeldEntry(cycle);
+    if (index == stimulus.size()) {
+        // Before the first entry (or no entries at all)
+        return stimulus.empty() ? UINT64_MAX : stimulus[0].cycle;
+    }
+    while (index < stimulus.size() && stimulus[index].cycle <= cycle) {
+        index++;
+    }
+    return index < stimulus.size() ? stimulus[index].cycle : UINT64_MAX;
+}
+
+// --- Streaming ---
+
+bool StimulusParser::openStream(const std::string& filename, size_t readAhead) {
+    if (!fileExists(filename)) {
+        throw SimulatorException("Stimulus file not found: " + filename);
+    }
+    
+    // Binary files are already compact and load in one pass over the mapping
+    if (isBinaryStimulus(filename) || isReadmemhStimulus(filename)) {
+        return loadStimulus(filename);
+    }
+    
+    size_t ahead = readAhead > 0 ? readAhead : 1;
+    const SymbolTable* symbols = inputSymbols;
+    openSource(filename, [filename, ahead, symbols] {
+        return std::make_unique<StimulusStream>(filename, ahead, symbols);
+    });
+    std::cout << "Streaming stimulus entries from " << filename << std::endl;
+    
+    return true;
+}
+
+void StimulusParser::openSource(const std::string& name, std::function<std::unique_ptr<StimulusSource>()> factory) {
+    clear();
+    streamName = name;
+    streamFactory = std::move(factory);
+    restartStream();
+    
+    if (!streamHasNext) {
+        throw SimulatorException("No stimulus entries loaded");
+    }
+    
+    loaded = true;
+}
+
+void StimulusParser::restartStream() const {
+    stream.reset();
+    stream = streamFactory();
+    
+    streamHasHeld = false;
+    streamConsumed = 0;
+    streamHasNext = stream->next(streamNext);
+    streamNumInputs = streamHasNext ? streamNext.inputs.size() : 0;
+}
+
+// Consume entries up to and including cycle; streamNext stays one ahead
+void StimulusParser::advanceStream(uint64_t cycle) const {
+    if (streamHasHeld && streamHeld.cycle > cycle) {
+        restartStream();
+    }
+    
+    while (streamHasNext && streamNext.cycle <= cycle) {
+        streamHeld = std::move(streamNext);
+        streamHasHeld = true;
+        streamConsumed++;
+        
+        streamHasNext = stream->next(streamNext);
+        if (streamHasNext) {
+            if (streamNext.cycle <= streamHeld.cycle) {
+                throw SimulatorException("Streamed stimulus " + streamName + " must have increasing cycles: cycle " +
+                                       std::to_string(streamNext.cycle) + " follows cycle " +
+                                       std::to_string(streamHeld.cycle));
             }
+            if (streamNext.inputs.size() > streamNumInputs) {
+                streamNumInputs = streamNext.inputs.size();
+            }
+        }
+    }
+}
+
+StimulusStream::StimulusStream(const std::string& fname, size_t ahead, const SymbolTable* names)
+    : filename(fname)
+    , readAhead(ahead)
+    , symbols(names)
+{
+    file.open(filename);
+    if (!file.is_open()) {
+        throw SimulatorException("Cannot open stimulus file: " + filename);
+    }
+    reader = std::thread(&StimulusStream::readLoop, this);
+}
+
+StimulusStream::~StimulusStream() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    notFull.notify_all();
+    if (reader.joinable()) {
+        reader.join();
+    }
+}
+
+void StimulusStream::readLoop() {
+    std::string line;
+    uint32_t lineNumber = 0;
+    std::unique_ptr<StimulusColumns> columns;
+    bool firstData = true;
+    
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            notFull.wait(lock, [this] { return queue.size() < readAhead || stopping; });
+            if (stopping) return;
+        }
+        
+        // Read and parse outside the lock
+        StimulusEntry entry;
+        bool haveEntry = false;
+        std::string parseError;
+        while (!haveEntry && std::getline(file, line)) {
+            lineNumber++;
+            line = trim(line);
+            if (line.empty() || line[0] == '#') {
+                continue;
+            }
+            try {
+                if (firstData && StimulusColumns::isHeader(line)) {
+                    if (!symbols) {
+                        throw SimulatorException("A named stimulus header needs the program's symbol table");
+                    }
+                    columns = std::make_unique<StimulusColumns>(line, *symbols);
+                } else {
+                    haveEntry = columns ? columns->parseRow(line, entry) : StimulusParser::parseEntry(line, entry);
+                }
+                firstData = false;
+            } catch (const SimulatorException& e) {
+                parseError = "Error parsing line " + std::to_string(lineNumber) +
+                             " in " + filename + ": " + e.what();
+                break;
+            }
+        }
+        
+        std::lock_guard<std::mutex> lock(mutex);
+        if (haveEntry) {
+            queue.push_back(std::move(entry));
         } else {
-            break;
+            error = parseError;
+            done = true;
         }
+        notEmpty.notify_one();
+        if (done) return;
+    }
+}
+
+bool StimulusStream::next(StimulusEntry& entry) {
+    std::unique_lock<std::mutex> lock(mutex);
+    notEmpty.wait(lock, [this] { return !queue.empty() || done; });
+    
+    if (!queue.empty()) {
+        entry = std::move(queue.front());
+        queue.pop_front();
+        notFull.notify_one();
+        return true;
     }
     
-    return lastInputs;
+    if (!error.empty()) {
+        throw SimulatorException(error);
+    }
+    return false;
 }
 
 void StimulusParser::printStimulus(size_t maxEntries) const {
@@ -231,7 +541,7 @@ void StimulusParser::validate() const {
     }
     
     // Check for duplicate cycles
-    std::vector<uint32_t> cycles;
+    std::vector<uint64_t> cycles;
     for (const auto& entry : stimulus) {
         cycles.push_back(entry.cycle);
     }
@@ -262,10 +572,29 @@ void StimulusParser::clear() {
     stimulus.clear();
     loaded = false;
     numInputs = 0;
+    cursor = 0;
+    columns.reset();
+    
+    stream.reset();
+    streamName.clear();
+    streamFactory = nullptr;
+    streamHasHeld = false;
+    streamHasNext = false;
+    streamConsumed = 0;
+    streamNumInputs = 0;
 }
 
 void StimulusParser::addEntry(const StimulusEntry& entry) {
-    stimulus.push_back(entry);
+    // Insert after any entries for the same or earlier cycles
+    if (stimulus.empty() || stimulus.back().cycle <= entry.cycle) {
+        stimulus.push_back(entry);
+    } else {
+        auto it = std::upper_bound(stimulus.begin(), stimulus.end(), entry.cycle,
+                                   [](uint64_t c, const StimulusEntry& e) {
+                                       return c < e.cycle;
+                                   });
+        stimulus.insert(it, entry);
+    }
     if (entry.inputs.size() > numInputs) {
         numInputs = entry.inputs.size();
     }
@@ -273,7 +602,7 @@ void StimulusParser::addEntry(const StimulusEntry& entry) {
 }
 
 void StimulusParser::sortEntries() {
-    std::sort(stimulus.begin(), stimulus.end(), 
+    std::stable_sort(stimulus.begin(), stimulus.end(), 
               [](const StimulusEntry& a, const StimulusEntry& b) {
                   return a.cycle < b.cycle;
               });
@@ -0,0 +1,166 @@
+#include "sweep_runner.h"
+#include "batch_simulator.h"
+#include "utils.h"
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+
+namespace HotstateSim {
+
+SweepRunner::SweepRunner(const SimulatorConfig& cfg, const std::vector<std::string>& files, uint32_t numJobs)
+    : config(cfg)
+    , stimulusFiles(files)
+    , jobs(numJobs)
+{
+    if (jobs == 0) {
+        jobs = std::max(1u, std::thread::hardware_concurrency());
+    }
+}
+
+bool SweepRunner::initialize() {
+    if (stimulusFiles.empty()) {
+        lastError = "Sweep has no stimulus files";
+        return false;
+    }
+
+    if (config.basePath.empty()) {
+        lastError = "Base path not specified";
+        return false;
+    }
+
+    if (!memoryLoader.loadProgram(config.basePath, config.sourceFile) || !memoryLoader.isLoaded()) {
+        lastError = "Failed to load memory files from base path: " + config.basePath;
+        return false;
+    }
+
+    if (config.verbose) {
+        memoryLoader.printMemoryInfo();
+    }
+
+    results.assign(stimulusFiles.size(), SweepResult());
+    return true;
+}
+
+bool SweepRunner::run() {
+    std::atomic<uint32_t> nextRun(0);
+    uint32_t runCount = static_cast<uint32_t>(stimulusFiles.size());
+
+    auto worker = [&]() {
+        for (uint32_t index = nextRun++; index < runCount; index = nextRun++) {
+            runOne(index, results[index]);
+        }
+    };
+
+    uint32_t threadCount = std::min(jobs, runCount);
+    std::vector<std::thread> threads;
+    for (uint32_t t = 1; t < threadCount; ++t) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    return std::all_of(results.begin(), results.end(),
+                       [](const SweepResult& result) { return result.success; });
+}
+
+void SweepRunner::runOne(uint32_t index, SweepResult& result) const {
+    result.stimulusFile = stimulusFiles[index];
+
+    try {
+        StimulusParser stimulus;
+        stimulus.setInputSymbols(&memoryLoader.getInputSymbols());
+        bool loaded = config.streamStimulus ? stimulus.openStream(result.stimulusFile)
+                                            : stimulus.loadStimulus(result.stimulusFile);
+        if (!loaded) {
+            result.error = "Failed to load stimulus file: " + result.stimulusFile;
+            return;
+        }
+
+        std::unique_ptr<OutputLogger> logger;
+        if (config.outputFormat != OutputFormat::CONSOLE) {
+            result.outputFile = BatchSimulator::outputFileFor(config, result.stimulusFile, index);
+            switch (config.outputFormat) {
+                case OutputFormat::VCD:
+                    logger = OutputLogger::createVCDLogger(result.outputFile);
+                    break;
+                case OutputFormat::JSON:
+                    logger = OutputLogger::createJSONLogger(result.outputFile);
+                    break;
+                case OutputFormat::TRACE:
+                    logger = OutputLogger::createTraceLogger(result.outputFile);
+                    break;
+                default:
+                    logger = OutputLogger::createCSVLogger(result.outputFile);
+                    break;
+            }
+            // Traces stream to disk; keep only the latest entry in memory
+            logger->setMaxLogEntries(1);
+            if (!logger->openFile()) {
+                result.error = "Failed to open output file: " + result.outputFile;
+                return;
+            }
+        }
+
+        HotstateModel model(memoryLoader);
+        model.reset();
+
+        // Same cycle loop as Simulator::run, without breakpoints. Untraced,
+        // the cycles up to the next stimulus change run as whole clock
+        // periods in one call.
+        uint64_t cycle = 0;
+        while (cycle < config.maxCycles) {
+            const std::vector<uint8_t>& inputs = stimulus.getInputs(cycle);
+            if (!stimulus.isEmpty()) {
+                model.setInputs(inputs);
+            }
+            uint64_t held = std::min(stimulus.getNextChangeCycle(cycle), config.maxCycles) - cycle;
+            if (!logger && !model.getClock() && held >= 2) {
+                model.run(held / 2);
+                cycle += held & ~1ULL;
+            } else {
+                model.clock();
+                if (logger) {
+                    logger->logCycle(cycle, model, inputs);
+                }
+                cycle++;
+            }
+            result.cycles = cycle;
+        }
+
+        result.finalAddress = model.getCurrentAddress();
+        result.activeStates = model.getStates().count();
+        result.success = true;
+
+    } catch (const SimulatorException& e) {
+        result.error = e.what();
+    }
+}
+
+void SweepRunner::printSummary() const {
+    uint32_t passed = 0;
+
+    std::cout << "=== Sweep Summary ===" << std::endl;
+    for (size_t i = 0; i < results.size(); ++i) {
+        const SweepResult& result = results[i];
+        std::cout << "[" << i << "] " << result.stimulusFile << ": ";
+        if (result.success) {
+            passed++;
+            std::cout << result.cycles << " cycles, Addr 0x" << std::hex << result.finalAddress << std::dec
+                      << ", active states " << result.activeStates;
+            if (!result.outputFile.empty()) {
+                std::cout << " -> " << result.outputFile;
+            }
+        } else {
+            std::cout << "FAILED: " << result.error;
+        }
+        std::cout << std::endl;
+    }
+    std::cout << "Runs: " << results.size() << ", passed: " << passed
+              << ", failed: " << (results.size() - passed) << ", jobs: " << jobs << std::endl;
+    std::cout << "=====================" << std::endl;
+}
+
+} // namespace HotstateSim
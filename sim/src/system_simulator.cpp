@@ -0,0 +1,186 @@
+#include "system_simulator.h"
+#include "utils.h"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <thread>
+
+namespace HotstateSim {
+
+SystemSimulator::SystemSimulator(const std::string& basePath, uint32_t coreCount, uint32_t jobs)
+    : numOutputs(0)
+    , outputWords(0)
+    , jobs(jobs)
+    , skippedCycles(0)
+{
+    if (coreCount == 0) {
+        throw SimulatorException("A system needs at least one core");
+    }
+    if (this->jobs == 0) {
+        this->jobs = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (uint32_t i = 0; i < coreCount; ++i) {
+        std::string corePath = basePath + "_p" + std::to_string(i);
+        auto memory = std::make_unique<MemoryLoader>();
+        if (!memory->loadProgram(corePath, "")) {
+            throw SimulatorException("Failed to load core " + std::to_string(i) + " from " + corePath);
+        }
+        cores.push_back(std::make_unique<HotstateModel>(*memory));
+        memories.push_back(std::move(memory));
+        // A core's image is only as wide as the states it numbers up to
+        numOutputs = std::max(numOutputs, cores[i]->getNumOutputs());
+    }
+    outputWords = (numOutputs + 63) / 64;
+
+    // Word 0 loads every state's initial value on every core, so it does
+    // not count as assigning them
+    owners.assign(numOutputs, 0);
+    std::vector<bool> owned(numOutputs, false);
+    for (uint32_t i = 0; i < coreCount; ++i) {
+        const std::vector<DecodedMicrocode>& program = cores[i]->getDecodedMicrocode();
+        for (size_t adr = 1; adr < program.size(); ++adr) {
+            const StateBits& mask = program[adr].transitionValue;
+            for (uint32_t s = 0; s < mask.size(); ++s) {
+                if (!owned[s] && mask[s]) {
+                    owned[s] = true;
+                    owners[s] = i;
+                }
+            }
+        }
+    }
+    ownedMasks.assign(coreCount, std::vector<uint64_t>(outputWords, 0));
+    for (uint32_t s = 0; s < numOutputs; ++s) {
+        ownedMasks[owners[s]][s >> 6] |= 1ULL << (s & 63);
+    }
+
+    stateRecords.assign(coreCount, std::vector<uint64_t>(static_cast<size_t>(SPAN_CYCLES) * outputWords, 0));
+    addressRecords.assign(coreCount, std::vector<uint32_t>(SPAN_CYCLES, 0));
+    coreSkipped.assign(coreCount, 0);
+}
+
+void SystemSimulator::run(const StimulusParser& stimulus, uint32_t cycles, const CycleObserver& observer) {
+    for (size_t i = 0; i < cores.size(); ++i) {
+        cores[i]->reset();
+        coreSkipped[i] = 0;
+    }
+
+    StateBits outputs(numOutputs);
+    std::vector<uint32_t> addresses(cores.size(), 0);
+    std::vector<InputChange> changes;
+    for (uint32_t start = 0; start < cycles; start += std::min(SPAN_CYCLES, cycles - start)) {
+        uint32_t end = start + std::min(SPAN_CYCLES, cycles - start);
+
+        // The input bus for the span, read once for every core
+        changes.clear();
+        if (!stimulus.isEmpty()) {
+            bool carried = start > 0 && stimulus.getNextChangeCycle(start - 1) != start;
+            changes.push_back({start, stimulus.getInputs(start), !carried});
+            for (uint64_t cycle = stimulus.getNextChangeCycle(start); cycle < end;
+                 cycle = stimulus.getNextChangeCycle(cycle)) {
+                changes.push_back({static_cast<uint32_t>(cycle), stimulus.getInputs(cycle), true});
+            }
+        }
+
+        // Cores to worker threads, one at a time
+        std::atomic<size_t> nextCore(0);
+        std::atomic<bool> failed(false);
+        std::exception_ptr failure;
+        auto worker = [&]() {
+            try {
+                for (size_t core = nextCore++; core < cores.size() && !failed; core = nextCore++) {
+                    runCore(core, start, end, changes);
+                }
+            } catch (...) {
+                if (!failed.exchange(true)) {
+                    failure = std::current_exception();
+                }
+            }
+        };
+        uint32_t threadCount = static_cast<uint32_t>(std::min<size_t>(jobs, cores.size()));
+        std::vector<std::thread> threads;
+        for (uint32_t t = 1; t < threadCount; ++t) {
+            threads.emplace_back(worker);
+        }
+        worker();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        if (failure) {
+            std::rethrow_exception(failure);
+        }
+
+        for (uint32_t cycle = start; cycle < end; ++cycle) {
+            uint32_t offset = cycle - start;
+            mergeOutputs(offset, outputs);
+            for (size_t core = 0; core < cores.size(); ++core) {
+                addresses[core] = addressRecords[core][offset];
+            }
+            observer(cycle, outputs, addresses);
+        }
+    }
+
+    skippedCycles = 0;
+    for (uint64_t skipped : coreSkipped) {
+        skippedCycles += skipped;
+    }
+}
+
+// One core through cycles [start, end), recording its registers per cycle
+void SystemSimulator::runCore(size_t core, uint32_t start, uint32_t end, const std::vector<InputChange>& changes) {
+    HotstateModel& model = *cores[core];
+    uint64_t* states = stateRecords[core].data();
+    uint32_t* address = addressRecords[core].data();
+    size_t next = 0;  // First change not yet applied
+
+    auto record = [&](uint32_t cycle) {
+        const std::vector<uint64_t>& words = model.getStates().getWords();
+        uint64_t* slot = states + static_cast<size_t>(cycle - start) * outputWords;
+        std::copy(words.begin(), words.end(), slot);
+        std::fill(slot + words.size(), slot + outputWords, 0);
+        address[cycle - start] = model.getCurrentAddress();
+    };
+
+    for (uint32_t cycle = start; cycle < end;) {
+        bool changed = cycle <= RESET_CYCLES;  // Reset is released at RESET_CYCLES
+        while (next < changes.size() && changes[next].cycle <= cycle) {
+            model.setInputs(changes[next].inputs);
+            changed |= changes[next].changed;
+            ++next;
+        }
+        model.setReset(cycle < RESET_CYCLES);
+
+        // After a settled rising edge, with the inputs held, every cycle up
+        // to the next change repeats it: whole clock periods are skipped and
+        // their records copied
+        if (!changed && model.isSettled() && model.getClock()) {
+            uint32_t until = next < changes.size() ? changes[next].cycle : end;
+            uint64_t span = std::min<uint64_t>(until - cycle, model.settledCycles());
+            uint32_t skip = static_cast<uint32_t>(span) & ~1u;
+            if (skip > 0) {
+                model.skipCycles(skip);
+                for (uint32_t i = 0; i < skip; ++i) {
+                    record(cycle + i);
+                }
+                coreSkipped[core] += skip;
+                cycle += skip;
+                continue;
+            }
+        }
+
+        model.clock();
+        record(cycle);
+        ++cycle;
+    }
+}
+
+void SystemSimulator::mergeOutputs(uint32_t offset, StateBits& outputs) const {
+    for (uint32_t w = 0; w < outputWords; ++w) {
+        uint64_t word = 0;
+        for (size_t core = 0; core < cores.size(); ++core) {
+            word |= stateRecords[core][static_cast<size_t>(offset) * outputWords + w] & ownedMasks[core][w];
+        }
+        outputs.captureWord(w, word, ~0ULL);
+    }
+}
+
+} // namespace HotstateSim
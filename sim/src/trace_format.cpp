@@ -0,0 +1,440 @@
+#include "trace_format.h"
+#include "utils.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace HotstateSim {
+
+namespace {
+
+const char TRACE_MAGIC[] = "HSTRACE1";
+const char INDEX_MAGIC[] = "HSTRIDX1";
+constexpr size_t HEADER_SIZE = 16;
+constexpr size_t TRAILER_SIZE = 16;
+
+void putVarint(std::vector<uint8_t>& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+void putFixed(std::vector<uint8_t>& out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; ++i) {
+        out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+}
+
+uint64_t zigzag(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+int64_t unzigzag(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+// Bounds-checked cursor over a block or footer read into memory
+class ByteCursor {
+private:
+    const std::vector<uint8_t>& bytes;
+    size_t pos;
+    const std::string& filename;
+
+public:
+    ByteCursor(const std::vector<uint8_t>& data, const std::string& fname) : bytes(data), pos(0), filename(fname) {}
+
+    size_t position() const { return pos; }
+
+    uint64_t varint() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (pos >= bytes.size()) break;
+            uint8_t byte = bytes[pos++];
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) return value;
+        }
+        throw SimulatorException("Corrupt trace data in " + filename);
+    }
+
+    uint64_t fixed(int size) {
+        if (pos + size > bytes.size()) {
+            throw SimulatorException("Truncated trace footer in " + filename);
+        }
+        uint64_t value = 0;
+        for (int i = 0; i < size; ++i) {
+            value |= static_cast<uint64_t>(bytes[pos++]) << (8 * i);
+        }
+        return value;
+    }
+
+    std::string text(size_t size) {
+        if (pos + size > bytes.size()) {
+            throw SimulatorException("Truncated trace footer in " + filename);
+        }
+        std::string result(bytes.begin() + pos, bytes.begin() + pos + size);
+        pos += size;
+        return result;
+    }
+};
+
+} // namespace
+
+// --- TraceWriter ---
+
+TraceWriter::TraceWriter(std::ostream& stream)
+    : out(stream)
+    , written(0)
+    , numStates(0)
+    , numOutputs(0)
+    , inputBase(0)
+    , inBlock(false)
+    , blockStart(0)
+    , lastCycle(0)
+{
+    std::vector<uint8_t> header(TRACE_MAGIC, TRACE_MAGIC + 8);
+    putFixed(header, VERSION, 4);
+    putFixed(header, BLOCK_CYCLES, 4);
+    writeBytes(header.data(), header.size());
+}
+
+void TraceWriter::writeBytes(const void* data, size_t size) {
+    out.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+    written += size;
+}
+
+// Names match the VCD writer
+void TraceWriter::defineSignals(const LogRecord& rec) {
+    numStates = rec.numStates;
+    numOutputs = rec.numOutputs;
+
+    for (uint32_t i = 0; i < numStates; ++i) {
+        signals.push_back({"state[" + std::to_string(i) + "]", 1});
+    }
+    signals.push_back({"address", 32});
+    for (const char* name : {"ready", "lhs", "fired", "jmpadr", "switch_active"}) {
+        signals.push_back({name, 1});
+    }
+    for (uint32_t i = 0; i < numOutputs; ++i) {
+        signals.push_back({"output[" + std::to_string(i) + "]", 8});
+    }
+    inputBase = static_cast<uint32_t>(signals.size());
+    columns.resize(signals.size());
+}
+
+void TraceWriter::flushRun(uint32_t signal) {
+    Column& column = columns[signal];
+    if (column.runCount == 0) return;
+
+    putVarint(column.bytes, column.runDelta);
+    if (signals[signal].width > 1) {
+        putVarint(column.bytes, zigzag(column.runValueDelta));
+    }
+    putVarint(column.bytes, column.runCount);
+    column.runCount = 0;
+}
+
+void TraceWriter::record(uint32_t signal, uint32_t value, uint64_t cycle) {
+    Column& column = columns[signal];
+    if (value == column.value) return;
+
+    uint64_t delta = cycle - column.lastChange;
+    // 1-bit signals can only toggle, so their value delta is implied
+    int64_t valueDelta = signals[signal].width > 1 ? static_cast<int64_t>(value) - column.value : 0;
+
+    if (column.runCount > 0 && delta == column.runDelta && valueDelta == column.runValueDelta) {
+        column.runCount++;
+    } else {
+        flushRun(signal);
+        column.runDelta = delta;
+        column.runValueDelta = valueDelta;
+        column.runCount = 1;
+    }
+    column.value = value;
+    column.lastChange = cycle;
+}
+
+void TraceWriter::append(const LogView& entry) {
+    const LogRecord& rec = entry.record;
+    uint64_t cycle = rec.cycle;
+
+    if (signals.empty()) {
+        defineSignals(rec);
+    }
+    if (inBlock && cycle <= lastCycle) {
+        restart();  // The simulation was reset
+    }
+
+    if (inBlock && cycle >= blockStart + BLOCK_CYCLES) {
+        finishBlock();
+    }
+    if (!inBlock) {
+        inBlock = true;
+        blockStart = cycle;
+        for (Column& column : columns) {
+            column.lastChange = cycle;
+        }
+    }
+
+    // Inputs seen for the first time become new signals, zero until now
+    while (columns.size() < inputBase + rec.numInputs) {
+        signals.push_back({"input[" + std::to_string(columns.size() - inputBase) + "]", 8});
+        columns.emplace_back();
+        columns.back().lastChange = blockStart;
+    }
+
+    uint32_t states = std::min(numStates, rec.numStates);
+    for (uint32_t i = 0; i < states; ++i) {
+        record(i, entry.state(i), cycle);
+    }
+    record(numStates, rec.address, cycle);
+    record(numStates + 1, rec.ready, cycle);
+    record(numStates + 2, rec.lhs, cycle);
+    record(numStates + 3, rec.fired, cycle);
+    record(numStates + 4, rec.jmpadr, cycle);
+    record(numStates + 5, rec.switchActive, cycle);
+
+    uint32_t outputs = std::min(numOutputs, rec.numOutputs);
+    for (uint32_t i = 0; i < outputs; ++i) {
+        record(numStates + 6 + i, entry.outputs[i], cycle);
+    }
+    // Inputs missing from a short entry keep their value, as in the model
+    for (uint32_t i = 0; i < rec.numInputs; ++i) {
+        record(inputBase + i, entry.inputs[i], cycle);
+    }
+
+    lastCycle = cycle;
+}
+
+void TraceWriter::finishBlock() {
+    if (!inBlock) return;
+
+    blockBytes.clear();
+    putVarint(blockBytes, blockStart);
+    putVarint(blockBytes, lastCycle - blockStart + 1);
+    putVarint(blockBytes, columns.size());
+    for (uint32_t i = 0; i < columns.size(); ++i) {
+        flushRun(i);
+        putVarint(blockBytes, columns[i].blockInitial);
+        putVarint(blockBytes, columns[i].bytes.size());
+    }
+    for (const Column& column : columns) {
+        blockBytes.insert(blockBytes.end(), column.bytes.begin(), column.bytes.end());
+    }
+
+    index.push_back({blockStart, lastCycle, written});
+    writeBytes(blockBytes.data(), blockBytes.size());
+
+    for (Column& column : columns) {
+        column.blockInitial = column.value;
+        column.bytes.clear();
+    }
+    inBlock = false;
+}
+
+void TraceWriter::restart() {
+    for (Column& column : columns) {
+        column = Column();
+    }
+    index.clear();
+    inBlock = false;
+    lastCycle = 0;
+}
+
+void TraceWriter::finish() {
+    finishBlock();
+
+    uint64_t footerOffset = written;
+    std::vector<uint8_t> footer;
+    putFixed(footer, signals.size(), 4);
+    for (const TraceSignal& signal : signals) {
+        footer.push_back(signal.width);
+        putFixed(footer, signal.name.size(), 2);
+        footer.insert(footer.end(), signal.name.begin(), signal.name.end());
+    }
+    putFixed(footer, index.size(), 4);
+    for (const BlockIndex& block : index) {
+        putFixed(footer, block.firstCycle, 8);
+        putFixed(footer, block.lastCycle, 8);
+        putFixed(footer, block.offset, 8);
+    }
+    putFixed(footer, footerOffset, 8);
+    footer.insert(footer.end(), INDEX_MAGIC, INDEX_MAGIC + 8);
+
+    writeBytes(footer.data(), footer.size());
+    out.flush();
+}
+
+// --- TraceReader ---
+
+TraceReader::TraceReader(const std::string& fname)
+    : filename(fname)
+    , blockCycles(0)
+    , footerOffset(0)
+{
+    file.open(filename, std::ios::binary);
+    if (!file.is_open()) {
+        throw SimulatorException("Cannot open trace file: " + filename);
+    }
+
+    file.seekg(0, std::ios::end);
+    uint64_t size = static_cast<uint64_t>(file.tellg());
+    if (size < HEADER_SIZE + TRAILER_SIZE) {
+        throw SimulatorException("Not a trace file: " + filename);
+    }
+
+    std::vector<uint8_t> header(HEADER_SIZE);
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(header.data()), header.size());
+    if (std::memcmp(header.data(), TRACE_MAGIC, 8) != 0) {
+        throw SimulatorException("Not a trace file: " + filename);
+    }
+    ByteCursor headerCursor(header, filename);
+    headerCursor.fixed(8);
+    uint32_t version = static_cast<uint32_t>(headerCursor.fixed(4));
+    if (version != TraceWriter::VERSION) {
+        throw SimulatorException("Unsupported trace version " + std::to_string(version) + " in " + filename);
+    }
+    blockCycles = static_cast<uint32_t>(headerCursor.fixed(4));
+
+    std::vector<uint8_t> trailer(TRAILER_SIZE);
+    file.seekg(static_cast<std::streamoff>(size - TRAILER_SIZE));
+    file.read(reinterpret_cast<char*>(trailer.data()), trailer.size());
+    if (std::memcmp(trailer.data() + 8, INDEX_MAGIC, 8) != 0) {
+        throw SimulatorException("Trace file " + filename + " has no index (was the run interrupted?)");
+    }
+    ByteCursor trailerCursor(trailer, filename);
+    footerOffset = trailerCursor.fixed(8);
+    if (footerOffset < HEADER_SIZE || footerOffset > size - TRAILER_SIZE) {
+        throw SimulatorException("Corrupt trace index in " + filename);
+    }
+
+    std::vector<uint8_t> footer(size - TRAILER_SIZE - footerOffset);
+    file.seekg(static_cast<std::streamoff>(footerOffset));
+    file.read(reinterpret_cast<char*>(footer.data()), footer.size());
+    ByteCursor cursor(footer, filename);
+
+    uint32_t signalCount = static_cast<uint32_t>(cursor.fixed(4));
+    for (uint32_t i = 0; i < signalCount; ++i) {
+        TraceSignal signal;
+        signal.width = static_cast<uint8_t>(cursor.fixed(1));
+        signal.name = cursor.text(cursor.fixed(2));
+        signals.push_back(signal);
+    }
+    uint32_t blockCount = static_cast<uint32_t>(cursor.fixed(4));
+    for (uint32_t i = 0; i < blockCount; ++i) {
+        BlockIndex block;
+        block.firstCycle = cursor.fixed(8);
+        block.lastCycle = cursor.fixed(8);
+        block.offset = cursor.fixed(8);
+        if (block.offset < HEADER_SIZE || block.offset >= footerOffset) {
+            throw SimulatorException("Corrupt trace index in " + filename);
+        }
+        index.push_back(block);
+    }
+}
+
+TraceReader::DecodedBlock TraceReader::decodeBlock(size_t block) {
+    uint64_t begin = index[block].offset;
+    uint64_t end = block + 1 < index.size() ? index[block + 1].offset : footerOffset;
+    if (end < begin) {
+        throw SimulatorException("Corrupt trace index in " + filename);
+    }
+
+    std::vector<uint8_t> bytes(end - begin);
+    file.clear();
+    file.seekg(static_cast<std::streamoff>(begin));
+    file.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
+    ByteCursor cursor(bytes, filename);
+
+    uint64_t start = cursor.varint();
+    cursor.varint();  // Cycle count; the index already holds the last cycle
+    uint64_t signalCount = cursor.varint();
+    if (signalCount > signals.size()) {
+        throw SimulatorException("Corrupt trace block in " + filename);
+    }
+
+    DecodedBlock decoded;
+    decoded.initial.assign(signals.size(), 0);
+    decoded.changes.resize(signals.size());
+    std::vector<uint64_t> columnBytes(signalCount);
+    for (uint64_t i = 0; i < signalCount; ++i) {
+        decoded.initial[i] = static_cast<uint32_t>(cursor.varint());
+        columnBytes[i] = cursor.varint();
+    }
+
+    for (uint64_t i = 0; i < signalCount; ++i) {
+        size_t columnEnd = cursor.position() + columnBytes[i];
+        uint64_t cycle = start;
+        uint32_t value = decoded.initial[i];
+        bool wide = signals[i].width > 1;
+
+        while (cursor.position() < columnEnd) {
+            uint64_t delta = cursor.varint();
+            int64_t valueDelta = wide ? unzigzag(cursor.varint()) : 0;
+            uint64_t repeat = cursor.varint();
+            for (uint64_t r = 0; r < repeat; ++r) {
+                cycle += delta;
+                value = wide ? static_cast<uint32_t>(value + valueDelta) : value ^ 1;
+                decoded.changes[i].push_back({cycle, value});
+            }
+        }
+        if (cursor.position() != columnEnd) {
+            throw SimulatorException("Corrupt trace column in " + filename);
+        }
+    }
+    return decoded;
+}
+
+void TraceReader::readCycles(uint64_t first, uint64_t last,
+                             const std::function<void(uint64_t, const std::vector<uint32_t>&)>& visit) {
+    // First block that ends at or after the start of the range
+    auto it = std::lower_bound(index.begin(), index.end(), first,
+                               [](const BlockIndex& block, uint64_t cycle) { return block.lastCycle < cycle; });
+
+    std::vector<uint32_t> values(signals.size());
+    for (size_t b = it - index.begin(); b < index.size() && index[b].firstCycle <= last; ++b) {
+        DecodedBlock decoded = decodeBlock(b);
+        values = decoded.initial;
+        std::vector<size_t> next(signals.size(), 0);
+
+        uint64_t from = std::max(first, index[b].firstCycle);
+        uint64_t to = std::min(last, index[b].lastCycle);
+        for (uint64_t cycle = index[b].firstCycle; cycle <= to; ++cycle) {
+            for (size_t s = 0; s < signals.size(); ++s) {
+                const std::vector<Change>& changes = decoded.changes[s];
+                while (next[s] < changes.size() && changes[next[s]].cycle <= cycle) {
+                    values[s] = changes[next[s]++].value;
+                }
+            }
+            if (cycle >= from) {
+                visit(cycle, values);
+            }
+        }
+    }
+}
+
+void TraceReader::dump(std::ostream& os, uint64_t first, uint64_t last) {
+    os << "# " << filename << ": " << signals.size() << " signals, " << index.size() << " blocks";
+    if (!index.empty()) {
+        os << ", cycles " << getFirstCycle() << "-" << getLastCycle();
+    }
+    os << '\n';
+
+    os << "Cycle";
+    for (const TraceSignal& signal : signals) {
+        os << "," << signal.name;
+    }
+    os << '\n';
+
+    readCycles(first, last, [&os](uint64_t cycle, const std::vector<uint32_t>& values) {
+        os << cycle;
+        for (uint32_t value : values) {
+            os << "," << value;
+        }
+        os << '\n';
+    });
+}
+
+} // namespace HotstateSim
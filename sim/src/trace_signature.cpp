@@ -0,0 +1,109 @@
+#include "trace_signature.h"
+#include "utils.h"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+namespace HotstateSim {
+
+namespace {
+
+constexpr const char* SIGNATURE_MAGIC = "HSSIG1";
+
+std::string hexHash(uint64_t hash) {
+    std::ostringstream out;
+    out << std::hex << std::setw(16) << std::setfill('0') << hash;
+    return out.str();
+}
+
+} // namespace
+
+TraceSignature::TraceSignature(uint32_t interval)
+    : interval(interval)
+    , nextCheckpoint(interval ? interval : UINT64_MAX)
+    , hash(SEED)
+    , cycles(0)
+    , lastAddress(UINT32_MAX)
+{
+}
+
+void TraceSignature::takeCheckpoint() {
+    checkpoints.push_back(hash);
+    nextCheckpoint += interval;
+}
+
+void TraceSignature::finish(uint64_t cycleCount) {
+    while (cycleCount >= nextCheckpoint) {
+        takeCheckpoint();
+    }
+    cycles = cycleCount;
+}
+
+bool TraceSignature::save(const std::string& filename) const {
+    std::ofstream file(filename);
+    if (!file.is_open()) {
+        return false;
+    }
+    file << SIGNATURE_MAGIC << "\n";
+    file << "cycles " << cycles << "\n";
+    file << "interval " << interval << "\n";
+    file << "final " << hexHash(hash) << "\n";
+    for (uint64_t checkpoint : checkpoints) {
+        file << hexHash(checkpoint) << "\n";
+    }
+    return static_cast<bool>(file);
+}
+
+TraceSignature TraceSignature::load(const std::string& filename) {
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        throw SimulatorException("Cannot open signature file: " + filename);
+    }
+    std::string magic, cyclesKey, intervalKey, finalKey, hashText;
+    uint64_t cycleCount = 0;
+    uint32_t every = 0;
+    if (!(file >> magic >> cyclesKey >> cycleCount >> intervalKey >> every >> finalKey >> hashText) ||
+        magic != SIGNATURE_MAGIC || cyclesKey != "cycles" || intervalKey != "interval" || finalKey != "final") {
+        throw SimulatorException("Not a trace signature file: " + filename);
+    }
+    TraceSignature signature(every);
+    signature.cycles = cycleCount;
+    try {
+        signature.hash = std::stoull(hashText, nullptr, 16);
+        while (file >> hashText) {
+            signature.checkpoints.push_back(std::stoull(hashText, nullptr, 16));
+        }
+    } catch (const std::exception&) {
+        throw SimulatorException("Bad hash '" + hashText + "' in signature file: " + filename);
+    }
+    return signature;
+}
+
+TraceSignature::Divergence TraceSignature::compare(const TraceSignature& golden, const TraceSignature& run) {
+    if (golden.interval != run.interval) {
+        throw SimulatorException("Signature intervals differ: golden " + std::to_string(golden.interval) +
+                                 ", run " + std::to_string(run.interval));
+    }
+    if (golden.hash == run.hash && golden.cycles == run.cycles) {
+        return {true, 0, 0};
+    }
+
+    // Checkpoints are cumulative: they agree up to the first divergent one
+    // and (barring collisions) differ from there on
+    size_t common = std::min(golden.checkpoints.size(), run.checkpoints.size());
+    size_t low = 0, high = common;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (golden.checkpoints[mid] == run.checkpoints[mid]) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    uint64_t first = low * golden.interval;
+    uint64_t last = low < common ? (low + 1) * golden.interval : std::max(golden.cycles, run.cycles);
+    return {false, first, last};
+}
+
+} // namespace HotstateSim
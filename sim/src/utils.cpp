@@ -4,6 +4,10 @@
 #include <sstream>
 #include <iostream>
 #include <climits>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 namespace HotstateSim {
 
@@ -71,6 +75,72 @@ uint32_t parseDecimal(const std::string& decStr) {
     }
 }
 
+uint64_t parseDecimal64(const std::string& decStr) {
+    std::string trimmed = trim(decStr);
+    try {
+        return static_cast<uint64_t>(std::stoull(trimmed, nullptr, 10));
+    } catch (const std::exception& e) {
+        throw SimulatorException("Failed to parse decimal64 value: " + decStr);
+    }
+}
+
+uint64_t parseCycleCount(const std::string& text) {
+    size_t used = 0;
+    uint64_t count;
+    try {
+        count = std::stoull(text, &used);
+    } catch (const std::exception& e) {
+        throw SimulatorException("Invalid cycle count: " + text);
+    }
+    uint64_t scale = 1;
+    if (used + 1 == text.size()) {
+        switch (text[used]) {
+            case 'k': scale = 1000ULL; break;
+            case 'M': scale = 1000000ULL; break;
+            case 'G': scale = 1000000000ULL; break;
+            case 'T': scale = 1000000000000ULL; break;
+            default: throw SimulatorException("Invalid cycle count: " + text);
+        }
+    } else if (used != text.size() || text[0] == '-') {
+        throw SimulatorException("Invalid cycle count: " + text);
+    }
+    if (count > UINT64_MAX / scale) {
+        throw SimulatorException("Cycle count out of range: " + text);
+    }
+    return count * scale;
+}
+
+MappedFile::MappedFile(const std::string& filename, const std::string& kind) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw SimulatorException("Cannot open " + kind + ": " + filename);
+    }
+    
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        throw SimulatorException("Cannot stat " + kind + ": " + filename);
+    }
+    length = static_cast<size_t>(info.st_size);
+    
+    if (length > 0) {
+        void* mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            close(fd);
+            throw SimulatorException("Cannot map " + kind + ": " + filename);
+        }
+        data = static_cast<const uint8_t*>(mapping);
+        madvise(mapping, length, MADV_SEQUENTIAL);
+    }
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (data) {
+        munmap(const_cast<uint8_t*>(data), length);
+    }
+}
+
 bool fileExists(const std::string& filename) {
     std::ifstream file(filename);
     return file.good();
@@ -110,6 +180,35 @@ uint64_t extractBits(uint64_t value, uint32_t start, uint32_t width) {
     return (value >> start) & mask;
 }
 
+bool getWideBit(const uint64_t* words, uint32_t count, uint32_t bit) {
+    return bit / 64 < count && ((words[bit / 64] >> (bit % 64)) & 1ULL);
+}
+
+uint64_t extractWideBits(const uint64_t* words, uint32_t count, uint32_t start, uint32_t width) {
+    if (width == 0 || start / 64 >= count) {
+        return 0;
+    }
+    uint32_t word = start / 64;
+    uint32_t shift = start % 64;
+    uint64_t value = words[word] >> shift;
+    if (shift != 0 && width > 64 - shift && word + 1 < count) {
+        value |= words[word + 1] << (64 - shift);
+    }
+    return extractBits(value, 0, width);
+}
+
+std::string wideHexString(const uint64_t* words, uint32_t count) {
+    static const char DIGITS[] = "0123456789abcdef";
+    std::string hex;
+    for (uint32_t i = count * 16; i-- > 0;) {
+        uint32_t digit = (words[i / 16] >> (4 * (i % 16))) & 0xF;
+        if (digit != 0 || !hex.empty() || i == 0) {
+            hex.push_back(DIGITS[digit]);
+        }
+    }
+    return hex;
+}
+
 uint64_t signExtend(uint64_t value, uint32_t bitWidth) {
     if (bitWidth >= 64) return value;
     
@@ -0,0 +1,111 @@
+#include "arena.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+// All allocations are aligned to this boundary
+#define ARENA_ALIGNMENT (sizeof(void*) > sizeof(double) ? sizeof(void*) : sizeof(double))
+
+static size_t align_up(size_t n) {
+    return (n + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+}
+
+static ArenaChunk* new_chunk(size_t size) {
+    ArenaChunk* chunk = malloc(sizeof(ArenaChunk) + size);
+    if (!chunk) {
+        fprintf(stderr, "Error: Arena out of memory (requested %zu bytes)\n", size);
+        exit(EXIT_FAILURE);
+    }
+    chunk->next = NULL;
+    chunk->size = size;
+    chunk->used = 0;
+    return chunk;
+}
+
+// --- Arena Management ---
+
+Arena* arena_create(size_t chunk_size) {
+    Arena* arena = malloc(sizeof(Arena));
+    if (!arena) return NULL;
+    arena->chunk_size = chunk_size ? chunk_size : ARENA_DEFAULT_CHUNK_SIZE;
+    arena->head = new_chunk(arena->chunk_size);
+    arena->bytes_allocated = 0;
+    arena->chunk_count = 1;
+    return arena;
+}
+
+void arena_reset(Arena* arena) {
+    if (!arena) return;
+
+    // Keep the first chunk we ever made (the tail of the list) and drop the rest
+    ArenaChunk* chunk = arena->head;
+    while (chunk && chunk->next) {
+        ArenaChunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    arena->head = chunk;
+    if (chunk) chunk->used = 0;
+    arena->bytes_allocated = 0;
+    arena->chunk_count = chunk ? 1 : 0;
+}
+
+void arena_destroy(Arena* arena) {
+    if (!arena) return;
+    ArenaChunk* chunk = arena->head;
+    while (chunk) {
+        ArenaChunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    free(arena);
+}
+
+// --- Allocation ---
+
+void* arena_alloc(Arena* arena, size_t size) {
+    size = align_up(size ? size : 1);
+
+    if (!arena->head || arena->head->used + size > arena->head->size) {
+        // Oversized requests get a dedicated chunk
+        size_t chunk_size = size > arena->chunk_size ? size : arena->chunk_size;
+        ArenaChunk* chunk = new_chunk(chunk_size);
+        chunk->next = arena->head;
+        arena->head = chunk;
+        arena->chunk_count++;
+    }
+
+    void* ptr = arena->head->data + arena->head->used;
+    arena->head->used += size;
+    arena->bytes_allocated += size;
+    return ptr;
+}
+
+void* arena_realloc(Arena* arena, void* ptr, size_t old_size, size_t new_size) {
+    if (new_size <= old_size) return ptr;
+
+    // Grow in place if ptr was the last allocation in the current chunk
+    ArenaChunk* head = arena->head;
+    if (ptr && head && (char*)ptr + align_up(old_size) == head->data + head->used &&
+        (char*)ptr - head->data + align_up(new_size) <= head->size) {
+        size_t extra = align_up(new_size) - align_up(old_size);
+        head->used += extra;
+        arena->bytes_allocated += extra;
+        return ptr;
+    }
+
+    void* new_ptr = arena_alloc(arena, new_size);
+    if (ptr) memcpy(new_ptr, ptr, old_size);
+    return new_ptr;
+}
+
+char* arena_strndup(Arena* arena, const char* str, size_t len) {
+    char* copy = arena_alloc(arena, len + 1);
+    memcpy(copy, str, len);
+    copy[len] = '\0';
+    return copy;
+}
+
+char* arena_strdup(Arena* arena, const char* str) {
+    return arena_strndup(arena, str, strlen(str));
+}
@@ -0,0 +1,37 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// Simple bump allocator used for per-compilation data (tokens, AST).
+// Allocations are never freed individually; the whole arena is released
+// at once with arena_reset() or arena_destroy().
+
+#define ARENA_DEFAULT_CHUNK_SIZE (64 * 1024)
+
+typedef struct ArenaChunk {
+    struct ArenaChunk* next;
+    size_t size;    // Usable bytes in data[]
+    size_t used;    // Bytes handed out so far
+    char data[];
+} ArenaChunk;
+
+typedef struct Arena {
+    ArenaChunk* head;       // Current chunk (most recently allocated)
+    size_t chunk_size;      // Default size for new chunks
+    size_t bytes_allocated; // Total bytes handed out since last reset
+    int chunk_count;
+} Arena;
+
+// --- Arena Management ---
+Arena* arena_create(size_t chunk_size);
+void arena_reset(Arena* arena);   // Release everything but keep one chunk
+void arena_destroy(Arena* arena);
+
+// --- Allocation ---
+void* arena_alloc(Arena* arena, size_t size);
+void* arena_realloc(Arena* arena, void* ptr, size_t old_size, size_t new_size);
+char* arena_strdup(Arena* arena, const char* str);
+char* arena_strndup(Arena* arena, const char* str, size_t len);
+
+#endif // ARENA_H
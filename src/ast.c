@@ -1,4 +1,5 @@
 #include "ast.h"
+#include "ast_analysis.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -6,29 +7,83 @@
 
 // --- Debug Functions ---
 
-void print_debug(const char* format, ...) {
-    if (!debug_mode) return;
-    
+int debug_mode = 0;
+
+void print_debug_message(const char* format, ...) {
     va_list args;
     va_start(args, format);
     vprintf(format, args);
     va_end(args);
 }
 
+// --- Allocation ---
+
+// When set, all AST allocations come from this arena and free_node() becomes
+// a no-op; the whole tree is released in one go by arena_reset/arena_destroy.
+static Arena* ast_arena = NULL;
+
+void ast_set_arena(Arena* arena) {
+    ast_arena = arena;
+}
+
+Arena* ast_get_arena(void) {
+    return ast_arena;
+}
+
+void* ast_alloc(size_t size) {
+    if (ast_arena) {
+        return arena_alloc(ast_arena, size);
+    }
+    return malloc(size);
+}
+
+char* ast_strdup(const char* str) {
+    if (ast_arena) {
+        return arena_strdup(ast_arena, str);
+    }
+    size_t len = strlen(str);
+    char* copy = malloc(len + 1);
+    memcpy(copy, str, len + 1);
+    return copy;
+}
+
+// Ids index side tables such as the per-node attributes of analyze_ast
+static int next_node_id = 0;
+
+void ast_reset_node_ids(void) {
+    next_node_id = 0;
+}
+
+int ast_node_id_limit(void) {
+    return next_node_id;
+}
+
+static void init_node(Node* node, NodeType type) {
+    node->type = type;
+    node->id = next_node_id++;
+}
+
 // Helper to create a node list
 NodeList* create_node_list() {
-    NodeList* list = malloc(sizeof(NodeList));
+    NodeList* list = ast_alloc(sizeof(NodeList));
     list->capacity = 8;
     list->count = 0;
-    list->items = malloc(sizeof(Node*) * list->capacity);
+    list->items = ast_alloc(sizeof(Node*) * list->capacity);
     return list;
 }
 
 // Public function to add a node to a list, handling resize
 void add_node_to_list(NodeList* list, Node* node) {
     if (list->count == list->capacity) {
+        int old_capacity = list->capacity;
         list->capacity *= 2;
-        list->items = realloc(list->items, sizeof(Node*) * list->capacity);
+        if (ast_arena) {
+            list->items = arena_realloc(ast_arena, list->items,
+                                        sizeof(Node*) * old_capacity,
+                                        sizeof(Node*) * list->capacity);
+        } else {
+            list->items = realloc(list->items, sizeof(Node*) * list->capacity);
+        }
     }
     list->items[list->count++] = node;
 }
@@ -36,15 +91,16 @@ void add_node_to_list(NodeList* list, Node* node) {
 // --- Creation functions for each node type (with missing implementations added) ---
 
 Node* create_program_node() {
-    ProgramNode* node = malloc(sizeof(ProgramNode));
-    node->base.type = NODE_PROGRAM;
+    ProgramNode* node = ast_alloc(sizeof(ProgramNode));
+    init_node(&node->base, NODE_PROGRAM);
     node->functions = create_node_list();
+    node->analysis = NULL;
     return (Node*)node;
 }
 
 Node* create_function_def_node(char* name, NodeList* parameters, Node* body) {
-    FunctionDefNode* node = malloc(sizeof(FunctionDefNode));
-    node->base.type = NODE_FUNCTION_DEF;
+    FunctionDefNode* node = ast_alloc(sizeof(FunctionDefNode));
+    init_node(&node->base, NODE_FUNCTION_DEF);
     node->name = name; // Assumes ownership of name
     node->parameters = parameters;
     node->body = body;
@@ -52,15 +108,15 @@ Node* create_function_def_node(char* name, NodeList* parameters, Node* body) {
 }
 
 Node* create_block_node() {
-    BlockNode* node = malloc(sizeof(BlockNode));
-    node->base.type = NODE_BLOCK;
+    BlockNode* node = ast_alloc(sizeof(BlockNode));
+    init_node(&node->base, NODE_BLOCK);
     node->statements = create_node_list();
     return (Node*)node;
 }
 
 Node* create_var_decl_node(TokenType var_type, int is_unsigned, char* var_name, int array_size, int bit_width, Node* initializer) {
-    VarDeclNode* node = malloc(sizeof(VarDeclNode));
-    node->base.type = NODE_VAR_DECL;
+    VarDeclNode* node = ast_alloc(sizeof(VarDeclNode));
+    init_node(&node->base, NODE_VAR_DECL);
     node->var_type = var_type;
     node->is_unsigned = is_unsigned;
     node->var_name = var_name;
@@ -71,44 +127,44 @@ Node* create_var_decl_node(TokenType var_type, int is_unsigned, char* var_name,
 }
 
 Node* create_expression_statement_node(Node* expression) {
-    ExpressionStatementNode* node = malloc(sizeof(ExpressionStatementNode));
-    node->base.type = NODE_EXPRESSION_STATEMENT;
+    ExpressionStatementNode* node = ast_alloc(sizeof(ExpressionStatementNode));
+    init_node(&node->base, NODE_EXPRESSION_STATEMENT);
     node->expression = expression;
     return (Node*)node;
 }
 
 Node* create_switch_node(Node* expression) {
-    SwitchNode* node = malloc(sizeof(SwitchNode));
-    node->base.type = NODE_SWITCH;
+    SwitchNode* node = ast_alloc(sizeof(SwitchNode));
+    init_node(&node->base, NODE_SWITCH);
     node->expression = expression;
     node->cases = create_node_list();
     return (Node*)node;
 }
 
 Node* create_case_node(Node* value) {
-    CaseNode* node = malloc(sizeof(CaseNode));
-    node->base.type = NODE_CASE;
+    CaseNode* node = ast_alloc(sizeof(CaseNode));
+    init_node(&node->base, NODE_CASE);
     node->value = value;
     node->body = create_node_list();
     return (Node*)node;
 }
 
 Node* create_break_node() {
-    BreakNode* node = malloc(sizeof(BreakNode));
-    node->base.type = NODE_BREAK;
+    BreakNode* node = ast_alloc(sizeof(BreakNode));
+    init_node(&node->base, NODE_BREAK);
     return (Node*)node;
 }
 
 Node* create_continue_node() {
-    ContinueNode* node = malloc(sizeof(ContinueNode));
-    node->base.type = NODE_CONTINUE;
+    ContinueNode* node = ast_alloc(sizeof(ContinueNode));
+    init_node(&node->base, NODE_CONTINUE);
     return (Node*)node;
 }
 
 // --- MISSING IMPLEMENTATIONS ADDED HERE ---
 Node* create_binary_op_node(TokenType op, Node* left, Node* right) {
-    BinaryOpNode* node = malloc(sizeof(BinaryOpNode));
-    node->base.type = NODE_BINARY_OP;
+    BinaryOpNode* node = ast_alloc(sizeof(BinaryOpNode));
+    init_node(&node->base, NODE_BINARY_OP);
     node->op = op;
     node->left = left;
     node->right = right;
@@ -116,8 +172,8 @@ Node* create_binary_op_node(TokenType op, Node* left, Node* right) {
 }
 
 Node* create_unary_op_node(TokenType op, Node* operand) {
-    UnaryOpNode* node = malloc(sizeof(UnaryOpNode));
-    node->base.type = NODE_UNARY_OP;
+    UnaryOpNode* node = ast_alloc(sizeof(UnaryOpNode));
+    init_node(&node->base, NODE_UNARY_OP);
     node->op = op;
     node->operand = operand;
     return (Node*)node;
@@ -128,8 +184,8 @@ Node* create_assignment_node(Node* identifier, Node* value) {
     // A production compiler would have an assert here.
     // assert(identifier && identifier->type == NODE_IDENTIFIER);
 
-    AssignmentNode* node = malloc(sizeof(AssignmentNode));
-    node->base.type = NODE_ASSIGNMENT;
+    AssignmentNode* node = ast_alloc(sizeof(AssignmentNode));
+    init_node(&node->base, NODE_ASSIGNMENT);
     node->identifier = identifier; // Takes ownership of the identifier node
     node->value = value;
     return (Node*)node;
@@ -138,22 +194,22 @@ Node* create_assignment_node(Node* identifier, Node* value) {
 // --- END OF ADDED IMPLEMENTATIONS ---
 
 Node* create_identifier_node(char* name) {
-    IdentifierNode* node = malloc(sizeof(IdentifierNode));
-    node->base.type = NODE_IDENTIFIER;
+    IdentifierNode* node = ast_alloc(sizeof(IdentifierNode));
+    init_node(&node->base, NODE_IDENTIFIER);
     node->name = name;
     return (Node*)node;
 }
 
 Node* create_number_literal_node(char* value) {
-    NumberLiteralNode* node = malloc(sizeof(NumberLiteralNode));
-    node->base.type = NODE_NUMBER_LITERAL;
+    NumberLiteralNode* node = ast_alloc(sizeof(NumberLiteralNode));
+    init_node(&node->base, NODE_NUMBER_LITERAL);
     node->value = value;
     return (Node*)node;
 }
 
 Node* create_if_node(Node* condition, Node* then_branch, Node* else_branch) {
-    IfNode* node = malloc(sizeof(IfNode));
-    node->base.type = NODE_IF;
+    IfNode* node = ast_alloc(sizeof(IfNode));
+    init_node(&node->base, NODE_IF);
     node->condition = condition;
     node->then_branch = then_branch;
     node->else_branch = else_branch;  // Can be NULL
@@ -161,16 +217,16 @@ Node* create_if_node(Node* condition, Node* then_branch, Node* else_branch) {
 }
 
 Node* create_while_node(Node* condition, Node* body) {
-    WhileNode* node = malloc(sizeof(WhileNode));
-    node->base.type = NODE_WHILE;
+    WhileNode* node = ast_alloc(sizeof(WhileNode));
+    init_node(&node->base, NODE_WHILE);
     node->condition = condition;
     node->body = body;
     return (Node*)node;
 }
 
 Node* create_for_node(Node* init, Node* condition, Node* update, Node* body) {
-    ForNode* node = malloc(sizeof(ForNode));
-    node->base.type = NODE_FOR;
+    ForNode* node = ast_alloc(sizeof(ForNode));
+    init_node(&node->base, NODE_FOR);
     node->init = init;
     node->condition = condition;
     node->update = update;
@@ -179,58 +235,158 @@ Node* create_for_node(Node* init, Node* condition, Node* update, Node* body) {
 }
 
 Node* create_return_node(Node* return_value) {
-    ReturnNode* node = malloc(sizeof(ReturnNode));
-    node->base.type = NODE_RETURN;
+    ReturnNode* node = ast_alloc(sizeof(ReturnNode));
+    init_node(&node->base, NODE_RETURN);
     node->return_value = return_value;
     return (Node*)node;
 }
 
 Node* create_function_call_node(char* name, NodeList* arguments) {
-    FunctionCallNode* node = malloc(sizeof(FunctionCallNode));
-    node->base.type = NODE_FUNCTION_CALL;
+    FunctionCallNode* node = ast_alloc(sizeof(FunctionCallNode));
+    init_node(&node->base, NODE_FUNCTION_CALL);
     node->name = name;
     node->arguments = arguments;
     return (Node*)node;
 }
 
 Node* create_array_access_node(Node* array, Node* index) {
-    ArrayAccessNode* node = malloc(sizeof(ArrayAccessNode));
-    node->base.type = NODE_ARRAY_ACCESS;
+    ArrayAccessNode* node = ast_alloc(sizeof(ArrayAccessNode));
+    init_node(&node->base, NODE_ARRAY_ACCESS);
     node->array = array;
     node->index = index;
     return (Node*)node;
 }
 
 Node* create_bool_literal_node(int value) {
-    BoolLiteralNode* node = malloc(sizeof(BoolLiteralNode));
-    node->base.type = NODE_BOOL_LITERAL;
+    BoolLiteralNode* node = ast_alloc(sizeof(BoolLiteralNode));
+    init_node(&node->base, NODE_BOOL_LITERAL);
     node->value = value;
     return (Node*)node;
 }
 
 Node* create_initializer_list_node(NodeList* elements) {
-    InitializerListNode* node = malloc(sizeof(InitializerListNode));
-    node->base.type = NODE_INITIALIZER_LIST;
+    InitializerListNode* node = ast_alloc(sizeof(InitializerListNode));
+    init_node(&node->base, NODE_INITIALIZER_LIST);
     node->elements = elements;
     return (Node*)node;
 }
 
 Node* create_goto_node(char* label_name) {
-    GotoNode* node = malloc(sizeof(GotoNode));
-    node->base.type = NODE_GOTO;
+    GotoNode* node = ast_alloc(sizeof(GotoNode));
+    init_node(&node->base, NODE_GOTO);
     node->label_name = label_name;
     return (Node*)node;
  }
 
 Node* create_label_node(char* label_name, Node* statement) {
-    LabelNode* node = malloc(sizeof(LabelNode));
-    node->base.type = NODE_LABEL;
+    LabelNode* node = ast_alloc(sizeof(LabelNode));
+    init_node(&node->base, NODE_LABEL);
     node->label_name = label_name;
     node->statement = statement;
     return (Node*)node;
  }
 
 
+// --- Lookup ---
+
+FunctionDefNode* find_main_function(Node* ast_root) {
+    if (!ast_root || ast_root->type != NODE_PROGRAM) return NULL;
+    ProgramNode* program = (ProgramNode*)ast_root;
+    for (int i = 0; i < program->functions->count; i++) {
+        Node* item = program->functions->items[i];
+        if (item->type == NODE_FUNCTION_DEF && strcmp(((FunctionDefNode*)item)->name, "main") == 0) {
+            return (FunctionDefNode*)item;
+        }
+    }
+    return NULL;
+}
+
+bool constant_literal_value(const Node* node, long long* value) {
+    if (node && node->type == NODE_UNARY_OP && ((const UnaryOpNode*)node)->op == TOKEN_MINUS &&
+        constant_literal_value(((const UnaryOpNode*)node)->operand, value)) {
+        *value = -*value;
+        return true;
+    }
+    if (!node || node->type != NODE_NUMBER_LITERAL) {
+        return false;
+    }
+    char* end;
+    *value = strtoll(((const NumberLiteralNode*)node)->value, &end, 0);
+    return *end == '\0';
+}
+
+static bool is_identifier_named(const Node* node, const char* name) {
+    return node && node->type == NODE_IDENTIFIER && strcmp(((const IdentifierNode*)node)->name, name) == 0;
+}
+
+long long delay_loop_trips(const ForNode* for_node) {
+    const Node* body = for_node->body;
+    if (!body || body->type != NODE_BLOCK || ((const BlockNode*)body)->statements->count > 0) {
+        return -1;
+    }
+
+    const char* name = NULL;
+    long long start;
+    const Node* init = for_node->init;
+    if (init && init->type == NODE_VAR_DECL) {
+        const VarDeclNode* decl = (const VarDeclNode*)init;
+        if (decl->array_size > 0 || !constant_literal_value(decl->initializer, &start)) return -1;
+        name = decl->var_name;
+    } else if (init && init->type == NODE_ASSIGNMENT) {
+        const AssignmentNode* assign = (const AssignmentNode*)init;
+        if (!assign->identifier || assign->identifier->type != NODE_IDENTIFIER ||
+            !constant_literal_value(assign->value, &start)) return -1;
+        name = ((const IdentifierNode*)assign->identifier)->name;
+    } else {
+        return -1;
+    }
+
+    const Node* condition = for_node->condition;
+    if (!condition || condition->type != NODE_BINARY_OP) return -1;
+    const BinaryOpNode* test = (const BinaryOpNode*)condition;
+    long long limit;
+    if (!is_identifier_named(test->left, name) || !constant_literal_value(test->right, &limit)) return -1;
+
+    // i = i + s, i = s + i or i = i - s
+    const Node* update = for_node->update;
+    if (!update || update->type != NODE_ASSIGNMENT) return -1;
+    const AssignmentNode* assign = (const AssignmentNode*)update;
+    if (!is_identifier_named(assign->identifier, name) || !assign->value ||
+        assign->value->type != NODE_BINARY_OP) return -1;
+    const BinaryOpNode* sum = (const BinaryOpNode*)assign->value;
+    long long step;
+    bool counted = (sum->op == TOKEN_PLUS || sum->op == TOKEN_MINUS) &&
+                   is_identifier_named(sum->left, name) && constant_literal_value(sum->right, &step);
+    if (!counted && sum->op == TOKEN_PLUS) {
+        counted = is_identifier_named(sum->right, name) && constant_literal_value(sum->left, &step);
+    }
+    if (!counted || step == 0) return -1;
+    if (sum->op == TOKEN_MINUS) step = -step;
+
+    // Counting up to the limit, or down to it
+    long long distance = step > 0 ? limit - start : start - limit;
+    long long stride = step > 0 ? step : -step;
+    switch (test->op) {
+        case TOKEN_LESS:
+            if (step < 0) return -1;
+            return distance > 0 ? (distance + stride - 1) / stride : 0;
+        case TOKEN_LESS_EQUAL:
+            if (step < 0) return -1;
+            return distance >= 0 ? distance / stride + 1 : 0;
+        case TOKEN_GREATER:
+            if (step > 0) return -1;
+            return distance > 0 ? (distance + stride - 1) / stride : 0;
+        case TOKEN_GREATER_EQUAL:
+            if (step > 0) return -1;
+            return distance >= 0 ? distance / stride + 1 : 0;
+        case TOKEN_NOT_EQUAL:
+            // Stepping past the limit would run until the counter wraps
+            return distance >= 0 && distance % stride == 0 ? distance / stride : -1;
+        default:
+            return -1;
+    }
+}
+
 // --- Cleanup Functions ---
 
 // Recursively free a node list
@@ -248,11 +404,21 @@ static void free_node_list(NodeList* list) {
 // The fully implemented, correct free_node function.
 void free_node(Node* node) {
     if (!node) return;
+    // Arena-owned trees are released in bulk, never node by node; the
+    // program's analysis is on the heap either way
+    if (ast_arena) {
+        if (node->type == NODE_PROGRAM) {
+            free_ast_analysis(((ProgramNode*)node)->analysis);
+            ((ProgramNode*)node)->analysis = NULL;
+        }
+        return;
+    }
 
     switch (node->type) {
         case NODE_PROGRAM: {
             ProgramNode* n = (ProgramNode*)node;
             free_node_list(n->functions);
+            free_ast_analysis(n->analysis);
             break;
         }
         case NODE_FUNCTION_DEF: {
@@ -2,8 +2,9 @@
 #define AST_H
 
 #include "lexer.h"
+#include <stdbool.h>
 
-// Global debug flag (defined in main.c)
+// Global debug flag (defined in ast.c, set by --debug)
 extern int debug_mode;
 
 typedef enum {
@@ -36,6 +37,7 @@ typedef enum {
 // Base struct for all AST nodes
 typedef struct Node {
     NodeType type;
+    int id;    // Numbered from 0 in creation order since the last parse; -1 if not created here
 } Node;
 
 // A dynamic array of nodes
@@ -50,6 +52,7 @@ typedef struct {
 typedef struct {
     Node base;
     NodeList* functions;
+    struct AstAnalysis* analysis;  // Memoized by analyze_ast, NULL until then
 } ProgramNode;
 
 typedef struct {
@@ -222,11 +225,39 @@ Node* create_label_node(char* label_name, Node* statement);
 
 
 // --- AST Management ---
+void ast_set_arena(Arena* arena);   // NULL restores plain malloc/free
+Arena* ast_get_arena(void);
+void* ast_alloc(size_t size);
+char* ast_strdup(const char* str);
 NodeList* create_node_list();
 void add_node_to_list(NodeList* list, Node* node);
 void free_node(Node* node);
+void ast_reset_node_ids(void);      // parse() numbers each tree from 0
+int ast_node_id_limit(void);        // One past the highest id handed out
+
+// --- Lookup ---
+// The program's main(), or NULL. Microcode starts at main; other functions
+// are emitted only through the parameterless calls main reaches.
+FunctionDefNode* find_main_function(Node* ast_root);
+
+// --- Counted Loops ---
+// Whether node is a decimal, hex or octal literal, or one negated; its
+// value goes to *value
+bool constant_literal_value(const Node* node, long long* value);
+
+// The iterations of a for loop that only counts (a delay loop): an empty
+// body, the counter set to a constant, compared with one and stepped by
+// one. -1 for any other loop, or one that would not stop.
+long long delay_loop_trips(const ForNode* for_node);
 
 // --- Debug Functions ---
-void print_debug(const char* format, ...);
+// print_debug() formats nothing, and does not evaluate its arguments, unless
+// --debug is on. Building with -DNO_DEBUG_OUTPUT compiles the calls out.
+void print_debug_message(const char* format, ...);
+#ifdef NO_DEBUG_OUTPUT
+#define print_debug(...) do { if (0) print_debug_message(__VA_ARGS__); } while (0)
+#else
+#define print_debug(...) do { if (debug_mode) print_debug_message(__VA_ARGS__); } while (0)
+#endif
 
 #endif // AST_H
@@ -0,0 +1,200 @@
+#include "ast_analysis.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Folds a child's attributes into its parent's: everything under a node is
+// under its parent too
+static void add_child(NodeAttributes* parent, const NodeAttributes* child) {
+    parent->has_break |= child->has_break;
+    parent->has_goto |= child->has_goto;
+    parent->switch_count += child->switch_count;
+    if (child->max_case_value > parent->max_case_value) {
+        parent->max_case_value = child->max_case_value;
+    }
+    parent->input_mask |= child->input_mask;
+}
+
+// Attributes of each pooled node, in pool order
+typedef struct {
+    const FlatAst* flat;
+    NodeAttributes* pooled;
+} FlatAttributes;
+
+// Slot slot of pooled node index; all clear for an absent child
+static NodeAttributes slot_attributes(const FlatAttributes* walk, uint32_t index, uint32_t slot) {
+    static const NodeAttributes none = {0};
+    if (slot >= flat_child_count(walk->flat, index)) return none;
+    uint32_t child = flat_children(walk->flat, index)[slot];
+    return child == FLAT_AST_NONE ? none : walk->pooled[child];
+}
+
+// Words of the statements in slots first and up, which add up
+static int slot_words(const FlatAttributes* walk, uint32_t index, uint32_t first) {
+    int words = 0;
+    for (uint32_t slot = first; slot < flat_child_count(walk->flat, index); slot++) {
+        words += slot_attributes(walk, index, slot).words;
+    }
+    return words;
+}
+
+// A node's attributes from its children's, which the pool order has already
+// computed. The word counts follow process_statement closely enough to weigh
+// inlining against a call.
+static NodeAttributes analyze_pooled(const AstAnalysis* analysis, const FlatAttributes* walk, uint32_t index) {
+    Node* node = walk->flat->nodes[index];
+    NodeAttributes attributes = {0};
+    attributes.analyzed = true;
+    for (uint32_t slot = 0; slot < flat_child_count(walk->flat, index); slot++) {
+        NodeAttributes child = slot_attributes(walk, index, slot);
+        add_child(&attributes, &child);
+    }
+
+    switch (node->type) {
+        case NODE_PROGRAM:
+        case NODE_FUNCTION_DEF:
+        case NODE_VAR_DECL:
+        case NODE_FUNCTION_CALL:
+        case NODE_ARRAY_ACCESS:
+        case NODE_INITIALIZER_LIST:
+            break;
+        case NODE_BLOCK:
+            attributes.words = slot_words(walk, index, 0);
+            break;
+        case NODE_EXPRESSION_STATEMENT:
+        case NODE_RETURN:
+        case NODE_ASSIGNMENT:
+            attributes.words = 1;
+            break;
+        case NODE_IF:
+            attributes.words = 1 + slot_attributes(walk, index, 1).words;
+            if (((IfNode*)node)->else_branch) {
+                attributes.words += 1 + slot_attributes(walk, index, 2).words;
+            }
+            break;
+        case NODE_WHILE:
+            attributes.words = 2 + slot_attributes(walk, index, 1).words;
+            break;
+        case NODE_FOR:
+            attributes.words = 3 + slot_attributes(walk, index, 3).words;
+            break;
+        case NODE_SWITCH:
+            attributes.words = 2 + slot_words(walk, index, 1);
+            attributes.switch_count++;
+            break;
+        case NODE_CASE: {
+            CaseNode* case_node = (CaseNode*)node;
+            attributes.words = 1 + slot_words(walk, index, 1);
+            if (case_node->value && case_node->value->type == NODE_NUMBER_LITERAL) {
+                int case_value = atoi(((NumberLiteralNode*)case_node->value)->value);
+                if (case_value > attributes.max_case_value) {
+                    attributes.max_case_value = case_value;
+                }
+            }
+            break;
+        }
+        case NODE_BREAK:
+        case NODE_CONTINUE:
+            attributes.has_break = true;
+            attributes.words = 1;
+            break;
+        case NODE_BINARY_OP:
+            attributes.input_only = slot_attributes(walk, index, 0).input_only &&
+                                    slot_attributes(walk, index, 1).input_only;
+            break;
+        case NODE_UNARY_OP:
+            attributes.input_only = slot_attributes(walk, index, 0).input_only;
+            break;
+        case NODE_IDENTIFIER: {
+            const char* name = ((IdentifierNode*)node)->name;
+            int input = analysis->hw_ctx ? get_input_number_by_name(analysis->hw_ctx, name) : -1;
+            if (input >= 0) {
+                attributes.input_only = true;
+                attributes.input_mask = 1ULL << (input < 63 ? input : 63);
+            } else if (analysis->hw_ctx) {
+                // A _BitInt input reads all of its bits
+                int width = get_input_width_by_name(analysis->hw_ctx, name);
+                for (int bit = 0; bit < width; bit++) {
+                    char bit_name[256];
+                    snprintf(bit_name, sizeof(bit_name), "%s[%d]", name, bit);
+                    input = get_input_number_by_name(analysis->hw_ctx, bit_name);
+                    attributes.input_only = true;
+                    attributes.input_mask |= 1ULL << (input < 63 ? input : 63);
+                }
+            }
+            break;
+        }
+        case NODE_NUMBER_LITERAL:
+        case NODE_BOOL_LITERAL:
+            attributes.input_only = true;
+            break;
+        case NODE_GOTO:
+            attributes.has_goto = true;
+            attributes.words = 1;
+            break;
+        case NODE_LABEL:
+            attributes.has_goto = true;
+            attributes.words = slot_attributes(walk, index, 0).words;
+            break;
+    }
+    return attributes;
+}
+
+// Every subtree follows its root in the pool, so walking it backwards
+// reaches each node after all of its children
+static void analyze_flat(AstAnalysis* analysis) {
+    const FlatAst* flat = analysis->flat;
+    FlatAttributes walk = { flat, malloc(sizeof(NodeAttributes) * (flat->count > 0 ? flat->count : 1)) };
+    if (!walk.pooled) {
+        fprintf(stderr, "Error: Failed to allocate AST analysis.\n");
+        exit(EXIT_FAILURE);
+    }
+    for (uint32_t index = flat->count; index-- > 0;) {
+        walk.pooled[index] = analyze_pooled(analysis, &walk, index);
+        // Nodes made after the tree was numbered are walked, not recorded
+        int id = flat->nodes[index]->id;
+        if (id >= 0 && id < analysis->count) {
+            analysis->nodes[id] = walk.pooled[index];
+        }
+    }
+    free(walk.pooled);
+}
+
+const AstAnalysis* analyze_ast(Node* ast_root, HardwareContext* hw_ctx) {
+    if (!ast_root || ast_root->type != NODE_PROGRAM) return NULL;
+    ProgramNode* program = (ProgramNode*)ast_root;
+    if (program->analysis && (!hw_ctx || program->analysis->hw_ctx == hw_ctx)) {
+        return program->analysis;
+    }
+    free_ast_analysis(program->analysis);
+
+    int count = ast_node_id_limit();
+    AstAnalysis* analysis = ast_alloc(sizeof(AstAnalysis));
+    NodeAttributes* nodes = ast_alloc(sizeof(NodeAttributes) * (count > 0 ? count : 1));
+    if (!analysis || !nodes) {
+        fprintf(stderr, "Error: Failed to allocate AST analysis.\n");
+        exit(EXIT_FAILURE);
+    }
+    memset(nodes, 0, sizeof(NodeAttributes) * count);
+    analysis->nodes = nodes;
+    analysis->count = count;
+    analysis->hw_ctx = hw_ctx;
+    analysis->flat = flatten_ast(ast_root);
+    analyze_flat(analysis);
+    program->analysis = analysis;
+    print_debug("DEBUG: analyze_ast: %d nodes%s\n", analysis->count, hw_ctx ? " with inputs" : "");
+    return analysis;
+}
+
+const NodeAttributes* node_attributes(const AstAnalysis* analysis, const Node* node) {
+    if (!analysis || !node || node->id < 0 || node->id >= analysis->count) return NULL;
+    const NodeAttributes* attributes = &analysis->nodes[node->id];
+    return attributes->analyzed ? attributes : NULL;
+}
+
+void free_ast_analysis(AstAnalysis* analysis) {
+    if (!analysis || ast_get_arena()) return;
+    free_flat_ast(analysis->flat);
+    free(analysis->nodes);
+    free(analysis);
+}
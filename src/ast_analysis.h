@@ -0,0 +1,44 @@
+#ifndef AST_ANALYSIS_H
+#define AST_ANALYSIS_H
+
+#include "ast.h"
+#include "ast_flat.h"
+#include "hw_analyzer.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// One bottom-up pass over the AST that records what the microcode passes
+// would otherwise re-walk subtrees for. Each node's attributes are built
+// from its children's, in a side table indexed by Node.id; the pass runs
+// backwards over the flat pool of the tree rather than recursing through it.
+
+typedef struct {
+    bool analyzed;        // False for nodes created after the pass, e.g. fused conditions
+    bool input_only;      // An expression of inputs and constants alone, which the LUT can decide
+    bool has_break;       // A break or continue at or under the node
+    bool has_goto;        // A goto or label at or under the node
+    int words;            // Microcode words one copy of the statement takes, roughly
+    int switch_count;     // Switch statements at or under the node
+    int max_case_value;   // Largest numeric case label among them, 0 if none
+    uint64_t input_mask;  // Inputs read at or under the node; inputs 63 and up share bit 63
+} NodeAttributes;
+
+typedef struct AstAnalysis {
+    NodeAttributes* nodes;    // By Node.id
+    int count;
+    HardwareContext* hw_ctx;  // Inputs were resolved against this; NULL leaves input_only and input_mask clear
+    FlatAst* flat;            // The tree as analysed, for passes that walk it in pool order
+} AstAnalysis;
+
+// The analysis of the program at ast_root, memoized on it. A cached
+// analysis is reused when hw_ctx is NULL or the one it was built with;
+// otherwise the tree is analysed again. Allocated like the AST, and freed
+// with it. NULL if ast_root is not a program.
+const AstAnalysis* analyze_ast(Node* ast_root, HardwareContext* hw_ctx);
+
+// The attributes of node, or NULL if the analysis did not see it
+const NodeAttributes* node_attributes(const AstAnalysis* analysis, const Node* node);
+
+void free_ast_analysis(AstAnalysis* analysis);
+
+#endif // AST_ANALYSIS_H
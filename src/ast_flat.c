@@ -0,0 +1,145 @@
+#include "ast_flat.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+static int list_count(const NodeList* list) {
+    return list ? list->count : 0;
+}
+
+// Child slots of a node, in the order ast_flat.h lists them
+static int slot_count(const Node* node) {
+    switch (node->type) {
+        case NODE_PROGRAM: return list_count(((const ProgramNode*)node)->functions);
+        case NODE_FUNCTION_DEF: return list_count(((const FunctionDefNode*)node)->parameters) + 1;
+        case NODE_BLOCK: return list_count(((const BlockNode*)node)->statements);
+        case NODE_SWITCH: return 1 + list_count(((const SwitchNode*)node)->cases);
+        case NODE_CASE: return 1 + list_count(((const CaseNode*)node)->body);
+        case NODE_FUNCTION_CALL: return list_count(((const FunctionCallNode*)node)->arguments);
+        case NODE_INITIALIZER_LIST: return list_count(((const InitializerListNode*)node)->elements);
+        case NODE_IF: return 3;
+        case NODE_FOR: return 4;
+        case NODE_WHILE:
+        case NODE_BINARY_OP:
+        case NODE_ASSIGNMENT:
+        case NODE_ARRAY_ACCESS:
+            return 2;
+        case NODE_VAR_DECL:
+        case NODE_EXPRESSION_STATEMENT:
+        case NODE_RETURN:
+        case NODE_UNARY_OP:
+        case NODE_LABEL:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+static Node* slot_at(const Node* node, int slot) {
+    switch (node->type) {
+        case NODE_PROGRAM: return ((const ProgramNode*)node)->functions->items[slot];
+        case NODE_FUNCTION_DEF: {
+            const FunctionDefNode* func = (const FunctionDefNode*)node;
+            return slot < list_count(func->parameters) ? func->parameters->items[slot] : func->body;
+        }
+        case NODE_BLOCK: return ((const BlockNode*)node)->statements->items[slot];
+        case NODE_SWITCH: {
+            const SwitchNode* switch_node = (const SwitchNode*)node;
+            return slot == 0 ? switch_node->expression : switch_node->cases->items[slot - 1];
+        }
+        case NODE_CASE: {
+            const CaseNode* case_node = (const CaseNode*)node;
+            return slot == 0 ? case_node->value : case_node->body->items[slot - 1];
+        }
+        case NODE_FUNCTION_CALL: return ((const FunctionCallNode*)node)->arguments->items[slot];
+        case NODE_INITIALIZER_LIST: return ((const InitializerListNode*)node)->elements->items[slot];
+        case NODE_IF: {
+            const IfNode* if_node = (const IfNode*)node;
+            Node* slots[] = { if_node->condition, if_node->then_branch, if_node->else_branch };
+            return slots[slot];
+        }
+        case NODE_FOR: {
+            const ForNode* for_node = (const ForNode*)node;
+            Node* slots[] = { for_node->init, for_node->condition, for_node->update, for_node->body };
+            return slots[slot];
+        }
+        case NODE_WHILE:
+            return slot == 0 ? ((const WhileNode*)node)->condition : ((const WhileNode*)node)->body;
+        case NODE_BINARY_OP:
+            return slot == 0 ? ((const BinaryOpNode*)node)->left : ((const BinaryOpNode*)node)->right;
+        case NODE_ASSIGNMENT:
+            return slot == 0 ? ((const AssignmentNode*)node)->identifier : ((const AssignmentNode*)node)->value;
+        case NODE_ARRAY_ACCESS:
+            return slot == 0 ? ((const ArrayAccessNode*)node)->array : ((const ArrayAccessNode*)node)->index;
+        case NODE_VAR_DECL: return ((const VarDeclNode*)node)->initializer;
+        case NODE_EXPRESSION_STATEMENT: return ((const ExpressionStatementNode*)node)->expression;
+        case NODE_RETURN: return ((const ReturnNode*)node)->return_value;
+        case NODE_UNARY_OP: return ((const UnaryOpNode*)node)->operand;
+        case NODE_LABEL: return ((const LabelNode*)node)->statement;
+        default: return NULL;
+    }
+}
+
+// Nodes and child slots under node, node included
+static void count_subtree(const Node* node, uint32_t* nodes, uint32_t* slots) {
+    int count = slot_count(node);
+    (*nodes)++;
+    *slots += count;
+    for (int i = 0; i < count; i++) {
+        Node* child = slot_at(node, i);
+        if (child) count_subtree(child, nodes, slots);
+    }
+}
+
+// Pools node and its subtree. A node's slots are reserved before its
+// children are placed, so child_offsets grows with the pool index.
+static uint32_t place_subtree(FlatAst* flat, Node* node, uint32_t* child_at) {
+    uint32_t index = flat->count++;
+    int count = slot_count(node);
+    flat->nodes[index] = node;
+    flat->child_offsets[index] = *child_at;
+    *child_at += count;
+    for (int i = 0; i < count; i++) {
+        Node* child = slot_at(node, i);
+        flat->children[flat->child_offsets[index] + i] = child ? place_subtree(flat, child, child_at) : FLAT_AST_NONE;
+    }
+    flat->subtree_end[index] = flat->count;
+    return index;
+}
+
+FlatAst* flatten_ast(Node* root) {
+    if (!root) return NULL;
+
+    uint32_t node_total = 0, slot_total = 0;
+    count_subtree(root, &node_total, &slot_total);
+
+    FlatAst* flat = ast_alloc(sizeof(FlatAst));
+    if (!flat) {
+        fprintf(stderr, "Error: Failed to allocate flat AST.\n");
+        exit(EXIT_FAILURE);
+    }
+    flat->nodes = ast_alloc(sizeof(Node*) * node_total);
+    flat->subtree_end = ast_alloc(sizeof(uint32_t) * node_total);
+    flat->child_offsets = ast_alloc(sizeof(uint32_t) * (node_total + 1));
+    flat->children = ast_alloc(sizeof(uint32_t) * (slot_total > 0 ? slot_total : 1));
+    if (!flat->nodes || !flat->subtree_end || !flat->child_offsets || !flat->children) {
+        fprintf(stderr, "Error: Failed to allocate flat AST.\n");
+        exit(EXIT_FAILURE);
+    }
+    flat->count = 0;
+    flat->child_total = slot_total;
+
+    uint32_t child_at = 0;
+    place_subtree(flat, root, &child_at);
+    flat->child_offsets[flat->count] = child_at;
+    print_debug("DEBUG: flatten_ast: %u nodes, %u child slots\n", flat->count, flat->child_total);
+    return flat;
+}
+
+void free_flat_ast(FlatAst* flat) {
+    if (!flat || ast_get_arena()) return;
+    free(flat->nodes);
+    free(flat->subtree_end);
+    free(flat->child_offsets);
+    free(flat->children);
+    free(flat);
+}
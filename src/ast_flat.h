@@ -0,0 +1,59 @@
+#ifndef AST_FLAT_H
+#define AST_FLAT_H
+
+#include "ast.h"
+#include <stdint.h>
+
+// A flat view of an AST: its nodes in one contiguous pool in pre-order,
+// addressed by 32-bit indices, with every node's children as a range of a
+// shared index array. A node's whole subtree follows it in the pool, so a
+// bottom-up pass is a loop from the last node to the first instead of a
+// recursive walk across the heap.
+//
+// Children are stored in a fixed slot order per node type, with
+// FLAT_AST_NONE for an absent optional child:
+//   PROGRAM              functions...
+//   FUNCTION_DEF         parameters..., body
+//   BLOCK                statements...
+//   VAR_DECL             initializer
+//   EXPRESSION_STATEMENT expression
+//   IF                   condition, then_branch, else_branch
+//   WHILE                condition, body
+//   FOR                  init, condition, update, body
+//   SWITCH               expression, cases...
+//   CASE                 value, body...
+//   RETURN               return_value
+//   BINARY_OP            left, right
+//   UNARY_OP             operand
+//   ASSIGNMENT           identifier, value
+//   FUNCTION_CALL        arguments...
+//   ARRAY_ACCESS         array, index
+//   INITIALIZER_LIST     elements...
+//   LABEL                statement
+
+#define FLAT_AST_NONE UINT32_MAX
+
+typedef struct FlatAst {
+    Node** nodes;             // The pool, in pre-order; nodes[0] is the root
+    uint32_t* subtree_end;    // nodes[i]'s subtree is nodes[i] up to, not including, nodes[subtree_end[i]]
+    uint32_t* child_offsets;  // Children of nodes[i] are children[child_offsets[i]] up to child_offsets[i + 1]
+    uint32_t* children;       // Pool indices, shared by every node
+    uint32_t count;
+    uint32_t child_total;
+} FlatAst;
+
+// The flat view of the tree at root, allocated like the AST and freed with
+// it. The tree itself is not changed; a node reached twice is pooled twice.
+FlatAst* flatten_ast(Node* root);
+
+void free_flat_ast(FlatAst* flat);
+
+static inline uint32_t flat_child_count(const FlatAst* flat, uint32_t index) {
+    return flat->child_offsets[index + 1] - flat->child_offsets[index];
+}
+
+static inline const uint32_t* flat_children(const FlatAst* flat, uint32_t index) {
+    return &flat->children[flat->child_offsets[index]];
+}
+
+#endif // AST_FLAT_H
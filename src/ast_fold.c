@@ -0,0 +1,308 @@
+#include "ast_fold.h"
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+int fold_constants = 0;
+
+// The value of a number or bool literal, or of a negated number
+static bool literal_value(const Node* node, long long* value) {
+    if (node && node->type == NODE_BOOL_LITERAL) {
+        *value = ((const BoolLiteralNode*)node)->value;
+        return true;
+    }
+    return constant_literal_value(node, value);
+}
+
+// A literal for value; a negative one is written as the parser would
+// have built it, a minus applied to a number
+static Node* make_literal(long long value) {
+    char text[32];
+    if (value < 0 && value != LLONG_MIN) {
+        snprintf(text, sizeof(text), "%lld", -value);
+        return create_unary_op_node(TOKEN_MINUS, create_number_literal_node(ast_strdup(text)));
+    }
+    snprintf(text, sizeof(text), "%lld", value);
+    return create_number_literal_node(ast_strdup(text));
+}
+
+// Replaces node by a literal of value
+static Node* replace_with_literal(Node* node, long long value) {
+    free_node(node);
+    return make_literal(value);
+}
+
+// a op b for two literals; false for an operator this does not fold, or a
+// division by zero, which is left for the target to decide
+static bool fold_binary(TokenType op, long long a, long long b, long long* result) {
+    // Wrapping like the hardware would rather than overflowing
+    unsigned long long ua = (unsigned long long)a, ub = (unsigned long long)b;
+    switch (op) {
+        case TOKEN_PLUS:          *result = (long long)(ua + ub); return true;
+        case TOKEN_MINUS:         *result = (long long)(ua - ub); return true;
+        case TOKEN_STAR:          *result = (long long)(ua * ub); return true;
+        case TOKEN_SLASH:
+            if (b == 0 || (b == -1 && a == LLONG_MIN)) return false;
+            *result = a / b;
+            return true;
+        case TOKEN_EQUAL:         *result = a == b; return true;
+        case TOKEN_NOT_EQUAL:     *result = a != b; return true;
+        case TOKEN_LESS:          *result = a < b; return true;
+        case TOKEN_LESS_EQUAL:    *result = a <= b; return true;
+        case TOKEN_GREATER:       *result = a > b; return true;
+        case TOKEN_GREATER_EQUAL: *result = a >= b; return true;
+        case TOKEN_AND:           *result = a & b; return true;
+        case TOKEN_OR:            *result = a | b; return true;
+        case TOKEN_LOGICAL_AND:   *result = a && b; return true;
+        case TOKEN_LOGICAL_OR:    *result = a || b; return true;
+        default:                  return false;
+    }
+}
+
+// Folds expr, returning what replaces it. A condition only needs to keep
+// its truth, so there 1 && x and 0 || x can become x.
+static Node* fold_expression(Node* expr, bool condition) {
+    if (!expr) return NULL;
+    long long a, b, result;
+
+    switch (expr->type) {
+        case NODE_UNARY_OP: {
+            UnaryOpNode* unary = (UnaryOpNode*)expr;
+            unary->operand = fold_expression(unary->operand, unary->op == TOKEN_NOT);
+            if (unary->op == TOKEN_MINUS && unary->operand->type == NODE_NUMBER_LITERAL) {
+                return expr;  // Already a literal
+            }
+            if (literal_value(unary->operand, &a)) {
+                if (unary->op == TOKEN_NOT) return replace_with_literal(expr, !a);
+                if (unary->op == TOKEN_MINUS) return replace_with_literal(expr, (long long)(0ull - (unsigned long long)a));
+            }
+            return expr;
+        }
+        case NODE_BINARY_OP: {
+            BinaryOpNode* binary = (BinaryOpNode*)expr;
+            bool logical = binary->op == TOKEN_LOGICAL_AND || binary->op == TOKEN_LOGICAL_OR;
+            binary->left = fold_expression(binary->left, logical);
+            binary->right = fold_expression(binary->right, logical);
+            bool left_constant = literal_value(binary->left, &a);
+            bool right_constant = literal_value(binary->right, &b);
+            if (left_constant && right_constant) {
+                return fold_binary(binary->op, a, b, &result) ? replace_with_literal(expr, result) : expr;
+            }
+            if (!logical) return expr;
+
+            // One constant side: it decides the result, or leaves only the other
+            long long constant = left_constant ? a : b;
+            if (!left_constant && !right_constant) return expr;
+            bool decides = binary->op == TOKEN_LOGICAL_AND ? constant == 0 : constant != 0;
+            if (decides) {
+                // Only a constant left side means the other is never evaluated
+                if (left_constant) return replace_with_literal(expr, binary->op == TOKEN_LOGICAL_OR);
+                return expr;
+            }
+            if (!condition) return expr;
+            Node* other = left_constant ? binary->right : binary->left;
+            if (left_constant) binary->right = NULL; else binary->left = NULL;
+            free_node(expr);
+            return other;
+        }
+        case NODE_ASSIGNMENT: {
+            AssignmentNode* assign = (AssignmentNode*)expr;
+            assign->value = fold_expression(assign->value, false);
+            return expr;
+        }
+        case NODE_FUNCTION_CALL: {
+            FunctionCallNode* call = (FunctionCallNode*)expr;
+            for (int i = 0; call->arguments && i < call->arguments->count; i++) {
+                call->arguments->items[i] = fold_expression(call->arguments->items[i], false);
+            }
+            return expr;
+        }
+        case NODE_ARRAY_ACCESS: {
+            ArrayAccessNode* access = (ArrayAccessNode*)expr;
+            access->index = fold_expression(access->index, false);
+            return expr;
+        }
+        default:
+            return expr;
+    }
+}
+
+// Folds a condition; a constant one becomes the literal 0 or 1, the forms
+// ast_to_compact_microcode tests without a lookup
+static Node* fold_condition(Node* condition) {
+    condition = fold_expression(condition, true);
+    long long value;
+    if (literal_value(condition, &value) &&
+        !(condition->type == NODE_NUMBER_LITERAL && (value == 0 || value == 1))) {
+        return replace_with_literal(condition, value != 0);
+    }
+    return condition;
+}
+
+// Whether a goto could land inside stmt
+static bool contains_label(const Node* stmt) {
+    if (!stmt) return false;
+    switch (stmt->type) {
+        case NODE_LABEL:
+            return true;
+        case NODE_BLOCK: {
+            const NodeList* statements = ((const BlockNode*)stmt)->statements;
+            for (int i = 0; statements && i < statements->count; i++) {
+                if (contains_label(statements->items[i])) return true;
+            }
+            return false;
+        }
+        case NODE_IF: {
+            const IfNode* if_node = (const IfNode*)stmt;
+            return contains_label(if_node->then_branch) || contains_label(if_node->else_branch);
+        }
+        case NODE_WHILE:
+            return contains_label(((const WhileNode*)stmt)->body);
+        case NODE_FOR:
+            return contains_label(((const ForNode*)stmt)->body);
+        case NODE_SWITCH: {
+            const NodeList* cases = ((const SwitchNode*)stmt)->cases;
+            for (int i = 0; cases && i < cases->count; i++) {
+                const NodeList* body = ((const CaseNode*)cases->items[i])->body;
+                for (int j = 0; body && j < body->count; j++) {
+                    if (contains_label(body->items[j])) return true;
+                }
+            }
+            return false;
+        }
+        default:
+            return false;
+    }
+}
+
+static bool ends_flow(const Node* stmt) {
+    return stmt->type == NODE_BREAK || stmt->type == NODE_CONTINUE ||
+           stmt->type == NODE_GOTO || stmt->type == NODE_RETURN;
+}
+
+static Node* fold_statement(Node* stmt);
+
+// A statement that has to stay a statement: an empty block for none
+static Node* fold_nested_statement(Node* stmt) {
+    Node* folded = fold_statement(stmt);
+    return folded ? folded : create_block_node();
+}
+
+// Folds each statement of a list in place, dropping those folded away and
+// those no path reaches
+static void fold_statement_list(NodeList* statements) {
+    if (!statements) return;
+    int kept = 0;
+    bool unreachable = false;
+    for (int i = 0; i < statements->count; i++) {
+        Node* stmt = statements->items[i];
+        if (unreachable && !contains_label(stmt)) {
+            free_node(stmt);
+            continue;
+        }
+        unreachable = false;
+        stmt = fold_statement(stmt);
+        if (!stmt) continue;
+        statements->items[kept++] = stmt;
+        unreachable = ends_flow(stmt);
+    }
+    statements->count = kept;
+}
+
+// Folds stmt, returning what replaces it: NULL when nothing does
+static Node* fold_statement(Node* stmt) {
+    if (!stmt) return NULL;
+    long long value;
+
+    switch (stmt->type) {
+        case NODE_BLOCK:
+            fold_statement_list(((BlockNode*)stmt)->statements);
+            return stmt;
+        case NODE_IF: {
+            IfNode* if_node = (IfNode*)stmt;
+            if_node->condition = fold_condition(if_node->condition);
+            if_node->then_branch = fold_nested_statement(if_node->then_branch);
+            if_node->else_branch = fold_statement(if_node->else_branch);
+            if (!literal_value(if_node->condition, &value)) return stmt;
+            Node** taken = value ? &if_node->then_branch : &if_node->else_branch;
+            Node* skipped = value ? if_node->else_branch : if_node->then_branch;
+            if (contains_label(skipped)) return stmt;
+            Node* kept = *taken;
+            *taken = NULL;
+            free_node(stmt);
+            return kept;
+        }
+        case NODE_WHILE: {
+            WhileNode* while_node = (WhileNode*)stmt;
+            while_node->condition = fold_condition(while_node->condition);
+            while_node->body = fold_nested_statement(while_node->body);
+            if (literal_value(while_node->condition, &value) && value == 0 && !contains_label(while_node->body)) {
+                free_node(stmt);
+                return NULL;
+            }
+            return stmt;
+        }
+        case NODE_FOR: {
+            ForNode* for_node = (ForNode*)stmt;
+            if (for_node->init && for_node->init->type == NODE_VAR_DECL) {
+                VarDeclNode* decl = (VarDeclNode*)for_node->init;
+                decl->initializer = fold_expression(decl->initializer, false);
+            } else {
+                for_node->init = fold_expression(for_node->init, false);
+            }
+            if (for_node->condition) {
+                for_node->condition = fold_condition(for_node->condition);
+            }
+            for_node->update = fold_expression(for_node->update, false);
+            for_node->body = fold_nested_statement(for_node->body);
+            return stmt;
+        }
+        case NODE_SWITCH: {
+            SwitchNode* switch_node = (SwitchNode*)stmt;
+            switch_node->expression = fold_expression(switch_node->expression, false);
+            for (int i = 0; switch_node->cases && i < switch_node->cases->count; i++) {
+                CaseNode* case_node = (CaseNode*)switch_node->cases->items[i];
+                case_node->value = fold_expression(case_node->value, false);
+                fold_statement_list(case_node->body);
+            }
+            return stmt;
+        }
+        case NODE_LABEL: {
+            LabelNode* label = (LabelNode*)stmt;
+            label->statement = fold_nested_statement(label->statement);
+            return stmt;
+        }
+        case NODE_VAR_DECL: {
+            VarDeclNode* decl = (VarDeclNode*)stmt;
+            decl->initializer = fold_expression(decl->initializer, false);
+            return stmt;
+        }
+        case NODE_EXPRESSION_STATEMENT: {
+            ExpressionStatementNode* expr_stmt = (ExpressionStatementNode*)stmt;
+            expr_stmt->expression = fold_expression(expr_stmt->expression, false);
+            return stmt;
+        }
+        case NODE_RETURN: {
+            ReturnNode* ret = (ReturnNode*)stmt;
+            ret->return_value = fold_expression(ret->return_value, false);
+            return stmt;
+        }
+        default:
+            return fold_expression(stmt, false);
+    }
+}
+
+void fold_program_constants(Node* ast_root) {
+    if (!ast_root || ast_root->type != NODE_PROGRAM) return;
+    NodeList* functions = ((ProgramNode*)ast_root)->functions;
+    for (int i = 0; i < functions->count; i++) {
+        Node* node = functions->items[i];
+        if (node->type == NODE_FUNCTION_DEF) {
+            FunctionDefNode* function = (FunctionDefNode*)node;
+            function->body = fold_nested_statement(function->body);
+        } else {
+            // Globals: their initializers
+            fold_statement(node);
+        }
+    }
+}
@@ -0,0 +1,23 @@
+#ifndef AST_FOLD_H
+#define AST_FOLD_H
+
+#include "ast.h"
+
+// Constant folding over the whole program (--fold-constants), run on the
+// AST right after parsing so every later pass sees the smaller tree:
+//
+// - operators whose operands are literals become one literal, and a
+//   condition's && and || drop a constant side;
+// - a condition that is always true becomes 1, one that never is 0;
+// - if (0) keeps only its else part, if (1) only its then part, and
+//   while (0) goes away;
+// - statements after a break, continue, goto or return are dropped up to
+//   the next label.
+//
+// Nothing holding a label is dropped, since a goto may still reach it.
+// ast_to_compact_microcode then emits while (1) without its test.
+extern int fold_constants;
+
+void fold_program_constants(Node* ast_root);
+
+#endif // AST_FOLD_H
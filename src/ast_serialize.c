@@ -0,0 +1,406 @@
+#define _GNU_SOURCE  // For getpid
+#include "ast_serialize.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Deeper nesting than the parser's recursion reaches marks corrupt input
+#define AST_MAX_DEPTH 1024
+
+// --- Writing ---
+
+void ast_write(AstWriter* w, const void* bytes, size_t size) {
+    if (w->failed) return;
+    if (w->length + size > w->capacity) {
+        size_t capacity = w->capacity ? w->capacity : 4096;
+        while (w->length + size > capacity) capacity *= 2;
+        uint8_t* data = realloc(w->data, capacity);
+        if (!data) {
+            w->failed = true;
+            return;
+        }
+        w->data = data;
+        w->capacity = capacity;
+    }
+    memcpy(w->data + w->length, bytes, size);
+    w->length += size;
+}
+
+static void write_u8(AstWriter* w, uint8_t value) { ast_write(w, &value, sizeof(value)); }
+static void write_i32(AstWriter* w, int32_t value) { ast_write(w, &value, sizeof(value)); }
+void ast_write_u32(AstWriter* w, uint32_t value) { ast_write(w, &value, sizeof(value)); }
+void ast_write_u64(AstWriter* w, uint64_t value) { ast_write(w, &value, sizeof(value)); }
+
+static void write_string(AstWriter* w, const char* s) {
+    uint32_t length = (uint32_t)strlen(s);
+    ast_write_u32(w, length);
+    ast_write(w, s, length);
+}
+
+static void write_list(AstWriter* w, const NodeList* list) {
+    ast_write_u32(w, (uint32_t)list->count);
+    for (int i = 0; i < list->count; i++) {
+        ast_write_node(w, list->items[i]);
+    }
+}
+
+void ast_write_node(AstWriter* w, const Node* node) {
+    if (!node) {
+        write_u8(w, AST_ABSENT_NODE);
+        return;
+    }
+    write_u8(w, (uint8_t)node->type);
+    switch (node->type) {
+        case NODE_PROGRAM:
+            write_list(w, ((const ProgramNode*)node)->functions);
+            break;
+        case NODE_FUNCTION_DEF: {
+            const FunctionDefNode* func = (const FunctionDefNode*)node;
+            write_string(w, func->name);
+            write_list(w, func->parameters);
+            ast_write_node(w, func->body);
+            break;
+        }
+        case NODE_BLOCK:
+            write_list(w, ((const BlockNode*)node)->statements);
+            break;
+        case NODE_VAR_DECL: {
+            const VarDeclNode* decl = (const VarDeclNode*)node;
+            ast_write_u32(w, (uint32_t)decl->var_type);
+            write_u8(w, (uint8_t)decl->is_unsigned);
+            write_string(w, decl->var_name);
+            write_i32(w, decl->array_size);
+            write_i32(w, decl->bit_width);
+            ast_write_node(w, decl->initializer);
+            break;
+        }
+        case NODE_EXPRESSION_STATEMENT:
+            ast_write_node(w, ((const ExpressionStatementNode*)node)->expression);
+            break;
+        case NODE_IF: {
+            const IfNode* if_node = (const IfNode*)node;
+            ast_write_node(w, if_node->condition);
+            ast_write_node(w, if_node->then_branch);
+            ast_write_node(w, if_node->else_branch);
+            break;
+        }
+        case NODE_WHILE:
+            ast_write_node(w, ((const WhileNode*)node)->condition);
+            ast_write_node(w, ((const WhileNode*)node)->body);
+            break;
+        case NODE_FOR: {
+            const ForNode* for_node = (const ForNode*)node;
+            ast_write_node(w, for_node->init);
+            ast_write_node(w, for_node->condition);
+            ast_write_node(w, for_node->update);
+            ast_write_node(w, for_node->body);
+            break;
+        }
+        case NODE_SWITCH:
+            ast_write_node(w, ((const SwitchNode*)node)->expression);
+            write_list(w, ((const SwitchNode*)node)->cases);
+            break;
+        case NODE_CASE:
+            ast_write_node(w, ((const CaseNode*)node)->value);
+            write_list(w, ((const CaseNode*)node)->body);
+            break;
+        case NODE_RETURN:
+            ast_write_node(w, ((const ReturnNode*)node)->return_value);
+            break;
+        case NODE_BREAK:
+        case NODE_CONTINUE:
+            break;
+        case NODE_BINARY_OP: {
+            const BinaryOpNode* op = (const BinaryOpNode*)node;
+            ast_write_u32(w, (uint32_t)op->op);
+            ast_write_node(w, op->left);
+            ast_write_node(w, op->right);
+            break;
+        }
+        case NODE_UNARY_OP:
+            ast_write_u32(w, (uint32_t)((const UnaryOpNode*)node)->op);
+            ast_write_node(w, ((const UnaryOpNode*)node)->operand);
+            break;
+        case NODE_ASSIGNMENT:
+            ast_write_node(w, ((const AssignmentNode*)node)->identifier);
+            ast_write_node(w, ((const AssignmentNode*)node)->value);
+            break;
+        case NODE_FUNCTION_CALL:
+            write_string(w, ((const FunctionCallNode*)node)->name);
+            write_list(w, ((const FunctionCallNode*)node)->arguments);
+            break;
+        case NODE_ARRAY_ACCESS:
+            ast_write_node(w, ((const ArrayAccessNode*)node)->array);
+            ast_write_node(w, ((const ArrayAccessNode*)node)->index);
+            break;
+        case NODE_INITIALIZER_LIST:
+            write_list(w, ((const InitializerListNode*)node)->elements);
+            break;
+        case NODE_IDENTIFIER:
+            write_string(w, ((const IdentifierNode*)node)->name);
+            break;
+        case NODE_NUMBER_LITERAL:
+            write_string(w, ((const NumberLiteralNode*)node)->value);
+            break;
+        case NODE_BOOL_LITERAL:
+            write_u8(w, (uint8_t)((const BoolLiteralNode*)node)->value);
+            break;
+        case NODE_GOTO:
+            write_string(w, ((const GotoNode*)node)->label_name);
+            break;
+        case NODE_LABEL:
+            write_string(w, ((const LabelNode*)node)->label_name);
+            ast_write_node(w, ((const LabelNode*)node)->statement);
+            break;
+    }
+}
+
+// --- Reading ---
+
+bool ast_read(AstReader* r, void* bytes, size_t size) {
+    if (size > r->length - r->pos) return false;
+    memcpy(bytes, r->data + r->pos, size);
+    r->pos += size;
+    return true;
+}
+
+static bool read_u8(AstReader* r, uint8_t* value) { return ast_read(r, value, sizeof(*value)); }
+static bool read_i32(AstReader* r, int32_t* value) { return ast_read(r, value, sizeof(*value)); }
+bool ast_read_u32(AstReader* r, uint32_t* value) { return ast_read(r, value, sizeof(*value)); }
+bool ast_read_u64(AstReader* r, uint64_t* value) { return ast_read(r, value, sizeof(*value)); }
+
+// Reading builds nodes only when out is set; otherwise every read below
+// just checks and skips
+
+// Into the AST arena
+static bool read_string(AstReader* r, char** out) {
+    uint32_t length;
+    if (!ast_read_u32(r, &length) || length > r->length - r->pos) return false;
+    if (out) {
+        *out = ast_alloc(length + 1);
+        memcpy(*out, r->data + r->pos, length);
+        (*out)[length] = '\0';
+    }
+    r->pos += length;
+    return true;
+}
+
+static bool read_node(AstReader* r, Node** out, int depth);
+
+// Appends to list, which is NULL when only checking
+static bool read_list(AstReader* r, NodeList* list, int depth) {
+    uint32_t count;
+    if (!ast_read_u32(r, &count)) return false;
+    for (uint32_t i = 0; i < count; i++) {
+        Node* item = NULL;
+        if (!read_node(r, list ? &item : NULL, depth + 1)) return false;
+        if (list) add_node_to_list(list, item);
+    }
+    return true;
+}
+
+// The node's children, into the given slots when building
+static bool read_children(AstReader* r, bool build, int depth, Node** a, Node** b, Node** c, Node** d) {
+    Node** slots[] = { a, b, c, d };
+    for (int i = 0; i < 4 && slots[i]; i++) {
+        if (!read_node(r, build ? slots[i] : NULL, depth + 1)) return false;
+    }
+    return true;
+}
+
+static bool read_node(AstReader* r, Node** out, int depth) {
+    uint8_t type;
+    if (depth > AST_MAX_DEPTH || !read_u8(r, &type)) return false;
+    if (out) *out = NULL;
+    if (type == AST_ABSENT_NODE) return true;
+
+    bool build = out != NULL;
+    Node* a = NULL;
+    Node* b = NULL;
+    Node* c = NULL;
+    Node* d = NULL;
+    char* name = NULL;
+    uint32_t op;
+    switch (type) {
+        case NODE_PROGRAM: {
+            Node* node = build ? create_program_node() : NULL;
+            if (!read_list(r, build ? ((ProgramNode*)node)->functions : NULL, depth)) return false;
+            if (build) *out = node;
+            return true;
+        }
+        case NODE_FUNCTION_DEF: {
+            NodeList* parameters = build ? create_node_list() : NULL;
+            if (!read_string(r, build ? &name : NULL) || !read_list(r, parameters, depth) ||
+                !read_children(r, build, depth, &a, NULL, NULL, NULL)) {
+                return false;
+            }
+            if (build) *out = create_function_def_node(name, parameters, a);
+            return true;
+        }
+        case NODE_BLOCK: {
+            Node* node = build ? create_block_node() : NULL;
+            if (!read_list(r, build ? ((BlockNode*)node)->statements : NULL, depth)) return false;
+            if (build) *out = node;
+            return true;
+        }
+        case NODE_VAR_DECL: {
+            uint32_t var_type;
+            uint8_t is_unsigned;
+            int32_t array_size, bit_width;
+            if (!ast_read_u32(r, &var_type) || !read_u8(r, &is_unsigned) || !read_string(r, build ? &name : NULL) ||
+                !read_i32(r, &array_size) || !read_i32(r, &bit_width) ||
+                !read_children(r, build, depth, &a, NULL, NULL, NULL)) {
+                return false;
+            }
+            if (build) *out = create_var_decl_node((TokenType)var_type, is_unsigned, name, array_size, bit_width, a);
+            return true;
+        }
+        case NODE_EXPRESSION_STATEMENT:
+            if (!read_children(r, build, depth, &a, NULL, NULL, NULL)) return false;
+            if (build) *out = create_expression_statement_node(a);
+            return true;
+        case NODE_IF:
+            if (!read_children(r, build, depth, &a, &b, &c, NULL)) return false;
+            if (build) *out = create_if_node(a, b, c);
+            return true;
+        case NODE_WHILE:
+            if (!read_children(r, build, depth, &a, &b, NULL, NULL)) return false;
+            if (build) *out = create_while_node(a, b);
+            return true;
+        case NODE_FOR:
+            if (!read_children(r, build, depth, &a, &b, &c, &d)) return false;
+            if (build) *out = create_for_node(a, b, c, d);
+            return true;
+        case NODE_SWITCH:
+        case NODE_CASE: {
+            if (!read_children(r, build, depth, &a, NULL, NULL, NULL)) return false;
+            Node* node = NULL;
+            NodeList* list = NULL;
+            if (build && type == NODE_SWITCH) {
+                node = create_switch_node(a);
+                list = ((SwitchNode*)node)->cases;
+            } else if (build) {
+                node = create_case_node(a);
+                list = ((CaseNode*)node)->body;
+            }
+            if (!read_list(r, list, depth)) return false;
+            if (build) *out = node;
+            return true;
+        }
+        case NODE_RETURN:
+            if (!read_children(r, build, depth, &a, NULL, NULL, NULL)) return false;
+            if (build) *out = create_return_node(a);
+            return true;
+        case NODE_BREAK:
+            if (build) *out = create_break_node();
+            return true;
+        case NODE_CONTINUE:
+            if (build) *out = create_continue_node();
+            return true;
+        case NODE_BINARY_OP:
+            if (!ast_read_u32(r, &op) || !read_children(r, build, depth, &a, &b, NULL, NULL)) return false;
+            if (build) *out = create_binary_op_node((TokenType)op, a, b);
+            return true;
+        case NODE_UNARY_OP:
+            if (!ast_read_u32(r, &op) || !read_children(r, build, depth, &a, NULL, NULL, NULL)) return false;
+            if (build) *out = create_unary_op_node((TokenType)op, a);
+            return true;
+        case NODE_ASSIGNMENT:
+            if (!read_children(r, build, depth, &a, &b, NULL, NULL)) return false;
+            if (build) *out = create_assignment_node(a, b);
+            return true;
+        case NODE_FUNCTION_CALL: {
+            NodeList* arguments = build ? create_node_list() : NULL;
+            if (!read_string(r, build ? &name : NULL) || !read_list(r, arguments, depth)) return false;
+            if (build) *out = create_function_call_node(name, arguments);
+            return true;
+        }
+        case NODE_ARRAY_ACCESS:
+            if (!read_children(r, build, depth, &a, &b, NULL, NULL)) return false;
+            if (build) *out = create_array_access_node(a, b);
+            return true;
+        case NODE_INITIALIZER_LIST: {
+            NodeList* elements = build ? create_node_list() : NULL;
+            if (!read_list(r, elements, depth)) return false;
+            if (build) *out = create_initializer_list_node(elements);
+            return true;
+        }
+        case NODE_IDENTIFIER:
+        case NODE_NUMBER_LITERAL:
+        case NODE_GOTO:
+            if (!read_string(r, build ? &name : NULL)) return false;
+            if (build) {
+                *out = type == NODE_IDENTIFIER ? create_identifier_node(name)
+                     : type == NODE_NUMBER_LITERAL ? create_number_literal_node(name)
+                     : create_goto_node(name);
+            }
+            return true;
+        case NODE_BOOL_LITERAL: {
+            uint8_t value;
+            if (!read_u8(r, &value)) return false;
+            if (build) *out = create_bool_literal_node(value);
+            return true;
+        }
+        case NODE_LABEL:
+            if (!read_string(r, build ? &name : NULL) || !read_children(r, build, depth, &a, NULL, NULL, NULL)) {
+                return false;
+            }
+            if (build) *out = create_label_node(name, a);
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool ast_read_node(AstReader* r, Node** out) {
+    return read_node(r, out, 0);
+}
+
+// --- Files ---
+
+uint8_t* ast_read_file(const char* path, size_t* size) {
+    FILE* file = fopen(path, "rb");
+    if (!file) return NULL;
+    uint8_t* data = NULL;
+    size_t length = 0, capacity = 0, n;
+    do {
+        if (length + 1 >= capacity) {
+            capacity = capacity ? capacity * 2 : 65536;
+            uint8_t* grown = realloc(data, capacity);
+            if (!grown) {
+                free(data);
+                fclose(file);
+                return NULL;
+            }
+            data = grown;
+        }
+        n = fread(data + length, 1, capacity - length - 1, file);
+        length += n;
+    } while (n > 0);
+    bool failed = ferror(file);
+    fclose(file);
+    if (failed) {
+        free(data);
+        return NULL;
+    }
+    data[length] = '\0';
+    *size = length;
+    return data;
+}
+
+bool ast_write_file(const char* path, const AstWriter* w) {
+    if (w->failed) return false;
+    size_t length = strlen(path) + 32;
+    char* tmp_path = malloc(length);
+    if (!tmp_path) return false;
+    snprintf(tmp_path, length, "%s.tmp.%ld", path, (long)getpid());
+
+    FILE* file = fopen(tmp_path, "wb");
+    bool ok = file && fwrite(w->data, 1, w->length, file) == w->length;
+    if (file && fclose(file) != 0) ok = false;
+    if (ok) ok = rename(tmp_path, path) == 0;
+    if (!ok) unlink(tmp_path);
+    free(tmp_path);
+    return ok;
+}
@@ -0,0 +1,57 @@
+#ifndef AST_SERIALIZE_H
+#define AST_SERIALIZE_H
+
+#include "ast.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Parsed trees as bytes, for the files that keep parsing results between
+// compilations: precompiled headers (.hpch) and translation unit objects
+// (.hso). In host byte order; the files' magic numbers carry the version.
+//
+// A node is a uint8 NodeType, or AST_ABSENT_NODE for a NULL child,
+// followed by its fields in declaration order: TokenType and counts as
+// uint32, flags as uint8, sizes as int32, strings as a uint32 length and
+// the bytes, child lists as a uint32 count and the nodes.
+
+#define AST_ABSENT_NODE 0xff
+
+// Growable output; failed once an allocation has failed
+typedef struct {
+    uint8_t* data;
+    size_t length;
+    size_t capacity;
+    bool failed;
+} AstWriter;
+
+void ast_write(AstWriter* w, const void* bytes, size_t size);
+void ast_write_u32(AstWriter* w, uint32_t value);
+void ast_write_u64(AstWriter* w, uint64_t value);
+void ast_write_node(AstWriter* w, const Node* node);  // node may be NULL
+
+// Input being read; reads past the end fail
+typedef struct {
+    const uint8_t* data;
+    size_t length;
+    size_t pos;
+} AstReader;
+
+bool ast_read(AstReader* r, void* bytes, size_t size);
+bool ast_read_u32(AstReader* r, uint32_t* value);
+bool ast_read_u64(AstReader* r, uint64_t* value);
+
+// Builds the next node, or NULL for an absent one, in the current AST
+// arena; with out NULL only checks that it is well formed. False for
+// malformed input, part of a tree possibly built.
+bool ast_read_node(AstReader* r, Node** out);
+
+// The whole file, NUL-terminated so a source can be lexed; NULL if it
+// cannot be read
+uint8_t* ast_read_file(const char* path, size_t* size);
+
+// Writes w's bytes to path through a temporary file renamed into place, so
+// a compilation reading path meanwhile never sees half a file
+bool ast_write_file(const char* path, const AstWriter* w);
+
+#endif // AST_SERIALIZE_H
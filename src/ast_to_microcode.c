@@ -6,6 +6,11 @@
 #include "lexer.h"             // For TOKEN_
 #include "cfg_to_microcode.h"  // For HotstateMicrocode and HOTSTATE_ macros
 #include "expression_evaluator.h" // New: For SimulatedExpression and evaluator functions
+#include "pass_stats.h"
+#include "cfg_simplify.h"      // For the rotate_loops option
+#include "profile_use.h"
+#include "ast_fold.h"
+#include "mem_patch.h"
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
@@ -21,17 +26,59 @@ typedef struct {
 // Global variables for hotstate compatibility
 static int gSwitches = 0;
 
+int use_bdd_conditions = 0;
+int compact_microcode_words = 0;
+int pipeline_delay_slots = 0;
+int inline_call_words = 2;
+int fuse_conditions = 0;
+int merge_common_tails = 0;
+int use_varsel_logic = 0;
+
 // Forward declarations
 static void process_function(CompactMicrocode* mc, FunctionDefNode* func);
 static void process_statement(CompactMicrocode* mc, Node* stmt, int* addr);
-static void add_compact_instruction(CompactMicrocode* mc, MCode* mcode, const char* label, JumpType jump_type, int jump_target_param);
+static void process_rotated_while(CompactMicrocode* mc, WhileNode* while_node, int* addr);
+static void add_compact_instruction(CompactMicrocode* mc, MCode* mcode, WordLabel label, JumpType jump_type, int jump_target_param);
 static void resolve_compact_microcode_jumps(CompactMicrocode* mc);
 static void resolve_switch_break_addresses(CompactMicrocode* mc);
+static void reserve_switch(CompactMicrocode* mc, int switch_id, int start_addr);
+static void add_pending_switch_break(CompactMicrocode* mc, int instruction_index, int switch_id);
+static void compact_fused_words(CompactMicrocode* mc);
+static void merge_tails(CompactMicrocode* mc);
+static void insert_delay_slots(CompactMicrocode* mc);
+static void collect_subroutines(CompactMicrocode* mc, Node* ast_root, FunctionDefNode* main_func);
+static int subroutine_stack_depth(CompactMicrocode* mc, FunctionDefNode* main_func, bool* recursive);
+static void process_call(CompactMicrocode* mc, FunctionCallNode* call, int* addr);
+static void emit_subroutines(CompactMicrocode* mc, int* addr);
+static bool has_interrupt_handlers(CompactMicrocode* mc);
+static void collect_interrupt_vectors(CompactMicrocode* mc);
 // static uint32_t encode_compact_instruction(int state, int var, int timer, int jump,
 //                                           int switch_val, int timer_val, int cap,
 //                                           int var_val, int branch, int force, int ret);
 //static char* create_statement_label(Node* stmt);
 static char* create_condition_label(Node* condition);
+static char* reconstruct_source_code(Node* node);
+
+// Word labels record what to build the text from; see compact_word_label
+static WordLabel text_label(const char* text) {
+    return (WordLabel){ .kind = WORD_LABEL_TEXT, .format = text, .fused = -1 };
+}
+
+static WordLabel name_label(const char* format, const char* name) {
+    return (WordLabel){ .kind = WORD_LABEL_NAME, .format = format, .name = name, .fused = -1 };
+}
+
+static WordLabel condition_label(const char* format, const Node* condition) {
+    return (WordLabel){ .kind = WORD_LABEL_CONDITION, .format = format, .node = condition, .fused = -1 };
+}
+
+static WordLabel source_label(const Node* expression) {
+    return (WordLabel){ .kind = WORD_LABEL_SOURCE, .node = expression, .fused = -1 };
+}
+
+static WordLabel assign_label(const char* name, int value) {
+    return (WordLabel){ .kind = WORD_LABEL_ASSIGN, .name = name, .value = value, .fused = -1 };
+}
 
 // New function to populate MCode struct
 static void populate_mcode_instruction(
@@ -52,9 +99,6 @@ static void populate_mcode_instruction(
     uint32_t sub,
     uint32_t rtn
 );
-static int calculate_jump_address(CompactMicrocode* mc, IfNode* if_node, int current_addr);
-static int calculate_else_jump_address(CompactMicrocode* mc, IfNode* if_node, int current_addr);
-static int estimate_statement_size(Node* stmt);
 static void process_assignment(CompactMicrocode* mc, AssignmentNode* assign, int* addr);
 static void process_expression_statement(CompactMicrocode* mc, ExpressionStatementNode* expr_stmt, int* addr);
 static void process_switch_statement(CompactMicrocode* mc, SwitchNode* switch_node, int* addr);
@@ -68,19 +112,23 @@ static void calculate_comma_expression_fields(Node* comma_expr, HardwareContext*
 
 // Switch management functions
 static void populate_switch_memory(CompactMicrocode* mc, int switch_id, SwitchNode* switch_node, int* addr);
-static void add_switch_instruction(CompactMicrocode* mc, MCode* mcode, const char* label, int switch_id);
-static void add_case_instruction(CompactMicrocode* mc, MCode* mcode, const char* label, int switch_id);
+static void add_switch_instruction(CompactMicrocode* mc, MCode* mcode, WordLabel label, int switch_id);
+static void add_case_instruction(CompactMicrocode* mc, MCode* mcode, WordLabel label, int switch_id);
 // static uint32_t encode_switch_instruction(int switch_id, int is_switch_instr);
 static void push_context(CompactMicrocode* mc, LoopSwitchContext* context);
 static void pop_context(CompactMicrocode* mc);
-static void add_pending_jump(CompactMicrocode* mc, int instruction_index, int target_instruction_address, bool is_exit_jump);
+static void add_pending_jump(CompactMicrocode* mc, int instruction_index, int target_instruction_address, bool is_exit_jump, int label_id);
 static void resize_pending_jumps(CompactMicrocode* mc);
+static int new_label(CompactMicrocode* mc);
+static void bind_label(CompactMicrocode* mc, int label_id, int address);
 static void add_conditional_expression(CompactMicrocode* mc, Node* expression_node, int varsel_id);
 static void resize_conditional_expressions(CompactMicrocode* mc);
+static void build_vardata_lut(CompactMicrocode* mc, int num_total_input_vars);
+static void release_lowering_state(CompactMicrocode* mc);
+static void split_varsel_logic(CompactMicrocode* mc, int num_total_input_vars);
 static bool is_simple_variable_reference(Node* expr);
 static bool is_complex_boolean_expression(Node* expr);
 // static int calculate_required_switch_bits(Node* ast_root); // Declared in header
-static void find_max_case_value(Node* node, int* max_case_value);
 
 static void push_context(CompactMicrocode* mc, LoopSwitchContext* context) {
     if(mc->stack_ptr >= mc->stack_capacity) {
@@ -92,15 +140,36 @@ static void push_context(CompactMicrocode* mc, LoopSwitchContext* context) {
     mc->loop_switch_stack[mc->stack_ptr++] = *context;
 }
 
-static void add_pending_jump(CompactMicrocode* mc, int instruction_index, int target_instruction_address, bool is_exit_jump) {
+static void add_pending_jump(CompactMicrocode* mc, int instruction_index, int target_instruction_address, bool is_exit_jump, int label_id) {
     if (mc->pending_jump_count >= mc->pending_jump_capacity) {
         resize_pending_jumps(mc);
     }
     mc->pending_jumps[mc->pending_jump_count].instruction_index = instruction_index;
     mc->pending_jumps[mc->pending_jump_count].target_instruction_address = target_instruction_address;
     mc->pending_jumps[mc->pending_jump_count].is_exit_jump = is_exit_jump;
+    mc->pending_jumps[mc->pending_jump_count].label_id = label_id;
     mc->pending_jump_count++;
 }
+
+// Labels name forward targets: a jump can refer to one before its address
+// is known, and resolve_compact_microcode_jumps patches it once bound. This
+// keeps generation a single pass with no look-ahead sizing of subtrees.
+static int new_label(CompactMicrocode* mc) {
+    if (mc->label_count >= mc->label_capacity) {
+        mc->label_capacity *= 2;
+        mc->label_addresses = realloc(mc->label_addresses, sizeof(int) * mc->label_capacity);
+        if (mc->label_addresses == NULL) {
+            fprintf(stderr, "Error: Failed to reallocate label_addresses array.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    mc->label_addresses[mc->label_count] = -1;
+    return mc->label_count++;
+}
+
+static void bind_label(CompactMicrocode* mc, int label_id, int address) {
+    mc->label_addresses[label_id] = address;
+}
  
  static void resize_pending_jumps(CompactMicrocode* mc) {
      mc->pending_jump_capacity *= 2;
@@ -183,9 +252,11 @@ static bool is_constant_condition(Node* expr) {
 static int get_hybrid_varsel(Node* condition, CompactMicrocode* mc) {
     if (is_constant_condition(condition)) {
         return 0; // Constant conditions (like while(1)) don't need varSel
-    } else if (is_simple_variable_reference(condition)) {
+    } else if (is_simple_variable_reference(condition) &&
+               get_input_width_by_name(mc->hw_ctx, ((IdentifierNode*)condition)->name) == 0) {
         return 0; // Direct hardware input (c-parser efficiency)
-    } else if (is_complex_boolean_expression(condition)) {
+    } else if (is_complex_boolean_expression(condition) || is_simple_variable_reference(condition)) {
+        // A bare _BitInt input tests all of its bits for nonzero
         mc->has_complex_conditionals = 1; // Mark that we need LUT
         return mc->var_sel_counter++; // Use incremental counter like hotstate
     } else {
@@ -193,6 +264,94 @@ static int get_hybrid_varsel(Node* condition, CompactMicrocode* mc) {
     }
 }
 
+// An expression the Uber LUT can decide from the inputs alone. Conditions
+// from the parse were decided by analyze_ast; fused ones are built here.
+static bool is_input_condition(CompactMicrocode* mc, Node* expr) {
+    if (!expr) return false;
+    const NodeAttributes* attributes = node_attributes(mc->analysis, expr);
+    if (attributes) {
+        return attributes->input_only;
+    }
+    switch (expr->type) {
+        case NODE_IDENTIFIER:
+            return get_input_number_by_name(mc->hw_ctx, ((IdentifierNode*)expr)->name) != -1 ||
+                   get_input_width_by_name(mc->hw_ctx, ((IdentifierNode*)expr)->name) > 0;
+        case NODE_NUMBER_LITERAL:
+        case NODE_BOOL_LITERAL:
+            return true;
+        case NODE_BINARY_OP:
+            return is_input_condition(mc, ((BinaryOpNode*)expr)->left) &&
+                   is_input_condition(mc, ((BinaryOpNode*)expr)->right);
+        case NODE_UNARY_OP:
+            return is_input_condition(mc, ((UnaryOpNode*)expr)->operand);
+        default:
+            return false;
+    }
+}
+
+static Node* new_fused_condition(CompactMicrocode* mc, Node* outer, Node* inner) {
+    if (mc->fused_condition_count >= mc->fused_condition_capacity) {
+        mc->fused_condition_capacity = mc->fused_condition_capacity ? mc->fused_condition_capacity * 2 : 8;
+        mc->fused_conditions = realloc(mc->fused_conditions, sizeof(Node*) * mc->fused_condition_capacity);
+        if (!mc->fused_conditions) {
+            fprintf(stderr, "Error: Failed to allocate fused conditions.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    // Not from ast_alloc: the AST may live in an arena released before mc
+    BinaryOpNode* fused = calloc(1, sizeof(BinaryOpNode));
+    if (!fused) {
+        fprintf(stderr, "Error: Failed to allocate fused condition.\n");
+        exit(EXIT_FAILURE);
+    }
+    fused->base.type = NODE_BINARY_OP;
+    fused->base.id = -1;
+    fused->op = TOKEN_LOGICAL_AND;
+    fused->left = outer;
+    fused->right = inner;
+    mc->fused_conditions[mc->fused_condition_count++] = (Node*)fused;
+    return (Node*)fused;
+}
+
+static void record_dispatch_site(CompactMicrocode* mc, bool is_switch, const char* label, int arms, bool has_default) {
+    if (mc->dispatch_site_count >= mc->dispatch_site_capacity) {
+        mc->dispatch_site_capacity = mc->dispatch_site_capacity ? mc->dispatch_site_capacity * 2 : 8;
+        mc->dispatch_sites = realloc(mc->dispatch_sites, sizeof(DispatchSite) * mc->dispatch_site_capacity);
+        if (!mc->dispatch_sites) {
+            fprintf(stderr, "Error: Failed to allocate dispatch sites.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    DispatchSite* site = &mc->dispatch_sites[mc->dispatch_site_count++];
+    site->is_switch = is_switch;
+    site->label = strdup(label);
+    site->arms = arms;
+    site->has_default = has_default;
+}
+
+// if (a) { if (b) { S } } tests b only when a holds, one branch word and
+// cycle each; with neither if having an else, it is if (a && b) { S }, one
+// lookup in the varsel LUT. Chains of such guards fold into one condition.
+// Only input-only conditions are fused: the LUT sees nothing else.
+static void fuse_nested_conditions(CompactMicrocode* mc, Node** condition, Node** body) {
+    if (is_constant_condition(*condition) || !is_input_condition(mc, *condition)) return;
+    for (;;) {
+        Node* inner = *body;
+        while (inner && inner->type == NODE_BLOCK && ((BlockNode*)inner)->statements->count == 1) {
+            inner = ((BlockNode*)inner)->statements->items[0];
+        }
+        if (!inner || inner->type != NODE_IF) return;
+        IfNode* nested = (IfNode*)inner;
+        if (nested->else_branch || is_constant_condition(nested->condition) ||
+            !is_input_condition(mc, nested->condition)) {
+            return;
+        }
+        *condition = new_fused_condition(mc, *condition, nested->condition);
+        *body = nested->then_branch;
+        print_debug("DEBUG: fused nested if into one condition\n");
+    }
+}
+
 static void pop_context(CompactMicrocode* mc){
     if (mc->stack_ptr > 0) {
         mc->stack_ptr--;
@@ -217,7 +376,7 @@ static LoopSwitchContext peek_context(CompactMicrocode* mc, ContextSearchType se
         }
     }
     fprintf(stderr, "Error: 'break' or 'continue' statement outside of a valid context.\n");
-    LoopSwitchContext error_context = {-1, -1, -1}; // Return invalid targets for all fields (including break_target)
+    LoopSwitchContext error_context = {-1, -1, -1, NO_LABEL, NO_LABEL, -1}; // Return invalid targets for all fields (including break_target)
     return error_context;
 }
 
@@ -256,6 +415,17 @@ static void populate_mcode_instruction(
     mcode_ptr->sub = sub;
     mcode_ptr->rtn = rtn;
 
+    // The fields are packed; a value that lost bits does not read back
+    if (mcode_ptr->jadr != jadr_placeholder || mcode_ptr->varSel != varSel ||
+        mcode_ptr->timerSel != timerSel || mcode_ptr->timerLd != timerLd ||
+        mcode_ptr->switch_sel != switch_sel || mcode_ptr->switch_adr != switch_adr ||
+        mcode_ptr->state_capture != state_capture || mcode_ptr->var_or_timer != var_or_timer ||
+        mcode_ptr->branch != branch || mcode_ptr->forced_jmp != forced_jmp ||
+        mcode_ptr->sub != sub || mcode_ptr->rtn != rtn) {
+        fprintf(stderr, "Error: Microcode field value out of range.\n");
+        exit(EXIT_FAILURE);
+    }
+
     // Update max_val fields in CompactMicrocode for dynamic bit-width calculation
     // Update max_jadr_val based on the potential maximum address, not placeholder
     // This assumes actual addresses are within the range of potential jadr values
@@ -307,6 +477,250 @@ static void populate_mcode_instruction(
     }
 }
 
+// FNV-1a over one varsel block of vardata
+static uint32_t hash_lut_block(const uint8_t* block, int size) {
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < size; i++) {
+        hash ^= block[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Build vardata from the evaluated conditional expressions.
+// Every complex condition was handed its own varsel_id while generating code,
+// but many conditions compute the same truth table (e.g. the same test in
+// several if/while statements). Each table is expanded into a scratch block
+// and hashed; if an identical block already exists the varsel is mapped to
+// it instead. With BDDs the ref itself identifies the function, so
+// duplicates are found before anything is expanded. Only where each block
+// comes from is kept, and instruction varSel fields and varsel_ids are then
+// rewritten to the dense shared numbering, which shrinks vardata and
+// VARSEL_WIDTH.
+static void build_vardata_lut(CompactMicrocode* mc, int num_total_input_vars) {
+    int block_size = 1 << num_total_input_vars;
+    int varsel_count = mc->var_sel_counter; // ids handed out are 1..var_sel_counter-1
+
+    ConditionalExpressionInfo** info_by_varsel = calloc(varsel_count, sizeof(ConditionalExpressionInfo*));
+    int* varsel_remap = calloc(varsel_count, sizeof(int));
+    uint32_t* block_hashes = malloc(sizeof(uint32_t) * varsel_count);
+    // Open-addressing table of block indices + 1, keyed by block hash
+    int table_size = 16;
+    while (table_size < varsel_count * 2) table_size *= 2;
+    int* block_table = calloc(table_size, sizeof(int));
+    // Block index + 1 for each BDD ref already emitted
+    int* block_by_bdd = mc->bdd_mgr ? calloc(mc->bdd_mgr->node_count, sizeof(int)) : NULL;
+    // Block index + 1 for each simulated expression already emitted
+    int expr_count = simulated_expression_count(mc->sim_exprs);
+    int* block_by_expr = calloc(expr_count > 0 ? expr_count : 1, sizeof(int));
+    // The candidate block, and a block it may repeat
+    uint8_t* block = malloc(block_size);
+    uint8_t* other_block = malloc(block_size);
+
+    // Worst case every varsel keeps its own block; trimmed below
+    mc->vardata_inputs = num_total_input_vars;
+    mc->vardata_blocks = malloc(sizeof(VardataBlock) * varsel_count);
+    if (!info_by_varsel || !varsel_remap || !block_hashes || !block_table || !mc->vardata_blocks ||
+        (mc->bdd_mgr && !block_by_bdd) || !block_by_expr || !block || !other_block) {
+        fprintf(stderr, "Error: Failed to allocate vardata_lut.\n");
+        exit(EXIT_FAILURE);
+    }
+    mc->vardata_blocks[0] = (VardataBlock){NULL, -1}; // All zeros for varSel 0
+
+    for (int i = 0; i < mc->conditional_expression_count; i++) {
+        ConditionalExpressionInfo* info = &mc->conditional_expressions[i];
+        if (info->varsel_id <= 0 || info->varsel_id >= varsel_count) {
+            fprintf(stderr, "Error: varsel_id %d exceeds the %d varsels handed out\n",
+                    info->varsel_id, varsel_count);
+            continue; // Skip this entry to prevent buffer overflow
+        }
+        info_by_varsel[info->varsel_id] = info;
+    }
+
+    int block_count = 1; // Block 0 stays all zeros for varSel 0
+    for (int varsel = 1; varsel < varsel_count; varsel++) {
+        ConditionalExpressionInfo* info = info_by_varsel[varsel];
+
+        // A repeated condition has the same simulated expression as its first use
+        if (info && info->sim_expr && info->sim_expr->id >= 0 && block_by_expr[info->sim_expr->id] != 0) {
+            print_debug("DEBUG: varsel_id %d shares vardata block %d\n", varsel, block_by_expr[info->sim_expr->id] - 1);
+            varsel_remap[varsel] = block_by_expr[info->sim_expr->id] - 1;
+            continue;
+        }
+
+        VardataBlock source = {NULL, -1};
+        if (block_by_bdd && info && info->sim_expr && info->sim_expr->bdd >= 0) {
+            BddRef bdd = info->sim_expr->bdd;
+            if (block_by_bdd[bdd] != 0) {
+                print_debug("DEBUG: varsel_id %d shares vardata block %d\n", varsel, block_by_bdd[bdd] - 1);
+                varsel_remap[varsel] = block_by_bdd[bdd] - 1;
+                continue;
+            }
+            source.bdd = bdd;
+        } else if (info && info->sim_expr && info->sim_expr->LUT) {
+            // The support-reduced LUT for this expression, expanded over every input
+            source.expr = info->sim_expr;
+        } else {
+            fprintf(stderr, "Warning: No LUT found for varsel_id %d. Skipping copy.\n", varsel);
+        }
+        mc->vardata_blocks[block_count] = source;
+        vardata_block(mc, block_count, block);
+
+        uint32_t hash = hash_lut_block(block, block_size);
+        int slot = hash & (table_size - 1);
+        int shared = -1;
+        while (block_table[slot] != 0) {
+            int other = block_table[slot] - 1;
+            if (block_hashes[other] == hash) {
+                vardata_block(mc, other, other_block);
+                if (memcmp(other_block, block, block_size) == 0) {
+                    shared = other;
+                    break;
+                }
+            }
+            slot = (slot + 1) & (table_size - 1);
+        }
+
+        if (shared >= 0) {
+            print_debug("DEBUG: varsel_id %d shares vardata block %d\n", varsel, shared);
+            varsel_remap[varsel] = shared;
+        } else {
+            block_hashes[block_count] = hash;
+            block_table[slot] = block_count + 1;
+            if (block_by_bdd && source.bdd >= 0) {
+                block_by_bdd[source.bdd] = block_count + 1;
+            }
+            varsel_remap[varsel] = block_count++;
+        }
+        if (info && info->sim_expr && info->sim_expr->id >= 0) {
+            block_by_expr[info->sim_expr->id] = varsel_remap[varsel] + 1;
+        }
+    }
+
+    // Rewrite varsel numbering to the shared blocks
+    mc->max_varsel_val = 0;
+    for (int i = 0; i < mc->instruction_count; i++) {
+        MCode* mcode = &mc->instructions[i].uword.mcode;
+        if (mcode->varSel > 0 && mcode->varSel < (uint32_t)varsel_count) {
+            mcode->varSel = varsel_remap[mcode->varSel];
+        }
+        if (mcode->varSel > mc->max_varsel_val) {
+            mc->max_varsel_val = mcode->varSel;
+        }
+    }
+    for (int i = 0; i < mc->conditional_expression_count; i++) {
+        ConditionalExpressionInfo* info = &mc->conditional_expressions[i];
+        if (info->varsel_id > 0 && info->varsel_id < varsel_count) {
+            info->varsel_id = varsel_remap[info->varsel_id];
+        }
+    }
+    mc->var_sel_counter = block_count;
+
+    mc->vardata_lut_size = block_count * block_size;
+    VardataBlock* trimmed = realloc(mc->vardata_blocks, sizeof(VardataBlock) * block_count);
+    if (trimmed) mc->vardata_blocks = trimmed;
+    print_debug("DEBUG: vardata_lut of size: %d (%d of %d varsel blocks after sharing)\n",
+                mc->vardata_lut_size, block_count, varsel_count);
+
+    free(info_by_varsel);
+    free(varsel_remap);
+    free(block_hashes);
+    free(block_table);
+    free(block_by_bdd);
+    free(block_by_expr);
+    free(block);
+    free(other_block);
+}
+
+void vardata_block(const CompactMicrocode* mc, int block, uint8_t* dest) {
+    const VardataBlock* source = &mc->vardata_blocks[block];
+    if (source->bdd >= 0) {
+        bdd_to_lut(mc->bdd_mgr, source->bdd, dest, mc->vardata_inputs);
+    } else if (source->expr) {
+        expand_simulated_expression_lut(source->expr, dest, mc->vardata_inputs);
+    } else {
+        memset(dest, 0, (size_t)1 << mc->vardata_inputs);
+    }
+}
+
+// --varsel-logic: minimize each shared vardata block to a sum of
+// products, and renumber the varsels so the blocks that stay in the ROM
+// come first (block 0 still being varSel 0's) and the ones decided in
+// logic follow them. The ROM is then built from the first varsel_rom_blocks
+// blocks alone; vardata_blocks keeps them all in the new order.
+static void split_varsel_logic(CompactMicrocode* mc, int num_total_input_vars) {
+    int block_size = 1 << num_total_input_vars;
+    int block_count = mc->var_sel_counter;
+    VarselLogic* logic = calloc(block_count, sizeof(VarselLogic));
+    bool* in_logic = calloc(block_count, sizeof(bool));
+    int* varsel_remap = calloc(block_count, sizeof(int));
+    VardataBlock* reordered = malloc(sizeof(VardataBlock) * block_count);
+    uint8_t* block_lut = malloc(block_size);
+    if (!logic || !in_logic || !varsel_remap || !reordered || !block_lut) {
+        fprintf(stderr, "Error: Failed to allocate varsel logic.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    int logic_count = 0;
+    for (int block = 1; block < block_count; block++) {
+        VarselLogic* sop = &logic[block];
+        vardata_block(mc, block, block_lut);
+        sop->term_count = minimize_lut(block_lut, num_total_input_vars,
+                                       VARSEL_LOGIC_MAX_TERMS, sop->terms);
+        in_logic[block] = sop->term_count >= 0;
+        if (in_logic[block]) logic_count++;
+        print_debug("DEBUG: vardata block %d %s\n", block,
+                    in_logic[block] ? "minimized into logic" : "stays in the ROM");
+    }
+
+    int rom_blocks = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        int next = pass == 0 ? 0 : rom_blocks;
+        for (int block = 0; block < block_count; block++) {
+            if (in_logic[block] != (pass == 1)) continue;
+            varsel_remap[block] = next;
+            reordered[next] = mc->vardata_blocks[block];
+            next++;
+        }
+        if (pass == 0) rom_blocks = next;
+    }
+    free(mc->vardata_blocks);
+    mc->vardata_blocks = reordered;
+    free(block_lut);
+
+    mc->varsel_rom_blocks = rom_blocks;
+    mc->varsel_logic_count = logic_count;
+    mc->varsel_logic = logic_count > 0 ? malloc(sizeof(VarselLogic) * logic_count) : NULL;
+    for (int block = 1; block < block_count; block++) {
+        if (in_logic[block]) {
+            mc->varsel_logic[varsel_remap[block] - rom_blocks] = logic[block];
+        }
+    }
+
+    mc->max_varsel_val = 0;
+    for (int i = 0; i < mc->instruction_count; i++) {
+        MCode* mcode = &mc->instructions[i].uword.mcode;
+        if (mcode->varSel < (uint32_t)block_count) {
+            mcode->varSel = varsel_remap[mcode->varSel];
+        }
+        if (mcode->varSel > mc->max_varsel_val) {
+            mc->max_varsel_val = mcode->varSel;
+        }
+    }
+    for (int i = 0; i < mc->conditional_expression_count; i++) {
+        ConditionalExpressionInfo* info = &mc->conditional_expressions[i];
+        if (info->varsel_id > 0 && info->varsel_id < block_count) {
+            info->varsel_id = varsel_remap[info->varsel_id];
+        }
+    }
+    print_debug("DEBUG: varsel logic: %d of %d vardata blocks in logic, %d in the ROM\n",
+                logic_count, block_count - 1, rom_blocks);
+
+    free(logic);
+    free(in_logic);
+    free(varsel_remap);
+}
+
 CompactMicrocode* ast_to_compact_microcode(Node* ast_root, HardwareContext* hw_ctx) {
     if (!ast_root || ast_root->type != NODE_PROGRAM) {
         return NULL;
@@ -318,14 +732,19 @@ CompactMicrocode* ast_to_compact_microcode(Node* ast_root, HardwareContext* hw_c
     
     CompactMicrocode* mc = malloc(sizeof(CompactMicrocode));
     mc->instructions = (Code*)malloc(sizeof(mc->instructions[0]) * 32);
+    mc->word_labels = malloc(sizeof(WordLabel) * 32);
+    mc->labels = NULL;
     mc->instruction_count = 0;
     mc->timer_count = 0;
+    mc->timdata = NULL;
+    mc->timdata_count = 0;
+    mc->timdata_capacity = 0;
     mc->instruction_capacity = 32;
     mc->function_name = strdup("main"); //TODO: this needs to not be hardcoded
     mc->hw_ctx = hw_ctx;
     
     // Initialize switch memory management
-    mc->switchmem = calloc(MAX_SWITCH_ENTRIES * MAX_SWITCHES, sizeof(uint32_t));
+    mc->switchmem = NULL; // Grown a switch at a time by reserve_switch
     mc->switch_count = 0;
     mc->switch_offset_bits = switch_offset_bits; // Use global configurable value
     
@@ -363,8 +782,14 @@ CompactMicrocode* ast_to_compact_microcode(Node* ast_root, HardwareContext* hw_c
     }
     mc->conditional_expression_count = 0;
     mc->conditional_expression_capacity = 16;
-    mc->vardata_lut = NULL; // Will be allocated later
+    mc->vardata_blocks = NULL; // Will be allocated later
+    mc->vardata_inputs = 0;
     mc->vardata_lut_size = 0;
+    mc->varsel_rom_blocks = 0;
+    mc->varsel_logic = NULL;
+    mc->varsel_logic_count = 0;
+    mc->bdd_mgr = use_bdd_conditions ? bdd_create() : NULL;
+    mc->sim_exprs = NULL;
 
     // Initialize pending jump resolution
     mc->pending_jumps = (PendingJump*)malloc(sizeof(PendingJump) * 16); // Initial capacity
@@ -372,39 +797,46 @@ CompactMicrocode* ast_to_compact_microcode(Node* ast_root, HardwareContext* hw_c
         fprintf(stderr, "Error: Failed to allocate pending_jumps.\n");
         free(mc->instructions);
         free(mc->switchmem);
-        free(mc->conditional_expressions); // Free conditional_expressions as well
+        for (int i = 0; i < mc->conditional_expression_count; i++) {
+        free_simulated_expression(mc->conditional_expressions[i].sim_expr);
+    }
+    free(mc->conditional_expressions); // Free conditional_expressions as well
         free(mc);
         return NULL;
     }
     mc->pending_jump_count = 0;
     mc->pending_jump_capacity = 16;
 
-
-    // Initialize pending switch break resolution
-    mc->pending_switch_breaks = (PendingSwitchBreak*)malloc(sizeof(PendingSwitchBreak) * MAX_PENDING_SWITCH_BREAKS);
-    if (mc->pending_switch_breaks == NULL) {
-        fprintf(stderr, "Error: Failed to allocate pending_switch_breaks.\n");
+    mc->label_addresses = (int*)malloc(sizeof(int) * 16);
+    if (mc->label_addresses == NULL) {
+        fprintf(stderr, "Error: Failed to allocate label_addresses.\n");
         free(mc->pending_jumps);
         free(mc->instructions);
         free(mc->switchmem);
+        free(mc->conditional_expressions);
         free(mc);
         return NULL;
     }
-    mc->pending_switch_break_count = 0;
+    mc->label_count = 0;
+    mc->label_capacity = 16;
 
-    // Initialize switch info tracking
-    mc->switch_infos = (SwitchInfo*)malloc(sizeof(SwitchInfo) * MAX_SWITCHES);
-    if (mc->switch_infos == NULL) {
-        fprintf(stderr, "Error: Failed to allocate switch_infos.\n");
-        free(mc->pending_switch_breaks);
+    // Initialize pending switch break resolution
+    mc->pending_switch_breaks = (PendingSwitchBreak*)malloc(sizeof(PendingSwitchBreak) * 16);
+    if (mc->pending_switch_breaks == NULL) {
+        fprintf(stderr, "Error: Failed to allocate pending_switch_breaks.\n");
         free(mc->pending_jumps);
         free(mc->instructions);
         free(mc->switchmem);
         free(mc);
         return NULL;
     }
+    mc->pending_switch_break_count = 0;
+    mc->pending_switch_break_capacity = 16;
+
+    // Initialize switch info tracking
+    mc->switch_infos = NULL; // Grown a switch at a time by reserve_switch
     mc->switch_info_count = 0;
-    mc->switch_info_capacity = MAX_SWITCHES;
+    mc->switch_info_capacity = 0;
 
     // Initialize loop/switch stack
     mc->stack_ptr = 0;
@@ -420,19 +852,38 @@ CompactMicrocode* ast_to_compact_microcode(Node* ast_root, HardwareContext* hw_c
     }
     mc->pending_jump_count = 0;
     mc->pending_jump_capacity = 16;
-    
-    ProgramNode* program = (ProgramNode*)ast_root;
-    
-    // Find main function
-    for (int i = 0; i < program->functions->count; i++) {
-        Node* func_node = program->functions->items[i];
-        if (func_node->type == NODE_FUNCTION_DEF) {
-            FunctionDefNode* func = (FunctionDefNode*)func_node;
-            if (strcmp(func->name, "main") == 0) {
-                process_function(mc, func);
-                break;
-            }
-        }
+    mc->exit_address = 0; // Set properly once the function body has been emitted
+    mc->subroutines = NULL;
+    mc->subroutine_count = 0;
+    mc->return_label = NO_LABEL;
+    mc->stack_depth = 0;
+    mc->interrupt_vectors = NULL;
+    mc->interrupt_vector_count = 0;
+    mc->subroutine_bodies = NULL;
+    mc->subroutine_body_count = 0;
+    mc->pipelined = false;
+    mc->fused_conditions = NULL;
+    mc->fused_condition_count = 0;
+    mc->fused_condition_capacity = 0;
+    mc->dispatch_sites = NULL;
+    mc->dispatch_site_count = 0;
+    mc->dispatch_site_capacity = 0;
+    mc->ladder_link = NULL;
+    mc->fused_labels = NULL;
+    mc->fused_label_count = 0;
+    mc->fused_label_capacity = 0;
+    mc->analysis = analyze_ast(ast_root, hw_ctx);
+    
+    FunctionDefNode* main_func = find_main_function(ast_root);
+    if (main_func) {
+        collect_subroutines(mc, ast_root, main_func);
+        bool recursive = false;
+        mc->stack_depth = subroutine_stack_depth(mc, main_func, &recursive);
+        if (recursive) {
+            fprintf(stderr, "Warning: Recursive calls have no static stack bound; STACK_DEPTH set to %d\n",
+                    RECURSIVE_STACK_DEPTH);
+        }
+        process_function(mc, main_func);
     }
     
     // Resolve all pending jumps after all microcode has been generated
@@ -440,82 +891,85 @@ CompactMicrocode* ast_to_compact_microcode(Node* ast_root, HardwareContext* hw_c
     
     // Resolve switch break addresses after all microcode has been generated
     resolve_switch_break_addresses(mc);
+
+    // Fold state words into their neighbours once every address is final
+    if (compact_microcode_words) {
+        compact_fused_words(mc);
+    }
+    if (merge_common_tails) {
+        merge_tails(mc);
+    }
+    if (pipeline_delay_slots) {
+        if (mc->interrupt_vector_count > 0) {
+            fprintf(stderr, "Warning: --pipeline does not take interrupts; generating without delay slots\n");
+        } else {
+            insert_delay_slots(mc);
+        }
+    }
     
     // Phase 2.3.2: Call create_simulated_expression and eval_simulated_expression for collected conditional expressions
     // This needs to happen after all microcode is generated and addresses are resolved,
     // as evaluation might depend on final instruction counts or addresses for context.
     if (mc->has_complex_conditionals && mc->conditional_expression_count > 0) {
+        // Timed on its own: this ends the ast_to_compact_microcode pass, and
+        // the caller's pass_end() closes this one
+        pass_begin("conditional_luts");
         print_debug("DEBUG: Evaluating %d conditional expressions for Uber LUT.\n", mc->conditional_expression_count);
         // Determine the total number of input variables in the hardware context
         // This is needed to calculate the full LUT size (2^num_total_input_vars)
         int num_total_input_vars = mc->hw_ctx->input_count; // Assuming input_count is the correct measure
         print_debug("DEBUG: num_total_input_vars: %d\n", num_total_input_vars);
 
+        // Conditions that repeat share one simulated expression, evaluated once
+        mc->sim_exprs = create_simulated_expression_table(mc->hw_ctx);
         for (int i = 0; i < mc->conditional_expression_count; i++) {
             ConditionalExpressionInfo* info = &mc->conditional_expressions[i];
             print_debug("DEBUG: Creating and evaluating simulated expression for varsel_id %d.\n", info->varsel_id);
-            info->sim_expr = create_simulated_expression(info->expression_node, mc->hw_ctx);
-            if (info->sim_expr) {
+            info->sim_expr = intern_simulated_expression(mc->sim_exprs, info->expression_node);
+            if (info->sim_expr && (mc->bdd_mgr ? info->sim_expr->bdd >= 0 : info->sim_expr->LUT != NULL)) {
+                print_debug("DEBUG: varsel_id %d repeats simulated expression %d\n", info->varsel_id, info->sim_expr->id);
+            } else if (info->sim_expr && mc->bdd_mgr) {
+                // Tables are emitted straight from the BDD when vardata is built
+                BddRef bdd = build_simulated_expression_bdd(info->sim_expr, mc->hw_ctx, mc->bdd_mgr);
+                print_debug("DEBUG: BDD for varsel_id %d: ref %d, %d nodes, support 0x%x\n", info->varsel_id,
+                            bdd, bdd_size(mc->bdd_mgr, bdd), bdd_support(mc->bdd_mgr, bdd));
+                if (bdd_is_constant(bdd)) {
+                    print_debug("DEBUG: Condition for varsel_id %d is constant %d\n", info->varsel_id, bdd == BDD_TRUE);
+                }
+            } else if (info->sim_expr) {
                 eval_simulated_expression(info->sim_expr, mc->hw_ctx, num_total_input_vars);
                 print_debug("DEBUG: sim_expr->LUT_size for varsel_id %d: %d\n", info->varsel_id, info->sim_expr->LUT_size);
                 print_debug("DEBUG: sim_expr->dependent_input_mask for varsel_id %d: 0x%x\n", info->varsel_id, info->sim_expr->dependent_input_mask);
-                print_debug("DEBUG: sim_expr->LUT for varsel_id %d: ", info->varsel_id);
-                for (int j = 0; j < info->sim_expr->LUT_size; j++) {
-                    fprintf(stderr, "%d ", info->sim_expr->LUT[j]);
+                if (debug_mode) {
+                    print_debug("DEBUG: sim_expr->LUT for varsel_id %d: ", info->varsel_id);
+                    for (int j = 0; j < info->sim_expr->LUT_size; j++) {
+                        fprintf(stderr, "%d ", info->sim_expr->LUT[j]);
+                    }
+                    fprintf(stderr, "\n");
                 }
-                fprintf(stderr, "\n");
             } else {
                 fprintf(stderr, "Error: Failed to create simulated expression for varsel_id %d.\n", info->varsel_id);
             }
         }
 
-        // Allocate and populate vardata_lut
-        // Need to allocate enough space for the highest varsel_id, not just the count
-        int max_varsel_id = 0;
-        for (int i = 0; i < mc->conditional_expression_count; i++) {
-            if (mc->conditional_expressions[i].varsel_id > max_varsel_id) {
-                max_varsel_id = mc->conditional_expressions[i].varsel_id;
-            }
+        // Allocate and populate vardata_blocks, sharing varsel blocks between identical tables
+        build_vardata_lut(mc, num_total_input_vars);
+        if (use_varsel_logic) {
+            split_varsel_logic(mc, num_total_input_vars);
         }
-        mc->vardata_lut_size = (max_varsel_id + 1) * (1 << num_total_input_vars);
-        mc->vardata_lut = (uint8_t*)malloc(sizeof(uint8_t) * mc->vardata_lut_size);
-        if (!mc->vardata_lut) {
-            fprintf(stderr, "Error: Failed to allocate vardata_lut.\n");
-            exit(EXIT_FAILURE);
-        }
-        print_debug("DEBUG: Allocated vardata_lut of size: %d\n", mc->vardata_lut_size);
-
-        for (int i = 0; i < mc->conditional_expression_count; i++) {
-            ConditionalExpressionInfo* info = &mc->conditional_expressions[i];
-            
-            // Check if varsel_id is within bounds
-            int required_size = (info->varsel_id + 1) * (1 << num_total_input_vars);
-            if (required_size > mc->vardata_lut_size) {
-                fprintf(stderr, "Error: varsel_id %d exceeds allocated vardata_lut size %d\n",
-                        info->varsel_id, mc->vardata_lut_size);
-                continue; // Skip this entry to prevent buffer overflow
-            }
-            
-            if (info->sim_expr && info->sim_expr->LUT) {
-                // Copy the LUT for this expression into the main vardata_lut
-                // The position in vardata_lut is determined by the varsel_id
-                // Assuming varsel_id maps directly to the block index in vardata_lut
-                memcpy(mc->vardata_lut + (info->varsel_id * (1 << num_total_input_vars)),
-                       info->sim_expr->LUT,
-                       (1 << num_total_input_vars) * sizeof(uint8_t));
-            } else {
-                fprintf(stderr, "Warning: No LUT found for varsel_id %d. Skipping copy.\n", info->varsel_id);
-                // Optionally, fill with zeros or a default value
-                memset(mc->vardata_lut + (info->varsel_id * (1 << num_total_input_vars)),
-                       0,
-                       (1 << num_total_input_vars) * sizeof(uint8_t));
+        if (debug_mode) {
+            int block_size = 1 << num_total_input_vars;
+            uint8_t* block_lut = malloc(block_size);
+            print_debug("DEBUG: Final vardata_lut content: ");
+            for (int block = 0; block_lut && block < mc->vardata_lut_size / block_size; block++) {
+                vardata_block(mc, block, block_lut);
+                for (int i = 0; i < block_size; i++) {
+                    fprintf(stderr, "%d ", block_lut[i]);
+                }
             }
+            fprintf(stderr, "\n");
+            free(block_lut);
         }
-        print_debug("DEBUG: Final vardata_lut content: ");
-        for (int i = 0; i < mc->vardata_lut_size; i++) {
-            fprintf(stderr, "%d ", mc->vardata_lut[i]);
-        }
-        fprintf(stderr, "\n");
     }
     
     // Write the vardata_lut to file
@@ -524,9 +978,37 @@ CompactMicrocode* ast_to_compact_microcode(Node* ast_root, HardwareContext* hw_c
     //snprintf(output_filename, sizeof(output_filename), "examples/simple/simple_vardata.mem"); // Hardcoded for now
     //write_vardata_mem_file(mc, output_filename);
     
+    release_lowering_state(mc);
+    mc->analysis = NULL; // Lives with the AST, which may be released before mc
     return mc;
 }
 
+// Frees what only lowering reads, before the image is printed or written:
+// the jump and break fixups, the loop/switch stack and the conditions.
+// The simulated expressions and BDDs stay, as vardata_blocks expands them
+// when the image is written
+static void release_lowering_state(CompactMicrocode* mc) {
+    free(mc->pending_jumps);
+    mc->pending_jumps = NULL;
+    mc->pending_jump_count = mc->pending_jump_capacity = 0;
+    free(mc->label_addresses);
+    mc->label_addresses = NULL;
+    mc->label_count = mc->label_capacity = 0;
+    free(mc->pending_switch_breaks);
+    mc->pending_switch_breaks = NULL;
+    mc->pending_switch_break_count = mc->pending_switch_break_capacity = 0;
+    free(mc->switch_infos);
+    mc->switch_infos = NULL;
+    mc->switch_info_count = mc->switch_info_capacity = 0;
+    free(mc->loop_switch_stack);
+    mc->loop_switch_stack = NULL;
+    mc->stack_ptr = mc->stack_capacity = 0;
+    free(mc->conditional_expressions);
+    mc->conditional_expressions = NULL;
+    mc->conditional_expression_count = mc->conditional_expression_capacity = 0;
+    mc->ladder_link = NULL;
+}
+
 static void resolve_compact_microcode_jumps(CompactMicrocode* mc) {
     for (int i = 0; i < mc->pending_jump_count; i++) {
         PendingJump jump = mc->pending_jumps[i];
@@ -534,6 +1016,14 @@ static void resolve_compact_microcode_jumps(CompactMicrocode* mc) {
             MCode* mcode = &mc->instructions[jump.instruction_index].uword.mcode;
             if (jump.is_exit_jump) {
                 mcode->jadr = mc->exit_address;
+            } else if (jump.label_id != NO_LABEL) {
+                int address = mc->label_addresses[jump.label_id];
+                if (address < 0) {
+                    fprintf(stderr, "Warning: Jump at %d targets unbound label %d\n", jump.instruction_index, jump.label_id);
+                    address = mc->exit_address;
+                }
+                mc->pending_jumps[i].target_instruction_address = address;
+                mcode->jadr = address;
             } else {
                 mcode->jadr = jump.target_instruction_address;
             }
@@ -544,31 +1034,62 @@ static void resolve_compact_microcode_jumps(CompactMicrocode* mc) {
     }
 }
 
-// Helper function to find the end address of a switch using switch info tracking
-static int find_switch_end_address(CompactMicrocode* mc, int switch_start_addr) {
-    // Find the instruction corresponding to the switch start
-    if (switch_start_addr < 0 || switch_start_addr >= mc->instruction_count) {
-        return switch_start_addr + 1; // Default fallback
+// Makes room for switch_id in switch_infos and its block of switch memory.
+// Both grow by doubling, so there is no cap on the number of switches.
+static void reserve_switch(CompactMicrocode* mc, int switch_id, int start_addr) {
+    if (switch_id >= mc->switch_info_capacity) {
+        int old_capacity = mc->switch_info_capacity;
+        int new_capacity = old_capacity == 0 ? 8 : old_capacity * 2;
+        while (new_capacity <= switch_id) {
+            new_capacity *= 2;
+        }
+        size_t switch_words = (size_t)1 << mc->switch_offset_bits;
+        SwitchInfo* infos = realloc(mc->switch_infos, sizeof(SwitchInfo) * new_capacity);
+        uint32_t* switchmem = realloc(mc->switchmem, sizeof(uint32_t) * switch_words * new_capacity);
+        if (infos == NULL || switchmem == NULL) {
+            fprintf(stderr, "Error: Failed to grow switch tables to %d switches.\n", new_capacity);
+            exit(EXIT_FAILURE);
+        }
+        memset(switchmem + switch_words * old_capacity, 0, sizeof(uint32_t) * switch_words * (new_capacity - old_capacity));
+        mc->switch_infos = infos;
+        mc->switchmem = switchmem;
+        mc->switch_info_capacity = new_capacity;
     }
-    
-    print_debug("DEBUG: find_switch_end_address: Looking for end of switch starting at %d\n", switch_start_addr);
-    
-    // Look through the switch info we've collected to find the end address for this switch
-    for (int i = 0; i < mc->switch_info_count; i++) {
-        if (mc->switch_infos[i].switch_start_addr == switch_start_addr) {
-            print_debug("DEBUG: find_switch_end_address: Found switch info for start addr %d, end addr %d\n",
-                    switch_start_addr, mc->switch_infos[i].switch_end_addr);
-            return mc->switch_infos[i].switch_end_addr;
+
+    SwitchInfo* info = &mc->switch_infos[switch_id];
+    info->switch_start_addr = start_addr;
+    info->switch_end_addr = -1;
+    info->context_stack_index = mc->stack_ptr;
+    info->first_break_index = -1;
+    info->break_count = 0;
+    if (switch_id >= mc->switch_info_count) {
+        mc->switch_info_count = switch_id + 1;
+    }
+}
+
+static void add_pending_switch_break(CompactMicrocode* mc, int instruction_index, int switch_id) {
+    if (mc->pending_switch_break_count >= mc->pending_switch_break_capacity) {
+        mc->pending_switch_break_capacity *= 2;
+        mc->pending_switch_breaks = realloc(mc->pending_switch_breaks, sizeof(PendingSwitchBreak) * mc->pending_switch_break_capacity);
+        if (mc->pending_switch_breaks == NULL) {
+            fprintf(stderr, "Error: Failed to reallocate pending_switch_breaks array.\n");
+            exit(EXIT_FAILURE);
         }
     }
-    
-    // If we don't have switch info, return a reasonable default
-    // This should not happen in a properly functioning system
-    print_debug("DEBUG: find_switch_end_address: No switch info found for start addr %d, using fallback\n", switch_start_addr);
-    return mc->instruction_count - 1;
+    PendingSwitchBreak* pending = &mc->pending_switch_breaks[mc->pending_switch_break_count];
+    pending->instruction_index = instruction_index;
+    pending->switch_id = switch_id;
+
+    SwitchInfo* info = &mc->switch_infos[switch_id];
+    if (info->first_break_index < 0) {
+        info->first_break_index = mc->pending_switch_break_count;
+    }
+    info->break_count++;
+    mc->pending_switch_break_count++;
 }
 
-// Resolve switch break addresses after all instructions have been generated
+// Resolve switch break addresses after all instructions have been generated.
+// Each break names its switch, so this is one lookup per break.
 static void resolve_switch_break_addresses(CompactMicrocode* mc) {
     if (!mc || !mc->pending_switch_breaks || mc->pending_switch_break_count == 0) {
         return;
@@ -576,448 +1097,984 @@ static void resolve_switch_break_addresses(CompactMicrocode* mc) {
     
     print_debug("DEBUG: Resolving %d switch break addresses\n", mc->pending_switch_break_count);
     
-    // Create a mapping from switch start address to end address
-    SwitchInfo switch_infos[MAX_SWITCHES];
-    int switch_info_count = 0;
-    
-    // First, build the switch info mapping
     for (int i = 0; i < mc->pending_switch_break_count; i++) {
         PendingSwitchBreak* pending = &mc->pending_switch_breaks[i];
-        int switch_start_addr = pending->switch_start_addr;
-        
-        // Check if we already have info for this switch
-        bool found = false;
-        for (int j = 0; j < switch_info_count; j++) {
-            if (switch_infos[j].switch_start_addr == switch_start_addr) {
-                found = true;
-                break;
-            }
+        if (pending->instruction_index >= mc->instruction_count) {
+            continue;
         }
-        
-        // If not found, add new switch info
-        if (!found && switch_info_count < MAX_SWITCHES) {
-            // For now, we'll determine the end address dynamically
-            // We'll update this with the actual end address later
-            switch_infos[switch_info_count].switch_start_addr = switch_start_addr;
-            switch_infos[switch_info_count].switch_end_addr = -1; // Will be determined later
-            switch_infos[switch_info_count].first_break_index = i;
-            switch_infos[switch_info_count].break_count = 1;
-            switch_info_count++;
-        } else if (found) {
-            // Increment break count for existing switch
-            for (int j = 0; j < switch_info_count; j++) {
-                if (switch_infos[j].switch_start_addr == switch_start_addr) {
-                    switch_infos[j].break_count++;
-                    break;
-                }
-            }
+        int target_addr = mc->switch_infos[pending->switch_id].switch_end_addr;
+        if (target_addr < 0) {
+            fprintf(stderr, "WARNING: Could not find containing switch for break at %d\n", pending->instruction_index);
+            continue;
         }
+        mc->instructions[pending->instruction_index].uword.mcode.jadr = target_addr;
+        print_debug("DEBUG: Break at %d leaves switch %d, jumping to 0x%x\n",
+                pending->instruction_index, pending->switch_id, target_addr);
     }
     
-    // Build a complete map of all switch boundaries using a stack-based approach
-    typedef struct {
-        int start_addr;
-        int end_addr;
-    } SwitchBoundary;
-    
-    SwitchBoundary boundaries[MAX_SWITCHES];
-    int boundary_count = 0;
-    
-    // Stack to track open switches
-    int switch_stack[MAX_SWITCHES];
-    int stack_top = -1;
-    
-    // Scan through all instructions to match switches with their closing "}}"
+    // Reset the pending switch break count for next function
+    mc->pending_switch_break_count = 0;
+}
+
+// A word that only captures state and falls through to the next address
+static bool is_plain_state_word(const MCode* m) {
+    return m->state_capture && m->mask != 0 && !m->branch && !m->forced_jmp &&
+           !m->switch_sel && !m->timerLd && !m->sub && !m->rtn;
+}
+
+// A word that only jumps; its jadr and forced_jmp can ride on a state word
+static bool is_plain_forced_jump(const MCode* m) {
+    return m->forced_jmp && !m->branch && !m->state_capture && m->state == 0 && m->mask == 0 &&
+           m->varSel == 0 && !m->switch_sel && !m->timerLd && !m->sub && !m->rtn;
+}
+
+// Can next (entered only by falling through from prev) be folded into prev?
+static bool can_fuse_words(const MCode* prev, const MCode* next) {
+    if (!is_plain_state_word(prev)) {
+        return false;
+    }
+    if (is_plain_forced_jump(next)) {
+        return true;
+    }
+    // Two captures of different state bits take effect together; the same
+    // bit written twice (a pulse) has to keep its own cycle
+    return is_plain_state_word(next) && (prev->mask & next->mask) == 0;
+}
+
+static int remap_address(const int* new_index, int count, int addr) {
+    return (addr >= 0 && addr <= count) ? new_index[addr] : addr;
+}
+
+// Rewrite every address held in mc through new_index, the new position of
+// each of the count old words (new_index[count] for one past the end),
+// once the words themselves are in place
+static void remap_word_addresses(CompactMicrocode* mc, const int* new_index, int count) {
+    int switch_words = 1 << mc->switch_offset_bits;
     for (int i = 0; i < mc->instruction_count; i++) {
-        const char* label = mc->instructions[i].label;
-        if (label) {
-            // Check for SWITCH instruction (not CASE or DEFAULT)
-            if (strstr(label, "SWITCH") != NULL &&
-                strstr(label, "CASE") == NULL &&
-                strstr(label, "DEFAULT") == NULL) {
-                // Push this switch onto the stack
-                stack_top++;
-                if (stack_top < MAX_SWITCHES) {
-                    switch_stack[stack_top] = i;
-                    print_debug("DEBUG: Found SWITCH at %d (0x%x), stack depth %d\n",
-                            i, i, stack_top + 1);
-                }
+        MCode* m = &mc->instructions[i].uword.mcode;
+        if (m->branch || m->forced_jmp) {
+            m->jadr = remap_address(new_index, count, m->jadr);
+        }
+    }
+    for (int i = 0; i < mc->switch_count * switch_words; i++) {
+        mc->switchmem[i] = remap_address(new_index, count, mc->switchmem[i]);
+    }
+    for (int i = 0; i < mc->pending_jump_count; i++) {
+        PendingJump* jump = &mc->pending_jumps[i];
+        jump->instruction_index = remap_address(new_index, count, jump->instruction_index);
+        jump->target_instruction_address = remap_address(new_index, count, jump->target_instruction_address);
+    }
+    for (int i = 0; i < mc->switch_info_count; i++) {
+        mc->switch_infos[i].switch_start_addr = remap_address(new_index, count, mc->switch_infos[i].switch_start_addr);
+        mc->switch_infos[i].switch_end_addr = remap_address(new_index, count, mc->switch_infos[i].switch_end_addr);
+    }
+    mc->exit_address = remap_address(new_index, count, mc->exit_address);
+    for (int i = 0; i < mc->interrupt_vector_count; i++) {
+        mc->interrupt_vectors[i].address = remap_address(new_index, count, mc->interrupt_vectors[i].address);
+    }
+    for (int i = 0; i < mc->subroutine_body_count; i++) {
+        SubroutineBody* body = &mc->subroutine_bodies[i];
+        int end = remap_address(new_index, count, body->address + body->words);
+        body->address = remap_address(new_index, count, body->address);
+        body->words = end - body->address;
+    }
+}
+
+// A fused word is labelled with the labels of the words it was made from,
+// in order: label's chain gets a copy of next's on the end
+static void append_fused_label(CompactMicrocode* mc, WordLabel* label, const WordLabel* next) {
+    if (mc->fused_label_count >= mc->fused_label_capacity) {
+        mc->fused_label_capacity = mc->fused_label_capacity ? mc->fused_label_capacity * 2 : 16;
+        mc->fused_labels = realloc(mc->fused_labels, sizeof(WordLabel) * mc->fused_label_capacity);
+        if (!mc->fused_labels) {
+            fprintf(stderr, "Error: Failed to allocate fused labels.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    int index = mc->fused_label_count++;
+    mc->fused_labels[index] = *next;
+    WordLabel* last = label;
+    while (last->fused >= 0) {
+        last = &mc->fused_labels[last->fused];
+    }
+    last->fused = index;
+}
+
+// Peephole pass over the resolved words: a state assignment absorbs the
+// forced jump after it (one word carries state, mask, jadr and forced_jmp),
+// and adjacent assignments to disjoint state bits share a word. A word that
+// anything jumps to keeps its own address. Every address held in mc is then
+// rewritten through old -> new index.
+static void compact_fused_words(CompactMicrocode* mc) {
+    int count = mc->instruction_count;
+    if (count < 2) {
+        return;
+    }
+
+    int switch_words = 1 << mc->switch_offset_bits;
+    bool* is_target = calloc(count + 1, sizeof(bool));
+    int* new_index = malloc(sizeof(int) * (count + 1));
+    if (!is_target || !new_index) {
+        fprintf(stderr, "Error: Failed to allocate word compaction tables.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = 0; i < count; i++) {
+        const MCode* m = &mc->instructions[i].uword.mcode;
+        if ((m->branch || m->forced_jmp) && (int)m->jadr <= count) {
+            is_target[m->jadr] = true;
+        }
+    }
+    for (int i = 0; i < mc->switch_count * switch_words; i++) {
+        if ((int)mc->switchmem[i] <= count) {
+            is_target[mc->switchmem[i]] = true;
+        }
+    }
+    if (mc->exit_address >= 0 && mc->exit_address <= count) {
+        is_target[mc->exit_address] = true;
+    }
+    for (int i = 0; i < mc->interrupt_vector_count; i++) {
+        if (mc->interrupt_vectors[i].address <= count) {
+            is_target[mc->interrupt_vectors[i].address] = true;
+        }
+    }
+
+    int out = 0;
+    int fused = 0;
+    for (int i = 0; i < count; i++) {
+        Code* word = &mc->instructions[i];
+        Code* prev = out > 0 ? &mc->instructions[out - 1] : NULL;
+        if (prev && !is_target[i] && can_fuse_words(&prev->uword.mcode, &word->uword.mcode)) {
+            MCode* p = &prev->uword.mcode;
+            const MCode* n = &word->uword.mcode;
+            if (n->forced_jmp) {
+                p->jadr = n->jadr;
+                p->forced_jmp = 1;
+                mc->jump_instructions--;
+            } else {
+                p->state |= n->state;
+                p->mask |= n->mask;
+                mc->state_assignments--;
             }
-            // Check for "}}" which closes a switch
-            else if (strcmp(label, "}}") == 0) {
-                if (stack_top >= 0) {
-                    // Pop the most recent switch from the stack
-                    int start = switch_stack[stack_top];
-                    stack_top--;
-                    
-                    // Record this switch boundary
-                    if (boundary_count < MAX_SWITCHES) {
-                        boundaries[boundary_count].start_addr = start;
-                        boundaries[boundary_count].end_addr = i + 1; // Jump to after "}}"
-                        print_debug("DEBUG: Matched SWITCH at %d with }} at %d, breaks jump to %d (0x%x)\n",
-                                start, i, i + 1, i + 1);
-                        boundary_count++;
-                    }
-                }
+
+            if (mc->word_labels[i].kind != WORD_LABEL_NONE) {
+                append_fused_label(mc, &mc->word_labels[out - 1], &mc->word_labels[i]);
             }
+            new_index[i] = out - 1;
+            fused++;
+            continue;
         }
+        if (out != i) {
+            mc->instructions[out] = *word;
+            mc->word_labels[out] = mc->word_labels[i];
+        }
+        new_index[i] = out++;
     }
-    
-    // Now update the switch_infos with the correct end addresses
-    for (int i = 0; i < switch_info_count; i++) {
-        int switch_start = switch_infos[i].switch_start_addr;
-        int switch_end = -1;
-        
-        // Find the matching boundary
-        for (int j = 0; j < boundary_count; j++) {
-            if (boundaries[j].start_addr == switch_start) {
-                switch_end = boundaries[j].end_addr;
+    new_index[count] = out;
+    mc->instruction_count = out;
+
+    if (fused > 0) {
+        remap_word_addresses(mc, new_index, count);
+    }
+
+    print_debug("DEBUG: compact_fused_words: %d words fused, %d -> %d\n", fused, count, out);
+    free(is_target);
+    free(new_index);
+}
+
+// A word that always leaves for somewhere other than the next address: a
+// forced jump or a return. It ends a tail.
+static bool ends_tail(const MCode* m) {
+    return (m->forced_jmp || m->rtn) && !m->sub && !m->switch_sel && !m->switch_adr;
+}
+
+// A word that may carry on at the next address and runs the same wherever
+// it sits: anything but a tail end, a call (which pushes its own address)
+// or a switch dispatch
+static bool continues_tail(const MCode* m) {
+    return !m->forced_jmp && !m->rtn && !m->sub && !m->switch_sel && !m->switch_adr;
+}
+
+static bool same_word(const MCode* a, const MCode* b) {
+    for (int f = 0; f < MCODE_FIELD_COUNT; f++) {
+        if (mcode_field(a, f) != mcode_field(b, f)) return false;
+    }
+    return true;
+}
+
+// Do the tails starting at a and b run the same words to the same end?
+static bool same_tail(const Code* words, int a, int b) {
+    for (;; a++, b++) {
+        const MCode* x = &words[a].uword.mcode;
+        if (!same_word(x, &words[b].uword.mcode)) return false;
+        if (ends_tail(x)) return true;
+    }
+}
+
+// Cross-jumping over the resolved words. The tail at a word is the run of
+// words from it that falls through to a forced jump or return; its hash
+// covers every packed word of the run. A tail that repeats one seen
+// earlier is dropped, and whatever reached it goes to the earlier copy:
+// jumps, switchmem entries and the other held addresses are rewritten like
+// compact_fused_words does. The word falling into a dropped tail has to
+// jump instead: a plain state word takes the jump for free, otherwise
+// --merge-tails-size spends a jump word (and a cycle) on tails of two or
+// more words. Programs with interrupt handlers are left alone: the word
+// an interrupt is taken on loses its jump and resumes after it, so moving
+// what follows a jump would change where the handler returns to.
+static void merge_tails(CompactMicrocode* mc) {
+    int count = mc->instruction_count;
+    if (count < 2 || mc->interrupt_vector_count > 0) {
+        return;
+    }
+
+    int buckets = 1;
+    while (buckets < count) buckets <<= 1;
+    uint64_t* hash = malloc(sizeof(uint64_t) * count);
+    bool* has_tail = calloc(count, sizeof(bool));
+    int* canonical = malloc(sizeof(int) * count);
+    int* bucket_head = malloc(sizeof(int) * buckets);
+    int* bucket_next = malloc(sizeof(int) * count);
+    int* new_index = malloc(sizeof(int) * (count + 1));
+    if (!hash || !has_tail || !canonical || !bucket_head || !bucket_next || !new_index) {
+        fprintf(stderr, "Error: Failed to allocate tail merging tables.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Hash each tail from the back, so a word's hash folds in the tail after it
+    for (int i = count - 1; i >= 0; i--) {
+        const MCode* m = &mc->instructions[i].uword.mcode;
+        if (ends_tail(m)) {
+            hash[i] = 1469598103934665603ULL;
+        } else if (continues_tail(m) && i + 1 < count && has_tail[i + 1]) {
+            hash[i] = hash[i + 1];
+        } else {
+            continue;
+        }
+        for (int f = 0; f < MCODE_FIELD_COUNT; f++) {
+            hash[i] = (hash[i] ^ mcode_field(m, f)) * 1099511628211ULL;
+        }
+        has_tail[i] = true;
+    }
+
+    // The first copy of each tail is canonical; equal tails never overlap,
+    // since both would run to the same end
+    for (int b = 0; b < buckets; b++) bucket_head[b] = -1;
+    int repeated = 0;
+    for (int i = 0; i < count; i++) {
+        canonical[i] = -1;
+        if (!has_tail[i]) continue;
+        int b = (int)(hash[i] & (uint64_t)(buckets - 1));
+        for (int j = bucket_head[b]; j >= 0; j = bucket_next[j]) {
+            if (hash[j] == hash[i] && same_tail(mc->instructions, j, i)) {
+                canonical[i] = j;
                 break;
             }
         }
-        
-        if (switch_end == -1) {
-            // Fallback: use the switch info if available
-            switch_end = find_switch_end_address(mc, switch_start);
+        if (canonical[i] < 0) {
+            bucket_next[i] = bucket_head[b];
+            bucket_head[b] = i;
+        } else {
+            repeated++;
+        }
+    }
+
+    int out = 0;
+    int merged = 0;
+    int jumps_added = 0;
+    bool kept_previous = false;
+    for (int i = 0; i < count; i++) {
+        Code* word = &mc->instructions[i];
+        if (canonical[i] >= 0) {
+            // A repeated run starts here and ends at the next tail end
+            int end = i;
+            while (!ends_tail(&mc->instructions[end].uword.mcode)) end++;
+            MCode* before = kept_previous ? &mc->instructions[out - 1].uword.mcode : NULL;
+            bool jumped_to = !before || ends_tail(before);
+            bool absorb = !jumped_to && is_plain_state_word(before);
+            bool add_jump = !jumped_to && !absorb && merge_common_tails == MERGE_TAILS_SIZE && end > i;
+            if (jumped_to || absorb || add_jump) {
+                if (absorb) {
+                    before->jadr = canonical[i];
+                    before->forced_jmp = 1;
+                }
+                for (int k = i; k <= end; k++) {
+                    const MCode* m = &mc->instructions[k].uword.mcode;
+                    if (m->state_capture) mc->state_assignments--;
+                    if (m->branch) mc->branch_instructions--;
+                    if (m->forced_jmp) mc->jump_instructions--;
+                    new_index[k] = new_index[canonical[k]];
+                }
+                if (add_jump) {
+                    MCode jump = {0};
+                    jump.jadr = canonical[i];
+                    jump.forced_jmp = 1;
+                    mc->instructions[out].uword.mcode = jump;
+                    mc->instructions[out].level = word->level;
+                    mc->word_labels[out] = text_label("shared tail");
+                    mc->jump_instructions++;
+                    out++;
+                    jumps_added++;
+                }
+                merged += end - i + 1;
+                kept_previous = add_jump;
+                i = end;
+                continue;
+            }
         }
-        
-        switch_infos[i].switch_end_addr = switch_end;
-        print_debug("DEBUG: Switch info: start=%d, end=%d (0x%x)\n",
-                switch_start, switch_end, switch_end);
+        if (out != i) {
+            mc->instructions[out] = *word;
+            mc->word_labels[out] = mc->word_labels[i];
+        }
+        new_index[i] = out++;
+        kept_previous = true;
+    }
+    new_index[count] = out;
+    mc->instruction_count = out;
+
+    if (merged > 0) {
+        remap_word_addresses(mc, new_index, count);
+    }
+
+    print_debug("DEBUG: merge_tails: %d repeated tail words, %d merged with %d jumps added, %d -> %d\n",
+                repeated, merged, jumps_added, count, out);
+    free(hash);
+    free(has_tail);
+    free(canonical);
+    free(bucket_head);
+    free(bucket_next);
+    free(new_index);
+}
+
+// A word that can leave its fall-through path: a jump, a call or return,
+// or a switch dispatch
+static bool can_redirect(const MCode* m) {
+    return m->branch || m->forced_jmp || m->sub || m->rtn || m->switch_sel || m->switch_adr;
+}
+
+// --pipeline: hotstate.sv with PIPELINED reads the word after a jump into
+// its output register while the jump runs, so that word always runs next
+// (the delay slot). Every word that can redirect gets an empty word after
+// it, which only falls through. A call pushes the address of its delay
+// slot; returning runs the empty word again, which changes nothing.
+static void insert_delay_slots(CompactMicrocode* mc) {
+    int count = mc->instruction_count;
+    int slots = 0;
+    for (int i = 0; i < count; i++) {
+        if (can_redirect(&mc->instructions[i].uword.mcode)) {
+            slots++;
+        }
+    }
+    mc->pipelined = true;
+    if (slots == 0) {
+        return;
+    }
+
+    Code* words = calloc(count + slots, sizeof(Code));
+    WordLabel* labels = calloc(count + slots, sizeof(WordLabel));
+    int* new_index = malloc(sizeof(int) * (count + 1));
+    if (!words || !labels || !new_index) {
+        fprintf(stderr, "Error: Failed to allocate delay slot tables.\n");
+        exit(EXIT_FAILURE);
     }
+    int out = 0;
+    for (int i = 0; i < count; i++) {
+        new_index[i] = out;
+        labels[out] = mc->word_labels[i];
+        words[out++] = mc->instructions[i];
+        if (can_redirect(&mc->instructions[i].uword.mcode)) {
+            labels[out++] = text_label("delay slot");
+        }
+    }
+    new_index[count] = out;
+
+    free(mc->instructions);
+    free(mc->word_labels);
+    mc->instructions = words;
+    mc->word_labels = labels;
+    mc->instruction_count = out;
+    mc->instruction_capacity = out;
+    remap_word_addresses(mc, new_index, count);
+
+    print_debug("DEBUG: insert_delay_slots: %d delay slots, %d -> %d\n", slots, count, out);
+    free(new_index);
+}
+
+static void process_function(CompactMicrocode* mc, FunctionDefNode* func) {
+    int current_addr = 0;
+    int* addr = &current_addr;
     
-    // Now resolve all break addresses
-    // We need to match breaks with their containing switches based on instruction position
-    for (int i = 0; i < mc->pending_switch_break_count; i++) {
-        PendingSwitchBreak* pending = &mc->pending_switch_breaks[i];
-        
-        if (pending->instruction_index < mc->instruction_count) {
-            int break_addr = pending->instruction_index;
-            int target_addr = -1;
-            int innermost_start = -1;
-            int innermost_end = -1;
-            
-            // Find the innermost switch that contains this break instruction
-            // We need to find the switch with the smallest range that still contains the break
-            for (int j = 0; j < boundary_count; j++) {
-                if (boundaries[j].start_addr < break_addr &&
-                    break_addr < boundaries[j].end_addr - 1) {
-                    // This break is inside this switch
-                    // Check if this is more inner than what we've found so far
-                    if (innermost_start == -1 ||
-                        (boundaries[j].end_addr - boundaries[j].start_addr) < (innermost_end - innermost_start)) {
-                        innermost_start = boundaries[j].start_addr;
-                        innermost_end = boundaries[j].end_addr;
-                        target_addr = boundaries[j].end_addr;
-                    }
-                }
-            }
-            
-            if (target_addr != -1) {
-                print_debug("DEBUG: Break at %d belongs to innermost switch %d-%d, jumping to 0x%x\n",
-                        break_addr, innermost_start, innermost_end - 1, target_addr);
-            }
-            
-            // Update the jump address
-            if (target_addr != -1) {
-                mc->instructions[pending->instruction_index].uword.mcode.jadr = target_addr;
-                print_debug("DEBUG: Fixed instruction %d to jump to 0x%x\n",
-                        pending->instruction_index, target_addr);
-            } else {
-                fprintf(stderr, "WARNING: Could not find containing switch for break at %d\n", break_addr);
+    // Calculate exit address dynamically. This will be the address of the :exit instruction.
+    // It is the current address after all statements in the function body are processed.
+    // Store exit address for use in jump resolution.
+    
+    // Add function entry, calculating initial state from hw_ctx
+    int initial_state = 0;
+    int initial_mask = 0;
+    if (mc->hw_ctx) {
+        for (int i = 0; i < mc->hw_ctx->state_count; i++) {
+            StateVariable* s = &mc->hw_ctx->states[i];
+            if (s->initial_value) {
+                initial_state |= (1 << s->state_number);
             }
+            initial_mask |= (1 << s->state_number);
         }
     }
     
-    // Reset the pending switch break count for next function
-    mc->pending_switch_break_count = 0;
-}
+    // Use calculated state and mask. Mask should be 7 for 3 state variables.
+    MCode entry_mcode;
+    populate_mcode_instruction(mc, &entry_mcode, mc->hw_ctx->initial_state_value, mc->hw_ctx->initial_mask_value, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0); // Use dynamically calculated initial state and mask
+    add_compact_instruction(mc, &entry_mcode, text_label("main(){"), JUMP_TYPE_DIRECT, 1);
+    (*addr)++; // Increment address for main(){
+    
+    
+    if (func->body && func->body->type == NODE_BLOCK) {
+        BlockNode* block = (BlockNode*)func->body;
+        for (int i = 0; i < block->statements->count; i++) {
+            process_statement(mc, block->statements->items[i], addr);
+        }
+    }
+    
+    // Set the exit address after all instructions have been generated
+    // The exit instruction will be the last instruction, so its address is mc->instruction_count - 1
+    mc->exit_address = mc->instruction_count; // Set exit address to the total number of instructions generated
 
-// Forward declaration for counting instructions
-static int count_statements(Node* stmt);
+    // Add exit instruction (will be a self-loop after resolution)
+    MCode exit_mcode;
+    populate_mcode_instruction(mc, &exit_mcode, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0); // jadr placeholder
+    add_compact_instruction(mc, &exit_mcode, text_label(":exit"), JUMP_TYPE_EXIT, mc->exit_address);
+    (*addr)++;
 
-// Count how many instructions a statement will generate
-static int count_statements(Node* stmt) {
-    if (!stmt) return 0;
-    
-    int count = 0; // Initialize count to 0
-    // Add a debug print at the very beginning of the function
+    // A handler returns past the word it interrupted, so an interrupt taken
+    // on the :exit self-loop comes back here and goes round again
+    if (has_interrupt_handlers(mc)) {
+        MCode idle_mcode;
+        populate_mcode_instruction(mc, &idle_mcode, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0);
+        add_compact_instruction(mc, &idle_mcode, text_label(":exit"), JUMP_TYPE_EXIT, mc->exit_address);
+        (*addr)++;
+    }
 
-    switch (stmt->type) {
-        case NODE_WHILE: {
-            WhileNode* while_node = (WhileNode*)stmt;
-            count = 1; // while header
-            
-            // Count body statements
-            if (while_node->body) {
-                if (while_node->body->type == NODE_BLOCK) {
-                    BlockNode* block = (BlockNode*)while_node->body;
-                    if (block->statements) {
-                        for (int i = 0; i < block->statements->count; i++) {
-                            count += count_statements(block->statements->items[i]);
-                        }
-                    }
-                } else {
-                    count += count_statements(while_node->body);
-                }
-            }
-            
-            // count++; // closing brace jump (removed to match hotstate instruction count)
-            break; // Use break instead of return here
+    // Shared helper bodies go after :exit, reached only through call words
+    // or, for interrupt handlers, the interrupt vector
+    emit_subroutines(mc, addr);
+    collect_interrupt_vectors(mc);
+}
+
+static bool has_interrupt_handlers(CompactMicrocode* mc) {
+    for (int i = 0; i < mc->subroutine_count; i++) {
+        if (mc->subroutines[i].handler) {
+            return true;
         }
-        
-        case NODE_IF: {
-            IfNode* if_node = (IfNode*)stmt;
-            count = 1; // if condition
-            
-            // Count then body
-            if (if_node->then_branch) {
-                if (if_node->then_branch->type == NODE_BLOCK) {
-                    BlockNode* block = (BlockNode*)if_node->then_branch;
-                    if (block->statements) {
-                        for (int i = 0; i < block->statements->count; i++) {
-                            count += count_statements(block->statements->items[i]);
-                        }
-                    }
-                } else {
-                    count += count_statements(if_node->then_branch);
-                }
-            }
-            
-            // Count else
-            if (if_node->else_branch) {
-                count++; // else instruction
-                if (if_node->else_branch->type == NODE_BLOCK) {
-                    BlockNode* block = (BlockNode*)if_node->else_branch;
-                    if (block->statements) {
-                        for (int i = 0; i < block->statements->count; i++) {
-                            count += count_statements(block->statements->items[i]);
-                        }
-                    }
-                } else {
-                    count += count_statements(if_node->else_branch);
-                }
+    }
+    return false;
+}
+
+// The entry address of every handler, in program order
+static void collect_interrupt_vectors(CompactMicrocode* mc) {
+    for (int i = 0; i < mc->subroutine_count; i++) {
+        Subroutine* sub = &mc->subroutines[i];
+        if (!sub->handler || sub->entry_label == NO_LABEL) continue;
+        if (mc->interrupt_vector_count == 0) {
+            mc->interrupt_vectors = malloc(sizeof(InterruptVector) * mc->subroutine_count);
+            if (!mc->interrupt_vectors) {
+                fprintf(stderr, "Error: Failed to allocate interrupt vectors.\n");
+                exit(EXIT_FAILURE);
             }
-            
-            break; // Use break instead of return here
         }
-        
-        case NODE_SWITCH: {
-            SwitchNode* switch_node = (SwitchNode*)stmt;
-            // Start with 1 for the switch header itself
-            int switch_total_count = 1;
-            
-            // Count case statements
-            if (switch_node->cases) {
-                print_debug("DEBUG: count_statements: Switch has %d cases\n", switch_node->cases->count);
-                for (int i = 0; i < switch_node->cases->count; i++) {
-                    CaseNode* case_node = (CaseNode*)switch_node->cases->items[i];
-                    // Add 1 for the case/default label itself (CASE_0, CASE_1, etc.)
-                    switch_total_count++;
-                    
-                    // Count case body statements, but handle nested switches specially
-                    if (case_node->body) {
-                        print_debug("DEBUG: count_statements: Case %d has %d statements\n", i, case_node->body->count);
-                        for (int j = 0; j < case_node->body->count; j++) {
-                            Node* stmt_node = case_node->body->items[j];
-                            int case_stmt_count;
-                            
-                            // Check if this statement is a nested switch
-                            // We need to look deeper since switches might be wrapped in blocks
-                            bool is_nested_switch = false;
-                            if (stmt_node->type == NODE_SWITCH) {
-                                is_nested_switch = true;
-                            } else if (stmt_node->type == NODE_BLOCK) {
-                                // Check if the block contains a switch
-                                BlockNode* block = (BlockNode*)stmt_node;
-                                if (block->statements && block->statements->count > 0) {
-                                    for (int k = 0; k < block->statements->count; k++) {
-                                        if (block->statements->items[k]->type == NODE_SWITCH) {
-                                            is_nested_switch = true;
-                                            break;
-                                        }
-                                    }
-                                }
-                            }
-                            
-                            if (is_nested_switch) {
-                                // For nested switches, only count the switch header instruction
-                                // The nested switch will be processed separately and have its own break targets
-                                case_stmt_count = 1;
-                                print_debug("DEBUG: count_statements: Case %d statement %d contains nested switch, counting as 1\n", i, j);
-                            } else {
-                                case_stmt_count = count_statements(stmt_node);
-                            }
-                            
-                            switch_total_count += case_stmt_count;
-                            print_debug("DEBUG: count_statements: Case %d statement %d contributes %d, total now %d\n", i, j, case_stmt_count, switch_total_count);
-                        }
-                    }
-                }
+        InterruptVector* vector = &mc->interrupt_vectors[mc->interrupt_vector_count++];
+        vector->name = strdup(sub->func->name);
+        vector->address = mc->label_addresses[sub->entry_label];
+    }
+}
+
+// --- Subroutines ---
+//
+// Only main is a program of its own; a call statement to a parameterless
+// helper runs the helper's body. A call word (sub with a forced jump) and
+// the return word that ends a shared body cost two cycles per call, so a
+// body of at most inline_call_words words is copied into every call site,
+// which costs no more ROM and saves those cycles on the hot path. Bigger
+// helpers called from several sites are emitted once, when one shared copy
+// plus a call word per site is smaller than a copy per site. The return
+// stack is 16 deep (IP/stack.sv); deeper nesting overwrites return addresses.
+// Interrupt handlers (INTERRUPT_HANDLER_PREFIX) are always shared bodies,
+// called by no word but entered from the interrupt vector.
+
+static int find_subroutine(CompactMicrocode* mc, const char* name) {
+    for (int i = 0; i < mc->subroutine_count; i++) {
+        if (mc->subroutines[i].func && strcmp(mc->subroutines[i].func->name, name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Calls visit on each call statement under node, without following calls
+static void for_each_call(Node* node, void (*visit)(FunctionCallNode* call, void* ctx), void* ctx) {
+    if (!node) return;
+    switch (node->type) {
+        case NODE_EXPRESSION_STATEMENT: {
+            Node* expr = ((ExpressionStatementNode*)node)->expression;
+            if (expr && expr->type == NODE_FUNCTION_CALL) {
+                visit((FunctionCallNode*)expr, ctx);
             }
-            // Add 1 for the closing "}}" instruction at the end of the switch
-            switch_total_count++;
-            print_debug("DEBUG: count_statements: Final switch count is %d\n", switch_total_count);
-            
-            // Debug print to check the calculated total for NODE_SWITCH
-            // Assign the calculated total to the 'count' variable for this statement
-            count = switch_total_count;
             break;
         }
-        
-        case NODE_ASSIGNMENT:
-        case NODE_EXPRESSION_STATEMENT:
-            count = 1;
+        case NODE_IF:
+            for_each_call(((IfNode*)node)->then_branch, visit, ctx);
+            for_each_call(((IfNode*)node)->else_branch, visit, ctx);
             break;
-            
-        case NODE_BREAK:
-        case NODE_CONTINUE:
-            count = 1; // Break and continue generate jump instructions
+        case NODE_WHILE:
+            for_each_call(((WhileNode*)node)->body, visit, ctx);
             break;
-            
-        case NODE_BLOCK: {
-            BlockNode* block = (BlockNode*)stmt;
-            count = 0;
-            if (block->statements) {
-                for (int i = 0; i < block->statements->count; i++) {
-                    count += count_statements(block->statements->items[i]);
+        case NODE_FOR:
+            for_each_call(((ForNode*)node)->body, visit, ctx);
+            break;
+        case NODE_SWITCH: {
+            SwitchNode* switch_node = (SwitchNode*)node;
+            for (int i = 0; switch_node->cases && i < switch_node->cases->count; i++) {
+                CaseNode* case_node = (CaseNode*)switch_node->cases->items[i];
+                for (int j = 0; case_node->body && j < case_node->body->count; j++) {
+                    for_each_call(case_node->body->items[j], visit, ctx);
                 }
             }
-            // Count for the closing brace '}'
-            // Hotstate implicitly generates an instruction for the closing brace of a block
-            count++;
-            break; // Use break instead of return here
+            break;
         }
-        case NODE_FOR: {
-            ForNode* for_node = (ForNode*)stmt;
-            count = 0;
-            // Initializer
-            if (for_node->init) {
-                count += count_statements(for_node->init);
-            }
-            // Condition (at least one instruction for the branch)
-            count += 1; // For the condition evaluation and branch instruction
-            // Body
-            if (for_node->body) {
-                count += count_statements(for_node->body);
-            }
-            // Update
-            if (for_node->update) {
-                count += count_statements(for_node->update);
+        case NODE_BLOCK: {
+            BlockNode* block = (BlockNode*)node;
+            for (int i = 0; block->statements && i < block->statements->count; i++) {
+                for_each_call(block->statements->items[i], visit, ctx);
             }
-            // Jump back to header
-            count += 1; // For the unconditional jump back to the loop header
-            break; // Use break instead of return here
+            break;
+        }
+        case NODE_LABEL:
+            for_each_call(((LabelNode*)node)->statement, visit, ctx);
+            break;
+        default:
+            break;
+    }
+}
+
+// The helper a call statement runs, or NULL
+static Subroutine* called_subroutine(CompactMicrocode* mc, FunctionCallNode* call) {
+    int index = find_subroutine(mc, call->name);
+    return index >= 0 && call->arguments->count == 0 ? &mc->subroutines[index] : NULL;
+}
+
+// Counts a call site, following each helper the first time it is called
+// so only helpers main reaches are counted
+static void count_call_site(FunctionCallNode* call, void* ctx) {
+    CompactMicrocode* mc = ctx;
+    Subroutine* sub = called_subroutine(mc, call);
+    uint64_t calls;
+    if (sub && profiled_runs((Node*)call, &calls)) {
+        sub->profiled = true;
+        sub->profiled_calls += calls;
+    }
+    if (sub && sub->call_sites++ == 0) {
+        for_each_call(sub->func->body, count_call_site, mc);
+    }
+}
+
+// Parameterless helpers and how many call sites main reaches each from
+static void find_called_subroutines(CompactMicrocode* mc, Node* ast_root, FunctionDefNode* main_func) {
+    if (!ast_root || ast_root->type != NODE_PROGRAM) return;
+    ProgramNode* program = (ProgramNode*)ast_root;
+    if (!program->functions || program->functions->count == 0) return;
+
+    mc->subroutine_count = program->functions->count;
+    mc->subroutines = calloc(mc->subroutine_count, sizeof(Subroutine));
+    if (!mc->subroutines) {
+        fprintf(stderr, "Error: Failed to allocate subroutines.\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < mc->subroutine_count; i++) {
+        Node* item = program->functions->items[i];
+        mc->subroutines[i].entry_label = NO_LABEL;
+        mc->subroutines[i].stack_depth = -1;
+        if (item->type != NODE_FUNCTION_DEF || (FunctionDefNode*)item == main_func) continue;
+        FunctionDefNode* func = (FunctionDefNode*)item;
+        bool handler = strncmp(func->name, INTERRUPT_HANDLER_PREFIX, strlen(INTERRUPT_HANDLER_PREFIX)) == 0;
+        if (func->body && (!func->parameters || func->parameters->count == 0)) {
+            mc->subroutines[i].func = func;
+            mc->subroutines[i].handler = handler;
+        } else if (handler && func->body) {
+            fprintf(stderr, "Warning: Interrupt handler %s() takes parameters and is not compiled\n", func->name);
+        }
+    }
+
+    for_each_call(main_func->body, count_call_site, mc);
+    for (int i = 0; i < mc->subroutine_count; i++) {
+        if (mc->subroutines[i].handler) {
+            for_each_call(mc->subroutines[i].func->body, count_call_site, mc);
+        }
+    }
+}
+
+static void collect_subroutines(CompactMicrocode* mc, Node* ast_root, FunctionDefNode* main_func) {
+    find_called_subroutines(mc, ast_root, main_func);
+    for (int i = 0; i < mc->subroutine_count; i++) {
+        Subroutine* sub = &mc->subroutines[i];
+        if (!sub->func || (sub->call_sites == 0 && !sub->handler)) continue;
+        const NodeAttributes* body = node_attributes(mc->analysis, sub->func->body);
+        sub->size_estimate = body ? body->words : 0;
+        int inlined_words = sub->call_sites * sub->size_estimate;
+        int shared_words = sub->size_estimate + 1 + sub->call_sites;  // Body, return, calls
+        if (sub->handler) {
+            sub->outlined = true;
+        } else if (sub->profiled) {
+            // A call and a return word per call are what inlining saves
+            sub->outlined = !profile_is_hot(2 * sub->profiled_calls) && shared_words < inlined_words;
+        } else {
+            sub->outlined = sub->size_estimate > inline_call_words && shared_words < inlined_words;
+        }
+        print_debug("DEBUG: subroutine %s: %d call sites, ~%d words, %s%s\n", sub->func->name,
+                    sub->call_sites, sub->size_estimate, sub->outlined ? "shared" : "inlined",
+                    sub->profiled ? " (profile)" : "");
+    }
+}
+
+typedef struct {
+    CompactMicrocode* mc;
+    int depth;        // Deepest nesting found so far
+    bool* recursive;
+} StackDepthWalk;
+
+// A call word stacks one return address on top of what the shared body
+// stacks; an inlined body runs in its caller's frame
+static void measure_call_depth(FunctionCallNode* call, void* ctx) {
+    StackDepthWalk* walk = ctx;
+    Subroutine* sub = called_subroutine(walk->mc, call);
+    if (!sub) return;
+    if (sub->expanding) {
+        *walk->recursive = true;
+        return;
+    }
+    if (sub->stack_depth < 0) {
+        StackDepthWalk body = { walk->mc, 0, walk->recursive };
+        sub->expanding = true;
+        for_each_call(sub->func->body, measure_call_depth, &body);
+        sub->expanding = false;
+        sub->stack_depth = body.depth;
+    }
+    int depth = sub->stack_depth + (sub->outlined ? 1 : 0);
+    if (depth > walk->depth) {
+        walk->depth = depth;
+    }
+}
+
+// An interrupt stacks its return address on top of whatever main has
+// stacked, and the handler's calls go on top of that. One handler runs at
+// a time: an interrupt taken inside a handler nests deeper than this.
+static int subroutine_stack_depth(CompactMicrocode* mc, FunctionDefNode* main_func, bool* recursive) {
+    StackDepthWalk walk = { mc, 0, recursive };
+    *recursive = false;
+    for_each_call(main_func->body, measure_call_depth, &walk);
+    int handler_depth = -1;
+    for (int i = 0; i < mc->subroutine_count; i++) {
+        Subroutine* sub = &mc->subroutines[i];
+        if (!sub->handler) continue;
+        StackDepthWalk body = { mc, 0, recursive };
+        sub->expanding = true;
+        for_each_call(sub->func->body, measure_call_depth, &body);
+        sub->expanding = false;
+        if (body.depth > handler_depth) {
+            handler_depth = body.depth;
+        }
+    }
+    int depth = walk.depth + (handler_depth >= 0 ? 1 + handler_depth : 0);
+    return *recursive ? RECURSIVE_STACK_DEPTH : depth;
+}
+
+// The statements of a helper's body. A return as the last statement needs
+// no word: the code after the body is where it goes.
+static void emit_function_body(CompactMicrocode* mc, FunctionDefNode* func, int* addr) {
+    if (!func->body || func->body->type != NODE_BLOCK) {
+        process_statement(mc, func->body, addr);
+        return;
+    }
+    NodeList* statements = ((BlockNode*)func->body)->statements;
+    for (int i = 0; statements && i < statements->count; i++) {
+        Node* stmt = statements->items[i];
+        if (i == statements->count - 1 && stmt->type == NODE_RETURN) {
+            break;
+        }
+        process_statement(mc, stmt, addr);
+    }
+}
+
+// Delays all run on timer 0 (timerSel and timerLd are one-hot per timer)
+#define DELAY_TIMER 1u
+
+// The timdata address holding count, added if no delay loads it yet
+static int timer_memory_word(CompactMicrocode* mc, uint32_t count) {
+    for (int i = 0; i < mc->timdata_count; i++) {
+        if (mc->timdata[i] == count) return i;
+    }
+    if (mc->timdata_count >= mc->timdata_capacity) {
+        mc->timdata_capacity = mc->timdata_capacity ? mc->timdata_capacity * 2 : 4;
+        mc->timdata = realloc(mc->timdata, sizeof(uint32_t) * mc->timdata_capacity);
+        if (!mc->timdata) {
+            fprintf(stderr, "Error: Failed to allocate timer memory.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    mc->timdata[mc->timdata_count] = count;
+    return mc->timdata_count++;
+}
+
+// Holds the program for cycles clocks: a word that loads timer 0 from
+// timdata, then one that branches to itself on var_or_timer until the
+// count runs out (IP/timer.sv), count + 2 clocks in all. With delay slots
+// each pass round the wait also runs its slot, so the count is halved;
+// empty words make up what the timer cannot.
+static void emit_delay(CompactMicrocode* mc, long long cycles, WordLabel label, int* addr) {
+    bool slots = pipeline_delay_slots && !has_interrupt_handlers(mc);
+    int overhead = slots ? 3 : 2;
+    long long count = -1;
+    long long empty = cycles;
+    if (cycles >= overhead) {
+        count = slots ? (cycles - overhead) / 2 : cycles - overhead;
+        empty = slots ? (cycles - overhead) % 2 : 0;
+    }
+    if (count > UINT32_MAX) {
+        fprintf(stderr, "Warning: Delay of %lld cycles is longer than a timer counts; holding %lld\n",
+                cycles, (slots ? 2 * (long long)UINT32_MAX : (long long)UINT32_MAX) + overhead);
+        count = UINT32_MAX;
+    }
+
+    MCode mcode;
+    for (long long i = 0; i < empty; i++) {
+        populate_mcode_instruction(mc, &mcode, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+        add_compact_instruction(mc, &mcode, label, JUMP_TYPE_DIRECT, 0);
+        label = text_label("wait");
+        (*addr)++;
+    }
+    if (count < 0) {
+        return;
+    }
+    if (mc->timer_count < 1) {
+        mc->timer_count = 1;
+    }
+
+    // The load word's jadr is the timdata address, not a jump target
+    int word = timer_memory_word(mc, (uint32_t)count);
+    populate_mcode_instruction(mc, &mcode, 0, 0, word, 0, DELAY_TIMER, DELAY_TIMER, 0, 0, 0, 0, 0, 0, 0, 0);
+    add_compact_instruction(mc, &mcode, label, JUMP_TYPE_DIRECT, 0);
+    (*addr)++;
+
+    populate_mcode_instruction(mc, &mcode, 0, 0, 0, 0, DELAY_TIMER, 0, 0, 0, 0, 1, 1, 0, 0, 0);
+    add_compact_instruction(mc, &mcode, text_label("wait"), JUMP_TYPE_DIRECT, *addr);
+    mc->branch_instructions++;
+    (*addr)++;
+}
+
+static void process_call(CompactMicrocode* mc, FunctionCallNode* call, int* addr) {
+    int index = find_subroutine(mc, call->name);
+    long long cycles;
+    if (index < 0 && strcmp(call->name, "delay") == 0 && call->arguments->count == 1 &&
+        call->arguments->items[0]->type == NODE_NUMBER_LITERAL &&
+        constant_literal_value(call->arguments->items[0], &cycles)) {
+        // The delay(n) intrinsic, unless the program defines its own
+        emit_delay(mc, cycles, name_label("delay(%s);", ((NumberLiteralNode*)call->arguments->items[0])->value), addr);
+        return;
+    }
+    if (index < 0 || call->arguments->count > 0) {
+        // Helpers with parameters, and undefined ones, have nothing to run
+        print_debug("DEBUG: process_call: %s() is not compiled\n", call->name);
+        return;
+    }
+    Subroutine* sub = &mc->subroutines[index];
+
+    if (sub->expanding) {
+        // Recursion cannot be inlined
+        sub->outlined = true;
+    }
+    if (sub->outlined) {
+        if (sub->entry_label == NO_LABEL) {
+            sub->entry_label = new_label(mc);
+        }
+        // sub and branch push the return address in IP/control.sv; the
+        // forced jump takes the branch whatever the variable select reads
+        MCode call_mcode;
+        populate_mcode_instruction(mc, &call_mcode, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 0);
+        add_compact_instruction(mc, &call_mcode, name_label("%s();", call->name), JUMP_TYPE_LABEL, sub->entry_label);
+        mc->jump_instructions++;
+        (*addr)++;
+        return;
+    }
+
+    // Inline: a return jumps past this copy
+    int saved_return = mc->return_label;
+    int end_label = new_label(mc);
+    mc->return_label = end_label;
+    sub->expanding = true;
+    emit_function_body(mc, sub->func, addr);
+    sub->expanding = false;
+    mc->return_label = saved_return;
+    bind_label(mc, end_label, *addr);
+}
+
+// One shared body and its return word, recorded in mc->subroutine_bodies
+static void emit_shared_body(CompactMicrocode* mc, Subroutine* sub, int* addr) {
+    sub->emitted = true;
+    int start = *addr;
+
+    bind_label(mc, sub->entry_label, *addr);
+    int saved_return = mc->return_label;
+    mc->return_label = RETURN_TO_CALLER;
+    sub->expanding = true;
+    emit_function_body(mc, sub->func, addr);
+    sub->expanding = false;
+    mc->return_label = saved_return;
+
+    MCode rtn_mcode;
+    populate_mcode_instruction(mc, &rtn_mcode, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1);
+    add_compact_instruction(mc, &rtn_mcode, name_label("} /* %s */", sub->func->name), JUMP_TYPE_DIRECT, 0);
+    (*addr)++;
+
+    if (!mc->subroutine_bodies) {
+        mc->subroutine_bodies = malloc(sizeof(SubroutineBody) * mc->subroutine_count);
+        if (!mc->subroutine_bodies) {
+            fprintf(stderr, "Error: Failed to allocate subroutine bodies.\n");
+            exit(EXIT_FAILURE);
         }
-        default:
-            count = 1; // Default to 1 instruction
-            break; // Use break instead of return here
     }
-    return count;
+    SubroutineBody* body = &mc->subroutine_bodies[mc->subroutine_body_count++];
+    body->name = strdup(sub->func->name);
+    body->address = start;
+    body->words = *addr - start;
 }
 
-static void process_function(CompactMicrocode* mc, FunctionDefNode* func) {
-    int current_addr = 0;
-    int* addr = &current_addr;
-    
-    // Calculate exit address dynamically. This will be the address of the :exit instruction.
-    // It is the current address after all statements in the function body are processed.
-    // Store exit address for use in jump resolution.
-    
-    // Add function entry, calculating initial state from hw_ctx
-    int initial_state = 0;
-    int initial_mask = 0;
-    if (mc->hw_ctx) {
-        for (int i = 0; i < mc->hw_ctx->state_count; i++) {
-            StateVariable* s = &mc->hw_ctx->states[i];
-            if (s->initial_value) {
-                initial_state |= (1 << s->state_number);
+// With --stable-layout: the pending body the previous build placed at
+// the lowest address from addr on, in *address, so it lands where it was;
+// when none fits, the first pending one, in *address -1
+static Subroutine* next_stable_body(CompactMicrocode* mc, int addr, int* address) {
+    Subroutine* first = NULL;
+    Subroutine* placed = NULL;
+    for (int i = 0; i < mc->subroutine_count; i++) {
+        Subroutine* sub = &mc->subroutines[i];
+        if (!sub->outlined || sub->emitted || sub->entry_label == NO_LABEL) continue;
+        if (!first) first = sub;
+        int previous = previous_body_address(sub->func->name);
+        if (previous >= addr && (!placed || previous < *address)) {
+            placed = sub;
+            *address = previous;
+        }
+    }
+    if (!placed) *address = -1;
+    return placed ? placed : first;
+}
+
+static void emit_subroutines(CompactMicrocode* mc, int* addr) {
+    for (int i = 0; i < mc->subroutine_count; i++) {
+        if (mc->subroutines[i].handler && mc->subroutines[i].entry_label == NO_LABEL) {
+            mc->subroutines[i].entry_label = new_label(mc);
+        }
+    }
+
+    if (previous_layout) {
+        // Empty words up to each body's old address; a body that no longer
+        // fits there goes after the ones that do
+        int address;
+        Subroutine* sub;
+        while ((sub = next_stable_body(mc, *addr, &address)) != NULL) {
+            while (*addr < address) {
+                MCode pad_mcode;
+                populate_mcode_instruction(mc, &pad_mcode, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+                add_compact_instruction(mc, &pad_mcode, text_label("padding"), JUMP_TYPE_DIRECT, 0);
+                (*addr)++;
             }
-            initial_mask |= (1 << s->state_number);
+            emit_shared_body(mc, sub, addr);
         }
+        return;
     }
-    
-    // Use calculated state and mask. Mask should be 7 for 3 state variables.
-    MCode entry_mcode;
-    populate_mcode_instruction(mc, &entry_mcode, mc->hw_ctx->initial_state_value, mc->hw_ctx->initial_mask_value, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0); // Use dynamically calculated initial state and mask
-    add_compact_instruction(mc, &entry_mcode, "main(){", JUMP_TYPE_DIRECT, 1);
-    (*addr)++; // Increment address for main(){
-    
-    
-    if (func->body && func->body->type == NODE_BLOCK) {
-        BlockNode* block = (BlockNode*)func->body;
-        for (int i = 0; i < block->statements->count; i++) {
-            process_statement(mc, block->statements->items[i], addr);
+
+    // A shared body can call into a helper not emitted yet, so repeat until none is left
+    bool emitted = true;
+    while (emitted) {
+        emitted = false;
+        for (int i = 0; i < mc->subroutine_count; i++) {
+            Subroutine* sub = &mc->subroutines[i];
+            if (!sub->outlined || sub->emitted || sub->entry_label == NO_LABEL) continue;
+            emitted = true;
+            emit_shared_body(mc, sub, addr);
         }
     }
-    
-    // Set the exit address after all instructions have been generated
-    // The exit instruction will be the last instruction, so its address is mc->instruction_count - 1
-    mc->exit_address = mc->instruction_count; // Set exit address to the total number of instructions generated
+}
 
-    // Add exit instruction (will be a self-loop after resolution)
-    MCode exit_mcode;
-    populate_mcode_instruction(mc, &exit_mcode, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0); // jadr placeholder
-    add_compact_instruction(mc, &exit_mcode, ":exit", JUMP_TYPE_EXIT, mc->exit_address);
+
+// Whether a while loop tests its condition at the bottom: as --rotate-loops
+// says, unless --profile-use counted its body. Rotating saves the jump back
+// on every iteration, for a second test of the condition at the entry.
+static bool rotate_while(WhileNode* while_node) {
+    if (is_constant_condition(while_node->condition)) return false;
+    uint64_t iterations;
+    if (profiled_runs(while_node->body, &iterations)) {
+        print_debug("DEBUG: while loop: body ran %llu times in the profile\n", (unsigned long long)iterations);
+        return profile_is_hot(iterations);
+    }
+    return rotate_loops;
 }
 
+static void emit_statement(CompactMicrocode* mc, Node* stmt, int* addr);
 
-// In ast_to_microcode.c (within process_statement function)
+// Generates stmt and marks its first word as the start of stmt for
+// --profile-use. A statement nested at the same word was marked when it
+// returned, before this one, so the outermost one is kept.
 static void process_statement(CompactMicrocode* mc, Node* stmt, int* addr) {
+    int first = mc->instruction_count;
+    emit_statement(mc, stmt, addr);
+    if (stmt && mc->instruction_count > first) {
+        mc->word_labels[first].statement = stmt;
+    }
+}
+
+static void emit_statement(CompactMicrocode* mc, Node* stmt, int* addr) {
     if (!stmt) return;
     
     switch (stmt->type) {
         case NODE_WHILE: {
             WhileNode* while_node = (WhileNode*)stmt;
+            if (rotate_while(while_node)) {
+                process_rotated_while(mc, while_node, addr);
+                break;
+            }
             
             // Determine continue_target (address of the while loop header) and break_target (address after the loop)
             int while_loop_start_addr = *addr; 
-            // Determine break_target (address after the entire while loop)
-            int estimated_break_target;
-            (void)estimated_break_target; // Placeholder for future use; avoid unused-variable warning
-            // Check if it's a while(1) loop
-            bool is_while_one = (while_node->condition->type == NODE_NUMBER_LITERAL &&
-                                 atoi(((NumberLiteralNode*)while_node->condition)->value) == 1);
-            if (while_node->condition->type == NODE_NUMBER_LITERAL) {
-            }
-
-            if (is_while_one) {
-                estimated_break_target = mc->exit_address; // For while(1), break target is program exit
-            } else {
-                estimated_break_target = *addr + count_statements((Node*)while_node);
-            }
+            // A false test and breaks leave to the word after the loop, as in
+            // process_rotated_while; that address is bound once the jump back is out
+            int exit_label = new_label(mc);
 
             // Create and push the loop context onto the stack
             LoopSwitchContext current_loop_context = {
                 .loop_type = NODE_WHILE,
                 .continue_target = while_loop_start_addr,
-                .break_target = mc->exit_address // For while(1) this means jump to exit
+                .break_target = 0,
+                .continue_label = NO_LABEL,
+                .break_label = exit_label,
+                .switch_id = -1
             };
             push_context(mc, &current_loop_context);
-            char* condition_lable_str = NULL;
-            char while_full_label[256];
-            if (while_node->condition) {
-                // process_expression(mc, while_node->condition, addr); // Condition handled directly by while instruction
-                condition_lable_str = create_condition_label(while_node->condition);
-            } else {
-                condition_lable_str = strdup("true"); // Directly set label for while(1)
-            }
-            snprintf(while_full_label, sizeof(while_full_label), "while (%s) {", condition_lable_str);
-            
-            
-            // Generate the while loop header instruction (jumps to loop_exit_addr if condition is false)
-            MCode while_mcode;
-            int current_varsel_id = get_hybrid_varsel(while_node->condition, mc);
-            populate_mcode_instruction(mc, &while_mcode, 0, 0, 0, current_varsel_id, 0, 0, 0, 0, 1, 0, 1, 0, 0, 0); // jadr placeholder, branch=1, state_capture=1, forced_jmp=0
-            add_compact_instruction(mc, &while_mcode, while_full_label, JUMP_TYPE_EXIT, mc->exit_address);
-            (*addr)++;
+            // With --fold-constants a condition that is always true has
+            // no test: the jump back goes straight to the body
+            long long always;
+            bool untested = fold_constants && constant_literal_value(while_node->condition, &always) && always != 0;
+            if (!untested) {
+                // Generate the while loop header instruction (jumps to exit_label if condition is false)
+                MCode while_mcode;
+                int current_varsel_id = get_hybrid_varsel(while_node->condition, mc);
+                populate_mcode_instruction(mc, &while_mcode, 0, 0, 0, current_varsel_id, 0, 0, 0, 0, 1, 0, 1, 0, 0, 0); // jadr placeholder, branch=1, state_capture=1, forced_jmp=0
+                add_compact_instruction(mc, &while_mcode, condition_label("while (%s) {", while_node->condition), JUMP_TYPE_LABEL, exit_label);
+                (*addr)++;
 
-            // Only add conditional expression for complex expressions (varSel > 0) and non-constant conditions
-            if (current_varsel_id > 0 && !is_constant_condition(while_node->condition)) {
-                add_conditional_expression(mc, while_node->condition, current_varsel_id);
+                // Only add conditional expression for complex expressions (varSel > 0) and non-constant conditions
+                if (current_varsel_id > 0 && !is_constant_condition(while_node->condition)) {
+                    add_conditional_expression(mc, while_node->condition, current_varsel_id);
+                }
             }
             
-            free(condition_lable_str);
             // Process while body statements
             if (while_node->body) {
                 if (while_node->body->type == NODE_BLOCK) {
@@ -1035,17 +2092,24 @@ static void process_statement(CompactMicrocode* mc, Node* stmt, int* addr) {
             // Add the jump back to the loop header for the next iteration
             MCode jump_mcode;
             populate_mcode_instruction(mc, &jump_mcode, 0, 0, current_loop_context.continue_target, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0); // Jadr still needs to be populated for the MCode struct
-            add_compact_instruction(mc, &jump_mcode, "}", JUMP_TYPE_CONTINUE, mc->stack_ptr - 1);
+            add_compact_instruction(mc, &jump_mcode, text_label("}"), JUMP_TYPE_CONTINUE, mc->stack_ptr - 1);
             mc->jump_instructions++;
             (*addr)++;
             
             // Pop the context from the stack
             pop_context(mc);
+            bind_label(mc, exit_label, *addr);
             break;
         }
         
         case NODE_FOR: {
             ForNode* for_node = (ForNode*)stmt;
+            long long trips = delay_loop_trips(for_node);
+            if (trips >= 0) {
+                // Only counts: a cycle an iteration, on a timer
+                emit_delay(mc, trips, condition_label("for %s;", for_node->condition), addr);
+                break;
+            }
             // Increment timer_count for each for loop encountered
             mc->timer_count++;
             process_for_loop(mc, for_node, addr); // Delegate to the new for loop processing function
@@ -1054,52 +2118,72 @@ static void process_statement(CompactMicrocode* mc, Node* stmt, int* addr) {
         
         case NODE_IF: {
             IfNode* if_node = (IfNode*)stmt;
+            Node* condition = if_node->condition;
+            Node* then_branch = if_node->then_branch;
+            if (fuse_conditions && !if_node->else_branch) {
+                fuse_nested_conditions(mc, &condition, &then_branch);
+            }
             
-            // Determine the condition and create appropriate label
-            char* condition_label = create_condition_label(if_node->condition);
-            
-            // Calculate jump address based on statement structure
-            int jump_addr = calculate_jump_address(mc, if_node, *addr);
+            // The branch skips the then part; its target is bound once that has been emitted
+            int else_label = new_label(mc);
             
             MCode if_mcode;
             int current_varsel_id;
 
             // Hybrid approach: simple variables = 0, complex expressions = incremental
-            current_varsel_id = get_hybrid_varsel(if_node->condition, mc);
+            current_varsel_id = get_hybrid_varsel(condition, mc);
 
             // Only add conditional expression for complex expressions (varSel > 0) and non-constant conditions
-            if (current_varsel_id > 0 && !is_constant_condition(if_node->condition)) {
-                add_conditional_expression(mc, if_node->condition, current_varsel_id);
+            if (current_varsel_id > 0 && !is_constant_condition(condition)) {
+                add_conditional_expression(mc, condition, current_varsel_id);
             }
             
-            char if_full_label[256];
-            snprintf(if_full_label, sizeof(if_full_label), "if (%s) {", condition_label);
-            populate_mcode_instruction(mc, &if_mcode, 0, 0, jump_addr, current_varsel_id, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0);
-            add_compact_instruction(mc, &if_mcode, if_full_label, JUMP_TYPE_DIRECT, calculate_jump_address(mc, if_node, *addr));
+
+            // The head of an else-if ladder records the whole ladder
+            if (stmt != mc->ladder_link && if_node->else_branch && if_node->else_branch->type == NODE_IF) {
+                int tests = 1;
+                Node* link = (Node*)if_node;
+                while (((IfNode*)link)->else_branch && ((IfNode*)link)->else_branch->type == NODE_IF) {
+                    link = ((IfNode*)link)->else_branch;
+                    tests++;
+                }
+                char* ladder_condition = create_condition_label(condition);
+                char ladder_label[256];
+                snprintf(ladder_label, sizeof(ladder_label), "if (%s)", ladder_condition);
+                free(ladder_condition);
+                record_dispatch_site(mc, false, ladder_label, tests, ((IfNode*)link)->else_branch != NULL);
+            }
+            populate_mcode_instruction(mc, &if_mcode, 0, 0, 0, current_varsel_id, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0);
+            add_compact_instruction(mc, &if_mcode, condition_label("if (%s) {", condition), JUMP_TYPE_LABEL, else_label);
             mc->branch_instructions++;
             (*addr)++;
             
             // Process then branch
-            if (if_node->then_branch) {
-                process_statement(mc, if_node->then_branch, addr);
+            if (then_branch) {
+                process_statement(mc, then_branch, addr);
             }
             
             // Process else branch if present
             if (if_node->else_branch) {
                 // Always generate an "else" instruction first, regardless of whether it's else-if or else-block
-                // Calculate the jump address for the else (should jump past the entire if-else chain)
-                int else_jump_addr = calculate_else_jump_address(mc, if_node, *addr);
+                // It jumps past the else part, to a label bound once that has been emitted
+                int end_label = new_label(mc);
                 MCode else_mcode;
-                populate_mcode_instruction(mc, &else_mcode, 0, 0, else_jump_addr, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0);
-                add_compact_instruction(mc, &else_mcode, "else", JUMP_TYPE_DIRECT, calculate_else_jump_address(mc, if_node, *addr));
+                populate_mcode_instruction(mc, &else_mcode, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0);
+                add_compact_instruction(mc, &else_mcode, text_label("else"), JUMP_TYPE_LABEL, end_label);
                 mc->jump_instructions++;
                 (*addr)++;
+                bind_label(mc, else_label, *addr);
                 
                 // Then process the else branch (whether it's else-if or else-block)
+                if (if_node->else_branch->type == NODE_IF) {
+                    mc->ladder_link = if_node->else_branch;
+                }
                 process_statement(mc, if_node->else_branch, addr);
+                bind_label(mc, end_label, *addr);
+            } else {
+                bind_label(mc, else_label, *addr);
             }
-            
-            free(condition_label);
             break;
         }
         
@@ -1127,40 +2211,9 @@ static void process_statement(CompactMicrocode* mc, Node* stmt, int* addr) {
             SwitchNode* switch_node = (SwitchNode*)stmt;
             print_debug("DEBUG: process_statement: Processing switch at address %d\n", *addr);
             
-            // Calculate break target using count_statements
-            int estimated_break_target;
-            LoopSwitchContext current_switch_context = {
-                .loop_type = NODE_SWITCH, // Indicate it's a switch
-                .continue_target = -1,    // Continue is not applicable for switch
-                .break_target = *addr + count_statements((Node*)switch_node)
-            };
-            estimated_break_target = current_switch_context.break_target;
-            print_debug("DEBUG: process_statement: Switch break target calculated as %d\n", estimated_break_target);
-            
-            push_context(mc, &current_switch_context);
-            
-            // Store the current pending switch break count to identify which breaks belong to this switch
-            int start_pending_break_count = mc->pending_switch_break_count;
-            
+            // process_switch_statement pushes the switch's own context; breaks resolve by switch ID
             process_switch_statement(mc, switch_node, addr);
-            
-            // The break target should now be the current address after processing the switch
             print_debug("DEBUG: process_statement: After processing switch, address is %d\n", *addr);
-            
-            // DO NOT update the break target here - it was already set correctly in process_switch_statement
-            // when we knew where the "}}" instruction was. Updating it here would use the wrong address
-            // after nested switches have been processed.
-            // mc->loop_switch_stack[mc->stack_ptr - 1].break_target = *addr;
-            print_debug("DEBUG: process_statement: NOT updating switch break target (already set correctly)\n");
-            
-            // DO NOT update pending switch breaks here - they already have the correct target
-            // from when the switch info was created in process_switch_statement
-            for (int i = start_pending_break_count; i < mc->pending_switch_break_count; i++) {
-                print_debug("DEBUG: Pending switch break %d at instruction %d already has correct target\n",
-                        i, mc->pending_switch_breaks[i].instruction_index);
-            }
-            
-            pop_context(mc); // Pop the switch context after processing
             break;
         }
         
@@ -1184,33 +2237,16 @@ static void process_statement(CompactMicrocode* mc, Node* stmt, int* addr) {
             // Generate a jump instruction to the break_target
             MCode break_mcode;
             populate_mcode_instruction(mc, &break_mcode, 0, 0, jump_target, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0);
-            add_compact_instruction(mc, &break_mcode, "break;", JUMP_TYPE_BREAK, mc->stack_ptr - 1);
+            add_compact_instruction(mc, &break_mcode, text_label("break;"), JUMP_TYPE_BREAK, mc->stack_ptr - 1);
             
             // If this is a switch break, add it to the pending list for later resolution
-            printf("DEBUG: Processing break statement at instruction index %d, loop_type=%d, jump_target=%d\n",
-                   mc->instruction_count - 1, current_context.loop_type, jump_target);
+            print_debug("DEBUG: Processing break statement at instruction index %d, loop_type=%d, jump_target=%d\n",
+                        mc->instruction_count - 1, current_context.loop_type, jump_target);
             if (current_context.loop_type == NODE_SWITCH) {
-                if (mc->pending_switch_break_count < MAX_PENDING_SWITCH_BREAKS) {
-                    mc->pending_switch_breaks[mc->pending_switch_break_count].instruction_index = mc->instruction_count - 1;
-                    // Store the context stack index so we can find the correct break target later
-                    // We need to find the switch context on the stack
-                    int switch_context_index = -1;
-                    (void)switch_context_index; // Currently unused; reserved for potential debug/analysis
-                    int switch_start_addr = -1;
-                    for (int i = mc->stack_ptr - 1; i >= 0; i--) {
-                        if (mc->loop_switch_stack[i].loop_type == NODE_SWITCH) {
-                            switch_context_index = i;
-                            switch_start_addr = mc->loop_switch_stack[i].continue_target; // Use continue_target as switch start
-                            break;
-                        }
-                    }
-                    mc->pending_switch_breaks[mc->pending_switch_break_count].switch_start_addr = switch_start_addr;
-                    printf("DEBUG: Added pending switch break %d with instruction index %d (switch_start_addr=%d)\n",
-                           mc->pending_switch_break_count, mc->instruction_count - 1, switch_start_addr);
-                    mc->pending_switch_break_count++;
-                } else {
-                    fprintf(stderr, "Error: Too many pending switch breaks (max %d)\n", MAX_PENDING_SWITCH_BREAKS);
-                }
+                // The innermost context is this break's switch; its end is looked up by ID once emitted
+                add_pending_switch_break(mc, mc->instruction_count - 1, current_context.switch_id);
+                print_debug("DEBUG: Added pending switch break %d with instruction index %d (switch_id=%d)\n",
+                            mc->pending_switch_break_count - 1, mc->instruction_count - 1, current_context.switch_id);
             } else {
                 print_debug("DEBUG: Break statement at instruction %d not added to pending list (loop_type=%d)\n", mc->instruction_count - 1, current_context.loop_type);
             }
@@ -1236,19 +2272,86 @@ static void process_statement(CompactMicrocode* mc, Node* stmt, int* addr) {
             // Generate a jump instruction to the continue_target
             MCode continue_mcode;
             populate_mcode_instruction(mc, &continue_mcode, 0, 0, current_context.continue_target, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0);
-            add_compact_instruction(mc, &continue_mcode, "continue;", JUMP_TYPE_CONTINUE, mc->stack_ptr - 1);
+            add_compact_instruction(mc, &continue_mcode, text_label("continue;"), JUMP_TYPE_CONTINUE, mc->stack_ptr - 1);
             mc->jump_instructions++;
             (*addr)++;
             // pop_context(mc); // Removed - Context should not be popped by individual continue statements
             break;
         }
         
+        case NODE_RETURN: {
+            // Not compiled in main; in a helper it leaves the body
+            if (mc->return_label == RETURN_TO_CALLER) {
+                MCode rtn_mcode;
+                populate_mcode_instruction(mc, &rtn_mcode, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1);
+                add_compact_instruction(mc, &rtn_mcode, text_label("return;"), JUMP_TYPE_DIRECT, 0);
+                (*addr)++;
+            } else if (mc->return_label != NO_LABEL) {
+                MCode jump_mcode;
+                populate_mcode_instruction(mc, &jump_mcode, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0);
+                add_compact_instruction(mc, &jump_mcode, text_label("return;"), JUMP_TYPE_LABEL, mc->return_label);
+                mc->jump_instructions++;
+                (*addr)++;
+            }
+            break;
+        }
+        
         default:
             // Skip other statement types for now
             break;
     }
 }
 
+// Rotated while loop: the header test runs once as a guard, and the loop
+// repeats from a test at the bottom, so an iteration costs the body plus
+// one branch word instead of a header word and a jump back. Hotstate
+// branches when the selected condition is false, so the bottom word tests
+// !(cond) to jump back into the body while cond holds. Both the guard and
+// breaks leave to the word after the loop.
+static void process_rotated_while(CompactMicrocode* mc, WhileNode* while_node, int* addr) {
+    int exit_label = new_label(mc);
+    int test_label = new_label(mc);
+
+    // Guard: skip the loop when the condition is false on entry
+    MCode guard_mcode;
+    int guard_varsel_id = get_hybrid_varsel(while_node->condition, mc);
+    if (guard_varsel_id > 0) {
+        add_conditional_expression(mc, while_node->condition, guard_varsel_id);
+    }
+    populate_mcode_instruction(mc, &guard_mcode, 0, 0, 0, guard_varsel_id, 0, 0, 0, 0, 1, 0, 1, 0, 0, 0);
+    add_compact_instruction(mc, &guard_mcode, condition_label("while (%s) {", while_node->condition), JUMP_TYPE_LABEL, exit_label);
+    mc->branch_instructions++;
+    (*addr)++;
+
+    int body_addr = *addr;
+    // The targets are only known once the body is out, so jumps use the labels
+    LoopSwitchContext loop_context = {
+        .loop_type = NODE_WHILE,
+        .continue_target = 0,
+        .break_target = 0,
+        .continue_label = test_label,
+        .break_label = exit_label,
+        .switch_id = -1
+    };
+    push_context(mc, &loop_context);
+    if (while_node->body) {
+        process_statement(mc, while_node->body, addr);
+    }
+    pop_context(mc);
+
+    // Bottom test: back into the body unless the condition has gone false
+    bind_label(mc, test_label, *addr);
+    Node* inverted = create_unary_op_node(TOKEN_NOT, while_node->condition);
+    int test_varsel_id = get_hybrid_varsel(inverted, mc);
+    add_conditional_expression(mc, inverted, test_varsel_id);
+    MCode test_mcode;
+    populate_mcode_instruction(mc, &test_mcode, 0, 0, body_addr, test_varsel_id, 0, 0, 0, 0, 1, 0, 1, 0, 0, 0);
+    add_compact_instruction(mc, &test_mcode, condition_label("} while (%s)", while_node->condition), JUMP_TYPE_DIRECT, body_addr);
+    mc->branch_instructions++;
+    (*addr)++;
+    bind_label(mc, exit_label, *addr);
+}
+
 // Process switch statement and generate microcode with hotstate-compatible switch memory
 static void process_switch_statement(CompactMicrocode* mc, SwitchNode* switch_node, int* addr) {
     if (!switch_node || !switch_node->expression) {
@@ -1259,10 +2362,7 @@ static void process_switch_statement(CompactMicrocode* mc, SwitchNode* switch_no
     
     // Assign unique switch ID
     int switch_id = mc->switch_count++;
-    if (switch_id >= MAX_SWITCHES) {
-        printf("Error: Too many switches (max %d)\n", MAX_SWITCHES);
-        return;
-    }
+    reserve_switch(mc, switch_id, *addr);
     
     int switch_expression_input_num = 0; // Default to 0 or an error value
     if (switch_node->expression->type == NODE_IDENTIFIER) {
@@ -1275,17 +2375,16 @@ static void process_switch_statement(CompactMicrocode* mc, SwitchNode* switch_no
         return;
     }
 
-    // Calculate the estimated break_target for this switch statement
-    // This is the address immediately after the entire switch block
-    int estimated_break_target = *addr + count_statements((Node*)switch_node);
-    print_debug("DEBUG: process_switch_statement: Switch size calculated as %d\n", count_statements((Node*)switch_node));
-    print_debug("DEBUG: process_switch_statement: Estimated break target: %d\n", estimated_break_target);
-
-    // Push the current switch context onto the stack
+    // Push the current switch context onto the stack. Breaks are patched
+    // from switch_infos[switch_id] once the closing "}}" is out, so the
+    // break target is only a stand-in until then.
     LoopSwitchContext current_switch_context = {
         .loop_type = NODE_SWITCH, // Indicate it's a switch
         .continue_target = *addr, // Store switch start address for break resolution
-        .break_target = estimated_break_target
+        .break_target = *addr,
+        .continue_label = NO_LABEL,
+        .break_label = NO_LABEL,
+        .switch_id = switch_id
     };
     push_context(mc, &current_switch_context);
 
@@ -1305,14 +2404,24 @@ static void process_switch_statement(CompactMicrocode* mc, SwitchNode* switch_no
     populate_mcode_instruction(mc, &switch_mcode, 0, 0, 0, current_varsel_id, 0, 0, switch_expression_input_num, 1, 0, 0, 0, 0, 0, 0);
     
     // Create dynamic label that includes the variable name
-    char switch_label[128];
+    WordLabel switch_label = text_label("SWITCH (expr)");
     if (switch_node->expression->type == NODE_IDENTIFIER) {
-        IdentifierNode* ident = (IdentifierNode*)switch_node->expression;
-        snprintf(switch_label, sizeof(switch_label), "SWITCH (%s)", ident->name);
-    } else {
-        snprintf(switch_label, sizeof(switch_label), "SWITCH (expr)");
+        switch_label = name_label("SWITCH (%s)", ((IdentifierNode*)switch_node->expression)->name);
     }
     
+    int num_arms = 0;
+    bool has_default = false;
+    for (int i = 0; switch_node->cases && i < switch_node->cases->count; i++) {
+        if (((CaseNode*)switch_node->cases->items[i])->value) {
+            num_arms++;
+        } else {
+            has_default = true;
+        }
+    }
+    char site_label[128];
+    snprintf(site_label, sizeof(site_label), "switch (%s)", ((IdentifierNode*)switch_node->expression)->name);
+    record_dispatch_site(mc, true, site_label, num_arms, has_default);
+
     add_switch_instruction(mc, &switch_mcode, switch_label, switch_id);
     (*addr)++;
     
@@ -1326,12 +2435,9 @@ static void process_switch_statement(CompactMicrocode* mc, SwitchNode* switch_no
         CaseNode* case_node = (CaseNode*)switch_node->cases->items[i];
         
         // Mark this address as a case target
-        char case_label[64];
+        WordLabel case_label = text_label("DEFAULT_CASE");
         if (case_node->value && case_node->value->type == NODE_NUMBER_LITERAL) {
-            NumberLiteralNode* num = (NumberLiteralNode*)case_node->value;
-            snprintf(case_label, sizeof(case_label), "CASE_%s", num->value);
-        } else {
-            snprintf(case_label, sizeof(case_label), "DEFAULT_CASE");
+            case_label = name_label("CASE_%s", ((NumberLiteralNode*)case_node->value)->value);
         }
         
         // Generate case target instruction (normal instruction, not switch)
@@ -1357,43 +2463,15 @@ static void process_switch_statement(CompactMicrocode* mc, SwitchNode* switch_no
     // Store the address where the "}}" will be placed
     int switch_closing_addr = *addr;
     
-    add_compact_instruction(mc, &end_switch_mcode, "}}", JUMP_TYPE_DIRECT, 0);
+    add_compact_instruction(mc, &end_switch_mcode, text_label("}}"), JUMP_TYPE_DIRECT, 0);
     (*addr)++;
     
-    // The break target should be the instruction AFTER the "}}"
-    int break_jump_target = *addr;
-    
-    // Update the break target in the context to the actual final address
-    mc->loop_switch_stack[mc->stack_ptr - 1].break_target = break_jump_target;
-    print_debug("DEBUG: process_switch_statement: Switch closing at %d, breaks should jump to %d\n",
-            switch_closing_addr, break_jump_target);
-    
-    // TWO-PASS SYSTEM: Store where breaks should jump to (after the "}}")
-    int current_switch_start_addr = mc->loop_switch_stack[mc->stack_ptr - 1].continue_target;
-    
-    // Check if we already have switch info for this switch
-    bool found = false;
-    for (int i = 0; i < mc->switch_info_count; i++) {
-        if (mc->switch_infos[i].switch_start_addr == current_switch_start_addr) {
-            // Update with the break jump target (instruction after "}}")
-            mc->switch_infos[i].switch_end_addr = break_jump_target;
-            print_debug("DEBUG: process_switch_statement: Updated switch info for start addr %d, break target %d\n",
-                    current_switch_start_addr, break_jump_target);
-            found = true;
-            break;
-        }
-    }
-    
-    // If not found, create new switch info with break jump target
-    if (!found && mc->switch_info_count < MAX_SWITCHES) {
-        mc->switch_infos[mc->switch_info_count].switch_start_addr = current_switch_start_addr;
-        mc->switch_infos[mc->switch_info_count].switch_end_addr = break_jump_target;
-        mc->switch_infos[mc->switch_info_count].first_break_index = -1;
-        mc->switch_infos[mc->switch_info_count].break_count = 0;
-        mc->switch_info_count++;
-        print_debug("DEBUG: process_switch_statement: Created switch info for start addr %d, break target %d\n",
-                current_switch_start_addr, break_jump_target);
-    }
+    // Breaks land on the word after the "}}"
+    SwitchInfo* info = &mc->switch_infos[switch_id];
+    info->switch_end_addr = mc->instruction_count;
+    mc->loop_switch_stack[mc->stack_ptr - 1].break_target = info->switch_end_addr;
+    print_debug("DEBUG: process_switch_statement: Switch %d closing at %d, breaks should jump to %d\n",
+            switch_id, switch_closing_addr, info->switch_end_addr);
     
     // Pop the switch context from the stack
     pop_context(mc);
@@ -1428,9 +2506,7 @@ static void process_expression(CompactMicrocode* mc, Node* expr, int* addr) {
             MCode load_mcode;
             populate_mcode_instruction(mc, &load_mcode, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
 
-            char label[64];
-            snprintf(label, sizeof(label), "load %s", ident->name);
-            add_compact_instruction(mc, &load_mcode, label, JUMP_TYPE_DIRECT, 0);
+            add_compact_instruction(mc, &load_mcode, name_label("load %s", ident->name), JUMP_TYPE_DIRECT, 0);
             (*addr)++;
             break;
         }
@@ -1440,9 +2516,7 @@ static void process_expression(CompactMicrocode* mc, Node* expr, int* addr) {
             // Generate immediate load instruction
             MCode imm_mcode;
             populate_mcode_instruction(mc, &imm_mcode, 0, 2, 0, 0, 0, 0, 0, atoi(num->value), 0, 0, 0, 0, 0, 0);
-            char label[64];
-            snprintf(label, sizeof(label), "load #%s", num->value);
-            add_compact_instruction(mc, &imm_mcode, label, JUMP_TYPE_DIRECT, 0);
+            add_compact_instruction(mc, &imm_mcode, name_label("load #%s", num->value), JUMP_TYPE_DIRECT, 0);
             (*addr)++;
             break;
         }
@@ -1456,7 +2530,7 @@ static void process_expression(CompactMicrocode* mc, Node* expr, int* addr) {
             // Generate operation instruction
             MCode op_mcode;
             populate_mcode_instruction(mc, &op_mcode, 0, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
-            add_compact_instruction(mc, &op_mcode, "binop", JUMP_TYPE_DIRECT, 0);
+            add_compact_instruction(mc, &op_mcode, text_label("binop"), JUMP_TYPE_DIRECT, 0);
             (*addr)++;
             break;
         }
@@ -1467,34 +2541,49 @@ static void process_expression(CompactMicrocode* mc, Node* expr, int* addr) {
     }
 }
 
-static void add_compact_instruction(CompactMicrocode* mc, MCode* mcode, const char* label, JumpType jump_type, int jump_target_param) {
+// Room for one more instruction and its label
+static void reserve_instruction(CompactMicrocode* mc) {
+    if ((uint32_t)mc->instruction_count >= MCODE_MAX_ADDRESS) {
+        fprintf(stderr, "Error: Program exceeds %u microcode words.\n", MCODE_MAX_ADDRESS);
+        exit(EXIT_FAILURE);
+    }
     if (mc->instruction_count >= mc->instruction_capacity) {
         mc->instruction_capacity *= 2;
         mc->instructions = (Code*)realloc(mc->instructions, sizeof(mc->instructions[0]) * mc->instruction_capacity);
+        mc->word_labels = realloc(mc->word_labels, sizeof(WordLabel) * mc->instruction_capacity);
     }
+}
+
+static void add_compact_instruction(CompactMicrocode* mc, MCode* mcode, WordLabel label, JumpType jump_type, int jump_target_param) {
+    reserve_instruction(mc);
 
     mc->instructions[mc->instruction_count].uword.mcode = *mcode;
-    mc->instructions[mc->instruction_count].label = label ? strdup(label) : NULL;
+    mc->word_labels[mc->instruction_count] = label;
 
     // If this is a jump instruction, add it to pending_jumps
     if (mcode->branch || mcode->forced_jmp) {
         int resolved_jadr = 0;
+        int label_id = NO_LABEL;
         bool is_exit_target_jump = false;
 
         if (jump_type == JUMP_TYPE_BREAK) {
             LoopSwitchContext ctx = peek_context(mc, CONTEXT_TYPE_LOOP_OR_SWITCH);
             resolved_jadr = ctx.break_target;
+            label_id = ctx.break_label;
             print_debug("DEBUG: add_compact_instruction: BREAK instruction at index %d, resolved_jadr=%d\n", mc->instruction_count, resolved_jadr);
         } else if (jump_type == JUMP_TYPE_CONTINUE) {
             LoopSwitchContext ctx = peek_context(mc, CONTEXT_TYPE_LOOP);
             resolved_jadr = ctx.continue_target;
+            label_id = ctx.continue_label;
         } else if (jump_type == JUMP_TYPE_DIRECT) {
             resolved_jadr = jump_target_param;
+        } else if (jump_type == JUMP_TYPE_LABEL) {
+            label_id = jump_target_param;
         } else if (jump_type == JUMP_TYPE_EXIT) {
             resolved_jadr = mc->exit_address;
             is_exit_target_jump = true;
         }
-        add_pending_jump(mc, mc->instruction_count, resolved_jadr, is_exit_target_jump);
+        add_pending_jump(mc, mc->instruction_count, resolved_jadr, is_exit_target_jump, label_id);
     }
     mc->instruction_count++;
 }
@@ -1526,6 +2615,8 @@ static char* create_condition_label(Node* condition) {
                 case TOKEN_GREATER_EQUAL:op_str = ">="; break;
                 case TOKEN_LOGICAL_AND: op_str = "&&"; break; // Added for completeness
                 case TOKEN_LOGICAL_OR: op_str = "||"; break;  // Added for completeness
+                case TOKEN_PLUS: op_str = "+"; break;
+                case TOKEN_MINUS: op_str = "-"; break;
                 default: op_str = "??"; break;
             }
             snprintf(buffer, sizeof(buffer), "(%s %s %s)", left_str, op_str, right_str);
@@ -1579,135 +2670,6 @@ static char* create_condition_label(Node* condition) {
     return result_str;
 }
 
-static int calculate_jump_address(CompactMicrocode* mc, IfNode* if_node, int current_addr) {
-    (void)mc; // mc not used yet in this helper
-    // For branch instructions, calculate where to jump if condition is FALSE
-    // This should jump to the next statement after the if-then-else block
-    
-    // Estimate the size of the then branch
-    int then_size = estimate_statement_size(if_node->then_branch);
-    
-    int jump_target;
-    if (if_node->else_branch) {
-        // If there's an else branch, jump to the else part
-        jump_target = current_addr + 1 + then_size + 1; // +1 for if, +then_size, +1 for else
-    } else {
-        // If no else branch, jump past the then branch
-        jump_target = current_addr + 1 + then_size;
-    }
-    print_debug("DEBUG: calculate_jump_address: current_addr=%d, then_size=%d, else_branch=%p, jump_target=%d\n",
-            current_addr, then_size, (void*)if_node->else_branch, jump_target);
-    return jump_target;
-}
-
-static int calculate_else_jump_address(CompactMicrocode* mc, IfNode* if_node, int current_addr) {
-    (void)mc; // mc not used yet in this helper
-    // For else instructions, calculate where to jump (past the entire if-else block)
-    int else_size = estimate_statement_size(if_node->else_branch);
-    int jump_target = current_addr + 1 + else_size; // +1 for else instruction, +else_size
-    print_debug("DEBUG: calculate_else_jump_address: current_addr=%d, else_size=%d, jump_target=%d\n",
-            current_addr, else_size, jump_target);
-    return jump_target;
-}
-
-// Helper function to estimate how many instructions a statement will generate
-static int estimate_statement_size(Node* stmt) {
-    if (!stmt) {
-        print_debug("DEBUG: estimate_statement_size: NULL stmt, returning 0\n");
-        return 0;
-    }
-    
-    int size = 0;
-    switch (stmt->type) {
-        case NODE_ASSIGNMENT:
-            size = 1;
-            break;
-        case NODE_EXPRESSION_STATEMENT: // This handles comma expressions
-            size = 1;
-            break;
-        case NODE_BLOCK: {
-            BlockNode* block = (BlockNode*)stmt;
-            for (int i = 0; i < block->statements->count; i++) {
-                size += estimate_statement_size(block->statements->items[i]);
-            }
-            break;
-        }
-        case NODE_IF: {
-            IfNode* if_node = (IfNode*)stmt;
-            size = 1; // for the if instruction itself
-            // Hotstate seems to flatten nested ifs for size estimation
-            // It appears to count 1 for the 'then' branch, and 1 for the 'else' instruction.
-            // This is a heuristic to match hotstate's output for nested if-else if.
-            if (if_node->then_branch) {
-                // If the then_branch is a block, we need to count its statements
-                if (if_node->then_branch->type == NODE_BLOCK) {
-                    BlockNode* block = (BlockNode*)if_node->then_branch;
-                    for (int i = 0; i < block->statements->count; i++) {
-                        size += estimate_statement_size(block->statements->items[i]);
-                    }
-                } else {
-                    size += 1; // For a single statement in then branch
-                }
-            } else {
-                // If then_branch is NULL, it still implicitly consumes an instruction for fall-through.
-                // This accounts for cases like 'if (cond) ; else { ... }'
-                size += 1;
-            }
-            if (if_node->else_branch) {
-                size += 1; // for else instruction
-                // If the else_branch is a block, count its statements
-                if (if_node->else_branch->type == NODE_BLOCK) {
-                    BlockNode* block = (BlockNode*)if_node->else_branch;
-                    for (int i = 0; i < block->statements->count; i++) {
-                        size += estimate_statement_size(block->statements->items[i]);
-                    }
-                } else {
-                    size += 1; // For a single statement in else branch
-                }
-            }
-            // Hotstate optimization: don't add separate closing instruction for simple if statements
-            // The closing brace is added to the label of the last instruction in the then branch
-            if (if_node->else_branch) {
-                size += 1; // Only add closing instruction for if-else statements
-            }
-            break;
-        }
-        case NODE_WHILE: {
-            WhileNode* while_node = (WhileNode*)stmt;
-            size = 1; // for the while instruction itself
-            size += estimate_statement_size(while_node->body);
-            size += 1; // for the jump back to header
-            break;
-        }
-        case NODE_FOR: {
-            ForNode* for_node = (ForNode*)stmt;
-            size = 0; // Initializer and update are part of loop structure, not separate instructions for size estimate
-            if (for_node->init) {
-                size += estimate_statement_size(for_node->init);
-            }
-            size += 1; // Condition evaluation and branch
-            size += estimate_statement_size(for_node->body);
-            if (for_node->update) {
-                size += estimate_statement_size(for_node->update);
-            }
-            size += 1; // Jump back to header
-            break;
-        }
-        case NODE_BREAK:
-        case NODE_CONTINUE:
-            size = 1; // Break and continue generate jump instructions
-            break;
-        case NODE_FUNCTION_CALL: // Like led0=1,led0=0 but could be a function call
-            size = 1;
-            break;
-        default:
-            size = 1; // conservative estimate for unhandled types
-            break;
-    }
-    print_debug("DEBUG: estimate_statement_size: Node type %d, size=%d\n", stmt->type, size);
-    return size;
-}
-
 static void process_assignment(CompactMicrocode* mc, AssignmentNode* assign, int* addr) {
     if (assign->identifier && assign->identifier->type == NODE_IDENTIFIER) {
         IdentifierNode* id = (IdentifierNode*)assign->identifier;
@@ -1745,9 +2707,7 @@ static void process_assignment(CompactMicrocode* mc, AssignmentNode* assign, int
                 0            // rtn
             );
             
-            char label[64];
-            snprintf(label, sizeof(label), "%s=%d;", id->name, assign_value);
-            add_compact_instruction(mc, &assign_mcode, label, JUMP_TYPE_DIRECT, 0);
+            add_compact_instruction(mc, &assign_mcode, assign_label(id->name, assign_value), JUMP_TYPE_DIRECT, 0);
             mc->state_assignments++;
             (*addr)++;
         }
@@ -1755,6 +2715,62 @@ static void process_assignment(CompactMicrocode* mc, AssignmentNode* assign, int
 }
 
 
+// The text of one word label, leaving out the labels fused onto it
+static char* build_word_label(const WordLabel* label) {
+    char buffer[256];
+    switch (label->kind) {
+        case WORD_LABEL_NONE:
+            return NULL;
+        case WORD_LABEL_TEXT:
+            return strdup(label->format);
+        case WORD_LABEL_NAME:
+            snprintf(buffer, sizeof(buffer), label->format, label->name);
+            return strdup(buffer);
+        case WORD_LABEL_CONDITION: {
+            char* condition = create_condition_label((Node*)label->node);
+            snprintf(buffer, sizeof(buffer), label->format, condition);
+            free(condition);
+            return strdup(buffer);
+        }
+        case WORD_LABEL_SOURCE:
+            return reconstruct_source_code((Node*)label->node);
+        case WORD_LABEL_ASSIGN:
+            snprintf(buffer, sizeof(buffer), "%s=%d;", label->name, label->value);
+            return strdup(buffer);
+    }
+    return NULL;
+}
+
+// A label and the labels fused onto it, space separated
+static char* build_fused_word_label(CompactMicrocode* mc, const WordLabel* label) {
+    char* text = build_word_label(label);
+    for (int next = label->fused; next >= 0; next = mc->fused_labels[next].fused) {
+        char* more = build_word_label(&mc->fused_labels[next]);
+        if (!more) continue;
+        size_t len = strlen(text ? text : "") + strlen(more) + 2;
+        char* joined = malloc(len);
+        snprintf(joined, len, "%s %s", text ? text : "", more);
+        free(text);
+        free(more);
+        text = joined;
+    }
+    return text;
+}
+
+const char* compact_word_label(CompactMicrocode* mc, int index) {
+    if (!mc->labels) {
+        mc->labels = calloc(mc->instruction_count > 0 ? mc->instruction_count : 1, sizeof(char*));
+        if (!mc->labels) {
+            fprintf(stderr, "Error: Failed to allocate word labels.\n");
+            exit(EXIT_FAILURE);
+        }
+        for (int i = 0; i < mc->instruction_count; i++) {
+            mc->labels[i] = build_fused_word_label(mc, &mc->word_labels[i]);
+        }
+    }
+    return mc->labels[index];
+}
+
 // Helper function to reconstruct source code from AST nodes
 static char* reconstruct_source_code(Node* node) {
     if (!node) return strdup("unknown_null");
@@ -1837,12 +2853,9 @@ static void process_expression_statement(CompactMicrocode* mc, ExpressionStateme
             int state_field = 0, mask_field = 0;
             calculate_comma_expression_fields(expr_stmt->expression, mc->hw_ctx, &state_field, &mask_field);
             
-            char* source_code = reconstruct_source_code(expr_stmt->expression);
-            
             MCode combo_mcode;
             populate_mcode_instruction(mc, &combo_mcode, state_field, mask_field, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0);
-            add_compact_instruction(mc, &combo_mcode, source_code, JUMP_TYPE_DIRECT, 0);
-            free(source_code);
+            add_compact_instruction(mc, &combo_mcode, source_label(expr_stmt->expression), JUMP_TYPE_DIRECT, 0);
             mc->state_assignments++;
             (*addr)++;
         }
@@ -1850,6 +2863,8 @@ static void process_expression_statement(CompactMicrocode* mc, ExpressionStateme
         // Handle single assignments
         AssignmentNode* assign = (AssignmentNode*)expr_stmt->expression;
         process_assignment(mc, assign, addr);
+    } else if (expr_stmt->expression && expr_stmt->expression->type == NODE_FUNCTION_CALL) {
+        process_call(mc, (FunctionCallNode*)expr_stmt->expression, addr);
     }
 }
 
@@ -1893,6 +2908,15 @@ static void print_variable_mappings(CompactMicrocode* mc, FILE* output) {
     fprintf(output, "\n");
 }
 
+static void print_interrupt_vectors(CompactMicrocode* mc, FILE* output) {
+    fprintf(output, "Interrupt vectors\n");
+    for (int i = 0; i < mc->interrupt_vector_count; i++) {
+        fprintf(output, "%s at %X%s\n", mc->interrupt_vectors[i].name, mc->interrupt_vectors[i].address,
+                i == 0 ? " (INTERRUPT_ADDRESS)" : "");
+    }
+    fprintf(output, "\n");
+}
+
 // Implementation of print_compact_microcode_table (Hotstate-compatible format)
 void print_compact_microcode_table(CompactMicrocode* mc, FILE* output) {
     fprintf(output, "\nState Machine Microcode derived from %s\n\n", mc->function_name);
@@ -1940,7 +2964,9 @@ void print_compact_microcode_table(CompactMicrocode* mc, FILE* output) {
         switch_bits = 1;
     }
     int switch_nibs = (switch_bits > 0) ? (switch_bits + 3) / 4 : 1;
-    int gAddrnibs = (int)ceil(((log10(mc->instruction_count)/log10(2))) / 4.0);
+    // log10(0) is -inf, which would become a negative (left-justified,
+    // billions of columns) printf width for an empty program
+    int gAddrnibs = mc->instruction_count > 1 ? (int)ceil(((log10(mc->instruction_count)/log10(2))) / 4.0) : 1;
     if (gAddrnibs == 0) gAddrnibs = 1; // Ensure at least 1 nibble for 0 instructions
     print_debug("DEBUG: print_compact_microcode_table: mc->instruction_count = %d, gAddrnibs = %d\n", mc->instruction_count, gAddrnibs);
     
@@ -1984,18 +3010,18 @@ void print_compact_microcode_table(CompactMicrocode* mc, FILE* output) {
                header_char = columns[j].header[char_index];
            }
            
-           printf("%-*c ", columns[j].width, header_char);
+           fprintf(output, "%-*c ", columns[j].width, header_char);
        }
-       printf("\n");
+       fprintf(output, "\n");
     }
 
     // print separator "-----...----"
     for (int i = 0; i < num_columns; i++) {
         for (int j = 0; j < columns[i].width + 1; j++) {
-            printf("-");
+            fprintf(output, "-");
         }
     }
-    printf("-\n");
+    fprintf(output, "-\n");
 
     
     // Print each instruction in hotstate format
@@ -2061,7 +3087,8 @@ void print_compact_microcode_table(CompactMicrocode* mc, FILE* output) {
             }
         }
         // Explicitly print sub and rtn outside the loop to ensure they are always displayed
-        fprintf(output, "   %s\n", code_entry->label ? code_entry->label : ""); // Label at the end
+        const char* label = compact_word_label(mc, i);
+        fprintf(output, "   %s\n", label ? label : ""); // Label at the end
     }
     
     fprintf(output, "\n");
@@ -2069,6 +3096,9 @@ void print_compact_microcode_table(CompactMicrocode* mc, FILE* output) {
     // Print state and variable assignments
     print_state_assignments(mc, output);
     print_variable_mappings(mc, output);
+    if (mc->interrupt_vector_count > 0) {
+        print_interrupt_vectors(mc, output);
+    }
 }
 
 void print_compact_microcode_analysis(CompactMicrocode* mc, FILE* output) {
@@ -2076,7 +3106,7 @@ void print_compact_microcode_analysis(CompactMicrocode* mc, FILE* output) {
     fprintf(output, "Function: %s\n", mc->function_name);
     int hotstate_instruction_count = 0;
     for (int i = 0; i < mc->instruction_count; i++) {
-        const char* label = mc->instructions[i].label;
+        const char* label = compact_word_label(mc, i);
         if (!(strcmp(label, "}}") == 0 || strcmp(label, "}") == 0 || strncmp(label, "CASE_", 5) == 0 || strcmp(label, "DEFAULT_CASE") == 0)) {
             hotstate_instruction_count++;
         }
@@ -2112,33 +3142,66 @@ void print_compact_microcode_analysis(CompactMicrocode* mc, FILE* output) {
         }
     }
     
+    if (mc->varsel_logic_count > 0) {
+        fprintf(output, "\nVarsel logic: %d conditions in logic, %d vardata blocks in the ROM\n",
+                mc->varsel_logic_count, mc->varsel_rom_blocks);
+    }
+
     if (mc->hw_ctx) {
         fprintf(output, "\nHardware Resources:\n");
         fprintf(output, "State variables: %d\n", mc->hw_ctx->state_count);
         fprintf(output, "Input variables: %d\n", mc->hw_ctx->input_count);
+        if (mc->hw_ctx->pruned_input_count > 0) {
+            fprintf(output, "Pruned inputs (never read):");
+            for (int i = 0; i < mc->hw_ctx->pruned_input_count; i++) {
+                fprintf(output, " %s", mc->hw_ctx->pruned_inputs[i]);
+            }
+            fprintf(output, "\n");
+        }
     }
 }
 
 void free_compact_microcode(CompactMicrocode* mc) {
     if (!mc) return;
     
-    for (int i = 0; i < mc->instruction_count; i++) {
-        if (mc->instructions[i].label) {
-            // printf("Freeing label %d: %s\n", i, mc->instructions[i].label);
-            free(mc->instructions[i].label);
-            mc->instructions[i].label = NULL; // Prevent double free
-        }
+    for (int i = 0; mc->labels && i < mc->instruction_count; i++) {
+        free(mc->labels[i]);
     }
     
     free(mc->instructions);
+    free(mc->word_labels);
+    free(mc->labels);
+    free(mc->fused_labels);
     free(mc->function_name);
     free(mc->loop_switch_stack); // Free loop_switch_stack
     free(mc->switchmem);  // Free switch memory
+    free(mc->timdata);
     free(mc->pending_jumps); // Free the pending jumps array
+    free(mc->label_addresses);
     free(mc->pending_switch_breaks); // Free the pending switch breaks array
     free(mc->switch_infos); // Free the switch infos array
+    free(mc->subroutines);
+    for (int i = 0; i < mc->interrupt_vector_count; i++) {
+        free(mc->interrupt_vectors[i].name);
+    }
+    free(mc->interrupt_vectors);
+    for (int i = 0; i < mc->subroutine_body_count; i++) {
+        free(mc->subroutine_bodies[i].name);
+    }
+    free(mc->subroutine_bodies);
+    for (int i = 0; i < mc->fused_condition_count; i++) {
+        free(mc->fused_conditions[i]);
+    }
+    free(mc->fused_conditions);
+    free(mc->varsel_logic);
+    for (int i = 0; i < mc->dispatch_site_count; i++) {
+        free(mc->dispatch_sites[i].label);
+    }
+    free(mc->dispatch_sites);
+    free_simulated_expression_table(mc->sim_exprs); // Frees every sim_expr
     free(mc->conditional_expressions); // Free conditional_expressions
-    free(mc->vardata_lut); // Free vardata_lut
+    free(mc->vardata_blocks); // Free vardata_blocks
+    bdd_destroy(mc->bdd_mgr);
     free(mc);
 }
 
@@ -2183,20 +3246,17 @@ static void populate_switch_memory(CompactMicrocode* mc, int switch_id, SwitchNo
 }
 
 // Add switch instruction with switch metadata
-static void add_switch_instruction(CompactMicrocode* mc, MCode* mcode, const char* label, int switch_id) {
+static void add_switch_instruction(CompactMicrocode* mc, MCode* mcode, WordLabel label, int switch_id) {
     (void)switch_id; // Unused for now; interface kept for future per-switch handling
-    if (mc->instruction_count >= mc->instruction_capacity) {
-        mc->instruction_capacity *= 2;
-        mc->instructions = (Code*)realloc(mc->instructions, sizeof(mc->instructions[0]) * mc->instruction_capacity);
-    }
+    reserve_instruction(mc);
     
     mc->instructions[mc->instruction_count].uword.mcode = *mcode;
-    mc->instructions[mc->instruction_count].label = strdup(label);
+    mc->word_labels[mc->instruction_count] = label;
     mc->instruction_count++;
 }
 
 // Add case target instruction with case metadata
-static void add_case_instruction(CompactMicrocode* mc, MCode* mcode, const char* label, int switch_id) {
+static void add_case_instruction(CompactMicrocode* mc, MCode* mcode, WordLabel label, int switch_id) {
     (void)switch_id; // Unused for now; interface kept for future per-switch handling
     // Case instructions are not jumps themselves.
     add_compact_instruction(mc, mcode, label, JUMP_TYPE_DIRECT, 0);
@@ -2209,14 +3269,8 @@ static void add_case_instruction(CompactMicrocode* mc, MCode* mcode, const char*
 static int get_state_number_for_variable(const char* var_name, HardwareContext* hw_ctx) {
     if (!var_name || !hw_ctx) return -1;
     
-    // Search through state variables
-    for (int i = 0; i < hw_ctx->state_count; i++) {
-        if (hw_ctx->states[i].name && strcmp(hw_ctx->states[i].name, var_name) == 0) {
-            return hw_ctx->states[i].state_number;
-        }
-    }
-    
-    return -1;  // Not a state variable
+    // Hash-indexed lookup; -1 if not a state variable
+    return get_state_number_by_name(hw_ctx, var_name);
 }
 
 
@@ -2295,75 +3349,39 @@ static void calculate_comma_expression_fields(Node* comma_expr, HardwareContext*
 
 // --- Automatic Switch Bits Calculation ---
 
-static void find_max_case_value(Node* node, int* max_case_value) {
-    if (!node) return;
-    
-    switch (node->type) {
-        case NODE_SWITCH: {
-            SwitchNode* switch_node = (SwitchNode*)node;
-            if (switch_node->cases) {
-                for (int i = 0; i < switch_node->cases->count; i++) {
-                    CaseNode* case_node = (CaseNode*)switch_node->cases->items[i];
-                    if (case_node->value && case_node->value->type == NODE_NUMBER_LITERAL) {
-                        NumberLiteralNode* num = (NumberLiteralNode*)case_node->value;
-                        int case_value = atoi(num->value);
-                        if (case_value > *max_case_value) {
-                            *max_case_value = case_value;
-                        }
-                    }
-                    // Recursively check nested switches in case body
-                    // case_node->body is a NodeList, need to iterate through it
-                    if (case_node->body) {
-                        for (int j = 0; j < case_node->body->count; j++) {
-                            find_max_case_value(case_node->body->items[j], max_case_value);
-                        }
-                    }
-                }
-            }
-            break;
-        }
-        
-        case NODE_BLOCK: {
-            BlockNode* block = (BlockNode*)node;
-            if (block->statements) {
-                for (int i = 0; i < block->statements->count; i++) {
-                    find_max_case_value(block->statements->items[i], max_case_value);
-                }
-            }
-            break;
-        }
-        
-        case NODE_FUNCTION_DEF: {
-            FunctionDefNode* func = (FunctionDefNode*)node;
-            if (func->body) {
-                find_max_case_value(func->body, max_case_value);
-            }
-            break;
-        }
-        
-        case NODE_PROGRAM: {
-            ProgramNode* program = (ProgramNode*)node;
-            if (program->functions) {
-                for (int i = 0; i < program->functions->count; i++) {
-                    find_max_case_value(program->functions->items[i], max_case_value);
+// The hardware forms the switch memory address as {jadr, switch_offset}, so
+// every switch gets a block of the same power-of-two size and the width has
+// to cover the largest case value in the program. Only main is emitted, so
+// switches in other functions do not count.
+int calculate_required_switch_bits(Node* ast_root) {
+    int max_case_value = 0;
+    int switch_count = 0;
+    const AstAnalysis* analysis = analyze_ast(ast_root, NULL);
+    FunctionDefNode* main_func = find_main_function(ast_root);
+    const NodeAttributes* root = node_attributes(analysis, main_func ? (Node*)main_func : ast_root);
+    if (root) {
+        max_case_value = root->max_case_value;
+        switch_count = root->switch_count;
+    }
+    if (main_func) {
+        // Helpers main calls and interrupt handlers are compiled too
+        CompactMicrocode called = {0};
+        find_called_subroutines(&called, ast_root, main_func);
+        for (int i = 0; i < called.subroutine_count; i++) {
+            const NodeAttributes* body = called.subroutines[i].call_sites > 0 || called.subroutines[i].handler
+                ? node_attributes(analysis, called.subroutines[i].func->body) : NULL;
+            if (body) {
+                switch_count += body->switch_count;
+                if (body->max_case_value > max_case_value) {
+                    max_case_value = body->max_case_value;
                 }
             }
-            break;
         }
-        
-        default:
-            // For other node types, check if they have children that might contain switches
-            // This is a generic approach - specific node types would be more efficient
-            break;
+        free(called.subroutines);
     }
-}
-
-int calculate_required_switch_bits(Node* ast_root) {
-    int max_case_value = 0;
-    find_max_case_value(ast_root, &max_case_value);
     
-    if (max_case_value == 0) {
-        return DEFAULT_SWITCH_OFFSET_BITS; // No switches or only case 0
+    if (switch_count == 0) {
+        return DEFAULT_SWITCH_OFFSET_BITS; // No switches: width is unused
     }
     
     // Calculate minimum bits needed to represent max_case_value
@@ -2381,3 +3399,20 @@ int calculate_required_switch_bits(Node* ast_root) {
     
     return required_bits;
 }
+
+int calculate_required_stack_depth(Node* ast_root, bool* recursive) {
+    bool found_recursion = false;
+    int depth = 0;
+    FunctionDefNode* main_func = find_main_function(ast_root);
+    if (main_func) {
+        CompactMicrocode called = {0};
+        called.analysis = analyze_ast(ast_root, NULL);
+        collect_subroutines(&called, ast_root, main_func);
+        depth = subroutine_stack_depth(&called, main_func, &found_recursion);
+        free(called.subroutines);
+    }
+    if (recursive) {
+        *recursive = found_recursion;
+    }
+    return depth;
+}
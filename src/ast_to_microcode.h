@@ -2,14 +2,15 @@
 #define AST_TO_MICROCODE_H
 
 #include "ast.h"
+#include "ast_analysis.h"
 #include "microcode_defs.h"
 #include "hw_analyzer.h"
 #include "expression_evaluator.h" // Include for SimulatedExpression
+#include "logic_minimizer.h"
 #include <stdio.h>
 #include <stdint.h>
 
 // Constants for switch break resolution
-#define MAX_PENDING_SWITCH_BREAKS 64
 #define SWITCH_BREAK_PLACEHOLDER -1
 
 typedef enum {
@@ -20,22 +21,28 @@ typedef enum {
 // Structure for tracking switch breaks that need address resolution
 typedef struct {
     int instruction_index;      // Index in mc->instructions where the break instruction is
-    int switch_start_addr;     // Address of the SWITCH instruction this break belongs to
+    int switch_id;              // Switch this break leaves; indexes mc->switch_infos
 } PendingSwitchBreak;
 
-// Enhanced structure for tracking switch information
+// Enhanced structure for tracking switch information, one per switch ID
 typedef struct {
     int switch_start_addr;     // Address of the SWITCH instruction
-    int switch_end_addr;       // Actual end address (determined after processing)
+    int switch_end_addr;       // Where breaks land, after the closing "}}"; -1 until emitted
     int context_stack_index;   // Index in the loop_switch_stack
     int first_break_index;     // Index of first break belonging to this switch
     int break_count;           // Number of breaks belonging to this switch
 } SwitchInfo;
 
+// Label id for a context or jump that targets a fixed address instead
+#define NO_LABEL -1
+
 typedef struct {
     NodeType loop_type;  // e.g., NODE_WHILE, NODE_FOR, NODE_SWITCH
     int continue_target; // Microcode address for 'continue' statements
     int break_target;    // Microcode address for 'break' statements
+    int continue_label;  // When not NO_LABEL, 'continue' jumps here instead
+    int break_label;     // When not NO_LABEL, 'break' jumps here instead
+    int switch_id;       // For NODE_SWITCH, indexes mc->switch_infos; -1 otherwise
 } LoopSwitchContext;
 
 // Proposed PendingJump structure
@@ -43,17 +50,74 @@ typedef enum {
     JUMP_TYPE_BREAK,
     JUMP_TYPE_CONTINUE,
     JUMP_TYPE_EXIT,
-    JUMP_TYPE_DIRECT // For direct address jumps not tied to a context (e.g., if/else branches)
+    JUMP_TYPE_DIRECT, // For direct address jumps not tied to a context
+    JUMP_TYPE_LABEL   // Target is a label bound later (e.g., if/else branches)
 } JumpType;
 
 typedef struct {
     int instruction_index;              // Index in mc->instructions where the MCode is
     int target_instruction_address;     // The symbolic target address (e.g., loop start, exit)
     bool is_exit_jump;                  // True if this jump should target the global :exit
+    int label_id;                       // Label to resolve against, NO_LABEL for a fixed address
     JumpType jump_type;                 // Type of jump (break, continue, exit)
     int direct_address;                 // Used for JUMP_TYPE_DIRECT, stores the absolute address
 } PendingJump;
 
+// A parameterless helper function that main reaches through call statements.
+// Each call either gets its own copy of the body (inlined) or, when that
+// would cost more ROM than a shared copy, becomes a call word into one body
+// emitted after :exit that ends in a return word.
+typedef struct {
+    FunctionDefNode* func;  // NULL for program items that cannot be called this way
+    int call_sites;         // Call statements in main and the helpers it reaches
+    int size_estimate;      // Words in one copy of the body, estimated from the AST
+    bool outlined;          // Shared body entered by call words
+    bool emitted;           // The shared body has been generated
+    bool expanding;         // Being inlined; a call back into it has to be a real call
+    bool handler;           // An interrupt handler, entered through the interrupt vector
+    int entry_label;        // Bound to the shared body's first word, NO_LABEL until called
+    int stack_depth;        // Return addresses a run of the body stacks; -1 until computed
+    bool profiled;          // --profile-use counted some call site
+    uint64_t profiled_calls;  // Calls the profiled run made, over the counted sites
+} Subroutine;
+
+// A parameterless function whose name starts with this is an interrupt
+// handler. IP/control.sv fires on a rising edge of the interrupt input:
+// the next edge jumps to interrupt_address and pushes the current address
+// plus one, so the word the interrupt is taken on captures its states but
+// loses its jump, and the handler's return word resumes after it.
+#define INTERRUPT_HANDLER_PREFIX "isr_"
+
+// A handler's entry address, for the interrupt_address input
+typedef struct {
+    char* name;
+    int address;
+} InterruptVector;
+
+// Where a shared helper body was placed, for a later --stable-layout build
+typedef struct {
+    char* name;
+    int address;
+    int words;  // With its return word
+} SubroutineBody;
+
+// mc->return_label in a shared body: 'return' is a return word
+#define RETURN_TO_CALLER -2
+
+// STACK_DEPTH for a program with recursive calls, whose nesting has no
+// static bound; HotstateModel fails on a call made with the stack full
+#define RECURSIVE_STACK_DEPTH 16
+
+// A multi-way branch as the source wrote it, priced by the dispatch cost
+// report (--dispatch-report): a switch, or an if/else-if ladder of two or
+// more tests
+typedef struct {
+    bool is_switch;
+    char* label;       // "switch (x)", or the ladder's first "if (...)"
+    int arms;          // Cases or tests, not counting default or a final else
+    bool has_default;  // A default case or a final else
+} DispatchSite;
+
 // Structure to hold information about a conditional expression that depends on input variables
 typedef struct {
     Node* expression_node; // Pointer to the AST node for the conditional expression
@@ -62,9 +126,52 @@ typedef struct {
     struct SimulatedExpression* sim_expr; // Forward declaration
 } ConditionalExpressionInfo;
 
+// Products a condition may take in logic before --varsel-logic leaves it
+// in the vardata ROM
+#define VARSEL_LOGIC_MAX_TERMS 8
+
+// A condition decided by combinational logic instead of the vardata ROM
+// (--varsel-logic): the sum of its products
+typedef struct {
+    ProductTerm terms[VARSEL_LOGIC_MAX_TERMS];
+    int term_count;
+} VarselLogic;
+
+// One shared block of vardata, the table of a distinct condition over every
+// input. It is kept as the condition's support-reduced table or BDD and
+// expanded only when vardata is written (vardata_block), so the LUT as a
+// whole is never in memory.
+typedef struct {
+    const struct SimulatedExpression* expr;  // Table to expand; NULL for all zeros
+    BddRef bdd;                              // Or the BDD to expand (--bdd); -1 if none
+} VardataBlock;
+
+// What an instruction's debug label is built from. Nothing is formatted
+// while generating; compact_word_label builds the text when a listing asks.
+typedef enum {
+    WORD_LABEL_NONE,       // No label
+    WORD_LABEL_TEXT,       // format, as it is
+    WORD_LABEL_NAME,       // format with name for its %s
+    WORD_LABEL_CONDITION,  // format with the condition in node for its %s
+    WORD_LABEL_SOURCE,     // The expression in node, as source
+    WORD_LABEL_ASSIGN      // "name=value;"
+} WordLabelKind;
+
+typedef struct {
+    WordLabelKind kind;
+    const char* format;  // A string literal
+    const char* name;    // Owned by the AST, which outlives the listing
+    const Node* node;
+    int value;
+    int fused;           // Label of a word fused onto the end of this one, indexing mc->fused_labels; -1 if none
+    const Node* statement;  // The outermost statement this word starts (--profile-use); NULL if none
+} WordLabel;
+
 // Structure to represent a simulated expression for building the Uber LUT
 typedef struct {
     Code* instructions; // Array of new Code structs
+    WordLabel* word_labels; // What each instruction's label is built from, alongside instructions
+    char** labels;      // The built labels (or NULL), once compact_word_label has been asked; NULL until then
     int instruction_count;
     int instruction_capacity;  // what is this for?
     char* function_name;
@@ -79,6 +186,12 @@ typedef struct {
     int switch_count;          // Number of switches processed
     int switch_offset_bits;    // Bits per switch (default 8)
     int timer_count;
+
+    // Timer memory (timdata): the counts delays load, by the jadr of their
+    // load words
+    uint32_t* timdata;
+    int timdata_count;
+    int timdata_capacity;
     
     // Address management
     int exit_address;          // Calculated exit address for while loops
@@ -93,8 +206,19 @@ typedef struct {
     int conditional_expression_count;
     int conditional_expression_capacity;
 
-    uint8_t* vardata_lut;
+    // vardata: var_sel_counter blocks of 1 << vardata_inputs entries each,
+    // vardata_lut_size entries in all; none without complex conditions
+    VardataBlock* vardata_blocks;
+    int vardata_inputs;
     int vardata_lut_size;
+    // With --varsel-logic, varsels from varsel_rom_blocks up are decided by
+    // varsel_logic[varsel - varsel_rom_blocks]; vardata still holds their
+    // blocks, for the simulator, but the ROM is built without them
+    int varsel_rom_blocks;
+    VarselLogic* varsel_logic;
+    int varsel_logic_count;
+    BddManager* bdd_mgr;       // Set when conditions are evaluated as BDDs (--bdd)
+    SimulatedExpressionTable* sim_exprs; // Owns every sim_expr, and the tables vardata_blocks expand
 
     uint32_t max_jadr_val;
     uint32_t max_varsel_val;
@@ -117,22 +241,96 @@ typedef struct {
     PendingJump* pending_jumps;
     int pending_jump_count;
     int pending_jump_capacity;
+
+    // Label addresses for forward jumps, -1 until bound
+    int* label_addresses;
+    int label_count;
+    int label_capacity;
     
     // Pending switch break resolution
     PendingSwitchBreak* pending_switch_breaks;
     int pending_switch_break_count;
+    int pending_switch_break_capacity;
     
-    // Switch info tracking
+    // Switch info tracking, indexed by switch ID; switchmem grows with it
     SwitchInfo* switch_infos;
     int switch_info_count;
     int switch_info_capacity;
+
+    // Helper functions, indexed like the program's items
+    Subroutine* subroutines;
+    int subroutine_count;
+    int return_label;  // Where 'return' jumps in the body being generated; NO_LABEL in main
+    int stack_depth;   // Return stack entries the deepest call nesting needs (STACK_DEPTH)
+
+    // Interrupt handlers, in program order; the first is the default vector
+    InterruptVector* interrupt_vectors;
+    int interrupt_vector_count;
+
+    // Shared helper bodies, in address order
+    SubroutineBody* subroutine_bodies;
+    int subroutine_body_count;
+
+    bool pipelined;    // Delay slots follow every word that can jump (PIPELINED)
+
+    // Conditions built by fuse_conditions; only the nodes themselves are
+    // owned, their operands belong to the AST
+    Node** fused_conditions;
+    int fused_condition_count;
+    int fused_condition_capacity;
+
+    // Switches and else-if ladders, in emission order
+    DispatchSite* dispatch_sites;
+    int dispatch_site_count;
+    int dispatch_site_capacity;
+    Node* ladder_link;  // The else-if being emitted as part of a recorded ladder
+    WordLabel* fused_labels;  // Labels of words compact_fused_words fused away
+    int fused_label_count;
+    int fused_label_capacity;
+    const AstAnalysis* analysis;  // Attributes of the AST being compiled; NULL once it is done
 } CompactMicrocode;
 
+// Evaluate conditional expressions as ROBDDs instead of flat truth tables
+extern int use_bdd_conditions;
+
+// Fuse state assignments with the jump or disjoint assignment after them
+extern int compact_microcode_words;
+
+// Follow every word that can jump with an empty delay slot word, for
+// hotstate.sv's PIPELINED fetch (--pipeline)
+extern int pipeline_delay_slots;
+
+// Helper bodies of at most this many words are inlined at every call
+extern int inline_call_words;
+
+// Test nested input-only ifs with one combined varsel lookup
+extern int fuse_conditions;
+
+// Decide conditions whose truth tables minimize to at most
+// VARSEL_LOGIC_MAX_TERMS products in combinational logic, written to
+// <base>_varsel_logic.v, and keep only the rest in the vardata ROM
+// (--varsel-logic)
+extern int use_varsel_logic;
+
+// Drop repeated instruction tails for a jump to their first copy:
+// MERGE_TAILS_SPEED (--merge-tails) only where no jump word is added,
+// MERGE_TAILS_SIZE (--merge-tails-size) also where one is, which saves ROM
+// at a cycle per pass through the merged tail
+#define MERGE_TAILS_SPEED 1
+#define MERGE_TAILS_SIZE 2
+extern int merge_common_tails;
+
 // Main generation function
 CompactMicrocode* ast_to_compact_microcode(Node* ast_root, HardwareContext* hw_ctx);
 
 // Output functions
+// The debug label of word index, or NULL. The labels of every word are
+// built on the first call, from the AST, which has to be alive then; they
+// are kept until the program is freed.
+const char* compact_word_label(CompactMicrocode* mc, int index);
 void print_compact_microcode_table(CompactMicrocode* mc, FILE* output);
+// Expands vardata block into dest, 1 << mc->vardata_inputs entries
+void vardata_block(const CompactMicrocode* mc, int block, uint8_t* dest);
 void print_compact_microcode_analysis(CompactMicrocode* mc, FILE* output);
 //void print_hotstate_microcode_table(HotstateMicrocode* mc, FILE* output); // Moved from cfg_to_microcode.h
 
@@ -142,4 +340,8 @@ void free_compact_microcode(CompactMicrocode* mc);
 // Automatic switch bits calculation
 int calculate_required_switch_bits(Node* ast_root);
 
+// Return stack entries the program's deepest nesting of call words needs;
+// RECURSIVE_STACK_DEPTH, with *recursive set, when a helper calls itself
+int calculate_required_stack_depth(Node* ast_root, bool* recursive);
+
 #endif // AST_TO_MICROCODE_H
\ No newline at end of file
@@ -0,0 +1,251 @@
+#include "bdd.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#define BDD_INITIAL_NODES 256
+#define BDD_CACHE_SIZE (1 << 14)
+
+static void* bdd_xalloc(size_t size) {
+    void* ptr = malloc(size);
+    if (!ptr) {
+        fprintf(stderr, "Error: BDD out of memory (requested %zu bytes)\n", size);
+        exit(EXIT_FAILURE);
+    }
+    return ptr;
+}
+
+static uint32_t hash_node(int var, BddRef low, BddRef high) {
+    uint32_t hash = (uint32_t)var * 0x9E3779B1u;
+    hash ^= (uint32_t)low * 0x85EBCA77u + (hash << 6) + (hash >> 2);
+    hash ^= (uint32_t)high * 0xC2B2AE3Du + (hash << 6) + (hash >> 2);
+    return hash;
+}
+
+static void rehash_unique(BddManager* mgr, uint32_t new_slot_count) {
+    free(mgr->unique);
+    mgr->unique = calloc(new_slot_count, sizeof(int));
+    if (!mgr->unique) {
+        fprintf(stderr, "Error: Failed to allocate BDD unique table\n");
+        exit(EXIT_FAILURE);
+    }
+    mgr->unique_mask = new_slot_count - 1;
+
+    for (int id = 2; id < mgr->node_count; id++) {
+        BddNode* n = &mgr->nodes[id];
+        uint32_t i = hash_node(n->var, n->low, n->high) & mgr->unique_mask;
+        while (mgr->unique[i] != 0) {
+            i = (i + 1) & mgr->unique_mask;
+        }
+        mgr->unique[i] = id + 1;
+    }
+}
+
+// Return the unique node (var, low, high), applying the reduction rule
+static BddRef make_node(BddManager* mgr, int var, BddRef low, BddRef high) {
+    if (low == high) return low;
+
+    uint32_t i = hash_node(var, low, high) & mgr->unique_mask;
+    while (mgr->unique[i] != 0) {
+        BddNode* n = &mgr->nodes[mgr->unique[i] - 1];
+        if (n->var == var && n->low == low && n->high == high) {
+            return mgr->unique[i] - 1;
+        }
+        i = (i + 1) & mgr->unique_mask;
+    }
+
+    if (mgr->node_count >= mgr->node_capacity) {
+        mgr->node_capacity *= 2;
+        mgr->nodes = realloc(mgr->nodes, sizeof(BddNode) * mgr->node_capacity);
+        if (!mgr->nodes) {
+            fprintf(stderr, "Error: Failed to grow BDD node table\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    BddRef id = mgr->node_count++;
+    mgr->nodes[id].var = var;
+    mgr->nodes[id].low = low;
+    mgr->nodes[id].high = high;
+    mgr->unique[i] = id + 1;
+
+    // Keep the load factor under one half
+    if ((uint32_t)mgr->node_count * 2 > mgr->unique_mask + 1) {
+        rehash_unique(mgr, (mgr->unique_mask + 1) * 2);
+    }
+    return id;
+}
+
+// --- Manager ---
+
+BddManager* bdd_create(void) {
+    BddManager* mgr = bdd_xalloc(sizeof(BddManager));
+    mgr->node_capacity = BDD_INITIAL_NODES;
+    mgr->nodes = bdd_xalloc(sizeof(BddNode) * mgr->node_capacity);
+    mgr->node_count = 2;
+    for (int t = 0; t < 2; t++) {
+        mgr->nodes[t].var = BDD_TERMINAL_VAR;
+        mgr->nodes[t].low = t;
+        mgr->nodes[t].high = t;
+    }
+
+    mgr->unique = NULL;
+    rehash_unique(mgr, BDD_INITIAL_NODES * 2);
+
+    mgr->cache = bdd_xalloc(sizeof(BddCacheEntry) * BDD_CACHE_SIZE);
+    mgr->cache_mask = BDD_CACHE_SIZE - 1;
+    for (int i = 0; i < BDD_CACHE_SIZE; i++) {
+        mgr->cache[i].result = -1;
+    }
+    return mgr;
+}
+
+void bdd_destroy(BddManager* mgr) {
+    if (!mgr) return;
+    free(mgr->nodes);
+    free(mgr->unique);
+    free(mgr->cache);
+    free(mgr);
+}
+
+// --- Construction ---
+
+BddRef bdd_var(BddManager* mgr, int var) {
+    return make_node(mgr, var, BDD_FALSE, BDD_TRUE);
+}
+
+BddRef bdd_not(BddManager* mgr, BddRef f) {
+    return bdd_apply(mgr, BDD_OP_XOR, f, BDD_TRUE);
+}
+
+BddRef bdd_apply(BddManager* mgr, BddOp op, BddRef a, BddRef b) {
+    // Terminal cases
+    switch (op) {
+        case BDD_OP_AND:
+            if (a == BDD_FALSE || b == BDD_FALSE) return BDD_FALSE;
+            if (a == BDD_TRUE) return b;
+            if (b == BDD_TRUE || a == b) return a;
+            break;
+        case BDD_OP_OR:
+            if (a == BDD_TRUE || b == BDD_TRUE) return BDD_TRUE;
+            if (a == BDD_FALSE) return b;
+            if (b == BDD_FALSE || a == b) return a;
+            break;
+        case BDD_OP_XOR:
+            if (a == b) return BDD_FALSE;
+            if (a == BDD_FALSE) return b;
+            if (b == BDD_FALSE) return a;
+            break;
+    }
+
+    // All three operators commute; order operands for better cache hits
+    if (a > b) {
+        BddRef tmp = a;
+        a = b;
+        b = tmp;
+    }
+
+    uint32_t slot = (hash_node((int)op, a, b)) & mgr->cache_mask;
+    BddCacheEntry* entry = &mgr->cache[slot];
+    if (entry->result >= 0 && entry->op == op && entry->a == a && entry->b == b) {
+        return entry->result;
+    }
+
+    // Shannon expansion on the topmost variable of either operand
+    int var_a = mgr->nodes[a].var;
+    int var_b = mgr->nodes[b].var;
+    int top = var_a > var_b ? var_a : var_b;
+    BddRef a_low = var_a == top ? mgr->nodes[a].low : a;
+    BddRef a_high = var_a == top ? mgr->nodes[a].high : a;
+    BddRef b_low = var_b == top ? mgr->nodes[b].low : b;
+    BddRef b_high = var_b == top ? mgr->nodes[b].high : b;
+
+    BddRef low = bdd_apply(mgr, op, a_low, b_low);
+    BddRef high = bdd_apply(mgr, op, a_high, b_high);
+    BddRef result = make_node(mgr, top, low, high);
+
+    // The recursion may have reused this slot; the newest result wins
+    entry->op = op;
+    entry->a = a;
+    entry->b = b;
+    entry->result = result;
+    return result;
+}
+
+// --- Queries ---
+
+int bdd_is_constant(BddRef f) {
+    return f == BDD_FALSE || f == BDD_TRUE;
+}
+
+int bdd_eval(const BddManager* mgr, BddRef f, uint32_t inputs) {
+    while (!bdd_is_constant(f)) {
+        const BddNode* n = &mgr->nodes[f];
+        f = ((inputs >> n->var) & 1) ? n->high : n->low;
+    }
+    return f == BDD_TRUE;
+}
+
+static void mark_reachable(const BddManager* mgr, BddRef f, uint8_t* visited, uint32_t* support, int* size) {
+    if (bdd_is_constant(f) || visited[f]) return;
+    visited[f] = 1;
+    (*size)++;
+    *support |= 1u << mgr->nodes[f].var;
+    mark_reachable(mgr, mgr->nodes[f].low, visited, support, size);
+    mark_reachable(mgr, mgr->nodes[f].high, visited, support, size);
+}
+
+static void walk_reachable(const BddManager* mgr, BddRef f, uint32_t* support, int* size) {
+    uint8_t* visited = calloc(mgr->node_count, sizeof(uint8_t));
+    if (!visited) {
+        fprintf(stderr, "Error: Failed to allocate BDD traversal state\n");
+        exit(EXIT_FAILURE);
+    }
+    *support = 0;
+    *size = 0;
+    mark_reachable(mgr, f, visited, support, size);
+    free(visited);
+}
+
+uint32_t bdd_support(const BddManager* mgr, BddRef f) {
+    uint32_t support;
+    int size;
+    walk_reachable(mgr, f, &support, &size);
+    return support;
+}
+
+int bdd_size(const BddManager* mgr, BddRef f) {
+    uint32_t support;
+    int size;
+    walk_reachable(mgr, f, &support, &size);
+    return size;
+}
+
+// Fill the 2^num_vars entries of dest whose inputs >= num_vars match the
+// path taken so far; inputs below num_vars are still undecided
+static void fill_lut(const BddManager* mgr, BddRef f, uint8_t* dest, int num_vars) {
+    if (bdd_is_constant(f)) {
+        memset(dest, f == BDD_TRUE, (size_t)1 << num_vars);
+        return;
+    }
+
+    int var = num_vars - 1;
+    size_t half = (size_t)1 << var;
+    const BddNode* n = &mgr->nodes[f];
+    if (n->var == var) {
+        fill_lut(mgr, n->low, dest, var);
+        fill_lut(mgr, n->high, dest + half, var);
+    } else {
+        // f does not test this input: both halves are the same table
+        fill_lut(mgr, f, dest, var);
+        memcpy(dest + half, dest, half);
+    }
+}
+
+void bdd_to_lut(const BddManager* mgr, BddRef f, uint8_t* dest, int num_vars) {
+    // Inputs at or above num_vars are treated as 0
+    while (!bdd_is_constant(f) && mgr->nodes[f].var >= num_vars) {
+        f = mgr->nodes[f].low;
+    }
+    fill_lut(mgr, f, dest, num_vars);
+}
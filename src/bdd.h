@@ -0,0 +1,70 @@
+#ifndef BDD_H
+#define BDD_H
+
+#include <stdint.h>
+
+// Reduced ordered binary decision diagrams for conditional expressions.
+// Nodes are hash-consed in a unique table, so two expressions compute the
+// same function exactly when they reduce to the same BddRef. Variables are
+// input numbers, ordered with the highest input nearest the root so that a
+// path ending early covers a contiguous range of the input-indexed LUT.
+
+typedef int BddRef;
+
+#define BDD_FALSE 0
+#define BDD_TRUE  1
+
+typedef enum {
+    BDD_OP_AND,
+    BDD_OP_OR,
+    BDD_OP_XOR
+} BddOp;
+
+typedef struct {
+    int var;        // Input number; BDD_TERMINAL_VAR for the two terminals
+    BddRef low;     // Cofactor with var = 0
+    BddRef high;    // Cofactor with var = 1
+} BddNode;
+
+#define BDD_TERMINAL_VAR (-1)
+
+typedef struct {
+    BddOp op;
+    BddRef a;
+    BddRef b;
+    BddRef result;  // -1 when the entry is empty
+} BddCacheEntry;
+
+typedef struct {
+    BddNode* nodes;
+    int node_count;
+    int node_capacity;
+
+    int* unique;            // Open-addressing table of node index + 1
+    uint32_t unique_mask;   // slot count - 1 (power of two)
+
+    BddCacheEntry* cache;   // Direct-mapped apply cache
+    uint32_t cache_mask;
+} BddManager;
+
+// --- Manager ---
+BddManager* bdd_create(void);
+void bdd_destroy(BddManager* mgr);
+
+// --- Construction ---
+BddRef bdd_var(BddManager* mgr, int var);
+BddRef bdd_not(BddManager* mgr, BddRef f);
+BddRef bdd_apply(BddManager* mgr, BddOp op, BddRef a, BddRef b);
+
+// --- Queries ---
+int bdd_is_constant(BddRef f);
+int bdd_eval(const BddManager* mgr, BddRef f, uint32_t inputs);
+uint32_t bdd_support(const BddManager* mgr, BddRef f);
+int bdd_size(const BddManager* mgr, BddRef f);   // Internal nodes reachable from f
+
+// Write the truth table of f over inputs 0..num_vars-1 into dest (2^num_vars
+// entries). Only paths of the diagram are walked; entries for skipped
+// variables are filled as whole ranges.
+void bdd_to_lut(const BddManager* mgr, BddRef f, uint8_t* dest, int num_vars);
+
+#endif // BDD_H
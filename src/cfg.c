@@ -4,6 +4,9 @@
 #include <string.h>
 #include <stdio.h>
 
+// Values of one function fit a small chunk; large functions add more
+#define CFG_ARENA_CHUNK_SIZE (16 * 1024)
+
 // --- CFG Creation Functions ---
 
 CFG* create_cfg(const char* function_name) {
@@ -16,7 +19,12 @@ CFG* create_cfg(const char* function_name) {
     cfg->block_count = 0;
     cfg->block_capacity = 0;
     cfg->next_block_id = 0;
+    cfg->visit_epoch = 0;
     cfg->function_name = function_name ? strdup(function_name) : NULL;
+    cfg->arena = arena_create(CFG_ARENA_CHUNK_SIZE);
+    cfg->values = NULL;
+    cfg->value_count = 0;
+    cfg->value_capacity = 0;
     cfg->current_loop_header = NULL;
     cfg->current_loop_exit = NULL;
     
@@ -45,7 +53,7 @@ BasicBlock* create_basic_block(CFG* cfg, const char* label) {
     block->dom_frontier_capacity = 0;
     
     // For CFG construction
-    block->visited = false;
+    block->visit_mark = 0;
     block->post_order_num = -1;
     
     // Add to CFG
@@ -118,6 +126,19 @@ void remove_edge(BasicBlock* from, BasicBlock* to) {
             break;
         }
     }
+    
+    // Once no edge from 'from' remains, its phi operands in 'to' are stale
+    for (int i = 0; i < to->predecessor_count; i++) {
+        if (to->predecessors[i] == from) return;
+    }
+    for (int i = 0; to->phi_nodes && i < to->phi_nodes->count; i++) {
+        PhiNode* phi = to->phi_nodes->items[i];
+        for (int j = phi->operand_count - 1; j >= 0; j--) {
+            if (phi->operands[j].block == from) {
+                remove_phi_operand(phi, j);
+            }
+        }
+    }
 }
 
 void free_cfg(CFG* cfg) {
@@ -134,6 +155,14 @@ void free_cfg(CFG* cfg) {
         free(cfg->function_name);
     }
     
+    // The values themselves go with the arena; only their use lists grow
+    // on the heap
+    for (int i = 0; i < cfg->value_count; i++) {
+        free(cfg->values[i]->uses);
+    }
+    free(cfg->values);
+    arena_destroy(cfg->arena);
+    
     free(cfg);
 }
 
@@ -159,62 +188,159 @@ void free_basic_block(BasicBlock* block) {
     free(block);
 }
 
+// --- Frozen Layout ---
+
+FrozenCFG* freeze_cfg(CFG* cfg) {
+    if (!cfg) return NULL;
+    
+    FrozenCFG* frozen = (FrozenCFG*)calloc(1, sizeof(FrozenCFG));
+    if (!frozen) return NULL;
+    
+    int n = cfg->block_count;
+    int succ_total = 0, pred_total = 0, instr_total = 0;
+    for (int i = 0; i < n; i++) {
+        succ_total += cfg->blocks[i]->successor_count;
+        pred_total += cfg->blocks[i]->predecessor_count;
+        instr_total += cfg->blocks[i]->instructions->count;
+    }
+    
+    frozen->cfg = cfg;
+    frozen->block_count = n;
+    frozen->id_count = cfg->next_block_id;
+    frozen->blocks = (BasicBlock**)malloc((n + 1) * sizeof(BasicBlock*));
+    frozen->index_of_id = (int*)malloc((frozen->id_count + 1) * sizeof(int));
+    frozen->succ_offsets = (int*)malloc((n + 1) * sizeof(int));
+    frozen->succs = (int*)malloc((succ_total + 1) * sizeof(int));
+    frozen->pred_offsets = (int*)malloc((n + 1) * sizeof(int));
+    frozen->preds = (int*)malloc((pred_total + 1) * sizeof(int));
+    frozen->instr_offsets = (int*)malloc((n + 1) * sizeof(int));
+    frozen->instrs = (SSAInstruction**)malloc((instr_total + 1) * sizeof(SSAInstruction*));
+    if (!frozen->blocks || !frozen->index_of_id || !frozen->succ_offsets || !frozen->succs ||
+        !frozen->pred_offsets || !frozen->preds || !frozen->instr_offsets || !frozen->instrs) {
+        free_frozen_cfg(frozen);
+        return NULL;
+    }
+    
+    for (int i = 0; i < frozen->id_count; i++) {
+        frozen->index_of_id[i] = -1;
+    }
+    for (int i = 0; i < n; i++) {
+        frozen->blocks[i] = cfg->blocks[i];
+        frozen->index_of_id[cfg->blocks[i]->id] = i;
+    }
+    frozen->entry = cfg->entry ? frozen->index_of_id[cfg->entry->id] : -1;
+    frozen->exit = cfg->exit ? frozen->index_of_id[cfg->exit->id] : -1;
+    
+    // Edges to blocks no longer in the CFG are dropped
+    int succ_at = 0, pred_at = 0, instr_at = 0;
+    for (int i = 0; i < n; i++) {
+        BasicBlock* block = cfg->blocks[i];
+        frozen->succ_offsets[i] = succ_at;
+        for (int j = 0; j < block->successor_count; j++) {
+            int index = frozen->index_of_id[block->successors[j]->id];
+            if (index >= 0) frozen->succs[succ_at++] = index;
+        }
+        frozen->pred_offsets[i] = pred_at;
+        for (int j = 0; j < block->predecessor_count; j++) {
+            int index = frozen->index_of_id[block->predecessors[j]->id];
+            if (index >= 0) frozen->preds[pred_at++] = index;
+        }
+        frozen->instr_offsets[i] = instr_at;
+        for (int j = 0; j < block->instructions->count; j++) {
+            frozen->instrs[instr_at++] = block->instructions->items[j];
+        }
+    }
+    frozen->succ_offsets[n] = succ_at;
+    frozen->pred_offsets[n] = pred_at;
+    frozen->instr_offsets[n] = instr_at;
+    
+    return frozen;
+}
+
+void free_frozen_cfg(FrozenCFG* frozen) {
+    if (!frozen) return;
+    
+    free(frozen->blocks);
+    free(frozen->index_of_id);
+    free(frozen->succ_offsets);
+    free(frozen->succs);
+    free(frozen->pred_offsets);
+    free(frozen->preds);
+    free(frozen->instr_offsets);
+    free(frozen->instrs);
+    free(frozen);
+}
+
 // --- SSA Value Creation ---
 
-SSAValue* create_ssa_var(const char* base_name, int version) {
-    SSAValue* value = (SSAValue*)malloc(sizeof(SSAValue));
+// A zeroed value of type in cfg's arena, given the next id
+static SSAValue* new_ssa_value(CFG* cfg, int type) {
+    if (!cfg) return NULL;
+    if (cfg->value_count >= cfg->value_capacity) {
+        int new_capacity = cfg->value_capacity == 0 ? 64 : cfg->value_capacity * 2;
+        SSAValue** new_values = (SSAValue**)realloc(cfg->values, new_capacity * sizeof(SSAValue*));
+        if (!new_values) return NULL;
+        cfg->values = new_values;
+        cfg->value_capacity = new_capacity;
+    }
+    
+    SSAValue* value = (SSAValue*)arena_alloc(cfg->arena, sizeof(SSAValue));
+    memset(value, 0, sizeof(SSAValue));
+    value->type = type;
+    value->id = cfg->value_count;
+    cfg->values[cfg->value_count++] = value;
+    return value;
+}
+
+int ssa_value_id_count(const CFG* cfg) {
+    return cfg ? cfg->value_count : 0;
+}
+
+SSAValue* create_ssa_var(CFG* cfg, SymbolId symbol, int version) {
+    SSAValue* value = new_ssa_value(cfg, SSA_VAR);
     if (!value) return NULL;
     
-    value->type = SSA_VAR;
-    value->data.var.base_name = strdup(base_name);
+    value->data.var.symbol = symbol;
     value->data.var.version = version;
     
     return value;
 }
 
-SSAValue* create_ssa_const(int const_value) {
-    SSAValue* value = (SSAValue*)malloc(sizeof(SSAValue));
+SSAValue* create_ssa_const(CFG* cfg, int const_value) {
+    SSAValue* value = new_ssa_value(cfg, SSA_CONST);
     if (!value) return NULL;
     
-    value->type = SSA_CONST;
     value->data.const_value = const_value;
     
     return value;
 }
 
-SSAValue* create_ssa_temp(int temp_id) {
-    SSAValue* value = (SSAValue*)malloc(sizeof(SSAValue));
+SSAValue* create_ssa_temp(CFG* cfg, int temp_id) {
+    SSAValue* value = new_ssa_value(cfg, SSA_TEMP);
     if (!value) return NULL;
     
-    value->type = SSA_TEMP;
     value->data.temp_id = temp_id;
     
     return value;
 }
 
-SSAValue* copy_ssa_value(SSAValue* value) {
+SSAValue* copy_ssa_value(CFG* cfg, SSAValue* value) {
     if (!value) return NULL;
     
     switch (value->type) {
         case SSA_VAR:
-            return create_ssa_var(value->data.var.base_name, value->data.var.version);
+            return create_ssa_var(cfg, value->data.var.symbol, value->data.var.version);
         case SSA_CONST:
-            return create_ssa_const(value->data.const_value);
+            return create_ssa_const(cfg, value->data.const_value);
         case SSA_TEMP:
-            return create_ssa_temp(value->data.temp_id);
+            return create_ssa_temp(cfg, value->data.temp_id);
         default:
             return NULL;
     }
 }
 
-void free_ssa_value(SSAValue* value) {
-    if (!value) return;
-    
-    if (value->type == SSA_VAR && value->data.var.base_name) {
-        free(value->data.var.base_name);
-    }
-    
-    free(value);
+const char* ssa_var_name(const SSAValue* value) {
+    return value && value->type == SSA_VAR ? symbol_name(value->data.var.symbol) : NULL;
 }
 
 char* ssa_value_to_string(SSAValue* value) {
@@ -225,7 +351,7 @@ char* ssa_value_to_string(SSAValue* value) {
     
     switch (value->type) {
         case SSA_VAR:
-            snprintf(result, 256, "%s_%d", value->data.var.base_name, value->data.var.version);
+            snprintf(result, 256, "%s_%d", ssa_var_name(value), value->data.var.version);
             break;
         case SSA_CONST:
             snprintf(result, 256, "%d", value->data.const_value);
@@ -244,12 +370,12 @@ char* ssa_value_to_string(SSAValue* value) {
 // --- SSA Instruction Creation ---
 
 SSAInstruction* create_ssa_assign(SSAValue* dest, SSAValue* src) {
-    SSAInstruction* inst = (SSAInstruction*)malloc(sizeof(SSAInstruction));
+    SSAInstruction* inst = (SSAInstruction*)calloc(1, sizeof(SSAInstruction));
     if (!inst) return NULL;
     
     inst->type = SSA_ASSIGN;
     inst->dest = dest;
-    inst->operands = (SSAValue**)malloc(sizeof(SSAValue*));
+    inst->operands = inst->inline_operands;
     inst->operands[0] = src;
     inst->operand_count = 1;
     
@@ -257,12 +383,12 @@ SSAInstruction* create_ssa_assign(SSAValue* dest, SSAValue* src) {
 }
 
 SSAInstruction* create_ssa_binary_op(SSAValue* dest, TokenType op, SSAValue* left, SSAValue* right) {
-    SSAInstruction* inst = (SSAInstruction*)malloc(sizeof(SSAInstruction));
+    SSAInstruction* inst = (SSAInstruction*)calloc(1, sizeof(SSAInstruction));
     if (!inst) return NULL;
     
     inst->type = SSA_BINARY_OP;
     inst->dest = dest;
-    inst->operands = (SSAValue**)malloc(2 * sizeof(SSAValue*));
+    inst->operands = inst->inline_operands;
     inst->operands[0] = left;
     inst->operands[1] = right;
     inst->operand_count = 2;
@@ -272,12 +398,12 @@ SSAInstruction* create_ssa_binary_op(SSAValue* dest, TokenType op, SSAValue* lef
 }
 
 SSAInstruction* create_ssa_unary_op(SSAValue* dest, TokenType op, SSAValue* operand) {
-    SSAInstruction* inst = (SSAInstruction*)malloc(sizeof(SSAInstruction));
+    SSAInstruction* inst = (SSAInstruction*)calloc(1, sizeof(SSAInstruction));
     if (!inst) return NULL;
     
     inst->type = SSA_UNARY_OP;
     inst->dest = dest;
-    inst->operands = (SSAValue**)malloc(sizeof(SSAValue*));
+    inst->operands = inst->inline_operands;
     inst->operands[0] = operand;
     inst->operand_count = 1;
     inst->data.op_data.op = op;
@@ -286,12 +412,13 @@ SSAInstruction* create_ssa_unary_op(SSAValue* dest, TokenType op, SSAValue* oper
 }
 
 SSAInstruction* create_ssa_call(SSAValue* dest, const char* func_name, SSAValue** args, int arg_count) {
-    SSAInstruction* inst = (SSAInstruction*)malloc(sizeof(SSAInstruction));
+    SSAInstruction* inst = (SSAInstruction*)calloc(1, sizeof(SSAInstruction));
     if (!inst) return NULL;
     
     inst->type = SSA_CALL;
     inst->dest = dest;
-    inst->operands = (SSAValue**)malloc(arg_count * sizeof(SSAValue*));
+    inst->operands = arg_count <= SSA_INLINE_OPERANDS ? inst->inline_operands
+                                                      : (SSAValue**)malloc(arg_count * sizeof(SSAValue*));
     for (int i = 0; i < arg_count; i++) {
         inst->operands[i] = args[i];
     }
@@ -302,13 +429,13 @@ SSAInstruction* create_ssa_call(SSAValue* dest, const char* func_name, SSAValue*
 }
 
 SSAInstruction* create_ssa_return(SSAValue* value) {
-    SSAInstruction* inst = (SSAInstruction*)malloc(sizeof(SSAInstruction));
+    SSAInstruction* inst = (SSAInstruction*)calloc(1, sizeof(SSAInstruction));
     if (!inst) return NULL;
     
     inst->type = SSA_RETURN;
     inst->dest = NULL;
     if (value) {
-        inst->operands = (SSAValue**)malloc(sizeof(SSAValue*));
+        inst->operands = inst->inline_operands;
         inst->operands[0] = value;
         inst->operand_count = 1;
         inst->data.return_data.value = value;
@@ -322,12 +449,12 @@ SSAInstruction* create_ssa_return(SSAValue* value) {
 }
 
 SSAInstruction* create_ssa_branch(SSAValue* condition, BasicBlock* true_target, BasicBlock* false_target) {
-    SSAInstruction* inst = (SSAInstruction*)malloc(sizeof(SSAInstruction));
+    SSAInstruction* inst = (SSAInstruction*)calloc(1, sizeof(SSAInstruction));
     if (!inst) return NULL;
     
     inst->type = SSA_BRANCH;
     inst->dest = NULL;
-    inst->operands = (SSAValue**)malloc(sizeof(SSAValue*));
+    inst->operands = inst->inline_operands;
     inst->operands[0] = condition;
     inst->operand_count = 1;
     inst->data.branch_data.condition = condition;
@@ -338,7 +465,7 @@ SSAInstruction* create_ssa_branch(SSAValue* condition, BasicBlock* true_target,
 }
 
 SSAInstruction* create_ssa_jump(BasicBlock* target) {
-    SSAInstruction* inst = (SSAInstruction*)malloc(sizeof(SSAInstruction));
+    SSAInstruction* inst = (SSAInstruction*)calloc(1, sizeof(SSAInstruction));
     if (!inst) return NULL;
     
     inst->type = SSA_JUMP;
@@ -353,8 +480,10 @@ SSAInstruction* create_ssa_jump(BasicBlock* target) {
 void free_ssa_instruction(SSAInstruction* inst) {
     if (!inst) return;
     
-    // Free operands array (but not the SSAValues themselves - they may be shared)
-    if (inst->operands) {
+    unlink_ssa_instruction(inst);
+    
+    // Free a long call's operands array (the SSAValues belong to the CFG)
+    if (inst->operands != inst->inline_operands) {
         free(inst->operands);
     }
     
@@ -368,10 +497,136 @@ void free_ssa_instruction(SSAInstruction* inst) {
     free(inst);
 }
 
+// --- Def-Use Links ---
+
+// Appends a use of value and returns its slot, -1 if it could not be recorded
+static int push_ssa_use(SSAValue* value, SSAInstruction* user, PhiNode* phi, int operand) {
+    if (!value) return -1;
+    if (value->use_count >= value->use_capacity) {
+        int new_capacity = value->use_capacity == 0 ? 4 : value->use_capacity * 2;
+        SSAUse* new_uses = (SSAUse*)realloc(value->uses, new_capacity * sizeof(SSAUse));
+        if (!new_uses) return -1;
+        value->uses = new_uses;
+        value->use_capacity = new_capacity;
+    }
+    value->uses[value->use_count].user = user;
+    value->uses[value->use_count].phi = phi;
+    value->uses[value->use_count].operand = operand;
+    return value->use_count++;
+}
+
+// Swaps the last use into the freed slot and repoints its owner
+static void drop_ssa_use(SSAValue* value, int slot) {
+    if (!value || slot < 0) return;
+    
+    SSAUse last = value->uses[--value->use_count];
+    if (slot < value->use_count) {
+        value->uses[slot] = last;
+        int* use_index = last.user ? last.user->use_index : last.phi->use_index;
+        use_index[last.operand] = slot;
+    }
+}
+
+static void add_ssa_use(SSAInstruction* inst, int index) {
+    inst->use_index[index] = push_ssa_use(inst->operands[index], inst, NULL, index);
+}
+
+static void remove_ssa_use(SSAInstruction* inst, int index) {
+    drop_ssa_use(inst->operands[index], inst->use_index[index]);
+    inst->use_index[index] = -1;
+}
+
+// Mirrors operands[0] into the type-specific field that also names it
+static void sync_operand_fields(SSAInstruction* inst) {
+    SSAValue* first = inst->operand_count > 0 ? inst->operands[0] : NULL;
+    if (inst->type == SSA_BRANCH) {
+        inst->data.branch_data.condition = first;
+    } else if (inst->type == SSA_SWITCH) {
+        inst->data.switch_data.switch_expr = first;
+    } else if (inst->type == SSA_RETURN) {
+        inst->data.return_data.value = first;
+    }
+}
+
+void link_ssa_instruction(SSAInstruction* inst) {
+    if (!inst || inst->use_index) return;
+    
+    if (inst->operand_count > 0) {
+        inst->use_index = inst->operand_count <= SSA_INLINE_OPERANDS
+                        ? inst->inline_use_index
+                        : (int*)malloc(inst->operand_count * sizeof(int));
+        if (!inst->use_index) return;
+        for (int i = 0; i < inst->operand_count; i++) {
+            add_ssa_use(inst, i);
+        }
+    }
+    if (inst->dest) {
+        inst->dest->def = inst;
+    }
+}
+
+void unlink_ssa_instruction(SSAInstruction* inst) {
+    if (!inst) return;
+    
+    if (inst->use_index) {
+        for (int i = 0; i < inst->operand_count; i++) {
+            remove_ssa_use(inst, i);
+        }
+        if (inst->use_index != inst->inline_use_index) {
+            free(inst->use_index);
+        }
+        inst->use_index = NULL;
+    }
+    if (inst->dest && inst->dest->def == inst) {
+        inst->dest->def = NULL;
+    }
+}
+
+void set_ssa_operand(SSAInstruction* inst, int index, SSAValue* value) {
+    if (!inst || index < 0 || index >= inst->operand_count) return;
+    
+    if (inst->use_index) {
+        remove_ssa_use(inst, index);
+        inst->operands[index] = value;
+        add_ssa_use(inst, index);
+    } else {
+        inst->operands[index] = value;
+    }
+    if (index == 0) {
+        sync_operand_fields(inst);
+    }
+}
+
+void set_ssa_dest(SSAInstruction* inst, SSAValue* dest) {
+    if (!inst) return;
+    
+    if (inst->dest && inst->dest->def == inst) {
+        inst->dest->def = NULL;
+    }
+    inst->dest = dest;
+    if (dest) {
+        dest->def = inst;
+    }
+}
+
+void replace_all_uses(SSAValue* value, SSAValue* replacement) {
+    if (!value || value == replacement) return;
+    
+    // Each update removes one entry from value->uses
+    while (value->use_count > 0) {
+        SSAUse use = value->uses[value->use_count - 1];
+        if (use.user) {
+            set_ssa_operand(use.user, use.operand, replacement);
+        } else {
+            set_phi_operand(use.phi, use.operand, replacement);
+        }
+    }
+}
+
 // --- Phi Node Functions ---
 
 PhiNode* create_phi_node(SSAValue* dest) {
-    PhiNode* phi = (PhiNode*)malloc(sizeof(PhiNode));
+    PhiNode* phi = (PhiNode*)calloc(1, sizeof(PhiNode));
     if (!phi) return NULL;
     
     phi->dest = dest;
@@ -381,26 +636,56 @@ PhiNode* create_phi_node(SSAValue* dest) {
     return phi;
 }
 
+// Phi operands are always linked into their values' use lists
 void add_phi_operand(PhiNode* phi, BasicBlock* block, SSAValue* value) {
     if (!phi || !block || !value) return;
     
     // Resize operands array
-    phi->operands = realloc(phi->operands, 
-                           (phi->operand_count + 1) * sizeof(phi->operands[0]));
-    if (!phi->operands) return;
+    void* operands = realloc(phi->operands, 
+                             (phi->operand_count + 1) * sizeof(phi->operands[0]));
+    if (!operands) return;
+    phi->operands = operands;
+    int* use_index = (int*)realloc(phi->use_index, (phi->operand_count + 1) * sizeof(int));
+    if (!use_index) return;
+    phi->use_index = use_index;
+    
+    int index = phi->operand_count++;
+    phi->operands[index].block = block;
+    phi->operands[index].value = value;
+    phi->use_index[index] = push_ssa_use(value, NULL, phi, index);
+}
+
+void set_phi_operand(PhiNode* phi, int index, SSAValue* value) {
+    if (!phi || index < 0 || index >= phi->operand_count) return;
     
-    phi->operands[phi->operand_count].block = block;
-    phi->operands[phi->operand_count].value = value;
-    phi->operand_count++;
+    drop_ssa_use(phi->operands[index].value, phi->use_index[index]);
+    phi->operands[index].value = value;
+    phi->use_index[index] = push_ssa_use(value, NULL, phi, index);
+}
+
+// Moves the last operand into the freed position
+void remove_phi_operand(PhiNode* phi, int index) {
+    if (!phi || index < 0 || index >= phi->operand_count) return;
+    
+    drop_ssa_use(phi->operands[index].value, phi->use_index[index]);
+    int last = --phi->operand_count;
+    if (index < last) {
+        SSAValue* value = phi->operands[last].value;
+        drop_ssa_use(value, phi->use_index[last]);
+        phi->operands[index] = phi->operands[last];
+        phi->use_index[index] = push_ssa_use(value, NULL, phi, index);
+    }
 }
 
 void free_phi_node(PhiNode* phi) {
     if (!phi) return;
     
     // Note: We don't free the SSAValues as they may be shared
-    if (phi->operands) {
-        free(phi->operands);
+    for (int i = 0; i < phi->operand_count; i++) {
+        drop_ssa_use(phi->operands[i].value, phi->use_index[i]);
     }
+    free(phi->operands);
+    free(phi->use_index);
     
     free(phi);
 }
@@ -431,6 +716,17 @@ void add_instruction(InstructionList* list, SSAInstruction* inst) {
     }
     
     list->items[list->count++] = inst;
+    link_ssa_instruction(inst);
+}
+
+void remove_instruction(InstructionList* list, int index) {
+    if (!list || index < 0 || index >= list->count) return;
+    
+    free_ssa_instruction(list->items[index]);
+    for (int i = index; i < list->count - 1; i++) {
+        list->items[i] = list->items[i + 1];
+    }
+    list->count--;
 }
 
 void free_instruction_list(InstructionList* list) {
@@ -489,12 +785,12 @@ void free_phi_node_list(PhiNodeList* list) {
 static int next_switch_id = 0;
 
 SSAInstruction* create_ssa_switch(SSAValue* expr, SwitchCase* cases, int case_count, BasicBlock* default_target) {
-    SSAInstruction* inst = (SSAInstruction*)malloc(sizeof(SSAInstruction));
+    SSAInstruction* inst = (SSAInstruction*)calloc(1, sizeof(SSAInstruction));
     if (!inst) return NULL;
     
     inst->type = SSA_SWITCH;
     inst->dest = NULL;
-    inst->operands = (SSAValue**)malloc(sizeof(SSAValue*));
+    inst->operands = inst->inline_operands;
     inst->operands[0] = expr;
     inst->operand_count = 1;
     
@@ -2,6 +2,8 @@
 #define CFG_H
 
 #include "ast.h"
+#include "arena.h"
+#include "intern.h"
 #include <stdbool.h>
 
 // Forward declarations
@@ -42,7 +44,16 @@ typedef struct {
     BasicBlock* target_block;
 } SwitchCase;
 
-// SSA value types
+// One operand slot reading a value: an instruction operand, or a phi
+// operand when user is NULL
+typedef struct {
+    SSAInstruction* user;
+    PhiNode* phi;
+    int operand;                // Index into user->operands or phi->operands
+} SSAUse;
+
+// SSA value types. Values belong to the CFG they were created for: they
+// live in its arena until free_cfg, and their ids index its values table.
 typedef struct SSAValue {
     enum {
         SSA_VAR,       // SSA variable (e.g., x_1, x_2)
@@ -51,12 +62,19 @@ typedef struct SSAValue {
     } type;
     union {
         struct {
-            char* base_name;    // Original variable name
+            SymbolId symbol;    // Original variable name, interned
             int version;        // SSA version number
         } var;
         int const_value;
         int temp_id;
     } data;
+    int id;                     // Dense index in the CFG's values table, for side tables
+    
+    // Def-use links, maintained for instructions added with add_instruction
+    SSAInstruction* def;        // Defining instruction, NULL if none or a phi
+    SSAUse* uses;               // Operand slots reading this value
+    int use_count;
+    int use_capacity;
 } SSAValue;
 
 // Dynamic array of SSA instructions
@@ -73,12 +91,18 @@ typedef struct {
     int capacity;
 } PhiNodeList;
 
+// Operands kept inside the instruction; calls with more have their own array
+#define SSA_INLINE_OPERANDS 2
+
 // SSA instruction structure
 typedef struct SSAInstruction {
     SSAInstructionType type;
     SSAValue* dest;              // Destination (if any)
-    SSAValue** operands;         // Source operands
+    SSAValue** operands;         // Source operands: inline_operands, or allocated for long calls
     int operand_count;
+    int* use_index;              // Per operand, its slot in the value's uses; NULL if unlinked
+    SSAValue* inline_operands[SSA_INLINE_OPERANDS];
+    int inline_use_index[SSA_INLINE_OPERANDS];
     
     // Type-specific data
     union {
@@ -117,6 +141,7 @@ typedef struct PhiNode {
         SSAValue* value;                 // Value from that predecessor
     }* operands;
     int operand_count;
+    int* use_index;                      // Per operand, its slot in the value's uses
 } PhiNode;
 
 // Basic block structure
@@ -139,7 +164,7 @@ typedef struct BasicBlock {
     int dom_frontier_capacity;
     
     // For CFG construction
-    bool visited;                    // For traversal algorithms
+    unsigned int visit_mark;         // Equals cfg->visit_epoch once visited
     int post_order_num;              // Post-order numbering
 } BasicBlock;
 
@@ -151,15 +176,44 @@ typedef struct CFG {
     int block_count;
     int block_capacity;
     int next_block_id;               // For generating unique IDs
+    unsigned int visit_epoch;        // Current traversal; see begin_cfg_visit
     
     // Function information
     char* function_name;
     
+    // SSA values: allocated from arena, and values[id] is the value with
+    // that id, so passes size their per-value tables by value_count
+    Arena* arena;
+    SSAValue** values;
+    int value_count;
+    int value_capacity;
+    
     // Temporary storage during construction
     BasicBlock* current_loop_header; // For break statements
     BasicBlock* current_loop_exit;   // For break statements
 } CFG;
 
+// Frozen, read-only layout of a finished CFG. Blocks are renumbered densely
+// in cfg->blocks order, and each block's successors, predecessors and
+// instructions are the slices [offsets[i], offsets[i + 1]) of one flat
+// array, so traversals walk contiguous memory instead of per-block
+// allocations. Any change to the CFG invalidates it.
+typedef struct {
+    CFG* cfg;
+    int block_count;
+    BasicBlock** blocks;             // Dense index -> block
+    int* index_of_id;                // Block id -> dense index, -1 if not in the CFG
+    int id_count;                    // Length of index_of_id
+    int entry;                       // Dense index of the entry, -1 if none
+    int exit;
+    int* succ_offsets;               // block_count + 1 entries each
+    int* succs;                      // Dense block indices
+    int* pred_offsets;
+    int* preds;
+    int* instr_offsets;
+    SSAInstruction** instrs;
+} FrozenCFG;
+
 // --- CFG Creation Functions ---
 CFG* create_cfg(const char* function_name);
 BasicBlock* create_basic_block(CFG* cfg, const char* label);
@@ -169,12 +223,18 @@ void remove_edge(BasicBlock* from, BasicBlock* to);
 void free_cfg(CFG* cfg);
 void free_basic_block(BasicBlock* block);
 
+// --- Frozen Layout ---
+FrozenCFG* freeze_cfg(CFG* cfg);
+void free_frozen_cfg(FrozenCFG* frozen);
+
 // --- SSA Value Creation ---
-SSAValue* create_ssa_var(const char* base_name, int version);
-SSAValue* create_ssa_const(int value);
-SSAValue* create_ssa_temp(int temp_id);
-SSAValue* copy_ssa_value(SSAValue* value);
-void free_ssa_value(SSAValue* value);
+// Values are freed with their CFG, never one at a time
+SSAValue* create_ssa_var(CFG* cfg, SymbolId symbol, int version);
+SSAValue* create_ssa_const(CFG* cfg, int value);
+SSAValue* create_ssa_temp(CFG* cfg, int temp_id);
+SSAValue* copy_ssa_value(CFG* cfg, SSAValue* value);
+int ssa_value_id_count(const CFG* cfg);  // Ids handed out so far; all ids are below this
+const char* ssa_var_name(const SSAValue* value);  // Base name of an SSA_VAR
 char* ssa_value_to_string(SSAValue* value);
 
 // --- SSA Instruction Creation ---
@@ -188,14 +248,26 @@ SSAInstruction* create_ssa_jump(BasicBlock* target);
 SSAInstruction* create_ssa_switch(SSAValue* expr, SwitchCase* cases, int case_count, BasicBlock* default_target);
 void free_ssa_instruction(SSAInstruction* inst);
 
+// --- Def-Use Links ---
+// add_instruction links an instruction; change its operands only through
+// set_ssa_operand or replace_all_uses so the value use lists stay exact.
+void link_ssa_instruction(SSAInstruction* inst);
+void unlink_ssa_instruction(SSAInstruction* inst);
+void set_ssa_operand(SSAInstruction* inst, int index, SSAValue* value);
+void set_ssa_dest(SSAInstruction* inst, SSAValue* dest);
+void replace_all_uses(SSAValue* value, SSAValue* replacement);
+
 // --- Phi Node Functions ---
 PhiNode* create_phi_node(SSAValue* dest);
 void add_phi_operand(PhiNode* phi, BasicBlock* block, SSAValue* value);
+void set_phi_operand(PhiNode* phi, int index, SSAValue* value);
+void remove_phi_operand(PhiNode* phi, int index);
 void free_phi_node(PhiNode* phi);
 
 // --- Instruction List Functions ---
 InstructionList* create_instruction_list();
 void add_instruction(InstructionList* list, SSAInstruction* inst);
+void remove_instruction(InstructionList* list, int index);  // Unlinks and frees it
 void free_instruction_list(InstructionList* list);
 
 // --- Phi Node List Functions ---
@@ -1,5 +1,6 @@
 #define _GNU_SOURCE  // For strdup
 #include "cfg_builder.h"
+#include "cfg_utils.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -14,7 +15,9 @@ CFGBuilderContext* create_builder_context(CFG* cfg) {
     ctx->current_block = NULL;
     ctx->loop_context = NULL;
     ctx->switch_context = NULL;
-    ctx->var_versions = NULL;
+    ctx->var_stacks = NULL;
+    ctx->var_stack_count = 0;
+    ctx->var_trail = NULL;
     ctx->var_count = 0;
     ctx->var_capacity = 0;
     ctx->next_temp_id = 0;
@@ -31,10 +34,11 @@ void free_builder_context(CFGBuilderContext* ctx) {
     if (!ctx) return;
     
     // Free variable version tracking
-    for (int i = 0; i < ctx->var_count; i++) {
-        free(ctx->var_versions[i].name);
+    for (int i = 0; i < ctx->var_stack_count; i++) {
+        free(ctx->var_stacks[i].entries);
     }
-    free(ctx->var_versions);
+    free(ctx->var_stacks);
+    free(ctx->var_trail);
     
     // Free loop context stack
     while (ctx->loop_context) {
@@ -59,47 +63,63 @@ void free_builder_context(CFGBuilderContext* ctx) {
 
 // --- Variable Version Tracking ---
 
+// Visible declaration of symbol, or NULL if it has none in scope
+static struct VarVersion* visible_var_version(CFGBuilderContext* ctx, SymbolId symbol) {
+    if (symbol == SYMBOL_NONE || symbol >= ctx->var_stack_count) return NULL;
+    struct VarStack* stack = &ctx->var_stacks[symbol];
+    return stack->count > 0 ? &stack->entries[stack->count - 1] : NULL;
+}
+
 int get_var_version(CFGBuilderContext* ctx, const char* name) {
-    // Search from most recent (highest scope) to oldest (lowest scope)
-    // This implements proper variable shadowing
-    for (int i = ctx->var_count - 1; i >= 0; i--) {
-        if (strcmp(ctx->var_versions[i].name, name) == 0) {
-            return ctx->var_versions[i].version;
-        }
-    }
-    return 0; // Variable not found, return version 0
+    // Names are interned when a version is created, so an unknown symbol
+    // means the variable has never been versioned
+    struct VarVersion* entry = visible_var_version(ctx, find_symbol(name));
+    return entry ? entry->version : 0; // Variable not found, return version 0
 }
 
 int increment_var_version(CFGBuilderContext* ctx, const char* name) {
     // For variable declarations, always create a new version in current scope
     // This handles both new variables and variable shadowing
+    SymbolId symbol = intern_symbol(name);
+    if (symbol >= ctx->var_stack_count) {
+        int new_count = symbol_count() > symbol + 1 ? symbol_count() : symbol + 1;
+        struct VarStack* new_stacks = (struct VarStack*)realloc(ctx->var_stacks,
+                                                                new_count * sizeof(struct VarStack));
+        if (!new_stacks) return 0;
+        memset(new_stacks + ctx->var_stack_count, 0,
+               (new_count - ctx->var_stack_count) * sizeof(struct VarStack));
+        ctx->var_stacks = new_stacks;
+        ctx->var_stack_count = new_count;
+    }
     
-    // Add new variable version
     if (ctx->var_count >= ctx->var_capacity) {
         int new_capacity = ctx->var_capacity == 0 ? 8 : ctx->var_capacity * 2;
-        struct VarVersion* new_versions = (struct VarVersion*)realloc(ctx->var_versions,
-                                                                      new_capacity * sizeof(struct VarVersion));
-        if (!new_versions) return 0;
-        ctx->var_versions = new_versions;
+        SymbolId* new_trail = (SymbolId*)realloc(ctx->var_trail, new_capacity * sizeof(SymbolId));
+        if (!new_trail) return 0;
+        ctx->var_trail = new_trail;
         ctx->var_capacity = new_capacity;
     }
     
-    // Find the highest version number for this variable name across all scopes
-    int max_version = 0;
-    for (int i = 0; i < ctx->var_count; i++) {
-        if (strcmp(ctx->var_versions[i].name, name) == 0) {
-            if (ctx->var_versions[i].version > max_version) {
-                max_version = ctx->var_versions[i].version;
-            }
-        }
+    struct VarStack* stack = &ctx->var_stacks[symbol];
+    if (stack->count >= stack->capacity) {
+        int new_capacity = stack->capacity == 0 ? 4 : stack->capacity * 2;
+        struct VarVersion* new_entries = (struct VarVersion*)realloc(stack->entries,
+                                                                     new_capacity * sizeof(struct VarVersion));
+        if (!new_entries) return 0;
+        stack->entries = new_entries;
+        stack->capacity = new_capacity;
     }
     
-    ctx->var_versions[ctx->var_count].name = strdup(name);
-    ctx->var_versions[ctx->var_count].version = max_version + 1;
-    ctx->var_versions[ctx->var_count].scope_level = ctx->current_scope_level;
-    ctx->var_count++;
+    // Every push takes the next number after the top, so the top always
+    // holds the highest version of this name still in scope
+    int version = stack->count > 0 ? stack->entries[stack->count - 1].version + 1 : 1;
+    stack->entries[stack->count].version = version;
+    stack->entries[stack->count].scope_level = ctx->current_scope_level;
+    stack->entries[stack->count].value = NULL;
+    stack->count++;
+    ctx->var_trail[ctx->var_count++] = symbol;
     
-    return max_version + 1;
+    return version;
 }
 
 // --- Scope Management ---
@@ -111,27 +131,27 @@ void enter_scope(CFGBuilderContext* ctx) {
 void exit_scope(CFGBuilderContext* ctx) {
     if (ctx->current_scope_level <= 0) return; // Don't go below global scope
     
-    // Remove all variables from the current scope level
-    int write_index = 0;
-    for (int read_index = 0; read_index < ctx->var_count; read_index++) {
-        if (ctx->var_versions[read_index].scope_level < ctx->current_scope_level) {
-            // Keep variables from outer scopes
-            if (write_index != read_index) {
-                ctx->var_versions[write_index] = ctx->var_versions[read_index];
-            }
-            write_index++;
-        } else {
-            // Free variables from current scope
-            free(ctx->var_versions[read_index].name);
-        }
+    // Pop the versions pushed in the current scope, newest first
+    while (ctx->var_count > 0) {
+        struct VarStack* stack = &ctx->var_stacks[ctx->var_trail[ctx->var_count - 1]];
+        if (stack->entries[stack->count - 1].scope_level < ctx->current_scope_level) break;
+        stack->count--;
+        ctx->var_count--;
     }
-    ctx->var_count = write_index;
     ctx->current_scope_level--;
 }
 
+// Every reference to a version, including its definition, shares one
+// SSAValue so that the value's def-use links cover all of its uses
 SSAValue* get_current_var_value(CFGBuilderContext* ctx, const char* name) {
-    int version = get_var_version(ctx, name);
-    return create_ssa_var(name, version);
+    struct VarVersion* entry = visible_var_version(ctx, find_symbol(name));
+    if (!entry) {
+        return create_ssa_var(ctx->cfg, intern_symbol(name), 0); // Never assigned (an input): no definition to share
+    }
+    if (!entry->value) {
+        entry->value = create_ssa_var(ctx->cfg, intern_symbol(name), entry->version);
+    }
+    return entry->value;
 }
 
 // --- Main Entry Points ---
@@ -142,19 +162,20 @@ CFG* build_cfg_from_ast(Node* ast) {
     ProgramNode* program = (ProgramNode*)ast;
     if (program->functions->count == 0) return NULL;
     
-    // Find the first function (skip global variable declarations)
-    Node* first_func = NULL;
+    // main, as on the compact path; helper functions before it are skipped
+    FunctionDefNode* main_func = find_main_function(ast);
+    if (main_func) {
+        return build_function_cfg(main_func);
+    }
+    
+    // Without main, the first function (skip global variable declarations)
     for (int i = 0; i < program->functions->count; i++) {
         Node* item = program->functions->items[i];
         if (item->type == NODE_FUNCTION_DEF) {
-            first_func = item;
-            break;
+            return build_function_cfg((FunctionDefNode*)item);
         }
     }
-    
-    if (!first_func) return NULL;
-    
-    return build_function_cfg((FunctionDefNode*)first_func);
+    return NULL;
 }
 
 CFG* build_function_cfg(FunctionDefNode* func) {
@@ -257,8 +278,8 @@ BasicBlock* process_block(CFGBuilderContext* ctx, BlockNode* block, BasicBlock*
 }
 
 BasicBlock* process_var_decl(CFGBuilderContext* ctx, VarDeclNode* decl, BasicBlock* current) {
-    int version = increment_var_version(ctx, decl->var_name);
-    SSAValue* dest = create_ssa_var(decl->var_name, version);
+    increment_var_version(ctx, decl->var_name);
+    SSAValue* dest = get_current_var_value(ctx, decl->var_name);
     
     if (decl->initializer) {
         SSAValue* init_value = process_expression(ctx, decl->initializer, current);
@@ -266,10 +287,9 @@ BasicBlock* process_var_decl(CFGBuilderContext* ctx, VarDeclNode* decl, BasicBlo
         add_instruction(current->instructions, assign);
     } else {
         // Initialize to 0
-        SSAValue* zero = create_ssa_const(0);
+        SSAValue* zero = create_ssa_const(ctx->cfg, 0);
         SSAInstruction* assign = create_ssa_assign(dest, zero);
         add_instruction(current->instructions, assign);
-        free_ssa_value(zero);
     }
     
     return current;
@@ -615,7 +635,7 @@ SSAValue* process_binary_op(CFGBuilderContext* ctx, BinaryOpNode* bin_op, BasicB
     SSAValue* right = process_expression(ctx, bin_op->right, current);
     
     // Create temporary for result
-    SSAValue* result = create_ssa_temp(ctx->next_temp_id++);
+    SSAValue* result = create_ssa_temp(ctx->cfg, ctx->next_temp_id++);
     
     SSAInstruction* inst = create_ssa_binary_op(result, bin_op->op, left, right);
     add_instruction(current->instructions, inst);
@@ -627,7 +647,7 @@ SSAValue* process_unary_op(CFGBuilderContext* ctx, UnaryOpNode* unary_op, BasicB
     SSAValue* operand = process_expression(ctx, unary_op->operand, current);
     
     // Create temporary for result
-    SSAValue* result = create_ssa_temp(ctx->next_temp_id++);
+    SSAValue* result = create_ssa_temp(ctx->cfg, ctx->next_temp_id++);
     
     SSAInstruction* inst = create_ssa_unary_op(result, unary_op->op, operand);
     add_instruction(current->instructions, inst);
@@ -644,8 +664,8 @@ SSAValue* process_assignment(CFGBuilderContext* ctx, AssignmentNode* assign, Bas
     SSAValue* value = process_expression(ctx, assign->value, current);
     
     // Create new version of variable
-    int version = increment_var_version(ctx, ident->name);
-    SSAValue* dest = create_ssa_var(ident->name, version);
+    increment_var_version(ctx, ident->name);
+    SSAValue* dest = get_current_var_value(ctx, ident->name);
     
     SSAInstruction* inst = create_ssa_assign(dest, value);
     add_instruction(current->instructions, inst);
@@ -661,7 +681,7 @@ SSAValue* process_identifier(CFGBuilderContext* ctx, IdentifierNode* ident, Basi
 SSAValue* process_number_literal(CFGBuilderContext* ctx, NumberLiteralNode* num, BasicBlock* current) {
     (void)ctx;      // Not needed for pure constant
     (void)current;  // No control-flow effect
-    return create_ssa_const(atoi(num->value));
+    return create_ssa_const(ctx->cfg, atoi(num->value));
 }
 
 SSAValue* process_function_call(CFGBuilderContext* ctx, FunctionCallNode* call, BasicBlock* current) {
@@ -675,7 +695,7 @@ SSAValue* process_function_call(CFGBuilderContext* ctx, FunctionCallNode* call,
     }
     
     // Create temporary for result
-    SSAValue* result = create_ssa_temp(ctx->next_temp_id++);
+    SSAValue* result = create_ssa_temp(ctx->cfg, ctx->next_temp_id++);
     
     SSAInstruction* inst = create_ssa_call(result, call->name, args, call->arguments->count);
     add_instruction(current->instructions, inst);
@@ -693,7 +713,7 @@ SSAValue* process_array_access(CFGBuilderContext* ctx, ArrayAccessNode* arr_acce
     SSAValue* index = process_expression(ctx, arr_access->index, current);
     
     // Create a temporary for the result
-    SSAValue* result = create_ssa_temp(ctx->next_temp_id++);
+    SSAValue* result = create_ssa_temp(ctx->cfg, ctx->next_temp_id++);
     
     // For now, we'll create a LOAD instruction (in a full implementation,
     // this would generate proper array access code)
@@ -706,7 +726,7 @@ SSAValue* process_array_access(CFGBuilderContext* ctx, ArrayAccessNode* arr_acce
 SSAValue* process_bool_literal(CFGBuilderContext* ctx, BoolLiteralNode* bool_lit, BasicBlock* current) {
     (void)ctx; // Unused
     (void)current; // Unused
-    return create_ssa_const(bool_lit->value);
+    return create_ssa_const(ctx->cfg, bool_lit->value);
 }
 
 SSAValue* process_initializer_list(CFGBuilderContext* ctx, InitializerListNode* init_list, BasicBlock* current) {
@@ -715,7 +735,7 @@ SSAValue* process_initializer_list(CFGBuilderContext* ctx, InitializerListNode*
     // memory allocation and proper array initialization.
     
     // Create a temporary for the array
-    SSAValue* array_temp = create_ssa_temp(ctx->next_temp_id++);
+    SSAValue* array_temp = create_ssa_temp(ctx->cfg, ctx->next_temp_id++);
     
     // Process each element and generate assignment instructions
     for (int i = 0; i < init_list->elements->count; i++) {
@@ -724,7 +744,7 @@ SSAValue* process_initializer_list(CFGBuilderContext* ctx, InitializerListNode*
         // For now, we'll create a simple assignment instruction to represent
         // the array element initialization. In a more complete implementation,
         // this would be array store operations.
-        SSAValue* element_temp = create_ssa_temp(ctx->next_temp_id++);
+        SSAValue* element_temp = create_ssa_temp(ctx->cfg, ctx->next_temp_id++);
         SSAInstruction* assign = create_ssa_assign(element_temp, element_value);
         add_instruction(current->instructions, assign);
     }
@@ -1037,4 +1057,318 @@ BasicBlock* process_label_statement(CFGBuilderContext* ctx, LabelNode* label_nod
     
     // Process the labeled statement in the new block
     return process_statement(ctx, label_node->statement, label_block);
-}
\ No newline at end of file
+}
+
+// --- SSA Construction ---
+
+// Per variable state while placing phis and renaming
+typedef struct {
+    SymbolId symbol;
+    BasicBlock** def_blocks;         // Reachable blocks assigning it
+    int def_count;
+    int def_capacity;
+    BasicBlock** use_blocks;         // Blocks reading it before any assignment
+    int use_count;
+    int use_capacity;
+    int defined_in;                  // Block id + 1 of the block being scanned
+    int used_in;
+    SSAValue** stack;                // Reaching definitions during renaming
+    int depth;
+    int stack_capacity;
+    int next_version;
+    SSAValue* undefined;             // Version 0, read where nothing reaches
+} SSAVariable;
+
+typedef struct {
+    SSAVariable* vars;
+    int var_count;
+    int var_capacity;
+    int* var_of_symbol;              // Symbol id -> index into vars, -1 if none
+    int symbol_capacity;
+} SSANameTable;
+
+static bool append_block(BasicBlock*** items, int* count, int* capacity, BasicBlock* block) {
+    if (*count >= *capacity) {
+        int new_capacity = *capacity == 0 ? 4 : *capacity * 2;
+        BasicBlock** grown = realloc(*items, new_capacity * sizeof(BasicBlock*));
+        if (!grown) return false;
+        *items = grown;
+        *capacity = new_capacity;
+    }
+    (*items)[(*count)++] = block;
+    return true;
+}
+
+static SSAVariable* ssa_variable(SSANameTable* table, SSAValue* value) {
+    SymbolId symbol = value->data.var.symbol;
+    if (symbol >= table->symbol_capacity) {
+        int new_capacity = symbol_count() > symbol + 1 ? symbol_count() : symbol + 1;
+        int* grown = realloc(table->var_of_symbol, new_capacity * sizeof(int));
+        if (!grown) return NULL;
+        for (int i = table->symbol_capacity; i < new_capacity; i++) {
+            grown[i] = -1;
+        }
+        table->var_of_symbol = grown;
+        table->symbol_capacity = new_capacity;
+    }
+    if (table->var_of_symbol[symbol] < 0) {
+        if (table->var_count >= table->var_capacity) {
+            int new_capacity = table->var_capacity == 0 ? 16 : table->var_capacity * 2;
+            SSAVariable* grown = realloc(table->vars, new_capacity * sizeof(SSAVariable));
+            if (!grown) return NULL;
+            table->vars = grown;
+            table->var_capacity = new_capacity;
+        }
+        memset(&table->vars[table->var_count], 0, sizeof(SSAVariable));
+        table->vars[table->var_count].symbol = symbol;
+        table->var_of_symbol[symbol] = table->var_count++;
+    }
+    return &table->vars[table->var_of_symbol[symbol]];
+}
+
+static SSAValue* reaching_definition(CFG* cfg, SSAVariable* var) {
+    if (var->depth > 0) {
+        return var->stack[var->depth - 1];
+    }
+    if (!var->undefined) {
+        var->undefined = create_ssa_var(cfg, var->symbol, 0);
+    }
+    return var->undefined;
+}
+
+// Creates the next version of var and makes it the reaching definition
+static SSAValue* push_new_definition(CFG* cfg, SSAVariable* var, int** log, int* log_count, int* log_capacity, int var_index) {
+    if (var->depth >= var->stack_capacity) {
+        var->stack_capacity = var->stack_capacity == 0 ? 4 : var->stack_capacity * 2;
+        var->stack = realloc(var->stack, var->stack_capacity * sizeof(SSAValue*));
+    }
+    if (*log_count >= *log_capacity) {
+        *log_capacity = *log_capacity == 0 ? 64 : *log_capacity * 2;
+        *log = realloc(*log, *log_capacity * sizeof(int));
+    }
+    SSAValue* value = create_ssa_var(cfg, var->symbol, ++var->next_version);
+    var->stack[var->depth++] = value;
+    (*log)[(*log_count)++] = var_index;
+    return value;
+}
+
+// Records which reachable blocks assign each variable and which read it
+// before assigning it (its upward-exposed uses)
+static void collect_ssa_variables(CFG* cfg, SSANameTable* table) {
+    for (int i = 0; i < cfg->block_count; i++) {
+        BasicBlock* block = cfg->blocks[i];
+        if (block->post_order_num < 0) continue;
+        int stamp = block->id + 1;
+        
+        for (int j = 0; j < block->instructions->count; j++) {
+            SSAInstruction* inst = block->instructions->items[j];
+            for (int k = 0; k < inst->operand_count; k++) {
+                SSAValue* operand = inst->operands[k];
+                if (!operand || operand->type != SSA_VAR) continue;
+                SSAVariable* var = ssa_variable(table, operand);
+                if (var && var->defined_in != stamp && var->used_in != stamp) {
+                    var->used_in = stamp;
+                    append_block(&var->use_blocks, &var->use_count, &var->use_capacity, block);
+                }
+            }
+            if (inst->dest && inst->dest->type == SSA_VAR) {
+                SSAVariable* var = ssa_variable(table, inst->dest);
+                if (var && var->defined_in != stamp) {
+                    var->defined_in = stamp;
+                    append_block(&var->def_blocks, &var->def_count, &var->def_capacity, block);
+                }
+            }
+        }
+    }
+}
+
+// Pruned placement: a variable gets a phi at each block of the iterated
+// dominance frontier of its assignments where it is live on entry
+static void place_phi_nodes(CFG* cfg, SSANameTable* table) {
+    int block_ids = cfg->next_block_id;
+    int* defines = calloc(block_ids, sizeof(int));
+    int* live = calloc(block_ids, sizeof(int));
+    int* has_phi = calloc(block_ids, sizeof(int));
+    int* queued = calloc(block_ids, sizeof(int));
+    BasicBlock** worklist = malloc(block_ids * sizeof(BasicBlock*));
+    if (!defines || !live || !has_phi || !queued || !worklist) goto done;
+    
+    for (int v = 0; v < table->var_count; v++) {
+        SSAVariable* var = &table->vars[v];
+        int stamp = v + 1;
+        if (var->def_count == 0) continue;  // Inputs are never renamed apart
+        
+        for (int i = 0; i < var->def_count; i++) {
+            defines[var->def_blocks[i]->id] = stamp;
+        }
+        
+        // Backward liveness from the upward-exposed uses
+        int count = 0;
+        for (int i = 0; i < var->use_count; i++) {
+            live[var->use_blocks[i]->id] = stamp;
+            worklist[count++] = var->use_blocks[i];
+        }
+        while (count > 0) {
+            BasicBlock* block = worklist[--count];
+            for (int i = 0; i < block->predecessor_count; i++) {
+                BasicBlock* pred = block->predecessors[i];
+                if (pred->post_order_num < 0 || live[pred->id] == stamp) continue;
+                live[pred->id] = stamp;
+                if (defines[pred->id] != stamp) {
+                    worklist[count++] = pred;
+                }
+            }
+        }
+        
+        // Iterated dominance frontier of the assigning blocks
+        for (int i = 0; i < var->def_count; i++) {
+            queued[var->def_blocks[i]->id] = stamp;
+            worklist[count++] = var->def_blocks[i];
+        }
+        while (count > 0) {
+            BasicBlock* block = worklist[--count];
+            for (int i = 0; i < block->dom_frontier_count; i++) {
+                BasicBlock* join = block->dom_frontier[i];
+                if (has_phi[join->id] == stamp || live[join->id] != stamp) continue;
+                has_phi[join->id] = stamp;
+                // The destination names the variable until renaming replaces it
+                add_phi_node(join->phi_nodes, create_phi_node(reaching_definition(cfg, var)));
+                if (queued[join->id] != stamp) {
+                    queued[join->id] = stamp;
+                    worklist[count++] = join;
+                }
+            }
+        }
+    }
+    
+done:
+    free(defines);
+    free(live);
+    free(has_phi);
+    free(queued);
+    free(worklist);
+}
+
+// Walks the dominator tree with one stack of reaching definitions per
+// variable, giving every assignment and phi a fresh version and pointing
+// each read, and each successor phi operand, at the definition on top
+static void rename_ssa_variables(CFG* cfg, SSANameTable* table) {
+    int block_ids = cfg->next_block_id;
+    
+    // Dominator tree children, laid out contiguously per parent
+    int* child_start = calloc(block_ids + 1, sizeof(int));
+    BasicBlock** children = malloc((cfg->block_count + 1) * sizeof(BasicBlock*));
+    int* fill = calloc(block_ids + 1, sizeof(int));
+    int* log_mark = malloc(block_ids * sizeof(int));
+    BasicBlock** walk = malloc(2 * (cfg->block_count + 1) * sizeof(BasicBlock*));
+    bool* leaving = malloc(2 * (cfg->block_count + 1) * sizeof(bool));
+    int* log = NULL;
+    int log_count = 0, log_capacity = 0;
+    if (!child_start || !children || !fill || !log_mark || !walk || !leaving) goto done;
+    
+    for (int i = 0; i < cfg->block_count; i++) {
+        if (cfg->blocks[i]->idom) child_start[cfg->blocks[i]->idom->id + 1]++;
+    }
+    for (int i = 0; i < block_ids; i++) {
+        child_start[i + 1] += child_start[i];
+    }
+    for (int i = 0; i < cfg->block_count; i++) {
+        BasicBlock* block = cfg->blocks[i];
+        if (block->idom) {
+            int parent = block->idom->id;
+            children[child_start[parent] + fill[parent]++] = block;
+        }
+    }
+    
+    int top = 0;
+    walk[top] = cfg->entry;
+    leaving[top++] = false;
+    while (top > 0) {
+        BasicBlock* block = walk[--top];
+        if (leaving[top]) {
+            while (log_count > log_mark[block->id]) {
+                table->vars[log[--log_count]].depth--;
+            }
+            continue;
+        }
+        log_mark[block->id] = log_count;
+        
+        for (int i = 0; i < block->phi_nodes->count; i++) {
+            PhiNode* phi = block->phi_nodes->items[i];
+            SSAVariable* var = ssa_variable(table, phi->dest);
+            phi->dest = push_new_definition(cfg, var, &log, &log_count, &log_capacity, (int)(var - table->vars));
+        }
+        
+        for (int i = 0; i < block->instructions->count; i++) {
+            SSAInstruction* inst = block->instructions->items[i];
+            for (int k = 0; k < inst->operand_count; k++) {
+                SSAValue* operand = inst->operands[k];
+                if (operand && operand->type == SSA_VAR) {
+                    set_ssa_operand(inst, k, reaching_definition(cfg, ssa_variable(table, operand)));
+                }
+            }
+            if (inst->dest && inst->dest->type == SSA_VAR) {
+                SSAVariable* var = ssa_variable(table, inst->dest);
+                set_ssa_dest(inst, push_new_definition(cfg, var, &log, &log_count, &log_capacity, (int)(var - table->vars)));
+            }
+        }
+        
+        for (int i = 0; i < block->successor_count; i++) {
+            PhiNodeList* phis = block->successors[i]->phi_nodes;
+            for (int j = 0; j < phis->count; j++) {
+                PhiNode* phi = phis->items[j];
+                bool seen = false;
+                for (int k = 0; k < phi->operand_count && !seen; k++) {
+                    seen = phi->operands[k].block == block;  // Parallel edges share one operand
+                }
+                if (!seen) {
+                    add_phi_operand(phi, block, reaching_definition(cfg, ssa_variable(table, phi->dest)));
+                }
+            }
+        }
+        
+        walk[top] = block;
+        leaving[top++] = true;
+        for (int i = child_start[block->id + 1] - 1; i >= child_start[block->id]; i--) {
+            walk[top] = children[i];
+            leaving[top++] = false;
+        }
+    }
+    
+done:
+    free(child_start);
+    free(children);
+    free(fill);
+    free(log_mark);
+    free(walk);
+    free(leaving);
+    free(log);
+}
+
+// The builder versions variables along its scoped version stacks, which
+// cannot see values merging at joins, loop heads or goto targets. This
+// rebuilds proper SSA over the finished CFG (Cytron et al., with pruned
+// phi placement): dominators, dominance frontiers, phis, then renaming.
+// Declarations that shadow an outer name share its base name and are
+// treated as one variable. Blocks unreachable from the entry are left
+// untouched.
+void construct_ssa_form(CFG* cfg) {
+    if (!cfg || !cfg->entry) return;
+    
+    compute_dominators(cfg);
+    compute_dominance_frontiers(cfg);
+    
+    SSANameTable table;
+    memset(&table, 0, sizeof(table));
+    collect_ssa_variables(cfg, &table);
+    place_phi_nodes(cfg, &table);
+    rename_ssa_variables(cfg, &table);
+    
+    for (int i = 0; i < table.var_count; i++) {
+        free(table.vars[i].def_blocks);
+        free(table.vars[i].use_blocks);
+        free(table.vars[i].stack);
+    }
+    free(table.vars);
+    free(table.var_of_symbol);
+}
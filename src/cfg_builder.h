@@ -56,13 +56,22 @@ typedef struct CFGBuilderContext {
         struct SwitchContext* parent;
     }* switch_context;
     
-    // For tracking variable versions with proper scoping
-    struct VarVersion {
-        char* name;
-        int version;
-        int scope_level;  // Track which scope this variable belongs to
-    }* var_versions;
-    int var_count;
+    // Variable versions with proper scoping: one stack per interned name,
+    // indexed by SymbolId, whose top entry is the visible declaration.
+    // var_trail records every push in order, so closing a scope pops only
+    // the names it declared.
+    struct VarStack {
+        struct VarVersion {
+            int version;
+            int scope_level;  // Track which scope this variable belongs to
+            SSAValue* value;  // Shared value for this version, created on first use
+        }* entries;
+        int count;
+        int capacity;
+    }* var_stacks;
+    int var_stack_count;  // Length of var_stacks
+    SymbolId* var_trail;
+    int var_count;        // Entries on var_trail
     int var_capacity;
     
     // Scope tracking
@@ -136,6 +145,10 @@ SSAValue* process_array_access(CFGBuilderContext* ctx, ArrayAccessNode* arr_acce
 SSAValue* process_bool_literal(CFGBuilderContext* ctx, BoolLiteralNode* bool_lit, BasicBlock* current);
 SSAValue* process_initializer_list(CFGBuilderContext* ctx, InitializerListNode* init_list, BasicBlock* current);
 
+// SSA construction: places pruned phi nodes at iterated dominance
+// frontiers and renames every variable so each version has one definition
+void construct_ssa_form(CFG* cfg);
+
 // Helper functions
 void finalize_block(BasicBlock* block);
 BasicBlock* split_block(CFGBuilderContext* ctx, BasicBlock* block, const char* label);
@@ -0,0 +1,493 @@
+#include "cfg_simplify.h"
+#include "cfg_utils.h"
+#include <stdint.h>
+#include <stdlib.h>
+
+int rotate_loops = 0;
+int layout_blocks = 0;
+
+// --- Helpers ---
+
+static bool is_control_instruction(SSAInstruction* instr) {
+    return instr->type == SSA_JUMP || instr->type == SSA_BRANCH ||
+           instr->type == SSA_SWITCH || instr->type == SSA_RETURN;
+}
+
+static SSAInstruction* last_instruction(BasicBlock* block) {
+    InstructionList* list = block->instructions;
+    return list->count > 0 ? list->items[list->count - 1] : NULL;
+}
+
+// A block whose only effect is to continue at its single successor
+static bool is_forwarding_block(CFG* cfg, BasicBlock* block) {
+    if (block == cfg->entry || block == cfg->exit) return false;
+    if (block->successor_count != 1 || block->phi_nodes->count > 0) return false;
+    InstructionList* list = block->instructions;
+    return list->count == 0 || (list->count == 1 && list->items[0]->type == SSA_JUMP);
+}
+
+// Points the terminators of block that name old_target at new_target
+static void retarget_terminator(BasicBlock* block, BasicBlock* old_target, BasicBlock* new_target) {
+    for (int i = 0; i < block->instructions->count; i++) {
+        SSAInstruction* instr = block->instructions->items[i];
+        switch (instr->type) {
+            case SSA_JUMP:
+                if (instr->data.jump_data.target == old_target) {
+                    instr->data.jump_data.target = new_target;
+                }
+                break;
+            case SSA_BRANCH:
+                if (instr->data.branch_data.true_target == old_target) {
+                    instr->data.branch_data.true_target = new_target;
+                }
+                if (instr->data.branch_data.false_target == old_target) {
+                    instr->data.branch_data.false_target = new_target;
+                }
+                break;
+            case SSA_SWITCH:
+                for (int j = 0; j < instr->data.switch_data.case_count; j++) {
+                    if (instr->data.switch_data.cases[j].target_block == old_target) {
+                        instr->data.switch_data.cases[j].target_block = new_target;
+                    }
+                }
+                if (instr->data.switch_data.default_target == old_target) {
+                    instr->data.switch_data.default_target = new_target;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+// Replaces every from -> old_target edge with from -> new_target, keeping
+// its position in from's successors so branch arm order is preserved
+static void redirect_edges(BasicBlock* from, BasicBlock* old_target, BasicBlock* new_target) {
+    for (int i = 0; i < from->successor_count; i++) {
+        if (from->successors[i] != old_target) continue;
+        remove_edge(from, old_target);
+        add_edge(from, new_target);
+        // remove_edge shifted the tail down and add_edge appended; move the
+        // new edge back into slot i
+        BasicBlock* moved = from->successors[from->successor_count - 1];
+        for (int j = from->successor_count - 1; j > i; j--) {
+            from->successors[j] = from->successors[j - 1];
+        }
+        from->successors[i] = moved;
+    }
+    retarget_terminator(from, old_target, new_target);
+}
+
+// Removes every block not reachable from the entry, except the exit
+static int remove_unreachable_blocks(CFG* cfg) {
+    mark_reachable_blocks(cfg);
+    
+    int kept = 0, removed = 0;
+    for (int i = 0; i < cfg->block_count; i++) {
+        BasicBlock* block = cfg->blocks[i];
+        if (is_block_visited(cfg, block) || block == cfg->exit) {
+            cfg->blocks[kept++] = block;
+            continue;
+        }
+        while (block->successor_count > 0) {
+            remove_edge(block, block->successors[0]);
+        }
+        while (block->predecessor_count > 0) {
+            remove_edge(block->predecessors[0], block);
+        }
+        free_basic_block(block);
+        removed++;
+    }
+    cfg->block_count = kept;
+    return removed;
+}
+
+// --- Jump Threading ---
+
+// Follows a chain of forwarding blocks to the first block that does real
+// work. A cycle made only of forwarding blocks stops at the block where
+// the walk first comes back around.
+static BasicBlock* thread_target(CFG* cfg, BasicBlock* block) {
+    begin_cfg_visit(cfg);
+    while (is_forwarding_block(cfg, block) && visit_block(cfg, block)) {
+        block = block->successors[0];
+    }
+    return block;
+}
+
+static int thread_jumps(CFG* cfg) {
+    int threaded = 0;
+    for (int i = 0; i < cfg->block_count; i++) {
+        BasicBlock* block = cfg->blocks[i];
+        for (int j = 0; j < block->successor_count; j++) {
+            BasicBlock* succ = block->successors[j];
+            if (!is_forwarding_block(cfg, succ)) continue;
+            BasicBlock* target = thread_target(cfg, succ);
+            // Threading into a phi block would change its predecessors
+            if (target == succ || target->phi_nodes->count > 0) continue;
+            redirect_edges(block, succ, target);
+            threaded++;
+        }
+    }
+    return threaded;
+}
+
+// --- Block Merging ---
+
+static bool can_merge_into(CFG* cfg, BasicBlock* block) {
+    if (block->successor_count != 1) return false;
+    BasicBlock* succ = block->successors[0];
+    if (succ == block || succ == cfg->entry || succ == cfg->exit) return false;
+    if (succ->predecessor_count != 1 || succ->phi_nodes->count > 0) return false;
+    
+    SSAInstruction* last = last_instruction(block);
+    return !last || last->type == SSA_JUMP || !is_control_instruction(last);
+}
+
+// Appends the sole successor's instructions and edges to block; the
+// emptied successor is left unreachable
+static void merge_successor(BasicBlock* block) {
+    BasicBlock* succ = block->successors[0];
+    InstructionList* list = block->instructions;
+    
+    SSAInstruction* last = last_instruction(block);
+    if (last && last->type == SSA_JUMP) {
+        remove_instruction(list, list->count - 1);
+    }
+    
+    // Moving the pointers keeps their def-use links intact
+    InstructionList* moved = succ->instructions;
+    for (int i = 0; i < moved->count; i++) {
+        if (list->count >= list->capacity) {
+            int new_capacity = list->capacity == 0 ? 4 : list->capacity * 2;
+            SSAInstruction** grown = realloc(list->items, new_capacity * sizeof(SSAInstruction*));
+            if (!grown) return;
+            list->items = grown;
+            list->capacity = new_capacity;
+        }
+        list->items[list->count++] = moved->items[i];
+    }
+    moved->count = 0;
+    
+    remove_edge(block, succ);
+    while (succ->successor_count > 0) {
+        BasicBlock* next = succ->successors[0];
+        remove_edge(succ, next);
+        add_edge(block, next);
+    }
+}
+
+static int merge_blocks(CFG* cfg) {
+    int merged = 0;
+    for (int i = 0; i < cfg->block_count; i++) {
+        BasicBlock* block = cfg->blocks[i];
+        if (block->predecessor_count == 0 && block != cfg->entry) continue;  // Already absorbed
+        while (can_merge_into(cfg, block)) {
+            merge_successor(block);
+            merged++;
+        }
+    }
+    return merged;
+}
+
+// --- Loop Rotation ---
+
+static bool block_holds_instruction(BasicBlock* block, SSAInstruction* instr) {
+    for (int i = 0; i < block->instructions->count; i++) {
+        if (block->instructions->items[i] == instr) return true;
+    }
+    return false;
+}
+
+// A loop test that can be duplicated: temporaries read only inside the
+// header, ending in a two-way branch
+static bool is_rotatable_header(CFG* cfg, BasicBlock* header) {
+    if (header == cfg->entry || header == cfg->exit) return false;
+    if (header->successor_count != 2 || header->phi_nodes->count > 0) return false;
+    
+    SSAInstruction* last = last_instruction(header);
+    if (!last || last->type != SSA_BRANCH) return false;
+    
+    InstructionList* list = header->instructions;
+    for (int i = 0; i < list->count - 1; i++) {
+        SSAInstruction* instr = list->items[i];
+        if (instr->type != SSA_BINARY_OP && instr->type != SSA_UNARY_OP && instr->type != SSA_ASSIGN) return false;
+        if (!instr->dest || instr->dest->type != SSA_TEMP) return false;
+        for (int j = 0; j < instr->dest->use_count; j++) {
+            SSAInstruction* user = instr->dest->uses[j].user;
+            if (!user || !block_holds_instruction(header, user)) return false;
+        }
+    }
+    return true;
+}
+
+static int next_free_temp_id(CFG* cfg) {
+    int next = 0;
+    for (int i = 0; i < cfg->block_count; i++) {
+        InstructionList* list = cfg->blocks[i]->instructions;
+        for (int j = 0; j < list->count; j++) {
+            SSAValue* dest = list->items[j]->dest;
+            if (dest && dest->type == SSA_TEMP && dest->data.temp_id >= next) {
+                next = dest->data.temp_id + 1;
+            }
+        }
+    }
+    return next;
+}
+
+// The copy of header's value at this operand: a fresh temporary if the
+// header computed it, otherwise the value itself
+static SSAValue* rotated_operand(InstructionList* list, SSAValue** copies, int count, SSAValue* operand) {
+    for (int i = 0; i < count; i++) {
+        if (list->items[i]->dest == operand) return copies[i];
+    }
+    return operand;
+}
+
+// Replaces latch's jump to header with a copy of header's test
+static void rotate_latch(CFG* cfg, BasicBlock* latch, BasicBlock* header, int* next_temp) {
+    InstructionList* list = header->instructions;
+    int count = list->count - 1;
+    SSAInstruction* branch = list->items[count];
+    SSAValue** copies = count > 0 ? malloc(count * sizeof(SSAValue*)) : NULL;
+    if (count > 0 && !copies) return;
+    
+    remove_instruction(latch->instructions, latch->instructions->count - 1);
+    for (int i = 0; i < count; i++) {
+        SSAInstruction* instr = list->items[i];
+        SSAValue* left = rotated_operand(list, copies, i, instr->operands[0]);
+        copies[i] = create_ssa_temp(cfg, (*next_temp)++);
+        SSAInstruction* copy;
+        if (instr->type == SSA_BINARY_OP) {
+            SSAValue* right = rotated_operand(list, copies, i, instr->operands[1]);
+            copy = create_ssa_binary_op(copies[i], instr->data.op_data.op, left, right);
+        } else if (instr->type == SSA_UNARY_OP) {
+            copy = create_ssa_unary_op(copies[i], instr->data.op_data.op, left);
+        } else {
+            copy = create_ssa_assign(copies[i], left);
+        }
+        add_instruction(latch->instructions, copy);
+    }
+    
+    BasicBlock* true_target = branch->data.branch_data.true_target;
+    BasicBlock* false_target = branch->data.branch_data.false_target;
+    SSAValue* condition = rotated_operand(list, copies, count, branch->data.branch_data.condition);
+    add_instruction(latch->instructions, create_ssa_branch(condition, true_target, false_target));
+    free(copies);
+    
+    // Arm order matches the header's: true successor first
+    remove_edge(latch, header);
+    add_edge(latch, true_target);
+    add_edge(latch, false_target);
+}
+
+int rotate_cfg_loops(CFG* cfg) {
+    if (!cfg || !cfg->entry) return 0;
+    compute_dominators(cfg);
+    
+    // Gather the back edges first; rotating changes the dominator tree
+    BasicBlock** latches = malloc(cfg->block_count * sizeof(BasicBlock*));
+    BasicBlock** headers = malloc(cfg->block_count * sizeof(BasicBlock*));
+    if (!latches || !headers) {
+        free(latches);
+        free(headers);
+        return 0;
+    }
+    int count = 0;
+    for (int i = 0; i < cfg->block_count; i++) {
+        BasicBlock* latch = cfg->blocks[i];
+        if (latch->successor_count != 1) continue;
+        BasicBlock* header = latch->successors[0];
+        SSAInstruction* last = last_instruction(latch);
+        if (latch == header || !last || last->type != SSA_JUMP) continue;
+        if (!dominates(header, latch) || !is_rotatable_header(cfg, header)) continue;
+        latches[count] = latch;
+        headers[count] = header;
+        count++;
+    }
+    
+    int next_temp = next_free_temp_id(cfg);
+    for (int i = 0; i < count; i++) {
+        rotate_latch(cfg, latches[i], headers[i], &next_temp);
+    }
+    free(latches);
+    free(headers);
+    
+    print_debug("DEBUG: rotate_cfg_loops: rotated %d latches\n", count);
+    return count;
+}
+
+// --- Block Placement ---
+
+// A block at loop depth d is taken to run LOOP_WEIGHT^d times as often as
+// one outside every loop
+#define LOOP_WEIGHT 8
+#define MAX_WEIGHTED_DEPTH 16
+
+BasicBlock* fall_through_successor(BasicBlock* block) {
+    if (block->successor_count == 1) return block->successors[0];
+    if (block->successor_count == 2) {
+        // Without a branch the block just jumps to its first successor
+        SSAInstruction* last = last_instruction(block);
+        return last && last->type == SSA_BRANCH ? block->successors[1] : block->successors[0];
+    }
+    return NULL;
+}
+
+// Loop nesting depth of each block, by id: how many natural loops hold it.
+// A header's loop is every block that reaches one of its back edges
+// without passing through the header.
+static int* compute_loop_depths(CFG* cfg, BasicBlock** stack) {
+    int* depth = calloc(cfg->next_block_id, sizeof(int));
+    if (!depth) return NULL;
+    compute_dominators(cfg);
+    
+    for (int i = 0; i < cfg->block_count; i++) {
+        BasicBlock* header = cfg->blocks[i];
+        int top = 0;
+        bool is_header = false;
+        begin_cfg_visit(cfg);
+        visit_block(cfg, header);
+        for (int p = 0; p < header->predecessor_count; p++) {
+            BasicBlock* latch = header->predecessors[p];
+            if (!dominates(header, latch)) continue;
+            is_header = true;
+            if (visit_block(cfg, latch)) {
+                stack[top++] = latch;
+            }
+        }
+        if (!is_header) continue;
+        depth[header->id]++;
+        while (top > 0) {
+            BasicBlock* block = stack[--top];
+            depth[block->id]++;
+            for (int p = 0; p < block->predecessor_count; p++) {
+                if (visit_block(cfg, block->predecessors[p])) {
+                    stack[top++] = block->predecessors[p];
+                }
+            }
+        }
+    }
+    return depth;
+}
+
+static uint64_t edge_weight(const int* depth, BasicBlock* from, BasicBlock* to) {
+    int d = depth[from->id] < depth[to->id] ? depth[from->id] : depth[to->id];
+    if (d > MAX_WEIGHTED_DEPTH) d = MAX_WEIGHTED_DEPTH;
+    uint64_t weight = 1;
+    while (d-- > 0) weight *= LOOP_WEIGHT;
+    return weight;
+}
+
+typedef struct {
+    BasicBlock* from;
+    BasicBlock* to;
+    uint64_t weight;
+    int position;   // from's index in cfg->blocks, to keep ties in source order
+} FallThroughEdge;
+
+static int compare_fall_through_edges(const void* a, const void* b) {
+    const FallThroughEdge* x = a;
+    const FallThroughEdge* y = b;
+    if (x->weight != y->weight) return x->weight > y->weight ? -1 : 1;
+    return x->position - y->position;
+}
+
+static BasicBlock* chain_head(BasicBlock** chain_prev, BasicBlock* block) {
+    while (chain_prev[block->id]) block = chain_prev[block->id];
+    return block;
+}
+
+int place_cfg_blocks(CFG* cfg) {
+    if (!cfg || !cfg->entry || cfg->block_count < 2) return 0;
+    int count = cfg->block_count;
+    int ids = cfg->next_block_id;
+    
+    BasicBlock** stack = malloc(count * sizeof(BasicBlock*));
+    BasicBlock** order = malloc(count * sizeof(BasicBlock*));
+    BasicBlock** chain_next = calloc(ids, sizeof(BasicBlock*));
+    BasicBlock** chain_prev = calloc(ids, sizeof(BasicBlock*));
+    uint64_t* pull = calloc(ids, sizeof(uint64_t));     // Heaviest edge into a chain head from placed blocks
+    bool* placed = calloc(ids, sizeof(bool));
+    FallThroughEdge* edges = malloc(count * sizeof(FallThroughEdge));
+    int* depth = stack ? compute_loop_depths(cfg, stack) : NULL;
+    if (!stack || !order || !chain_next || !chain_prev || !pull || !placed || !edges || !depth) {
+        free(stack); free(order); free(chain_next); free(chain_prev);
+        free(pull); free(placed); free(edges); free(depth);
+        return 0;
+    }
+    
+    // Chain the heaviest fall-through edges first. The entry has to stay
+    // at address 0, so nothing falls into it.
+    int edge_count = 0;
+    for (int i = 0; i < count; i++) {
+        BasicBlock* block = cfg->blocks[i];
+        BasicBlock* target = fall_through_successor(block);
+        if (target && target != block && target != cfg->entry) {
+            edges[edge_count++] = (FallThroughEdge){ block, target, edge_weight(depth, block, target), i };
+        }
+    }
+    qsort(edges, edge_count, sizeof(FallThroughEdge), compare_fall_through_edges);
+    for (int i = 0; i < edge_count; i++) {
+        BasicBlock* from = edges[i].from;
+        BasicBlock* to = edges[i].to;
+        if (chain_next[from->id] || chain_prev[to->id] || chain_head(chain_prev, from) == to) continue;
+        chain_next[from->id] = to;
+        chain_prev[to->id] = from;
+    }
+    
+    // Lay out the entry's chain, then whichever chain the placed blocks
+    // reach most heavily, until every chain is placed
+    int placed_count = 0;
+    BasicBlock* head = cfg->entry;
+    while (head) {
+        for (BasicBlock* block = head; block; block = chain_next[block->id]) {
+            placed[block->id] = true;
+            order[placed_count++] = block;
+        }
+        for (BasicBlock* block = head; block; block = chain_next[block->id]) {
+            for (int s = 0; s < block->successor_count; s++) {
+                BasicBlock* target = block->successors[s];
+                if (placed[target->id]) continue;
+                BasicBlock* target_head = chain_head(chain_prev, target);
+                uint64_t weight = edge_weight(depth, block, target);
+                if (weight > pull[target_head->id]) pull[target_head->id] = weight;
+            }
+        }
+        
+        head = NULL;
+        for (int i = 0; i < count; i++) {
+            BasicBlock* block = cfg->blocks[i];
+            if (placed[block->id] || chain_prev[block->id]) continue;
+            if (!head || pull[block->id] > pull[head->id]) head = block;
+        }
+    }
+    
+    int fall_throughs = 0;
+    for (int i = 0; i < count; i++) {
+        cfg->blocks[i] = order[i];
+        if (i + 1 < count && fall_through_successor(order[i]) == order[i + 1]) fall_throughs++;
+    }
+    print_debug("DEBUG: place_cfg_blocks: %d of %d blocks fall through\n", fall_throughs, count);
+    
+    free(stack); free(order); free(chain_next); free(chain_prev);
+    free(pull); free(placed); free(edges); free(depth);
+    return fall_throughs;
+}
+
+// --- Entry Point ---
+
+CFGSimplifyStats simplify_cfg(CFG* cfg) {
+    CFGSimplifyStats stats = {0, 0, 0};
+    if (!cfg || !cfg->entry) return stats;
+    
+    stats.unreachable_blocks_removed += remove_unreachable_blocks(cfg);
+    stats.jumps_threaded = thread_jumps(cfg);
+    stats.blocks_merged = merge_blocks(cfg);
+    // Threading and merging orphan the blocks they bypass
+    stats.unreachable_blocks_removed += remove_unreachable_blocks(cfg);
+    
+    print_debug("DEBUG: simplify_cfg: removed %d unreachable blocks, threaded %d jumps, merged %d blocks\n",
+                stats.unreachable_blocks_removed, stats.jumps_threaded, stats.blocks_merged);
+    return stats;
+}
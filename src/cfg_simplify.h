@@ -0,0 +1,45 @@
+#ifndef CFG_SIMPLIFY_H
+#define CFG_SIMPLIFY_H
+
+#include "cfg.h"
+
+// Counts of what simplify_cfg changed
+typedef struct {
+    int unreachable_blocks_removed;
+    int jumps_threaded;              // Edges redirected past a jump-only block
+    int blocks_merged;
+} CFGSimplifyStats;
+
+// Structural cleanup run before microcode emission: removes blocks
+// unreachable from the entry, threads edges through blocks that only jump
+// onward, and merges a block into its sole successor when it is that
+// successor's only predecessor. The entry and exit blocks are kept, and
+// blocks with phi nodes are left alone.
+CFGSimplifyStats simplify_cfg(CFG* cfg);
+
+// Optional loop rotation (--rotate-loops), for the CFG and compact paths
+extern int rotate_loops;
+
+// Copies each loop's test onto the end of its latches, so an iteration
+// branches straight back into the body instead of jumping to the header
+// first; the header stays behind as the guard run once on entry. Only
+// headers whose test reads nothing but header-local temporaries are
+// rotated. Returns the number of latches rewritten.
+int rotate_cfg_loops(CFG* cfg);
+
+// Optional block placement (--layout-blocks), for the CFG path
+extern int layout_blocks;
+
+// The successor whose jump word disappears when it is placed right after
+// block: the sole successor, or a branch's false arm (the true arm is the
+// branch word's own jadr). NULL for a block with no such successor.
+BasicBlock* fall_through_successor(BasicBlock* block);
+
+// Reorders cfg->blocks so hot successors follow their predecessor, Pettis-
+// Hansen style: fall-through edges, weighted by the loop depth they run
+// at, join chains heaviest first, and the chains are laid out from the
+// entry's, each followed by the one it reaches most heavily. Returns the
+// number of blocks that now fall through to their successor.
+int place_cfg_blocks(CFG* cfg);
+
+#endif // CFG_SIMPLIFY_H
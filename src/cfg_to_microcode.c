@@ -2,6 +2,7 @@
 #include "cfg_to_microcode.h"
 #include "microcode_defs.h" // Include new microcode definitions
 #include "ast_to_microcode.h" // Include CompactMicrocode definition
+#include "cfg_simplify.h" // For layout_blocks
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -18,6 +19,13 @@ static char* generate_instruction_label(SSAInstruction* instr, BasicBlock* block
 /* static bool is_boolean_expression(Node* expr); */
 /* Unused prototype: original idea for expression classification, not implemented. */
 static int count_expected_instructions(CFG* cfg);
+static SSAInstruction* block_branch(FrozenCFG* layout, int index);
+static bool falls_through(int index, int target);
+static bool single_exit(FrozenCFG* layout, int index);
+static int copy_carrier(HotstateMicrocode* mc, int index);
+static void add_copies(MCode* mcode, MCode copy);
+static void add_copy_word(HotstateMicrocode* mc, MCode copy, BasicBlock* block, BasicBlock* target);
+static int block_word_count(HotstateMicrocode* mc, int index);
 
 // --- Main Translation Function ---
 
@@ -28,18 +36,21 @@ HotstateMicrocode* cfg_to_hotstate_microcode(CFG* cfg, HardwareContext* hw_ctx)
     
     HotstateMicrocode* mc = create_hotstate_microcode(cfg, hw_ctx);
     
-    // Phase 1: Build address mapping for all blocks
+    // Phase 1: Work out the state bits phi nodes copy on each edge
+    plan_phi_copies(mc);
+    
+    // Phase 2: Build address mapping for all blocks
     build_address_mapping(mc);
     
-    // Phase 2: Translate each basic block to microcode
-    for (int i = 0; i < cfg->block_count; i++) {
-        translate_basic_block(mc, cfg->blocks[i]);
+    // Phase 3: Translate each basic block to microcode
+    for (int i = 0; i < mc->layout->block_count; i++) {
+        translate_basic_block(mc, mc->layout->blocks[i]);
     }
     
-    // Phase 3: Resolve jump addresses
+    // Phase 4: Resolve jump addresses
     resolve_jump_addresses(mc);
     
-    // Phase 4: Validate the generated microcode
+    // Phase 5: Validate the generated microcode
     if (!validate_microcode(mc)) {
         printf("Warning: Generated microcode failed validation\n");
     }
@@ -55,8 +66,7 @@ void translate_basic_block(HotstateMicrocode* mc, BasicBlock* block) {
     // Record the starting address for this block
     mc->block_addresses[block->id] = mc->instruction_count;
     
-    // Translate phi nodes (if any)
-    translate_phi_nodes(mc, block);
+    // Phi nodes cost no words of their own; see plan_phi_copies
     
     // Translate regular SSA instructions
     translate_instructions(mc, block);
@@ -65,61 +75,64 @@ void translate_basic_block(HotstateMicrocode* mc, BasicBlock* block) {
     translate_control_flow(mc, block);
 }
 
-void translate_phi_nodes(HotstateMicrocode* mc, BasicBlock* block) {
-    if (!block->phi_nodes) return;
-    
-    // For now, phi nodes are handled by state assignments
-    // In a more sophisticated implementation, we would need to
-    // generate conditional assignments based on predecessor blocks
-    for (int i = 0; i < block->phi_nodes->count; i++) {
-        PhiNode* phi = block->phi_nodes->items[i];
+// Out-of-SSA translation. Every version of a variable lives in the same
+// state bit, so a phi operand that is a version of the phi's own variable,
+// or a phi over a variable with no state bit, needs no code at all. Any
+// other operand becomes a write of the phi's bit on the edge from its
+// block, which the predecessor folds into a word it emits anyway where it
+// can: its last state assignment or its jump.
+void plan_phi_copies(HotstateMicrocode* mc) {
+    FrozenCFG* layout = mc->layout;
+    mc->edge_copies = calloc(2 * layout->block_count + 1, sizeof(MCode));
+    
+    for (int i = 0; i < layout->block_count; i++) {
+        BasicBlock* block = layout->blocks[i];
+        int* succs = layout->succs + layout->succ_offsets[i];
+        int successor_count = layout->succ_offsets[i + 1] - layout->succ_offsets[i];
         
-        // Generate a comment instruction for phi nodes
-        char label[256];
-        snprintf(label, sizeof(label), "phi: %s", 
-                ssa_value_to_string(phi->dest));
-        
-        // Populate MCode struct for NOP
-        MCode nop_mcode = {0}; // All fields to 0
-        nop_mcode.forced_jmp = 1; // NOP usually means just continue
-        add_hotstate_instruction(mc, nop_mcode, label, block);
-        print_debug("DEBUG: translate_phi_nodes: Added NOP MCode (forced_jmp: %d)\n", nop_mcode.forced_jmp);
+        for (int slot = 0; slot < successor_count && slot < 2; slot++) {
+            PhiNodeList* phis = layout->blocks[succs[slot]]->phi_nodes;
+            MCode* copy = &mc->edge_copies[2 * i + slot];
+            for (int j = 0; phis && j < phis->count; j++) {
+                PhiNode* phi = phis->items[j];
+                int bit = get_state_bit_from_ssa_value(phi->dest, mc->hw_ctx);
+                if (bit < 0) continue;
+                
+                for (int k = 0; k < phi->operand_count; k++) {
+                    if (phi->operands[k].block != block) continue;
+                    SSAValue* value = phi->operands[k].value;
+                    if (get_state_bit_from_ssa_value(value, mc->hw_ctx) != bit) {
+                        // A constant writes its value; anything else sets the
+                        // bit, as encode_state_assignment does for assignments
+                        bool clear = value && value->type == SSA_CONST && value->data.const_value == 0;
+                        copy->mask |= 1u << bit;
+                        if (!clear) copy->state |= 1u << bit;
+                    }
+                    break;
+                }
+            }
+        }
     }
 }
 
 void translate_instructions(HotstateMicrocode* mc, BasicBlock* block) {
-    if (!block->instructions) return;
+    FrozenCFG* layout = mc->layout;
+    int index = layout->index_of_id[block->id];
+    int carrier = copy_carrier(mc, index);
     
-    for (int i = 0; i < block->instructions->count; i++) {
-        SSAInstruction* instr = block->instructions->items[i];
+    for (int i = layout->instr_offsets[index]; i < layout->instr_offsets[index + 1]; i++) {
+        SSAInstruction* instr = layout->instrs[i];
         MCode mcode = {0}; // Initialize all fields to 0
         char* label = generate_instruction_label(instr, block);
         
-        switch (instr->type) {
-            case SSA_ASSIGN:
-                if (is_state_assignment(instr, mc->hw_ctx)) {
-                    // For now, encode_state_assignment returns uint32_t.
-                    // We need to convert it to MCode. This is a temporary solution.
-                    // Later, encode_state_assignment should directly return MCode.
-                    mcode = encode_state_assignment(instr, mc->hw_ctx);
-
-                    mc->state_assignments++;
-                } else {
-                    mcode.forced_jmp = 1; // NOP
-                }
-                break;
-                
-            case SSA_BINARY_OP:
-                mcode.forced_jmp = 1; // NOP
-                break;
-                
-            case SSA_CALL:
-                mcode.forced_jmp = 1; // NOP
-                break;
-                
-            default:
-                mcode.forced_jmp = 1; // NOP
-                break;
+        if (instr->type == SSA_ASSIGN && is_state_assignment(instr, mc->hw_ctx)) {
+            mcode = encode_state_assignment(instr, mc->hw_ctx);
+            mc->state_assignments++;
+        } else {
+            mcode = encode_nop_instruction();
+        }
+        if (i == carrier) {
+            add_copies(&mcode, mc->edge_copies[2 * index]);
         }
         
         add_hotstate_instruction(mc, mcode, label, block);
@@ -130,7 +143,15 @@ void translate_instructions(HotstateMicrocode* mc, BasicBlock* block) {
 }
 
 void translate_control_flow(HotstateMicrocode* mc, BasicBlock* block) {
-    if (block->successor_count == 0) {
+    FrozenCFG* layout = mc->layout;
+    int index = layout->index_of_id[block->id];
+    int* succs = layout->succs + layout->succ_offsets[index];
+    int successor_count = layout->succ_offsets[index + 1] - layout->succ_offsets[index];
+    // Copies on a single exit edge that no state assignment carried
+    MCode copy = mc->edge_copies[2 * index];
+    bool pending = copy.mask && copy_carrier(mc, index) < 0;
+    
+    if (successor_count == 0) {
         // Terminal block - add halt/return instruction
         MCode halt_mcode = {0};
         halt_mcode.forced_jmp = 1; // Or some other halt instruction
@@ -139,12 +160,17 @@ void translate_control_flow(HotstateMicrocode* mc, BasicBlock* block) {
         return;
     }
     
-    if (block->successor_count == 1) {
-        // Unconditional jump to successor
-        BasicBlock* target = block->successors[0];
+    if (successor_count == 1) {
+        // Unconditional jump to successor, unless it is laid out next
+        BasicBlock* target = layout->blocks[succs[0]];
+        if (falls_through(index, succs[0])) {
+            if (pending) add_copy_word(mc, copy, block, target);
+            return;
+        }
         int target_addr = get_block_address(mc, target);
         // Temporary: encode_unconditional_jump still returns uint32_t
         MCode jump_mcode = encode_unconditional_jump(target_addr);
+        if (pending) add_copies(&jump_mcode, copy);
         
         char label[64];
         snprintf(label, sizeof(label), "jump -> block_%d", target->id);
@@ -152,22 +178,20 @@ void translate_control_flow(HotstateMicrocode* mc, BasicBlock* block) {
         mc->jumps++;
         print_debug("DEBUG: translate_control_flow: Added JUMP MCode (jadr: %d, forced_jmp: %d)\n", jump_mcode.jadr, jump_mcode.forced_jmp);
         
-    } else if (block->successor_count == 2) {
+    } else if (successor_count == 2) {
         // Conditional branch - need to find the branch condition
-        BasicBlock* true_target = block->successors[0];
-        BasicBlock* false_target = block->successors[1];
-        
-        // Look for branch instruction in the block
-        SSAInstruction* branch_instr = NULL;
-        if (block->instructions && block->instructions->count > 0) {
-            SSAInstruction* last_instr = block->instructions->items[block->instructions->count - 1];
-            if (last_instr->type == SSA_BRANCH) {
-                branch_instr = last_instr;
-            }
-        }
+        BasicBlock* true_target = layout->blocks[succs[0]];
+        BasicBlock* false_target = layout->blocks[succs[1]];
         
+        SSAInstruction* branch_instr = block_branch(layout, index);
         if (branch_instr) {
-            int true_addr = get_block_address(mc, true_target);
+            // Copies on the true edge go in a jump word of their own at the
+            // end of the block, which the branch targets instead
+            MCode true_copy = mc->edge_copies[2 * index];
+            MCode false_copy = mc->edge_copies[2 * index + 1];
+            bool stub = true_copy.mask != 0;
+            int true_addr = stub ? get_block_address(mc, block) + block_word_count(mc, index) - 1
+                                 : get_block_address(mc, true_target);
             int false_addr = get_block_address(mc, false_target);
             // Temporary: encode_conditional_branch still returns uint32_t
             MCode branch_mcode = encode_conditional_branch(branch_instr, mc->hw_ctx, true_addr, false_addr);
@@ -180,17 +204,36 @@ void translate_control_flow(HotstateMicrocode* mc, BasicBlock* block) {
             print_debug("DEBUG: translate_control_flow: Added BRANCH MCode (jadr: %d, varSel: %d, branch: %d, var_or_timer: %d)\n",
                    branch_mcode.jadr, branch_mcode.varSel, branch_mcode.branch, branch_mcode.var_or_timer);
             
-            // Add unconditional jump for false case (next instruction)
+            // Add unconditional jump for false case (next instruction),
+            // unless the false block is laid out right after this one
+            if (falls_through(index, succs[1]) && !stub) {
+                if (false_copy.mask) add_copy_word(mc, false_copy, block, false_target);
+                return;
+            }
             MCode false_jump_mcode = encode_unconditional_jump(false_addr);
+            add_copies(&false_jump_mcode, false_copy);
 
             snprintf(label, sizeof(label), "false -> block_%d", false_target->id);
             add_hotstate_instruction(mc, false_jump_mcode, label, block);
             mc->jumps++;
             print_debug("DEBUG: translate_control_flow: Added FALSE JUMP MCode (jadr: %d, forced_jmp: %d)\n", false_jump_mcode.jadr, false_jump_mcode.forced_jmp);
+            
+            if (stub) {
+                MCode stub_mcode = encode_unconditional_jump(get_block_address(mc, true_target));
+                add_copies(&stub_mcode, true_copy);
+                snprintf(label, sizeof(label), "phi copies, jump -> block_%d", true_target->id);
+                add_hotstate_instruction(mc, stub_mcode, label, block);
+                mc->jumps++;
+            }
         } else {
             // No explicit branch instruction - generate default behavior
+            if (falls_through(index, succs[0])) {
+                if (pending) add_copy_word(mc, copy, block, true_target);
+                return;
+            }
             int target_addr = get_block_address(mc, true_target);
             MCode jump_mcode = encode_unconditional_jump(target_addr);
+            if (pending) add_copies(&jump_mcode, copy);
             add_hotstate_instruction(mc, jump_mcode, "default_jump", block);
             mc->jumps++;
             print_debug("DEBUG: translate_control_flow: Added DEFAULT JUMP MCode (jadr: %d, forced_jmp: %d)\n", jump_mcode.jadr, jump_mcode.forced_jmp);
@@ -210,11 +253,6 @@ MCode encode_state_assignment(SSAInstruction* instr, HardwareContext* hw_ctx) {
         mcode.state = (1 << state_bit);
         mcode.mask = (1 << state_bit);
         
-        // Set forced jump flag (continue to next instruction)
-        mcode.forced_jmp = 1;
-        
-        // Jump address will be resolved later
-        mcode.jadr = 0;
     }
     
     return mcode;
@@ -231,7 +269,7 @@ MCode encode_conditional_branch(SSAInstruction* instr, HardwareContext* hw_ctx,
         mcode.varSel = input_num;
         
         // Set jump address (true branch)
-        mcode.jadr = (true_addr & 0xF);
+        mcode.jadr = true_addr;
         
         // Set branch and variable flags
         mcode.branch = 1;
@@ -245,7 +283,7 @@ MCode encode_unconditional_jump(int target_addr) {
     MCode mcode = {0}; // Initialize all fields to 0
     
     // Set jump address
-    mcode.jadr = (target_addr & 0xF);
+    mcode.jadr = target_addr;
     
     // Set forced jump flag
     mcode.forced_jmp = 1;
@@ -255,8 +293,7 @@ MCode encode_unconditional_jump(int target_addr) {
 
 MCode encode_nop_instruction() {
     MCode mcode = {0}; // Initialize all fields to 0
-    // NOP: no state changes, no jumps, just continue
-    mcode.forced_jmp = 1; // Continue to next instruction
+    // NOP: no state changes, no jumps, just continue to the next word
     return mcode;
 }
 
@@ -279,7 +316,7 @@ int get_state_bit_from_ssa_value(SSAValue* value, HardwareContext* hw_ctx) {
         return -1;
     }
     
-    return get_state_number_by_name(hw_ctx, value->data.var.base_name);
+    return get_state_number_by_name(hw_ctx, ssa_var_name(value));
 }
 
 int get_input_number_from_ssa_value(SSAValue* value, HardwareContext* hw_ctx) {
@@ -287,36 +324,101 @@ int get_input_number_from_ssa_value(SSAValue* value, HardwareContext* hw_ctx) {
         return -1;
     }
     
-    return get_input_number_by_name(hw_ctx, value->data.var.base_name);
+    return get_input_number_by_name(hw_ctx, ssa_var_name(value));
 }
 
 // --- Address Management ---
 
 void build_address_mapping(HotstateMicrocode* mc) {
-    mc->block_addresses = calloc(mc->block_count, sizeof(int));
-    
-    // Pre-calculate approximate instruction count per block
-    int estimated_addr = 0;
-    for (int i = 0; i < mc->source_cfg->block_count; i++) {
-        BasicBlock* block = mc->source_cfg->blocks[i];
-        mc->block_addresses[block->id] = estimated_addr;
-        
-        // Estimate instructions per block
-        int block_instructions = 1; // At least one instruction per block
-        if (block->instructions) {
-            block_instructions += block->instructions->count;
-        }
-        if (block->phi_nodes && block->phi_nodes->count > 0) {
-            block_instructions += block->phi_nodes->count;
+    // Indexed by block id, which can run past block_count once blocks
+    // have been removed
+    mc->block_addresses = calloc(mc->layout->id_count, sizeof(int));
+    
+    // Block sizes are known before translation, so forward jumps get
+    // the same addresses translate_basic_block records
+    FrozenCFG* layout = mc->layout;
+    int addr = 0;
+    for (int i = 0; i < layout->block_count; i++) {
+        mc->block_addresses[layout->blocks[i]->id] = addr;
+        addr += block_word_count(mc, i);
+    }
+}
+
+// The block's closing branch, if it ends in one
+static SSAInstruction* block_branch(FrozenCFG* layout, int index) {
+    int first_instr = layout->instr_offsets[index];
+    int last_instr = layout->instr_offsets[index + 1] - 1;
+    if (last_instr < first_instr || layout->instrs[last_instr]->type != SSA_BRANCH) return NULL;
+    return layout->instrs[last_instr];
+}
+
+// With --layout-blocks, a jump to the block laid out next is left out
+static bool falls_through(int index, int target) {
+    return layout_blocks && target == index + 1;
+}
+
+// Leaves the block along one edge only: a jump, or two successors
+// without a branch to choose between them
+static bool single_exit(FrozenCFG* layout, int index) {
+    int successor_count = layout->succ_offsets[index + 1] - layout->succ_offsets[index];
+    return successor_count == 1 || (successor_count == 2 && !block_branch(layout, index));
+}
+
+// The instruction whose state assignment word also carries the block's
+// phi copies, or -1: its last state assignment, when the block has a
+// single exit and the assignment writes none of the copied bits
+static int copy_carrier(HotstateMicrocode* mc, int index) {
+    FrozenCFG* layout = mc->layout;
+    MCode copy = mc->edge_copies[2 * index];
+    if (!copy.mask || !single_exit(layout, index)) return -1;
+    
+    for (int i = layout->instr_offsets[index + 1] - 1; i >= layout->instr_offsets[index]; i--) {
+        SSAInstruction* instr = layout->instrs[i];
+        if (is_state_assignment(instr, mc->hw_ctx)) {
+            return (encode_state_assignment(instr, mc->hw_ctx).mask & copy.mask) ? -1 : i;
         }
-        if (block->successor_count > 1) {
-            block_instructions += 2; // Branch + jump
-        } else if (block->successor_count == 1) {
-            block_instructions += 1; // Jump
+    }
+    return -1;
+}
+
+static void add_copies(MCode* mcode, MCode copy) {
+    mcode->state |= copy.state;
+    mcode->mask |= copy.mask;
+}
+
+// Copies with nothing to ride on, falling through into target
+static void add_copy_word(HotstateMicrocode* mc, MCode copy, BasicBlock* block, BasicBlock* target) {
+    MCode mcode = encode_nop_instruction();
+    add_copies(&mcode, copy);
+    char label[64];
+    snprintf(label, sizeof(label), "phi copies -> block_%d", target->id);
+    add_hotstate_instruction(mc, mcode, label, block);
+    mc->state_assignments++;
+}
+
+// Words translate_basic_block emits for the block
+static int block_word_count(HotstateMicrocode* mc, int index) {
+    FrozenCFG* layout = mc->layout;
+    int* succs = layout->succs + layout->succ_offsets[index];
+    int successor_count = layout->succ_offsets[index + 1] - layout->succ_offsets[index];
+    int words = layout->instr_offsets[index + 1] - layout->instr_offsets[index];
+    bool pending = mc->edge_copies[2 * index].mask && copy_carrier(mc, index) < 0;
+    
+    if (successor_count == 0) {
+        words += 1; // Halt
+    } else if (single_exit(layout, index)) {
+        words += falls_through(index, succs[0]) ? (pending ? 1 : 0) : 1;
+    } else if (successor_count == 2) {
+        bool stub = mc->edge_copies[2 * index].mask != 0;
+        words += 1; // Branch
+        if (falls_through(index, succs[1]) && !stub) {
+            words += mc->edge_copies[2 * index + 1].mask ? 1 : 0;
+        } else {
+            words += 1; // False jump
         }
-        
-        estimated_addr += block_instructions;
+        words += stub ? 1 : 0;
     }
+    return words;
 }
 
 void resolve_jump_addresses(HotstateMicrocode* mc) {
@@ -334,7 +436,7 @@ void resolve_jump_addresses(HotstateMicrocode* mc) {
 }
 
 int get_block_address(HotstateMicrocode* mc, BasicBlock* block) {
-    if (!block || block->id >= mc->block_count) {
+    if (!block || block->id >= mc->layout->id_count) {
         return 0;
     }
     return mc->block_addresses[block->id];
@@ -351,7 +453,7 @@ void add_hotstate_instruction(HotstateMicrocode* mc, MCode mcode_val, const char
     Code* code_entry = &mc->instructions[mc->instruction_count];
     code_entry->uword.mcode = mcode_val;
     code_entry->level = 0; // Default level for now
-    code_entry->label = label ? strdup(label) : NULL;
+    mc->labels[mc->instruction_count] = label ? strdup(label) : NULL;
     // The address and source_block can be stored as metadata in Code struct if needed
     // For now, we rely on the instruction_count as address.
     
@@ -379,6 +481,7 @@ void resize_instruction_array(HotstateMicrocode* mc) {
     mc->instruction_capacity *= 2;
     mc->instructions = realloc(mc->instructions, 
                               sizeof(Code) * mc->instruction_capacity);
+    mc->labels = realloc(mc->labels, sizeof(char*) * mc->instruction_capacity);
 }
 
 // --- Helper Functions ---
@@ -426,14 +529,17 @@ void init_hotstate_microcode(HotstateMicrocode* mc, CFG* cfg, HardwareContext* h
     print_debug("DEBUG: cfg_to_microcode.c: init_hotstate_microcode: debug_mode = %d\n", debug_mode);
     mc->instruction_capacity = count_expected_instructions(cfg);
     mc->instructions = malloc(sizeof(Code) * mc->instruction_capacity);
+    mc->labels = malloc(sizeof(char*) * mc->instruction_capacity);
     mc->instruction_count = 0;
     
     mc->hw_ctx = hw_ctx;
     mc->source_cfg = cfg;
+    mc->layout = freeze_cfg(cfg);
     mc->function_name = cfg->function_name ? strdup(cfg->function_name) : strdup("main");
     
     mc->block_addresses = NULL;
     mc->block_count = cfg->block_count;
+    mc->edge_copies = NULL;
     
     mc->state_assignments = 0;
     mc->branches = 0;
@@ -464,9 +570,6 @@ static int count_expected_instructions(CFG* cfg) {
         if (block->instructions) {
             count += block->instructions->count;
         }
-        if (block->phi_nodes) {
-            count += block->phi_nodes->count;
-        }
     }
     return count > 16 ? count : 16; // Minimum allocation
 }
@@ -476,11 +579,14 @@ void free_hotstate_microcode(HotstateMicrocode* mc) {
     
     // Free instruction labels
     for (int i = 0; i < mc->instruction_count; i++) {
-        free(mc->instructions[i].label);
+        free(mc->labels[i]);
     }
     free(mc->instructions);
+    free(mc->labels);
     
     free(mc->block_addresses);
+    free(mc->edge_copies);
+    free_frozen_cfg(mc->layout);
     free(mc->function_name);
     free(mc);
 }
@@ -12,17 +12,23 @@
 // Complete microcode program
 typedef struct {
     Code* instructions;
+    char** labels;             // Debug label of each instruction (or NULL)
     int instruction_count;
     int instruction_capacity;
     
     HardwareContext* hw_ctx;   // Hardware variable mappings
     CFG* source_cfg;           // Source control flow graph
+    FrozenCFG* layout;         // Contiguous view of source_cfg used while emitting
     char* function_name;       // Function name
     
     // Address mapping for jump resolution
     int* block_addresses;      // block_id -> instruction_address mapping
     int block_count;
     
+    // Out of SSA: the state bits phi nodes copy on each edge, indexed by
+    // 2 * layout index + successor slot (state and mask only)
+    MCode* edge_copies;
+    
     // Generation statistics
     int state_assignments;     // Number of state assignment instructions
     int branches;             // Number of branch instructions
@@ -82,7 +88,7 @@ HotstateMicrocode* cfg_to_hotstate_microcode(CFG* cfg, HardwareContext* hw_ctx);
 
 // Block-level translation
 void translate_basic_block(HotstateMicrocode* mc, BasicBlock* block);
-void translate_phi_nodes(HotstateMicrocode* mc, BasicBlock* block);
+void plan_phi_copies(HotstateMicrocode* mc);
 void translate_instructions(HotstateMicrocode* mc, BasicBlock* block);
 void translate_control_flow(HotstateMicrocode* mc, BasicBlock* block);
 
@@ -114,11 +120,51 @@ void resize_instruction_array(HotstateMicrocode* mc);
 void generate_smdata_mem_file(CompactMicrocode* mc, const char* filename);
 void generate_vardata_mem_file(CompactMicrocode* mc, const char* filename);
 
+// The same outputs written to an open stream, without the "Generated"
+// report; the generate_*_file functions are wrappers around these
+void write_microcode_params_vh(CompactMicrocode* mc, FILE* file);
+void write_smdata_mem(CompactMicrocode* mc, FILE* file);
+void write_vardata_mem(CompactMicrocode* mc, FILE* file);
+void write_switchdata_mem(CompactMicrocode* mc, FILE* file);
+void write_symbol_table(CompactMicrocode* mc, FILE* file);
+void write_image(CompactMicrocode* mc, FILE* file);
+
+// Delay counts for timer 0's timer_mem, one hex word per line; written as
+// <base>_timdata.mem only when the program has delays
+void write_timdata_mem(CompactMicrocode* mc, FILE* file);
+
+// --varsel-logic: module <base_name>_varsel_logic deciding the conditions
+// mc keeps out of the vardata ROM, for hotstate's logic_var_sel and
+// logic_lhs ports
+void write_varsel_logic(CompactMicrocode* mc, const char* base_name, FILE* file);
+
+// Binary memory image (_image.bin) loaded by the simulator in place of the
+// .mem/.vh files. Little-endian:
+//   "HSIMAGE1", uint32 version, uint32 parameter count,
+//   uint32 offset + uint32 count for vardata, switchdata and smdata,
+//   the parameters as uint32 in sim Parameters order,
+//   then the sections, each 8-byte aligned: vardata and switchdata as
+//   uint32, smdata as SMDATA_WORDS uint64s per instruction (least
+//   significant first), with its count in uint64s
+#define HOTSTATE_IMAGE_MAGIC "HSIMAGE1"
+#define HOTSTATE_IMAGE_VERSION 1
+#define HOTSTATE_IMAGE_HEADER_SIZE 40
+#define HOTSTATE_IMAGE_PARAM_COUNT 32
+#define HOTSTATE_IMAGE_NUM_VARS 18       // Parameter index of NUM_VARS, the inputs addressing a vardata LUT block
+#define HOTSTATE_IMAGE_STACK_DEPTH 30    // Parameter index of STACK_DEPTH
+#define HOTSTATE_IMAGE_SMDATA_WORDS 31   // Parameter index of SMDATA_WORDS
+// Images of programs with interrupt handlers carry one more parameter, the
+// default interrupt vector
+#define HOTSTATE_IMAGE_INTERRUPT_ADDRESS 32
+// and --pipeline images one after that, PIPELINED
+#define HOTSTATE_IMAGE_PIPELINED 33
+void generate_image_file(CompactMicrocode* mc, const char* filename);
+
 // Debug output
 void print_microcode_analysis(HotstateMicrocode* mc, FILE* output);
 // print_instruction_details will need to be updated to take MCode or Code directly
 // For now, removing the HotstateInstruction* version to avoid conflicts.
-// void print_instruction_details(Code* instr, FILE* output);
+// void print_instruction_details(Code* instr, const char* label, FILE* output);
 void print_address_mapping(HotstateMicrocode* mc, FILE* output);
 
 // --- Memory Management ---
@@ -129,7 +175,10 @@ void free_hotstate_microcode(HotstateMicrocode* mc);
 // --- Output Generation Functions (from microcode_output.c) ---
 
 char* generate_base_filename(const char* source_filename);
+char* generate_output_filepath(const char* source_filename, const char* suffix);
 void generate_all_output_files(CompactMicrocode* mc, const char* source_filename);
+void print_microcode_encoding_analysis(CompactMicrocode* mc, FILE* output);
+void print_dispatch_cost_analysis(CompactMicrocode* mc, FILE* output);
 
 // --- Validation ---
 
@@ -139,5 +188,10 @@ bool check_variable_references(HotstateMicrocode* mc);
 
 // Global configuration variables (extern declarations)
 extern int switch_offset_bits;
+extern int narrow_microcode_fields;
+extern int report_microcode_encoding;
+extern int report_dispatch_costs;
+extern int vardata_word_bits;   // --vardata-bits: LUT bits per vardata .mem word, a power of two up to 32
+extern int sparse_vardata;      // --vardata-sparse: skip zero runs in the vardata .mem with @address lines
 
 #endif // CFG_TO_MICROCODE_H
\ No newline at end of file
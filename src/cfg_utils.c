@@ -356,19 +356,14 @@ void print_phi_node(PhiNode* phi) {
 void find_unreachable_blocks(CFG* cfg) {
     if (!cfg || !cfg->entry) return;
     
-    // Mark all blocks as not visited
-    for (int i = 0; i < cfg->block_count; i++) {
-        cfg->blocks[i]->visited = false;
-    }
-    
     // Mark reachable blocks starting from entry
-    mark_reachable_blocks(cfg->entry);
+    mark_reachable_blocks(cfg);
     
     // Report unreachable blocks
     printf("Unreachable blocks: ");
     int unreachable_count = 0;
     for (int i = 0; i < cfg->block_count; i++) {
-        if (!cfg->blocks[i]->visited) {
+        if (!is_block_visited(cfg, cfg->blocks[i])) {
             if (unreachable_count > 0) printf(", ");
             printf("bb%d", cfg->blocks[i]->id);
             unreachable_count++;
@@ -382,35 +377,220 @@ void find_unreachable_blocks(CFG* cfg) {
 
 int count_reachable_blocks(CFG* cfg) {
     if (!cfg || !cfg->entry) return 0;
+    return mark_reachable_blocks(cfg);
+}
+
+// Marks every block reachable from the entry as visited in a new epoch
+int mark_reachable_blocks(CFG* cfg) {
+    BasicBlock** order = malloc(sizeof(BasicBlock*) * (cfg->block_count + 1));
+    if (!order) return 0;
+    int count = cfg_walk(cfg, CFG_WALK_PREORDER, order);
+    free(order);
+    return count;
+}
+
+// --- Traversal ---
+
+unsigned int begin_cfg_visit(CFG* cfg) {
+    // On wraparound, old marks could alias the new epoch; clear them once
+    if (++cfg->visit_epoch == 0) {
+        for (int i = 0; i < cfg->block_count; i++) {
+            cfg->blocks[i]->visit_mark = 0;
+        }
+        cfg->visit_epoch = 1;
+    }
+    return cfg->visit_epoch;
+}
+
+bool visit_block(CFG* cfg, BasicBlock* block) {
+    if (block->visit_mark == cfg->visit_epoch) return false;
+    block->visit_mark = cfg->visit_epoch;
+    return true;
+}
+
+bool is_block_visited(CFG* cfg, BasicBlock* block) {
+    return block->visit_mark == cfg->visit_epoch;
+}
+
+// Explicit-stack walks, so deep or goto-heavy graphs cannot overflow the
+// C stack. Depth-first walks keep each block's next successor index
+// beside it on the stack.
+int cfg_walk(CFG* cfg, CFGWalkOrder walk_order, BasicBlock** order) {
+    if (!cfg || !cfg->entry || !order) return 0;
+    
+    int capacity = cfg->block_count + 1;
+    BasicBlock** stack = malloc(sizeof(BasicBlock*) * capacity);
+    int* next_succ = malloc(sizeof(int) * capacity);
+    if (!stack || !next_succ) {
+        free(stack);
+        free(next_succ);
+        return 0;
+    }
+    
+    begin_cfg_visit(cfg);
+    visit_block(cfg, cfg->entry);
+    int count = 0;
+    
+    if (walk_order == CFG_WALK_BREADTH_FIRST) {
+        // The output doubles as the queue
+        order[count++] = cfg->entry;
+        for (int head = 0; head < count; head++) {
+            BasicBlock* block = order[head];
+            for (int i = 0; i < block->successor_count; i++) {
+                if (visit_block(cfg, block->successors[i])) {
+                    order[count++] = block->successors[i];
+                }
+            }
+        }
+    } else {
+        int depth = 0;
+        stack[depth] = cfg->entry;
+        next_succ[depth++] = 0;
+        if (walk_order == CFG_WALK_PREORDER) {
+            order[count++] = cfg->entry;
+        }
+        while (depth > 0) {
+            BasicBlock* block = stack[depth - 1];
+            if (next_succ[depth - 1] < block->successor_count) {
+                BasicBlock* succ = block->successors[next_succ[depth - 1]++];
+                if (visit_block(cfg, succ)) {
+                    if (walk_order == CFG_WALK_PREORDER) {
+                        order[count++] = succ;
+                    }
+                    stack[depth] = succ;
+                    next_succ[depth++] = 0;
+                }
+                continue;
+            }
+            if (walk_order != CFG_WALK_PREORDER) {
+                order[count++] = block;
+            }
+            depth--;
+        }
+        if (walk_order == CFG_WALK_REVERSE_POSTORDER) {
+            for (int i = 0, j = count - 1; i < j; i++, j--) {
+                BasicBlock* swap = order[i];
+                order[i] = order[j];
+                order[j] = swap;
+            }
+        }
+    }
+    
+    free(stack);
+    free(next_succ);
+    return count;
+}
+
+// --- Dominance ---
+
+// Fills order with the reachable blocks in reverse postorder and numbers
+// them in postorder. Unreachable blocks get post_order_num -1.
+int compute_reverse_postorder(CFG* cfg, BasicBlock** order) {
+    if (!cfg || !cfg->entry || !order) return 0;
     
-    // Mark all blocks as not visited
     for (int i = 0; i < cfg->block_count; i++) {
-        cfg->blocks[i]->visited = false;
+        cfg->blocks[i]->post_order_num = -1;
     }
     
-    // Mark reachable blocks starting from entry
-    mark_reachable_blocks(cfg->entry);
+    int count = cfg_walk(cfg, CFG_WALK_REVERSE_POSTORDER, order);
+    for (int i = 0; i < count; i++) {
+        order[i]->post_order_num = count - 1 - i;
+    }
+    return count;
+}
+
+static BasicBlock* intersect_dominators(BasicBlock* a, BasicBlock* b) {
+    while (a != b) {
+        while (a->post_order_num < b->post_order_num) a = a->idom;
+        while (b->post_order_num < a->post_order_num) b = b->idom;
+    }
+    return a;
+}
+
+// Cooper, Harvey and Kennedy, "A Simple, Fast Dominance Algorithm": iterate
+// idom = intersection of the processed predecessors' dominators over the
+// reverse postorder until nothing changes. The entry's idom is NULL, as
+// is that of every unreachable block.
+void compute_dominators(CFG* cfg) {
+    if (!cfg || !cfg->entry) return;
+    
+    BasicBlock** order = malloc(sizeof(BasicBlock*) * (cfg->block_count + 1));
+    if (!order) return;
+    int count = compute_reverse_postorder(cfg, order);
     
-    // Count reachable blocks
-    int count = 0;
     for (int i = 0; i < cfg->block_count; i++) {
-        if (cfg->blocks[i]->visited) {
-            count++;
+        cfg->blocks[i]->idom = NULL;
+    }
+    // The entry stands as its own dominator while iterating
+    cfg->entry->idom = cfg->entry;
+    
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int i = 1; i < count; i++) {
+            BasicBlock* block = order[i];
+            BasicBlock* new_idom = NULL;
+            for (int j = 0; j < block->predecessor_count; j++) {
+                BasicBlock* pred = block->predecessors[j];
+                if (!pred->idom) continue;  // Unprocessed or unreachable
+                new_idom = new_idom ? intersect_dominators(pred, new_idom) : pred;
+            }
+            if (new_idom && block->idom != new_idom) {
+                block->idom = new_idom;
+                changed = true;
+            }
         }
     }
     
-    return count;
+    cfg->entry->idom = NULL;
+    free(order);
 }
 
-void mark_reachable_blocks(BasicBlock* block) {
-    if (!block || block->visited) return;
+static void add_to_dom_frontier(BasicBlock* block, BasicBlock* member) {
+    // Members arrive one join block at a time, so a repeat is always last
+    if (block->dom_frontier_count > 0 &&
+        block->dom_frontier[block->dom_frontier_count - 1] == member) {
+        return;
+    }
+    if (block->dom_frontier_count >= block->dom_frontier_capacity) {
+        int new_capacity = block->dom_frontier_capacity == 0 ? 4 : block->dom_frontier_capacity * 2;
+        BasicBlock** grown = realloc(block->dom_frontier, new_capacity * sizeof(BasicBlock*));
+        if (!grown) return;
+        block->dom_frontier = grown;
+        block->dom_frontier_capacity = new_capacity;
+    }
+    block->dom_frontier[block->dom_frontier_count++] = member;
+}
+
+// Walks up from each predecessor of a join block to the join's idom; every
+// block passed on the way has the join in its frontier. Needs idom from
+// compute_dominators.
+void compute_dominance_frontiers(CFG* cfg) {
+    if (!cfg) return;
     
-    block->visited = true;
+    for (int i = 0; i < cfg->block_count; i++) {
+        cfg->blocks[i]->dom_frontier_count = 0;
+    }
     
-    // Recursively mark successors
-    for (int i = 0; i < block->successor_count; i++) {
-        mark_reachable_blocks(block->successors[i]);
+    for (int i = 0; i < cfg->block_count; i++) {
+        BasicBlock* block = cfg->blocks[i];
+        if (block->post_order_num < 0 || block->predecessor_count < 2) continue;
+        for (int j = 0; j < block->predecessor_count; j++) {
+            BasicBlock* runner = block->predecessors[j];
+            if (runner->post_order_num < 0) continue;
+            while (runner && runner != block->idom) {
+                add_to_dom_frontier(runner, block);
+                runner = runner->idom;
+            }
+        }
+    }
+}
+
+bool dominates(BasicBlock* a, BasicBlock* b) {
+    while (b && b != a) {
+        b = b->idom;
     }
+    return b == a;
 }
 
 // --- Debugging Functions ---
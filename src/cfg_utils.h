@@ -15,7 +15,29 @@ void print_phi_node(PhiNode* phi);
 // Analysis functions
 void find_unreachable_blocks(CFG* cfg);
 int count_reachable_blocks(CFG* cfg);
-void mark_reachable_blocks(BasicBlock* block);
+int mark_reachable_blocks(CFG* cfg);
+
+// Traversal. Each walk starts a new visit epoch, so marks never need
+// resetting; a block is visited when its visit_mark equals the epoch.
+typedef enum {
+    CFG_WALK_PREORDER,                // Depth-first, block before successors
+    CFG_WALK_POSTORDER,               // Depth-first, block after successors
+    CFG_WALK_REVERSE_POSTORDER,
+    CFG_WALK_BREADTH_FIRST
+} CFGWalkOrder;
+
+unsigned int begin_cfg_visit(CFG* cfg);
+bool visit_block(CFG* cfg, BasicBlock* block);  // False if already visited
+bool is_block_visited(CFG* cfg, BasicBlock* block);
+// Fills order (block_count entries) with the blocks reachable from the
+// entry and returns how many; they stay marked visited until the next walk
+int cfg_walk(CFG* cfg, CFGWalkOrder walk_order, BasicBlock** order);
+
+// Dominance; order must hold block_count entries
+int compute_reverse_postorder(CFG* cfg, BasicBlock** order);
+void compute_dominators(CFG* cfg);
+void compute_dominance_frontiers(CFG* cfg);
+bool dominates(BasicBlock* a, BasicBlock* b);
 
 // Debugging functions
 void verify_cfg(CFG* cfg);
@@ -0,0 +1,284 @@
+#define _GNU_SOURCE  // For getpid, mkdir, rename
+#include "compile_cache.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "ast_fold.h"
+#include "ast_to_microcode.h"
+#include "cfg_simplify.h"
+#include "cfg_to_microcode.h"
+#include "output_file.h"
+#include "wcet.h"
+
+const char* compile_cache_dir = NULL;
+
+// Bump when the entry layout or the key inputs change
+#define COMPILE_CACHE_FORMAT "hotstate-cache-2"
+
+// Files written by generate_all_output_files(), in entry order
+static const char* const cached_suffixes[] = {
+    "_smdata.mem", "_vardata.mem", "_params.vh",
+    "_switchdata.mem", "_symbols.toml", "_image.bin"
+};
+#define CACHED_SUFFIX_COUNT (sizeof(cached_suffixes) / sizeof(cached_suffixes[0]))
+
+// Written only by programs with delays; kept in the entry when present
+#define TIMDATA_SUFFIX "_timdata.mem"
+
+#define LISTING_NAME "listing.txt"
+
+// --- Hashing (FNV-1a, 64 bit) ---
+
+#define FNV_OFFSET 0xcbf29ce484222325ULL
+#define FNV_PRIME  0x100000001b3ULL
+
+static uint64_t hash_bytes(uint64_t h, const void* data, size_t len) {
+    const unsigned char* p = data;
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= FNV_PRIME;
+    }
+    return h;
+}
+
+// Strings are hashed with their terminator so "ab","c" differs from "a","bc"
+static uint64_t hash_string(uint64_t h, const char* s) {
+    if (!s) s = "";
+    return hash_bytes(h, s, strlen(s) + 1);
+}
+
+static uint64_t hash_int(uint64_t h, int64_t v) {
+    return hash_bytes(h, &v, sizeof(v));
+}
+
+// Fingerprint of the running compiler, so a rebuilt compiler never reuses
+// entries made by an older one. Falls back to the build timestamp when the
+// executable cannot be read.
+static uint64_t hash_compiler_build(uint64_t h) {
+    FILE* exe = fopen("/proc/self/exe", "rb");
+    if (!exe) {
+        return hash_string(h, __DATE__ " " __TIME__);
+    }
+    unsigned char buf[65536];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), exe)) > 0) {
+        h = hash_bytes(h, buf, n);
+    }
+    fclose(exe);
+    return h;
+}
+
+uint64_t compile_cache_key(const TokenList* tokens, const HardwareContext* hw_ctx) {
+    uint64_t h = hash_string(FNV_OFFSET, COMPILE_CACHE_FORMAT);
+    h = hash_compiler_build(h);
+
+    // Options that change the generated words or the printed listing
+    h = hash_int(h, compact_microcode_words);
+    h = hash_int(h, inline_call_words);
+    h = hash_int(h, fuse_conditions);
+    h = hash_int(h, merge_common_tails);
+    h = hash_int(h, use_bdd_conditions);
+    h = hash_int(h, rotate_loops);
+    h = hash_int(h, switch_offset_bits);
+    h = hash_int(h, narrow_microcode_fields);
+    h = hash_int(h, report_microcode_encoding);
+    h = hash_int(h, report_dispatch_costs);
+    h = hash_int(h, report_wcet);
+    h = hash_int(h, wcet_loop_bound);
+    h = hash_int(h, vardata_word_bits);
+    h = hash_int(h, sparse_vardata);
+    h = hash_int(h, pipeline_delay_slots);
+    h = hash_int(h, prune_unused_inputs);
+    h = hash_int(h, fold_constants);
+
+    // Hardware signature: the state and input numbering the words refer to
+    if (hw_ctx) {
+        h = hash_int(h, hw_ctx->state_count);
+        for (int i = 0; i < hw_ctx->state_count; i++) {
+            h = hash_string(h, hw_ctx->states[i].name);
+            h = hash_int(h, hw_ctx->states[i].state_number);
+            h = hash_int(h, hw_ctx->states[i].initial_value);
+        }
+        h = hash_int(h, hw_ctx->input_count);
+        for (int i = 0; i < hw_ctx->input_count; i++) {
+            h = hash_string(h, hw_ctx->inputs[i].name);
+            h = hash_int(h, hw_ctx->inputs[i].input_number);
+        }
+        h = hash_int(h, hw_ctx->initial_state_value);
+        h = hash_int(h, hw_ctx->initial_mask_value);
+    }
+
+    // Token stream. Positions are left out so layout and comment edits keep
+    // the key; every function body counts, since main's calls compile the
+    // bodies of the helpers they name.
+    for (int i = 0; i < tokens->count; i++) {
+        h = hash_int(h, tokens->items[i].type);
+        h = hash_string(h, tokens->items[i].value);
+    }
+    return h;
+}
+
+// --- Entry files ---
+
+static char* entry_path(uint64_t key, const char* tag) {
+    size_t len = strlen(compile_cache_dir) + 64 + (tag ? strlen(tag) : 0);
+    char* path = malloc(len);
+    if (!path) return NULL;
+    snprintf(path, len, "%s/%016llx%s", compile_cache_dir, (unsigned long long)key, tag ? tag : "");
+    return path;
+}
+
+static char* join_path(const char* dir, const char* name) {
+    size_t len = strlen(dir) + strlen(name) + 2;
+    char* path = malloc(len);
+    if (path) snprintf(path, len, "%s/%s", dir, name);
+    return path;
+}
+
+// Copy src to dst (or to out when dst is NULL); false if either side fails.
+// dst is left untouched when it already holds the same bytes.
+static bool copy_file(const char* src, const char* dst, FILE* out) {
+    FILE* in = fopen(src, "rb");
+    if (!in) return false;
+    FILE* to = dst ? output_file_open(dst, "wb") : out;
+    if (!to) {
+        fclose(in);
+        return false;
+    }
+    char buf[65536];
+    size_t n;
+    bool ok = true;
+    while ((n = fread(buf, 1, sizeof(buf), in)) > 0) {
+        if (fwrite(buf, 1, n, to) != n) {
+            ok = false;
+            break;
+        }
+    }
+    if (ferror(in)) ok = false;
+    fclose(in);
+    if (dst && !output_file_close(to, dst)) ok = false;
+    return ok;
+}
+
+static void remove_entry_dir(const char* dir) {
+    for (size_t i = 0; i < CACHED_SUFFIX_COUNT; i++) {
+        char* path = join_path(dir, cached_suffixes[i]);
+        if (path) {
+            unlink(path);
+            free(path);
+        }
+    }
+    char* timdata = join_path(dir, TIMDATA_SUFFIX);
+    if (timdata) {
+        unlink(timdata);
+        free(timdata);
+    }
+    char* listing = join_path(dir, LISTING_NAME);
+    if (listing) {
+        unlink(listing);
+        free(listing);
+    }
+    rmdir(dir);
+}
+
+bool compile_cache_restore(uint64_t key, const char* source_filename, FILE* out) {
+    if (!compile_cache_dir || !source_filename) return false;
+    char* dir = entry_path(key, NULL);
+    if (!dir) return false;
+
+    // Check the entry is complete before touching any output
+    bool ok = true;
+    for (size_t i = 0; i < CACHED_SUFFIX_COUNT && ok; i++) {
+        char* path = join_path(dir, cached_suffixes[i]);
+        ok = path && access(path, R_OK) == 0;
+        free(path);
+    }
+    char* listing = join_path(dir, LISTING_NAME);
+    if (!ok || !listing || access(listing, R_OK) != 0) {
+        free(listing);
+        free(dir);
+        return false;
+    }
+
+    ok = !out || copy_file(listing, NULL, out);
+    for (size_t i = 0; i < CACHED_SUFFIX_COUNT && ok; i++) {
+        char* src = join_path(dir, cached_suffixes[i]);
+        char* dst = generate_output_filepath(source_filename, cached_suffixes[i]);
+        ok = src && dst && copy_file(src, dst, NULL);
+        if (ok) printf("Restored %s from cache\n", dst);
+        free(src);
+        free(dst);
+    }
+    if (ok) {
+        char* src = join_path(dir, TIMDATA_SUFFIX);
+        if (src && access(src, R_OK) == 0) {
+            char* dst = generate_output_filepath(source_filename, TIMDATA_SUFFIX);
+            ok = dst && copy_file(src, dst, NULL);
+            if (ok) printf("Restored %s from cache\n", dst);
+            free(dst);
+        }
+        free(src);
+    }
+    if (!ok) {
+        fprintf(stderr, "Warning: compile cache entry %016llx could not be restored\n",
+                (unsigned long long)key);
+    }
+    free(listing);
+    free(dir);
+    return ok;
+}
+
+void compile_cache_store(uint64_t key, const char* source_filename, const char* listing, size_t listing_size) {
+    if (!compile_cache_dir || !source_filename) return;
+    if (mkdir(compile_cache_dir, 0777) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Warning: cannot create cache directory '%s': %s\n",
+                compile_cache_dir, strerror(errno));
+        return;
+    }
+
+    // Fill a private directory first, then publish it with one rename so a
+    // concurrent reader never sees a half-written entry
+    char tag[32];
+    snprintf(tag, sizeof(tag), ".tmp.%ld", (long)getpid());
+    char* tmp_dir = entry_path(key, tag);
+    char* final_dir = entry_path(key, NULL);
+    if (!tmp_dir || !final_dir || mkdir(tmp_dir, 0777) != 0) {
+        free(tmp_dir);
+        free(final_dir);
+        return;
+    }
+
+    bool ok = true;
+    for (size_t i = 0; i < CACHED_SUFFIX_COUNT && ok; i++) {
+        char* src = generate_output_filepath(source_filename, cached_suffixes[i]);
+        char* dst = join_path(tmp_dir, cached_suffixes[i]);
+        ok = src && dst && copy_file(src, dst, NULL);
+        free(src);
+        free(dst);
+    }
+    if (ok) {
+        char* src = generate_output_filepath(source_filename, TIMDATA_SUFFIX);
+        if (src && access(src, R_OK) == 0) {
+            char* dst = join_path(tmp_dir, TIMDATA_SUFFIX);
+            ok = dst && copy_file(src, dst, NULL);
+            free(dst);
+        }
+        free(src);
+    }
+    if (ok) {
+        char* path = join_path(tmp_dir, LISTING_NAME);
+        FILE* f = path ? fopen(path, "wb") : NULL;
+        ok = f && fwrite(listing, 1, listing_size, f) == listing_size;
+        if (f && fclose(f) != 0) ok = false;
+        free(path);
+    }
+
+    // Losing the race to another process that stored the same key is fine
+    if (!ok || rename(tmp_dir, final_dir) != 0) {
+        remove_entry_dir(tmp_dir);
+    }
+    free(tmp_dir);
+    free(final_dir);
+}
@@ -0,0 +1,30 @@
+#ifndef COMPILE_CACHE_H
+#define COMPILE_CACHE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "lexer.h"
+#include "hw_analyzer.h"
+
+// On-disk cache of --microcode-hs results (--cache-dir).
+// An entry holds the printed microcode listing and every output file of one
+// compilation, keyed by a hash of what decides them: the token stream of
+// the program outside the functions that are never emitted (so comment,
+// whitespace and helper-function edits still hit), the HardwareContext
+// signature, the options that change code generation, and the compiler
+// binary itself.
+
+extern const char* compile_cache_dir; // NULL disables the cache
+
+uint64_t compile_cache_key(const TokenList* tokens, const HardwareContext* hw_ctx);
+
+// Copy a cached entry to the output files next to source_filename and
+// print its listing to out (unless NULL); false on a miss
+bool compile_cache_restore(uint64_t key, const char* source_filename, FILE* out);
+
+// Save the output files next to source_filename and the listing under key
+void compile_cache_store(uint64_t key, const char* source_filename, const char* listing, size_t listing_size);
+
+#endif // COMPILE_CACHE_H
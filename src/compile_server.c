@@ -0,0 +1,348 @@
+#define _GNU_SOURCE  // For getline, clock_gettime, nanosleep, strndup
+#include "compile_server.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include "preprocessor.h"
+#include "cfg_to_microcode.h"
+
+// Source last compiled for a path and how that went, to skip recompiling
+// unchanged files
+typedef struct {
+    char* path;
+    uint64_t source_hash;  // Of the preprocessed source; 0 before the first compile
+    bool ok;
+    int instruction_count;
+    char error[256];
+} SourceEntry;
+
+typedef struct {
+    HotstateContext* ctx;
+    const HotstateOptions* options;
+    SourceEntry* entries;
+    int entry_count;
+    int entry_capacity;
+} CompileServer;
+
+typedef struct {
+    bool ok;
+    bool unchanged;        // Preprocessed source identical to the last compile
+    int instruction_count;
+    double ms;
+    const char* error;     // Points into the SourceEntry or a literal
+} CompileOutcome;
+
+static const char* const output_suffixes[] = {
+    "_params.vh", "_smdata.mem", "_vardata.mem",
+    "_switchdata.mem", "_symbols.toml", "_image.bin"
+};
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+// FNV-1a, 64 bit
+static uint64_t hash_source(const char* s) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (; *s; s++) {
+        h ^= (unsigned char)*s;
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+static SourceEntry* find_entry(CompileServer* server, const char* path) {
+    for (int i = 0; i < server->entry_count; i++) {
+        if (strcmp(server->entries[i].path, path) == 0) {
+            return &server->entries[i];
+        }
+    }
+    if (server->entry_count == server->entry_capacity) {
+        int capacity = server->entry_capacity ? server->entry_capacity * 2 : 8;
+        SourceEntry* entries = realloc(server->entries, capacity * sizeof(SourceEntry));
+        if (!entries) return NULL;
+        server->entries = entries;
+        server->entry_capacity = capacity;
+    }
+    SourceEntry* entry = &server->entries[server->entry_count];
+    memset(entry, 0, sizeof(*entry));
+    entry->path = strdup(path);
+    if (!entry->path) return NULL;
+    server->entry_count++;
+    return entry;
+}
+
+static bool outputs_exist(const char* path) {
+    for (size_t i = 0; i < sizeof(output_suffixes) / sizeof(output_suffixes[0]); i++) {
+        char* output = generate_output_filepath(path, output_suffixes[i]);
+        bool exists = output && access(output, F_OK) == 0;
+        free(output);
+        if (!exists) return false;
+    }
+    return true;
+}
+
+static void compile_file(CompileServer* server, const char* path, CompileOutcome* outcome) {
+    memset(outcome, 0, sizeof(*outcome));
+    double start = now_ms();
+
+    SourceEntry* entry = find_entry(server, path);
+    char* source = entry ? preprocess_includes(path) : NULL;
+    if (!source) {
+        outcome->error = entry ? "Cannot read file" : "Out of memory";
+        outcome->ms = now_ms() - start;
+        return;
+    }
+
+    // A failed compile is not retried either until the source changes
+    uint64_t hash = hash_source(source);
+    outcome->unchanged = entry->source_hash == hash && (!entry->ok || outputs_exist(path));
+    if (!outcome->unchanged) {
+        HotstateResult* result = hotstate_compile(server->ctx, source, server->options);
+        entry->source_hash = hash;
+        entry->ok = false;
+        if (!result) {
+            snprintf(entry->error, sizeof(entry->error), "%s", hotstate_error(server->ctx));
+        } else if (!hotstate_write_outputs(result, path)) {
+            snprintf(entry->error, sizeof(entry->error), "Cannot write output files");
+        } else {
+            entry->ok = true;
+            entry->instruction_count = result->microcode->instruction_count;
+        }
+        hotstate_release(server->ctx, result);
+    }
+    free(source);
+
+    outcome->ok = entry->ok;
+    outcome->instruction_count = entry->instruction_count;
+    outcome->error = entry->ok ? NULL : entry->error;
+    outcome->ms = now_ms() - start;
+}
+
+static bool server_init(CompileServer* server, const HotstateOptions* options) {
+    memset(server, 0, sizeof(*server));
+    server->ctx = hotstate_create();
+    server->options = options;
+    return server->ctx != NULL;
+}
+
+static void server_free(CompileServer* server) {
+    for (int i = 0; i < server->entry_count; i++) {
+        free(server->entries[i].path);
+    }
+    free(server->entries);
+    hotstate_destroy(server->ctx);
+}
+
+// --- Request parsing ---
+// Requests are flat JSON objects; only string, number, true/false/null
+// values at the top level are understood.
+
+static const char* skip_space(const char* p) {
+    while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') p++;
+    return p;
+}
+
+// End of the JSON string whose opening quote is at p, or NULL
+static const char* string_end(const char* p) {
+    for (p++; *p; p++) {
+        if (*p == '\\' && p[1]) {
+            p++;
+        } else if (*p == '"') {
+            return p + 1;
+        }
+    }
+    return NULL;
+}
+
+// End of the scalar value at p (string, number or literal), or NULL
+static const char* value_end(const char* p) {
+    if (*p == '"') return string_end(p);
+    const char* start = p;
+    while (*p && *p != ',' && *p != '}' && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') p++;
+    return p > start ? p : NULL;
+}
+
+// Value of key in the object on line, or NULL; *end gets the value's end
+static const char* find_value(const char* line, const char* key, const char** end) {
+    size_t key_len = strlen(key);
+    const char* p = skip_space(line);
+    if (*p != '{') return NULL;
+    p = skip_space(p + 1);
+    while (*p == '"') {
+        const char* name_end = string_end(p);
+        if (!name_end) return NULL;
+        bool match = (size_t)(name_end - p - 2) == key_len && strncmp(p + 1, key, key_len) == 0;
+        p = skip_space(name_end);
+        if (*p != ':') return NULL;
+        p = skip_space(p + 1);
+        const char* v_end = value_end(p);
+        if (!v_end) return NULL;
+        if (match) {
+            *end = v_end;
+            return p;
+        }
+        p = skip_space(v_end);
+        if (*p != ',') return NULL;
+        p = skip_space(p + 1);
+    }
+    return NULL;
+}
+
+// The string value of key, unescaped and malloc'd; NULL if absent or not a string
+static char* string_value(const char* line, const char* key) {
+    const char* end;
+    const char* p = find_value(line, key, &end);
+    if (!p || *p != '"') return NULL;
+    char* out = malloc(end - p);
+    if (!out) return NULL;
+    size_t n = 0;
+    for (p++; p < end - 1; p++) {
+        char c = *p;
+        if (c == '\\') {
+            switch (*++p) {
+                case 'n': c = '\n'; break;
+                case 't': c = '\t'; break;
+                case 'r': c = '\r'; break;
+                case 'b': c = '\b'; break;
+                case 'f': c = '\f'; break;
+                case 'u': {
+                    // Only code points below 0x80 appear in paths we accept
+                    unsigned code = 0;
+                    if (sscanf(p + 1, "%4x", &code) != 1 || code >= 0x80 || code == 0) {
+                        free(out);
+                        return NULL;
+                    }
+                    c = (char)code;
+                    p += 4;
+                    break;
+                }
+                default: c = *p; break;  // \" \\ \/
+            }
+        }
+        out[n++] = c;
+    }
+    out[n] = '\0';
+    return out;
+}
+
+static void write_json_string(FILE* out, const char* s) {
+    fputc('"', out);
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') {
+            fprintf(out, "\\%c", c);
+        } else if (c == '\n') {
+            fputs("\\n", out);
+        } else if (c < 0x20) {
+            fprintf(out, "\\u%04x", c);
+        } else {
+            fputc(c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+// Echo the request id as given, null when absent
+static void write_id(FILE* out, const char* line) {
+    const char* end;
+    const char* id = find_value(line, "id", &end);
+    if (id) {
+        fwrite(id, 1, end - id, out);
+    } else {
+        fputs("null", out);
+    }
+}
+
+static void write_error(FILE* out, const char* line, const char* message) {
+    fputs("{\"id\": ", out);
+    write_id(out, line);
+    fputs(", \"ok\": false, \"error\": ", out);
+    write_json_string(out, message);
+    fputs("}\n", out);
+}
+
+int compile_server_run(FILE* in, FILE* out, const HotstateOptions* options) {
+    CompileServer server;
+    if (!server_init(&server, options)) {
+        fprintf(stderr, "Error: Cannot create compiler context\n");
+        return 1;
+    }
+
+    char* line = NULL;
+    size_t line_capacity = 0;
+    while (getline(&line, &line_capacity, in) != -1) {
+        if (*skip_space(line) == '\0') continue;
+
+        char* method = string_value(line, "method");
+        if (method && strcmp(method, "shutdown") == 0) {
+            fputs("{\"id\": ", out);
+            write_id(out, line);
+            fputs(", \"ok\": true}\n", out);
+            fflush(out);
+            free(method);
+            break;
+        }
+        char* file = string_value(line, "file");
+        if (method && strcmp(method, "compile") != 0) {
+            write_error(out, line, "Unknown method");
+        } else if (!file) {
+            write_error(out, line, "Request needs a \"file\" string");
+        } else {
+            CompileOutcome outcome;
+            compile_file(&server, file, &outcome);
+            fputs("{\"id\": ", out);
+            write_id(out, line);
+            fprintf(out, ", \"ok\": %s, \"file\": ", outcome.ok ? "true" : "false");
+            write_json_string(out, file);
+            if (outcome.ok) {
+                fprintf(out, ", \"instructions\": %d", outcome.instruction_count);
+            } else {
+                fputs(", \"error\": ", out);
+                write_json_string(out, outcome.error);
+            }
+            fprintf(out, ", \"unchanged\": %s, \"ms\": %.2f}\n", outcome.unchanged ? "true" : "false", outcome.ms);
+        }
+        fflush(out);
+        free(method);
+        free(file);
+    }
+
+    free(line);
+    server_free(&server);
+    return 0;
+}
+
+int compile_watch_run(const char* filename, const HotstateOptions* options, int interval_ms) {
+    CompileServer server;
+    if (!server_init(&server, options)) {
+        fprintf(stderr, "Error: Cannot create compiler context\n");
+        return 1;
+    }
+    printf("Watching %s (Ctrl-C to stop)\n", filename);
+    fflush(stdout);
+
+    // Preprocessing every tick is what notices edits to included files;
+    // compile_file only compiles when the expanded source changed
+    struct timespec interval = { interval_ms / 1000, (long)(interval_ms % 1000) * 1000000L };
+    for (;;) {
+        CompileOutcome outcome;
+        compile_file(&server, filename, &outcome);
+        if (!outcome.unchanged) {
+            if (outcome.ok) {
+                printf("Compiled %s: %d instructions in %.2f ms\n", filename, outcome.instruction_count, outcome.ms);
+            } else {
+                printf("Failed to compile %s: %s\n", filename, outcome.error);
+            }
+            fflush(stdout);
+        }
+        nanosleep(&interval, NULL);
+    }
+
+    server_free(&server);
+    return 0;
+}
@@ -0,0 +1,26 @@
+#ifndef COMPILE_SERVER_H
+#define COMPILE_SERVER_H
+
+#include <stdio.h>
+#include "hotstate.h"
+
+// Long-running compilation for editors and CI (--serve, --watch). One
+// libhotstate context serves every compilation, so the arena and the
+// interned symbol table stay warm, and a file whose preprocessed source has
+// not changed since it was last compiled is not compiled again. Each
+// compilation writes the --microcode-hs output files next to the source;
+// "unchanged" results repeat the last outcome for that file.
+
+// --serve: one JSON request per line on in, one JSON response per line on
+// out, until EOF or a "shutdown" request:
+//   {"id": 1, "method": "compile", "file": "prog.c"}
+//   {"id": 1, "ok": true, "file": "prog.c", "instructions": 22, "unchanged": false, "ms": 0.41}
+//   {"id": 2, "ok": false, "file": "bad.c", "error": "Parse error (details on stderr)", "unchanged": false, "ms": 0.12}
+// "method" defaults to "compile"; "id" is echoed back as given.
+int compile_server_run(FILE* in, FILE* out, const HotstateOptions* options);
+
+// --watch: compile filename, then recompile whenever it or a file it
+// includes changes, checking every interval_ms. Runs until interrupted.
+int compile_watch_run(const char* filename, const HotstateOptions* options, int interval_ms);
+
+#endif // COMPILE_SERVER_H
@@ -3,6 +3,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h> // For fprintf
+#include <stdint.h>
+#include "intern.h"
 
 // Function to evaluate a binary operation on single-bit values
 int eval_op(int lhv, TokenType op, int rhv) {
@@ -34,6 +36,79 @@ int eval_op(int lhv, TokenType op, int rhv) {
     }
 }
 
+// --- Multi-bit values ---
+// A _BitInt input is one input per bit ("x[0]" is the least significant),
+// and a comparison or arithmetic on it is evaluated over all of them, so
+// sensor == 5 is a single lookup. Multi-bit values are two's complement,
+// each node wide enough that + and - never overflow; a truth value is 0 or
+// 1 and a literal keeps its whole value next to a multi-bit operand. With
+// no multi-bit operand the single-bit semantics of eval_op apply as before.
+
+// Bits that hold value in two's complement
+static int literal_width(int value) {
+    int width = 1;
+    while (width < 32 && (value >> (width - 1)) != 0 && (value >> (width - 1)) != -1) {
+        width++;
+    }
+    return width;
+}
+
+// Width of operand as a multi-bit value
+static int operand_width(const SimulatedExpression* operand) {
+    if (operand->width > 0) return operand->width;
+    if (operand->type == NODE_NUMBER_LITERAL) return literal_width(operand->const_value);
+    return 2; // A truth value, 0 or 1
+}
+
+// Width of a binary op as a multi-bit value, 0 when it is a truth value:
+// + and - always give numbers, & and | are bitwise next to a multi-bit
+// operand and logical otherwise
+static int binary_op_width(TokenType op, const SimulatedExpression* lhs, const SimulatedExpression* rhs) {
+    if (!lhs || !rhs) return 0;
+    int widest = operand_width(lhs) > operand_width(rhs) ? operand_width(lhs) : operand_width(rhs);
+    switch (op) {
+        case TOKEN_PLUS:
+        case TOKEN_MINUS:
+            return widest + 1;
+        case TOKEN_AND:
+        case TOKEN_OR:
+            return (lhs->width > 0 || rhs->width > 0) ? widest : 0;
+        default:
+            return 0;
+    }
+}
+
+static bool is_relational_op(TokenType op) {
+    return op == TOKEN_EQUAL || op == TOKEN_NOT_EQUAL || op == TOKEN_LESS || op == TOKEN_GREATER ||
+           op == TOKEN_LESS_EQUAL || op == TOKEN_GREATER_EQUAL;
+}
+
+// A relational op with a multi-bit operand compares whole values
+static bool compares_multi_bit(const SimulatedExpression* sim_expr) {
+    return sim_expr->type == NODE_BINARY_OP && is_relational_op(sim_expr->op_type) &&
+           sim_expr->lhs && sim_expr->rhs && (sim_expr->lhs->width > 0 || sim_expr->rhs->width > 0);
+}
+
+// Input number of bit bit of the _BitInt input name, -1 if there is none
+static int bit_input_number(HardwareContext* hw_ctx, const char* name, int bit) {
+    char bit_name[256];
+    snprintf(bit_name, sizeof(bit_name), "%s[%d]", name, bit);
+    return get_input_number_by_name(hw_ctx, bit_name);
+}
+
+// Sets the width and inputs of an identifier that names a _BitInt input
+static void resolve_bit_vector(SimulatedExpression* sim_expr, HardwareContext* hw_ctx) {
+    int bits = get_input_width_by_name(hw_ctx, sim_expr->var_name);
+    if (bits == 0) return;
+    sim_expr->width = bits + 1; // Plus a clear sign bit
+    for (int bit = 0; bit < bits; bit++) {
+        int input_num = bit_input_number(hw_ctx, sim_expr->var_name, bit);
+        if (input_num != -1) {
+            sim_expr->dependent_input_mask |= 1u << input_num;
+        }
+    }
+}
+
 // Function to create a SimulatedExpression from an AST Node
 SimulatedExpression* create_simulated_expression(Node* ast_expr_node, HardwareContext* hw_ctx) {
     if (!ast_expr_node) return NULL;
@@ -48,6 +123,13 @@ SimulatedExpression* create_simulated_expression(Node* ast_expr_node, HardwareCo
     sim_expr->type = ast_expr_node->type;
     sim_expr->LUT = NULL; // Will be allocated and populated later
     sim_expr->LUT_size = 0;
+    sim_expr->LUT_bits = NULL;
+    sim_expr->LUT_words = 0;
+    sim_expr->support_mask = 0;
+    sim_expr->support_count = 0;
+    sim_expr->bdd = -1;
+    sim_expr->id = -1;
+    sim_expr->input_num = -1;
     sim_expr->dependent_input_mask = 0;
 
     switch (ast_expr_node->type) {
@@ -55,9 +137,11 @@ SimulatedExpression* create_simulated_expression(Node* ast_expr_node, HardwareCo
             IdentifierNode* id_node = (IdentifierNode*)ast_expr_node;
             sim_expr->var_name = strdup(id_node->name);
             // Check if it's an input variable and update dependent_input_mask
-            int input_num = get_input_number_by_name(hw_ctx, id_node->name);
-            if (input_num != -1) {
-                sim_expr->dependent_input_mask |= (1 << input_num);
+            sim_expr->input_num = get_input_number_by_name(hw_ctx, id_node->name);
+            if (sim_expr->input_num != -1) {
+                sim_expr->dependent_input_mask |= (1 << sim_expr->input_num);
+            } else {
+                resolve_bit_vector(sim_expr, hw_ctx);
             }
             break;
         }
@@ -79,6 +163,7 @@ SimulatedExpression* create_simulated_expression(Node* ast_expr_node, HardwareCo
             // Combine dependent_input_masks from children
             if (sim_expr->lhs) sim_expr->dependent_input_mask |= sim_expr->lhs->dependent_input_mask;
             if (sim_expr->rhs) sim_expr->dependent_input_mask |= sim_expr->rhs->dependent_input_mask;
+            sim_expr->width = binary_op_width(sim_expr->op_type, sim_expr->lhs, sim_expr->rhs);
             break;
         }
         case NODE_UNARY_OP: {
@@ -95,66 +180,503 @@ SimulatedExpression* create_simulated_expression(Node* ast_expr_node, HardwareCo
     return sim_expr;
 }
 
-// Function to evaluate a simulated expression and populate its LUT
-void eval_simulated_expression(SimulatedExpression* sim_expr, HardwareContext* hw_ctx, int num_total_input_vars) {
-    if (!sim_expr) return;
+// --- Bit-sliced truth tables ---
+// Each table holds one minterm per bit, 64 minterms per uint64_t word: bit b
+// of word w is the value for input combination (w * 64 + b). Whole-table
+// operators are then a single bitwise op per word instead of an eval_op call
+// per minterm, and the word loops are plain enough for the compiler to
+// vectorize.
+
+#define LUT_WORD_BITS 64
+#define LUT_WORD_SHIFT 6
+
+// Bit patterns of input variables 0..5 within a single word
+static const uint64_t input_bit_patterns[LUT_WORD_SHIFT] = {
+    0xAAAAAAAAAAAAAAAAULL,
+    0xCCCCCCCCCCCCCCCCULL,
+    0xF0F0F0F0F0F0F0F0ULL,
+    0xFF00FF00FF00FF00ULL,
+    0xFFFF0000FFFF0000ULL,
+    0xFFFFFFFF00000000ULL
+};
+
+static int lut_word_count(int lut_size) {
+    return (lut_size + LUT_WORD_BITS - 1) / LUT_WORD_BITS;
+}
 
-    // Calculate LUT_size based on total number of input variables
-    sim_expr->LUT_size = 1 << num_total_input_vars; // 2^num_total_input_vars
-    sim_expr->LUT = (uint8_t*)malloc(sizeof(uint8_t) * sim_expr->LUT_size);
-    if (!sim_expr->LUT) {
+static uint64_t* alloc_lut_bits(int word_count) {
+    uint64_t* bits = (uint64_t*)malloc(sizeof(uint64_t) * word_count);
+    if (!bits) {
         fprintf(stderr, "Error: Failed to allocate LUT for simulated expression.\n");
         exit(EXIT_FAILURE);
     }
-    
-    // Iterate through all possible input combinations
-    for (int i = 0; i < sim_expr->LUT_size; i++) {
-        switch (sim_expr->type) {
-            case NODE_IDENTIFIER: {
-                // Determine the value of the identifier for the current input combination (i)
-                // This is the "eigenLUT" generation part
-                int input_num = get_input_number_by_name(hw_ctx, sim_expr->var_name);
-                if (input_num != -1) {
-                    sim_expr->LUT[i] = (i >> input_num) & 1; // Extract the bit corresponding to this input variable
-                } else {
-                    // Not an input variable, treat as a constant 0 for evaluation if not found
-                    // Or, if it's a state variable, its value would depend on the current state.
-                    // For now, assume 0 for non-input identifiers in expressions.
-                    sim_expr->LUT[i] = 0; 
-                }
+    return bits;
+}
+
+static void fill_lut_bits(uint64_t* bits, int word_count, uint64_t value) {
+    for (int w = 0; w < word_count; w++) {
+        bits[w] = value;
+    }
+}
+
+// Table of the support variable at position var_pos: low positions repeat a
+// fixed pattern in every word, higher positions select whole words
+static void fill_input_lut_bits(uint64_t* bits, int word_count, int var_pos) {
+    if (var_pos < LUT_WORD_SHIFT) {
+        fill_lut_bits(bits, word_count, input_bit_patterns[var_pos]);
+        return;
+    }
+    int word_shift = var_pos - LUT_WORD_SHIFT;
+    for (int w = 0; w < word_count; w++) {
+        bits[w] = ((w >> word_shift) & 1) ? ~0ULL : 0ULL;
+    }
+}
+
+static int count_bits(uint32_t mask) {
+    int count = 0;
+    while (mask) {
+        mask &= mask - 1;
+        count++;
+    }
+    return count;
+}
+
+// Position of input_num among the inputs of support_mask, i.e. its bit in a
+// support-reduced table index
+static int support_position(uint32_t support_mask, int input_num) {
+    return count_bits(support_mask & ((1u << input_num) - 1));
+}
+
+// Bitwise equivalent of eval_op over whole tables; the result replaces lhs
+static void combine_lut_bits(uint64_t* lhs, const uint64_t* rhs, int word_count, TokenType op) {
+    switch (op) {
+        case TOKEN_AND:
+        case TOKEN_LOGICAL_AND:
+            for (int w = 0; w < word_count; w++) lhs[w] &= rhs[w];
+            break;
+        case TOKEN_OR:
+        case TOKEN_LOGICAL_OR:
+            for (int w = 0; w < word_count; w++) lhs[w] |= rhs[w];
+            break;
+        case TOKEN_EQUAL:
+            for (int w = 0; w < word_count; w++) lhs[w] = ~(lhs[w] ^ rhs[w]);
+            break;
+        case TOKEN_NOT_EQUAL:
+            for (int w = 0; w < word_count; w++) lhs[w] ^= rhs[w];
+            break;
+        case TOKEN_LESS:
+            for (int w = 0; w < word_count; w++) lhs[w] = ~lhs[w] & rhs[w];
+            break;
+        case TOKEN_GREATER:
+            for (int w = 0; w < word_count; w++) lhs[w] &= ~rhs[w];
+            break;
+        case TOKEN_LESS_EQUAL:
+            for (int w = 0; w < word_count; w++) lhs[w] = ~lhs[w] | rhs[w];
+            break;
+        case TOKEN_GREATER_EQUAL:
+            for (int w = 0; w < word_count; w++) lhs[w] |= ~rhs[w];
+            break;
+        default:
+            fprintf(stderr, "Error: Unsupported operator for eval_op: %d\n", op);
+            fill_lut_bits(lhs, word_count, 0);
+            break;
+    }
+}
+
+static uint64_t* eval_lut_bits(SimulatedExpression* sim_expr, HardwareContext* hw_ctx,
+                               uint32_t support_mask, int word_count);
+
+// a += b, or a -= b when subtract, over width-bit vectors of tables (bit i
+// is the table at i * word_count): one ripple-carry stage per bit
+static void add_lut_vectors(uint64_t* a, const uint64_t* b, int width, int word_count, bool subtract) {
+    for (int w = 0; w < word_count; w++) {
+        uint64_t carry = subtract ? ~0ULL : 0ULL;
+        for (int bit = 0; bit < width; bit++) {
+            uint64_t x = a[bit * word_count + w];
+            uint64_t y = subtract ? ~b[bit * word_count + w] : b[bit * word_count + w];
+            a[bit * word_count + w] = x ^ y ^ carry;
+            carry = (x & y) | (carry & (x ^ y));
+        }
+    }
+}
+
+// Evaluate sim_expr as a multi-bit value, sign-extended to width bits
+static uint64_t* eval_lut_vector(SimulatedExpression* sim_expr, HardwareContext* hw_ctx,
+                                 uint32_t support_mask, int word_count, int width) {
+    uint64_t* vector;
+    if (sim_expr->type == NODE_BINARY_OP && sim_expr->width > 0) {
+        vector = eval_lut_vector(sim_expr->lhs, hw_ctx, support_mask, word_count, width);
+        uint64_t* rhs = eval_lut_vector(sim_expr->rhs, hw_ctx, support_mask, word_count, width);
+        int total = width * word_count;
+        switch (sim_expr->op_type) {
+            case TOKEN_PLUS:
+            case TOKEN_MINUS:
+                add_lut_vectors(vector, rhs, width, word_count, sim_expr->op_type == TOKEN_MINUS);
                 break;
-            }
-            case NODE_NUMBER_LITERAL:
-            case NODE_BOOL_LITERAL: {
-                sim_expr->LUT[i] = sim_expr->const_value & 1;
+            case TOKEN_AND:
+                for (int w = 0; w < total; w++) vector[w] &= rhs[w];
                 break;
-            }
-            case NODE_BINARY_OP: {
-                // Recursively evaluate LHS and RHS
-                eval_simulated_expression(sim_expr->lhs, hw_ctx, num_total_input_vars);
-                eval_simulated_expression(sim_expr->rhs, hw_ctx, num_total_input_vars);
-                // Combine LUTs using eval_op
-                sim_expr->LUT[i] = eval_op(sim_expr->lhs->LUT[i], sim_expr->op_type, sim_expr->rhs->LUT[i]);
+            default: // TOKEN_OR
+                for (int w = 0; w < total; w++) vector[w] |= rhs[w];
                 break;
+        }
+        free(rhs);
+        return vector;
+    }
+
+    vector = alloc_lut_bits(width * word_count);
+    if (sim_expr->type == NODE_IDENTIFIER && sim_expr->width > 0) {
+        for (int bit = 0; bit < width; bit++) {
+            int input_num = bit < sim_expr->width - 1 ? bit_input_number(hw_ctx, sim_expr->var_name, bit) : -1;
+            if (input_num != -1 && (support_mask & (1u << input_num))) {
+                fill_input_lut_bits(vector + bit * word_count, word_count, support_position(support_mask, input_num));
+            } else {
+                fill_lut_bits(vector + bit * word_count, word_count, 0);
             }
-            case NODE_UNARY_OP: {
-                // Recursively evaluate operand
-                eval_simulated_expression(sim_expr->lhs, hw_ctx, num_total_input_vars); // Unary ops use lhs for operand
-                // Apply unary op
-                if (sim_expr->op_type == TOKEN_NOT) { // Logical NOT
-                    sim_expr->LUT[i] = !sim_expr->lhs->LUT[i];
-                } else {
-                    fprintf(stderr, "Warning: Unsupported unary operator for eval_simulated_expression: %d\n", sim_expr->op_type);
-                    sim_expr->LUT[i] = 0;
-                }
-                break;
+        }
+    } else if (sim_expr->type == NODE_NUMBER_LITERAL) {
+        for (int bit = 0; bit < width; bit++) {
+            int value_bit = (sim_expr->const_value >> (bit < 31 ? bit : 31)) & 1;
+            fill_lut_bits(vector + bit * word_count, word_count, value_bit ? ~0ULL : 0ULL);
+        }
+    } else {
+        // A truth value
+        uint64_t* bits = eval_lut_bits(sim_expr, hw_ctx, support_mask, word_count);
+        memcpy(vector, bits, sizeof(uint64_t) * word_count);
+        fill_lut_bits(vector + word_count, (width - 1) * word_count, 0);
+        free(bits);
+    }
+    return vector;
+}
+
+// Relational op over multi-bit operands, from the sign and zero-ness of
+// lhs - rhs taken one bit wider than either
+static uint64_t* compare_lut_vectors(SimulatedExpression* sim_expr, HardwareContext* hw_ctx,
+                                     uint32_t support_mask, int word_count) {
+    int width = binary_op_width(TOKEN_MINUS, sim_expr->lhs, sim_expr->rhs);
+    uint64_t* difference = eval_lut_vector(sim_expr->lhs, hw_ctx, support_mask, word_count, width);
+    uint64_t* rhs = eval_lut_vector(sim_expr->rhs, hw_ctx, support_mask, word_count, width);
+    add_lut_vectors(difference, rhs, width, word_count, true);
+    free(rhs);
+
+    uint64_t* bits = alloc_lut_bits(word_count);
+    for (int w = 0; w < word_count; w++) {
+        uint64_t nonzero = 0;
+        for (int bit = 0; bit < width; bit++) nonzero |= difference[bit * word_count + w];
+        uint64_t less = difference[(width - 1) * word_count + w];
+        switch (sim_expr->op_type) {
+            case TOKEN_EQUAL:         bits[w] = ~nonzero; break;
+            case TOKEN_NOT_EQUAL:     bits[w] = nonzero; break;
+            case TOKEN_LESS:          bits[w] = less; break;
+            case TOKEN_GREATER:       bits[w] = ~less & nonzero; break;
+            case TOKEN_LESS_EQUAL:    bits[w] = less | ~nonzero; break;
+            default:                  bits[w] = ~less; break; // TOKEN_GREATER_EQUAL
+        }
+    }
+    free(difference);
+    return bits;
+}
+
+// Evaluate sim_expr into a freshly owned bit-sliced table. The tree is walked
+// bottom-up exactly once; each parent reuses its left child's table in place
+// and releases the right child's, so at most one table per level is live.
+static uint64_t* eval_lut_bits(SimulatedExpression* sim_expr, HardwareContext* hw_ctx,
+                               uint32_t support_mask, int word_count) {
+    uint64_t* bits = NULL;
+
+    if (sim_expr->width > 0) {
+        // A multi-bit value is true when it is nonzero
+        uint64_t* vector = eval_lut_vector(sim_expr, hw_ctx, support_mask, word_count, sim_expr->width);
+        bits = alloc_lut_bits(word_count);
+        fill_lut_bits(bits, word_count, 0);
+        for (int bit = 0; bit < sim_expr->width; bit++) {
+            for (int w = 0; w < word_count; w++) bits[w] |= vector[bit * word_count + w];
+        }
+        free(vector);
+        return bits;
+    }
+    if (compares_multi_bit(sim_expr)) {
+        return compare_lut_vectors(sim_expr, hw_ctx, support_mask, word_count);
+    }
+
+    switch (sim_expr->type) {
+        case NODE_BINARY_OP: {
+            if (!sim_expr->lhs || !sim_expr->rhs) break;
+            bits = eval_lut_bits(sim_expr->lhs, hw_ctx, support_mask, word_count);
+            uint64_t* rhs_bits = eval_lut_bits(sim_expr->rhs, hw_ctx, support_mask, word_count);
+            combine_lut_bits(bits, rhs_bits, word_count, sim_expr->op_type);
+            free(rhs_bits);
+            return bits;
+        }
+        case NODE_UNARY_OP: {
+            // Unary ops use lhs for operand
+            if (!sim_expr->lhs) break;
+            bits = eval_lut_bits(sim_expr->lhs, hw_ctx, support_mask, word_count);
+            if (sim_expr->op_type == TOKEN_NOT) { // Logical NOT
+                for (int w = 0; w < word_count; w++) bits[w] = ~bits[w];
+            } else {
+                fprintf(stderr, "Warning: Unsupported unary operator for eval_simulated_expression: %d\n", sim_expr->op_type);
+                fill_lut_bits(bits, word_count, 0);
             }
-            default:
-                fprintf(stderr, "Warning: Unsupported AST node type for eval_simulated_expression: %d\n", sim_expr->type);
-                sim_expr->LUT[i] = 0;
-                break;
+            return bits;
+        }
+        default:
+            break;
+    }
+
+    bits = alloc_lut_bits(word_count);
+
+    switch (sim_expr->type) {
+        case NODE_IDENTIFIER: {
+            // This is the "eigenLUT" generation part: the value of the
+            // identifier is its input's bit of the (support-reduced) index
+            int input_num = sim_expr->input_num;
+            if (input_num != -1 && (support_mask & (1u << input_num))) {
+                fill_input_lut_bits(bits, word_count, support_position(support_mask, input_num));
+            } else {
+                // Not an input variable, treat as a constant 0 for evaluation.
+                // If it's a state variable, its value would depend on the current state.
+                fill_lut_bits(bits, word_count, 0);
+            }
+            break;
+        }
+        case NODE_NUMBER_LITERAL:
+        case NODE_BOOL_LITERAL:
+            fill_lut_bits(bits, word_count, (sim_expr->const_value & 1) ? ~0ULL : 0ULL);
+            break;
+        case NODE_BINARY_OP:
+        case NODE_UNARY_OP:
+            // Missing operand; already reported by create_simulated_expression
+            fill_lut_bits(bits, word_count, 0);
+            break;
+        default:
+            fprintf(stderr, "Warning: Unsupported AST node type for eval_simulated_expression: %d\n", sim_expr->type);
+            fill_lut_bits(bits, word_count, 0);
+            break;
+    }
+    return bits;
+}
+
+// Function to evaluate a simulated expression and populate its LUT.
+// The table only enumerates the expression's own support (the inputs in
+// dependent_input_mask, lowest input number first), so LUT_size is
+// 2^support_count rather than 2^num_total_input_vars; use
+// expand_simulated_expression_lut to lay it out over all inputs. It is
+// computed bit-sliced (see eval_lut_bits) and kept in LUT_bits; LUT is the
+// same table with one byte per entry. Only the root of the tree holds tables.
+void eval_simulated_expression(SimulatedExpression* sim_expr, HardwareContext* hw_ctx, int num_total_input_vars) {
+    if (!sim_expr) return;
+
+    uint32_t support_mask = sim_expr->dependent_input_mask;
+    if (num_total_input_vars < 32) {
+        support_mask &= (1u << num_total_input_vars) - 1;
+    }
+    int support_count = count_bits(support_mask);
+
+    int lut_size = 1 << support_count; // 2^support_count
+    int word_count = lut_word_count(lut_size);
+
+    // Re-evaluation replaces any previous table
+    free(sim_expr->LUT);
+    free(sim_expr->LUT_bits);
+
+    uint64_t* bits = eval_lut_bits(sim_expr, hw_ctx, support_mask, word_count);
+
+    // Clear minterms past lut_size so LUT_bits can be compared word by word
+    if (lut_size % LUT_WORD_BITS) {
+        bits[word_count - 1] &= (1ULL << (lut_size % LUT_WORD_BITS)) - 1;
+    }
+
+    uint8_t* lut = (uint8_t*)malloc(sizeof(uint8_t) * lut_size);
+    if (!lut) {
+        fprintf(stderr, "Error: Failed to allocate LUT for simulated expression.\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < lut_size; i++) {
+        lut[i] = (bits[i >> LUT_WORD_SHIFT] >> (i & (LUT_WORD_BITS - 1))) & 1;
+    }
+
+    sim_expr->LUT = lut;
+    sim_expr->LUT_size = lut_size;
+    sim_expr->LUT_bits = bits;
+    sim_expr->LUT_words = word_count;
+    sim_expr->support_mask = support_mask;
+    sim_expr->support_count = support_count;
+}
+
+// Function to write the full 2^num_total_input_vars table of an evaluated
+// expression into dest, indexed by the complete input vector.
+// Support-reduced entry j is replicated over every combination of the inputs
+// the expression does not read; support indices are deposited into the full
+// index with the usual (d - mask) & mask subset walk, which visits them in
+// increasing order.
+void expand_simulated_expression_lut(const SimulatedExpression* sim_expr, uint8_t* dest, int num_total_input_vars) {
+    uint32_t full_mask = num_total_input_vars < 32 ? (1u << num_total_input_vars) - 1 : 0xFFFFFFFFu;
+    uint32_t support_mask = sim_expr->support_mask;
+    uint32_t free_mask = full_mask & ~support_mask;
+
+    uint32_t d = 0;
+    for (int j = 0; j < sim_expr->LUT_size; j++) {
+        uint8_t value = sim_expr->LUT[j];
+        uint32_t c = 0;
+        do {
+            dest[d | c] = value;
+            c = (c - free_mask) & free_mask;
+        } while (c != 0);
+        d = (d - support_mask) & support_mask;
+    }
+}
+
+// --- BDD construction ---
+
+// Build the reduced ordered BDD of a simulated expression. Unlike the flat
+// tables this does not depend on the number of inputs, only on the
+// structure of the function; equal functions give equal refs. Only the root
+// records its ref in sim_expr->bdd.
+static BddRef build_bdd(SimulatedExpression* sim_expr, HardwareContext* hw_ctx, BddManager* mgr);
+
+static BddRef* alloc_bdd_vector(int width) {
+    BddRef* vector = (BddRef*)malloc(sizeof(BddRef) * width);
+    if (!vector) {
+        fprintf(stderr, "Error: Failed to allocate BDD vector for simulated expression.\n");
+        exit(EXIT_FAILURE);
+    }
+    return vector;
+}
+
+// a += b, or a -= b when subtract, bit by bit as in add_lut_vectors
+static void add_bdd_vectors(BddManager* mgr, BddRef* a, const BddRef* b, int width, bool subtract) {
+    BddRef carry = subtract ? BDD_TRUE : BDD_FALSE;
+    for (int bit = 0; bit < width; bit++) {
+        BddRef y = subtract ? bdd_not(mgr, b[bit]) : b[bit];
+        BddRef half = bdd_apply(mgr, BDD_OP_XOR, a[bit], y);
+        BddRef generate = bdd_apply(mgr, BDD_OP_AND, a[bit], y);
+        a[bit] = bdd_apply(mgr, BDD_OP_XOR, half, carry);
+        carry = bdd_apply(mgr, BDD_OP_OR, generate, bdd_apply(mgr, BDD_OP_AND, carry, half));
+    }
+}
+
+// BDDs of the bits of sim_expr as a multi-bit value, as eval_lut_vector
+static BddRef* build_bdd_vector(SimulatedExpression* sim_expr, HardwareContext* hw_ctx, BddManager* mgr, int width) {
+    BddRef* vector;
+    if (sim_expr->type == NODE_BINARY_OP && sim_expr->width > 0) {
+        vector = build_bdd_vector(sim_expr->lhs, hw_ctx, mgr, width);
+        BddRef* rhs = build_bdd_vector(sim_expr->rhs, hw_ctx, mgr, width);
+        if (sim_expr->op_type == TOKEN_PLUS || sim_expr->op_type == TOKEN_MINUS) {
+            add_bdd_vectors(mgr, vector, rhs, width, sim_expr->op_type == TOKEN_MINUS);
+        } else {
+            BddOp op = sim_expr->op_type == TOKEN_AND ? BDD_OP_AND : BDD_OP_OR;
+            for (int bit = 0; bit < width; bit++) vector[bit] = bdd_apply(mgr, op, vector[bit], rhs[bit]);
         }
+        free(rhs);
+        return vector;
     }
+
+    vector = alloc_bdd_vector(width);
+    for (int bit = 0; bit < width; bit++) vector[bit] = BDD_FALSE;
+    if (sim_expr->type == NODE_IDENTIFIER && sim_expr->width > 0) {
+        for (int bit = 0; bit < sim_expr->width - 1 && bit < width; bit++) {
+            int input_num = bit_input_number(hw_ctx, sim_expr->var_name, bit);
+            if (input_num != -1) vector[bit] = bdd_var(mgr, input_num);
+        }
+    } else if (sim_expr->type == NODE_NUMBER_LITERAL) {
+        for (int bit = 0; bit < width; bit++) {
+            vector[bit] = ((sim_expr->const_value >> (bit < 31 ? bit : 31)) & 1) ? BDD_TRUE : BDD_FALSE;
+        }
+    } else {
+        vector[0] = build_bdd(sim_expr, hw_ctx, mgr);
+    }
+    return vector;
+}
+
+// As compare_lut_vectors
+static BddRef compare_bdd_vectors(SimulatedExpression* sim_expr, HardwareContext* hw_ctx, BddManager* mgr) {
+    int width = binary_op_width(TOKEN_MINUS, sim_expr->lhs, sim_expr->rhs);
+    BddRef* difference = build_bdd_vector(sim_expr->lhs, hw_ctx, mgr, width);
+    BddRef* rhs = build_bdd_vector(sim_expr->rhs, hw_ctx, mgr, width);
+    add_bdd_vectors(mgr, difference, rhs, width, true);
+    BddRef nonzero = BDD_FALSE;
+    for (int bit = 0; bit < width; bit++) nonzero = bdd_apply(mgr, BDD_OP_OR, nonzero, difference[bit]);
+    BddRef less = difference[width - 1];
+    free(difference);
+    free(rhs);
+    switch (sim_expr->op_type) {
+        case TOKEN_EQUAL:         return bdd_not(mgr, nonzero);
+        case TOKEN_NOT_EQUAL:     return nonzero;
+        case TOKEN_LESS:          return less;
+        case TOKEN_GREATER:       return bdd_apply(mgr, BDD_OP_AND, bdd_not(mgr, less), nonzero);
+        case TOKEN_LESS_EQUAL:    return bdd_apply(mgr, BDD_OP_OR, less, bdd_not(mgr, nonzero));
+        default:                  return bdd_not(mgr, less); // TOKEN_GREATER_EQUAL
+    }
+}
+
+static BddRef build_bdd(SimulatedExpression* sim_expr, HardwareContext* hw_ctx, BddManager* mgr) {
+    if (sim_expr->width > 0) {
+        // A multi-bit value is true when it is nonzero
+        BddRef* vector = build_bdd_vector(sim_expr, hw_ctx, mgr, sim_expr->width);
+        BddRef nonzero = BDD_FALSE;
+        for (int bit = 0; bit < sim_expr->width; bit++) nonzero = bdd_apply(mgr, BDD_OP_OR, nonzero, vector[bit]);
+        free(vector);
+        return nonzero;
+    }
+    if (compares_multi_bit(sim_expr)) {
+        return compare_bdd_vectors(sim_expr, hw_ctx, mgr);
+    }
+    switch (sim_expr->type) {
+        case NODE_IDENTIFIER:
+            // Non-input identifiers evaluate as constant 0, as in the LUT path
+            return sim_expr->input_num != -1 ? bdd_var(mgr, sim_expr->input_num) : BDD_FALSE;
+        case NODE_NUMBER_LITERAL:
+        case NODE_BOOL_LITERAL:
+            return (sim_expr->const_value & 1) ? BDD_TRUE : BDD_FALSE;
+        case NODE_BINARY_OP: {
+            // Missing operand; already reported by create_simulated_expression
+            if (!sim_expr->lhs || !sim_expr->rhs) return BDD_FALSE;
+            BddRef l = build_bdd(sim_expr->lhs, hw_ctx, mgr);
+            BddRef r = build_bdd(sim_expr->rhs, hw_ctx, mgr);
+            switch (sim_expr->op_type) {
+                case TOKEN_AND:
+                case TOKEN_LOGICAL_AND:
+                    return bdd_apply(mgr, BDD_OP_AND, l, r);
+                case TOKEN_OR:
+                case TOKEN_LOGICAL_OR:
+                    return bdd_apply(mgr, BDD_OP_OR, l, r);
+                case TOKEN_EQUAL:
+                    return bdd_not(mgr, bdd_apply(mgr, BDD_OP_XOR, l, r));
+                case TOKEN_NOT_EQUAL:
+                    return bdd_apply(mgr, BDD_OP_XOR, l, r);
+                case TOKEN_LESS:
+                    return bdd_apply(mgr, BDD_OP_AND, bdd_not(mgr, l), r);
+                case TOKEN_GREATER:
+                    return bdd_apply(mgr, BDD_OP_AND, l, bdd_not(mgr, r));
+                case TOKEN_LESS_EQUAL:
+                    return bdd_apply(mgr, BDD_OP_OR, bdd_not(mgr, l), r);
+                case TOKEN_GREATER_EQUAL:
+                    return bdd_apply(mgr, BDD_OP_OR, l, bdd_not(mgr, r));
+                default:
+                    fprintf(stderr, "Error: Unsupported operator for eval_op: %d\n", sim_expr->op_type);
+                    return BDD_FALSE;
+            }
+        }
+        case NODE_UNARY_OP: {
+            if (!sim_expr->lhs) return BDD_FALSE;
+            BddRef operand = build_bdd(sim_expr->lhs, hw_ctx, mgr);
+            if (sim_expr->op_type == TOKEN_NOT) { // Logical NOT
+                return bdd_not(mgr, operand);
+            }
+            fprintf(stderr, "Warning: Unsupported unary operator for eval_simulated_expression: %d\n", sim_expr->op_type);
+            return BDD_FALSE;
+        }
+        default:
+            fprintf(stderr, "Warning: Unsupported AST node type for eval_simulated_expression: %d\n", sim_expr->type);
+            return BDD_FALSE;
+    }
+}
+
+BddRef build_simulated_expression_bdd(SimulatedExpression* sim_expr, HardwareContext* hw_ctx, BddManager* mgr) {
+    if (!sim_expr || !mgr) return BDD_FALSE;
+    sim_expr->bdd = build_bdd(sim_expr, hw_ctx, mgr);
+    return sim_expr->bdd;
 }
 
 // Function to free a simulated expression tree
@@ -173,5 +695,249 @@ void free_simulated_expression(SimulatedExpression* sim_expr) {
     if (sim_expr->LUT) {
         free(sim_expr->LUT);
     }
+    if (sim_expr->LUT_bits) {
+        free(sim_expr->LUT_bits);
+    }
     free(sim_expr);
-}
\ No newline at end of file
+}
+// --- Hash-consed expressions ---
+// Nodes are found by structure (type, operator, child ids, input symbol or
+// constant), with an open-addressing table of node index + 1. A second
+// table keyed by AST node pointer remembers conversions already done, so a
+// condition handed over twice (e.g. a rotated loop's guard and test) is not
+// even re-walked.
+
+struct SimulatedExpressionTable {
+    HardwareContext* hw_ctx;
+    SimulatedExpression** nodes;
+    SymbolId* symbols;          // Per node: the identifier's symbol, else SYMBOL_NONE
+    int count;
+    int capacity;
+    int* buckets;               // Node index + 1 by structural hash
+    int bucket_count;
+    Node** converted;           // AST nodes already converted ...
+    SimulatedExpression** converted_to; // ... and their nodes
+    int converted_count;
+    int converted_capacity;     // Power of two, kept at most half full
+};
+
+static uint32_t hash_mix(uint32_t h, uint32_t value) {
+    h ^= value;
+    h *= 16777619u;
+    return h;
+}
+
+static uint32_t structure_hash(NodeType type, TokenType op, int lhs_id, int rhs_id,
+                               SymbolId symbol, int const_value) {
+    uint32_t h = 2166136261u;
+    h = hash_mix(h, (uint32_t)type);
+    h = hash_mix(h, (uint32_t)op);
+    h = hash_mix(h, (uint32_t)lhs_id);
+    h = hash_mix(h, (uint32_t)rhs_id);
+    h = hash_mix(h, (uint32_t)symbol);
+    h = hash_mix(h, (uint32_t)const_value);
+    return h;
+}
+
+static uint32_t pointer_hash(const void* p) {
+    uintptr_t v = (uintptr_t)p;
+    return (uint32_t)((v >> 4) ^ (v >> 20)) * 2654435761u;
+}
+
+static void* table_alloc(size_t count, size_t size) {
+    void* p = calloc(count, size);
+    if (!p) {
+        fprintf(stderr, "Error: Failed to allocate simulated expression table.\n");
+        exit(EXIT_FAILURE);
+    }
+    return p;
+}
+
+SimulatedExpressionTable* create_simulated_expression_table(HardwareContext* hw_ctx) {
+    SimulatedExpressionTable* table = table_alloc(1, sizeof(SimulatedExpressionTable));
+    table->hw_ctx = hw_ctx;
+    table->capacity = 16;
+    table->nodes = table_alloc(table->capacity, sizeof(SimulatedExpression*));
+    table->symbols = table_alloc(table->capacity, sizeof(SymbolId));
+    table->bucket_count = 32;
+    table->buckets = table_alloc(table->bucket_count, sizeof(int));
+    table->converted_capacity = 32;
+    table->converted = table_alloc(table->converted_capacity, sizeof(Node*));
+    table->converted_to = table_alloc(table->converted_capacity, sizeof(SimulatedExpression*));
+    return table;
+}
+
+static bool same_structure(const SimulatedExpressionTable* table, int index, NodeType type, TokenType op,
+                           const SimulatedExpression* lhs, const SimulatedExpression* rhs,
+                           SymbolId symbol, int const_value) {
+    const SimulatedExpression* node = table->nodes[index];
+    return node->type == type && node->op_type == op && node->lhs == lhs && node->rhs == rhs &&
+           table->symbols[index] == symbol && node->const_value == const_value;
+}
+
+static void rehash_structures(SimulatedExpressionTable* table) {
+    free(table->buckets);
+    table->bucket_count *= 2;
+    table->buckets = table_alloc(table->bucket_count, sizeof(int));
+    for (int i = 0; i < table->count; i++) {
+        const SimulatedExpression* node = table->nodes[i];
+        uint32_t h = structure_hash(node->type, node->op_type, node->lhs ? node->lhs->id : -1,
+                                    node->rhs ? node->rhs->id : -1, table->symbols[i], node->const_value);
+        int slot = h & (table->bucket_count - 1);
+        while (table->buckets[slot] != 0) slot = (slot + 1) & (table->bucket_count - 1);
+        table->buckets[slot] = i + 1;
+    }
+}
+
+// The node for this structure, created if it is new
+static SimulatedExpression* find_or_add(SimulatedExpressionTable* table, NodeType type, TokenType op,
+                                        SimulatedExpression* lhs, SimulatedExpression* rhs,
+                                        SymbolId symbol, int const_value) {
+    uint32_t h = structure_hash(type, op, lhs ? lhs->id : -1, rhs ? rhs->id : -1, symbol, const_value);
+    int slot = h & (table->bucket_count - 1);
+    while (table->buckets[slot] != 0) {
+        int index = table->buckets[slot] - 1;
+        if (same_structure(table, index, type, op, lhs, rhs, symbol, const_value)) {
+            return table->nodes[index];
+        }
+        slot = (slot + 1) & (table->bucket_count - 1);
+    }
+
+    if (table->count == table->capacity) {
+        table->capacity *= 2;
+        table->nodes = realloc(table->nodes, table->capacity * sizeof(SimulatedExpression*));
+        table->symbols = realloc(table->symbols, table->capacity * sizeof(SymbolId));
+        if (!table->nodes || !table->symbols) {
+            fprintf(stderr, "Error: Failed to allocate simulated expression table.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    SimulatedExpression* node = table_alloc(1, sizeof(SimulatedExpression));
+    node->type = type;
+    node->op_type = op;
+    node->lhs = lhs;
+    node->rhs = rhs;
+    node->const_value = const_value;
+    node->bdd = -1;
+    node->id = table->count;
+    node->input_num = -1;
+    if (symbol != SYMBOL_NONE) {
+        node->var_name = (char*)symbol_name(symbol);
+        node->input_num = get_input_number_by_name(table->hw_ctx, node->var_name);
+        if (node->input_num != -1) {
+            node->dependent_input_mask = 1u << node->input_num;
+        } else {
+            resolve_bit_vector(node, table->hw_ctx);
+        }
+    }
+    if (lhs) node->dependent_input_mask |= lhs->dependent_input_mask;
+    if (rhs) node->dependent_input_mask |= rhs->dependent_input_mask;
+    if (type == NODE_BINARY_OP) {
+        node->width = binary_op_width(op, lhs, rhs);
+    }
+
+    table->nodes[table->count] = node;
+    table->symbols[table->count] = symbol;
+    table->buckets[slot] = ++table->count;
+    if (table->count * 2 > table->bucket_count) {
+        rehash_structures(table);
+    }
+    return node;
+}
+
+static SimulatedExpression** converted_slot(SimulatedExpressionTable* table, Node* ast_expr_node, int* slot) {
+    *slot = pointer_hash(ast_expr_node) & (table->converted_capacity - 1);
+    while (table->converted[*slot] && table->converted[*slot] != ast_expr_node) {
+        *slot = (*slot + 1) & (table->converted_capacity - 1);
+    }
+    return table->converted[*slot] ? &table->converted_to[*slot] : NULL;
+}
+
+static void remember_conversion(SimulatedExpressionTable* table, Node* ast_expr_node, SimulatedExpression* node) {
+    if ((table->converted_count + 1) * 2 > table->converted_capacity) {
+        Node** old_keys = table->converted;
+        SimulatedExpression** old_values = table->converted_to;
+        int old_capacity = table->converted_capacity;
+        table->converted_capacity *= 2;
+        table->converted = table_alloc(table->converted_capacity, sizeof(Node*));
+        table->converted_to = table_alloc(table->converted_capacity, sizeof(SimulatedExpression*));
+        for (int i = 0; i < old_capacity; i++) {
+            if (old_keys[i]) {
+                int slot;
+                converted_slot(table, old_keys[i], &slot);
+                table->converted[slot] = old_keys[i];
+                table->converted_to[slot] = old_values[i];
+            }
+        }
+        free(old_keys);
+        free(old_values);
+    }
+    int slot;
+    converted_slot(table, ast_expr_node, &slot);
+    table->converted[slot] = ast_expr_node;
+    table->converted_to[slot] = node;
+    table->converted_count++;
+}
+
+// Same conversion as create_simulated_expression, into shared nodes
+SimulatedExpression* intern_simulated_expression(SimulatedExpressionTable* table, Node* ast_expr_node) {
+    if (!ast_expr_node) return NULL;
+
+    int slot;
+    SimulatedExpression** done = converted_slot(table, ast_expr_node, &slot);
+    if (done) return *done;
+
+    SimulatedExpression* node;
+    switch (ast_expr_node->type) {
+        case NODE_IDENTIFIER:
+            node = find_or_add(table, NODE_IDENTIFIER, 0, NULL, NULL,
+                               intern_symbol(((IdentifierNode*)ast_expr_node)->name), 0);
+            break;
+        case NODE_NUMBER_LITERAL:
+            node = find_or_add(table, NODE_NUMBER_LITERAL, 0, NULL, NULL, SYMBOL_NONE,
+                               atoi(((NumberLiteralNode*)ast_expr_node)->value));
+            break;
+        case NODE_BOOL_LITERAL:
+            node = find_or_add(table, NODE_BOOL_LITERAL, 0, NULL, NULL, SYMBOL_NONE,
+                               ((BoolLiteralNode*)ast_expr_node)->value);
+            break;
+        case NODE_BINARY_OP: {
+            BinaryOpNode* bin_op_node = (BinaryOpNode*)ast_expr_node;
+            SimulatedExpression* lhs = intern_simulated_expression(table, bin_op_node->left);
+            SimulatedExpression* rhs = intern_simulated_expression(table, bin_op_node->right);
+            node = find_or_add(table, NODE_BINARY_OP, bin_op_node->op, lhs, rhs, SYMBOL_NONE, 0);
+            break;
+        }
+        case NODE_UNARY_OP: {
+            UnaryOpNode* un_op_node = (UnaryOpNode*)ast_expr_node;
+            SimulatedExpression* operand = intern_simulated_expression(table, un_op_node->operand);
+            node = find_or_add(table, NODE_UNARY_OP, un_op_node->op, operand, NULL, SYMBOL_NONE, 0);
+            break;
+        }
+        default:
+            fprintf(stderr, "Warning: Unsupported AST node type for simulated expression: %d\n", ast_expr_node->type);
+            node = find_or_add(table, ast_expr_node->type, 0, NULL, NULL, SYMBOL_NONE, 0);
+            break;
+    }
+    remember_conversion(table, ast_expr_node, node);
+    return node;
+}
+
+int simulated_expression_count(const SimulatedExpressionTable* table) {
+    return table ? table->count : 0;
+}
+
+void free_simulated_expression_table(SimulatedExpressionTable* table) {
+    if (!table) return;
+    for (int i = 0; i < table->count; i++) {
+        free(table->nodes[i]->LUT);
+        free(table->nodes[i]->LUT_bits);
+        free(table->nodes[i]);
+    }
+    free(table->nodes);
+    free(table->symbols);
+    free(table->buckets);
+    free(table->converted);
+    free(table->converted_to);
+    free(table);
+}
@@ -4,6 +4,7 @@
 #include "ast.h"    // For NodeType
 #include "lexer.h"  // For TokenType
 #include "hw_analyzer.h" // For HardwareContext
+#include "bdd.h"         // For BddRef
 
 // Structure to represent a simulated expression for building the Uber LUT
 typedef struct SimulatedExpression {
@@ -12,20 +13,43 @@ typedef struct SimulatedExpression {
     struct SimulatedExpression* lhs; // Left-hand side operand for binary ops
     struct SimulatedExpression* rhs; // Right-hand side operand for binary ops
     char* var_name;     // Variable name for identifiers
+    int input_num;      // Input number of an identifier, -1 if it is not an input
     int const_value;    // Value for number/bool literals
+    int width;          // Two's complement bits of a multi-bit value (a _BitInt input, or
+                        // arithmetic on one), 0 for a truth value
 
     uint8_t* LUT;       // Truth table (Uber LUT fragment) for this expression
     int LUT_size;       // Size of the LUT (2^num_dependent_inputs)
+    uint64_t* LUT_bits; // Same truth table bit-sliced, 64 minterms per word
+    int LUT_words;      // Number of words in LUT_bits
     
     // For identifying which input variables this expression depends on
     // This could be a bitmask or a list of input_numbers
     uint32_t dependent_input_mask; // Bitmask of dependent input variable numbers
+    uint32_t support_mask; // Inputs enumerated by LUT (dependent inputs within range)
+    int support_count;     // Number of bits in support_mask; LUT_size == 1 << support_count
+
+    BddRef bdd;         // ROBDD of the expression when built with a BddManager, else -1
+    int id;             // Index in its SimulatedExpressionTable, -1 outside one
 } SimulatedExpression;
 
+// Hash-consed simulated expressions. Structurally equal subexpressions share
+// one node and each AST node is converted once, so a condition that repeats
+// across a state machine is built, evaluated and expanded once. The table
+// owns its nodes (names point into the intern table); free it, not the nodes.
+typedef struct SimulatedExpressionTable SimulatedExpressionTable;
+
 // Function prototypes for the Expression Evaluator/Simulator
 SimulatedExpression* create_simulated_expression(Node* ast_expr_node, HardwareContext* hw_ctx);
 void eval_simulated_expression(SimulatedExpression* sim_expr, HardwareContext* hw_ctx, int num_total_input_vars);
+void expand_simulated_expression_lut(const SimulatedExpression* sim_expr, uint8_t* dest, int num_total_input_vars);
+BddRef build_simulated_expression_bdd(SimulatedExpression* sim_expr, HardwareContext* hw_ctx, BddManager* mgr);
 int eval_op(int lhv, TokenType op, int rhv);
 void free_simulated_expression(SimulatedExpression* sim_expr);
 
+SimulatedExpressionTable* create_simulated_expression_table(HardwareContext* hw_ctx);
+SimulatedExpression* intern_simulated_expression(SimulatedExpressionTable* table, Node* ast_expr_node);
+int simulated_expression_count(const SimulatedExpressionTable* table);
+void free_simulated_expression_table(SimulatedExpressionTable* table);
+
 #endif // EXPRESSION_EVALUATOR_H
\ No newline at end of file
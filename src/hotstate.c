@@ -0,0 +1,254 @@
+#define _GNU_SOURCE  // For open_memstream
+#include "hotstate.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include "lexer.h"
+#include "parser.h"
+#include "intern.h"
+#include "ast_fold.h"
+#include "cfg_simplify.h"
+#include "cfg_to_microcode.h"
+#include "output_file.h"
+#include "wcet.h"
+
+struct HotstateContext {
+    Arena* spare_arena;     // Released result arena, reused by the next compile
+    char error[256];
+};
+
+// The option globals a compilation reads, saved around hotstate_compile so
+// a host that also runs c_parser code paths sees its own settings again
+typedef struct {
+    int compact_words;
+    int inline_words;
+    int fuse_conditions;
+    int merge_tails;
+    int use_bdd;
+    int rotate_loops;
+    int narrow_fields;
+    int report_encoding;
+    int report_dispatch;
+    int report_wcet;
+    int loop_bound;
+    int switch_bits;
+    int vardata_word_bits;
+    int sparse_vardata;
+    int pipeline;
+    int varsel_logic;
+    int prune_inputs;
+    int fold_constants;
+} SavedOptions;
+
+static SavedOptions save_options(void) {
+    SavedOptions saved = {
+        compact_microcode_words, inline_call_words, fuse_conditions, merge_common_tails, use_bdd_conditions, rotate_loops,
+        narrow_microcode_fields, report_microcode_encoding, report_dispatch_costs,
+        report_wcet, wcet_loop_bound, switch_offset_bits,
+        vardata_word_bits, sparse_vardata, pipeline_delay_slots, use_varsel_logic,
+        prune_unused_inputs, fold_constants
+    };
+    return saved;
+}
+
+static void restore_options(const SavedOptions* saved) {
+    compact_microcode_words = saved->compact_words;
+    inline_call_words = saved->inline_words;
+    fuse_conditions = saved->fuse_conditions;
+    merge_common_tails = saved->merge_tails;
+    use_bdd_conditions = saved->use_bdd;
+    rotate_loops = saved->rotate_loops;
+    narrow_microcode_fields = saved->narrow_fields;
+    report_microcode_encoding = saved->report_encoding;
+    report_dispatch_costs = saved->report_dispatch;
+    report_wcet = saved->report_wcet;
+    wcet_loop_bound = saved->loop_bound;
+    switch_offset_bits = saved->switch_bits;
+    vardata_word_bits = saved->vardata_word_bits;
+    sparse_vardata = saved->sparse_vardata;
+    pipeline_delay_slots = saved->pipeline;
+    use_varsel_logic = saved->varsel_logic;
+    prune_unused_inputs = saved->prune_inputs;
+    fold_constants = saved->fold_constants;
+}
+
+static void set_error(HotstateContext* ctx, const char* message) {
+    snprintf(ctx->error, sizeof(ctx->error), "%s", message);
+}
+
+// Run one writer into a malloc'd buffer
+static bool capture(HotstateBuffer* buffer, CompactMicrocode* mc, void (*write)(CompactMicrocode*, FILE*)) {
+    FILE* stream = open_memstream(&buffer->data, &buffer->size);
+    if (!stream) return false;
+    write(mc, stream);
+    return fclose(stream) == 0;
+}
+
+static void write_listing(CompactMicrocode* mc, FILE* stream) {
+    print_compact_microcode_table(mc, stream);
+    print_compact_microcode_analysis(mc, stream);
+}
+
+HotstateContext* hotstate_create(void) {
+    HotstateContext* ctx = calloc(1, sizeof(HotstateContext));
+    return ctx;
+}
+
+void hotstate_destroy(HotstateContext* ctx) {
+    if (!ctx) return;
+    if (ctx->spare_arena) {
+        arena_destroy(ctx->spare_arena);
+    }
+    free_symbol_table();
+    free(ctx);
+}
+
+const char* hotstate_error(const HotstateContext* ctx) {
+    return ctx->error;
+}
+
+HotstateResult* hotstate_compile(HotstateContext* ctx, const char* source, const HotstateOptions* options) {
+    static const HotstateOptions defaults = {0};
+    if (!options) options = &defaults;
+    ctx->error[0] = '\0';
+    if (!source) {
+        set_error(ctx, "No source given");
+        return NULL;
+    }
+
+    HotstateResult* result = calloc(1, sizeof(HotstateResult));
+    if (!result) {
+        set_error(ctx, "Out of memory");
+        return NULL;
+    }
+    if (ctx->spare_arena) {
+        result->arena = ctx->spare_arena;
+        ctx->spare_arena = NULL;
+    } else {
+        result->arena = arena_create(ARENA_DEFAULT_CHUNK_SIZE);
+    }
+
+    SavedOptions saved = save_options();
+    compact_microcode_words = options->compact_words;
+    inline_call_words = options->inline_words > 0 ? options->inline_words : 2;
+    fuse_conditions = options->fuse_conditions;
+    merge_common_tails = options->merge_tails;
+    use_bdd_conditions = options->use_bdd;
+    rotate_loops = options->rotate_loops;
+    narrow_microcode_fields = options->narrow_fields;
+    report_microcode_encoding = 0;
+    report_dispatch_costs = 0;
+    report_wcet = 0;
+    wcet_loop_bound = 0;
+    vardata_word_bits = options->vardata_bits > 0 ? options->vardata_bits : 1;
+    sparse_vardata = options->sparse_vardata;
+    pipeline_delay_slots = options->pipeline;
+    use_varsel_logic = 0;  // Its module is named after a file the result does not have
+    prune_unused_inputs = options->prune_inputs;
+    fold_constants = options->fold_constants;
+
+    // Lex and parse; a parse error comes back here instead of exiting.
+    // Locals used after a longjmp are volatile.
+    ast_set_arena(result->arena);
+    TokenList* volatile tokens = lexer_tokenize(source, result->arena);
+    Parser* volatile parser = parser_create(source, tokens->items, tokens->count);
+    jmp_buf on_parse_error;
+    jmp_buf* outer_handler = parser_error_jump;
+    Node* volatile ast_root = NULL;
+    if (setjmp(on_parse_error) == 0) {
+        parser_error_jump = &on_parse_error;
+        ast_root = parse(parser);
+    } else {
+        set_error(ctx, "Parse error (details on stderr)");
+    }
+    parser_error_jump = outer_handler;
+    parser_destroy(parser);
+    free_token_list(tokens);
+
+    if (ast_root) {
+        if (fold_constants) {
+            fold_program_constants(ast_root);
+        }
+        switch_offset_bits = options->switch_bits > 0 ? options->switch_bits
+                                                      : calculate_required_switch_bits(ast_root);
+        result->switch_bits = switch_offset_bits;
+        result->hw_ctx = analyze_hardware_constructs(ast_root);
+        if (!result->hw_ctx) {
+            set_error(ctx, "Failed to analyze hardware constructs");
+        } else {
+            result->microcode = ast_to_compact_microcode(ast_root, result->hw_ctx);
+            if (!result->microcode) {
+                set_error(ctx, "Failed to generate compact microcode");
+            }
+        }
+    } else if (!ctx->error[0]) {
+        set_error(ctx, "Parsing failed to produce an AST");
+    }
+
+    // The writers read the option globals too, so capture before restoring
+    CompactMicrocode* mc = result->microcode;
+    if (mc && !(capture(&result->params_vh, mc, write_microcode_params_vh) &&
+                capture(&result->smdata, mc, write_smdata_mem) &&
+                capture(&result->vardata, mc, write_vardata_mem) &&
+                capture(&result->switchdata, mc, write_switchdata_mem) &&
+                capture(&result->symbols, mc, write_symbol_table) &&
+                capture(&result->image, mc, write_image) &&
+                capture(&result->timdata, mc, write_timdata_mem) &&
+                capture(&result->listing, mc, write_listing))) {
+        set_error(ctx, "Out of memory");
+    }
+    ast_set_arena(NULL);
+    restore_options(&saved);
+
+    if (ctx->error[0]) {
+        hotstate_release(ctx, result);
+        return NULL;
+    }
+    return result;
+}
+
+static bool write_buffer(const HotstateBuffer* buffer, const char* source_filename, const char* suffix) {
+    char* path = generate_output_filepath(source_filename, suffix);
+    FILE* file = path ? output_file_open(path, "wb") : NULL;
+    if (!file) {
+        fprintf(stderr, "Error: Cannot write file '%s'\n", path ? path : suffix);
+        free(path);
+        return false;
+    }
+    fwrite(buffer->data, 1, buffer->size, file);
+    bool ok = output_file_close(file, path); // Unchanged files keep their timestamps
+    free(path);
+    return ok;
+}
+
+bool hotstate_write_outputs(const HotstateResult* result, const char* source_filename) {
+    return write_buffer(&result->params_vh, source_filename, "_params.vh") &&
+           write_buffer(&result->smdata, source_filename, "_smdata.mem") &&
+           write_buffer(&result->vardata, source_filename, "_vardata.mem") &&
+           write_buffer(&result->switchdata, source_filename, "_switchdata.mem") &&
+           write_buffer(&result->symbols, source_filename, "_symbols.toml") &&
+           write_buffer(&result->image, source_filename, "_image.bin") &&
+           (result->timdata.size == 0 || write_buffer(&result->timdata, source_filename, "_timdata.mem"));
+}
+
+void hotstate_release(HotstateContext* ctx, HotstateResult* result) {
+    if (!result) return;
+    free_compact_microcode(result->microcode);
+    free_hardware_context(result->hw_ctx);
+    free(result->params_vh.data);
+    free(result->smdata.data);
+    free(result->vardata.data);
+    free(result->switchdata.data);
+    free(result->symbols.data);
+    free(result->image.data);
+    free(result->timdata.data);
+    free(result->listing.data);
+    if (ctx && !ctx->spare_arena) {
+        arena_reset(result->arena);
+        ctx->spare_arena = result->arena;
+    } else {
+        arena_destroy(result->arena);
+    }
+    free(result);
+}
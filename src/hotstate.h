@@ -0,0 +1,94 @@
+#ifndef HOTSTATE_H
+#define HOTSTATE_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "arena.h"
+#include "hw_analyzer.h"
+#include "ast_to_microcode.h"
+
+// libhotstate: compile a program held in memory to hotstate microcode and
+// get back the CompactMicrocode and every output file as in-memory buffers,
+// so a test harness or the simulator can compile in-process instead of
+// running c_parser --microcode-hs and reading its files back.
+//
+// A context is created once and reused for any number of compilations.
+// The compiler keeps its options in globals, so one context is used by one
+// thread at a time, and no two contexts compile concurrently.
+//
+// The source is compiled as given: #include directives are not expanded
+// (they are for files, see preprocess_includes). A parse error returns NULL
+// with the message available from hotstate_error(); internal errors and
+// allocation failures still terminate the process as they do in c_parser.
+
+typedef struct HotstateOptions {
+    int compact_words;   // --compact-words
+    int inline_words;    // --inline-words; 0 means the default, 2
+    int fuse_conditions; // --fuse-conditions
+    int merge_tails;     // MERGE_TAILS_SPEED for --merge-tails, MERGE_TAILS_SIZE for --merge-tails-size
+    int use_bdd;         // --bdd
+    int rotate_loops;    // --rotate-loops
+    int narrow_fields;   // --narrow-fields
+    int switch_bits;     // --switch-bits; 0 detects it from the program
+    int vardata_bits;    // --vardata-bits; 0 means 1
+    int sparse_vardata;  // --vardata-sparse
+    int pipeline;        // --pipeline
+    int prune_inputs;    // --prune-inputs
+    int fold_constants;  // --fold-constants
+} HotstateOptions;
+
+typedef struct {
+    char* data;   // NUL terminated for convenience; the image is binary
+    size_t size;  // Bytes, not counting the terminator
+} HotstateBuffer;
+
+typedef struct {
+    CompactMicrocode* microcode;
+    HardwareContext* hw_ctx;     // States and inputs the microcode refers to
+    int switch_bits;             // Switch offset bits actually used
+
+    // The files --microcode-hs writes next to the source, byte for byte
+    HotstateBuffer params_vh;    // _params.vh
+    HotstateBuffer smdata;       // _smdata.mem
+    HotstateBuffer vardata;      // _vardata.mem
+    HotstateBuffer switchdata;   // _switchdata.mem
+    HotstateBuffer symbols;      // _symbols.toml
+    HotstateBuffer image;        // _image.bin
+    HotstateBuffer timdata;      // _timdata.mem; empty, and not written, without delays
+
+    // The microcode table and analysis --microcode-hs prints
+    HotstateBuffer listing;
+
+    Arena* arena;                // Private: holds the AST the microcode refers to
+} HotstateResult;
+
+typedef struct HotstateContext HotstateContext;
+
+HotstateContext* hotstate_create(void);
+
+// Also releases the interned symbol table, so destroy the last context only
+// once no other compilation in the process needs it
+void hotstate_destroy(HotstateContext* ctx);
+
+// options may be NULL for the c_parser defaults. Returns NULL on failure.
+HotstateResult* hotstate_compile(HotstateContext* ctx, const char* source, const HotstateOptions* options);
+
+// Write the result's output files next to source_filename, named as
+// --microcode-hs names them; false if any could not be written
+bool hotstate_write_outputs(const HotstateResult* result, const char* source_filename);
+
+// Frees a result; its memory is kept in ctx for the next compilation
+void hotstate_release(HotstateContext* ctx, HotstateResult* result);
+
+// Why the last hotstate_compile on ctx failed, or "" if it succeeded
+const char* hotstate_error(const HotstateContext* ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HOTSTATE_H
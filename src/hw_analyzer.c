@@ -1,5 +1,6 @@
 #define _GNU_SOURCE  // For strdup
 #include "hw_analyzer.h"
+#include "ast_flat.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -17,6 +18,9 @@ static void build_lookup_tables(HardwareContext* ctx);
 static void traverse_ast_for_variables(Node* node, HardwareContext* ctx);
 static bool extract_initial_bool_value(Node* initializer);
 static int assign_sequential_state_numbers(HardwareContext* ctx);
+static void prune_inputs(HardwareContext* ctx, Node* ast);
+
+int prune_unused_inputs = 0;
 
 // --- Main Analysis Function ---
 
@@ -33,14 +37,19 @@ HardwareContext* analyze_hardware_constructs(Node* ast) {
     
     // Assign sequential state numbers to all state variables
     assign_sequential_state_numbers(ctx);
+
+    if (prune_unused_inputs) {
+        prune_inputs(ctx, ast);
+    }
     
     // Build lookup tables for fast access
     build_lookup_tables(ctx);
     
     // Validate the hardware context
     ctx->analysis_successful = validate_hardware_context(ctx);
-    // Add debug print of hardware context
-    print_hardware_context(ctx, stderr);
+    if (debug_mode) {
+        print_hardware_context(ctx, stderr);
+    }
     
     return ctx;
 }
@@ -52,8 +61,10 @@ HardwareVarType classify_variable(VarDeclNode* var_decl) {
         return HW_VAR_UNKNOWN;
     }
     
-    // Must be boolean, integer, or char type (for hardware variables)
-    if (var_decl->var_type != TOKEN_BOOL && var_decl->var_type != TOKEN_INT && var_decl->var_type != TOKEN_CHAR) {
+    // Must be boolean, integer, or char type (for hardware variables), or a
+    // _BitInt input
+    if (var_decl->var_type != TOKEN_BOOL && var_decl->var_type != TOKEN_INT && var_decl->var_type != TOKEN_CHAR &&
+        var_decl->var_type != TOKEN_BITINT) {
         return HW_VAR_UNKNOWN;
     }
     
@@ -80,9 +91,12 @@ bool is_state_variable(VarDeclNode* var_decl) {
 
 bool is_input_variable(VarDeclNode* var_decl) {
     // Input variables:
-    // 1. Must be boolean, integer, or char type
+    // 1. Must be boolean, integer, or char type, or a single _BitInt (one
+    //    input per bit)
     // 2. Must NOT have initialization (uninitialized global variables are input variables)
-    return (var_decl->var_type == TOKEN_BOOL || var_decl->var_type == TOKEN_INT || var_decl->var_type == TOKEN_CHAR) &&
+    bool bit_vector = var_decl->var_type == TOKEN_BITINT && var_decl->array_size == 0 && var_decl->bit_width > 0;
+    return (var_decl->var_type == TOKEN_BOOL || var_decl->var_type == TOKEN_INT || var_decl->var_type == TOKEN_CHAR ||
+            bit_vector) &&
            (var_decl->initializer == NULL);
 }
 
@@ -177,7 +191,8 @@ static void traverse_ast_for_variables(Node* node, HardwareContext* ctx) {
         
         case NODE_FOR: {
             ForNode* for_node = (ForNode*)node;
-            if (for_node->init) {
+            // A delay loop runs on a timer; its own counter is never a state
+            if (for_node->init && delay_loop_trips(for_node) < 0) {
                 traverse_ast_for_variables(for_node->init, ctx);
             }
             traverse_ast_for_variables(for_node->body, ctx);
@@ -205,6 +220,10 @@ static void init_hardware_context(HardwareContext* ctx) {
     ctx->all_var_names = NULL;
     ctx->var_types = NULL;
     ctx->total_var_count = 0;
+
+    ctx->state_index_by_symbol = NULL;
+    ctx->input_index_by_symbol = NULL;
+    ctx->lookup_size = 0;
     
     ctx->analysis_successful = false;
     ctx->error_message = NULL;
@@ -212,6 +231,9 @@ static void init_hardware_context(HardwareContext* ctx) {
     // Initialize initial_state_value and initial_mask_value
     ctx->initial_state_value = 0;
     ctx->initial_mask_value = 0;
+
+    ctx->pruned_inputs = NULL;
+    ctx->pruned_input_count = 0;
 }
 
 static void add_state_variable(HardwareContext* ctx, VarDeclNode* var_decl) {
@@ -236,6 +258,7 @@ static void add_state_variable(HardwareContext* ctx, VarDeclNode* var_decl) {
             state->state_number = -1; // Will be assigned sequentially later
         }
         
+        state->symbol = intern_symbol(state->name);
         state->initial_value = extract_initial_bool_value(var_decl->initializer);
         state->ast_node = var_decl;
         
@@ -250,6 +273,7 @@ static void add_input_variable(HardwareContext* ctx, VarDeclNode* var_decl) {
     
     InputVariable* input = &ctx->inputs[ctx->input_count];
     input->name = strdup(var_decl->var_name);
+    input->symbol = intern_symbol(input->name);
     input->input_number = ctx->input_count;  // Auto-assign sequential numbers
     input->ast_node = var_decl;
     
@@ -257,10 +281,12 @@ static void add_input_variable(HardwareContext* ctx, VarDeclNode* var_decl) {
 }
 
 static void add_input_variable_with_array_support(HardwareContext* ctx, VarDeclNode* var_decl) {
-    // Check if this is an array declaration
-    if (var_decl->array_size > 0) {
+    // Check if this is an array declaration, or a _BitInt whose bits are
+    // indexed the same way (bit 0 is the least significant)
+    int elements = var_decl->var_type == TOKEN_BITINT ? var_decl->bit_width : var_decl->array_size;
+    if (elements > 0) {
         // Add each array element as a separate input variable
-        for (int i = 0; i < var_decl->array_size; i++) {
+        for (int i = 0; i < elements; i++) {
             if (ctx->input_count >= ctx->input_capacity) {
                 resize_input_array(ctx);
             }
@@ -271,6 +297,7 @@ static void add_input_variable_with_array_support(HardwareContext* ctx, VarDeclN
             char* element_name = malloc(strlen(var_decl->var_name) + 10);
             sprintf(element_name, "%s[%d]", var_decl->var_name, i);
             input->name = element_name;
+            input->symbol = intern_symbol(element_name);
             input->input_number = ctx->input_count;
             input->ast_node = var_decl;
             
@@ -282,6 +309,65 @@ static void add_input_variable_with_array_support(HardwareContext* ctx, VarDeclN
     }
 }
 
+// Inputs ordered by reads, most first; declaration order breaks ties
+static int input_read_order(const void* a, const void* b) {
+    const int* x = a;
+    const int* y = b;
+    if (x[1] != y[1]) return y[1] - x[1];
+    return x[0] - y[0];
+}
+
+// --prune-inputs. An input counts as read wherever an identifier names its
+// declaration, so a read of an array reads every element.
+static void prune_inputs(HardwareContext* ctx, Node* ast) {
+    if (ctx->input_count == 0) return;
+    // (input index, reads) pairs
+    int* order = calloc(ctx->input_count * 2, sizeof(int));
+    if (!order) {
+        fprintf(stderr, "Error: Failed to allocate input usage counts.\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < ctx->input_count; i++) {
+        order[i * 2] = i;
+    }
+    FlatAst* flat = flatten_ast(ast);
+    for (uint32_t n = 0; n < flat->count; n++) {
+        if (flat->nodes[n]->type != NODE_IDENTIFIER) continue;
+        const char* name = ((IdentifierNode*)flat->nodes[n])->name;
+        for (int i = 0; i < ctx->input_count; i++) {
+            if (strcmp(ctx->inputs[i].ast_node->var_name, name) == 0) {
+                order[i * 2 + 1]++;
+            }
+        }
+    }
+    free_flat_ast(flat);
+    qsort(order, ctx->input_count, sizeof(int) * 2, input_read_order);
+
+    InputVariable* kept = malloc(sizeof(InputVariable) * ctx->input_capacity);
+    ctx->pruned_inputs = malloc(sizeof(char*) * ctx->input_count);
+    if (!kept || !ctx->pruned_inputs) {
+        fprintf(stderr, "Error: Failed to allocate pruned inputs.\n");
+        exit(EXIT_FAILURE);
+    }
+    int kept_count = 0;
+    for (int k = 0; k < ctx->input_count; k++) {
+        InputVariable* input = &ctx->inputs[order[k * 2]];
+        if (order[k * 2 + 1] == 0) {
+            print_debug("DEBUG: prune_inputs: %s is never read\n", input->name);
+            ctx->pruned_inputs[ctx->pruned_input_count++] = input->name;
+            continue;
+        }
+        kept[kept_count] = *input;
+        kept[kept_count].input_number = kept_count;
+        print_debug("DEBUG: prune_inputs: %s is read %d times, input%d\n", input->name, order[k * 2 + 1], kept_count);
+        kept_count++;
+    }
+    free(order);
+    free(ctx->inputs);
+    ctx->inputs = kept;
+    ctx->input_count = kept_count;
+}
+
 static bool extract_initial_bool_value(Node* initializer) {
     if (!initializer) return false;
     
@@ -310,9 +396,20 @@ static void resize_input_array(HardwareContext* ctx) {
 
 // --- Lookup Functions ---
 
+// Every hardware variable name is interned when it is added, so a name
+// that was never interned cannot match anything. Once the lookup tables are
+// built each query is a hash of the name plus one array index.
+
 int get_state_number_by_name(HardwareContext* ctx, const char* var_name) {
+    SymbolId symbol = find_symbol(var_name);
+    if (symbol == SYMBOL_NONE) return -1;
+    if (ctx->state_index_by_symbol) {
+        if (symbol >= ctx->lookup_size) return -1;
+        int index = ctx->state_index_by_symbol[symbol];
+        return index >= 0 ? ctx->states[index].state_number : -1;
+    }
     for (int i = 0; i < ctx->state_count; i++) {
-        if (strcmp(ctx->states[i].name, var_name) == 0) {
+        if (ctx->states[i].symbol == symbol) {
             return ctx->states[i].state_number;
         }
     }
@@ -320,14 +417,32 @@ int get_state_number_by_name(HardwareContext* ctx, const char* var_name) {
 }
 
 int get_input_number_by_name(HardwareContext* ctx, const char* var_name) {
+    SymbolId symbol = find_symbol(var_name);
+    if (symbol == SYMBOL_NONE) return -1;
+    if (ctx->input_index_by_symbol) {
+        if (symbol >= ctx->lookup_size) return -1;
+        int index = ctx->input_index_by_symbol[symbol];
+        return index >= 0 ? ctx->inputs[index].input_number : -1;
+    }
     for (int i = 0; i < ctx->input_count; i++) {
-        if (strcmp(ctx->inputs[i].name, var_name) == 0) {
+        if (ctx->inputs[i].symbol == symbol) {
             return ctx->inputs[i].input_number;
         }
     }
     return -1;
 }
 
+int get_input_width_by_name(HardwareContext* ctx, const char* var_name) {
+    if (!ctx) return 0;
+    for (int i = 0; i < ctx->input_count; i++) {
+        VarDeclNode* decl = ctx->inputs[i].ast_node;
+        if (decl->var_type == TOKEN_BITINT && strcmp(decl->var_name, var_name) == 0) {
+            return decl->bit_width;
+        }
+    }
+    return 0;
+}
+
 HardwareVarType get_variable_type(HardwareContext* ctx, const char* var_name) {
     if (get_state_number_by_name(ctx, var_name) >= 0) {
         return HW_VAR_STATE;
@@ -362,7 +477,7 @@ bool check_variable_name_conflicts(HardwareContext* ctx) {
     // Check for duplicate variable names between states and inputs
     for (int i = 0; i < ctx->state_count; i++) {
         for (int j = 0; j < ctx->input_count; j++) {
-            if (strcmp(ctx->states[i].name, ctx->inputs[j].name) == 0) {
+            if (ctx->states[i].symbol == ctx->inputs[j].symbol) {
                 ctx->error_message = strdup("Variable name conflict between state and input");
                 return false;
             }
@@ -401,6 +516,9 @@ void print_input_variables(HardwareContext* ctx, FILE* output) {
         fprintf(output, "  %s -> input%d\n", 
                 input->name, input->input_number);
     }
+    for (int i = 0; i < ctx->pruned_input_count; i++) {
+        fprintf(output, "  %s -> never read, pruned\n", ctx->pruned_inputs[i]);
+    }
 }
 
 // --- Memory Management ---
@@ -419,6 +537,10 @@ void free_hardware_context(HardwareContext* ctx) {
         free(ctx->inputs[i].name);
     }
     free(ctx->inputs);
+    for (int i = 0; i < ctx->pruned_input_count; i++) {
+        free(ctx->pruned_inputs[i]);
+    }
+    free(ctx->pruned_inputs);
     
     // Free lookup tables
     if (ctx->all_var_names) {
@@ -428,6 +550,8 @@ void free_hardware_context(HardwareContext* ctx) {
         free(ctx->all_var_names);
     }
     free(ctx->var_types);
+    free(ctx->state_index_by_symbol);
+    free(ctx->input_index_by_symbol);
     
     // Free error message
     free(ctx->error_message);
@@ -435,10 +559,36 @@ void free_hardware_context(HardwareContext* ctx) {
     free(ctx);
 }
 
-// --- Build Lookup Tables (placeholder for future optimization) ---
+// --- Build Lookup Tables ---
 
+// Map each interned name to its state/input index. Every hardware variable
+// has been interned by now, so the maps only need to cover the ids handed
+// out so far; later symbols are by construction not hardware variables.
 static void build_lookup_tables(HardwareContext* ctx) {
-    // For now, we use the direct lookup functions
-    // This can be optimized later with hash tables if needed
     ctx->total_var_count = ctx->state_count + ctx->input_count;
+
+    free(ctx->state_index_by_symbol);
+    free(ctx->input_index_by_symbol);
+    ctx->lookup_size = symbol_count();
+    int map_size = ctx->lookup_size > 0 ? ctx->lookup_size : 1;
+    ctx->state_index_by_symbol = malloc(sizeof(int) * map_size);
+    ctx->input_index_by_symbol = malloc(sizeof(int) * map_size);
+    for (int i = 0; i < map_size; i++) {
+        ctx->state_index_by_symbol[i] = -1;
+        ctx->input_index_by_symbol[i] = -1;
+    }
+
+    // First declaration wins, matching the previous linear search order
+    for (int i = 0; i < ctx->state_count; i++) {
+        SymbolId symbol = ctx->states[i].symbol;
+        if (ctx->state_index_by_symbol[symbol] < 0) {
+            ctx->state_index_by_symbol[symbol] = i;
+        }
+    }
+    for (int i = 0; i < ctx->input_count; i++) {
+        SymbolId symbol = ctx->inputs[i].symbol;
+        if (ctx->input_index_by_symbol[symbol] < 0) {
+            ctx->input_index_by_symbol[symbol] = i;
+        }
+    }
 }
\ No newline at end of file
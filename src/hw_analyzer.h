@@ -15,6 +15,7 @@ typedef enum {
 // State variable information
 typedef struct {
     char* name;              // Variable name (e.g., "LED0")
+    SymbolId symbol;         // Interned name for integer comparisons
     int state_number;        // State number from comment (e.g., 0 from /* state0 */)
     bool initial_value;      // Initial value (0 or 1)
     VarDeclNode* ast_node;   // Reference to AST node
@@ -23,6 +24,7 @@ typedef struct {
 // Input variable information  
 typedef struct {
     char* name;              // Variable name (e.g., "a0")
+    SymbolId symbol;         // Interned name for integer comparisons
     int input_number;        // Auto-assigned input number
     VarDeclNode* ast_node;   // Reference to AST node
 } InputVariable;
@@ -43,6 +45,12 @@ typedef struct {
     char** all_var_names;    // All variable names for quick lookup
     HardwareVarType* var_types; // Corresponding types
     int total_var_count;
+
+    // Name -> index maps, indexed by interned SymbolId (-1 = not present).
+    // Built once by build_lookup_tables at the end of analysis.
+    int* state_index_by_symbol;
+    int* input_index_by_symbol;
+    int lookup_size;         // Number of symbols covered by the maps
     
     // Analysis results
     bool analysis_successful;
@@ -50,8 +58,17 @@ typedef struct {
 
     uint32_t initial_state_value; // Combined initial state value for all state variables
     uint32_t initial_mask_value;  // Combined initial mask for all state variables
+
+    // Inputs --prune-inputs left out because the program never reads them
+    char** pruned_inputs;
+    int pruned_input_count;
 } HardwareContext;
 
+// Leave inputs the program never reads out of the context, so they take no
+// vardata address bit, and number the rest by how often they are read,
+// most first (--prune-inputs)
+extern int prune_unused_inputs;
+
 // --- Core API Functions ---
 
 // Main analysis function
@@ -68,6 +85,9 @@ bool is_common_input_name(const char* var_name);
 // Lookup functions
 int get_state_number_by_name(HardwareContext* ctx, const char* var_name);
 int get_input_number_by_name(HardwareContext* ctx, const char* var_name);
+// Bits of the _BitInt input var_name, whose bit i is the input named
+// "var_name[i]"; 0 when var_name is not one
+int get_input_width_by_name(HardwareContext* ctx, const char* var_name);
 HardwareVarType get_variable_type(HardwareContext* ctx, const char* var_name);
 
 // Validation functions
@@ -0,0 +1,136 @@
+#include "intern.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Open-addressing hash table of ids, indexing into a dense array of names.
+// Slots hold id + 1 so that zero means empty.
+static char** symbol_names = NULL;
+static uint32_t* symbol_hashes = NULL;
+static int symbols_count = 0;
+static int symbols_capacity = 0;
+
+static int* slots = NULL;
+static uint32_t slot_mask = 0; // slot count - 1 (power of two)
+
+static uint32_t hash_string(const char* str, size_t len) {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    const unsigned char* p = (const unsigned char*)str;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= p[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static void rehash_slots(uint32_t new_slot_count) {
+    free(slots);
+    slots = calloc(new_slot_count, sizeof(int));
+    if (!slots) {
+        fprintf(stderr, "Error: Failed to allocate symbol table\n");
+        exit(EXIT_FAILURE);
+    }
+    slot_mask = new_slot_count - 1;
+
+    for (int id = 0; id < symbols_count; id++) {
+        uint32_t i = symbol_hashes[id] & slot_mask;
+        while (slots[i] != 0) {
+            i = (i + 1) & slot_mask;
+        }
+        slots[i] = id + 1;
+    }
+}
+
+// Returns the slot index holding the len-byte name, or the empty slot where
+// it would go
+static uint32_t probe(const char* name, size_t len, uint32_t hash) {
+    uint32_t i = hash & slot_mask;
+    while (slots[i] != 0) {
+        int id = slots[i] - 1;
+        if (symbol_hashes[id] == hash && strncmp(symbol_names[id], name, len) == 0 &&
+            symbol_names[id][len] == '\0') {
+            return i;
+        }
+        i = (i + 1) & slot_mask;
+    }
+    return i;
+}
+
+SymbolId intern_symbol(const char* name) {
+    if (!name) return SYMBOL_NONE;
+    return intern_symbol_n(name, strlen(name));
+}
+
+SymbolId intern_symbol_n(const char* name, size_t len) {
+    if (!name) return SYMBOL_NONE;
+
+    if (!slots) {
+        rehash_slots(256);
+    }
+
+    uint32_t hash = hash_string(name, len);
+    uint32_t i = probe(name, len, hash);
+    if (slots[i] != 0) {
+        return slots[i] - 1;
+    }
+
+    // New symbol
+    if (symbols_count >= symbols_capacity) {
+        symbols_capacity = symbols_capacity == 0 ? 64 : symbols_capacity * 2;
+        symbol_names = realloc(symbol_names, sizeof(char*) * symbols_capacity);
+        symbol_hashes = realloc(symbol_hashes, sizeof(uint32_t) * symbols_capacity);
+        if (!symbol_names || !symbol_hashes) {
+            fprintf(stderr, "Error: Failed to grow symbol table\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    char* copy = malloc(len + 1);
+    memcpy(copy, name, len);
+    copy[len] = '\0';
+
+    SymbolId id = symbols_count++;
+    symbol_names[id] = copy;
+    symbol_hashes[id] = hash;
+    slots[i] = id + 1;
+
+    // Keep the load factor under one half
+    if ((uint32_t)symbols_count * 2 > slot_mask + 1) {
+        rehash_slots((slot_mask + 1) * 2);
+    }
+
+    return id;
+}
+
+SymbolId find_symbol(const char* name) {
+    if (!name || !slots) return SYMBOL_NONE;
+    size_t len = strlen(name);
+    uint32_t i = probe(name, len, hash_string(name, len));
+    return slots[i] != 0 ? slots[i] - 1 : SYMBOL_NONE;
+}
+
+const char* symbol_name(SymbolId id) {
+    if (id < 0 || id >= symbols_count) return NULL;
+    return symbol_names[id];
+}
+
+int symbol_count(void) {
+    return symbols_count;
+}
+
+void free_symbol_table(void) {
+    for (int i = 0; i < symbols_count; i++) {
+        free(symbol_names[i]);
+    }
+    free(symbol_names);
+    free(symbol_hashes);
+    free(slots);
+    symbol_names = NULL;
+    symbol_hashes = NULL;
+    slots = NULL;
+    slot_mask = 0;
+    symbols_count = 0;
+    symbols_capacity = 0;
+}
@@ -0,0 +1,31 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stddef.h>
+
+// Global string interning table.
+// Every distinct identifier spelling gets a stable integer SymbolId, so name
+// comparisons in the analyzer and CFG builder become integer compares.
+
+typedef int SymbolId;
+
+#define SYMBOL_NONE (-1)
+
+// Return the id for name, adding it to the table if it is new
+SymbolId intern_symbol(const char* name);
+
+// Same, for a name that is not NUL-terminated (e.g. a slice of the source)
+SymbolId intern_symbol_n(const char* name, size_t len);
+
+// Return the id for name, or SYMBOL_NONE if it was never interned
+SymbolId find_symbol(const char* name);
+
+// Return the canonical spelling of an id (owned by the table)
+const char* symbol_name(SymbolId id);
+
+int symbol_count(void);
+
+// Release all interned strings; previously returned ids become invalid
+void free_symbol_table(void);
+
+#endif // INTERN_H
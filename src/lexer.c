@@ -1,14 +1,42 @@
 #include "lexer.h"
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
+
+#if defined(__SSE2__) && defined(__GNUC__)
+#include <emmintrin.h>
+#define LEXER_SSE2
+#endif
+
+// Character classes, indexed by unsigned char. Replaces the <ctype.h>
+// calls, which are locale-dependent and undefined for negative chars.
+enum {
+    CC_SPACE = 1 << 0,
+    CC_DIGIT = 1 << 1,
+    CC_IDENT_START = 1 << 2,   // letter or '_'
+    CC_IDENT = 1 << 3          // letter, digit or '_'
+};
+#define CC_LETTER (CC_IDENT_START | CC_IDENT)
+#define CC_NUMERAL (CC_DIGIT | CC_IDENT)
+
+static const unsigned char char_class[256] = {
+    [' '] = CC_SPACE, ['\t'] = CC_SPACE, ['\n'] = CC_SPACE, ['\v'] = CC_SPACE, ['\f'] = CC_SPACE, ['\r'] = CC_SPACE,
+    ['0'] = CC_NUMERAL, ['1'] = CC_NUMERAL, ['2'] = CC_NUMERAL, ['3'] = CC_NUMERAL, ['4'] = CC_NUMERAL, ['5'] = CC_NUMERAL, ['6'] = CC_NUMERAL, ['7'] = CC_NUMERAL, ['8'] = CC_NUMERAL, ['9'] = CC_NUMERAL,
+    ['a'] = CC_LETTER, ['b'] = CC_LETTER, ['c'] = CC_LETTER, ['d'] = CC_LETTER, ['e'] = CC_LETTER, ['f'] = CC_LETTER, ['g'] = CC_LETTER, ['h'] = CC_LETTER, ['i'] = CC_LETTER, ['j'] = CC_LETTER, ['k'] = CC_LETTER, ['l'] = CC_LETTER, ['m'] = CC_LETTER,
+    ['n'] = CC_LETTER, ['o'] = CC_LETTER, ['p'] = CC_LETTER, ['q'] = CC_LETTER, ['r'] = CC_LETTER, ['s'] = CC_LETTER, ['t'] = CC_LETTER, ['u'] = CC_LETTER, ['v'] = CC_LETTER, ['w'] = CC_LETTER, ['x'] = CC_LETTER, ['y'] = CC_LETTER, ['z'] = CC_LETTER,
+    ['A'] = CC_LETTER, ['B'] = CC_LETTER, ['C'] = CC_LETTER, ['D'] = CC_LETTER, ['E'] = CC_LETTER, ['F'] = CC_LETTER, ['G'] = CC_LETTER, ['H'] = CC_LETTER, ['I'] = CC_LETTER, ['J'] = CC_LETTER, ['K'] = CC_LETTER, ['L'] = CC_LETTER, ['M'] = CC_LETTER,
+    ['N'] = CC_LETTER, ['O'] = CC_LETTER, ['P'] = CC_LETTER, ['Q'] = CC_LETTER, ['R'] = CC_LETTER, ['S'] = CC_LETTER, ['T'] = CC_LETTER, ['U'] = CC_LETTER, ['V'] = CC_LETTER, ['W'] = CC_LETTER, ['X'] = CC_LETTER, ['Y'] = CC_LETTER, ['Z'] = CC_LETTER,
+    ['_'] = CC_LETTER,
+};
+
+static inline int char_is(char c, unsigned char classes) {
+    return (char_class[(unsigned char)c] & classes) != 0;
+}
 
 struct Lexer {
     const char* source;
     int pos;
     int len;
-    int line;
-    int column;
+    Arena* arena;   // Token strings come from here when set (not owned)
 };
 
 Lexer* lexer_create(const char* source) {
@@ -16,267 +44,456 @@ Lexer* lexer_create(const char* source) {
     lexer->source = source;
     lexer->pos = 0;
     lexer->len = strlen(source);
-    lexer->line = 1;
-    lexer->column = 1;
+    lexer->arena = NULL;
     return lexer;
 }
 
+void lexer_set_arena(Lexer* lexer, Arena* arena) {
+    lexer->arena = arena;
+}
+
 void lexer_destroy(Lexer* lexer) {
     free(lexer);
 }
 
+// --- Token List Management ---
+
+TokenList* create_token_list(void) {
+    TokenList* list = malloc(sizeof(TokenList));
+    list->capacity = 256;
+    list->count = 0;
+    list->items = malloc(sizeof(Token) * list->capacity);
+    list->arena = NULL;
+    return list;
+}
+
+void add_token_to_list(TokenList* list, Token token) {
+    if (list->count == list->capacity) {
+        list->capacity *= 2;
+        list->items = realloc(list->items, sizeof(Token) * list->capacity);
+    }
+    list->items[list->count++] = token;
+}
+
+void free_token_list(TokenList* list) {
+    if (!list) return;
+    // Arena-backed token strings are released with the arena itself
+    if (!list->arena) {
+        for (int i = 0; i < list->count; i++) {
+            free(list->items[i].value);
+        }
+    }
+    free(list->items);
+    free(list);
+}
+
 // Helper to create a token and copy its value
-static Token make_token(TokenType type, const char* value, int len, int line, int column) {
+static Token make_token(Lexer* lexer, TokenType type, const char* value, int len, int offset) {
     Token token;
     token.type = type;
-    token.value = malloc(len + 1);
-    strncpy(token.value, value, len);
-    token.value[len] = '\0';
-    token.line = line;
-    token.column = column;
+    if (lexer->arena) {
+        token.value = arena_strndup(lexer->arena, value, len);
+    } else {
+        token.value = malloc(len + 1);
+        strncpy(token.value, value, len);
+        token.value[len] = '\0';
+    }
+    token.offset = offset;
+    token.symbol = SYMBOL_NONE;
+    return token;
+}
+
+// Helper for tokens whose spelling is fixed (keywords, operators). With an
+// arena the token shares the static spelling instead of copying it; the
+// arena releases token values wholesale, so nothing ever frees it.
+static Token make_fixed_token(Lexer* lexer, TokenType type, const char* spelling, int offset) {
+    if (!lexer->arena) {
+        return make_token(lexer, type, spelling, strlen(spelling), offset);
+    }
+    Token token;
+    token.type = type;
+    token.value = (char*)spelling;
+    token.offset = offset;
+    token.symbol = SYMBOL_NONE;
     return token;
 }
 
 // Helper for single-char tokens
-static Token make_simple_token(TokenType type, Lexer* lexer) {
-    Token token = make_token(type, &lexer->source[lexer->pos], 1, lexer->line, lexer->column);
+static Token make_simple_token(TokenType type, const char* spelling, Lexer* lexer) {
+    Token token = make_fixed_token(lexer, type, spelling, lexer->pos);
+    lexer->pos++;
+    return token;
+}
+
+// Helper for two-char operators
+static Token make_pair_token(TokenType type, const char* spelling, Lexer* lexer) {
+    Token token = make_fixed_token(lexer, type, spelling, lexer->pos);
+    lexer->pos += 2;
+    return token;
+}
+
+// Helper for characters the lexer does not recognise
+static Token make_illegal_token(Lexer* lexer) {
+    Token token = make_token(lexer, TOKEN_ILLEGAL, &lexer->source[lexer->pos], 1, lexer->pos);
     lexer->pos++;
-    lexer->column++;
     return token;
 }
 
+// --- Whitespace and comment scanning ---
+// Generated sources are mostly indentation and comment blocks, so these
+// scanners look at 16 bytes per step with SSE2 where available and fall
+// back to a byte loop elsewhere and for the tail. Loads never go past len.
+
+// Number of newlines in source[from, to)
+static int count_newlines(const char* source, int from, int to) {
+    int count = 0;
+    int i = from;
+#ifdef LEXER_SSE2
+    const __m128i newline = _mm_set1_epi8('\n');
+    for (; i + 16 <= to; i += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)(source + i));
+        count += __builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline)));
+    }
+#endif
+    for (; i < to; i++) {
+        count += source[i] == '\n';
+    }
+    return count;
+}
+
+// First index at or after from that is not whitespace, or len
+static int find_non_space(const char* source, int from, int len) {
+    // Most runs are a single space or a short indent
+    int i = from;
+    int short_end = len - from < 16 ? len : from + 16;
+    while (i < short_end && char_is(source[i], CC_SPACE)) i++;
+    if (i < short_end) return i;
+#ifdef LEXER_SSE2
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i span = _mm_set1_epi8('\r' - '\t'); // \t \n \v \f \r are contiguous
+    for (; i + 16 <= len; i += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)(source + i));
+        __m128i offset = _mm_sub_epi8(chunk, tab);
+        __m128i is_control = _mm_cmpeq_epi8(_mm_min_epu8(offset, span), offset);
+        int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, space), is_control));
+        if (mask != 0xFFFF) {
+            return i + __builtin_ctz(~mask);
+        }
+    }
+#endif
+    while (i < len && char_is(source[i], CC_SPACE)) i++;
+    return i;
+}
+
+// Index of the next newline at or after from, or len
+static int find_newline(const char* source, int from, int len) {
+    int i = from;
+#ifdef LEXER_SSE2
+    const __m128i newline = _mm_set1_epi8('\n');
+    for (; i + 16 <= len; i += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)(source + i));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline));
+        if (mask) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+#endif
+    while (i < len && source[i] != '\n') i++;
+    return i;
+}
+
+// Index of the next "*/" at or after from, or -1
+static int find_comment_end(const char* source, int from, int len) {
+    int i = from;
+#ifdef LEXER_SSE2
+    const __m128i star = _mm_set1_epi8('*');
+    const __m128i slash = _mm_set1_epi8('/');
+    for (; i + 17 <= len; i += 16) {
+        __m128i here = _mm_loadu_si128((const __m128i*)(source + i));
+        __m128i next = _mm_loadu_si128((const __m128i*)(source + i + 1));
+        int mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(here, star), _mm_cmpeq_epi8(next, slash)));
+        if (mask) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+#endif
+    for (; i + 1 < len; i++) {
+        if (source[i] == '*' && source[i + 1] == '/') return i;
+    }
+    return -1;
+}
+
 static void skip_whitespace_and_comments(Lexer* lexer) {
+    const char* source = lexer->source;
     while (lexer->pos < lexer->len) {
         // Skip whitespace
-        if (isspace(lexer->source[lexer->pos])) {
-            if (lexer->source[lexer->pos] == '\n') {
-                lexer->line++;
-                lexer->column = 1;
-            } else {
-                lexer->column++;
-            }
-            lexer->pos++;
+        if (char_is(source[lexer->pos], CC_SPACE)) {
+            lexer->pos = find_non_space(source, lexer->pos, lexer->len);
             continue;
         }
-        
-        // Skip single-line comments
-        if (lexer->pos + 1 < lexer->len &&
-            lexer->source[lexer->pos] == '/' &&
-            lexer->source[lexer->pos + 1] == '/') {
-            lexer->pos += 2;
-            lexer->column += 2;
-            while (lexer->pos < lexer->len && lexer->source[lexer->pos] != '\n') {
-                lexer->pos++;
-                lexer->column++;
-            }
+
+        // Skip single-line comments (the newline is left for the next pass)
+        if (lexer->pos + 1 < lexer->len && source[lexer->pos] == '/' && source[lexer->pos + 1] == '/') {
+            lexer->pos = find_newline(source, lexer->pos + 2, lexer->len);
             continue;
         }
-        
-        // Skip multi-line comments
-        if (lexer->pos + 1 < lexer->len &&
-            lexer->source[lexer->pos] == '/' &&
-            lexer->source[lexer->pos + 1] == '*') {
-            lexer->pos += 2;
-            lexer->column += 2;
-            while (lexer->pos + 1 < lexer->len) {
-                if (lexer->source[lexer->pos] == '*' &&
-                    lexer->source[lexer->pos + 1] == '/') {
-                    lexer->pos += 2;
-                    lexer->column += 2;
-                    break;
-                }
-                if (lexer->source[lexer->pos] == '\n') {
-                    lexer->line++;
-                    lexer->column = 1;
-                } else {
-                    lexer->column++;
-                }
-                lexer->pos++;
+
+        // Skip multi-line comments. An unterminated one stops short of the
+        // last character, which is then lexed as a token.
+        if (lexer->pos + 1 < lexer->len && source[lexer->pos] == '/' && source[lexer->pos + 1] == '*') {
+            int end = find_comment_end(source, lexer->pos + 2, lexer->len);
+            if (end >= 0) {
+                end += 2;
+            } else {
+                end = lexer->len - 1 > lexer->pos + 2 ? lexer->len - 1 : lexer->pos + 2;
             }
+            lexer->pos = end;
             continue;
         }
-        
+
         // No more whitespace or comments
         break;
     }
 }
 
+typedef struct {
+    const char* spelling;
+    TokenType type;
+} Keyword;
+
+static const Keyword kw_if = { "if", TOKEN_IF };
+static const Keyword kw_int = { "int", TOKEN_INT }, kw_for = { "for", TOKEN_FOR };
+static const Keyword kw_bool = { "bool", TOKEN_BOOL }, kw_char = { "char", TOKEN_CHAR },
+    kw_void = { "void", TOKEN_VOID }, kw_true = { "true", TOKEN_TRUE },
+    kw_else = { "else", TOKEN_ELSE }, kw_case = { "case", TOKEN_CASE },
+    kw_goto = { "goto", TOKEN_GOTO };
+static const Keyword kw_false = { "false", TOKEN_FALSE }, kw_while = { "while", TOKEN_WHILE },
+    kw_break = { "break", TOKEN_BREAK };
+static const Keyword kw_return = { "return", TOKEN_RETURN }, kw_switch = { "switch", TOKEN_SWITCH };
+static const Keyword kw_bitint = { "_BitInt", TOKEN_BITINT }, kw_default = { "default", TOKEN_DEFAULT };
+static const Keyword kw_unsigned = { "unsigned", TOKEN_UNSIGNED }, kw_continue = { "continue", TOKEN_CONTINUE };
+
+// Keyword lookup on a source slice: dispatch on length, then on the first
+// character, leaving at most one memcmp per identifier.
+static const Keyword* match_keyword(const char* text, int len) {
+    const Keyword* candidate = NULL;
+    switch (len) {
+        case 2: candidate = text[0] == 'i' ? &kw_if : NULL; break;
+        case 3:
+            switch (text[0]) {
+                case 'i': candidate = &kw_int; break;
+                case 'f': candidate = &kw_for; break;
+            }
+            break;
+        case 4:
+            switch (text[0]) {
+                case 'b': candidate = &kw_bool; break;
+                case 'c': candidate = text[1] == 'h' ? &kw_char : &kw_case; break;
+                case 'v': candidate = &kw_void; break;
+                case 't': candidate = &kw_true; break;
+                case 'e': candidate = &kw_else; break;
+                case 'g': candidate = &kw_goto; break;
+            }
+            break;
+        case 5:
+            switch (text[0]) {
+                case 'f': candidate = &kw_false; break;
+                case 'w': candidate = &kw_while; break;
+                case 'b': candidate = &kw_break; break;
+            }
+            break;
+        case 6:
+            switch (text[0]) {
+                case 'r': candidate = &kw_return; break;
+                case 's': candidate = &kw_switch; break;
+            }
+            break;
+        case 7:
+            switch (text[0]) {
+                case '_': candidate = &kw_bitint; break;
+                case 'd': candidate = &kw_default; break;
+            }
+            break;
+        case 8:
+            switch (text[0]) {
+                case 'u': candidate = &kw_unsigned; break;
+                case 'c': candidate = &kw_continue; break;
+            }
+            break;
+    }
+    return candidate && memcmp(candidate->spelling, text, len) == 0 ? candidate : NULL;
+}
+
+// Keywords and identifiers are matched on the source slice; nothing is
+// copied except the first spelling of each identifier, by the intern table.
 static Token identifier_or_keyword(Lexer* lexer) {
     int start = lexer->pos;
-    int start_column = lexer->column;
-    while (lexer->pos < lexer->len && (isalnum(lexer->source[lexer->pos]) || lexer->source[lexer->pos] == '_')) {
+    while (lexer->pos < lexer->len && char_is(lexer->source[lexer->pos], CC_IDENT)) {
         lexer->pos++;
-        lexer->column++;
     }
     int len = lexer->pos - start;
-    char* value = (char*)malloc(len + 1);
-    strncpy(value, &lexer->source[start], len);
-    value[len] = '\0';
+    const char* text = &lexer->source[start];
 
     // Keyword check
-    if (strcmp(value, "int") == 0) { free(value); return make_token(TOKEN_INT, "int", 3, lexer->line, start_column); }
-    if (strcmp(value, "bool") == 0) { free(value); return make_token(TOKEN_BOOL, "bool", 4, lexer->line, start_column); }
-    if (strcmp(value, "char") == 0) { free(value); return make_token(TOKEN_CHAR, "char", 4, lexer->line, start_column); }
-    if (strcmp(value, "unsigned") == 0) { free(value); return make_token(TOKEN_UNSIGNED, "unsigned", 8, lexer->line, start_column); }
-    if (strcmp(value, "void") == 0) { free(value); return make_token(TOKEN_VOID, "void", 4, lexer->line, start_column); }
-    if (strcmp(value, "_BitInt") == 0) { free(value); return make_token(TOKEN_BITINT, "_BitInt", 7, lexer->line, start_column); }
-    if (strcmp(value, "true") == 0) { free(value); return make_token(TOKEN_TRUE, "true", 4, lexer->line, start_column); }
-    if (strcmp(value, "false") == 0) { free(value); return make_token(TOKEN_FALSE, "false", 5, lexer->line, start_column); }
-    if (strcmp(value, "if") == 0) { free(value); return make_token(TOKEN_IF, "if", 2, lexer->line, start_column); }
-    if (strcmp(value, "else") == 0) { free(value); return make_token(TOKEN_ELSE, "else", 4, lexer->line, start_column); }
-    if (strcmp(value, "while") == 0) { free(value); return make_token(TOKEN_WHILE, "while", 5, lexer->line, start_column); }
-    if (strcmp(value, "for") == 0) { free(value); return make_token(TOKEN_FOR, "for", 3, lexer->line, start_column); }
-    if (strcmp(value, "return") == 0) { free(value); return make_token(TOKEN_RETURN, "return", 6, lexer->line, start_column); }
-    if (strcmp(value, "break") == 0) { free(value); return make_token(TOKEN_BREAK, "break", 5, lexer->line, start_column); }
-    if (strcmp(value, "continue") == 0) { free(value); return make_token(TOKEN_CONTINUE, "continue", 8, lexer->line, start_column); }
-    if (strcmp(value, "switch") == 0) { free(value); return make_token(TOKEN_SWITCH, "switch", 6, lexer->line, start_column); }
-    if (strcmp(value, "case") == 0) { free(value); return make_token(TOKEN_CASE, "case", 4, lexer->line, start_column); }
-    if (strcmp(value, "default") == 0) { free(value); return make_token(TOKEN_DEFAULT, "default", 7, lexer->line, start_column); }
-    if (strcmp(value, "goto") == 0) { free(value); return make_token(TOKEN_GOTO, "goto", 4, lexer->line, start_column); }
-    
-    Token token = make_token(TOKEN_IDENTIFIER, value, strlen(value), lexer->line, start_column);
-    free(value);  // Free the temporary value since make_token makes its own copy
+    const Keyword* keyword = match_keyword(text, len);
+    if (keyword) {
+        return make_fixed_token(lexer, keyword->type, keyword->spelling, start);
+    }
+
+    // With an arena the value is the interned spelling, valid until
+    // free_symbol_table()
+    SymbolId symbol = intern_symbol_n(text, len);
+    Token token = make_fixed_token(lexer, TOKEN_IDENTIFIER, symbol_name(symbol), start);
+    token.symbol = symbol;
     return token;
 }
 
 static Token number(Lexer* lexer) {
     int start = lexer->pos;
-    int start_column = lexer->column;
-    while (lexer->pos < lexer->len && isdigit(lexer->source[lexer->pos])) {
+    while (lexer->pos < lexer->len && char_is(lexer->source[lexer->pos], CC_DIGIT)) {
         lexer->pos++;
-        lexer->column++;
     }
-    return make_token(TOKEN_NUMBER, &lexer->source[start], lexer->pos - start, lexer->line, start_column);
+    return make_token(lexer, TOKEN_NUMBER, &lexer->source[start], lexer->pos - start, start);
 }
 
 static Token string_literal(Lexer* lexer) {
     int start = lexer->pos;
-    int start_column = lexer->column;
     lexer->pos++; // Skip opening quote
-    lexer->column++;
     
     while (lexer->pos < lexer->len && lexer->source[lexer->pos] != '"') {
-        if (lexer->source[lexer->pos] == '\n') {
-            lexer->line++;
-            lexer->column = 1;
-        } else {
-            lexer->column++;
-        }
         lexer->pos++;
     }
     
     if (lexer->pos >= lexer->len) {
         // Unterminated string
-        return make_token(TOKEN_ILLEGAL, &lexer->source[start], lexer->pos - start, lexer->line, start_column);
+        return make_token(lexer, TOKEN_ILLEGAL, &lexer->source[start], lexer->pos - start, start);
     }
     
     lexer->pos++; // Skip closing quote
-    lexer->column++;
     
     // Return string without quotes
-    return make_token(TOKEN_STRING, &lexer->source[start + 1], lexer->pos - start - 2, lexer->line, start_column);
+    return make_token(lexer, TOKEN_STRING, &lexer->source[start + 1], lexer->pos - start - 2, start);
 }
 
 static Token handle_include_directive(Lexer* lexer) {
-    int start_column = lexer->column;
+    int start = lexer->pos;
     lexer->pos++; // Skip '#'
-    lexer->column++;
     
     // Skip whitespace after #
     while (lexer->pos < lexer->len && (lexer->source[lexer->pos] == ' ' || lexer->source[lexer->pos] == '\t')) {
         lexer->pos++;
-        lexer->column++;
     }
     
     // Check if it's "include"
     if (lexer->pos + 7 <= lexer->len && strncmp(&lexer->source[lexer->pos], "include", 7) == 0) {
         lexer->pos += 7;
-        lexer->column += 7;
-        return make_token(TOKEN_INCLUDE, "#include", 8, lexer->line, start_column);
+        return make_fixed_token(lexer, TOKEN_INCLUDE, "#include", start);
     }
     
+    // "#precompiled KEY", spliced in by the preprocessor for a precompiled header
+    if (lexer->pos + 11 <= lexer->len && strncmp(&lexer->source[lexer->pos], "precompiled", 11) == 0) {
+        lexer->pos += 11;
+        while (lexer->pos < lexer->len && (lexer->source[lexer->pos] == ' ' || lexer->source[lexer->pos] == '\t')) {
+            lexer->pos++;
+        }
+        int key_start = lexer->pos;
+        while (lexer->pos < lexer->len && char_is(lexer->source[lexer->pos], CC_IDENT)) {
+            lexer->pos++;
+        }
+        return make_token(lexer, TOKEN_PRECOMPILED, &lexer->source[key_start], lexer->pos - key_start, start);
+    }
+
     // Not an include directive, treat as illegal
-    return make_simple_token(TOKEN_ILLEGAL, lexer);
+    return make_illegal_token(lexer);
 }
 
 Token lexer_next_token(Lexer* lexer) {
     skip_whitespace_and_comments(lexer);
 
-    if (lexer->pos >= lexer->len) return make_token(TOKEN_EOF, "", 0, lexer->line, lexer->column);
+    if (lexer->pos >= lexer->len) return make_fixed_token(lexer, TOKEN_EOF, "", lexer->pos);
 
     char current = lexer->source[lexer->pos];
     char peek = (lexer->pos + 1 < lexer->len) ? lexer->source[lexer->pos + 1] : '\0';
 
     if (current == '#') return handle_include_directive(lexer);
     if (current == '"') return string_literal(lexer);
-    if (isalpha(current) || current == '_') return identifier_or_keyword(lexer);
-    if (isdigit(current)) return number(lexer);
+    if (char_is(current, CC_IDENT_START)) return identifier_or_keyword(lexer);
+    if (char_is(current, CC_DIGIT)) return number(lexer);
 
     switch (current) {
-        case '+': return make_simple_token(TOKEN_PLUS, lexer);
-        case '-': return make_simple_token(TOKEN_MINUS, lexer);
-        case '*': return make_simple_token(TOKEN_STAR, lexer);
-        case '/': return make_simple_token(TOKEN_SLASH, lexer);
-        case '(': return make_simple_token(TOKEN_LPAREN, lexer);
-        case ')': return make_simple_token(TOKEN_RPAREN, lexer);
-        case '{': return make_simple_token(TOKEN_LBRACE, lexer);
-        case '}': return make_simple_token(TOKEN_RBRACE, lexer);
-        case '[': return make_simple_token(TOKEN_LBRACKET, lexer);
-        case ']': return make_simple_token(TOKEN_RBRACKET, lexer);
-        case ';': return make_simple_token(TOKEN_SEMICOLON, lexer);
-        case ':': return make_simple_token(TOKEN_COLON, lexer);
-        case ',': return make_simple_token(TOKEN_COMMA, lexer);
+        case '+': return make_simple_token(TOKEN_PLUS, "+", lexer);
+        case '-': return make_simple_token(TOKEN_MINUS, "-", lexer);
+        case '*': return make_simple_token(TOKEN_STAR, "*", lexer);
+        case '/': return make_simple_token(TOKEN_SLASH, "/", lexer);
+        case '(': return make_simple_token(TOKEN_LPAREN, "(", lexer);
+        case ')': return make_simple_token(TOKEN_RPAREN, ")", lexer);
+        case '{': return make_simple_token(TOKEN_LBRACE, "{", lexer);
+        case '}': return make_simple_token(TOKEN_RBRACE, "}", lexer);
+        case '[': return make_simple_token(TOKEN_LBRACKET, "[", lexer);
+        case ']': return make_simple_token(TOKEN_RBRACKET, "]", lexer);
+        case ';': return make_simple_token(TOKEN_SEMICOLON, ";", lexer);
+        case ':': return make_simple_token(TOKEN_COLON, ":", lexer);
+        case ',': return make_simple_token(TOKEN_COMMA, ",", lexer);
         case '=':
             if (peek == '=') {
-                int col = lexer->column;
-                lexer->pos += 2;
-                lexer->column += 2;
-                return make_token(TOKEN_EQUAL, "==", 2, lexer->line, col);
+                return make_pair_token(TOKEN_EQUAL, "==", lexer);
             }
-            return make_simple_token(TOKEN_ASSIGN, lexer);
+            return make_simple_token(TOKEN_ASSIGN, "=", lexer);
         case '!':
             if (peek == '=') {
-                int col = lexer->column;
-                lexer->pos += 2;
-                lexer->column += 2;
-                return make_token(TOKEN_NOT_EQUAL, "!=", 2, lexer->line, col);
+                return make_pair_token(TOKEN_NOT_EQUAL, "!=", lexer);
             }
-            return make_simple_token(TOKEN_NOT, lexer);
+            return make_simple_token(TOKEN_NOT, "!", lexer);
         case '&':
             if (peek == '&') {
-                int col = lexer->column;
-                lexer->pos += 2;
-                lexer->column += 2;
-                return make_token(TOKEN_LOGICAL_AND, "&&", 2, lexer->line, col);
+                return make_pair_token(TOKEN_LOGICAL_AND, "&&", lexer);
             }
-            return make_simple_token(TOKEN_AND, lexer);
+            return make_simple_token(TOKEN_AND, "&", lexer);
         case '|':
             if (peek == '|') {
-                int col = lexer->column;
-                lexer->pos += 2;
-                lexer->column += 2;
-                return make_token(TOKEN_LOGICAL_OR, "||", 2, lexer->line, col);
+                return make_pair_token(TOKEN_LOGICAL_OR, "||", lexer);
             }
-            return make_simple_token(TOKEN_OR, lexer);
+            return make_simple_token(TOKEN_OR, "|", lexer);
         case '<':
             if (peek == '=') {
-                int col = lexer->column;
-                lexer->pos += 2;
-                lexer->column += 2;
-                return make_token(TOKEN_LESS_EQUAL, "<=", 2, lexer->line, col);
+                return make_pair_token(TOKEN_LESS_EQUAL, "<=", lexer);
             }
-            return make_simple_token(TOKEN_LESS, lexer);
+            return make_simple_token(TOKEN_LESS, "<", lexer);
         case '>':
             if (peek == '=') {
-                int col = lexer->column;
-                lexer->pos += 2;
-                lexer->column += 2;
-                return make_token(TOKEN_GREATER_EQUAL, ">=", 2, lexer->line, col);
+                return make_pair_token(TOKEN_GREATER_EQUAL, ">=", lexer);
             }
-            return make_simple_token(TOKEN_GREATER, lexer);
+            return make_simple_token(TOKEN_GREATER, ">", lexer);
     }
     
-    return make_simple_token(TOKEN_ILLEGAL, lexer);
+    return make_illegal_token(lexer);
+}
+
+// Lex the whole source into a growable list (token strings drawn from
+// arena when non-NULL). There is no token limit; the
+// list doubles as needed so large generated controllers are never truncated.
+TokenList* lexer_tokenize(const char* source, Arena* arena) {
+    Lexer* lexer = lexer_create(source);
+    lexer_set_arena(lexer, arena);
+    TokenList* list = create_token_list();
+    list->arena = arena;
+    Token token;
+    do {
+        token = lexer_next_token(lexer);
+        add_token_to_list(list, token);
+    } while (token.type != TOKEN_EOF);
+    lexer_destroy(lexer);
+    return list;
+}
+
+// Tokens keep only their offset; the line is counted when a diagnostic
+// asks for it, which is rare enough not to track it for every token
+void token_position(const char* source, const Token* token, int* line, int* column) {
+    int line_start = token->offset;
+    while (line_start > 0 && source[line_start - 1] != '\n') line_start--;
+    *line = count_newlines(source, 0, line_start) + 1;
+    *column = token->offset - line_start + 1;
 }
 
 // For printing/debugging
@@ -287,6 +504,7 @@ const char* token_type_to_string(TokenType type) {
         case TOKEN_WHILE: return "WHILE"; case TOKEN_FOR: return "FOR"; case TOKEN_RETURN: return "RETURN"; case TOKEN_BREAK: return "BREAK"; case TOKEN_CONTINUE: return "CONTINUE"; case TOKEN_GOTO: return "GOTO";
         case TOKEN_SWITCH: return "SWITCH"; case TOKEN_CASE: return "CASE"; case TOKEN_DEFAULT: return "DEFAULT";
         case TOKEN_INCLUDE: return "INCLUDE";
+        case TOKEN_PRECOMPILED: return "PRECOMPILED";
         case TOKEN_IDENTIFIER: return "IDENTIFIER"; case TOKEN_NUMBER: return "NUMBER"; case TOKEN_STRING: return "STRING";
         case TOKEN_PLUS: return "PLUS"; case TOKEN_MINUS: return "MINUS"; case TOKEN_STAR: return "STAR";
         case TOKEN_SLASH: return "SLASH"; case TOKEN_ASSIGN: return "ASSIGN"; case TOKEN_EQUAL: return "EQUAL";
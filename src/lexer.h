@@ -2,6 +2,8 @@
 #define LEXER_H
 
 #include <stdio.h>
+#include "arena.h"
+#include "intern.h"
 
 typedef enum {
     // Keywords
@@ -11,6 +13,7 @@ typedef enum {
     TOKEN_SWITCH, TOKEN_CASE, TOKEN_DEFAULT,
     // Preprocessor directives
     TOKEN_INCLUDE,
+    TOKEN_PRECOMPILED,  // Value is the hex key of a loaded precompiled header
     // Identifiers and Literals
     TOKEN_IDENTIFIER, TOKEN_NUMBER, TOKEN_STRING,
     // Operators
@@ -27,17 +30,43 @@ typedef enum {
 
 typedef struct {
     TokenType type;
+    int offset;  // Byte offset of its first character in the lexed source
     char* value; // Malloc'd string
-    int line;    // Line number where token appears
-    int column;  // Column number where token starts
+    SymbolId symbol; // Interned id for identifiers, SYMBOL_NONE otherwise
 } Token;
 
+// Growable token buffer; the parser needs random access for lookahead
+typedef struct {
+    Token* items;
+    int count;
+    int capacity;
+    Arena* arena;   // Non-NULL if token values live in an arena
+} TokenList;
+
 // Opaque struct for the lexer state
 typedef struct Lexer Lexer;
 
 Lexer* lexer_create(const char* source);
 Token lexer_next_token(Lexer* lexer);
 void lexer_destroy(Lexer* lexer);
+void lexer_set_arena(Lexer* lexer, Arena* arena); // Draw token strings from arena
+
+// Token list management
+TokenList* create_token_list(void);
+void add_token_to_list(TokenList* list, Token token);
+void free_token_list(TokenList* list);
+
+// Lex an entire source buffer (up to and including TOKEN_EOF).
+// arena may be NULL, in which case token values are individually malloc'd.
+// With an arena only numbers and strings are copied into it: keywords and
+// operators share static spellings and identifiers share their interned
+// spelling, so token values must not be modified and the symbol table must
+// outlive the tokens.
+TokenList* lexer_tokenize(const char* source, Arena* arena);
 const char* token_type_to_string(TokenType type); // Helper for printing
 
+// 1-based line and column of a token in the source it was lexed from.
+// Scans the source up to the token, so it is meant for diagnostics.
+void token_position(const char* source, const Token* token, int* line, int* column);
+
 #endif // LEXER_H
@@ -0,0 +1,183 @@
+#include "logic_minimizer.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// An implicant over the support: the minterms that match value outside the
+// don't-care bits in dc. Each round of merging adds one don't-care bit, so
+// (dc, value) also names it uniquely across rounds.
+typedef struct {
+    uint32_t dc;
+    uint32_t value;
+} Implicant;
+
+static bool implicant_covers(Implicant implicant, uint32_t minterm) {
+    return (minterm & ~implicant.dc) == implicant.value;
+}
+
+static void* checked_calloc(size_t count, size_t size) {
+    void* p = calloc(count ? count : 1, size);
+    if (!p) {
+        fprintf(stderr, "Error: Failed to allocate logic minimization tables.\n");
+        exit(EXIT_FAILURE);
+    }
+    return p;
+}
+
+// The inputs lut depends on, in input order; -1 when there are more than
+// LOGIC_MAX_SUPPORT of them
+static int lut_support(const uint8_t* lut, int input_count, int* support) {
+    int count = 0;
+    uint32_t entries = 1u << input_count;
+    for (int b = 0; b < input_count; b++) {
+        uint32_t bit = 1u << b;
+        for (uint32_t i = 0; i < entries; i++) {
+            if (!(i & bit) && (lut[i] != 0) != (lut[i | bit] != 0)) {
+                if (count == LOGIC_MAX_SUPPORT) return -1;
+                support[count++] = b;
+                break;
+            }
+        }
+    }
+    return count;
+}
+
+// Takes prime p into the cover; false when that would exceed max_terms
+static bool take_prime(const Implicant* primes, int p, const uint32_t* minterms, int minterm_count,
+                       bool* covered, bool* taken, Implicant* cover, int* cover_count, int max_terms) {
+    if (taken[p]) return true;
+    if (*cover_count == max_terms) return false;
+    taken[p] = true;
+    cover[(*cover_count)++] = primes[p];
+    for (int m = 0; m < minterm_count; m++) {
+        if (implicant_covers(primes[p], minterms[m])) covered[m] = true;
+    }
+    return true;
+}
+
+int minimize_lut(const uint8_t* lut, int input_count, int max_terms, ProductTerm* terms) {
+    int support[LOGIC_MAX_SUPPORT];
+    int k = lut_support(lut, input_count, support);
+    if (k < 0) return -1;
+
+    // The on-set over the support; the other inputs are 0 in the entry read
+    int size = 1 << k;
+    uint32_t* minterms = checked_calloc(size, sizeof(uint32_t));
+    int minterm_count = 0;
+    for (int j = 0; j < size; j++) {
+        uint32_t entry = 0;
+        for (int t = 0; t < k; t++) {
+            if (j & (1 << t)) entry |= 1u << support[t];
+        }
+        if (lut[entry]) minterms[minterm_count++] = j;
+    }
+    if (minterm_count == 0 || minterm_count == size) {
+        free(minterms);
+        if (minterm_count == 0) return 0;
+        if (max_terms < 1) return -1;
+        terms[0].care = 0;
+        terms[0].value = 0;
+        return 1;
+    }
+
+    // Quine-McCluskey: merge implicants one don't-care bit at a time. A
+    // k-input function has at most 3^k implicants in all.
+    int limit = 1;
+    for (int t = 0; t < k; t++) limit *= 3;
+    uint8_t* present = checked_calloc((size_t)1 << (2 * k), 1);  // Keyed (dc << k) | value
+    uint8_t* merged = checked_calloc((size_t)1 << (2 * k), 1);
+    Implicant* current = checked_calloc(limit, sizeof(Implicant));
+    Implicant* next = checked_calloc(limit, sizeof(Implicant));
+    Implicant* primes = checked_calloc(limit, sizeof(Implicant));
+    int current_count = 0, prime_count = 0;
+    for (int m = 0; m < minterm_count; m++) {
+        current[current_count++] = (Implicant){0, minterms[m]};
+        present[minterms[m]] = 1;
+    }
+    uint32_t full = (uint32_t)size - 1;
+    while (current_count > 0) {
+        int next_count = 0;
+        for (int i = 0; i < current_count; i++) {
+            Implicant a = current[i];
+            for (uint32_t bits = full & ~a.dc & ~a.value; bits; bits &= bits - 1) {
+                uint32_t bit = bits & -bits;
+                uint32_t partner = (a.dc << k) | a.value | bit;
+                if (!present[partner]) continue;
+                merged[(a.dc << k) | a.value] = 1;
+                merged[partner] = 1;
+                uint32_t key = ((a.dc | bit) << k) | a.value;
+                if (!present[key]) {
+                    present[key] = 1;
+                    next[next_count++] = (Implicant){a.dc | bit, a.value};
+                }
+            }
+        }
+        for (int i = 0; i < current_count; i++) {
+            if (!merged[(current[i].dc << k) | current[i].value]) {
+                primes[prime_count++] = current[i];
+            }
+        }
+        Implicant* swap = current;
+        current = next;
+        next = swap;
+        current_count = next_count;
+    }
+
+    // Cover the on-set: essential primes first, then the prime covering
+    // the most minterms still uncovered, until none are
+    bool* covered = checked_calloc(minterm_count, sizeof(bool));
+    bool* taken = checked_calloc(prime_count, sizeof(bool));
+    Implicant* cover = checked_calloc(max_terms, sizeof(Implicant));
+    int cover_count = 0;
+    bool fits = true;
+    for (int m = 0; m < minterm_count && fits; m++) {
+        int only = -1, count = 0;
+        for (int p = 0; p < prime_count && count < 2; p++) {
+            if (implicant_covers(primes[p], minterms[m])) {
+                only = p;
+                count++;
+            }
+        }
+        if (count == 1) {
+            fits = take_prime(primes, only, minterms, minterm_count, covered, taken, cover, &cover_count, max_terms);
+        }
+    }
+    while (fits) {
+        int best = -1, best_gain = 0;
+        for (int p = 0; p < prime_count; p++) {
+            if (taken[p]) continue;
+            int gain = 0;
+            for (int m = 0; m < minterm_count; m++) {
+                if (!covered[m] && implicant_covers(primes[p], minterms[m])) gain++;
+            }
+            if (gain > best_gain) {
+                best = p;
+                best_gain = gain;
+            }
+        }
+        if (best < 0) break;
+        fits = take_prime(primes, best, minterms, minterm_count, covered, taken, cover, &cover_count, max_terms);
+    }
+
+    // Back from support positions to input numbers
+    for (int c = 0; fits && c < cover_count; c++) {
+        terms[c].care = 0;
+        terms[c].value = 0;
+        for (int t = 0; t < k; t++) {
+            if (cover[c].dc & (1u << t)) continue;
+            terms[c].care |= 1u << support[t];
+            if (cover[c].value & (1u << t)) terms[c].value |= 1u << support[t];
+        }
+    }
+
+    free(minterms);
+    free(present);
+    free(merged);
+    free(current);
+    free(next);
+    free(primes);
+    free(covered);
+    free(taken);
+    free(cover);
+    return fits ? cover_count : -1;
+}
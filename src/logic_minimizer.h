@@ -0,0 +1,31 @@
+#ifndef LOGIC_MINIMIZER_H
+#define LOGIC_MINIMIZER_H
+
+#include <stdint.h>
+
+// Two-level (sum of products) minimization of condition truth tables, for
+// conditions decided by combinational logic instead of the vardata ROM
+// (--varsel-logic). Quine-McCluskey over the inputs the table depends on:
+// every prime implicant is generated, the essential ones are taken, and the
+// rest of the on-set is covered greedily, largest prime first.
+
+// Widest support minimize_lut works over; tables that depend on more inputs
+// stay in the ROM
+#define LOGIC_MAX_SUPPORT 8
+
+// A product of inputs: input b is in it when bit b of care is set, true
+// when bit b of value is, complemented otherwise
+typedef struct {
+    uint32_t care;
+    uint32_t value;
+} ProductTerm;
+
+// Writes to terms a sum of at most max_terms products equal to the function
+// whose truth table over input_count inputs is lut (entry i is the value
+// with input b at bit b of i). Returns the number written, or -1 when the
+// function depends on more than LOGIC_MAX_SUPPORT inputs or its cover needs
+// more products. Constant false is 0 products, constant true one with no
+// inputs in it.
+int minimize_lut(const uint8_t* lut, int input_count, int max_terms, ProductTerm* terms);
+
+#endif // LOGIC_MINIMIZER_H
@@ -5,18 +5,28 @@
 #include "lexer.h"
 #include "parser.h"
 #include "ast.h"
+#include "ast_fold.h"
 #include "cfg.h"
 #include "cfg_builder.h"
 #include "cfg_utils.h"
+#include "cfg_simplify.h"
 #include "hw_analyzer.h"
 #include "cfg_to_microcode.h"
 #include "ast_to_microcode.h"
+#include "wcet.h"
+#include "partition.h"
+#include "profile_use.h"
+#include "mem_patch.h"
 #include "ssa_optimizer.h"
 #include "verilog_generator.h"
 #include "preprocessor.h"
+#include "pass_stats.h"
+#include "compile_cache.h"
+#include "compile_server.h"
+#include "precompiled_header.h"
+#include "translation_unit.h"
 
 // Global configuration flags
-int debug_mode = 0;
 static bool user_set_switch_bits = false; // Track if user explicitly set switch-bits
 // switch_offset_bits is defined in cfg_to_microcode.c
 
@@ -69,9 +79,91 @@ char* generate_dot_filename(const char* source_filename) {
     return dot_filename;
 }
 
+// --partition: one listing and set of output files (<base>_p<i>_*) per core
+static void compile_partitioned_cores(Partitioning* partitioning, HardwareContext* hw_ctx,
+                                      const char* input_filename, bool quiet) {
+    printf("Partitioned into %d cores; state owners:", partitioning->count);
+    for (int s = 0; s < hw_ctx->state_count; s++) {
+        printf(" %s->p%d", hw_ctx->states[s].name, partitioning->state_owner[hw_ctx->states[s].state_number]);
+    }
+    printf("\n");
+
+    for (int core = 0; core < partitioning->count; core++) {
+        printf("\n--- Core %d of %d ---\n", core, partitioning->count);
+        pass_begin("ast_to_compact_microcode");
+        CompactMicrocode* compact_mc = ast_to_compact_microcode(partitioning->programs[core], hw_ctx);
+        pass_end();
+        if (!compact_mc) {
+            printf("Error: Failed to generate compact microcode for core %d\n", core);
+            continue;
+        }
+        if (!quiet) {
+            print_compact_microcode_table(compact_mc, stdout);
+            print_compact_microcode_analysis(compact_mc, stdout);
+            if (report_microcode_encoding) {
+                print_microcode_encoding_analysis(compact_mc, stdout);
+            }
+            if (report_dispatch_costs) {
+                print_dispatch_cost_analysis(compact_mc, stdout);
+            }
+            if (report_wcet) {
+                print_wcet_analysis(compact_mc, stdout);
+            }
+        }
+        if (input_filename) {
+            char* core_filename = partition_core_filename(input_filename, core);
+            pass_begin("generate_output_files");
+            generate_all_output_files(compact_mc, core_filename);
+            pass_end();
+            free(core_filename);
+        } else {
+            fprintf(stderr, "Warning: Cannot generate .mem files without an input filename.\n");
+        }
+        free_compact_microcode(compact_mc);
+    }
+}
+
+// --partition with --verilog: module <base>_p<i> for each core, in
+// <base>_p<i>_template.v; <base>_template.v then instantiates them
+static void generate_partitioned_verilog(Partitioning* partitioning, HardwareContext* hw_ctx,
+                                         const char* source_filename) {
+    for (int core = 0; core < partitioning->count; core++) {
+        Node* program = partitioning->programs[core];
+        CFG* cfg = build_cfg_from_ast(program);
+        if (!cfg) {
+            printf("Error: Failed to build CFG for core %d\n", core);
+            continue;
+        }
+        simplify_cfg(cfg);
+        if (rotate_loops) {
+            rotate_cfg_loops(cfg);
+        }
+        if (layout_blocks) {
+            place_cfg_blocks(cfg);
+        }
+        HotstateMicrocode* microcode = cfg_to_hotstate_microcode(cfg, hw_ctx);
+        if (microcode) {
+            VerilogGenOptions options = {
+                .generate_module = true,
+                .stack_depth = calculate_required_stack_depth(program, NULL)
+            };
+            char* core_filename = partition_core_filename(source_filename, core);
+            generate_verilog_hdl(microcode, core_filename, &options);
+            free(core_filename);
+            free_hotstate_microcode(microcode);
+        } else {
+            printf("Error: Failed to generate microcode for core %d\n", core);
+        }
+        free_cfg(cfg);
+    }
+}
+
 int main(int argc, char* argv[]) {
     char* source_code = NULL;
     char* input_filename = NULL;
+    char* input_files[argc];        // Several make a multi-file program
+    int input_count = 0;
+    int jobs = 0;                   // --jobs: workers compiling its units, 0 for one per CPU
     bool generate_dot = false;
     bool analyze_hardware = false;
     bool generate_microcode = false;
@@ -79,6 +171,14 @@ int main(int argc, char* argv[]) {
     bool generate_testbench = false;
     bool generate_all_hdl = false;
     bool optimize_ssa = false;
+    bool time_passes = false;
+    bool mem_stats = false;
+    bool stats_json = false;
+    bool quiet = false;             // No AST dump or microcode listing
+    bool serve = false;             // --serve: compile files named on stdin
+    bool watch = false;             // --watch: recompile input_filename on change
+    bool precompile = false;        // --precompile-header: write input_filename's .hpch
+    const char* profile_use_file = NULL;  // --profile-use: hotstate_sim --profile counts
     // Microcode generation modes
     typedef enum {
         MICROCODE_NONE,        // No microcode generation
@@ -103,6 +203,99 @@ int main(int argc, char* argv[]) {
         } else if (strcmp(argv[i], "--microcode-ssa") == 0) {
             generate_microcode = true;
             microcode_mode = MICROCODE_SSA;
+        } else if (strcmp(argv[i], "--bdd") == 0) {
+            use_bdd_conditions = 1;
+        } else if (strcmp(argv[i], "--compact-words") == 0) {
+            compact_microcode_words = 1;
+        } else if (strcmp(argv[i], "--pipeline") == 0) {
+            pipeline_delay_slots = 1;
+        } else if (strcmp(argv[i], "--inline-words") == 0) {
+            if (i + 1 < argc) {
+                inline_call_words = atoi(argv[++i]);
+                if (inline_call_words < 1) {
+                    fprintf(stderr, "Error: inline-words must be at least 1\n");
+                    return 1;
+                }
+            } else {
+                fprintf(stderr, "Error: --inline-words requires a value\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--fuse-conditions") == 0) {
+            fuse_conditions = 1;
+        } else if (strcmp(argv[i], "--merge-tails") == 0) {
+            merge_common_tails = MERGE_TAILS_SPEED;
+        } else if (strcmp(argv[i], "--merge-tails-size") == 0) {
+            merge_common_tails = MERGE_TAILS_SIZE;
+        } else if (strcmp(argv[i], "--rotate-loops") == 0) {
+            rotate_loops = 1;
+        } else if (strcmp(argv[i], "--layout-blocks") == 0) {
+            layout_blocks = 1;
+        } else if (strcmp(argv[i], "--profile-use") == 0) {
+            if (i + 1 < argc) {
+                profile_use_file = argv[++i];
+            } else {
+                fprintf(stderr, "Error: --profile-use requires a profile\n");
+                return 1;
+            }
+        } else if (strncmp(argv[i], "--profile-use=", 14) == 0) {
+            profile_use_file = argv[i] + 14;
+        } else if (strcmp(argv[i], "--narrow-fields") == 0) {
+            narrow_microcode_fields = 1;
+        } else if (strcmp(argv[i], "--encoding-report") == 0) {
+            report_microcode_encoding = 1;
+        } else if (strcmp(argv[i], "--dispatch-report") == 0) {
+            report_dispatch_costs = 1;
+        } else if (strcmp(argv[i], "--wcet") == 0) {
+            report_wcet = 1;
+        } else if (strcmp(argv[i], "--loop-bound") == 0) {
+            if (i + 1 < argc) {
+                wcet_loop_bound = atoi(argv[++i]);
+                if (wcet_loop_bound < 1) {
+                    fprintf(stderr, "Error: loop-bound must be at least 1\n");
+                    return 1;
+                }
+            } else {
+                fprintf(stderr, "Error: --loop-bound requires a value\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--partition") == 0) {
+            partition_into_cores = 1;
+        } else if (strcmp(argv[i], "--vardata-bits") == 0) {
+            if (i + 1 < argc) {
+                vardata_word_bits = atoi(argv[++i]);
+                if (vardata_word_bits < 1 || vardata_word_bits > 32 ||
+                    (vardata_word_bits & (vardata_word_bits - 1)) != 0) {
+                    fprintf(stderr, "Error: vardata-bits must be a power of two between 1 and 32\n");
+                    return 1;
+                }
+            } else {
+                fprintf(stderr, "Error: --vardata-bits requires a value\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--vardata-sparse") == 0) {
+            sparse_vardata = 1;
+        } else if (strcmp(argv[i], "--varsel-logic") == 0) {
+            use_varsel_logic = 1;
+        } else if (strcmp(argv[i], "--prune-inputs") == 0) {
+            prune_unused_inputs = 1;
+        } else if (strcmp(argv[i], "--fold-constants") == 0) {
+            fold_constants = 1;
+        } else if (strcmp(argv[i], "--diff-against") == 0) {
+            if (i + 1 < argc) {
+                diff_against_base = argv[++i];
+            } else {
+                fprintf(stderr, "Error: --diff-against requires a base path\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--stable-layout") == 0) {
+            stable_layout = 1;
+        } else if (strcmp(argv[i], "--cache-dir") == 0) {
+            if (i + 1 < argc) {
+                compile_cache_dir = argv[++i];
+            } else {
+                fprintf(stderr, "Error: --cache-dir requires a directory\n");
+                return 1;
+            }
         } else if (strcmp(argv[i], "--opt") == 0) {
             optimize_ssa = true;
         } else if (strcmp(argv[i], "--switch-bits") == 0) {
@@ -128,9 +321,77 @@ int main(int argc, char* argv[]) {
             generate_testbench = true;
         } else if (strcmp(argv[i], "--all-hdl") == 0) {
             generate_all_hdl = true;
+        } else if (strcmp(argv[i], "--mem-style") == 0) {
+            if (i + 1 < argc) {
+                if (!parse_mem_style(argv[++i], &verilog_mem_style)) {
+                    fprintf(stderr, "Error: mem-style must be auto, distributed, block or registers\n");
+                    return 1;
+                }
+            } else {
+                fprintf(stderr, "Error: --mem-style requires a value\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--sim-fast") == 0) {
+            verilog_sim_harness.fast = true;
+        } else if (strcmp(argv[i], "--sim-threads") == 0) {
+            if (i + 1 < argc) {
+                verilog_sim_harness.threads = atoi(argv[++i]);
+                if (verilog_sim_harness.threads < 1) {
+                    fprintf(stderr, "Error: sim-threads must be at least 1\n");
+                    return 1;
+                }
+            } else {
+                fprintf(stderr, "Error: --sim-threads requires a value\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--trace-window") == 0) {
+            if (i + 1 < argc) {
+                if (!parse_trace_window(argv[++i], &verilog_sim_harness)) {
+                    fprintf(stderr, "Error: trace-window must be START:END with END after START, or START:\n");
+                    return 1;
+                }
+            } else {
+                fprintf(stderr, "Error: --trace-window requires a value\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--trace-when") == 0) {
+            if (i + 1 < argc) {
+                verilog_sim_harness.trace_when = argv[++i];
+            } else {
+                fprintf(stderr, "Error: --trace-when requires an output name\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--time-passes") == 0) {
+            time_passes = true;
+        } else if (strcmp(argv[i], "--mem-stats") == 0) {
+            mem_stats = true;
+        } else if (strcmp(argv[i], "--stats-json") == 0) {
+            stats_json = true;
+        } else if (strcmp(argv[i], "--quiet") == 0) {
+            quiet = true;
+        } else if (strcmp(argv[i], "--serve") == 0) {
+            serve = true;
+        } else if (strcmp(argv[i], "--watch") == 0) {
+            watch = true;
+        } else if (strcmp(argv[i], "--precompile-header") == 0) {
+            precompile = true;
+        } else if (strcmp(argv[i], "--jobs") == 0) {
+            if (i + 1 < argc) {
+                jobs = atoi(argv[++i]);
+                if (jobs < 1) {
+                    fprintf(stderr, "Error: jobs must be at least 1\n");
+                    return 1;
+                }
+            } else {
+                fprintf(stderr, "Error: --jobs requires a value\n");
+                return 1;
+            }
         } else if (argv[i][0] != '-') {
-            // This is the input filename
-            input_filename = argv[i];
+            // An input file; outputs are named after the first
+            if (!input_filename) {
+                input_filename = argv[i];
+            }
+            input_files[input_count++] = argv[i];
         } else {
             printf("Unknown option: %s\n", argv[i]);
             printf("Usage: %s [options] <filename.c>\n", argv[0]);
@@ -142,15 +403,117 @@ int main(int argc, char* argv[]) {
             printf("  --microcode-ssa      Generate SSA-based microcode (verbose, for analysis)\n");
             printf("  --microcode-hs       Generate hotstate-compatible microcode\n");
             printf("  --opt                Apply SSA optimizations (constant/copy propagation)\n");
+            printf("  --bdd                Evaluate conditional expressions as BDDs (for many inputs)\n");
+            printf("  --compact-words      Fuse state assignments with following jumps (--microcode-hs)\n");
+            printf("  --pipeline           Add a delay slot after every jump, for hotstate.sv PIPELINED (--microcode-hs)\n");
+            printf("  --inline-words N     Inline helpers of up to N words instead of calling them (default 2)\n");
+            printf("  --fuse-conditions    Test nested input-only ifs with one combined lookup\n");
+            printf("  --merge-tails        Share repeated instruction tails where no jump is added\n");
+            printf("  --merge-tails-size   Share them even where a jump is added (smaller ROM, more cycles)\n");
+            printf("  --rotate-loops       Test loop conditions at the bottom, guarded once at entry\n");
+            printf("  --layout-blocks      Order CFG blocks so hot successors fall through (HDL)\n");
+            printf("  --profile-use FILE   Rotate loops and inline helpers by a hotstate_sim --profile FILE.json run\n");
+            printf("  --narrow-fields      Pack each microcode field only as wide as its values need\n");
+            printf("  --encoding-report    Report microcode field utilization (--microcode-hs)\n");
+            printf("  --dispatch-report    Price switches and else-if ladders as tables and as test chains\n");
+            printf("  --wcet               Report best and worst cycles to each state assignment (--microcode-hs)\n");
+            printf("  --loop-bound N       Let --wcet assume loops with an exit iterate at most N times\n");
+            printf("  --partition          Split independent tasks onto separate hotstate cores (_p0, _p1, ...)\n");
+            printf("  --vardata-bits N     Pack N LUT bits per vardata .mem word (power of two, default 1)\n");
+            printf("  --vardata-sparse     Skip runs of zero words in the vardata .mem with @address lines\n");
+            printf("  --varsel-logic       Decide small conditions in logic instead of the vardata ROM (--microcode-hs)\n");
+            printf("  --prune-inputs       Drop inputs the program never reads and number the rest by reads\n");
+            printf("  --fold-constants     Fold constant expressions and drop branches and statements never run\n");
+            printf("  --diff-against BASE  Write <base>_patch.txt, the memory words that differ from build BASE\n");
+            printf("  --stable-layout      Keep shared helper bodies at their --diff-against addresses\n");
+            printf("  --cache-dir DIR      Reuse --microcode-hs results cached in DIR\n");
             printf("  --verilog            Generate Verilog HDL module\n");
             printf("  --testbench          Generate Verilog testbench\n");
             printf("  --all-hdl            Generate all HDL files (module, testbench, stimulus, makefile)\n");
+            printf("  --mem-style STYLE    Build the HDL memories as auto (sized each), distributed, block or registers\n");
+            printf("  --sim-fast           Make Makefile.sim build the untraced, optimized, multithreaded harness by default\n");
+            printf("  --sim-threads N      Verilator threads for Makefile.sim's fast target (default 2)\n");
+            printf("  --trace-window A:B   Trace only harness cycles A up to B (A: for no end) in Makefile.sim's sim target\n");
+            printf("  --trace-when NAME    Trace only while output NAME is nonzero\n");
+            printf("  --time-passes        Report wall time per compiler pass (on stderr)\n");
+            printf("  --mem-stats          Report heap and peak RSS per compiler pass (on stderr)\n");
+            printf("  --stats-json         Print pass statistics as JSON\n");
+            printf("  --quiet              Skip the AST dump and microcode listing\n");
+            printf("  --serve              Compile files named in JSON requests on stdin, one per line\n");
+            printf("  --watch              Recompile <filename.c> whenever it or an include changes\n");
+            printf("  --precompile-header  Parse the declarations header <filename.h> once into <filename.h>.hpch\n");
+            printf("  --jobs N             Compile the files of a multi-file program N at a time (default: one per CPU)\n");
             return 1;
         }
     }
     
-    if (input_filename) {
+    if (stable_layout && !diff_against_base) {
+        fprintf(stderr, "Error: --stable-layout requires --diff-against\n");
+        return 1;
+    }
+
+    // --stats-json alone implies timing
+    pass_stats_enable(time_passes || (stats_json && !mem_stats), mem_stats, stats_json);
+
+    if (precompile) {
+        if (!input_filename) {
+            fprintf(stderr, "Error: --precompile-header requires a header file\n");
+            return 1;
+        }
+        bool ok = true;
+        for (int i = 0; i < input_count; i++) {
+            ok = precompile_header(input_files[i]) && ok;
+        }
+        return ok ? 0 : 1;
+    }
+    if (input_count > 1 && (serve || watch)) {
+        fprintf(stderr, "Error: --serve and --watch compile one file at a time\n");
+        return 1;
+    }
+
+    // Long-running modes compile like --microcode-hs, through libhotstate
+    if (serve || watch) {
+        HotstateOptions options = {
+            .compact_words = compact_microcode_words,
+            .inline_words = inline_call_words,
+            .fuse_conditions = fuse_conditions,
+            .merge_tails = merge_common_tails,
+            .use_bdd = use_bdd_conditions,
+            .rotate_loops = rotate_loops,
+            .narrow_fields = narrow_microcode_fields,
+            .vardata_bits = vardata_word_bits,
+            .sparse_vardata = sparse_vardata,
+            .pipeline = pipeline_delay_slots,
+            .prune_inputs = prune_unused_inputs,
+            .fold_constants = fold_constants,
+            .switch_bits = user_set_switch_bits ? switch_offset_bits : 0
+        };
+        if (use_varsel_logic) {
+            fprintf(stderr, "Warning: --varsel-logic does not apply to --serve or --watch\n");
+        }
+        if (diff_against_base) {
+            fprintf(stderr, "Warning: --diff-against does not apply to --serve or --watch\n");
+        }
+        if (serve) {
+            return compile_server_run(stdin, stdout, &options);
+        }
+        if (!input_filename) {
+            fprintf(stderr, "Error: --watch requires a file\n");
+            return 1;
+        }
+        return compile_watch_run(input_filename, &options, 250);
+    }
+
+    if (input_count > 1) {
+        // Each file is preprocessed and parsed on its own, below
+        printf("Compiling %d files as one program:", input_count);
+        for (int i = 0; i < input_count; i++) {
+            printf(" %s", input_files[i]);
+        }
+        printf("\n");
+    } else if (input_filename) {
         // Preprocess includes and read from file
+        pass_begin("preprocess");
         source_code = preprocess_includes(input_filename);
         if (!source_code) {
             printf("Error: Failed to preprocess file '%s'\n", input_filename);
@@ -169,9 +532,46 @@ int main(int argc, char* argv[]) {
         printf("  --microcode-ssa      Generate SSA-based microcode (verbose, for analysis)\n");
         printf("  --microcode-hs       Generate hotstate-compatible microcode\n");
         printf("  --opt                Apply SSA optimizations (constant/copy propagation)\n");
+        printf("  --bdd                Evaluate conditional expressions as BDDs (for many inputs)\n");
+        printf("  --compact-words      Fuse state assignments with following jumps (--microcode-hs)\n");
+        printf("  --pipeline           Add a delay slot after every jump, for hotstate.sv PIPELINED (--microcode-hs)\n");
+        printf("  --inline-words N     Inline helpers of up to N words instead of calling them (default 2)\n");
+        printf("  --fuse-conditions    Test nested input-only ifs with one combined lookup\n");
+        printf("  --merge-tails        Share repeated instruction tails where no jump is added\n");
+        printf("  --merge-tails-size   Share them even where a jump is added (smaller ROM, more cycles)\n");
+        printf("  --rotate-loops       Test loop conditions at the bottom, guarded once at entry\n");
+        printf("  --layout-blocks      Order CFG blocks so hot successors fall through (HDL)\n");
+        printf("  --profile-use FILE   Rotate loops and inline helpers by a hotstate_sim --profile FILE.json run\n");
+        printf("  --narrow-fields      Pack each microcode field only as wide as its values need\n");
+        printf("  --encoding-report    Report microcode field utilization (--microcode-hs)\n");
+        printf("  --dispatch-report    Price switches and else-if ladders as tables and as test chains\n");
+        printf("  --wcet               Report best and worst cycles to each state assignment (--microcode-hs)\n");
+        printf("  --loop-bound N       Let --wcet assume loops with an exit iterate at most N times\n");
+        printf("  --partition          Split independent tasks onto separate hotstate cores (_p0, _p1, ...)\n");
+        printf("  --vardata-bits N     Pack N LUT bits per vardata .mem word (power of two, default 1)\n");
+        printf("  --vardata-sparse     Skip runs of zero words in the vardata .mem with @address lines\n");
+        printf("  --varsel-logic       Decide small conditions in logic instead of the vardata ROM (--microcode-hs)\n");
+        printf("  --prune-inputs       Drop inputs the program never reads and number the rest by reads\n");
+        printf("  --fold-constants     Fold constant expressions and drop branches and statements never run\n");
+        printf("  --diff-against BASE  Write <base>_patch.txt, the memory words that differ from build BASE\n");
+        printf("  --stable-layout      Keep shared helper bodies at their --diff-against addresses\n");
+        printf("  --cache-dir DIR      Reuse --microcode-hs results cached in DIR\n");
         printf("  --verilog            Generate Verilog HDL module\n");
         printf("  --testbench          Generate Verilog testbench\n");
-        printf("  --all-hdl            Generate all HDL files (module, testbench, stimulus, makefile)\n\n");
+        printf("  --all-hdl            Generate all HDL files (module, testbench, stimulus, makefile)\n");
+        printf("  --mem-style STYLE    Build the HDL memories as auto (sized each), distributed, block or registers\n");
+        printf("  --sim-fast           Make Makefile.sim build the untraced, optimized, multithreaded harness by default\n");
+        printf("  --sim-threads N      Verilator threads for Makefile.sim's fast target (default 2)\n");
+        printf("  --trace-window A:B   Trace only harness cycles A up to B (A: for no end) in Makefile.sim's sim target\n");
+        printf("  --trace-when NAME    Trace only while output NAME is nonzero\n");
+        printf("  --time-passes        Report wall time per compiler pass (on stderr)\n");
+        printf("  --mem-stats          Report heap and peak RSS per compiler pass (on stderr)\n");
+        printf("  --stats-json         Print pass statistics as JSON\n");
+        printf("  --quiet              Skip the AST dump and microcode listing\n");
+        printf("  --serve              Compile files named in JSON requests on stdin, one per line\n");
+        printf("  --watch              Recompile <filename.c> whenever it or an include changes\n");
+        printf("  --precompile-header  Parse the declarations header <filename.h> once into <filename.h>.hpch\n");
+        printf("  --jobs N             Compile the files of a multi-file program N at a time (default: one per CPU)\n\n");
         
         const char* default_code =
         "int main() {\n"
@@ -191,23 +591,38 @@ int main(int argc, char* argv[]) {
         source_code = strdup(default_code);
     }
 
-    // 1. Lexing
-    Lexer* lexer = lexer_create(source_code);
-    Token tokens[1024]; // Simple fixed-size buffer
-    int token_count = 0;
-    Token token;
-    do {
-        token = lexer_next_token(lexer);
-        tokens[token_count++] = token;
-        // Optional: print tokens to debug
-        // printf("Token: %s ('%s')\n", token_type_to_string(token.type), token.value);
-    } while (token.type != TOKEN_EOF && token_count < 1024);
-    lexer_destroy(lexer);
+    // Tokens and AST share a per-compilation arena, released in one go below
+    Arena* compile_arena = arena_create(ARENA_DEFAULT_CHUNK_SIZE);
+    ast_set_arena(compile_arena);
+    TokenList* tokens = NULL;
+    Node* ast_root = NULL;
+    if (input_count > 1) {
+        // 1-2. Separate compilation: parse the units in parallel, then link
+        pass_begin("compile_units");
+        if (!compile_units(input_files, input_count, jobs)) {
+            return 1;
+        }
+        pass_begin("link");
+        ast_root = link_units(input_files, input_count);
+        if (!ast_root) {
+            return 1;
+        }
+    } else {
+        // 1. Lexing
+        pass_begin("lex");
+        tokens = lexer_tokenize(source_code, compile_arena);
+        print_debug("Lexed %d tokens\n", tokens->count);
 
-    // 2. Parsing
-    Parser* parser = parser_create(tokens, token_count);
-    Node* ast_root = parse(parser);
-    parser_destroy(parser);
+        // 2. Parsing
+        pass_begin("parse");
+        Parser* parser = parser_create(source_code, tokens->items, tokens->count);
+        ast_root = parse(parser);
+        parser_destroy(parser);
+    }
+    if (ast_root && fold_constants) {
+        pass_begin("fold_constants");
+        fold_program_constants(ast_root);
+    }
     
     // Auto-calculate switch bits if not explicitly set by user
     if (!user_set_switch_bits && generate_microcode && microcode_mode == MICROCODE_COMPACT) {
@@ -216,16 +631,21 @@ int main(int argc, char* argv[]) {
                required_bits, 1 << required_bits);
         switch_offset_bits = required_bits;
     }
+    pass_end();
 
     // 3. Print AST
     if (ast_root) {
-        printf("\n--- Abstract Syntax Tree ---\n");
-        print_ast(ast_root, 0);
+        if (!quiet) {
+            printf("\n--- Abstract Syntax Tree ---\n");
+            print_ast(ast_root, 0);
+        }
         
         // 4. Generate CFG and DOT file if requested
         if (generate_dot) {
             printf("\n--- Generating Control Flow Graph ---\n");
+            pass_begin("build_cfg");
             CFG* cfg = build_cfg_from_ast(ast_root);
+            pass_begin("dot_output");
             if (cfg) {
                 char* dot_filename;
                 if (input_filename) {
@@ -253,12 +673,15 @@ int main(int argc, char* argv[]) {
             } else {
                 printf("Error: Failed to build CFG from AST\n");
             }
+            pass_end();
         }
         
         // 5. Hardware Analysis if requested
         if (analyze_hardware) {
             printf("\n--- Hardware Analysis ---\n");
+            pass_begin("hw_analysis");
             HardwareContext* hw_ctx = analyze_hardware_constructs(ast_root);
+            pass_end();
             if (hw_ctx) {
                 print_hardware_context(hw_ctx, stdout);
                 free_hardware_context(hw_ctx);
@@ -270,7 +693,9 @@ int main(int argc, char* argv[]) {
         // 6. Microcode Generation if requested
         if (generate_microcode) {
             // First analyze hardware constructs
+            pass_begin("hw_analysis");
             HardwareContext* hw_ctx = analyze_hardware_constructs(ast_root);
+            pass_end();
             if (!hw_ctx) {
                 printf("Error: Failed to analyze hardware constructs\n");
             } else {
@@ -323,17 +748,109 @@ int main(int argc, char* argv[]) {
                     case MICROCODE_COMPACT:
                         printf("\n--- Generating Hotstate-Compatible Microcode ---\n");
                         {
+                            // With --partition, independent tasks are compiled to one
+                            // image per core instead (not cached)
+                            if (partition_into_cores) {
+                                pass_begin("partition");
+                                Partitioning* partitioning = partition_program(ast_root, hw_ctx);
+                                pass_end();
+                                bool split = partitioning->count > 1;
+                                if (split && profile_use_file) {
+                                    fprintf(stderr, "Warning: --profile-use does not apply to partitioned cores\n");
+                                }
+                                if (split && diff_against_base) {
+                                    fprintf(stderr, "Warning: --diff-against does not apply to partitioned cores\n");
+                                }
+                                if (split) {
+                                    compile_partitioned_cores(partitioning, hw_ctx, input_filename, quiet);
+                                } else {
+                                    printf("No independent tasks to partition; compiling one core\n");
+                                }
+                                free_partitioning(partitioning);
+                                if (split) {
+                                    break;
+                                }
+                            }
+
+                            // With --cache-dir, an unchanged main reuses the listing and
+                            // output files of an earlier compilation; the key does not
+                            // cover a profile or a previous layout, so a compilation
+                            // guided by either is not cached. The key is built from tokens,
+                            // which a multi-file program, linked from objects, does not have.
+                            bool use_cache = compile_cache_dir && input_filename && tokens && !profile_use_file &&
+                                             !use_varsel_logic && !stable_layout;
+                            uint64_t cache_key = 0;
+                            if (use_cache) {
+                                pass_begin("compile_cache");
+                                cache_key = compile_cache_key(tokens, hw_ctx);
+                                bool hit = compile_cache_restore(cache_key, input_filename, quiet ? NULL : stdout);
+                                pass_end();
+                                if (hit) {
+                                    if (diff_against_base) {
+                                        write_memory_patch(diff_against_base, input_filename);
+                                    }
+                                    break;
+                                }
+                            }
+
+                            if (stable_layout) {
+                                use_previous_layout(diff_against_base);
+                            }
+                            if (profile_use_file) {
+                                pass_begin("profile_use");
+                                use_profile(profile_use_file, ast_root, hw_ctx);
+                                pass_end();
+                            }
+                            pass_begin("ast_to_compact_microcode");
                             CompactMicrocode* compact_mc = ast_to_compact_microcode(ast_root, hw_ctx);
+                            pass_end();
+                            stop_using_profile();
+                            stop_using_previous_layout();
                             if (compact_mc) {
-                                // Print compact microcode table
-                                print_compact_microcode_table(compact_mc, stdout);
-                                
-                                // Print analysis
-                                print_compact_microcode_analysis(compact_mc, stdout);
+                                // The listing is captured so a cache entry can replay it
+                                char* listing = NULL;
+                                size_t listing_size = 0;
+                                FILE* listing_out = use_cache ? open_memstream(&listing, &listing_size) : NULL;
+                                if (!listing_out && !quiet) {
+                                    listing_out = stdout;
+                                }
+
+                                if (listing_out) {
+                                    // Print compact microcode table
+                                    print_compact_microcode_table(compact_mc, listing_out);
+
+                                    // Print analysis
+                                    print_compact_microcode_analysis(compact_mc, listing_out);
+                                    if (report_microcode_encoding) {
+                                        print_microcode_encoding_analysis(compact_mc, listing_out);
+                                    }
+                                    if (report_dispatch_costs) {
+                                        print_dispatch_cost_analysis(compact_mc, listing_out);
+                                    }
+                                    if (report_wcet) {
+                                        print_wcet_analysis(compact_mc, listing_out);
+                                    }
+                                }
+                                if (listing_out && listing_out != stdout) {
+                                    fclose(listing_out);
+                                    if (!quiet) {
+                                        fwrite(listing, 1, listing_size, stdout);
+                                    }
+                                }
 
                                 // Generate memory files if input filename provided
                                 if (input_filename) {
+                                    pass_begin("generate_output_files");
                                     generate_all_output_files(compact_mc, input_filename);
+                                    if (diff_against_base) {
+                                        pass_begin("memory_patch");
+                                        write_memory_patch(diff_against_base, input_filename);
+                                    }
+                                    pass_end();
+                                    if (listing) {
+                                        compile_cache_store(cache_key, input_filename, listing, listing_size);
+                                    }
+                                    free(listing);
                                 } else {
                                     fprintf(stderr, "Warning: Cannot generate .mem files without an input filename.\n");
                                 }
@@ -359,17 +876,50 @@ int main(int argc, char* argv[]) {
             printf("\n--- Generating Verilog HDL ---\n");
             
             // First analyze hardware constructs
+            pass_begin("hw_analysis");
             HardwareContext* hw_ctx = analyze_hardware_constructs(ast_root);
+            pass_end();
             if (!hw_ctx) {
                 printf("Error: Failed to analyze hardware constructs\n");
             } else {
+                // With --partition, each core's module and a module tying them together
+                Partitioning* partitioning = NULL;
+                if (partition_into_cores) {
+                    pass_begin("partition");
+                    partitioning = partition_program(ast_root, hw_ctx);
+                    pass_end();
+                    if (partitioning->count > 1) {
+                        generate_partitioned_verilog(partitioning, hw_ctx,
+                                                     input_filename ? input_filename : "output");
+                    }
+                }
+
                 // Build CFG if not already done
+                pass_begin("build_cfg");
                 CFG* cfg = build_cfg_from_ast(ast_root);
+                pass_end();
                 if (!cfg) {
                     printf("Error: Failed to build CFG from AST\n");
                 } else {
+                    // Drop dead blocks and jump-only hops before they become ROM words
+                    pass_begin("simplify_cfg");
+                    simplify_cfg(cfg);
+                    pass_end();
+                    if (rotate_loops) {
+                        pass_begin("rotate_loops");
+                        rotate_cfg_loops(cfg);
+                        pass_end();
+                    }
+                    if (layout_blocks) {
+                        pass_begin("layout_blocks");
+                        place_cfg_blocks(cfg);
+                        pass_end();
+                    }
+                    
                     // Generate microcode (needed for HDL generation)
+                    pass_begin("cfg_to_hotstate_microcode");
                     HotstateMicrocode* microcode = cfg_to_hotstate_microcode(cfg, hw_ctx);
+                    pass_end();
                     if (microcode) {
                         // Set up Verilog generation options
                         VerilogGenOptions options = {
@@ -377,11 +927,24 @@ int main(int argc, char* argv[]) {
                             .generate_testbench = generate_testbench || generate_all_hdl,
                             .generate_user_stim = generate_all_hdl,
                             .generate_makefile = generate_all_hdl,
-                            .generate_all = generate_all_hdl
+                            .generate_all = generate_all_hdl,
+                            .stack_depth = calculate_required_stack_depth(ast_root, NULL)
                         };
+                        int* output_owner = NULL;
+                        if (partitioning && partitioning->count > 1) {
+                            output_owner = malloc((hw_ctx->state_count + 1) * sizeof(int));
+                            for (int s = 0; s < hw_ctx->state_count; s++) {
+                                output_owner[s] = partitioning->state_owner[hw_ctx->states[s].state_number];
+                            }
+                            options.core_count = partitioning->count;
+                            options.state_owner = output_owner;
+                        }
                         
                         // Generate Verilog HDL
+                        pass_begin("generate_verilog_hdl");
                         generate_verilog_hdl(microcode, input_filename ? input_filename : "output", &options);
+                        pass_end();
+                        free(output_owner);
                         
                         free_hotstate_microcode(microcode);
                     } else {
@@ -391,6 +954,7 @@ int main(int argc, char* argv[]) {
                     free_cfg(cfg);
                 }
                 
+                free_partitioning(partitioning);
                 free_hardware_context(hw_ctx);
             }
         }
@@ -399,12 +963,17 @@ int main(int argc, char* argv[]) {
     }
 
     // 5. Cleanup
+    pass_begin("cleanup");
     free_node(ast_root);
-    for (int i = 0; i < token_count; i++) {
-        free(tokens[i].value);
-    }
+    free_token_list(tokens);
+    ast_set_arena(NULL);
+    print_debug("Compile arena: %zu bytes in %d chunks\n",
+                compile_arena->bytes_allocated, compile_arena->chunk_count);
+    arena_destroy(compile_arena);
+    free_symbol_table();
     free(source_code);
 
+    pass_stats_report(stderr);
     return 0;
 }
 
@@ -0,0 +1,291 @@
+#define _GNU_SOURCE  // For getline, strdup
+#include "mem_patch.h"
+#include "cfg_to_microcode.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+const char* diff_against_base = NULL;
+int stable_layout = 0;
+PreviousLayout* previous_layout = NULL;
+
+// The memories a patch covers, in patch order; timdata only exists for
+// programs with delays, so a missing one is empty rather than an error
+static const struct {
+    const char* name;
+    const char* suffix;
+    bool required;
+} patched_memories[] = {
+    { "smdata", "_smdata.mem", true },
+    { "vardata", "_vardata.mem", true },
+    { "switchdata", "_switchdata.mem", true },
+    { "timdata", "_timdata.mem", false },
+};
+#define PATCHED_MEMORY_COUNT (sizeof(patched_memories) / sizeof(patched_memories[0]))
+
+// old_base + suffix; old_base may name the build's source file too
+static char* old_base_path(const char* old_base, const char* suffix) {
+    size_t length = strlen(old_base);
+    if (length > 2 && strcmp(old_base + length - 2, ".c") == 0) {
+        length -= 2;
+    }
+    char* path = malloc(length + strlen(suffix) + 1);
+    if (!path) {
+        fprintf(stderr, "Error: Memory allocation failed for patch filepath.\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(path, old_base, length);
+    strcpy(path + length, suffix);
+    return path;
+}
+
+// A .mem file's values by address, as $readmemh reads it: one value per
+// token, @address lines moving on, // comments ignored. NULL at an
+// address the file skips.
+typedef struct {
+    char** values;
+    int count;
+} MemoryImage;
+
+static void set_memory_value(MemoryImage* image, int* capacity, int address, const char* token, size_t length) {
+    if (address >= *capacity) {
+        int grown = *capacity ? *capacity : 256;
+        while (grown <= address) grown *= 2;
+        image->values = realloc(image->values, sizeof(char*) * grown);
+        if (!image->values) {
+            fprintf(stderr, "Error: Failed to allocate memory image.\n");
+            exit(EXIT_FAILURE);
+        }
+        memset(image->values + *capacity, 0, sizeof(char*) * (grown - *capacity));
+        *capacity = grown;
+    }
+    free(image->values[address]);
+    image->values[address] = strndup(token, length);
+    if (address >= image->count) {
+        image->count = address + 1;
+    }
+}
+
+static bool read_memory_image(const char* path, MemoryImage* image) {
+    image->values = NULL;
+    image->count = 0;
+    FILE* file = fopen(path, "r");
+    if (!file) return false;
+
+    int capacity = 0;
+    int address = 0;
+    char* line = NULL;
+    size_t line_size = 0;
+    while (getline(&line, &line_size, file) != -1) {
+        char* comment = strstr(line, "//");
+        if (comment) *comment = '\0';
+        for (char* p = line; *p; ) {
+            if (isspace((unsigned char)*p)) {
+                p++;
+                continue;
+            }
+            size_t length = strcspn(p, " \t\r\n");
+            if (*p == '@') {
+                address = (int)strtol(p + 1, NULL, 16);
+            } else {
+                set_memory_value(image, &capacity, address++, p, length);
+            }
+            p += length;
+        }
+    }
+    free(line);
+    fclose(file);
+    return true;
+}
+
+static void free_memory_image(MemoryImage* image) {
+    for (int i = 0; i < image->count; i++) {
+        free(image->values[i]);
+    }
+    free(image->values);
+}
+
+// Whether two values are the same number, an address left out holding 0
+static bool same_memory_value(const char* a, const char* b) {
+    if (!a) a = "0";
+    if (!b) b = "0";
+    while (*a == '0' && a[1]) a++;
+    while (*b == '0' && b[1]) b++;
+    return strcasecmp(a, b) == 0;
+}
+
+static const char* memory_value(const MemoryImage* image, int address) {
+    const char* value = address < image->count ? image->values[address] : NULL;
+    return value ? value : "0";
+}
+
+// Writes the runs of new_image that differ from old_image to patch;
+// returns the words that differ, and adds the runs to *runs
+static int write_memory_runs(FILE* patch, const char* name, const MemoryImage* old_image,
+                             const MemoryImage* new_image, int* runs) {
+    int count = old_image->count > new_image->count ? old_image->count : new_image->count;
+    int changed = 0;
+    for (int address = 0; address < count; ) {
+        if (same_memory_value(memory_value(old_image, address), memory_value(new_image, address))) {
+            address++;
+            continue;
+        }
+        fprintf(patch, "%s @%x", name, address);
+        while (address < count &&
+               !same_memory_value(memory_value(old_image, address), memory_value(new_image, address))) {
+            fprintf(patch, " %s", memory_value(new_image, address));
+            changed++;
+            address++;
+        }
+        fprintf(patch, "\n");
+        (*runs)++;
+    }
+    return changed;
+}
+
+// Whether two files hold the same text; false if either cannot be read
+static bool same_file_text(const char* path_a, const char* path_b) {
+    FILE* a = fopen(path_a, "rb");
+    FILE* b = fopen(path_b, "rb");
+    bool same = a && b;
+    while (same) {
+        int ca = fgetc(a), cb = fgetc(b);
+        if (ca != cb) same = false;
+        if (ca == EOF || cb == EOF) break;
+    }
+    if (a) fclose(a);
+    if (b) fclose(b);
+    return same;
+}
+
+bool write_memory_patch(const char* old_base, const char* source_filename) {
+    MemoryImage old_images[PATCHED_MEMORY_COUNT];
+    MemoryImage new_images[PATCHED_MEMORY_COUNT];
+    memset(old_images, 0, sizeof(old_images));
+    memset(new_images, 0, sizeof(new_images));
+    bool ok = true;
+    for (size_t m = 0; m < PATCHED_MEMORY_COUNT; m++) {
+        char* old_path = old_base_path(old_base, patched_memories[m].suffix);
+        char* new_path = generate_output_filepath(source_filename, patched_memories[m].suffix);
+        bool old_read = read_memory_image(old_path, &old_images[m]);
+        bool new_read = new_path && read_memory_image(new_path, &new_images[m]);
+        if (patched_memories[m].required && (!old_read || !new_read)) {
+            fprintf(stderr, "Error: Cannot read %s for the memory patch\n",
+                    old_read ? (new_path ? new_path : patched_memories[m].suffix) : old_path);
+            ok = false;
+        }
+        free(old_path);
+        free(new_path);
+    }
+
+    char* patch_path = ok ? generate_output_filepath(source_filename, "_patch.txt") : NULL;
+    FILE* patch = patch_path ? fopen(patch_path, "w") : NULL;
+    if (ok && !patch) {
+        fprintf(stderr, "Error: Cannot create memory patch file '%s'\n", patch_path ? patch_path : "_patch.txt");
+        ok = false;
+    }
+    if (ok) {
+        fprintf(patch, "// Memory patch from %s to %s\n", old_base, source_filename);
+        fprintf(patch, "// memory @address values: runs of changed words, written as in the .mem files\n");
+        int runs = 0, words = 0;
+        char summary[256] = "";
+        size_t used = 0;
+        for (size_t m = 0; m < PATCHED_MEMORY_COUNT; m++) {
+            int changed = write_memory_runs(patch, patched_memories[m].name, &old_images[m], &new_images[m], &runs);
+            words += changed;
+            if (patched_memories[m].required || new_images[m].count > 0) {
+                used += snprintf(summary + used, sizeof(summary) - used, "%s%s %d/%d", used ? ", " : "",
+                                 patched_memories[m].name, changed, new_images[m].count);
+            }
+        }
+        fclose(patch);
+        printf("Generated memory patch file: %s (%d words in %d runs: %s)\n", patch_path, words, runs, summary);
+
+        char* old_params = old_base_path(old_base, "_params.vh");
+        char* new_params = generate_output_filepath(source_filename, "_params.vh");
+        if (!same_file_text(old_params, new_params)) {
+            fprintf(stderr, "Warning: %s differs from %s; the field widths or memory sizes changed, "
+                            "so the hardware needs a full rebuild rather than the patch\n", new_params, old_params);
+        }
+        free(old_params);
+        free(new_params);
+    }
+    free(patch_path);
+
+    for (size_t m = 0; m < PATCHED_MEMORY_COUNT; m++) {
+        free_memory_image(&old_images[m]);
+        free_memory_image(&new_images[m]);
+    }
+    return ok;
+}
+
+// --- Stable layout ---
+
+bool use_previous_layout(const char* old_base) {
+    char* path = old_base_path(old_base, "_symbols.toml");
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "Warning: Cannot read %s; --stable-layout keeps no addresses\n", path);
+        free(path);
+        return false;
+    }
+    free(path);
+
+    PreviousLayout* layout = calloc(1, sizeof(PreviousLayout));
+    int capacity = 0;
+    bool in_subroutines = false;
+    char* line = NULL;
+    size_t line_size = 0;
+    while (getline(&line, &line_size, file) != -1) {
+        if (line[0] == '[') {
+            in_subroutines = strncmp(line, "[subroutines]", 13) == 0;
+            continue;
+        }
+        // "address" = { name = "helper", words = N }
+        int address;
+        const char* name = strstr(line, "name = \"");
+        if (!in_subroutines || !name || sscanf(line, " \"%d\"", &address) != 1) continue;
+        name += 8;
+        const char* name_end = strchr(name, '"');
+        if (!name_end) continue;
+        if (layout->count == capacity) {
+            capacity = capacity ? capacity * 2 : 8;
+            layout->names = realloc(layout->names, sizeof(char*) * capacity);
+            layout->addresses = realloc(layout->addresses, sizeof(int) * capacity);
+            if (!layout->names || !layout->addresses) {
+                fprintf(stderr, "Error: Failed to allocate the previous layout.\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+        layout->names[layout->count] = strndup(name, name_end - name);
+        layout->addresses[layout->count++] = address;
+    }
+    free(line);
+    fclose(file);
+
+    stop_using_previous_layout();
+    previous_layout = layout;
+    return true;
+}
+
+void stop_using_previous_layout(void) {
+    if (!previous_layout) return;
+    for (int i = 0; i < previous_layout->count; i++) {
+        free(previous_layout->names[i]);
+    }
+    free(previous_layout->names);
+    free(previous_layout->addresses);
+    free(previous_layout);
+    previous_layout = NULL;
+}
+
+int previous_body_address(const char* name) {
+    for (int i = 0; previous_layout && i < previous_layout->count; i++) {
+        if (strcmp(previous_layout->names[i], name) == 0) {
+            return previous_layout->addresses[i];
+        }
+    }
+    return -1;
+}
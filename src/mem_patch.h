@@ -0,0 +1,54 @@
+#ifndef MEM_PATCH_H
+#define MEM_PATCH_H
+
+#include <stdbool.h>
+
+// Field updates of deployed hardware (--diff-against OLD_BASE). After the
+// output files are written, the smdata, vardata, switchdata and timdata
+// memories are compared with OLD_BASE's (OLD_BASE_smdata.mem and so on,
+// as hotstate_sim -b names a build) and <base>_patch.txt gets the words
+// that differ, one run of consecutive addresses per line:
+//
+//   smdata @1c 14c40 02000
+//
+// the memory, the run's first address and its values, in hex as the .mem
+// files write them (vardata in its own notation). Writing the runs over
+// the old memories gives the new ones; an address a .mem file leaves out
+// holds 0. When _params.vh differs the field widths or memory sizes
+// changed and the hardware needs a full rebuild, which is warned about.
+//
+// --stable-layout also keeps shared helper bodies where OLD_BASE had them,
+// from the [subroutines] its _symbols.toml lists, so a fix in one function
+// does not move every body after it. Empty words fill the gap up to a
+// body's old address; a body that no longer fits there (main, or the body
+// before it, grew past it) goes after the others. Passes that drop or add
+// words later (--compact-words, --merge-tails, --pipeline) can still move
+// them.
+
+extern const char* diff_against_base;  // NULL: no patch
+extern int stable_layout;
+
+// The shared bodies of OLD_BASE, read for --stable-layout
+typedef struct {
+    char** names;
+    int* addresses;
+    int count;
+} PreviousLayout;
+
+// Guides emit_subroutines when set; NULL lays bodies out as usual
+extern PreviousLayout* previous_layout;
+
+// Reads old_base's _symbols.toml and sets previous_layout; false, with a
+// warning, when it cannot be read
+bool use_previous_layout(const char* old_base);
+void stop_using_previous_layout(void);
+
+// Address of name's body in previous_layout, -1 if it had none
+int previous_body_address(const char* name);
+
+// Writes <source_filename base>_patch.txt from the output files already
+// written next to source_filename; false, with the reason on stderr, when
+// a memory cannot be read
+bool write_memory_patch(const char* old_base, const char* source_filename);
+
+#endif // MEM_PATCH_H
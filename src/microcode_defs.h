@@ -3,32 +3,76 @@
 
 #include <stdint.h> // For uint32_t
 
-// MCode struct as defined in docs/microcode_encoding_migration.md
+// Widths of the packed MCode fields below. STATE, MASK and the switch
+// fields (switch_sel carries -1 for a switch on a non-input) stay 32 bits;
+// the others are far wider than any program needs, and
+// populate_mcode_instruction rejects a value that does not fit.
+#define MCODE_JADR_BITS 24
+#define MCODE_TIMERLD_BITS 2
+#define MCODE_VARSEL_BITS 24
+#define MCODE_TIMERSEL_BITS 8
+
+// Largest word address a jadr can hold
+#define MCODE_MAX_ADDRESS ((1u << MCODE_JADR_BITS) - 1)
+
+// MCode struct as defined in docs/microcode_encoding_migration.md, packed
+// into six 32-bit units (24 bytes, against 56 at a uint32_t per field) so
+// resolution, compaction and output walk a dense array
 typedef struct {
     uint32_t state;
     uint32_t mask;
-    uint32_t jadr;
-    uint32_t varSel;
-    uint32_t timerSel;
-    uint32_t timerLd;
     uint32_t switch_sel;
     uint32_t switch_adr;
-    uint32_t state_capture;
-    uint32_t var_or_timer;
-    uint32_t branch;
-    uint32_t forced_jmp;
-    uint32_t sub;
-    uint32_t rtn;
+    uint32_t jadr : MCODE_JADR_BITS;
+    uint32_t state_capture : 1;
+    uint32_t var_or_timer : 1;
+    uint32_t branch : 1;
+    uint32_t forced_jmp : 1;
+    uint32_t sub : 1;
+    uint32_t rtn : 1;
+    uint32_t timerLd : MCODE_TIMERLD_BITS;
+    uint32_t varSel : MCODE_VARSEL_BITS;
+    uint32_t timerSel : MCODE_TIMERSEL_BITS;
 } MCode;
 
-// Code struct as defined in docs/microcode_encoding_migration.md
+// Number of MCode fields; mcode_field numbers them in the order the
+// hardware packs them
+#define MCODE_FIELD_COUNT 14
+
+// uint64 words that hold every MCode field packed at its full width
+#define MCODE_MAX_WORDS ((MCODE_FIELD_COUNT * 32 + 63) / 64)
+
+// Field f of an MCode: state, mask, jadr, varSel, timerSel, timerLd,
+// switch_sel, switch_adr, state_capture, var_or_timer, branch, forced_jmp,
+// sub, rtn
+static inline uint32_t mcode_field(const MCode* m, int f) {
+    switch (f) {
+        case 0: return m->state;
+        case 1: return m->mask;
+        case 2: return m->jadr;
+        case 3: return m->varSel;
+        case 4: return m->timerSel;
+        case 5: return m->timerLd;
+        case 6: return m->switch_sel;
+        case 7: return m->switch_adr;
+        case 8: return m->state_capture;
+        case 9: return m->var_or_timer;
+        case 10: return m->branch;
+        case 11: return m->forced_jmp;
+        case 12: return m->sub;
+        case 13: return m->rtn;
+        default: return 0;
+    }
+}
+
+// Code struct as defined in docs/microcode_encoding_migration.md. The debug
+// label of each word lives out of line, in the owning program's labels
+// array, so the words stay small.
 typedef struct {
-    union {
+    struct {
         MCode mcode; // Use 'mcode' to avoid conflict with struct name
-        uint32_t value[14]; // Assuming 14 fields, each uint32_t
     } uword;
     uint32_t level; // Metadata for hotstate compatibility/debugging
-    char *label;    // Debug label for the instruction
 } Code;
 
-#endif // MICROCODE_DEFS_H
\ No newline at end of file
+#endif // MICROCODE_DEFS_H
@@ -2,17 +2,20 @@
 #include "cfg_to_microcode.h"
 #include "microcode_defs.h" // Include new microcode definitions
 #include "ast_to_microcode.h" // Include CompactMicrocode definition
+#include "output_file.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 #include <math.h> // For ceil and log2
+#include <ctype.h>
 
 extern int debug_mode; // Declare debug_mode as external
 
 // Forward declarations for local functions (will be moved to header later)
 static int calculate_bit_width(int max_val);
-static uint64_t pack_mcode_instruction(MCode* mcode, CompactMicrocode* mc);
+static int pack_mcode_instruction(MCode* mcode, const int* widths, uint64_t* words);
 static void generate_microcode_params_vh(CompactMicrocode* mc, const char* filename);
+static FILE* create_output_file(const char* filename, const char* mode, const char* what);
 
 // --- Hotstate-Compatible Output Generation ---
 /*
@@ -61,7 +64,7 @@ void print_hotstate_microcode_table(HotstateMicrocode* mc, FILE* output) {
             forced_jmp,         // Forced jump
             sub,                // Subroutine
             rtn,                // Return
-            code_entry->label ? code_entry->label : "");
+            mc->labels[i] ? mc->labels[i] : "");
     }
     
     fprintf(output, "\n");
@@ -78,123 +81,293 @@ static int calculate_bit_width(int max_val) {
     return (int)ceil(log2(max_val + 1));
 }
 
-// Function to pack an MCode struct into a uint64_t based on dynamic bit-widths
-// The packing order must match the hardware's unpacking order.
-// This example uses a fixed order for now, but in a real scenario,
-// this order would need to be defined and consistent.
-static uint64_t pack_mcode_instruction(MCode* mcode, CompactMicrocode* mc) {
-    uint64_t packed_word = 0;
+// Sets width bits of a multi-word packed value at *shift, little-endian
+// across uint64 words, and advances *shift past them
+static void pack_field(uint64_t* words, int* shift, uint64_t value, int width) {
+    if (width <= 0) return;
+    if (width < 64) {
+        value &= (1ULL << width) - 1;
+    }
+    int word = *shift / 64;
+    int bit = *shift % 64;
+    if (word < MCODE_MAX_WORDS) {
+        words[word] |= value << bit;
+    }
+    if (bit != 0 && width > 64 - bit && word + 1 < MCODE_MAX_WORDS) {
+        words[word + 1] |= value >> (64 - bit);
+    }
+    *shift += width;
+}
+
+int narrow_microcode_fields = 0;
+int report_microcode_encoding = 0;
+int report_dispatch_costs = 0;
+int vardata_word_bits = 1;
+int sparse_vardata = 0;
+
+// MCode fields in packing order (LSB to MSB), as the .vh names them
+static const char* const MCODE_FIELD_NAMES[MCODE_FIELD_COUNT] = {
+    "STATE", "MASK", "JADR", "VARSEL", "TIMERSEL", "TIMERLD", "SWITCH_SEL",
+    "SWITCH_ADR", "STATE_CAPTURE", "VAR_OR_TIMER", "BRANCH", "FORCED_JMP", "SUB", "RTN"
+};
+#define MCODE_FIRST_FLAG_FIELD 7   // SWITCH_ADR onwards are single-bit flags
+
+// Largest value each field takes in the program
+static void mcode_field_maxima(CompactMicrocode* mc, uint32_t* maxima) {
+    memset(maxima, 0, sizeof(uint32_t) * MCODE_FIELD_COUNT);
+    for (int i = 0; i < mc->instruction_count; i++) {
+        for (int f = 0; f < MCODE_FIELD_COUNT; f++) {
+            uint32_t value = mcode_field(&mc->instructions[i].uword.mcode, f);
+            if (value > maxima[f]) {
+                maxima[f] = value;
+            }
+        }
+    }
+}
+
+// Bits needed to hold value; 0 needs none
+static int value_bit_width(uint32_t value) {
+    int bits = 0;
+    while (value) {
+        bits++;
+        value >>= 1;
+    }
+    return bits;
+}
+
+// Bit width of every field in the packed word. The default layout is the
+// one the hardware examples use (8-bit jadr, a switch_sel bit even without
+// switches, rtn written twice). With --narrow-fields each multi-bit field
+// is as wide as its largest value needs, and a field no word uses takes no
+// bits; the .vh and image then describe this exact layout.
+static int packed_field_widths(CompactMicrocode* mc, int* widths) {
+    if (narrow_microcode_fields) {
+        uint32_t maxima[MCODE_FIELD_COUNT];
+        mcode_field_maxima(mc, maxima);
+        for (int f = 0; f < MCODE_FIELD_COUNT; f++) {
+            if (f >= MCODE_FIRST_FLAG_FIELD) {
+                widths[f] = 1;
+            } else {
+                widths[f] = value_bit_width(maxima[f]);
+            }
+        }
+        // One state and one mask bit per state variable, used or not
+        widths[0] = mc->hw_ctx->state_count;
+        widths[1] = mc->hw_ctx->state_count;
+    } else {
+        widths[0] = mc->hw_ctx->state_count;
+        widths[1] = mc->hw_ctx->state_count;
+        // JADR_WIDTH is 8 bits (fixed address width as per Hotstate examples)
+        widths[2] = 8;
+        // Harmonized varsel_width: Ensure mc->hw_ctx->input_count accurately reflects hotstate's gvarSel intent
+        widths[3] = calculate_bit_width(mc->hw_ctx->input_count > 0 ? mc->hw_ctx->input_count - 1 : 0);
+        // Harmonized timersel_width and timerld_width: Ensure max_timersel_val/max_timerld_val align with hotstate's gTimers
+        widths[4] = (mc->max_timersel_val > 0) ? calculate_bit_width(mc->max_timersel_val) : 0;
+        widths[5] = (mc->max_timerld_val > 0) ? calculate_bit_width(mc->max_timerld_val) : 0;
+        // Harmonized switch_sel_width: Dynamically determined based on the maximum switch selection value, aligning with hotstate's gSwitches
+        widths[6] = calculate_bit_width(mc->max_switch_sel_val);
+        for (int f = MCODE_FIRST_FLAG_FIELD; f < MCODE_FIELD_COUNT; f++) {
+            widths[f] = 1;
+        }
+    }
+
+    int total = 0;
+    for (int f = 0; f < MCODE_FIELD_COUNT; f++) {
+        total += widths[f];
+    }
+    return narrow_microcode_fields ? total : total + 1; // Default layout repeats rtn
+}
+
+// Field widths the .vh and image report. These describe the packed word
+// exactly only with --narrow-fields; the default layout keeps the widths
+// the existing parameter files have always carried.
+static void param_field_widths(CompactMicrocode* mc, int* widths) {
+    if (narrow_microcode_fields) {
+        packed_field_widths(mc, widths);
+        return;
+    }
+    widths[0] = calculate_bit_width(mc->max_state_val);
+    widths[1] = calculate_bit_width(mc->max_mask_val);
+    widths[2] = calculate_bit_width(mc->max_jadr_val);
+    widths[3] = calculate_bit_width(mc->max_varsel_val);
+    widths[4] = calculate_bit_width(mc->max_timersel_val);
+    widths[5] = calculate_bit_width(mc->max_timerld_val);
+    widths[6] = calculate_bit_width(mc->max_switch_sel_val);
+    widths[7] = calculate_bit_width(mc->max_switch_adr_val);
+    widths[8] = calculate_bit_width(mc->max_state_capture_val);
+    widths[9] = calculate_bit_width(mc->max_var_or_timer_val);
+    widths[10] = calculate_bit_width(mc->max_branch_val);
+    widths[11] = calculate_bit_width(mc->max_forced_jmp_val);
+    widths[12] = calculate_bit_width(mc->max_sub_val);
+    widths[13] = calculate_bit_width(mc->max_rtn_val);
+}
+
+// Function to pack an MCode struct into MCODE_MAX_WORDS uint64s (least
+// significant first) with the field widths from packed_field_widths;
+// returns the bit width. The packing order must match the hardware's
+// unpacking order.
+static int pack_mcode_instruction(MCode* mcode, const int* widths, uint64_t* words) {
     int current_shift = 0;
+    memset(words, 0, sizeof(uint64_t) * MCODE_MAX_WORDS);
+    for (int f = 0; f < MCODE_FIELD_COUNT; f++) {
+        pack_field(words, &current_shift, mcode_field(mcode, f), widths[f]);
+    }
+    if (!narrow_microcode_fields) {
+        pack_field(words, &current_shift, mcode->rtn, 1);
+    }
+    return current_shift;
+}
 
-    // Define bit widths based on Hotstate's structure
-    // These should ideally come from a central configuration or be derived more robustly
-    int state_width = mc->hw_ctx->state_count;
-    int mask_width = mc->hw_ctx->state_count;
-    // JADR_WIDTH is 8 bits (fixed address width as per Hotstate examples)
-    int jadr_width = 8;
-    // Harmonized varsel_width: Ensure mc->hw_ctx->input_count accurately reflects hotstate's gvarSel intent
-    int varsel_width = calculate_bit_width(mc->hw_ctx->input_count > 0 ? mc->hw_ctx->input_count - 1 : 0);
-    // Harmonized timersel_width and timerld_width: Ensure max_timersel_val/max_timerld_val align with hotstate's gTimers
-    int timersel_width = (mc->max_timersel_val > 0) ? calculate_bit_width(mc->max_timersel_val) : 0;
-    int timerld_width = (mc->max_timerld_val > 0) ? calculate_bit_width(mc->max_timerld_val) : 0;
-    // Harmonized switch_sel_width: Dynamically determined based on the maximum switch selection value, aligning with hotstate's gSwitches
-    int switch_sel_width = calculate_bit_width(mc->max_switch_sel_val);
-
-    // Pack fields in Hotstate's defined order (LSB to MSB)
-    // state
-    packed_word |= ((uint64_t)mcode->state & ((1ULL << state_width) - 1)) << current_shift;
-    current_shift += state_width;
-
-    // mask
-    packed_word |= ((uint64_t)mcode->mask & ((1ULL << mask_width) - 1)) << current_shift;
-    current_shift += mask_width;
-
-    // jadr
-    packed_word |= ((uint64_t)mcode->jadr & ((1ULL << jadr_width) - 1)) << current_shift;
-    current_shift += jadr_width;
-
-    // varSel
-    packed_word |= ((uint64_t)mcode->varSel & ((1ULL << varsel_width) - 1)) << current_shift;
-    current_shift += varsel_width;
-
-    // timerSel
-    packed_word |= ((uint64_t)mcode->timerSel & ((1ULL << timersel_width) - 1)) << current_shift;
-    current_shift += timersel_width;
-
-    // timerLd
-    packed_word |= ((uint64_t)mcode->timerLd & ((1ULL << timerld_width) - 1)) << current_shift;
-    current_shift += timerld_width;
-
-    // switch_sel
-    packed_word |= ((uint64_t)mcode->switch_sel & ((1ULL << switch_sel_width) - 1)) << current_shift;
-    current_shift += switch_sel_width;
-
-    // switch_adr (1 bit)
-    packed_word |= ((uint64_t)mcode->switch_adr & 1ULL) << current_shift;
-    current_shift += 1;
-
-    // state_capture (1 bit)
-    packed_word |= ((uint64_t)mcode->state_capture & 1ULL) << current_shift;
-    current_shift += 1;
-
-    // var_or_timer (1 bit)
-    packed_word |= ((uint64_t)mcode->var_or_timer & 1ULL) << current_shift;
-    current_shift += 1;
-
-    // branch (1 bit)
-    packed_word |= ((uint64_t)mcode->branch & 1ULL) << current_shift;
-    current_shift += 1;
-
-    // forced_jmp (1 bit)
-    packed_word |= ((uint64_t)mcode->forced_jmp & 1ULL) << current_shift;
-    current_shift += 1;
-
-    // sub (1 bit)
-    packed_word |= ((uint64_t)mcode->sub & 1ULL) << current_shift;
-    current_shift += 1;
-
-    // rtn (1 bit)
-    packed_word |= ((uint64_t)mcode->rtn & 1ULL) << current_shift;
-    current_shift += 1;
-    // rtn (1 bit)
-    packed_word |= ((uint64_t)mcode->rtn & 1ULL) << current_shift;
-    current_shift += 1;
-    
-    // Check for overflow (conceptual, actual multi-word packing would be handled here)
-    if (current_shift > 64) {
-        fprintf(stderr, "Warning: Microcode instruction bit width (%d) exceeds 64 bits. Multi-word packing is required.\n", current_shift);
-        // In full implementation, this would involve packing into multiple uint64_t values
-        // For now, this serves as a detection and warning.
+// --- Buffered output ---
+// The .mem and image writers format a whole file into one buffer with the
+// hand-rolled formatters below and pass it to stdio in a single fwrite;
+// one fprintf per value dominated output time for megabyte vardata LUTs.
+
+// Text is formatted into the buffer and written out a chunk at a time, so a
+// large memory file costs OUTPUT_CHUNK_SIZE of heap rather than its size
+#define OUTPUT_CHUNK_SIZE (64 * 1024)
+
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;
+    bool failed;       // An allocation failed; nothing more is appended
+    FILE* file;        // Where full chunks go
+} OutputBuffer;
+
+// Room for extra more bytes at data + length; false once out of memory
+static bool output_reserve(OutputBuffer* out, size_t extra) {
+    if (out->failed) return false;
+    if (out->length > 0 && out->length + extra > OUTPUT_CHUNK_SIZE) {
+        fwrite(out->data, 1, out->length, out->file);
+        out->length = 0;
     }
+    if (out->length + extra <= out->capacity) return true;
+    size_t capacity = out->capacity ? out->capacity : 4096;
+    while (capacity < out->length + extra) capacity *= 2;
+    char* data = realloc(out->data, capacity);
+    if (!data) {
+        out->failed = true;
+        return false;
+    }
+    out->data = data;
+    out->capacity = capacity;
+    return true;
+}
 
-    return packed_word;
+// Appends value as lowercase hex: at least min_digits digits, more if the
+// value needs them, as "%0*llx" does; words holds count uint64s, least
+// significant first
+static void output_hex_words(OutputBuffer* out, const uint64_t* words, int count, int min_digits) {
+    int digits = count * 16;
+    while (digits > min_digits && ((words[(digits - 1) / 16] >> (4 * ((digits - 1) % 16))) & 0xF) == 0) {
+        digits--;
+    }
+    if (!output_reserve(out, (size_t)digits + 1)) return;
+    char* p = out->data + out->length;
+    for (int d = digits - 1; d >= 0; d--) {
+        *p++ = "0123456789abcdef"[(words[d / 16] >> (4 * (d % 16))) & 0xF];
+    }
+    *p++ = '\n';
+    out->length = p - out->data;
 }
 
-// Function to generate the microcode_params.vh file
-static void generate_microcode_params_vh(CompactMicrocode* mc, const char* filename) {
-    FILE* file = fopen(filename, "w");
+// Appends value in decimal and a newline, as "%u\n"
+static void output_decimal_line(OutputBuffer* out, uint32_t value) {
+    char digits[10];
+    int n = 0;
+    do {
+        digits[n++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value);
+    if (!output_reserve(out, (size_t)n + 1)) return;
+    char* p = out->data + out->length;
+    while (n > 0) *p++ = digits[--n];
+    *p++ = '\n';
+    out->length = p - out->data;
+}
+
+// Writes what is left of the buffer out and releases it
+static void output_flush(OutputBuffer* out) {
+    if (out->failed) {
+        fprintf(stderr, "Error: Out of memory while formatting output\n");
+    } else if (out->length > 0) {
+        fwrite(out->data, 1, out->length, out->file);
+    }
+    free(out->data);
+    out->data = NULL;
+    out->length = out->capacity = 0;
+}
+
+// Opens an output file, reporting failure the way every generator does.
+// It is written through output_file_open, so a file that comes out the
+// same as the one already there is left untouched.
+static FILE* create_output_file(const char* filename, const char* mode, const char* what) {
+    FILE* file = output_file_open(filename, mode);
     if (!file) {
-        fprintf(stderr, "Error: Cannot create file '%s'\n", filename);
-        return;
+        fprintf(stderr, "Error: Cannot create %s '%s'\n", what, filename);
     }
+    return file;
+}
+
+// Each output has a write_* function that emits it to an open stream (used
+// in-process by the hotstate library) and a generate_* wrapper that writes
+// the file next to the source and reports it.
 
+// Bits of the longest count a delay loads, at least one
+static int timdata_bit_width(CompactMicrocode* mc) {
+    uint32_t max_count = 0;
+    for (int i = 0; i < mc->timdata_count; i++) {
+        if (mc->timdata[i] > max_count) max_count = mc->timdata[i];
+    }
+    int bits = 1;
+    while (bits < 32 && (max_count >> bits) != 0) bits++;
+    return bits;
+}
+
+void write_microcode_params_vh(CompactMicrocode* mc, FILE* file) {
     fprintf(file, "`ifndef MICROCODE_PARAMS_VH\n");
     fprintf(file, "`define MICROCODE_PARAMS_VH\n\n");
 
-    fprintf(file, "localparam STATE_WIDTH = %d;\n", calculate_bit_width(mc->max_state_val));
-    fprintf(file, "localparam MASK_WIDTH = %d;\n", calculate_bit_width(mc->max_mask_val));
-    fprintf(file, "localparam JADR_WIDTH = %d;\n", calculate_bit_width(mc->max_jadr_val));
-    fprintf(file, "localparam VARSEL_WIDTH = %d;\n", calculate_bit_width(mc->max_varsel_val));
-    fprintf(file, "localparam TIMERSEL_WIDTH = %d;\n", calculate_bit_width(mc->max_timersel_val));
-    fprintf(file, "localparam TIMERLD_WIDTH = %d;\n", calculate_bit_width(mc->max_timerld_val));
-    fprintf(file, "localparam SWITCH_SEL_WIDTH = %d;\n", calculate_bit_width(mc->max_switch_sel_val));
-    fprintf(file, "localparam SWITCH_ADR_WIDTH = %d;\n", calculate_bit_width(mc->max_switch_adr_val));
-    fprintf(file, "localparam STATE_CAPTURE_WIDTH = %d;\n", calculate_bit_width(mc->max_state_capture_val));
-    fprintf(file, "localparam VAR_OR_TIMER_WIDTH = %d;\n", calculate_bit_width(mc->max_var_or_timer_val));
-    fprintf(file, "localparam BRANCH_WIDTH = %d;\n", calculate_bit_width(mc->max_branch_val));
-    fprintf(file, "localparam FORCED_JMP_WIDTH = %d;\n", calculate_bit_width(mc->max_forced_jmp_val));
-    fprintf(file, "localparam SUB_WIDTH = %d;\n", calculate_bit_width(mc->max_sub_val));
-    fprintf(file, "localparam RTN_WIDTH = %d;\n", calculate_bit_width(mc->max_rtn_val));
+    int widths[MCODE_FIELD_COUNT];
+    param_field_widths(mc, widths);
+    for (int f = 0; f < MCODE_FIELD_COUNT; f++) {
+        fprintf(file, "localparam %s_WIDTH = %d;\n", MCODE_FIELD_NAMES[f], widths[f]);
+    }
+    // STATE_WIDTH counts state bits under --narrow-fields, so readers take
+    // the state count from here rather than from the width
+    fprintf(file, "localparam NUM_STATES = %d;\n", mc->hw_ctx->state_count);
+    if (mc->varsel_logic_count > 0) {
+        // hotstate's NUM_VARSEL: varsels from here up are <base>_varsel_logic's
+        fprintf(file, "localparam VARSEL_ROM_BLOCKS = %d;\n", mc->varsel_rom_blocks);
+    }
+    if (vardata_word_bits > 1) {
+        // variable.sv then reads the vardata .mem as hex words of this many LUT bits
+        fprintf(file, "localparam VARDATA_WORD_BITS = %d;\n", vardata_word_bits);
+    }
+    // Return stack entries for the deepest call nesting; 0 leaves stack.sv out
+    fprintf(file, "localparam STACK_DEPTH = %d;\n", mc->stack_depth);
+    if (mc->pipelined) {
+        // The words carry delay slots for hotstate.sv's registered fetch
+        fprintf(file, "localparam PIPELINED = 1;\n");
+    }
+    if (mc->timdata_count > 0) {
+        // Delays load timer 0 from <base>_timdata.mem, addressed by jadr
+        fprintf(file, "localparam NUM_TIMERS = 1;\n");
+        fprintf(file, "localparam TIM_WIDTH = %d;\n", timdata_bit_width(mc));
+        fprintf(file, "localparam TIM_MEM_WORDS = %d;\n", mc->timdata_count);
+    }
+    if (mc->interrupt_vector_count > 0) {
+        // For hotstate's interrupt_address input: the first handler, then each by name
+        fprintf(file, "localparam INTERRUPT_ADDRESS = %d;\n", mc->interrupt_vectors[0].address);
+        for (int i = 0; i < mc->interrupt_vector_count; i++) {
+            fprintf(file, "localparam INTERRUPT_");
+            for (const char* c = mc->interrupt_vectors[i].name + strlen(INTERRUPT_HANDLER_PREFIX); *c; c++) {
+                fputc(toupper((unsigned char)*c), file);
+            }
+            fprintf(file, "_ADDRESS = %d;\n", mc->interrupt_vectors[i].address);
+        }
+    }
 
     // Calculate total INSTR_WIDTH
     fprintf(file, "\nlocalparam INSTR_WIDTH = STATE_WIDTH + MASK_WIDTH + JADR_WIDTH + VARSEL_WIDTH + \n");
@@ -203,20 +376,21 @@ static void generate_microcode_params_vh(CompactMicrocode* mc, const char* filen
     fprintf(file, "                         SUB_WIDTH + RTN_WIDTH;\n");
 
     fprintf(file, "\n`endif // MICROCODE_PARAMS_VH\n");
-    
-    fclose(file);
+}
+
+// Function to generate the microcode_params.vh file
+static void generate_microcode_params_vh(CompactMicrocode* mc, const char* filename) {
+    FILE* file = create_output_file(filename, "w", "file");
+    if (!file) return;
+    write_microcode_params_vh(mc, file);
+    if (!output_file_close(file, filename)) return;
     printf("Generated Verilog parameter file: %s\n", filename);
 }
 
 // --- Memory File Generation ---
 
-void generate_smdata_mem_file(CompactMicrocode* mc, const char* filename) {
-    FILE* file = fopen(filename, "w");
-    if (!file) {
-        fprintf(stderr, "Error: Cannot create file '%s'\n", filename);
-        return;
-    }
-    
+// Hex digits per smdata line; the instruction width in bits goes to *total_width
+static int smdata_hex_width(CompactMicrocode* mc, int* widths, int* total_width) {
     // Calculate hex width based on total instruction width
     // Calculate total INSTR_WIDTH based on Hotstate's formula
     // STATE_WIDTH and MASK_WIDTH are mc->hw_ctx->state_count
@@ -233,18 +407,42 @@ void generate_smdata_mem_file(CompactMicrocode* mc, const char* filename) {
                             7; // Fixed 1-bit flags (switch_adr, state_capture, var_or_timer, branch, forced_jmp, sub, rtn)
         
     int hex_width = total_instr_width / 4 + 1; // Match Hotstate's smdata_nibs calculation
-    if (hex_width == 0) hex_width = 1; // Ensure at least 1 hex digit
- 
-    char format_str[32]; // Increased size to prevent truncation warnings
-    snprintf(format_str, sizeof(format_str), "%%0%dllx\n", hex_width); // Use %llx for uint64_t
  
-    // Write each instruction with variable width (no masking needed)
+    int packed_width = packed_field_widths(mc, widths);
+    if (narrow_microcode_fields) {
+        total_instr_width = packed_width;
+        hex_width = (packed_width + 3) / 4;
+    }
+    if (hex_width == 0) hex_width = 1; // Ensure at least 1 hex digit
+    if (hex_width > MCODE_MAX_WORDS * 16) hex_width = MCODE_MAX_WORDS * 16;
+    *total_width = total_instr_width;
+    return hex_width;
+}
+
+void write_smdata_mem(CompactMicrocode* mc, FILE* file) {
+    // Write each instruction with variable width; words wider than 64 bits
+    // are written as one long hex line, which $readmemh reads as is
+    int widths[MCODE_FIELD_COUNT];
+    int total_instr_width;
+    int hex_width = smdata_hex_width(mc, widths, &total_instr_width);
+    OutputBuffer out = {.file = file};
+    uint64_t packed_instruction[MCODE_MAX_WORDS];
     for (int i = 0; i < mc->instruction_count; i++) {
-        uint64_t packed_instruction = pack_mcode_instruction(&mc->instructions[i].uword.mcode, mc);
-        fprintf(file, format_str, packed_instruction);
+        pack_mcode_instruction(&mc->instructions[i].uword.mcode, widths, packed_instruction);
+        output_hex_words(&out, packed_instruction, MCODE_MAX_WORDS, hex_width);
     }
-    
-    fclose(file);
+    output_flush(&out);
+}
+
+void generate_smdata_mem_file(CompactMicrocode* mc, const char* filename) {
+    FILE* file = create_output_file(filename, "w", "file");
+    if (!file) return;
+    write_smdata_mem(mc, file);
+    if (!output_file_close(file, filename)) return;
+
+    int widths[MCODE_FIELD_COUNT];
+    int total_instr_width;
+    int hex_width = smdata_hex_width(mc, widths, &total_instr_width);
     printf("Generated microcode memory file: %s (width: %d hex digits, total bit width: %d)\n", filename, hex_width, total_instr_width);
 }
 
@@ -279,14 +477,8 @@ void print_variable_mappings(HotstateMicrocode* mc, FILE* output) {
     fprintf(output, "\n");
 }
 
-// Generate symbol table file for simulator in TOML format
-void generate_symbol_table_file(CompactMicrocode* mc, const char* filename) {
-    FILE* file = fopen(filename, "w");
-    if (!file) {
-        fprintf(stderr, "Error: Cannot create symbol table file '%s'\n", filename);
-        return;
-    }
-
+// Symbol table for the simulator in TOML format
+void write_symbol_table(CompactMicrocode* mc, FILE* file) {
     // Write TOML header with metadata
     fprintf(file, "# Symbol table for simulator\n");
     fprintf(file, "# Generated from %s\n", mc->function_name);
@@ -319,7 +511,32 @@ void generate_symbol_table_file(CompactMicrocode* mc, const char* filename) {
     }
     fprintf(file, "\n");
 
-    fclose(file);
+    if (mc->interrupt_vector_count > 0) {
+        fprintf(file, "[interrupt_handlers]\n");
+        for (int i = 0; i < mc->interrupt_vector_count; i++) {
+            fprintf(file, "\"%d\" = { name = \"%s\", type = \"interrupt\" }\n",
+                    mc->interrupt_vectors[i].address, mc->interrupt_vectors[i].name);
+        }
+        fprintf(file, "\n");
+    }
+
+    // Where the shared helper bodies are, for --stable-layout
+    if (mc->subroutine_body_count > 0) {
+        fprintf(file, "[subroutines]\n");
+        for (int i = 0; i < mc->subroutine_body_count; i++) {
+            fprintf(file, "\"%d\" = { name = \"%s\", words = %d }\n",
+                    mc->subroutine_bodies[i].address, mc->subroutine_bodies[i].name, mc->subroutine_bodies[i].words);
+        }
+        fprintf(file, "\n");
+    }
+}
+
+// Generate symbol table file for simulator in TOML format
+void generate_symbol_table_file(CompactMicrocode* mc, const char* filename) {
+    FILE* file = create_output_file(filename, "w", "symbol table file");
+    if (!file) return;
+    write_symbol_table(mc, file);
+    if (!output_file_close(file, filename)) return;
 
     if (debug_mode) {
         printf("Generated TOML symbol table file: %s\n", filename);
@@ -327,46 +544,148 @@ void generate_symbol_table_file(CompactMicrocode* mc, const char* filename) {
 }
 
 
-void generate_switchdata_mem_file(CompactMicrocode* mc, const char* filename) {
-    FILE* file = fopen(filename, "w");
-    if (!file) {
-        fprintf(stderr, "Error: Cannot create file '%s'\n", filename);
-        return;
+void write_timdata_mem(CompactMicrocode* mc, FILE* file) {
+    int hex_width = (timdata_bit_width(mc) + 3) / 4;
+    OutputBuffer out = {.file = file};
+    for (int i = 0; i < mc->timdata_count; i++) {
+        uint64_t count = mc->timdata[i];
+        output_hex_words(&out, &count, 1, hex_width);
     }
+    output_flush(&out);
+}
 
+static void generate_timdata_mem_file(CompactMicrocode* mc, const char* filename) {
+    FILE* file = create_output_file(filename, "w", "file");
+    if (!file) return;
+    write_timdata_mem(mc, file);
+    if (!output_file_close(file, filename)) return;
+    printf("Generated timer data memory file: %s (%d words)\n", filename, mc->timdata_count);
+}
+
+// Hex digits per switchdata line: enough for the largest jump address
+static int switchdata_hex_width(CompactMicrocode* mc) {
+    int jadr_bit_width = calculate_bit_width(mc->max_jadr_val);
+    int hex_width = (jadr_bit_width + 3) / 4;
+    if (hex_width == 0) hex_width = 1; // Ensure at least 1 hex digit
+    return hex_width;
+}
+
+void write_switchdata_mem(CompactMicrocode* mc, FILE* file) {
     // Calculate the total size of the switch memory based on hotstate's logic
     // This assumes mc->switch_count and mc->switch_offset_bits are correctly populated
     int total_switchmem_size = mc->switch_count * (1 << mc->switch_offset_bits);
 
     // Determine the hex width needed for jump addresses (jadr)
     // Use mc->max_jadr_val for this, as it's the maximum possible jump target
-    int jadr_bit_width = calculate_bit_width(mc->max_jadr_val);
-    int hex_width = (jadr_bit_width + 3) / 4;
-    if (hex_width == 0) hex_width = 1; // Ensure at least 1 hex digit
-
-    char format_str[16];
-    snprintf(format_str, sizeof(format_str), "%%0%dx\n", hex_width);
+    int hex_width = switchdata_hex_width(mc);
 
     // Iterate through the populated mc->switchmem and write to file
+    OutputBuffer out = {.file = file};
     for (int i = 0; i < total_switchmem_size; i++) {
-        fprintf(file, format_str, mc->switchmem[i]);
+        uint64_t entry = mc->switchmem[i];
+        output_hex_words(&out, &entry, 1, hex_width);
     }
+    output_flush(&out);
+}
 
-    fclose(file);
-    printf("Generated switch data memory file: %s (width: %d hex digits)\n", filename, hex_width);
+void generate_switchdata_mem_file(CompactMicrocode* mc, const char* filename) {
+    FILE* file = create_output_file(filename, "w", "file");
+    if (!file) return;
+    write_switchdata_mem(mc, file);
+    if (!output_file_close(file, filename)) return;
+    printf("Generated switch data memory file: %s (width: %d hex digits)\n", filename, switchdata_hex_width(mc));
 }
 
 
-//TODO: this needs to be filled in with actual vardata
-//TODO: actuall vadata needs to be created somewhere
-void generate_vardata_mem_file(CompactMicrocode* mc, const char* filename) {
-    FILE* file = fopen(filename, "w");
-    if (!file) {
-        fprintf(stderr, "Error: Cannot create file '%s'\n", filename);
-        return;
+// Reads vardata entries in order, expanding one block of the LUT at a
+// time from where it comes from (vardata_block) so the whole table never
+// has to be in memory. A reader without blocks reads all zeros.
+typedef struct {
+    const CompactMicrocode* mc;
+    uint8_t* block;   // Entries of block `current`
+    int block_size;
+    int current;      // -1 until the first block is expanded
+} VardataReader;
+
+static VardataReader vardata_reader(const CompactMicrocode* mc) {
+    VardataReader reader = {NULL, NULL, 0, -1};
+    if (mc && mc->vardata_blocks && mc->vardata_lut_size > 0) {
+        reader.block_size = 1 << mc->vardata_inputs;
+        reader.block = malloc(reader.block_size);
+        if (!reader.block) {
+            fprintf(stderr, "Error: Failed to allocate vardata block.\n");
+            exit(EXIT_FAILURE);
+        }
+        reader.mc = mc;
     }
-    
-    if (!mc->vardata_lut || mc->vardata_lut_size == 0) {
+    return reader;
+}
+
+static uint8_t vardata_entry(VardataReader* reader, int entry) {
+    if (!reader->mc || entry >= reader->mc->vardata_lut_size) return 0;
+    int block = entry / reader->block_size;
+    if (block != reader->current) {
+        vardata_block(reader->mc, block, reader->block);
+        reader->current = block;
+    }
+    return reader->block[entry % reader->block_size];
+}
+
+// Bit-packed vardata (--vardata-bits, --vardata-sparse): word w holds LUT
+// entries w*bits .. w*bits+bits-1, the first in the least significant bit,
+// matching the {varSel, variable} addressing in variable.sv; a comment line
+// names the width for readers other than $readmem. A sparse file
+// replaces runs of zero words with a $readmem "@address" line wherever that
+// is shorter; variable.sv clears the memory before reading it. The last
+// word is always written so the file spans the whole LUT.
+static uint64_t vardata_word(VardataReader* reader, int entries, int bits, int word) {
+    uint64_t value = 0;
+    int first = word * bits;
+    for (int b = 0; b < bits && first + b < entries; b++) {
+        if (vardata_entry(reader, first + b)) value |= 1ULL << b;
+    }
+    return value;
+}
+
+static void write_packed_vardata(VardataReader* reader, int entries, FILE* file) {
+    int bits = vardata_word_bits;
+    int word_count = (entries + bits - 1) / bits;
+    int hex_width = (bits + 3) / 4;
+
+    OutputBuffer out = {.file = file};
+    if (bits > 1) {
+        char header[32];
+        int length = snprintf(header, sizeof(header), "// VARDATA_WORD_BITS = %d\n", bits);
+        if (output_reserve(&out, length)) {
+            memcpy(out.data + out.length, header, length);
+            out.length += length;
+        }
+    }
+    for (int w = 0; w < word_count; ) {
+        if (sparse_vardata) {
+            int run = 0;
+            while (w + run < word_count - 1 && vardata_word(reader, entries, bits, w + run) == 0) {
+                run++;
+            }
+            int address_digits = 1;
+            for (int a = (w + run) >> 4; a; a >>= 4) address_digits++;
+            if ((long)run * (hex_width + 1) > address_digits + 2) {
+                w += run;
+                uint64_t address = (uint64_t)w;
+                if (output_reserve(&out, 1)) out.data[out.length++] = '@';
+                output_hex_words(&out, &address, 1, 1);
+                continue;
+            }
+        }
+        uint64_t value = vardata_word(reader, entries, bits, w);
+        output_hex_words(&out, &value, 1, hex_width);
+        w++;
+    }
+    output_flush(&out);
+}
+
+void write_vardata_mem(CompactMicrocode* mc, FILE* file) {
+    if (!mc->vardata_blocks || mc->vardata_lut_size == 0) {
         fprintf(stderr, "Warning: No vardata_lut to write or LUT is empty. Writing zeros.\n");
         // Fallback to writing zeros if LUT is empty, matching previous behavior
         int total_vardata_entries;
@@ -375,22 +694,383 @@ void generate_vardata_mem_file(CompactMicrocode* mc, const char* filename) {
         } else {
             total_vardata_entries = mc->hw_ctx->input_count * (1 << mc->hw_ctx->input_count);
         }
+        if (vardata_word_bits > 1 || sparse_vardata) {
+            VardataReader zeros = vardata_reader(NULL);
+            write_packed_vardata(&zeros, total_vardata_entries, file);
+            return;
+        }
+        OutputBuffer out = {.file = file};
         for (int i = 0; i < total_vardata_entries; i++) {
-            fprintf(file, "%x\n", 0);
+            output_decimal_line(&out, 0);
         }
+        output_flush(&out);
+    } else if (vardata_word_bits > 1 || sparse_vardata) {
+        print_debug("DEBUG: Packing %d vardata_lut entries into %d-bit words\n",
+                    mc->vardata_lut_size, vardata_word_bits);
+        VardataReader reader = vardata_reader(mc);
+        write_packed_vardata(&reader, mc->vardata_lut_size, file);
+        free(reader.block);
     } else {
-        print_debug("DEBUG: Writing %d entries from vardata_lut to %s\n", mc->vardata_lut_size, filename);
+        print_debug("DEBUG: Writing %d entries from vardata_lut\n", mc->vardata_lut_size);
+        VardataReader reader = vardata_reader(mc);
+        OutputBuffer out = {.file = file};
         for (int i = 0; i < mc->vardata_lut_size; i++) {
-            fprintf(file, "%d\n", mc->vardata_lut[i]); // Write actual LUT values
+            output_decimal_line(&out, vardata_entry(&reader, i)); // Write actual LUT values
         }
+        output_flush(&out);
+        free(reader.block);
     }
-    
-    fclose(file);
+}
+
+void generate_vardata_mem_file(CompactMicrocode* mc, const char* filename) {
+    FILE* file = create_output_file(filename, "w", "file");
+    if (!file) return;
+    write_vardata_mem(mc, file);
+    if (!output_file_close(file, filename)) return;
     printf("Generated variable data file: %s\n", filename);
 }
 
+void write_varsel_logic(CompactMicrocode* mc, const char* base_name, FILE* file) {
+    int widths[MCODE_FIELD_COUNT];
+    param_field_widths(mc, widths);
+    int input_count = mc->hw_ctx->input_count;
+
+    fprintf(file, "// Auto-generated by c_parser --varsel-logic for %s\n", base_name);
+    fprintf(file, "// The conditions left out of %s_vardata.mem's ROM: varSel VARSEL_ROM_BLOCKS\n", base_name);
+    fprintf(file, "// and up, as sums of products of the inputs. Instantiate hotstate with\n");
+    fprintf(file, "// .NUM_VARSEL(VARSEL_ROM_BLOCKS) and .VARSEL_LOGIC(1), and connect its\n");
+    fprintf(file, "// logic_var_sel and logic_lhs ports to varSel and lhs here.\n\n");
+    fprintf(file, "`timescale 10ns / 1ns\n\n");
+    fprintf(file, "module %s_varsel_logic #(\n", base_name);
+    fprintf(file, "    parameter NUM_VARS = %d,\n", input_count);
+    fprintf(file, "    parameter NUM_VARSEL_BITS = %d\n", widths[3]);
+    fprintf(file, ")(\n");
+    fprintf(file, "    input [NUM_VARS-1:0] variable,\n");
+    fprintf(file, "    input [NUM_VARSEL_BITS-1:0] varSel,\n");
+    fprintf(file, "    output reg lhs\n");
+    fprintf(file, ");\n\n");
+    for (int i = 0; i < input_count; i++) {
+        fprintf(file, "// variable[%d]: %s\n", i, mc->hw_ctx->inputs[i].name);
+    }
+    fprintf(file, "\nalways @(*) begin\n");
+    fprintf(file, "    case (varSel)\n");
+    for (int v = 0; v < mc->varsel_logic_count; v++) {
+        const VarselLogic* sop = &mc->varsel_logic[v];
+        fprintf(file, "    %d: lhs = ", mc->varsel_rom_blocks + v);
+        if (sop->term_count == 0) {
+            fprintf(file, "1'b0");
+        }
+        for (int t = 0; t < sop->term_count; t++) {
+            const ProductTerm* term = &sop->terms[t];
+            if (t > 0) fprintf(file, " | ");
+            if (term->care == 0) {
+                fprintf(file, "1'b1");
+                continue;
+            }
+            bool product = sop->term_count > 1 && (term->care & (term->care - 1));
+            if (product) fprintf(file, "(");
+            bool first = true;
+            for (int b = 0; b < input_count; b++) {
+                if (!(term->care & (1u << b))) continue;
+                fprintf(file, "%s%svariable[%d]", first ? "" : " & ", (term->value & (1u << b)) ? "" : "~", b);
+                first = false;
+            }
+            if (product) fprintf(file, ")");
+        }
+        fprintf(file, ";\n");
+    }
+    fprintf(file, "    default: lhs = 1'b0;\n");
+    fprintf(file, "    endcase\n");
+    fprintf(file, "end\n\n");
+    fprintf(file, "endmodule\n");
+}
+
+static void generate_varsel_logic_file(CompactMicrocode* mc, const char* base_name, const char* filename) {
+    FILE* file = create_output_file(filename, "w", "file");
+    if (!file) return;
+    write_varsel_logic(mc, base_name, file);
+    if (!output_file_close(file, filename)) return;
+    printf("Generated varsel logic module: %s\n", filename);
+}
+
+static void store_u32(uint8_t* p, uint32_t value) {
+    for (int shift = 0; shift < 32; shift += 8) {
+        *p++ = (uint8_t)(value >> shift);
+    }
+}
+
+static void store_u64(uint8_t* p, uint64_t value) {
+    for (int shift = 0; shift < 64; shift += 8) {
+        *p++ = (uint8_t)(value >> shift);
+    }
+}
+
+static uint32_t align_image_offset(uint32_t offset) {
+    return (offset + 7) & ~7u;
+}
+
+// Appends size zero bytes, returning them; NULL once out of memory
+static uint8_t* output_bytes(OutputBuffer* out, size_t size) {
+    if (!output_reserve(out, size)) return NULL;
+    uint8_t* p = (uint8_t*)out->data + out->length;
+    memset(p, 0, size);
+    out->length += size;
+    return p;
+}
+
+static void output_u32(OutputBuffer* out, uint32_t value) {
+    uint8_t* p = output_bytes(out, 4);
+    if (p) store_u32(p, value);
+}
+
+static void output_u64(OutputBuffer* out, uint64_t value) {
+    uint8_t* p = output_bytes(out, 8);
+    if (p) store_u64(p, value);
+}
+
+// Writes the same data as the .vh and .mem files in one binary image; the
+// layout is described with HOTSTATE_IMAGE_MAGIC in cfg_to_microcode.h
+void write_image(CompactMicrocode* mc, FILE* file) {
+    // vardata: the LUT, or the zero fill generate_vardata_mem_file writes
+    VardataReader reader = vardata_reader(mc);
+    uint32_t vardata_count;
+    if (reader.mc) {
+        vardata_count = (uint32_t)mc->vardata_lut_size;
+    } else if (mc->hw_ctx->input_count == 0) {
+        vardata_count = 1;
+    } else {
+        vardata_count = (uint32_t)(mc->hw_ctx->input_count * (1 << mc->hw_ctx->input_count));
+    }
+    uint32_t switchdata_count = (uint32_t)(mc->switch_count * (1 << mc->switch_offset_bits));
+    int widths[MCODE_FIELD_COUNT];
+    uint32_t smdata_words = (uint32_t)(packed_field_widths(mc, widths) + 63) / 64;
+    uint32_t smdata_count = (uint32_t)mc->instruction_count * smdata_words;
+
+    // Only the widths, the state count and the stack depth are known here, as
+    // in the .vh; the simulator derives the remaining parameters from them
+    uint32_t params[HOTSTATE_IMAGE_PIPELINED + 1] = {0};
+    uint32_t param_count = HOTSTATE_IMAGE_PARAM_COUNT;
+    int param_widths[MCODE_FIELD_COUNT];
+    param_field_widths(mc, param_widths);
+    for (int i = 0; i < MCODE_FIELD_COUNT; i++) {
+        params[i] = (uint32_t)param_widths[i];
+        params[MCODE_FIELD_COUNT] += params[i]; // INSTR_WIDTH
+    }
+    params[MCODE_FIELD_COUNT + 1] = (uint32_t)mc->hw_ctx->state_count; // NUM_STATES
+    params[HOTSTATE_IMAGE_NUM_VARS] = (uint32_t)mc->hw_ctx->input_count;
+    params[HOTSTATE_IMAGE_STACK_DEPTH] = (uint32_t)mc->stack_depth;
+    params[HOTSTATE_IMAGE_SMDATA_WORDS] = smdata_words;
+    if (mc->interrupt_vector_count > 0) {
+        params[HOTSTATE_IMAGE_INTERRUPT_ADDRESS] = (uint32_t)mc->interrupt_vectors[0].address;
+        param_count = HOTSTATE_IMAGE_INTERRUPT_ADDRESS + 1;
+    }
+    if (mc->pipelined) {
+        params[HOTSTATE_IMAGE_PIPELINED] = 1;
+        param_count = HOTSTATE_IMAGE_PIPELINED + 1;
+    }
+
+    uint32_t vardata_offset = align_image_offset(HOTSTATE_IMAGE_HEADER_SIZE + 4 * param_count);
+    uint32_t switchdata_offset = align_image_offset(vardata_offset + 4 * vardata_count);
+    uint32_t smdata_offset = align_image_offset(switchdata_offset + 4 * switchdata_count);
+
+    // Every offset is known, so the sections go out in order, each padded
+    // with zeros up to the next, a chunk at a time
+    OutputBuffer out = {.file = file};
+    uint8_t* magic = output_bytes(&out, 8);
+    if (magic) memcpy(magic, HOTSTATE_IMAGE_MAGIC, 8);
+    uint32_t header[8] = {
+        HOTSTATE_IMAGE_VERSION, param_count,
+        vardata_offset, vardata_count,
+        switchdata_offset, switchdata_count,
+        smdata_offset, smdata_count
+    };
+    for (int i = 0; i < 8; i++) {
+        output_u32(&out, header[i]);
+    }
+    for (uint32_t i = 0; i < param_count; i++) {
+        output_u32(&out, params[i]);
+    }
+
+    output_bytes(&out, vardata_offset - (HOTSTATE_IMAGE_HEADER_SIZE + 4 * param_count));
+    for (uint32_t i = 0; i < vardata_count; i++) {
+        output_u32(&out, vardata_entry(&reader, (int)i));
+    }
+    free(reader.block);
+    output_bytes(&out, switchdata_offset - (vardata_offset + 4 * vardata_count));
+    for (uint32_t i = 0; i < switchdata_count; i++) {
+        output_u32(&out, mc->switchmem[i]);
+    }
+    output_bytes(&out, smdata_offset - (switchdata_offset + 4 * switchdata_count));
+
+    uint64_t packed_instruction[MCODE_MAX_WORDS];
+    for (int i = 0; i < mc->instruction_count; i++) {
+        pack_mcode_instruction(&mc->instructions[i].uword.mcode, widths, packed_instruction);
+        for (uint32_t w = 0; w < smdata_words; w++) {
+            output_u64(&out, packed_instruction[w]);
+        }
+    }
+    output_flush(&out);
+}
+
+void generate_image_file(CompactMicrocode* mc, const char* filename) {
+    FILE* file = create_output_file(filename, "wb", "file");
+    if (!file) return;
+    write_image(mc, file);
+    if (!output_file_close(file, filename)) return;
+    printf("Generated memory image file: %s\n", filename);
+}
+
 // --- Debug Output ---
 
+static int compare_uint32(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+// Report how well the packed word uses its bits: per field, the width it
+// is given, the width its largest value needs, how many words set it and
+// how many distinct values it takes. Sparse multi-bit fields that are never
+// set in the same word could share one encoded slot (vertical encoding);
+// that needs a decoder in IP/microcode.sv, so it is reported, not emitted.
+void print_microcode_encoding_analysis(CompactMicrocode* mc, FILE* output) {
+    int widths[MCODE_FIELD_COUNT];
+    int narrow_widths[MCODE_FIELD_COUNT];
+    uint32_t maxima[MCODE_FIELD_COUNT];
+    int packed_width = packed_field_widths(mc, widths);
+    int saved_mode = narrow_microcode_fields;
+    narrow_microcode_fields = 1;
+    int narrow_width = packed_field_widths(mc, narrow_widths);
+    narrow_microcode_fields = saved_mode;
+    mcode_field_maxima(mc, maxima);
+
+    int words = mc->instruction_count;
+    fprintf(output, "\n=== Microcode Encoding Analysis ===\n");
+    fprintf(output, "Words: %d\n", words);
+    fprintf(output, "Word width: %d bits (%d with --narrow-fields)\n", packed_width, narrow_width);
+    fprintf(output, "ROM bits: %d (%d with --narrow-fields)\n", packed_width * words, narrow_width * words);
+
+    uint32_t* values = words > 0 ? malloc(sizeof(uint32_t) * words) : NULL;
+    int used[MCODE_FIELD_COUNT];
+    fprintf(output, "\n%-14s %5s %6s %6s %8s\n", "Field", "Width", "Needed", "Used", "Distinct");
+    for (int f = 0; f < MCODE_FIELD_COUNT; f++) {
+        used[f] = 0;
+        for (int i = 0; i < words; i++) {
+            values[i] = mcode_field(&mc->instructions[i].uword.mcode, f);
+            if (values[i] != 0) {
+                used[f]++;
+            }
+        }
+        int distinct = 0;
+        if (words > 0) {
+            qsort(values, words, sizeof(uint32_t), compare_uint32);
+            distinct = 1;
+            for (int i = 1; i < words; i++) {
+                if (values[i] != values[i - 1]) {
+                    distinct++;
+                }
+            }
+        }
+        int needed = value_bit_width(maxima[f]);
+        fprintf(output, "%-14s %5d %6d %6d %8d\n", MCODE_FIELD_NAMES[f], widths[f], needed, used[f], distinct);
+    }
+    free(values);
+
+    fprintf(output, "\nUnused fields:");
+    int unused = 0;
+    for (int f = 0; f < MCODE_FIELD_COUNT; f++) {
+        if (used[f] == 0) {
+            fprintf(output, " %s(%d)", MCODE_FIELD_NAMES[f], widths[f]);
+            unused++;
+        }
+    }
+    fprintf(output, unused ? "\n" : " none\n");
+
+    // Vertical-encoding candidates: sparse multi-bit fields (state and
+    // mask excluded) that no word sets together
+    int candidates[MCODE_FIELD_COUNT];
+    int candidate_count = 0;
+    for (int f = 2; f < MCODE_FIRST_FLAG_FIELD; f++) {
+        if (used[f] > 0 && widths[f] > 1 && used[f] * 8 <= words) {
+            candidates[candidate_count++] = f;
+        }
+    }
+    int exclusive = candidate_count > 1;
+    for (int i = 0; i < words && exclusive; i++) {
+        int set = 0;
+        for (int c = 0; c < candidate_count; c++) {
+            if (mcode_field(&mc->instructions[i].uword.mcode, candidates[c]) != 0) {
+                set++;
+            }
+        }
+        exclusive = set <= 1;
+    }
+    if (exclusive) {
+        int separate = 0;
+        int widest = 0;
+        fprintf(output, "Vertical encoding candidates:");
+        for (int c = 0; c < candidate_count; c++) {
+            int w = narrow_widths[candidates[c]];
+            fprintf(output, " %s", MCODE_FIELD_NAMES[candidates[c]]);
+            separate += w;
+            if (w > widest) {
+                widest = w;
+            }
+        }
+        int tag_bits = calculate_bit_width(candidate_count);
+        int saving = separate - (widest + tag_bits);
+        fprintf(output, "\n  one %d-bit slot plus %d-bit tag would save %d bits/word (needs a decoder in microcode.sv)\n",
+                widest, tag_bits, saving > 0 ? saving : 0);
+    } else {
+        fprintf(output, "Vertical encoding candidates: none\n");
+    }
+}
+
+// Up to this many arms a chain of tests reaches every arm within a cycle
+// of the jump table, and the table's switch memory buys nothing
+#define DISPATCH_CHAIN_MAX_ARMS 2
+
+// Prices each multi-way branch both ways. A chain of n tests is one branch
+// word per test, a jump out of each arm but the last (or every arm, with a
+// default), and reaches arm k on the k-th cycle; a jump table is one switch
+// word and a block of switch memory and reaches any arm in one cycle.
+void print_dispatch_cost_analysis(CompactMicrocode* mc, FILE* output) {
+    int table_entries = 1 << mc->switch_offset_bits;
+    fprintf(output, "\n=== Dispatch Cost Analysis ===\n");
+    fprintf(output, "Switch memory per table: %d entries (--switch-bits %d)\n", table_entries, mc->switch_offset_bits);
+    if (mc->dispatch_site_count == 0) {
+        fprintf(output, "No switches or else-if ladders\n");
+        return;
+    }
+
+    int switch_to_chain = 0;
+    int ladder_to_table = 0;
+    fprintf(output, "\n%-24s %4s %11s %11s %9s %13s  %s\n",
+            "Site", "Arms", "Chain worst", "Chain words", "Table cyc", "Table entries", "Cheaper");
+    for (int i = 0; i < mc->dispatch_site_count; i++) {
+        const DispatchSite* site = &mc->dispatch_sites[i];
+        int n = site->arms;
+        int chain_words = n + (site->has_default ? n : (n > 0 ? n - 1 : 0));
+        bool chain = n <= DISPATCH_CHAIN_MAX_ARMS;
+        if (site->is_switch && chain) {
+            switch_to_chain++;
+        } else if (!site->is_switch && !chain) {
+            ladder_to_table++;
+        }
+        fprintf(output, "%-24.24s %4d %11d %11d %9d %13d  %s%s\n", site->label, n, n, chain_words, 1,
+                table_entries, chain ? "chain" : "table", chain == !site->is_switch ? "" : " *");
+    }
+
+    // Neither rewrite is made here: a table's selector is the switch_offset
+    // port, which the LUT cannot test, and a ladder's tests are LUT lookups
+    // on separate inputs that a table could only select between through an
+    // encoder outside the core
+    if (switch_to_chain > 0 || ladder_to_table > 0) {
+        fprintf(output, "* %d switch(es) would be cheaper as tests on inputs, %d ladder(s) as a switch on an encoded selector\n",
+                switch_to_chain, ladder_to_table);
+    }
+}
+
 void print_microcode_analysis(HotstateMicrocode* mc, FILE* output) {
     fprintf(output, "\n=== Microcode Analysis ===\n");
     fprintf(output, "Function: %s\n", mc->function_name);
@@ -408,13 +1088,13 @@ void print_microcode_analysis(HotstateMicrocode* mc, FILE* output) {
             validate_microcode(mc) ? "PASSED" : "FAILED");
 }
 
-void print_instruction_details(Code* code_entry, FILE* output) {
+void print_instruction_details(Code* code_entry, const char* label, FILE* output) {
     MCode* mcode = &code_entry->uword.mcode;
     
     fprintf(output, "Addr %02x:", code_entry->level); // Using level as address for now
     
-    if (code_entry->label) {
-        fprintf(output, " (%s)", code_entry->label);
+    if (label) {
+        fprintf(output, " (%s)", label);
     }
     
     // Decode instruction fields from MCode struct
@@ -501,11 +1181,11 @@ void debug_print_filepaths(const char* source_filename) {
     char* switchdata_filepath = generate_output_filepath(source_filename, "_switchdata.mem");
     char* symbol_filepath = generate_output_filepath(source_filename, "_symbols.txt");
 
-    printf("Debug: smdata_filepath = %s\n", smdata_filepath);
-    printf("Debug: vardata_filepath = %s\n", vardata_filepath);
-    printf("Debug: params_filepath = %s\n", params_filepath);
-    printf("Debug: switchdata_filepath = %s\n", switchdata_filepath);
-    printf("Debug: symbol_filepath = %s\n", symbol_filepath);
+    print_debug("Debug: smdata_filepath = %s\n", smdata_filepath);
+    print_debug("Debug: vardata_filepath = %s\n", vardata_filepath);
+    print_debug("Debug: params_filepath = %s\n", params_filepath);
+    print_debug("Debug: switchdata_filepath = %s\n", switchdata_filepath);
+    print_debug("Debug: symbol_filepath = %s\n", symbol_filepath);
 
     free(smdata_filepath);
     free(vardata_filepath);
@@ -522,14 +1202,17 @@ void generate_all_output_files(CompactMicrocode* mc, const char* source_filename
     char* params_filepath = generate_output_filepath(source_filename, "_params.vh");
     char* switchdata_filepath = generate_output_filepath(source_filename, "_switchdata.mem");
     char* symbol_filepath = generate_output_filepath(source_filename, "_symbols.toml"); // New
+    char* image_filepath = generate_output_filepath(source_filename, "_image.bin");
 
-    if (!smdata_filepath || !vardata_filepath || !params_filepath || !switchdata_filepath || !symbol_filepath) { // Updated condition
+    if (!smdata_filepath || !vardata_filepath || !params_filepath || !switchdata_filepath || !symbol_filepath ||
+        !image_filepath) {
         // Handle allocation errors, already printed inside generate_output_filepath
         free(smdata_filepath);
         free(vardata_filepath);
         free(params_filepath);
         free(switchdata_filepath);
         free(symbol_filepath); // Free new path
+        free(image_filepath);
         return;
     }
 
@@ -541,10 +1224,30 @@ void generate_all_output_files(CompactMicrocode* mc, const char* source_filename
     generate_vardata_mem_file(mc, vardata_filepath);
     generate_switchdata_mem_file(mc, switchdata_filepath);
     generate_symbol_table_file(mc, symbol_filepath); // Generate symbol table
+    generate_image_file(mc, image_filepath);
+    if (mc->timdata_count > 0) {
+        char* timdata_filepath = generate_output_filepath(source_filename, "_timdata.mem");
+        if (timdata_filepath) {
+            generate_timdata_mem_file(mc, timdata_filepath);
+        }
+        free(timdata_filepath);
+    }
+    if (mc->varsel_logic_count > 0) {
+        char* logic_filepath = generate_output_filepath(source_filename, "_varsel_logic.v");
+        char* base_path = generate_output_filepath(source_filename, "");
+        if (logic_filepath && base_path) {
+            // The module is named like the file, without its directory
+            const char* slash = strrchr(base_path, '/');
+            generate_varsel_logic_file(mc, slash ? slash + 1 : base_path, logic_filepath);
+        }
+        free(logic_filepath);
+        free(base_path);
+    }
 
     free(smdata_filepath);
     free(vardata_filepath);
     free(params_filepath);
     free(switchdata_filepath);
     free(symbol_filepath); // Free new path
+    free(image_filepath);
 }
\ No newline at end of file
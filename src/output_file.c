@@ -0,0 +1,62 @@
+#include "output_file.h"
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// The temporary file is per process, so parallel builds of different
+// configurations into one directory do not write over each other's
+static char* temporary_path(const char* path) {
+    size_t length = strlen(path) + 32;
+    char* tmp_path = malloc(length);
+    if (tmp_path) snprintf(tmp_path, length, "%s.tmp.%ld", path, (long)getpid());
+    return tmp_path;
+}
+
+// True if both files exist and hold the same bytes
+static bool same_contents(const char* path_a, const char* path_b) {
+    struct stat st_a, st_b;
+    if (stat(path_a, &st_a) != 0 || stat(path_b, &st_b) != 0 || st_a.st_size != st_b.st_size) {
+        return false;
+    }
+    FILE* a = fopen(path_a, "rb");
+    FILE* b = fopen(path_b, "rb");
+    bool same = a && b;
+    char buf_a[65536], buf_b[65536];
+    while (same) {
+        size_t n = fread(buf_a, 1, sizeof(buf_a), a);
+        if (fread(buf_b, 1, sizeof(buf_b), b) != n || memcmp(buf_a, buf_b, n) != 0) {
+            same = false;
+        }
+        if (n < sizeof(buf_a)) break;
+    }
+    if (a && ferror(a)) same = false;
+    if (b && ferror(b)) same = false;
+    if (a) fclose(a);
+    if (b) fclose(b);
+    return same;
+}
+
+FILE* output_file_open(const char* path, const char* mode) {
+    char* tmp_path = temporary_path(path);
+    FILE* file = tmp_path ? fopen(tmp_path, mode) : NULL;
+    free(tmp_path);
+    return file;
+}
+
+bool output_file_close(FILE* file, const char* path) {
+    char* tmp_path = temporary_path(path);
+    bool ok = !ferror(file);
+    ok = fclose(file) == 0 && ok && tmp_path;
+    if (ok && same_contents(tmp_path, path)) {
+        unlink(tmp_path);
+    } else if (ok) {
+        ok = rename(tmp_path, path) == 0;
+    }
+    if (!ok) {
+        fprintf(stderr, "Error: Failed writing file '%s'\n", path);
+        if (tmp_path) unlink(tmp_path);
+    }
+    free(tmp_path);
+    return ok;
+}
@@ -0,0 +1,20 @@
+#ifndef OUTPUT_FILE_H
+#define OUTPUT_FILE_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+// Write-if-changed output files. A generated file is written to a
+// temporary file next to it and only renamed over it when the contents
+// differ, so a file that comes out the same keeps its timestamp and the
+// Verilator and synthesis steps that depend on it are not rerun.
+
+// Opens the temporary file for path; NULL if it cannot be created
+FILE* output_file_open(const char* path, const char* mode);
+
+// Closes a file from output_file_open and replaces path with it unless
+// path already holds the same bytes. If a write to the file failed, path is
+// left as it was; false (with an error printed) if writing failed
+bool output_file_close(FILE* file, const char* path);
+
+#endif // OUTPUT_FILE_H
@@ -1,5 +1,6 @@
 #define _GNU_SOURCE  // For strdup
 #include "parser.h"
+#include "precompiled_header.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -26,15 +27,7 @@ static Node* parse_goto_statement(Parser* p);
 static Node* parse_expression(Parser* p);
 static Node* parse_comma_expression(Parser* p);
 static Node* parse_assignment(Parser* p);
-static Node* parse_logical_or(Parser* p);
-static Node* parse_logical_and(Parser* p);
-static Node* parse_bitwise_or(Parser* p);
-static Node* parse_bitwise_xor(Parser* p);
-static Node* parse_bitwise_and(Parser* p);
-static Node* parse_equality(Parser* p);
-static Node* parse_relational(Parser* p);
-static Node* parse_additive(Parser* p);
-static Node* parse_multiplicative(Parser* p);
+static Node* parse_binary(Parser* p, int min_precedence);
 static Node* parse_unary(Parser* p);
 static Node* parse_postfix(Parser* p);
 static Node* parse_primary(Parser* p);
@@ -57,18 +50,31 @@ static void debug_print_node(Node* node, const char* context) {
 
 // --- Helper Functions ---
 
+jmp_buf* parser_error_jump = NULL;
+
+// Parse errors are fatal to the compilation: back to the caller's recovery
+// point if there is one, otherwise out of the process
+static void parser_abort(void) {
+    if (parser_error_jump) {
+        longjmp(*parser_error_jump, 1);
+    }
+    exit(1);
+}
+
 static void parser_error(const char* message) {
     fprintf(stderr, "Parse Error: %s\n", message);
-    exit(1);
+    parser_abort();
 }
 
 static Token current_token(Parser* p) { return p->tokens[p->pos]; }
 
 static void parser_error_at_token(Parser* p, const char* message) {
     Token token = current_token(p);
-    fprintf(stderr, "Parse Error at line %d, column %d: %s\n", token.line, token.column, message);
+    int line, column;
+    token_position(p->source, &token, &line, &column);
+    fprintf(stderr, "Parse Error at line %d, column %d: %s\n", line, column, message);
     fprintf(stderr, "  Token: %s ('%s')\n", token_type_to_string(token.type), token.value);
-    exit(1);
+    parser_abort();
 }
 static Token peek_token(Parser* p) {
     if (p->pos + 1 < p->count) {
@@ -92,27 +98,45 @@ static Token expect(Parser* p, TokenType type, const char* msg) {
         advance(p);
         return token;
     }
-    fprintf(stderr, "Parse Error at line %d, column %d: %s\n", token.line, token.column, msg);
+    int line, column;
+    token_position(p->source, &token, &line, &column);
+    fprintf(stderr, "Parse Error at line %d, column %d: %s\n", line, column, msg);
     fprintf(stderr, "  Expected: %s, but got %s ('%s')\n",
             token_type_to_string(type), token_type_to_string(token.type), token.value);
-    exit(1);
+    parser_abort();
+    return token; // Not reached
 }
 
 // --- Expression Parsing Logic ---
-// This chain of functions implements operator precedence.
-// Each function handles one level of precedence and calls the next higher level.
-
-
-
-
-
-static Node* parse_multiplicative(Parser* p) {
+// Binary operators are parsed by precedence climbing over the table below;
+// comma and assignment sit above it, unary/postfix/primary below it.
+
+// Binding strength of each binary operator (0 = not a binary operator).
+// All are left-associative. Adding an operator is adding an entry here.
+static const unsigned char binary_precedence[TOKEN_ILLEGAL + 1] = {
+    [TOKEN_LOGICAL_OR] = 1,
+    [TOKEN_LOGICAL_AND] = 2,
+    [TOKEN_OR] = 3,
+    [TOKEN_AND] = 4,
+    [TOKEN_EQUAL] = 5, [TOKEN_NOT_EQUAL] = 5,
+    [TOKEN_LESS] = 6, [TOKEN_LESS_EQUAL] = 6, [TOKEN_GREATER] = 6, [TOKEN_GREATER_EQUAL] = 6,
+    [TOKEN_PLUS] = 7, [TOKEN_MINUS] = 7,
+    [TOKEN_STAR] = 8, [TOKEN_SLASH] = 8,
+};
+
+// Parse operators binding at least as tightly as min_precedence. Recursion
+// happens only when precedence rises, so a long chain like a && b && c
+// stays at constant depth instead of descending through every level.
+static Node* parse_binary(Parser* p, int min_precedence) {
     Node* node = parse_unary(p);
-    while (current_token(p).type == TOKEN_STAR || current_token(p).type == TOKEN_SLASH) {
-        // Get the operator type BEFORE advancing.
+    while (1) {
         TokenType op = current_token(p).type;
-        advance(p); // Manually advance instead of using match()
-        Node* right = parse_unary(p);
+        int precedence = binary_precedence[op];
+        if (precedence == 0 || precedence < min_precedence) {
+            break;
+        }
+        advance(p);
+        Node* right = parse_binary(p, precedence + 1);
         node = create_binary_op_node(op, node, right);
     }
     return node;
@@ -153,11 +177,10 @@ static Node* parse_postfix(Parser* p) {
             
             // Extract function name from identifier node
             IdentifierNode* id_node = (IdentifierNode*)node;
-            node = create_function_call_node(strdup(id_node->name), args);
+            node = create_function_call_node(ast_strdup(id_node->name), args);
             
-            // Free the original identifier node
-            free(id_node->name);
-            free(id_node);
+            // Free the original identifier node (no-op when arena-allocated)
+            free_node((Node*)id_node);
         } else {
             break;
         }
@@ -168,7 +191,7 @@ static Node* parse_postfix(Parser* p) {
 
 static Node* parse_primary(Parser* p) {
     if (current_token(p).type == TOKEN_NUMBER) {
-        char* value = strdup(current_token(p).value);
+        char* value = ast_strdup(current_token(p).value);
         if (!value) {
             parser_error("Memory allocation failed for number literal");
         }
@@ -179,7 +202,7 @@ static Node* parse_primary(Parser* p) {
     }
     
     if (current_token(p).type == TOKEN_IDENTIFIER) {
-        char* value = strdup(current_token(p).value);
+        char* value = ast_strdup(current_token(p).value);
         if (!value) {
             parser_error("Memory allocation failed for identifier");
         }
@@ -234,93 +257,6 @@ static Node* parse_initializer_list(Parser* p) {
     return create_initializer_list_node(elements);
 }
 
-static Node* parse_additive(Parser* p) {
-    Node* node = parse_multiplicative(p);
-    while (current_token(p).type == TOKEN_PLUS || current_token(p).type == TOKEN_MINUS) {
-        TokenType op = current_token(p).type;
-        advance(p);
-        Node* right = parse_multiplicative(p);
-        node = create_binary_op_node(op, node, right);
-    }
-    return node;
-}
-
-
-static Node* parse_relational(Parser* p) {
-    Node* node = parse_additive(p);
-     while (current_token(p).type == TOKEN_LESS || current_token(p).type == TOKEN_LESS_EQUAL || current_token(p).type == TOKEN_GREATER || current_token(p).type == TOKEN_GREATER_EQUAL) {
-        TokenType op = current_token(p).type;
-        advance(p);
-        Node* right = parse_additive(p);
-        node = create_binary_op_node(op, node, right);
-    }
-    return node;
-}
-
-
-static Node* parse_equality(Parser* p) {
-    Node* node = parse_relational(p);
-    while (current_token(p).type == TOKEN_EQUAL || current_token(p).type == TOKEN_NOT_EQUAL) {
-        TokenType op = current_token(p).type;
-        advance(p);
-        Node* right = parse_relational(p);
-        node = create_binary_op_node(op, node, right);
-    }
-    return node;
-}
-
-
-
-
-static Node* parse_logical_and(Parser* p) {
-    Node* node = parse_bitwise_or(p);
-    while (current_token(p).type == TOKEN_LOGICAL_AND) {
-        TokenType op = current_token(p).type;
-        advance(p);
-        Node* right = parse_bitwise_or(p);
-        node = create_binary_op_node(op, node, right);
-    }
-    return node;
-}
-
-static Node* parse_logical_or(Parser* p) {
-    Node* node = parse_logical_and(p);
-    while (current_token(p).type == TOKEN_LOGICAL_OR) {
-        TokenType op = current_token(p).type;
-        advance(p);
-        Node* right = parse_logical_and(p);
-        node = create_binary_op_node(op, node, right);
-    }
-    return node;
-}
-
-static Node* parse_bitwise_or(Parser* p) {
-    Node* node = parse_bitwise_xor(p);
-    while (current_token(p).type == TOKEN_OR) {
-        TokenType op = current_token(p).type;
-        advance(p);
-        Node* right = parse_bitwise_xor(p);
-        node = create_binary_op_node(op, node, right);
-    }
-    return node;
-}
-
-static Node* parse_bitwise_xor(Parser* p) {
-    // XOR not implemented yet, skip to bitwise AND
-    return parse_bitwise_and(p);
-}
-
-static Node* parse_bitwise_and(Parser* p) {
-    Node* node = parse_equality(p);
-    while (current_token(p).type == TOKEN_AND) {
-        TokenType op = current_token(p).type;
-        advance(p);
-        Node* right = parse_equality(p);
-        node = create_binary_op_node(op, node, right);
-    }
-    return node;
-}
-
 static Node* parse_expression(Parser* p) {
     return parse_comma_expression(p);
 }
@@ -339,7 +275,7 @@ static Node* parse_comma_expression(Parser* p) {
 }
 
 static Node* parse_assignment(Parser* p) {
-    Node* left = parse_logical_or(p);
+    Node* left = parse_binary(p, 1);
     
     if (current_token(p).type == TOKEN_ASSIGN) {
         advance(p);
@@ -442,7 +378,7 @@ static Node* parse_declaration_statement(Parser* p) {
     }
     
     // Create first variable declaration
-    Node* first_decl = create_var_decl_node(var_type, is_unsigned, strdup(id_tok.value), array_size, bit_width, initializer);
+    Node* first_decl = create_var_decl_node(var_type, is_unsigned, ast_strdup(id_tok.value), array_size, bit_width, initializer);
     
     // Check for comma-separated additional variables
     if (current_token(p).type == TOKEN_COMMA) {
@@ -471,7 +407,7 @@ static Node* parse_declaration_statement(Parser* p) {
                 }
             }
             
-            Node* next_decl = create_var_decl_node(var_type, is_unsigned, strdup(next_id_tok.value), next_array_size, bit_width, next_initializer);
+            Node* next_decl = create_var_decl_node(var_type, is_unsigned, ast_strdup(next_id_tok.value), next_array_size, bit_width, next_initializer);
             add_node_to_list(block->statements, next_decl);
         }
         
@@ -594,7 +530,7 @@ static Node* parse_statement(Parser* p) {
         advance(p); // Consume Colon
         //Now parse the actual statement the lable is attached to
         Node* statmnt = parse_statement(p);  
-        return create_label_node(strdup(label_tok.value), statmnt);
+        return create_label_node(ast_strdup(label_tok.value), statmnt);
     }
     // Check for declaration: 'int', 'bool', 'char', 'unsigned', or '_BitInt' followed by an identifier
     if ((current_token(p).type == TOKEN_INT || current_token(p).type == TOKEN_BOOL ||
@@ -633,6 +569,10 @@ static Node* parse_statement(Parser* p) {
             expect(p, TOKEN_SEMICOLON, "Expected ';' after return");
             return create_return_node(return_value);
         case TOKEN_LBRACE: return parse_block_statement(p);
+        case TOKEN_SEMICOLON:
+            // The null statement, as in for (...); -- an empty block
+            advance(p);
+            return create_block_node();
         case TOKEN_GOTO: return parse_goto_statement(p);
         
         // Add other statement types like function calls here
@@ -688,7 +628,7 @@ static Node* parse_function_definition(Parser* p) {
             return NULL;
         }
         Token param_tok = expect(p, TOKEN_IDENTIFIER, "Expected parameter name");
-        add_node_to_list(parameters, create_identifier_node(strdup(param_tok.value)));
+        add_node_to_list(parameters, create_identifier_node(ast_strdup(param_tok.value)));
         
         // Additional parameters
         while (match(p, TOKEN_COMMA)) {
@@ -704,20 +644,20 @@ static Node* parse_function_definition(Parser* p) {
                 return NULL;
             }
             param_tok = expect(p, TOKEN_IDENTIFIER, "Expected parameter name");
-            add_node_to_list(parameters, create_identifier_node(strdup(param_tok.value)));
+            add_node_to_list(parameters, create_identifier_node(ast_strdup(param_tok.value)));
         }
     }
     
     expect(p, TOKEN_RPAREN, "Expected ')' after function parameters");
     Node* body = parse_block_statement(p);
-    return create_function_def_node(strdup(name_tok.value), parameters, body);
+    return create_function_def_node(ast_strdup(name_tok.value), parameters, body);
 }
 
 static Node* parse_goto_statement(Parser* p) {
     expect(p, TOKEN_GOTO, "Expected 'goto'");
     Token label_tok = expect(p, TOKEN_IDENTIFIER, "Expected label name");
     expect(p, TOKEN_SEMICOLON, "Expected ';' after goto");
-    return create_goto_node(strdup(label_tok.value));
+    return create_goto_node(ast_strdup(label_tok.value));
 }
 
 
@@ -725,8 +665,9 @@ static Node* parse_goto_statement(Parser* p) {
 
 // --- Public API ---
 
-Parser* parser_create(Token* tokens, int count) {
+Parser* parser_create(const char* source, Token* tokens, int count) {
     Parser* p = malloc(sizeof(Parser));
+    p->source = source;
     p->tokens = tokens;
     p->count = count;
     p->pos = 0;
@@ -739,6 +680,7 @@ void parser_destroy(Parser* parser) {
 
 // This is the public entry point. It parses a full program.
 Node* parse(Parser* parser) {
+    ast_reset_node_ids();
     ProgramNode* program = (ProgramNode*)create_program_node();
     print_debug("DEBUG: Parsing program...\n");
     while (current_token(parser).type != TOKEN_EOF) {
@@ -783,6 +725,12 @@ Node* parse(Parser* parser) {
             } else {
                 parser_error("Expected identifier after type");
             }
+        } else if (current_token(parser).type == TOKEN_PRECOMPILED) {
+            // A precompiled header's declarations, in place of its text
+            if (!add_precompiled_declarations(strtoull(current_token(parser).value, NULL, 16), program->functions)) {
+                parser_error_at_token(parser, "No precompiled header is loaded with this key");
+            }
+            advance(parser);
         } else {
             print_debug("DEBUG: It's not a function def...\n");
             Token token = current_token(parser);
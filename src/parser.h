@@ -1,19 +1,24 @@
 #ifndef PARSER_H
 #define PARSER_H
 
+#include <setjmp.h>
 #include "lexer.h"
 #include "ast.h"
 
 typedef struct {
+    const char* source;  // What the tokens were lexed from, for error positions
     Token* tokens;
     int pos;
     int count;
 } Parser;
 
-Parser* parser_create(Token* tokens, int count);
+Parser* parser_create(const char* source, Token* tokens, int count);
 void parser_destroy(Parser* parser);
 
 // The main entry point
 Node* parse(Parser* parser);
 
+// Where a parse error jumps to; NULL (the default) exits the process instead
+extern jmp_buf* parser_error_jump;
+
 #endif // PARSER_H
@@ -0,0 +1,379 @@
+#include "partition.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+int partition_into_cores = 0;
+
+// One task: a statement of main's body, or of the while (1) loop split open
+typedef struct {
+    Node* statement;
+    bool in_loop;
+    int root;        // A state it touches, after union-find; -1 for none
+} PartitionUnit;
+
+typedef struct {
+    ProgramNode* program;
+    HardwareContext* hw_ctx;
+    int* parent;              // Union-find over state numbers
+    bool* touched;            // States the current unit touches
+    FunctionDefNode** visited;  // Helpers already walked for the current unit
+    int visited_count;
+    int visited_capacity;
+    bool has_goto;
+} PartitionWalk;
+
+static int find_root(int* parent, int state) {
+    while (parent[state] != state) {
+        parent[state] = parent[parent[state]];
+        state = parent[state];
+    }
+    return state;
+}
+
+static FunctionDefNode* find_function(ProgramNode* program, const char* name) {
+    for (int i = 0; i < program->functions->count; i++) {
+        Node* item = program->functions->items[i];
+        if (item->type == NODE_FUNCTION_DEF && strcmp(((FunctionDefNode*)item)->name, name) == 0) {
+            return (FunctionDefNode*)item;
+        }
+    }
+    return NULL;
+}
+
+static void touch_name(PartitionWalk* walk, const char* name) {
+    int state = name ? get_state_number_by_name(walk->hw_ctx, name) : -1;
+    if (state >= 0 && state < walk->hw_ctx->state_count) {
+        walk->touched[state] = true;
+    }
+}
+
+static void walk_node(PartitionWalk* walk, Node* node);
+
+static void walk_list(PartitionWalk* walk, NodeList* list) {
+    if (!list) return;
+    for (int i = 0; i < list->count; i++) {
+        walk_node(walk, list->items[i]);
+    }
+}
+
+static void walk_call(PartitionWalk* walk, FunctionCallNode* call) {
+    walk_list(walk, call->arguments);
+    FunctionDefNode* callee = find_function(walk->program, call->name);
+    if (!callee) return;
+    for (int i = 0; i < walk->visited_count; i++) {
+        if (walk->visited[i] == callee) return;
+    }
+    if (walk->visited_count == walk->visited_capacity) {
+        walk->visited_capacity = walk->visited_capacity ? walk->visited_capacity * 2 : 8;
+        walk->visited = realloc(walk->visited, walk->visited_capacity * sizeof(FunctionDefNode*));
+    }
+    walk->visited[walk->visited_count++] = callee;
+    walk_node(walk, callee->body);
+}
+
+// Marks every state node reads or writes
+static void walk_node(PartitionWalk* walk, Node* node) {
+    if (!node) return;
+    switch (node->type) {
+        case NODE_BLOCK:
+            walk_list(walk, ((BlockNode*)node)->statements);
+            break;
+        case NODE_VAR_DECL:
+            touch_name(walk, ((VarDeclNode*)node)->var_name);
+            walk_node(walk, ((VarDeclNode*)node)->initializer);
+            break;
+        case NODE_EXPRESSION_STATEMENT:
+            walk_node(walk, ((ExpressionStatementNode*)node)->expression);
+            break;
+        case NODE_IF: {
+            IfNode* if_node = (IfNode*)node;
+            walk_node(walk, if_node->condition);
+            walk_node(walk, if_node->then_branch);
+            walk_node(walk, if_node->else_branch);
+            break;
+        }
+        case NODE_WHILE:
+            walk_node(walk, ((WhileNode*)node)->condition);
+            walk_node(walk, ((WhileNode*)node)->body);
+            break;
+        case NODE_FOR: {
+            ForNode* for_node = (ForNode*)node;
+            walk_node(walk, for_node->init);
+            walk_node(walk, for_node->condition);
+            walk_node(walk, for_node->update);
+            walk_node(walk, for_node->body);
+            break;
+        }
+        case NODE_SWITCH:
+            walk_node(walk, ((SwitchNode*)node)->expression);
+            walk_list(walk, ((SwitchNode*)node)->cases);
+            break;
+        case NODE_CASE:
+            walk_node(walk, ((CaseNode*)node)->value);
+            walk_list(walk, ((CaseNode*)node)->body);
+            break;
+        case NODE_RETURN:
+            walk_node(walk, ((ReturnNode*)node)->return_value);
+            break;
+        case NODE_BINARY_OP:
+            walk_node(walk, ((BinaryOpNode*)node)->left);
+            walk_node(walk, ((BinaryOpNode*)node)->right);
+            break;
+        case NODE_UNARY_OP:
+            walk_node(walk, ((UnaryOpNode*)node)->operand);
+            break;
+        case NODE_ASSIGNMENT:
+            walk_node(walk, ((AssignmentNode*)node)->identifier);
+            walk_node(walk, ((AssignmentNode*)node)->value);
+            break;
+        case NODE_FUNCTION_CALL:
+            walk_call(walk, (FunctionCallNode*)node);
+            break;
+        case NODE_ARRAY_ACCESS:
+            walk_node(walk, ((ArrayAccessNode*)node)->array);
+            walk_node(walk, ((ArrayAccessNode*)node)->index);
+            break;
+        case NODE_INITIALIZER_LIST:
+            walk_list(walk, ((InitializerListNode*)node)->elements);
+            break;
+        case NODE_IDENTIFIER:
+            touch_name(walk, ((IdentifierNode*)node)->name);
+            break;
+        case NODE_GOTO:
+            walk->has_goto = true;
+            break;
+        case NODE_LABEL:
+            walk->has_goto = true;
+            walk_node(walk, ((LabelNode*)node)->statement);
+            break;
+        default:
+            break;
+    }
+}
+
+static bool is_forever_loop(Node* node) {
+    if (!node || node->type != NODE_WHILE) return false;
+    Node* condition = ((WhileNode*)node)->condition;
+    if (!condition) return false;
+    if (condition->type == NODE_NUMBER_LITERAL) {
+        return strtol(((NumberLiteralNode*)condition)->value, NULL, 0) != 0;
+    }
+    return condition->type == NODE_BOOL_LITERAL && ((BoolLiteralNode*)condition)->value;
+}
+
+// A break, continue or return that leaves the loop node is the body of:
+// its statements cannot run apart, as each would need to stop the others.
+// Inside a nested loop only a return leaves; inside a switch, a continue.
+static bool leaves_loop(Node* node, bool in_loop, bool in_switch) {
+    if (!node) return false;
+    switch (node->type) {
+        case NODE_BREAK:
+            return !in_loop && !in_switch;
+        case NODE_CONTINUE:
+            return !in_loop;
+        case NODE_RETURN:
+            return true;
+        case NODE_BLOCK: {
+            NodeList* list = ((BlockNode*)node)->statements;
+            for (int i = 0; i < list->count; i++) {
+                if (leaves_loop(list->items[i], in_loop, in_switch)) return true;
+            }
+            return false;
+        }
+        case NODE_IF:
+            return leaves_loop(((IfNode*)node)->then_branch, in_loop, in_switch) ||
+                   leaves_loop(((IfNode*)node)->else_branch, in_loop, in_switch);
+        case NODE_WHILE:
+            return leaves_loop(((WhileNode*)node)->body, true, in_switch);
+        case NODE_FOR:
+            return leaves_loop(((ForNode*)node)->body, true, in_switch);
+        case NODE_SWITCH: {
+            NodeList* cases = ((SwitchNode*)node)->cases;
+            for (int i = 0; i < cases->count; i++) {
+                NodeList* body = ((CaseNode*)cases->items[i])->body;
+                for (int j = 0; body && j < body->count; j++) {
+                    if (leaves_loop(body->items[j], in_loop, true)) return true;
+                }
+            }
+            return false;
+        }
+        case NODE_LABEL:
+            return leaves_loop(((LabelNode*)node)->statement, in_loop, in_switch);
+        default:
+            return false;
+    }
+}
+
+static void add_unit(PartitionUnit** units, int* count, int* capacity, Node* statement, bool in_loop) {
+    if (*count == *capacity) {
+        *capacity = *capacity ? *capacity * 2 : 16;
+        *units = realloc(*units, *capacity * sizeof(PartitionUnit));
+    }
+    (*units)[*count].statement = statement;
+    (*units)[*count].in_loop = in_loop;
+    (*units)[*count].root = -1;
+    (*count)++;
+}
+
+static Partitioning* single_core(Node* ast_root, HardwareContext* hw_ctx) {
+    Partitioning* partitioning = calloc(1, sizeof(Partitioning));
+    partitioning->count = 1;
+    partitioning->programs = malloc(sizeof(Node*));
+    partitioning->programs[0] = ast_root;
+    partitioning->state_count = hw_ctx->state_count;
+    partitioning->state_owner = calloc(hw_ctx->state_count > 0 ? hw_ctx->state_count : 1, sizeof(int));
+    return partitioning;
+}
+
+Partitioning* partition_program(Node* ast_root, HardwareContext* hw_ctx) {
+    FunctionDefNode* main_function = find_main_function(ast_root);
+    if (!main_function || !main_function->body || main_function->body->type != NODE_BLOCK ||
+        hw_ctx->state_count == 0) {
+        return single_core(ast_root, hw_ctx);
+    }
+    NodeList* statements = ((BlockNode*)main_function->body)->statements;
+
+    // Units: main's statements, and those of its first while (1) that
+    // nothing inside leaves
+    PartitionUnit* units = NULL;
+    int unit_count = 0;
+    int unit_capacity = 0;
+    Node* split_loop = NULL;
+    for (int i = 0; i < statements->count; i++) {
+        Node* statement = statements->items[i];
+        Node* body = is_forever_loop(statement) ? ((WhileNode*)statement)->body : NULL;
+        if (!split_loop && body && body->type == NODE_BLOCK && !leaves_loop(body, false, false)) {
+            split_loop = statement;
+            NodeList* loop_statements = ((BlockNode*)body)->statements;
+            for (int j = 0; j < loop_statements->count; j++) {
+                add_unit(&units, &unit_count, &unit_capacity, loop_statements->items[j], true);
+            }
+        } else {
+            add_unit(&units, &unit_count, &unit_capacity, statement, false);
+        }
+    }
+
+    PartitionWalk walk = {0};
+    walk.program = (ProgramNode*)ast_root;
+    walk.hw_ctx = hw_ctx;
+    walk.parent = malloc(hw_ctx->state_count * sizeof(int));
+    walk.touched = malloc(hw_ctx->state_count * sizeof(bool));
+    for (int s = 0; s < hw_ctx->state_count; s++) {
+        walk.parent[s] = s;
+    }
+
+    // Join the states each unit touches
+    int* first_state = malloc((unit_count > 0 ? unit_count : 1) * sizeof(int));
+    for (int u = 0; u < unit_count; u++) {
+        memset(walk.touched, 0, hw_ctx->state_count * sizeof(bool));
+        walk.visited_count = 0;
+        walk_node(&walk, units[u].statement);
+        first_state[u] = -1;
+        for (int s = 0; s < hw_ctx->state_count; s++) {
+            if (!walk.touched[s]) continue;
+            if (first_state[u] < 0) {
+                first_state[u] = s;
+            } else {
+                walk.parent[find_root(walk.parent, s)] = find_root(walk.parent, first_state[u]);
+            }
+        }
+    }
+    free(walk.visited);
+    free(walk.touched);
+
+    if (walk.has_goto) {
+        free(first_state);
+        free(walk.parent);
+        free(units);
+        return single_core(ast_root, hw_ctx);
+    }
+
+    // Cores in the order their first unit appears
+    int* core_of_root = malloc(hw_ctx->state_count * sizeof(int));
+    for (int s = 0; s < hw_ctx->state_count; s++) {
+        core_of_root[s] = -1;
+    }
+    int core_count = 0;
+    for (int u = 0; u < unit_count; u++) {
+        if (first_state[u] < 0) continue;
+        units[u].root = find_root(walk.parent, first_state[u]);
+        if (core_of_root[units[u].root] < 0) {
+            core_of_root[units[u].root] = core_count++;
+        }
+    }
+    free(first_state);
+
+    if (core_count < 2) {
+        free(core_of_root);
+        free(walk.parent);
+        free(units);
+        return single_core(ast_root, hw_ctx);
+    }
+
+    Partitioning* partitioning = calloc(1, sizeof(Partitioning));
+    partitioning->count = core_count;
+    partitioning->state_count = hw_ctx->state_count;
+    partitioning->state_owner = calloc(hw_ctx->state_count, sizeof(int));
+    for (int s = 0; s < hw_ctx->state_count; s++) {
+        int core = core_of_root[find_root(walk.parent, s)];
+        partitioning->state_owner[s] = core >= 0 ? core : 0;
+    }
+
+    // Each core's main keeps the original order: its own units and the
+    // state-free ones, with the loop units inside a while (1) of their own
+    ProgramNode* original = (ProgramNode*)ast_root;
+    partitioning->programs = malloc(core_count * sizeof(Node*));
+    for (int core = 0; core < core_count; core++) {
+        Node* body = create_block_node();
+        for (int u = 0; u < unit_count; u++) {
+            if (units[u].in_loop) {
+                // The loop's units, in place of the loop
+                Node* loop_body = create_block_node();
+                for (; u < unit_count && units[u].in_loop; u++) {
+                    if (units[u].root < 0 || core_of_root[units[u].root] == core) {
+                        add_node_to_list(((BlockNode*)loop_body)->statements, units[u].statement);
+                    }
+                }
+                u--;
+                add_node_to_list(((BlockNode*)body)->statements,
+                                 create_while_node(((WhileNode*)split_loop)->condition, loop_body));
+            } else if (units[u].root < 0 || core_of_root[units[u].root] == core) {
+                add_node_to_list(((BlockNode*)body)->statements, units[u].statement);
+            }
+        }
+
+        Node* program = create_program_node();
+        for (int i = 0; i < original->functions->count; i++) {
+            Node* item = original->functions->items[i];
+            if (item == (Node*)main_function) {
+                item = create_function_def_node(main_function->name, main_function->parameters, body);
+            }
+            add_node_to_list(((ProgramNode*)program)->functions, item);
+        }
+        partitioning->programs[core] = program;
+    }
+
+    free(core_of_root);
+    free(walk.parent);
+    free(units);
+    return partitioning;
+}
+
+void free_partitioning(Partitioning* partitioning) {
+    if (!partitioning) return;
+    free(partitioning->programs);
+    free(partitioning->state_owner);
+    free(partitioning);
+}
+
+char* partition_core_filename(const char* filename, int core) {
+    const char* slash = strrchr(filename, '/');
+    const char* dot = strrchr(filename, '.');
+    size_t stem = dot && (!slash || dot > slash) ? (size_t)(dot - filename) : strlen(filename);
+    const char* extension = filename + stem;
+    size_t size = stem + strlen(extension) + 16;
+    char* name = malloc(size);
+    snprintf(name, size, "%.*s_p%d%s", (int)stem, filename, core, extension);
+    return name;
+}
@@ -0,0 +1,38 @@
+#ifndef PARTITION_H
+#define PARTITION_H
+
+#include "ast.h"
+#include "hw_analyzer.h"
+
+// Splitting a program into independent tasks, each compiled for its own
+// hotstate core (--partition). The tasks are main's top-level statements,
+// or the statements of its while (1) loop: two belong to the same core when
+// they touch a common state, through helpers they call included. Inputs are
+// wired to every core, so reading the same input does not tie two tasks.
+// A statement that touches no state (a local, a wait on an input, the final
+// return) goes to every core.
+//
+// Each core's program shares the original's nodes and functions and is
+// compiled against the original HardwareContext, so a state keeps its
+// number on every core; the core that owns a state drives its output.
+
+extern int partition_into_cores;  // --partition
+
+typedef struct {
+    int count;          // Cores; 1 when nothing could be split
+    Node** programs;    // Per core: a ProgramNode whose main runs that core's tasks
+    int* state_owner;   // Per state number: the core driving it (0 if no task touches it)
+    int state_count;
+} Partitioning;
+
+// The programs are allocated like the rest of the AST, so they live as
+// long as the compile's arena; a program with goto or labels in main is
+// left whole.
+Partitioning* partition_program(Node* ast_root, HardwareContext* hw_ctx);
+void free_partitioning(Partitioning* partitioning);
+
+// "dir/foo.c" and core 1 give "dir/foo_p1.c": the name output files of
+// that core are derived from. Returns a malloc'd string.
+char* partition_core_filename(const char* filename, int core);
+
+#endif // PARTITION_H
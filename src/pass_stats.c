@@ -0,0 +1,138 @@
+#define _GNU_SOURCE // For clock_gettime, getrusage and mallinfo2
+#include "pass_stats.h"
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+static int report_time = 0;
+static int report_mem = 0;
+static int report_json = 0;
+
+static PassRecord records[PASS_STATS_MAX_PASSES];
+static int record_count = 0;
+static int open_record = -1;    // Index of the pass in progress, or -1
+
+static double pass_start_ms = 0.0;
+static size_t pass_start_heap = 0;
+static size_t heap_peak = 0;
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+// Bytes currently handed out by malloc (0 where the libc can't tell us)
+static size_t heap_in_use(void) {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+#else
+    return 0;
+#endif
+}
+
+static long peak_rss_kb(void) {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+    return usage.ru_maxrss; // Kilobytes on Linux
+}
+
+void pass_stats_enable(int time_passes, int mem_stats, int json) {
+    report_time = time_passes;
+    report_mem = mem_stats;
+    report_json = json;
+}
+
+int pass_stats_enabled(void) {
+    return report_time || report_mem;
+}
+
+void pass_begin(const char* name) {
+    if (!pass_stats_enabled()) return;
+    if (open_record >= 0) pass_end(); // Passes don't nest; close the previous one
+    if (record_count >= PASS_STATS_MAX_PASSES) return;
+
+    open_record = record_count++;
+    memset(&records[open_record], 0, sizeof(PassRecord));
+    records[open_record].name = name;
+    pass_start_heap = heap_in_use();
+    if (pass_start_heap > heap_peak) heap_peak = pass_start_heap;
+    pass_start_ms = now_ms();
+}
+
+void pass_end(void) {
+    if (open_record < 0) return;
+
+    PassRecord* rec = &records[open_record];
+    rec->wall_ms = now_ms() - pass_start_ms;
+    rec->heap_in_use = heap_in_use();
+    rec->heap_delta = (long long)rec->heap_in_use - (long long)pass_start_heap;
+    if (rec->heap_in_use > heap_peak) heap_peak = rec->heap_in_use;
+    rec->heap_peak = heap_peak;
+    rec->peak_rss_kb = peak_rss_kb();
+    open_record = -1;
+}
+
+static void report_json_records(FILE* out, double total_ms) {
+    fprintf(out, "{\n  \"passes\": [\n");
+    for (int i = 0; i < record_count; i++) {
+        PassRecord* rec = &records[i];
+        fprintf(out, "    {\"name\": \"%s\"", rec->name);
+        if (report_time) {
+            fprintf(out, ", \"wall_ms\": %.3f", rec->wall_ms);
+        }
+        if (report_mem) {
+            fprintf(out, ", \"heap_delta\": %lld, \"heap_in_use\": %zu, \"heap_peak\": %zu, \"peak_rss_kb\": %ld",
+                    rec->heap_delta, rec->heap_in_use, rec->heap_peak, rec->peak_rss_kb);
+        }
+        fprintf(out, "}%s\n", i + 1 < record_count ? "," : "");
+    }
+    fprintf(out, "  ]");
+    if (report_time) {
+        fprintf(out, ",\n  \"total_ms\": %.3f", total_ms);
+    }
+    fprintf(out, "\n}\n");
+}
+
+static void report_table(FILE* out, double total_ms) {
+    fprintf(out, "\n--- Pass Statistics ---\n");
+    fprintf(out, "%-28s", "Pass");
+    if (report_time) fprintf(out, " %10s %6s", "Wall(ms)", "%");
+    if (report_mem) fprintf(out, " %12s %12s %12s %10s", "Heap delta", "Heap in use", "Heap peak", "RSS(KB)");
+    fprintf(out, "\n");
+
+    for (int i = 0; i < record_count; i++) {
+        PassRecord* rec = &records[i];
+        fprintf(out, "%-28s", rec->name);
+        if (report_time) {
+            fprintf(out, " %10.3f %5.1f%%", rec->wall_ms, total_ms > 0 ? 100.0 * rec->wall_ms / total_ms : 0.0);
+        }
+        if (report_mem) {
+            fprintf(out, " %12lld %12zu %12zu %10ld", rec->heap_delta, rec->heap_in_use, rec->heap_peak, rec->peak_rss_kb);
+        }
+        fprintf(out, "\n");
+    }
+    if (report_time) {
+        fprintf(out, "%-28s %10.3f\n", "Total", total_ms);
+    }
+}
+
+void pass_stats_report(FILE* out) {
+    if (!pass_stats_enabled()) return;
+    pass_end();
+
+    double total_ms = 0.0;
+    for (int i = 0; i < record_count; i++) {
+        total_ms += records[i].wall_ms;
+    }
+
+    if (report_json) {
+        report_json_records(out, total_ms);
+    } else {
+        report_table(out, total_ms);
+    }
+}
@@ -0,0 +1,31 @@
+#ifndef PASS_STATS_H
+#define PASS_STATS_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+// Per-phase compile instrumentation for --time-passes / --mem-stats.
+// Each phase is bracketed by pass_begin()/pass_end(); the calls are cheap
+// no-ops unless reporting was enabled with pass_stats_enable().
+
+#define PASS_STATS_MAX_PASSES 64
+
+typedef struct {
+    const char* name;       // Static string, e.g. "parse"
+    double wall_ms;         // Wall-clock time spent in the pass
+    long long heap_delta;   // Change in heap bytes in use across the pass
+    size_t heap_in_use;     // Heap bytes in use when the pass ended
+    size_t heap_peak;       // Highest heap-in-use sample seen so far
+    long peak_rss_kb;       // Process peak resident set size when the pass ended
+} PassRecord;
+
+void pass_stats_enable(int time_passes, int mem_stats, int json);
+int pass_stats_enabled(void);
+
+void pass_begin(const char* name);
+void pass_end(void);
+
+// Print the collected records as a table, or as JSON if requested
+void pass_stats_report(FILE* out);
+
+#endif // PASS_STATS_H
@@ -0,0 +1,299 @@
+#define _GNU_SOURCE  // For strdup and st_mtim
+#include "precompiled_header.h"
+#include "ast_serialize.h"
+#include "parser.h"
+#include "hw_analyzer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include <sys/stat.h>
+
+// Bump when the layout changes. PCH_MAGIC; the header it was made from:
+// uint64 size, mtime seconds and nanoseconds; uint64 key (FNV-1a of its
+// text); uint32 item count and the items, as ast_write_node writes them.
+#define PCH_MAGIC "HSPCH002"
+#define PCH_MAGIC_SIZE 8
+
+static char* pch_path_for(const char* header_path) {
+    size_t length = strlen(header_path) + sizeof(PRECOMPILED_HEADER_SUFFIX);
+    char* path = malloc(length);
+    if (path) snprintf(path, length, "%s%s", header_path, PRECOMPILED_HEADER_SUFFIX);
+    return path;
+}
+
+// FNV-1a of the header's text, never 0
+static uint64_t header_key(const char* text, size_t length) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < length; i++) {
+        h ^= (unsigned char)text[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h ? h : 1;
+}
+
+// --- Precompiling ---
+
+// Declarations, and of them states and inputs, under node
+static void count_declarations(Node* node, int* decls, int* states, int* inputs) {
+    if (node->type == NODE_BLOCK) {
+        NodeList* statements = ((BlockNode*)node)->statements;
+        for (int i = 0; i < statements->count; i++) {
+            count_declarations(statements->items[i], decls, states, inputs);
+        }
+        return;
+    }
+    (*decls)++;
+    HardwareVarType type = classify_variable((VarDeclNode*)node);
+    *states += type == HW_VAR_STATE;
+    *inputs += type == HW_VAR_INPUT;
+}
+
+// Built only from literals and operators
+static bool constant_initializer(Node* node) {
+    switch (node->type) {
+        case NODE_NUMBER_LITERAL:
+        case NODE_BOOL_LITERAL:
+            return true;
+        case NODE_UNARY_OP:
+            return constant_initializer(((UnaryOpNode*)node)->operand);
+        case NODE_BINARY_OP:
+            return constant_initializer(((BinaryOpNode*)node)->left) &&
+                   constant_initializer(((BinaryOpNode*)node)->right);
+        case NODE_INITIALIZER_LIST: {
+            NodeList* elements = ((InitializerListNode*)node)->elements;
+            for (int i = 0; i < elements->count; i++) {
+                if (!constant_initializer(elements->items[i])) return false;
+            }
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+// Why item cannot be precompiled, or NULL
+static const char* unsupported_item(Node* item) {
+    if (item->type == NODE_FUNCTION_DEF) {
+        return "functions cannot be precompiled";
+    }
+    if (item->type == NODE_BLOCK) {
+        NodeList* statements = ((BlockNode*)item)->statements;
+        for (int i = 0; i < statements->count; i++) {
+            const char* reason = unsupported_item(statements->items[i]);
+            if (reason) return reason;
+        }
+        return NULL;
+    }
+    if (item->type != NODE_VAR_DECL) {
+        return "only declarations can be precompiled";
+    }
+    VarDeclNode* decl = (VarDeclNode*)item;
+    if (decl->initializer && !constant_initializer(decl->initializer)) {
+        return "initializers must be constants";
+    }
+    return NULL;
+}
+
+bool precompile_header(const char* header_path) {
+    struct stat header_stat;
+    size_t text_length = 0;
+    char* text = stat(header_path, &header_stat) == 0 ? (char*)ast_read_file(header_path, &text_length) : NULL;
+    if (!text) {
+        fprintf(stderr, "Error: Cannot read header '%s'\n", header_path);
+        return false;
+    }
+
+    Arena* arena = arena_create(ARENA_DEFAULT_CHUNK_SIZE);
+    Arena* outer_arena = ast_get_arena();
+    ast_set_arena(arena);
+    TokenList* tokens = lexer_tokenize(text, arena);
+    bool ok = true;
+    for (int i = 0; i < tokens->count && ok; i++) {
+        if (tokens->items[i].type == TOKEN_INCLUDE) {
+            fprintf(stderr, "Error: %s includes other files; only a header of declarations can be precompiled\n",
+                    header_path);
+            ok = false;
+        }
+    }
+
+    // A parse error comes back here instead of exiting
+    Parser* parser = parser_create(text, tokens->items, tokens->count);
+    jmp_buf on_parse_error;
+    jmp_buf* outer_handler = parser_error_jump;
+    ProgramNode* volatile program = NULL;
+    if (ok) {
+        if (setjmp(on_parse_error) == 0) {
+            parser_error_jump = &on_parse_error;
+            program = (ProgramNode*)parse(parser);
+        } else {
+            ok = false;
+        }
+        parser_error_jump = outer_handler;
+    }
+    parser_destroy(parser);
+
+    AstWriter w = { 0 };
+    int decls = 0, states = 0, inputs = 0;
+    if (ok) {
+        ast_write(&w, PCH_MAGIC, PCH_MAGIC_SIZE);
+        ast_write_u64(&w, (uint64_t)header_stat.st_size);
+        ast_write_u64(&w, (uint64_t)header_stat.st_mtim.tv_sec);
+        ast_write_u64(&w, (uint64_t)header_stat.st_mtim.tv_nsec);
+        ast_write_u64(&w, header_key(text, text_length));
+        ast_write_u32(&w, (uint32_t)program->functions->count);
+        for (int i = 0; i < program->functions->count && ok; i++) {
+            Node* item = program->functions->items[i];
+            const char* reason = unsupported_item(item);
+            if (reason) {
+                fprintf(stderr, "Error: Cannot precompile %s: %s\n", header_path, reason);
+                ok = false;
+            } else {
+                ast_write_node(&w, item);
+                count_declarations(item, &decls, &states, &inputs);
+            }
+        }
+    }
+
+    char* pch_path = pch_path_for(header_path);
+    if (ok && (!pch_path || !ast_write_file(pch_path, &w))) {
+        fprintf(stderr, "Error: Cannot write %s%s\n", header_path, PRECOMPILED_HEADER_SUFFIX);
+        ok = false;
+    }
+    if (ok) {
+        printf("Precompiled %s: %d declarations (%d states, %d inputs) into %s\n",
+               header_path, decls, states, inputs, pch_path);
+    }
+
+    free(pch_path);
+    free(w.data);
+    free_token_list(tokens);
+    ast_set_arena(outer_arena);
+    arena_destroy(arena);
+    free(text);
+    return ok;
+}
+
+// --- Loading ---
+
+// A .hpch read in this process. Kept for the parser, and so that
+// compiling again (--watch, --serve) only stats the files.
+typedef struct {
+    char* path;                  // The .hpch
+    off_t size;                  // Its size and modification time when read
+    struct timespec mtime;
+    uint64_t header_size;        // The header it was made from
+    uint64_t header_sec, header_nsec;
+    uint64_t key;                // 0 when unusable
+    uint8_t* items;              // The item count and items
+    size_t items_size;
+} LoadedHeader;
+
+static LoadedHeader* loaded_headers = NULL;
+static int loaded_count = 0;
+static int loaded_capacity = 0;
+
+static LoadedHeader* find_loaded(const char* pch_path) {
+    for (int i = 0; i < loaded_count; i++) {
+        if (strcmp(loaded_headers[i].path, pch_path) == 0) return &loaded_headers[i];
+    }
+    if (loaded_count == loaded_capacity) {
+        int capacity = loaded_capacity ? loaded_capacity * 2 : 8;
+        LoadedHeader* grown = realloc(loaded_headers, capacity * sizeof(LoadedHeader));
+        if (!grown) return NULL;
+        loaded_headers = grown;
+        loaded_capacity = capacity;
+    }
+    LoadedHeader* entry = &loaded_headers[loaded_count];
+    memset(entry, 0, sizeof(*entry));
+    entry->path = strdup(pch_path);
+    if (!entry->path) return NULL;
+    loaded_count++;
+    return entry;
+}
+
+// Reads entry's file afresh; its key stays 0 if the file is unusable
+static void read_loaded(LoadedHeader* entry, const struct stat* pch_stat) {
+    free(entry->items);
+    entry->items = NULL;
+    entry->items_size = 0;
+    entry->key = 0;
+    entry->size = pch_stat->st_size;
+    entry->mtime = pch_stat->st_mtim;
+
+    size_t size = 0;
+    uint8_t* data = ast_read_file(entry->path, &size);
+    AstReader r = { data, size, 0 };
+    char magic[PCH_MAGIC_SIZE];
+    uint64_t key = 0;
+    uint32_t count = 0;
+    bool ok = data && ast_read(&r, magic, PCH_MAGIC_SIZE) && memcmp(magic, PCH_MAGIC, PCH_MAGIC_SIZE) == 0 &&
+              ast_read_u64(&r, &entry->header_size) && ast_read_u64(&r, &entry->header_sec) &&
+              ast_read_u64(&r, &entry->header_nsec) && ast_read_u64(&r, &key) && key != 0;
+    size_t items_start = r.pos;
+    if (ok) ok = ast_read_u32(&r, &count);
+    for (uint32_t i = 0; i < count && ok; i++) {
+        ok = ast_read_node(&r, NULL);
+    }
+    if (ok && r.pos == size) {
+        entry->items_size = size - items_start;
+        entry->items = malloc(entry->items_size);
+        if (entry->items) {
+            memcpy(entry->items, data + items_start, entry->items_size);
+            entry->key = key;
+        }
+    } else {
+        fprintf(stderr, "Warning: Ignoring %s, which is not a precompiled header this compiler reads\n",
+                entry->path);
+    }
+    free(data);
+}
+
+uint64_t load_precompiled_header(const char* header_path) {
+    char* pch_path = pch_path_for(header_path);
+    struct stat pch_stat, header_stat;
+    if (!pch_path || stat(pch_path, &pch_stat) != 0 || stat(header_path, &header_stat) != 0) {
+        free(pch_path);
+        return 0;
+    }
+
+    LoadedHeader* entry = find_loaded(pch_path);
+    free(pch_path);
+    if (!entry) return 0;
+    bool reread = entry->size != pch_stat.st_size || entry->mtime.tv_sec != pch_stat.st_mtim.tv_sec ||
+                  entry->mtime.tv_nsec != pch_stat.st_mtim.tv_nsec;
+    if (reread) {
+        read_loaded(entry, &pch_stat);
+    }
+    if (!entry->key) return 0;
+
+    // The header has been edited since it was precompiled
+    if (entry->header_size != (uint64_t)header_stat.st_size ||
+        entry->header_sec != (uint64_t)header_stat.st_mtim.tv_sec ||
+        entry->header_nsec != (uint64_t)header_stat.st_mtim.tv_nsec) {
+        if (reread) {
+            fprintf(stderr, "Warning: %s is out of date; reading %s instead\n", entry->path, header_path);
+        }
+        return 0;
+    }
+    return entry->key;
+}
+
+bool add_precompiled_declarations(uint64_t key, NodeList* list) {
+    for (int i = 0; i < loaded_count; i++) {
+        LoadedHeader* entry = &loaded_headers[i];
+        if (entry->key != key) continue;
+
+        // Checked when it was loaded
+        AstReader r = { entry->items, entry->items_size, 0 };
+        uint32_t count = 0;
+        ast_read_u32(&r, &count);
+        for (uint32_t j = 0; j < count; j++) {
+            Node* item = NULL;
+            if (!ast_read_node(&r, &item)) return false;
+            add_node_to_list(list, item);
+        }
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,32 @@
+#ifndef PRECOMPILED_HEADER_H
+#define PRECOMPILED_HEADER_H
+
+#include "ast.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Precompiled hardware-declaration headers (--precompile-header).
+// A header holding only global declarations with constant initializers,
+// such as the state and input declarations a family of programs shares,
+// is lexed and parsed once into <header>.hpch next to it. While the .hpch
+// still matches the header's size and modification time, preprocess_includes
+// splices a "#precompiled KEY" line in place of the header's text, and the
+// parser adds the stored declarations there without lexing or parsing the
+// header again. A stale or unreadable .hpch is ignored and the header is
+// read as text.
+
+#define PRECOMPILED_HEADER_SUFFIX ".hpch"
+
+// Writes header_path's .hpch; false, with the reason on stderr, for a
+// header that cannot be read or holds anything but declarations
+bool precompile_header(const char* header_path);
+
+// The key of header_path's .hpch, loaded and kept for the parser for the
+// rest of the process; 0 when it has none or it is out of date
+uint64_t load_precompiled_header(const char* header_path);
+
+// Appends the declarations loaded under key to list, as parsed nodes in the
+// current AST arena; false when no loaded header has that key
+bool add_precompiled_declarations(uint64_t key, NodeList* list);
+
+#endif // PRECOMPILED_HEADER_H
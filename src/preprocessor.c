@@ -1,36 +1,65 @@
-#define _GNU_SOURCE  // For strdup
+#define _GNU_SOURCE  // For strdup, strndup, realpath
 #include "preprocessor.h"
+#include "precompiled_header.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <libgen.h>
 
-// Helper function to read entire file into a string
-static char* read_file_content(const char* filename) {
-    FILE* file = fopen(filename, "r");
-    if (!file) {
-        return NULL;
+// A source file's bytes: mapped read-only when possible, else read into a
+// malloc'd buffer. Not NUL-terminated.
+typedef struct {
+    const char* data;
+    size_t length;
+    int mapped;
+} SourceFile;
+
+static int open_source_file(const char* filename, SourceFile* file) {
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return 0;
     }
-    
-    // Get file size
-    fseek(file, 0, SEEK_END);
-    long file_size = ftell(file);
-    fseek(file, 0, SEEK_SET);
-    
-    // Allocate buffer
-    char* buffer = malloc(file_size + 1);
-    if (!buffer) {
-        fclose(file);
-        return NULL;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return 0;
+    }
+    file->length = (size_t)st.st_size;
+    file->mapped = 0;
+    file->data = "";
+    if (file->length > 0) {
+        void* map = mmap(NULL, file->length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            file->data = map;
+            file->mapped = 1;
+        } else {
+            // Not mappable (e.g. a pipe); fall back to reading it
+            char* buffer = malloc(file->length);
+            ssize_t got = buffer ? read(fd, buffer, file->length) : -1;
+            if (got < 0) {
+                free(buffer);
+                close(fd);
+                return 0;
+            }
+            file->data = buffer;
+            file->length = (size_t)got;
+        }
+    }
+    close(fd);
+    return 1;
+}
+
+static void close_source_file(SourceFile* file) {
+    if (file->mapped) {
+        munmap((void*)file->data, file->length);
+    } else if (file->length > 0) {
+        free((void*)file->data);
     }
-    
-    // Read file
-    size_t bytes_read = fread(buffer, 1, file_size, file);
-    buffer[bytes_read] = '\0';
-    
-    fclose(file);
-    return buffer;
 }
 
 // Helper function to check if file exists
@@ -65,111 +94,250 @@ static char* resolve_include_path(const char* include_filename, const char* curr
 }
 
 // Simple text-based include processing
-static char* process_includes_simple(const char* filename, char** included_files, int* included_count, int max_includes) {
-    // Check for include cycles
-    for (int i = 0; i < *included_count; i++) {
-        if (strcmp(included_files[i], filename) == 0) {
-            fprintf(stderr, "Warning: Circular include detected for '%s'\n", filename);
-            return strdup(""); // Return empty string to avoid infinite recursion
+//
+// The expansion is written into one growable buffer. Each file is read once
+// and scanned in place, every (directory, name) lookup is resolved once, and
+// the set of files already expanded is hashed, so the cost is linear in the
+// size of the output rather than in the include count times the output.
+
+// Growable output buffer
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;
+} OutputBuffer;
+
+static int output_append(OutputBuffer* out, const char* text, size_t length) {
+    if (out->length + length + 1 > out->capacity) {
+        size_t capacity = out->capacity ? out->capacity : 4096;
+        while (out->length + length + 1 > capacity) capacity *= 2;
+        char* data = realloc(out->data, capacity);
+        if (!data) {
+            fprintf(stderr, "Error: Out of memory while preprocessing\n");
+            return 0;
         }
+        out->data = data;
+        out->capacity = capacity;
     }
-    
+    memcpy(out->data + out->length, text, length);
+    out->length += length;
+    out->data[out->length] = '\0';
+    return 1;
+}
+
+// Open-addressing string map; value may be NULL. Used both as the set of
+// expanded files and as the cache of resolved include paths.
+typedef struct {
+    char* key;
+    char* value;
+    uint32_t hash;
+} PathEntry;
+
+typedef struct {
+    PathEntry* entries;
+    uint32_t mask;  // slot count - 1 (power of two)
+    uint32_t count;
+} PathTable;
+
+static uint32_t hash_path(const char* str) {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (const unsigned char* p = (const unsigned char*)str; *p; p++) {
+        hash ^= *p;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Returns the slot holding key, or the empty slot where it would go
+static PathEntry* path_table_probe(PathTable* table, const char* key, uint32_t hash) {
+    uint32_t i = hash & table->mask;
+    while (table->entries[i].key) {
+        if (table->entries[i].hash == hash && strcmp(table->entries[i].key, key) == 0) {
+            break;
+        }
+        i = (i + 1) & table->mask;
+    }
+    return &table->entries[i];
+}
+
+static PathEntry* path_table_find(PathTable* table, const char* key) {
+    if (!table->entries) return NULL;
+    PathEntry* entry = path_table_probe(table, key, hash_path(key));
+    return entry->key ? entry : NULL;
+}
+
+// Takes ownership of value; key is copied
+static int path_table_insert(PathTable* table, const char* key, char* value) {
+    if ((table->count + 1) * 2 > table->mask + 1 || !table->entries) {
+        uint32_t slot_count = table->entries ? (table->mask + 1) * 2 : 64;
+        PathEntry* old = table->entries;
+        uint32_t old_slots = table->entries ? table->mask + 1 : 0;
+        table->entries = calloc(slot_count, sizeof(PathEntry));
+        if (!table->entries) {
+            table->entries = old;
+            return 0;
+        }
+        table->mask = slot_count - 1;
+        for (uint32_t i = 0; i < old_slots; i++) {
+            if (old[i].key) {
+                *path_table_probe(table, old[i].key, old[i].hash) = old[i];
+            }
+        }
+        free(old);
+    }
+    uint32_t hash = hash_path(key);
+    PathEntry* entry = path_table_probe(table, key, hash);
+    if (entry->key) {
+        free(entry->value);
+    } else {
+        entry->key = strdup(key);
+        entry->hash = hash;
+        table->count++;
+    }
+    entry->value = value;
+    return 1;
+}
+
+static void path_table_free(PathTable* table) {
+    for (uint32_t i = 0; table->entries && i <= table->mask; i++) {
+        free(table->entries[i].key);
+        free(table->entries[i].value);
+    }
+    free(table->entries);
+}
+
+typedef struct {
+    PathTable included;   // Files already expanded (include-once)
+    PathTable resolved;   // "dir\nname" -> resolved path, or NULL if not found
+    int depth;
+    int max_depth;
+} PreprocessState;
+
+// resolve_include_path() with its answers remembered; the result is owned
+// by the cache
+static const char* resolve_include_cached(PreprocessState* state, const char* include_filename, const char* current_dir) {
+    size_t key_len = strlen(current_dir) + strlen(include_filename) + 2;
+    char* key = malloc(key_len);
+    snprintf(key, key_len, "%s\n%s", current_dir, include_filename);
+
+    PathEntry* entry = path_table_find(&state->resolved, key);
+    if (!entry) {
+        path_table_insert(&state->resolved, key, resolve_include_path(include_filename, current_dir));
+        entry = path_table_find(&state->resolved, key);
+    }
+    free(key);
+    return entry ? entry->value : NULL;
+}
+
+// Adds filename to the included set; 0 if it was already there. Files are
+// identified by canonical path, so "sub/../a.h" and "a.h" are the same file.
+static int mark_included(PreprocessState* state, const char* filename) {
+    char* canonical = realpath(filename, NULL);
+    const char* file_key = canonical ? canonical : filename;
+    int added = !path_table_find(&state->included, file_key);
+    if (added) {
+        path_table_insert(&state->included, file_key, NULL);
+    }
+    free(canonical);
+    return added;
+}
+
+static int process_includes_simple(PreprocessState* state, const char* filename, OutputBuffer* out) {
     // Check maximum include depth
-    if (*included_count >= max_includes) {
+    if (state->depth >= state->max_depth) {
         fprintf(stderr, "Error: Maximum include depth exceeded\n");
-        return NULL;
+        return 0;
     }
-    
-    // Add current file to included list
-    included_files[*included_count] = strdup(filename);
-    (*included_count)++;
-    
-    // Read the file content
-    char* content = read_file_content(filename);
-    if (!content) {
+
+    // Each file is expanded once; later includes of it expand to nothing
+    if (!mark_included(state, filename)) {
+        fprintf(stderr, "Warning: Circular include detected for '%s'\n", filename);
+        return 1;
+    }
+
+    // Map the file; lines are scanned without copying
+    SourceFile file;
+    if (!open_source_file(filename, &file)) {
         fprintf(stderr, "Error: Cannot read file '%s'\n", filename);
-        return NULL;
+        return 0;
     }
-    
+
     // Get directory of current file for relative includes
     char* filename_copy = strdup(filename);
     char* current_dir = dirname(filename_copy);
-    
-    // Process line by line without modifying original content
-    char* content_copy = strdup(content);
-    char* result = malloc(strlen(content) * 2 + 1000); // Extra space for includes
-    result[0] = '\0';
-    
-    char* line_start = content_copy;
-    char* line_end;
-    
-    while ((line_end = strchr(line_start, '\n')) != NULL || *line_start != '\0') {
-        // Extract current line
-        char* line;
-        if (line_end) {
-            *line_end = '\0';
-            line = line_start;
-            line_start = line_end + 1;
-        } else {
-            // Last line without newline
-            line = line_start;
-            line_start += strlen(line_start);
-        }
-        
+
+    state->depth++;
+    int ok = 1;
+    const char* line_start = file.data;
+    const char* file_end = file.data + file.length;
+    while (ok && line_start < file_end) {
+        // Extract current line (the last one may lack a newline)
+        const char* line = line_start;
+        const char* line_end = memchr(line_start, '\n', (size_t)(file_end - line_start));
+        if (!line_end) line_end = file_end;
+        size_t line_len = (size_t)(line_end - line);
+        line_start = line_end < file_end ? line_end + 1 : file_end;
+
         // Check if line starts with #include
-        char* trimmed = line;
-        while (*trimmed == ' ' || *trimmed == '\t') trimmed++; // Skip whitespace
-        
-        if (strncmp(trimmed, "#include", 8) == 0) {
+        const char* trimmed = line;
+        while (trimmed < line_end && (*trimmed == ' ' || *trimmed == '\t')) trimmed++; // Skip whitespace
+
+        if (line_end - trimmed >= 8 && strncmp(trimmed, "#include", 8) == 0) {
             // Extract filename from #include "filename"
-            char* quote_start = strchr(trimmed, '"');
+            const char* quote_start = memchr(trimmed, '"', (size_t)(line_end - trimmed));
             if (quote_start) {
                 quote_start++; // Skip opening quote
-                char* quote_end = strchr(quote_start, '"');
+                const char* quote_end = memchr(quote_start, '"', (size_t)(line_end - quote_start));
                 if (quote_end) {
-                    *quote_end = '\0'; // Null terminate filename
-                    
+                    char* include_name = strndup(quote_start, (size_t)(quote_end - quote_start));
+
                     // Resolve and process included file
-                    char* include_path = resolve_include_path(quote_start, current_dir);
-                    if (include_path) {
-                        char* included_content = process_includes_simple(include_path, included_files, included_count, max_includes);
-                        if (included_content) {
-                            strcat(result, included_content);
-                            strcat(result, "\n");
-                            free(included_content);
+                    const char* include_path = resolve_include_cached(state, include_name, current_dir);
+                    uint64_t precompiled = include_path ? load_precompiled_header(include_path) : 0;
+                    if (precompiled) {
+                        // Its declarations come from the .hpch; the parser adds them here
+                        if (mark_included(state, include_path)) {
+                            char directive[32];
+                            int length = snprintf(directive, sizeof(directive), "#precompiled %016llx\n",
+                                                  (unsigned long long)precompiled);
+                            ok = output_append(out, directive, (size_t)length);
+                        }
+                    } else if (include_path) {
+                        if (process_includes_simple(state, include_path, out)) {
+                            ok = output_append(out, "\n", 1);
                         }
-                        free(include_path);
                     } else {
-                        fprintf(stderr, "Warning: Cannot find include file '%s'\n", quote_start);
+                        fprintf(stderr, "Warning: Cannot find include file '%s'\n", include_name);
                     }
+                    free(include_name);
                 }
             }
         } else {
             // Regular line, copy as-is
-            strcat(result, line);
-            strcat(result, "\n");
+            ok = output_append(out, line, line_len) && output_append(out, "\n", 1);
         }
     }
-    
-    free(content_copy);
-    
-    free(content);
+    state->depth--;
+
+    close_source_file(&file);
     free(filename_copy);
-    
-    return result;
+
+    return ok;
 }
 
 char* preprocess_includes(const char* filename) {
-    const int MAX_INCLUDES = 100;
-    char* included_files[MAX_INCLUDES];
-    int included_count = 0;
-    
-    char* result = process_includes_simple(filename, included_files, &included_count, MAX_INCLUDES);
-    
-    // Clean up included files list
-    for (int i = 0; i < included_count; i++) {
-        free(included_files[i]);
+    PreprocessState state = { .max_depth = 100 };
+    OutputBuffer out = { 0 };
+
+    int ok = process_includes_simple(&state, filename, &out) && output_append(&out, "", 0);
+
+    path_table_free(&state.included);
+    path_table_free(&state.resolved);
+
+    if (!ok) {
+        free(out.data);
+        return NULL;
     }
-    
-    return result;
-}
\ No newline at end of file
+    return out.data;
+}
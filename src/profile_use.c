@@ -0,0 +1,163 @@
+#include "profile_use.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+StatementProfile* statement_profile = NULL;
+
+static char* read_profile_file(const char* filename) {
+    FILE* file = fopen(filename, "rb");
+    if (!file) return NULL;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char* text = size >= 0 ? malloc(size + 1) : NULL;
+    if (text) {
+        size_t read = fread(text, 1, size, file);
+        text[read] = '\0';
+    }
+    fclose(file);
+    return text;
+}
+
+// The numbers of the array after "key": in text; -1 when there is none
+static int parse_counts(const char* text, const char* key, uint64_t** counts) {
+    const char* p = strstr(text, key);
+    if (!p) return -1;
+    p += strlen(key);
+    while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r' || *p == ':') p++;
+    if (*p++ != '[') return -1;
+
+    int count = 0, capacity = 256;
+    *counts = malloc(sizeof(uint64_t) * capacity);
+    for (;;) {
+        while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r' || *p == ',') p++;
+        if (*p == ']') return count;
+        char* end;
+        unsigned long long value = strtoull(p, &end, 10);
+        if (end == p) {
+            free(*counts);
+            *counts = NULL;
+            return -1;
+        }
+        if (count == capacity) {
+            capacity *= 2;
+            *counts = realloc(*counts, sizeof(uint64_t) * capacity);
+        }
+        (*counts)[count++] = value;
+        p = end;
+    }
+}
+
+WordProfile* load_word_profile(const char* filename) {
+    char* text = read_profile_file(filename);
+    if (!text) {
+        fprintf(stderr, "Error: Cannot read profile %s\n", filename);
+        return NULL;
+    }
+    WordProfile* profile = calloc(1, sizeof(WordProfile));
+    profile->words = parse_counts(text, "\"hits\"", &profile->hits);
+    free(text);
+    if (profile->words < 0) {
+        fprintf(stderr, "Error: Profile %s has no \"hits\" array; write it with hotstate_sim --profile FILE.json\n", filename);
+        free(profile);
+        return NULL;
+    }
+    for (int i = 0; i < profile->words; i++) {
+        profile->edges += profile->hits[i];
+    }
+    return profile;
+}
+
+void free_word_profile(WordProfile* profile) {
+    if (!profile) return;
+    free(profile->hits);
+    free(profile);
+}
+
+static void credit(StatementProfile* profile, const Node* node, uint64_t hits) {
+    if (node->id < 0 || node->id >= profile->count) return;
+    profile->runs[node->id] += hits;
+    profile->measured[node->id] = true;
+}
+
+StatementProfile* map_word_profile(const WordProfile* words, const CompactMicrocode* mc) {
+    if (words->words != mc->instruction_count) {
+        fprintf(stderr, "Warning: Profile has %d words but the program compiles to %d; "
+                "compiling without it\n", words->words, mc->instruction_count);
+        return NULL;
+    }
+    StatementProfile* profile = calloc(1, sizeof(StatementProfile));
+    profile->count = ast_node_id_limit();
+    profile->runs = calloc(profile->count > 0 ? profile->count : 1, sizeof(uint64_t));
+    profile->measured = calloc(profile->count > 0 ? profile->count : 1, sizeof(bool));
+    profile->edges = words->edges;
+    if (!profile->runs || !profile->measured) {
+        fprintf(stderr, "Error: Failed to allocate the statement profile.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    int measured = 0;
+    for (int i = 0; i < mc->instruction_count; i++) {
+        const Node* stmt = mc->word_labels[i].statement;
+        if (!stmt) continue;
+        credit(profile, stmt, words->hits[i]);
+        measured++;
+        // A call statement's count is its call's, which is what helpers look up
+        if (stmt->type == NODE_EXPRESSION_STATEMENT) {
+            const Node* expr = ((const ExpressionStatementNode*)stmt)->expression;
+            if (expr && expr->type == NODE_FUNCTION_CALL) {
+                credit(profile, expr, words->hits[i]);
+            }
+        }
+    }
+    print_debug("DEBUG: map_word_profile: %d of %d words start a statement, %llu edges\n",
+                measured, mc->instruction_count, (unsigned long long)profile->edges);
+    return profile;
+}
+
+void free_statement_profile(StatementProfile* profile) {
+    if (!profile) return;
+    free(profile->runs);
+    free(profile->measured);
+    free(profile);
+}
+
+bool use_profile(const char* filename, Node* ast_root, HardwareContext* hw_ctx) {
+    WordProfile* words = load_word_profile(filename);
+    if (!words) return false;
+    statement_profile = NULL;
+    CompactMicrocode* profiled = ast_to_compact_microcode(ast_root, hw_ctx);
+    StatementProfile* profile = profiled ? map_word_profile(words, profiled) : NULL;
+    free_compact_microcode(profiled);
+    free_word_profile(words);
+    statement_profile = profile;
+    return profile != NULL;
+}
+
+void stop_using_profile(void) {
+    free_statement_profile(statement_profile);
+    statement_profile = NULL;
+}
+
+bool profiled_runs(const Node* stmt, uint64_t* runs) {
+    const StatementProfile* profile = statement_profile;
+    if (!profile || !stmt) return false;
+    if (stmt->id >= 0 && stmt->id < profile->count && profile->measured[stmt->id]) {
+        *runs = profile->runs[stmt->id];
+        return true;
+    }
+    if (stmt->type != NODE_BLOCK) return false;
+    const BlockNode* block = (const BlockNode*)stmt;
+    for (int i = 0; block->statements && i < block->statements->count; i++) {
+        if (profiled_runs(block->statements->items[i], runs)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool profile_is_hot(uint64_t cycles) {
+    const StatementProfile* profile = statement_profile;
+    return profile && profile->edges > 0 && cycles * 100 >= profile->edges * PROFILE_HOT_PERCENT;
+}
@@ -0,0 +1,70 @@
+#ifndef PROFILE_USE_H
+#define PROFILE_USE_H
+
+#include "ast_to_microcode.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Profile-guided compilation (--profile-use FILE). FILE holds the word
+// counts hotstate_sim --profile wrote as JSON for a run of this program,
+// built with the same options but without the profile. The program is
+// compiled that way once more, each word's count is credited to the
+// outermost statement the word starts, and the real compilation reads the
+// counts per statement:
+//
+// - a while loop is rotated when its body ran hot, and left testing at
+//   the top (one condition test instead of two) when it did not, whatever
+//   --rotate-loops says;
+// - a helper is inlined when its calls ran hot, and shared when it was
+//   cold and one shared copy is smaller, whatever --inline-words says.
+//
+// Loops and helpers the profile has no counts for keep the options'
+// choices.
+
+// What the profiled run saved has to add up to this share of its edges
+// for a construct to count as hot
+#define PROFILE_HOT_PERCENT 1
+
+// Times each word of the profiled program ran, by address
+typedef struct {
+    uint64_t* hits;
+    int words;
+    uint64_t edges;  // Of all words
+} WordProfile;
+
+// Times each statement ran in the profiled run, by Node.id
+typedef struct {
+    uint64_t* runs;
+    bool* measured;  // Some word the statement starts was counted
+    int count;
+    uint64_t edges;
+} StatementProfile;
+
+// Guides ast_to_compact_microcode when set; NULL compiles without a profile
+extern StatementProfile* statement_profile;
+
+// NULL, with a message on stderr, for a file that is missing or holds no
+// "hits" array
+WordProfile* load_word_profile(const char* filename);
+void free_word_profile(WordProfile* profile);
+
+// Credits the counts to the statements mc's words start; NULL, with a
+// warning, when mc is not the program that was profiled
+StatementProfile* map_word_profile(const WordProfile* profile, const CompactMicrocode* mc);
+void free_statement_profile(StatementProfile* profile);
+
+// Loads filename, compiles ast_root once to map it, and sets
+// statement_profile; false, with the reason on stderr, leaves it NULL
+bool use_profile(const char* filename, Node* ast_root, HardwareContext* hw_ctx);
+
+// Frees statement_profile and compiles without one again
+void stop_using_profile(void);
+
+// Times stmt ran, from statement_profile; for a block whose own start was
+// not counted, the first counted statement in it. False when unmeasured.
+bool profiled_runs(const Node* stmt, uint64_t* runs);
+
+// Whether saving cycles over the profiled run is worth a word or a block
+bool profile_is_hot(uint64_t cycles);
+
+#endif // PROFILE_USE_H
@@ -1,8 +1,10 @@
 #define _GNU_SOURCE  // For strdup
 #include "ssa_optimizer.h"
+#include "cfg_builder.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <limits.h>
 
 // --- Context Management ---
 
@@ -32,10 +34,10 @@ OptimizationContext* create_optimization_context(CFG* cfg, HardwareContext* hw_c
         ctx->stats.original_instruction_count += cfg->blocks[i]->instructions->count;
     }
     
-    // Initialize value tracking
-    ctx->value_capacity = 256;  // Start with reasonable capacity
+    // Initialize value tracking, one slot per SSA value id
+    ctx->value_capacity = ssa_value_id_count(cfg) > 0 ? ssa_value_id_count(cfg) : 1;
     ctx->value_count = 0;
-    ctx->value_info = malloc(sizeof(ValueInfo) * ctx->value_capacity);
+    ctx->value_info = calloc(ctx->value_capacity, sizeof(ValueInfo));
     if (!ctx->value_info) {
         free(ctx);
         return NULL;
@@ -62,6 +64,9 @@ CFG* optimize_ssa_cfg(CFG* cfg, HardwareContext* hw_ctx) {
     
     printf("\n--- SSA Optimization Pass ---\n");
     
+    // The passes below assume every value has a single definition
+    construct_ssa_form(cfg);
+    
     OptimizationContext* ctx = create_optimization_context(cfg, hw_ctx);
     if (!ctx) {
         printf("Error: Failed to create optimization context\n");
@@ -70,39 +75,20 @@ CFG* optimize_ssa_cfg(CFG* cfg, HardwareContext* hw_ctx) {
     
     printf("Original instruction count: %d\n", ctx->stats.original_instruction_count);
     
-    // Apply optimization passes in order
-    bool changed = true;
-    int pass = 1;
+    // Each pass runs once: constant propagation is driven by its own
+    // worklist to a fixed point, and the other two only mark values
+    if (ctx->flags.constant_propagation && constant_propagation_pass(ctx)) {
+        printf("  - Constants propagated: %d\n", ctx->stats.constants_propagated);
+        printf("  - Branches folded: %d\n", ctx->stats.branches_folded);
+        printf("  - Unreachable blocks removed: %d\n", ctx->stats.unreachable_blocks_removed);
+    }
     
-    while (changed && pass <= 5) {  // Limit to 5 passes to prevent infinite loops
-        changed = false;
-        printf("Optimization pass %d:\n", pass);
-        
-        // Pass 1: Constant propagation
-        if (ctx->flags.constant_propagation) {
-            if (constant_propagation_pass(ctx)) {
-                changed = true;
-                printf("  - Constants propagated: %d\n", ctx->stats.constants_propagated);
-            }
-        }
-        
-        // Pass 2: Copy propagation
-        if (ctx->flags.copy_propagation) {
-            if (copy_propagation_pass(ctx)) {
-                changed = true;
-                printf("  - Copies propagated: %d\n", ctx->stats.copies_propagated);
-            }
-        }
-        
-        // Pass 3: Dead code elimination
-        if (ctx->flags.dead_code_elimination) {
-            if (dead_code_elimination_pass(ctx)) {
-                changed = true;
-                printf("  - Dead instructions removed: %d\n", ctx->stats.dead_instructions_removed);
-            }
-        }
-        
-        pass++;
+    if (ctx->flags.copy_propagation && copy_propagation_pass(ctx)) {
+        printf("  - Copies propagated: %d\n", ctx->stats.copies_propagated);
+    }
+    
+    if (ctx->flags.dead_code_elimination && dead_code_elimination_pass(ctx)) {
+        printf("  - Dead instructions removed: %d\n", ctx->stats.dead_instructions_removed);
     }
     
     // Count final instructions
@@ -119,28 +105,28 @@ CFG* optimize_ssa_cfg(CFG* cfg, HardwareContext* hw_ctx) {
 // --- Value Analysis Functions ---
 
 ValueInfo* get_value_info(OptimizationContext* ctx, SSAValue* value) {
-    if (!ctx || !value) return NULL;
+    if (!ctx || !value || value->id < 0) return NULL;
     
-    // Look for existing value info
-    for (int i = 0; i < ctx->value_count; i++) {
-        if (ctx->value_info[i].value == value) {
-            return &ctx->value_info[i];
+    // Values created after the context was set up lie past the table
+    if (value->id >= ctx->value_capacity) {
+        int new_capacity = ctx->value_capacity * 2;
+        if (new_capacity <= value->id) {
+            new_capacity = value->id + 1;
         }
-    }
-    
-    // Create new value info if not found
-    if (ctx->value_count >= ctx->value_capacity) {
-        // Expand capacity
-        ctx->value_capacity *= 2;
-        ctx->value_info = realloc(ctx->value_info, sizeof(ValueInfo) * ctx->value_capacity);
-        if (!ctx->value_info) {
+        ValueInfo* grown = realloc(ctx->value_info, sizeof(ValueInfo) * new_capacity);
+        if (!grown) {
             return NULL;
         }
+        memset(grown + ctx->value_capacity, 0, sizeof(ValueInfo) * (new_capacity - ctx->value_capacity));
+        ctx->value_info = grown;
+        ctx->value_capacity = new_capacity;
     }
     
-    ValueInfo* info = &ctx->value_info[ctx->value_count++];
-    memset(info, 0, sizeof(ValueInfo));
-    info->value = value;
+    ValueInfo* info = &ctx->value_info[value->id];
+    if (!info->value) {
+        info->value = value;
+        ctx->value_count++;
+    }
     return info;
 }
 
@@ -211,8 +197,14 @@ bool is_dead_instruction(SSAInstruction* instr, OptimizationContext* ctx) {
         return false;
     }
     
-    // Check if the result is never used
-    if (instr->dest) {
+    // Calls may have effects beyond their result
+    if (instr->type == SSA_CALL) {
+        return false;
+    }
+    
+    // A variable may be a global or output read after the function returns,
+    // so only temporaries are removed
+    if (instr->dest && instr->dest->type == SSA_TEMP) {
         return !is_value_used(instr->dest, ctx);
     }
     
@@ -224,11 +216,7 @@ bool affects_hardware_state(SSAInstruction* instr, HardwareContext* hw_ctx) {
     
     // Check if instruction assigns to a state variable
     if (instr->dest && instr->dest->type == SSA_VAR) {
-        for (int i = 0; i < hw_ctx->state_count; i++) {
-            if (strcmp(instr->dest->data.var.base_name, hw_ctx->states[i].name) == 0) {
-                return true;
-            }
-        }
+        return get_state_number_by_name(hw_ctx, ssa_var_name(instr->dest)) >= 0;
     }
     
     return false;
@@ -266,63 +254,517 @@ SSAValue* get_copy_source(SSAValue* value, OptimizationContext* ctx) {
 
 bool is_value_used(SSAValue* value, OptimizationContext* ctx) {
     if (!value || !ctx) return false;
+    return value->use_count > 0;
+}
+
+// --- Transformation Functions ---
+
+void replace_value_with_constant(OptimizationContext* ctx, SSAValue* value, int constant) {
+    if (!ctx || !value) return;
+    mark_value_as_constant(ctx, value, constant);
+    if (value->use_count > 0) {
+        replace_all_uses(value, create_ssa_const(ctx->cfg, constant));
+    }
+}
+
+void replace_value_with_copy(OptimizationContext* ctx, SSAValue* value, SSAValue* source) {
+    if (!ctx || !value || !source) return;
+    mark_value_as_copy(ctx, value, source);
+    replace_all_uses(value, source);
+}
+
+// Drops instr's operand uses and marks its result dead; the block lists
+// are compacted afterwards by dead_code_elimination_pass
+void remove_dead_instruction(OptimizationContext* ctx, SSAInstruction* instr) {
+    if (!ctx || !instr) return;
+    unlink_ssa_instruction(instr);
+    if (instr->dest) {
+        mark_value_as_dead(ctx, instr->dest);
+    }
+    ctx->stats.dead_instructions_removed++;
+}
+
+// --- Optimization Passes ---
+
+// --- Sparse Conditional Constant Propagation ---
+
+typedef enum {
+    LATTICE_UNDEFINED,               // No executable definition seen yet
+    LATTICE_CONSTANT,
+    LATTICE_OVERDEFINED
+} LatticeLevel;
+
+// Lattice cell for one SSA value, indexed by value id. SSA construction
+// gives every value a single definition, so a cell only needs its level.
+typedef struct {
+    LatticeLevel level;
+    int constant;
+    int def_count;
+    int* uses;                       // Entry numbers reading the value
+    int use_count;
+    int use_capacity;
+} SCCPValue;
+
+// An instruction or a phi node, numbered in block order
+typedef struct {
+    BasicBlock* block;
+    SSAInstruction* instr;
+    PhiNode* phi;
+} SCCPInstr;
+
+typedef struct {
+    OptimizationContext* ctx;
+    SCCPValue* values;
+    int value_count;
+    SCCPInstr* instrs;
+    int instr_count;
+    bool* block_executable;          // Indexed by block id
+    BasicBlock** block_worklist;
+    int block_worklist_count;
+    int* value_worklist;
+    int value_worklist_count;
+    int value_worklist_capacity;
+} SCCPState;
+
+// Index of the cell behind an operand or destination, -1 for constants
+static int sccp_value_index(SCCPState* state, SSAValue* value) {
+    if (!value || value->type == SSA_CONST || value->id < 0 || value->id >= state->value_count) {
+        return -1;
+    }
+    return value->id;
+}
+
+static void sccp_add_use(SCCPValue* value, int instr_number) {
+    if (value->use_count >= value->use_capacity) {
+        value->use_capacity = value->use_capacity ? value->use_capacity * 2 : 4;
+        value->uses = realloc(value->uses, sizeof(int) * value->use_capacity);
+    }
+    value->uses[value->use_count++] = instr_number;
+}
+
+static void sccp_free_state(SCCPState* state) {
+    for (int i = 0; state->values && i < state->value_count; i++) {
+        free(state->values[i].uses);
+    }
+    free(state->values);
+    free(state->instrs);
+    free(state->block_executable);
+    free(state->block_worklist);
+    free(state->value_worklist);
+}
+
+static void sccp_add_entry(SCCPState* state, int number, SSAValue* operand) {
+    int index = sccp_value_index(state, operand);
+    if (index >= 0) {
+        sccp_add_use(&state->values[index], number);
+    }
+}
+
+static void sccp_count_def(SCCPState* state, SSAValue* dest) {
+    int index = sccp_value_index(state, dest);
+    if (index >= 0) {
+        state->values[index].def_count++;
+    }
+}
+
+// Numbers every phi and instruction, builds the use lists and counts
+// definitions
+static bool sccp_init_state(SCCPState* state, OptimizationContext* ctx) {
+    CFG* cfg = ctx->cfg;
+    memset(state, 0, sizeof(SCCPState));
+    state->ctx = ctx;
     
-    // Scan all instructions to see if this value is used
-    for (int i = 0; i < ctx->cfg->block_count; i++) {
-        BasicBlock* block = ctx->cfg->blocks[i];
-        for (int j = 0; j < block->instructions->count; j++) {
+    for (int i = 0; i < cfg->block_count; i++) {
+        state->instr_count += cfg->blocks[i]->instructions->count + cfg->blocks[i]->phi_nodes->count;
+    }
+    
+    state->value_count = ssa_value_id_count(cfg);
+    state->values = calloc(state->value_count + 1, sizeof(SCCPValue));
+    state->instrs = malloc(sizeof(SCCPInstr) * (state->instr_count + 1));
+    state->block_executable = calloc(cfg->next_block_id + 1, sizeof(bool));
+    state->block_worklist = malloc(sizeof(BasicBlock*) * (cfg->next_block_id + 1));
+    if (!state->values || !state->instrs || !state->block_executable || !state->block_worklist) {
+        sccp_free_state(state);
+        return false;
+    }
+    
+    int number = 0;
+    for (int i = 0; i < cfg->block_count; i++) {
+        BasicBlock* block = cfg->blocks[i];
+        for (int j = 0; j < block->phi_nodes->count; j++, number++) {
+            PhiNode* phi = block->phi_nodes->items[j];
+            state->instrs[number] = (SCCPInstr){ block, NULL, phi };
+            for (int k = 0; k < phi->operand_count; k++) {
+                sccp_add_entry(state, number, phi->operands[k].value);
+            }
+            sccp_count_def(state, phi->dest);
+        }
+        for (int j = 0; j < block->instructions->count; j++, number++) {
             SSAInstruction* instr = block->instructions->items[j];
-            
-            // Check operands
+            state->instrs[number] = (SCCPInstr){ block, instr, NULL };
             for (int k = 0; k < instr->operand_count; k++) {
-                if (instr->operands[k] == value) {
-                    return true;
-                }
+                sccp_add_entry(state, number, instr->operands[k]);
             }
+            sccp_count_def(state, instr->dest);
         }
     }
     
-    return false;
+    // Values without a definition (inputs, parameters, variables read
+    // before any assignment) start overdefined, as does anything defined
+    // twice, which only happens in blocks SSA construction did not reach
+    for (int i = 0; i < state->value_count; i++) {
+        SCCPValue* value = &state->values[i];
+        value->level = value->def_count == 1 ? LATTICE_UNDEFINED : LATTICE_OVERDEFINED;
+    }
+    return true;
 }
 
-// --- Optimization Passes ---
+static void sccp_push_value(SCCPState* state, int index) {
+    if (state->value_worklist_count >= state->value_worklist_capacity) {
+        state->value_worklist_capacity = state->value_worklist_capacity ? state->value_worklist_capacity * 2 : 64;
+        state->value_worklist = realloc(state->value_worklist, sizeof(int) * state->value_worklist_capacity);
+    }
+    state->value_worklist[state->value_worklist_count++] = index;
+}
 
-bool constant_propagation_pass(OptimizationContext* ctx) {
-    if (!ctx) return false;
-    int initial_count = ctx->stats.constants_propagated;
-    
-    for (int i = 0; i < ctx->cfg->block_count; i++) {
-        BasicBlock* block = ctx->cfg->blocks[i];
-        
-        for (int j = 0; j < block->instructions->count; j++) {
-            SSAInstruction* instr = block->instructions->items[j];
+static void sccp_visit_phi(SCCPState* state, PhiNode* phi);
+
+// A block reached again, possibly along a new edge, only needs its phis
+// re-evaluated
+static void sccp_mark_block(SCCPState* state, BasicBlock* block) {
+    if (!block) return;
+    if (state->block_executable[block->id]) {
+        for (int i = 0; i < block->phi_nodes->count; i++) {
+            sccp_visit_phi(state, block->phi_nodes->items[i]);
+        }
+        return;
+    }
+    state->block_executable[block->id] = true;
+    state->block_worklist[state->block_worklist_count++] = block;
+}
+
+// Lowers a value in the lattice; a value only ever moves toward overdefined
+static void sccp_set_value(SCCPState* state, int index, LatticeLevel level, int constant) {
+    if (index < 0) return;
+    SCCPValue* value = &state->values[index];
+    if (value->level == LATTICE_OVERDEFINED || level == LATTICE_UNDEFINED) return;
+    if (value->level == LATTICE_CONSTANT) {
+        if (level == LATTICE_CONSTANT && constant == value->constant) return;
+        level = LATTICE_OVERDEFINED;
+    }
+    value->level = level;
+    value->constant = constant;
+    sccp_push_value(state, index);
+}
+
+static LatticeLevel sccp_operand(SCCPState* state, SSAValue* operand, int* constant) {
+    if (!operand) return LATTICE_OVERDEFINED;
+    if (operand->type == SSA_CONST) {
+        *constant = operand->data.const_value;
+        return LATTICE_CONSTANT;
+    }
+    int index = sccp_value_index(state, operand);
+    if (index < 0) return LATTICE_OVERDEFINED;
+    *constant = state->values[index].constant;
+    return state->values[index].level;
+}
+
+static bool sccp_fold_binary(TokenType op, int a, int b, int* result) {
+    unsigned int ua = (unsigned int)a, ub = (unsigned int)b;
+    switch (op) {
+        case TOKEN_PLUS: *result = (int)(ua + ub); return true;
+        case TOKEN_MINUS: *result = (int)(ua - ub); return true;
+        case TOKEN_STAR: *result = (int)(ua * ub); return true;
+        case TOKEN_SLASH:
+            if (b == 0 || (a == INT_MIN && b == -1)) return false;
+            *result = a / b;
+            return true;
+        case TOKEN_AND: *result = a & b; return true;
+        case TOKEN_OR: *result = a | b; return true;
+        case TOKEN_EQUAL: *result = a == b; return true;
+        case TOKEN_NOT_EQUAL: *result = a != b; return true;
+        case TOKEN_LESS: *result = a < b; return true;
+        case TOKEN_LESS_EQUAL: *result = a <= b; return true;
+        case TOKEN_GREATER: *result = a > b; return true;
+        case TOKEN_GREATER_EQUAL: *result = a >= b; return true;
+        case TOKEN_LOGICAL_AND: *result = a && b; return true;
+        case TOKEN_LOGICAL_OR: *result = a || b; return true;
+        default: return false;
+    }
+}
+
+static bool sccp_fold_unary(TokenType op, int a, int* result) {
+    switch (op) {
+        case TOKEN_MINUS: *result = (int)(0u - (unsigned int)a); return true;
+        case TOKEN_NOT: *result = !a; return true;
+        default: return false;
+    }
+}
+
+static BasicBlock* sccp_switch_target(SSAInstruction* instr, int constant) {
+    for (int i = 0; i < instr->data.switch_data.case_count; i++) {
+        if (instr->data.switch_data.cases[i].case_value == constant) {
+            return instr->data.switch_data.cases[i].target_block;
+        }
+    }
+    return instr->data.switch_data.default_target;
+}
+
+static void sccp_visit(SCCPState* state, SSAInstruction* instr) {
+    int a = 0, b = 0, result = 0;
+    LatticeLevel level = LATTICE_OVERDEFINED;
+    
+    switch (instr->type) {
+        case SSA_ASSIGN:
+            if (instr->operand_count >= 1) {
+                level = sccp_operand(state, instr->operands[0], &result);
+            }
+            break;
+            
+        case SSA_BINARY_OP:
+            if (instr->operand_count >= 2) {
+                LatticeLevel left = sccp_operand(state, instr->operands[0], &a);
+                LatticeLevel right = sccp_operand(state, instr->operands[1], &b);
+                if (left == LATTICE_OVERDEFINED || right == LATTICE_OVERDEFINED) {
+                    level = LATTICE_OVERDEFINED;
+                } else if (left == LATTICE_UNDEFINED || right == LATTICE_UNDEFINED) {
+                    level = LATTICE_UNDEFINED;
+                } else {
+                    level = sccp_fold_binary(instr->data.op_data.op, a, b, &result)
+                                ? LATTICE_CONSTANT : LATTICE_OVERDEFINED;
+                }
+            }
+            break;
             
-            if (is_constant_instruction(instr)) {
-                if (instr->type == SSA_ASSIGN && instr->dest) {
-                    // Simple constant assignment: x = 5
-                    mark_value_as_constant(ctx, instr->dest, instr->operands[0]->data.const_value);
+        case SSA_UNARY_OP:
+            if (instr->operand_count >= 1) {
+                level = sccp_operand(state, instr->operands[0], &a);
+                if (level == LATTICE_CONSTANT && !sccp_fold_unary(instr->data.op_data.op, a, &result)) {
+                    level = LATTICE_OVERDEFINED;
                 }
-                else if (instr->type == SSA_BINARY_OP && instr->dest && instr->operand_count >= 2) {
-                    // Constant folding: x = 5 + 3
-                    int val1 = instr->operands[0]->data.const_value;
-                    int val2 = instr->operands[1]->data.const_value;
-                    int result = 0;
-                    
-                    switch (instr->data.op_data.op) {
-                        case TOKEN_PLUS: result = val1 + val2; break;
-                        case TOKEN_MINUS: result = val1 - val2; break;
-                        case TOKEN_STAR: result = val1 * val2; break;
-                        case TOKEN_SLASH: result = (val2 != 0) ? val1 / val2 : 0; break;
-                        default: continue;
-                    }
-                    
-                    mark_value_as_constant(ctx, instr->dest, result);
+            }
+            break;
+            
+        case SSA_BRANCH:
+            level = sccp_operand(state, instr->data.branch_data.condition, &a);
+            if (level == LATTICE_CONSTANT) {
+                sccp_mark_block(state, a ? instr->data.branch_data.true_target
+                                         : instr->data.branch_data.false_target);
+            } else if (level == LATTICE_OVERDEFINED) {
+                sccp_mark_block(state, instr->data.branch_data.true_target);
+                sccp_mark_block(state, instr->data.branch_data.false_target);
+            }
+            return;
+            
+        case SSA_SWITCH:
+            level = sccp_operand(state, instr->data.switch_data.switch_expr, &a);
+            if (level == LATTICE_CONSTANT && sccp_switch_target(instr, a)) {
+                sccp_mark_block(state, sccp_switch_target(instr, a));
+            } else if (level != LATTICE_UNDEFINED) {
+                for (int i = 0; i < instr->data.switch_data.case_count; i++) {
+                    sccp_mark_block(state, instr->data.switch_data.cases[i].target_block);
                 }
+                sccp_mark_block(state, instr->data.switch_data.default_target);
+            }
+            return;
+            
+        case SSA_JUMP:
+            sccp_mark_block(state, instr->data.jump_data.target);
+            return;
+            
+        default:
+            // Calls, loads, phis and anything else are not evaluated
+            break;
+    }
+    
+    if (instr->dest) {
+        sccp_set_value(state, sccp_value_index(state, instr->dest), level, result);
+    }
+}
+
+// Meet of the operands flowing in from executable predecessors
+static void sccp_visit_phi(SCCPState* state, PhiNode* phi) {
+    LatticeLevel level = LATTICE_UNDEFINED;
+    int result = 0;
+    for (int i = 0; i < phi->operand_count && level != LATTICE_OVERDEFINED; i++) {
+        if (!state->block_executable[phi->operands[i].block->id]) continue;
+        int constant = 0;
+        LatticeLevel operand = sccp_operand(state, phi->operands[i].value, &constant);
+        if (operand == LATTICE_OVERDEFINED ||
+            (operand == LATTICE_CONSTANT && level == LATTICE_CONSTANT && constant != result)) {
+            level = LATTICE_OVERDEFINED;
+        } else if (operand == LATTICE_CONSTANT) {
+            level = LATTICE_CONSTANT;
+            result = constant;
+        }
+    }
+    sccp_set_value(state, sccp_value_index(state, phi->dest), level, result);
+}
+
+static bool sccp_is_conditional(SSAInstruction* instr) {
+    return instr && (instr->type == SSA_BRANCH || instr->type == SSA_SWITCH);
+}
+
+static void sccp_visit_block(SCCPState* state, BasicBlock* block) {
+    for (int i = 0; i < block->phi_nodes->count; i++) {
+        sccp_visit_phi(state, block->phi_nodes->items[i]);
+    }
+    InstructionList* list = block->instructions;
+    for (int i = 0; i < list->count; i++) {
+        sccp_visit(state, list->items[i]);
+    }
+    // Blocks not ending in a branch or switch fall through to every successor
+    if (list->count == 0 || !sccp_is_conditional(list->items[list->count - 1])) {
+        for (int i = 0; i < block->successor_count; i++) {
+            sccp_mark_block(state, block->successors[i]);
+        }
+    }
+}
+
+static void sccp_solve(SCCPState* state) {
+    while (state->block_worklist_count > 0 || state->value_worklist_count > 0) {
+        if (state->block_worklist_count > 0) {
+            sccp_visit_block(state, state->block_worklist[--state->block_worklist_count]);
+            continue;
+        }
+        SCCPValue* value = &state->values[state->value_worklist[--state->value_worklist_count]];
+        for (int i = 0; i < value->use_count; i++) {
+            SCCPInstr* use = &state->instrs[value->uses[i]];
+            if (!state->block_executable[use->block->id]) {
+                continue;
+            }
+            if (use->phi) {
+                sccp_visit_phi(state, use->phi);
+            } else {
+                sccp_visit(state, use->instr);
+            }
+        }
+    }
+}
+
+// A condition still undefined at the fixed point has no executable
+// definition; treating it as overdefined keeps both arms. Returns whether
+// any condition changed, in which case the solver must run again.
+static bool sccp_resolve_undefined_conditions(SCCPState* state) {
+    bool changed = false;
+    for (int i = 0; i < state->instr_count; i++) {
+        SCCPInstr* entry = &state->instrs[i];
+        if (!state->block_executable[entry->block->id] || !sccp_is_conditional(entry->instr)) {
+            continue;
+        }
+        int index = sccp_value_index(state, entry->instr->operands[0]);
+        if (index >= 0 && state->values[index].level == LATTICE_UNDEFINED) {
+            sccp_set_value(state, index, LATTICE_OVERDEFINED, 0);
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+// Turns a branch or switch into a jump to target and drops its other edges
+static void sccp_fold_to_jump(BasicBlock* block, SSAInstruction* instr, BasicBlock* target) {
+    int i = 0;
+    while (i < block->successor_count) {
+        if (block->successors[i] != target) {
+            remove_edge(block, block->successors[i]);
+        } else {
+            i++;
+        }
+    }
+    unlink_ssa_instruction(instr);
+    if (instr->type == SSA_SWITCH) {
+        free(instr->data.switch_data.cases);
+    }
+    instr->operands = NULL;  // Its one operand was inline
+    instr->operand_count = 0;
+    instr->type = SSA_JUMP;
+    instr->data.jump_data.target = target;
+}
+
+// Writes the solution back: uses of constant values become literals,
+// decided branches become jumps and blocks never reached are removed
+static void sccp_rewrite(SCCPState* state) {
+    OptimizationContext* ctx = state->ctx;
+    CFG* cfg = ctx->cfg;
+    
+    for (int i = 0; i < state->instr_count; i++) {
+        SCCPInstr* entry = &state->instrs[i];
+        SSAValue* dest = entry->phi ? entry->phi->dest : entry->instr->dest;
+        if (!state->block_executable[entry->block->id]) {
+            continue;
+        }
+        
+        int constant = 0;
+        if (dest && sccp_operand(state, dest, &constant) == LATTICE_CONSTANT) {
+            replace_value_with_constant(ctx, dest, constant);
+        }
+    }
+    
+    for (int i = 0; i < state->instr_count; i++) {
+        SCCPInstr* entry = &state->instrs[i];
+        SSAInstruction* instr = entry->instr;
+        if (!state->block_executable[entry->block->id]) {
+            continue;
+        }
+        
+        if (sccp_is_conditional(instr) && instr->operands[0] && instr->operands[0]->type == SSA_CONST) {
+            int value = instr->operands[0]->data.const_value;
+            BasicBlock* target = instr->type == SSA_BRANCH
+                ? (value ? instr->data.branch_data.true_target : instr->data.branch_data.false_target)
+                : sccp_switch_target(instr, value);
+            if (target) {
+                sccp_fold_to_jump(entry->block, instr, target);
+                ctx->stats.branches_folded++;
             }
         }
     }
     
-    return (ctx->stats.constants_propagated > initial_count);
+    // The exit block is kept even when unreachable, since cfg->exit names it.
+    // Dropping a removed block's edges also drops its phi operands.
+    int kept = 0;
+    for (int i = 0; i < cfg->block_count; i++) {
+        BasicBlock* block = cfg->blocks[i];
+        if (state->block_executable[block->id] || block == cfg->exit) {
+            cfg->blocks[kept++] = block;
+            continue;
+        }
+        while (block->successor_count > 0) {
+            remove_edge(block, block->successors[0]);
+        }
+        while (block->predecessor_count > 0) {
+            remove_edge(block->predecessors[0], block);
+        }
+        free_basic_block(block);
+        ctx->stats.unreachable_blocks_removed++;
+    }
+    cfg->block_count = kept;
+}
+
+// Sparse conditional constant propagation (Wegman-Zadeck). Values are only
+// re-evaluated when one of their operands changes, and only in blocks
+// proven reachable, so constant branch conditions also prune code.
+bool constant_propagation_pass(OptimizationContext* ctx) {
+    if (!ctx || !ctx->cfg->entry) return false;
+    int initial_constants = ctx->stats.constants_propagated;
+    int initial_branches = ctx->stats.branches_folded;
+    int initial_blocks = ctx->stats.unreachable_blocks_removed;
+    
+    SCCPState state;
+    if (!sccp_init_state(&state, ctx)) {
+        return false;
+    }
+    
+    sccp_mark_block(&state, ctx->cfg->entry);
+    do {
+        sccp_solve(&state);
+    } while (sccp_resolve_undefined_conditions(&state));
+    
+    sccp_rewrite(&state);
+    sccp_free_state(&state);
+    
+    return ctx->stats.constants_propagated > initial_constants ||
+           ctx->stats.branches_folded > initial_branches ||
+           ctx->stats.unreachable_blocks_removed > initial_blocks;
 }
 
 bool copy_propagation_pass(OptimizationContext* ctx) {
@@ -349,20 +791,60 @@ bool dead_code_elimination_pass(OptimizationContext* ctx) {
     if (!ctx) return false;
     int initial_count = ctx->stats.dead_instructions_removed;
     
+    // Each instruction is queued once up front, and again at most once per
+    // operand use dropped
+    int capacity = 0;
     for (int i = 0; i < ctx->cfg->block_count; i++) {
-        BasicBlock* block = ctx->cfg->blocks[i];
+        InstructionList* list = ctx->cfg->blocks[i]->instructions;
+        capacity += list->count;
+        for (int j = 0; j < list->count; j++) {
+            capacity += list->items[j]->operand_count;
+        }
+    }
+    SSAInstruction** worklist = malloc(sizeof(SSAInstruction*) * (capacity + 1));
+    if (!worklist) return false;
+    int count = 0;
+    
+    for (int i = 0; i < ctx->cfg->block_count; i++) {
+        InstructionList* list = ctx->cfg->blocks[i]->instructions;
+        for (int j = 0; j < list->count; j++) {
+            if (is_dead_instruction(list->items[j], ctx)) {
+                worklist[count++] = list->items[j];
+            }
+        }
+    }
+    
+    // Removing an instruction drops its operand uses, which can leave the
+    // instructions defining those operands dead in turn
+    while (count > 0) {
+        SSAInstruction* instr = worklist[--count];
+        ValueInfo* info = get_value_info(ctx, instr->dest);
+        if (info && info->is_dead) continue;
         
-        // Mark dead instructions (scan backwards to handle dependencies)
-        for (int j = block->instructions->count - 1; j >= 0; j--) {
-            SSAInstruction* instr = block->instructions->items[j];
-            
-            if (is_dead_instruction(instr, ctx)) {
-                if (instr->dest) {
-                    mark_value_as_dead(ctx, instr->dest);
-                }
-                ctx->stats.dead_instructions_removed++;
+        remove_dead_instruction(ctx, instr);
+        for (int k = 0; k < instr->operand_count; k++) {
+            SSAValue* operand = instr->operands[k];
+            if (operand && operand->def && count < capacity && is_dead_instruction(operand->def, ctx)) {
+                worklist[count++] = operand->def;
+            }
+        }
+    }
+    free(worklist);
+    
+    // Sweep the removed instructions out of their blocks
+    for (int i = 0; i < ctx->cfg->block_count; i++) {
+        InstructionList* list = ctx->cfg->blocks[i]->instructions;
+        int kept = 0;
+        for (int j = 0; j < list->count; j++) {
+            SSAInstruction* instr = list->items[j];
+            ValueInfo* info = instr->dest ? get_value_info(ctx, instr->dest) : NULL;
+            if (info && info->is_dead) {
+                free_ssa_instruction(instr);
+            } else {
+                list->items[kept++] = instr;
             }
         }
+        list->count = kept;
     }
     
     return (ctx->stats.dead_instructions_removed > initial_count);
@@ -381,6 +863,8 @@ void print_optimization_stats(OptimizationStats* stats) {
            100.0 * (stats->original_instruction_count - stats->optimized_instruction_count) / 
            (float)stats->original_instruction_count);
     printf("Constants propagated: %d\n", stats->constants_propagated);
+    printf("Branches folded: %d\n", stats->branches_folded);
+    printf("Unreachable blocks removed: %d\n", stats->unreachable_blocks_removed);
     printf("Copies propagated: %d\n", stats->copies_propagated);
     printf("Dead instructions removed: %d\n", stats->dead_instructions_removed);
     printf("\n");
@@ -17,13 +17,15 @@ typedef struct {
     int original_instruction_count;
     int optimized_instruction_count;
     int constants_propagated;
+    int branches_folded;
+    int unreachable_blocks_removed;
     int copies_propagated;
     int dead_instructions_removed;
 } OptimizationStats;
 
 // Value tracking for optimization
 typedef struct {
-    SSAValue* value;
+    SSAValue* value;            // NULL until the value is first looked up
     bool is_constant;
     int constant_value;
     bool is_copy;
@@ -37,9 +39,9 @@ typedef struct {
     HardwareContext* hw_ctx;
     OptimizationFlags flags;
     OptimizationStats stats;
-    ValueInfo* value_info;
-    int value_count;
-    int value_capacity;
+    ValueInfo* value_info;      // Indexed by SSAValue id
+    int value_count;            // Values with an entry
+    int value_capacity;         // Length of value_info
 } OptimizationContext;
 
 // --- Core Optimization Functions ---
@@ -47,7 +49,8 @@ typedef struct {
 // Main optimization entry point
 CFG* optimize_ssa_cfg(CFG* cfg, HardwareContext* hw_ctx);
 
-// Individual optimization passes
+// Individual optimization passes. Constant propagation is sparse and
+// conditional: it folds constant branches and removes unreachable blocks.
 bool constant_propagation_pass(OptimizationContext* ctx);
 bool copy_propagation_pass(OptimizationContext* ctx);
 bool dead_code_elimination_pass(OptimizationContext* ctx);
@@ -8,9 +8,6 @@
 #include "cfg_builder.h"
 #include "cfg_utils.h"
 
-// Global debug flag for test executable
-int debug_mode = 0;
-
 void test_simple_function() {
     const char* code =
         "int main() {\n"
@@ -35,7 +32,7 @@ void test_simple_function() {
     lexer_destroy(lexer);
     
     // Parse the code
-    Parser* parser = parser_create(tokens, token_count);
+    Parser* parser = parser_create(code, tokens, token_count);
     Node* ast = parse(parser);
     
     if (!ast) {
@@ -102,7 +99,7 @@ void test_if_statement() {
     lexer_destroy(lexer);
     
     // Parse the code
-    Parser* parser = parser_create(tokens, token_count);
+    Parser* parser = parser_create(code, tokens, token_count);
     Node* ast = parse(parser);
     
     if (!ast) {
@@ -167,7 +164,7 @@ void test_while_loop() {
     lexer_destroy(lexer);
     
     // Parse the code
-    Parser* parser = parser_create(tokens, token_count);
+    Parser* parser = parser_create(code, tokens, token_count);
     Node* ast = parse(parser);
     
     if (!ast) {
@@ -230,7 +227,7 @@ void test_for_loop() {
     lexer_destroy(lexer);
     
     // Parse the code
-    Parser* parser = parser_create(tokens, token_count);
+    Parser* parser = parser_create(code, tokens, token_count);
     Node* ast = parse(parser);
     
     if (!ast) {
@@ -303,7 +300,7 @@ void test_arrays_and_booleans() {
     lexer_destroy(lexer);
     
     // Parse the code
-    Parser* parser = parser_create(tokens, token_count);
+    Parser* parser = parser_create(code, tokens, token_count);
     Node* ast = parse(parser);
     
     if (!ast) {
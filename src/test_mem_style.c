@@ -0,0 +1,79 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "verilog_generator.h"
+
+static int failures = 0;
+
+static void expect_style(const char* what, MemStyle actual, MemStyle expected) {
+    if (actual == expected) {
+        printf("  PASS %s: %s\n", what, mem_style_name(actual));
+    } else {
+        printf("  FAIL %s: %s, expected %s\n", what, mem_style_name(actual), mem_style_name(expected));
+        failures++;
+    }
+}
+
+void test_depth_threshold() {
+    printf("=== Testing Depth Threshold (%d words) ===\n", MEM_STYLE_LUTRAM_DEPTH);
+
+    // Wide enough that only the depth decides
+    expect_style("below depth", choose_mem_style(MEM_STYLE_LUTRAM_DEPTH - 1, 1024), MEM_STYLE_DISTRIBUTED);
+    expect_style("at depth", choose_mem_style(MEM_STYLE_LUTRAM_DEPTH, 1024), MEM_STYLE_DISTRIBUTED);
+    expect_style("above depth", choose_mem_style(MEM_STYLE_LUTRAM_DEPTH + 1, 1024), MEM_STYLE_BLOCK);
+}
+
+void test_bit_threshold() {
+    printf("=== Testing Bit Threshold (%d bits) ===\n", MEM_STYLE_BLOCK_BITS);
+
+    // Deep enough that only the bit count decides: 128 words of 36 bits
+    // is exactly MEM_STYLE_BLOCK_BITS
+    long long words = 128;
+    int width = MEM_STYLE_BLOCK_BITS / words;
+    expect_style("below bits", choose_mem_style(words, width - 1), MEM_STYLE_DISTRIBUTED);
+    expect_style("at bits", choose_mem_style(words, width), MEM_STYLE_BLOCK);
+    expect_style("above bits", choose_mem_style(words, width + 1), MEM_STYLE_BLOCK);
+    expect_style("one bit short", choose_mem_style(MEM_STYLE_BLOCK_BITS - 1, 1), MEM_STYLE_DISTRIBUTED);
+}
+
+void test_mem_style_override() {
+    printf("=== Testing --mem-style Override ===\n");
+
+    // A small program: every memory is distributed when sized automatically
+    HardwareContext hw_ctx;
+    memset(&hw_ctx, 0, sizeof(hw_ctx));
+    hw_ctx.state_count = 2;
+    hw_ctx.input_count = 2;
+    HotstateMicrocode mc;
+    memset(&mc, 0, sizeof(mc));
+    mc.instruction_count = 8;
+    mc.hw_ctx = &hw_ctx;
+
+    MemStyle styles[] = {MEM_STYLE_AUTO, MEM_STYLE_BLOCK, MEM_STYLE_REGISTERS, MEM_STYLE_DISTRIBUTED};
+    for (size_t i = 0; i < sizeof(styles) / sizeof(styles[0]); i++) {
+        VerilogModule vm;
+        memset(&vm, 0, sizeof(vm));
+        verilog_mem_style = styles[i];
+        calculate_hotstate_parameters(&vm, &mc);
+        MemStyle expected = styles[i] == MEM_STYLE_AUTO ? MEM_STYLE_DISTRIBUTED : styles[i];
+        char what[64];
+        snprintf(what, sizeof(what), "--mem-style %s smdata", mem_style_name(styles[i]));
+        expect_style(what, vm.mc_mem_style, expected);
+        snprintf(what, sizeof(what), "--mem-style %s vardata", mem_style_name(styles[i]));
+        expect_style(what, vm.vr_mem_style, expected);
+        snprintf(what, sizeof(what), "--mem-style %s switchdata", mem_style_name(styles[i]));
+        expect_style(what, vm.sw_mem_style, expected);
+    }
+    verilog_mem_style = MEM_STYLE_AUTO;
+}
+
+int main() {
+    printf("=== Memory Style Test ===\n\n");
+
+    test_depth_threshold();
+    test_bit_threshold();
+    test_mem_style_override();
+
+    printf("\n=== %s ===\n", failures == 0 ? "All tests passed" : "Some tests failed");
+    return failures == 0 ? 0 : 1;
+}
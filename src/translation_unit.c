@@ -0,0 +1,359 @@
+#define _GNU_SOURCE  // For fork, waitpid and _SC_NPROCESSORS_ONLN
+#include "translation_unit.h"
+#include "ast_serialize.h"
+#include "ast_flat.h"
+#include "parser.h"
+#include "preprocessor.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+// Bump when the layout changes. UNIT_MAGIC; uint64 hash of the preprocessed
+// source (FNV-1a, never 0); the unit's program node, as ast_write_node
+// writes it.
+#define UNIT_MAGIC "HSOBJ001"
+#define UNIT_MAGIC_SIZE 8
+
+// A worker's exit status; anything else is a failure
+#define UNIT_COMPILED 0
+#define UNIT_UP_TO_DATE 3
+
+// a.c -> a.hso; a name without .c gets the suffix added
+static char* object_path_for(const char* file) {
+    size_t length = strlen(file);
+    if (length > 2 && strcmp(file + length - 2, ".c") == 0) length -= 2;
+    char* path = malloc(length + sizeof(UNIT_OBJECT_SUFFIX));
+    if (path) {
+        memcpy(path, file, length);
+        memcpy(path + length, UNIT_OBJECT_SUFFIX, sizeof(UNIT_OBJECT_SUFFIX));
+    }
+    return path;
+}
+
+static uint64_t source_hash(const char* source) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (const unsigned char* p = (const unsigned char*)source; *p; p++) {
+        h ^= *p;
+        h *= 0x100000001b3ULL;
+    }
+    return h ? h : 1;
+}
+
+// The source hash an object was made from; 0 if there is none to read
+static uint64_t object_source_hash(const char* object_path) {
+    FILE* file = fopen(object_path, "rb");
+    if (!file) return 0;
+    char magic[UNIT_MAGIC_SIZE];
+    uint64_t hash = 0;
+    if (fread(magic, 1, UNIT_MAGIC_SIZE, file) != UNIT_MAGIC_SIZE ||
+        memcmp(magic, UNIT_MAGIC, UNIT_MAGIC_SIZE) != 0 || fread(&hash, sizeof(hash), 1, file) != 1) {
+        hash = 0;
+    }
+    fclose(file);
+    return hash;
+}
+
+// --- Compiling ---
+
+// Run in a worker: a parse error exits it, which the parent reports
+static int compile_unit(const char* file) {
+    char* object_path = object_path_for(file);
+    char* source = object_path ? preprocess_includes(file) : NULL;
+    if (!source) {
+        fprintf(stderr, "Error: Failed to preprocess file '%s'\n", file);
+        free(object_path);
+        return 1;
+    }
+    uint64_t hash = source_hash(source);
+    if (object_source_hash(object_path) == hash) {
+        free(source);
+        free(object_path);
+        return UNIT_UP_TO_DATE;
+    }
+
+    Arena* arena = arena_create(ARENA_DEFAULT_CHUNK_SIZE);
+    ast_set_arena(arena);
+    TokenList* tokens = lexer_tokenize(source, arena);
+    Parser* parser = parser_create(source, tokens->items, tokens->count);
+    Node* program = parse(parser);
+    parser_destroy(parser);
+
+    AstWriter w = { 0 };
+    ast_write(&w, UNIT_MAGIC, UNIT_MAGIC_SIZE);
+    ast_write_u64(&w, hash);
+    ast_write_node(&w, program);
+    bool ok = ast_write_file(object_path, &w);
+    if (!ok) {
+        fprintf(stderr, "Error: Cannot write %s\n", object_path);
+    }
+
+    free(w.data);
+    free_token_list(tokens);
+    ast_set_arena(NULL);
+    arena_destroy(arena);
+    free(source);
+    free(object_path);
+    return ok ? UNIT_COMPILED : 1;
+}
+
+bool compile_units(char* const* files, int count, int jobs) {
+    if (jobs <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        jobs = cpus > 0 ? (int)cpus : 1;
+    }
+    pid_t* workers = calloc(count, sizeof(pid_t));
+    int* results = malloc(count * sizeof(int));
+    if (!workers || !results) {
+        fprintf(stderr, "Error: Failed to allocate worker tables\n");
+        free(workers);
+        free(results);
+        return false;
+    }
+
+    for (int i = 0; i < count; i++) {
+        results[i] = 1;
+    }
+
+    // Output buffered now would be written again by every worker
+    fflush(NULL);
+    int next = 0, running = 0;
+    while (next < count || running > 0) {
+        if (next < count && running < jobs) {
+            pid_t pid = fork();
+            if (pid == 0) {
+                int result = compile_unit(files[next]);
+                fflush(NULL);
+                _exit(result);
+            }
+            if (pid < 0) {
+                fprintf(stderr, "Error: Cannot start a worker for '%s'\n", files[next]);
+                results[next] = 1;
+            } else {
+                workers[next] = pid;
+                running++;
+            }
+            next++;
+            continue;
+        }
+
+        int status;
+        pid_t done = waitpid(-1, &status, 0);
+        if (done < 0) break;
+        for (int i = 0; i < next; i++) {
+            if (workers[i] == done) {
+                results[i] = WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+                workers[i] = 0;
+                running--;
+                break;
+            }
+        }
+    }
+
+    int compiled = 0, up_to_date = 0;
+    bool ok = true;
+    for (int i = 0; i < count; i++) {
+        if (results[i] == UNIT_COMPILED) {
+            compiled++;
+        } else if (results[i] == UNIT_UP_TO_DATE) {
+            up_to_date++;
+        } else {
+            fprintf(stderr, "Error: '%s' did not compile\n", files[i]);
+            ok = false;
+        }
+    }
+    if (ok) {
+        printf("Compiled %d of %d units, %d up to date\n", compiled, count, up_to_date);
+    }
+    free(workers);
+    free(results);
+    return ok;
+}
+
+// --- Linking ---
+
+// A function or global seen so far, with the unit that brought it
+typedef struct {
+    const char* name;  // Owned by the AST
+    int unit;
+    bool function;
+    AstWriter declaration;  // A global's declaration, serialized for comparing
+} LinkSymbol;
+
+typedef struct {
+    char* const* files;
+    LinkSymbol* symbols;
+    int symbol_count;
+    int symbol_capacity;
+    bool failed;
+} Linker;
+
+static LinkSymbol* find_link_symbol(Linker* linker, const char* name) {
+    for (int i = 0; i < linker->symbol_count; i++) {
+        if (strcmp(linker->symbols[i].name, name) == 0) return &linker->symbols[i];
+    }
+    return NULL;
+}
+
+static LinkSymbol* add_link_symbol(Linker* linker, const char* name, int unit, bool function) {
+    if (linker->symbol_count == linker->symbol_capacity) {
+        int capacity = linker->symbol_capacity ? linker->symbol_capacity * 2 : 64;
+        LinkSymbol* grown = realloc(linker->symbols, capacity * sizeof(LinkSymbol));
+        if (!grown) {
+            fprintf(stderr, "Error: Failed to allocate the symbol table\n");
+            linker->failed = true;
+            return NULL;
+        }
+        linker->symbols = grown;
+        linker->symbol_capacity = capacity;
+    }
+    LinkSymbol* symbol = &linker->symbols[linker->symbol_count++];
+    memset(symbol, 0, sizeof(*symbol));
+    symbol->name = name;
+    symbol->unit = unit;
+    symbol->function = function;
+    return symbol;
+}
+
+// Whether unit's global declaration goes into the program: false for a
+// repeat of an earlier unit's, or one that conflicts with it
+static bool link_declaration(Linker* linker, VarDeclNode* decl, int unit) {
+    AstWriter encoded = { 0 };
+    ast_write_node(&encoded, (Node*)decl);
+    LinkSymbol* symbol = find_link_symbol(linker, decl->var_name);
+    if (!symbol) {
+        symbol = add_link_symbol(linker, decl->var_name, unit, false);
+        if (symbol) {
+            symbol->declaration = encoded;
+        } else {
+            free(encoded.data);
+        }
+        return true;
+    }
+
+    // Repeats within one unit stay, as they would compiled on their own
+    bool same = !symbol->function && symbol->declaration.length == encoded.length &&
+                memcmp(symbol->declaration.data, encoded.data, encoded.length) == 0;
+    free(encoded.data);
+    if (symbol->unit == unit) return true;
+    if (!same) {
+        fprintf(stderr, "Error: '%s' is declared differently in %s and %s\n",
+                decl->var_name, linker->files[symbol->unit], linker->files[unit]);
+        linker->failed = true;
+    }
+    return false;
+}
+
+static void link_function(Linker* linker, FunctionDefNode* func, int unit) {
+    LinkSymbol* symbol = find_link_symbol(linker, func->name);
+    if (!symbol) {
+        add_link_symbol(linker, func->name, unit, true);
+    } else if (symbol->unit != unit) {
+        fprintf(stderr, "Error: '%s' is defined in both %s and %s\n",
+                func->name, linker->files[symbol->unit], linker->files[unit]);
+        linker->failed = true;
+    }
+}
+
+// Adds unit's items to program
+static void link_unit(Linker* linker, ProgramNode* unit_program, int unit, ProgramNode* program) {
+    NodeList* items = unit_program->functions;
+    for (int i = 0; i < items->count; i++) {
+        Node* item = items->items[i];
+        if (item->type == NODE_FUNCTION_DEF) {
+            link_function(linker, (FunctionDefNode*)item, unit);
+        } else if (item->type == NODE_VAR_DECL) {
+            if (!link_declaration(linker, (VarDeclNode*)item, unit)) continue;
+        } else if (item->type == NODE_BLOCK) {
+            // int a, b; keeps the declarations not already linked
+            NodeList* statements = ((BlockNode*)item)->statements;
+            int kept = 0;
+            for (int j = 0; j < statements->count; j++) {
+                Node* statement = statements->items[j];
+                if (statement->type != NODE_VAR_DECL || link_declaration(linker, (VarDeclNode*)statement, unit)) {
+                    statements->items[kept++] = statement;
+                }
+            }
+            statements->count = kept;
+            if (kept == 0) continue;
+        }
+        add_node_to_list(program->functions, item);
+    }
+}
+
+// Warns of calls in unit's function to functions no unit defines
+static void check_calls(Linker* linker, Node* func, int unit) {
+    FlatAst* flat = flatten_ast(func);
+    if (!flat) return;
+    for (uint32_t i = 0; i < flat->count; i++) {
+        if (flat->nodes[i]->type != NODE_FUNCTION_CALL) continue;
+        const char* name = ((FunctionCallNode*)flat->nodes[i])->name;
+        LinkSymbol* symbol = find_link_symbol(linker, name);
+        if ((!symbol || !symbol->function) && strcmp(name, "delay") != 0) {
+            fprintf(stderr, "Warning: %s calls '%s', which no unit defines\n", linker->files[unit], name);
+        }
+    }
+    free_flat_ast(flat);
+}
+
+// The unit's program, read from its object
+static ProgramNode* read_unit(const char* file) {
+    char* object_path = object_path_for(file);
+    size_t size = 0;
+    uint8_t* data = object_path ? ast_read_file(object_path, &size) : NULL;
+    AstReader r = { data, size, 0 };
+    char magic[UNIT_MAGIC_SIZE];
+    uint64_t hash;
+    Node* program = NULL;
+    bool ok = data && ast_read(&r, magic, UNIT_MAGIC_SIZE) && memcmp(magic, UNIT_MAGIC, UNIT_MAGIC_SIZE) == 0 &&
+              ast_read_u64(&r, &hash) && ast_read_node(&r, &program) && program &&
+              program->type == NODE_PROGRAM && r.pos == size;
+    if (!ok) {
+        fprintf(stderr, "Error: %s is not an object this compiler reads\n", object_path ? object_path : file);
+    }
+    free(data);
+    free(object_path);
+    return ok ? (ProgramNode*)program : NULL;
+}
+
+Node* link_units(char* const* files, int count) {
+    ast_reset_node_ids();
+    ProgramNode* program = (ProgramNode*)create_program_node();
+    Linker linker = { .files = files };
+    int* item_units = NULL;  // The unit each linked item came from
+    for (int unit = 0; unit < count && !linker.failed; unit++) {
+        ProgramNode* unit_program = read_unit(files[unit]);
+        if (!unit_program) {
+            linker.failed = true;
+            break;
+        }
+        int before = program->functions->count;
+        link_unit(&linker, unit_program, unit, program);
+        int* grown = realloc(item_units, (program->functions->count + 1) * sizeof(int));
+        if (!grown) {
+            linker.failed = true;
+            break;
+        }
+        item_units = grown;
+        for (int i = before; i < program->functions->count; i++) {
+            item_units[i] = unit;
+        }
+    }
+
+    if (!linker.failed) {
+        for (int i = 0; i < program->functions->count; i++) {
+            if (program->functions->items[i]->type == NODE_FUNCTION_DEF) {
+                check_calls(&linker, program->functions->items[i], item_units[i]);
+            }
+        }
+    }
+
+    for (int i = 0; i < linker.symbol_count; i++) {
+        free(linker.symbols[i].declaration.data);
+    }
+    free(linker.symbols);
+    free(item_units);
+    return linker.failed ? NULL : (Node*)program;
+}
@@ -0,0 +1,34 @@
+#ifndef TRANSLATION_UNIT_H
+#define TRANSLATION_UNIT_H
+
+#include "ast.h"
+#include <stdbool.h>
+
+// Separate compilation of a program spread over several files
+// (c_parser a.c b.c ...). Each file is a translation unit: worker
+// processes, several at once, preprocess and parse the units into objects
+// next to them (a.c -> a.hso), serialized trees of their items stamped
+// with a hash of the preprocessed source. A unit whose source still hashes
+// the same as its object is not parsed again.
+//
+// Linking reads the objects back in command-line order into one program.
+// A global declared the same way in several units, usually through a
+// shared header, is kept once; different declarations of one name, or a
+// function defined twice, do not link. Code generation then runs on the
+// linked program as a whole, since state and input numbers, the vardata
+// LUT's address bits and the varsel and switch numbering are all decided
+// over every function.
+
+#define UNIT_OBJECT_SUFFIX ".hso"
+
+// Brings each file's object up to date, running up to jobs workers at once
+// (one per online CPU for 0). False if a unit failed to compile, with its
+// errors on stderr.
+bool compile_units(char* const* files, int count, int jobs);
+
+// The units' objects linked into one program, in the current AST arena and
+// numbered from 0 like a parsed tree; NULL, with the reasons on stderr, if
+// they do not link. Calls to functions no unit defines draw a warning.
+Node* link_units(char* const* files, int count);
+
+#endif // TRANSLATION_UNIT_H
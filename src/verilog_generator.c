@@ -4,18 +4,31 @@
 #endif
 
 #include "verilog_generator.h"
+#include "output_file.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #define MAX_VARIABLES 32
 
+MemStyle verilog_mem_style = MEM_STYLE_AUTO;
+SimHarnessOptions verilog_sim_harness = { false, SIM_HARNESS_THREADS, 0, -1, NULL };
+
 // --- Forward Declarations ---
 void generate_verilog_module_file(VerilogModule* vm, const char* filename);
 void generate_verilog_testbench_file(VerilogModule* vm, const char* filename);
 void generate_simulation_makefile(VerilogModule* vm, const char* filename);
 void generate_sim_main_cpp(VerilogModule* vm, const char* filename);
 void generate_verilator_sim_h(VerilogModule* vm, const char* filename);
+void generate_cosim_wrapper_file(VerilogModule* vm, const char* filename);
+void generate_verilator_cosim_h(VerilogModule* vm, const char* filename);
+static MemStyle resolve_mem_style(long long words, int width);
+static uint64_t vardata_file_entries(int input_count);
+
+// The harness traces only part of the run
+static bool sim_trace_windowed(const VerilogModule* vm) {
+    return vm->trace_output >= 0 || verilog_sim_harness.trace_start > 0 || verilog_sim_harness.trace_end >= 0;
+}
 
 // --- Main Generation Function ---
 
@@ -25,6 +38,19 @@ void generate_verilog_hdl(HotstateMicrocode* mc, const char* source_filename, Ve
         fprintf(stderr, "Error: Failed to create Verilog module\n");
         return;
     }
+    vm->stack_depth = options->stack_depth;
+    vm->core_count = options->core_count;
+    if (verilog_sim_harness.trace_when) {
+        for (int i = 0; i < vm->output_count; i++) {
+            if (strcmp(vm->output_names[i], verilog_sim_harness.trace_when) == 0) {
+                vm->trace_output = i;
+            }
+        }
+        if (vm->trace_output < 0) {
+            fprintf(stderr, "Warning: --trace-when: '%s' is not an output of %s; tracing every cycle\n",
+                    verilog_sim_harness.trace_when, vm->module_name);
+        }
+    }
     
     printf("Generating Verilog files for module: %s\n", vm->module_name);
     printf("Detected %d input variables: ", vm->input_count);
@@ -41,7 +67,11 @@ void generate_verilog_hdl(HotstateMicrocode* mc, const char* source_filename, Ve
     // Generate module file
     if (options->generate_module || options->generate_all) {
         char* module_filename = generate_verilog_filename(vm->base_filename, "_template.v");
-        generate_verilog_module_file(vm, module_filename);
+        if (vm->core_count > 0) {
+            generate_partition_module_file(vm, options->state_owner, module_filename);
+        } else {
+            generate_verilog_module_file(vm, module_filename);
+        }
         printf("Generated Verilog module: %s\n", module_filename);
         free(module_filename);
     }
@@ -63,12 +93,21 @@ void generate_verilog_hdl(HotstateMicrocode* mc, const char* source_filename, Ve
         generate_sim_main_cpp(vm, "sim_main.cpp");
         generate_verilator_sim_h(vm, "verilator_sim.h");
         printf("Generated simulation support files: sim_main.cpp, verilator_sim.h\n");
+        
+        // Co-simulation against the C++ model
+        char* cosim_filename = generate_verilog_filename(vm->base_filename, "_cosim.v");
+        generate_cosim_wrapper_file(vm, cosim_filename);
+        generate_verilator_cosim_h(vm, "verilator_cosim.h");
+        printf("Generated co-simulation files: %s, verilator_cosim.h\n", cosim_filename);
+        free(cosim_filename);
     }
     
     // Generate user stimulus file
     if (options->generate_user_stim || options->generate_all) {
-        generate_user_stimulus_file(vm, "user.v");
-        printf("Generated user stimulus file: user.v\n");
+        char* stimulus_filename = generate_verilog_filename(vm->base_filename, "_stimulus.mem");
+        generate_user_stimulus_file(vm, stimulus_filename);
+        printf("Generated user stimulus file: %s\n", stimulus_filename);
+        free(stimulus_filename);
     }
     
     free_verilog_module(vm);
@@ -77,7 +116,7 @@ void generate_verilog_hdl(HotstateMicrocode* mc, const char* source_filename, Ve
 // --- Module Generation ---
 
 void generate_verilog_module_file(VerilogModule* vm, const char* filename) {
-    FILE* file = fopen(filename, "w");
+    FILE* file = output_file_open(filename, "w");
     if (!file) {
         fprintf(stderr, "Error: Cannot create file '%s'\n", filename);
         return;
@@ -133,7 +172,14 @@ void generate_verilog_module_file(VerilogModule* vm, const char* filename) {
     fprintf(file, "hotstate #(\n");
     fprintf(file, "    .NUM_STATES(%d),\n", vm->output_count);
     fprintf(file, "    .NUM_VARS(%d),\n", vm->input_count);
+    fprintf(file, "    .STACK_DEPTH(%d),\n", vm->stack_depth);
     fprintf(file, "    .MCFILENAME(\"%s\"),\n", vm->smdata_filename);
+    if (vardata_word_bits > 1) {
+        fprintf(file, "    .VARDATA_WORD_BITS(%d),\n", vardata_word_bits);
+    }
+    fprintf(file, "    .MC_MEM_STYLE(\"%s\"),\n", mem_style_name(vm->mc_mem_style));
+    fprintf(file, "    .VR_MEM_STYLE(\"%s\"),\n", mem_style_name(vm->vr_mem_style));
+    fprintf(file, "    .SW_MEM_STYLE(\"%s\"),\n", mem_style_name(vm->sw_mem_style));
     fprintf(file, "    .VRFILENAME(\"%s\")\n", vm->vardata_filename);
     fprintf(file, ") hotstate_inst (\n");
     fprintf(file, "    .clk(clk),\n");
@@ -154,17 +200,70 @@ void generate_verilog_module_file(VerilogModule* vm, const char* filename) {
     fprintf(file, "    .switch_tdata(5'b0),\n");
     fprintf(file, "    .switch_tvalid(1'b0),\n");
     fprintf(file, "    .switch_offset(8'b0),\n");
-    fprintf(file, "    .switch_sel()\n");
+    fprintf(file, "    .switch_sel(),\n");
+    fprintf(file, "    .logic_var_sel(),\n");
+    fprintf(file, "    .logic_lhs(1'b0)\n");
+    fprintf(file, ");\n\n");
+    fprintf(file, "endmodule\n");
+    
+    output_file_close(file, filename);
+}
+
+// The module of a partitioned program: the same ports as one core's, with
+// the cores <base>_p<i> inside sharing the clock, reset and inputs, and
+// each output taken from the core whose tasks assign it
+void generate_partition_module_file(VerilogModule* vm, const int* state_owner, const char* filename) {
+    FILE* file = output_file_open(filename, "w");
+    if (!file) {
+        fprintf(stderr, "Error: Cannot create file '%s'\n", filename);
+        return;
+    }
+    
+    fprintf(file, "// Auto-generated Verilog module for %s\n", vm->module_name);
+    fprintf(file, "// Partitioned into %d hotstate cores running independent tasks\n\n", vm->core_count);
+    
+    fprintf(file, "`timescale 1ns / 1ps\n\n");
+    
+    fprintf(file, "module %s (\n", vm->module_name);
+    fprintf(file, "    input wire clk,\n");
+    fprintf(file, "    input wire rst,\n");
+    for (int i = 0; i < vm->input_count; i++) {
+        fprintf(file, "    input wire [7:0] %s,\n", vm->input_names[i]);
+    }
+    for (int i = 0; i < vm->output_count; i++) {
+        fprintf(file, "    output wire [7:0] %s%s\n",
+                vm->output_names[i],
+                (i == vm->output_count - 1) ? "" : ",");
+    }
     fprintf(file, ");\n\n");
+    
+    for (int core = 0; core < vm->core_count; core++) {
+        fprintf(file, "// Core %d\n", core);
+        fprintf(file, "%s_p%d core%d (\n", vm->module_name, core, core);
+        fprintf(file, "    .clk(clk),\n");
+        fprintf(file, "    .rst(rst),\n");
+        for (int i = 0; i < vm->input_count; i++) {
+            fprintf(file, "    .%s(%s),\n", vm->input_names[i], vm->input_names[i]);
+        }
+        for (int i = 0; i < vm->output_count; i++) {
+            const char* separator = (i == vm->output_count - 1) ? "" : ",";
+            if (state_owner[i] == core) {
+                fprintf(file, "    .%s(%s)%s\n", vm->output_names[i], vm->output_names[i], separator);
+            } else {
+                fprintf(file, "    .%s()%s\n", vm->output_names[i], separator);
+            }
+        }
+        fprintf(file, ");\n\n");
+    }
     fprintf(file, "endmodule\n");
     
-    fclose(file);
+    output_file_close(file, filename);
 }
 
 // --- Testbench Generation ---
 
 void generate_verilog_testbench_file(VerilogModule* vm, const char* filename) {
-    FILE* file = fopen(filename, "w");
+    FILE* file = output_file_open(filename, "w");
     if (!file) {
         fprintf(stderr, "Error: Cannot create file '%s'\n", filename);
         return;
@@ -173,8 +272,15 @@ void generate_verilog_testbench_file(VerilogModule* vm, const char* filename) {
     fprintf(file, "// Auto-generated testbench for %s\n", vm->module_name);
     fprintf(file, "`timescale 1ns / 1ps\n\n");
     
-    // Testbench module
-    fprintf(file, "module %s_tb;\n\n", vm->module_name);
+    // Testbench module. A --trace-when output comes out as a port, the
+    // only signal of the testbench Verilator lets sim_main.cpp read.
+    if (vm->trace_output >= 0) {
+        fprintf(file, "module %s_tb (\n", vm->module_name);
+        fprintf(file, "    output wire trace_trigger  // sim_main.cpp traces while this is set\n");
+        fprintf(file, ");\n\n");
+    } else {
+        fprintf(file, "module %s_tb;\n\n", vm->module_name);
+    }
     
     // Clock and reset
     fprintf(file, "// Clock and reset\n");
@@ -213,6 +319,10 @@ void generate_verilog_testbench_file(VerilogModule* vm, const char* filename) {
     
     fprintf(file, ");\n\n");
     
+    if (vm->trace_output >= 0) {
+        fprintf(file, "assign trace_trigger = %s != 0;\n\n", vm->output_names[vm->trace_output]);
+    }
+    
     // Clock generation
     fprintf(file, "// Clock generation\n");
     fprintf(file, "initial begin\n");
@@ -220,15 +330,28 @@ void generate_verilog_testbench_file(VerilogModule* vm, const char* filename) {
     fprintf(file, "    forever #5 clk = ~clk; // 100MHz clock\n");
     fprintf(file, "end\n\n");
     
-    // VCD dump
-    fprintf(file, "// VCD dump\n");
-    fprintf(file, "initial begin\n");
-    fprintf(file, "    $dumpfile(\"sim_wf.vcd\");\n");
-    fprintf(file, "    $dumpvars(0, %s_tb);\n", vm->module_name);
-    fprintf(file, "end\n\n");
+    // VCD dump, unless sim_main.cpp is left to trace a window of the run
+    if (!sim_trace_windowed(vm)) {
+        fprintf(file, "// VCD dump\n");
+        fprintf(file, "initial begin\n");
+        fprintf(file, "    $dumpfile(\"sim_wf.vcd\");\n");
+        fprintf(file, "    $dumpvars(0, %s_tb);\n", vm->module_name);
+        fprintf(file, "end\n\n");
+    }
+    
+    // Stimulus, read at run time so that new vectors need no rebuild
+    char* stimulus_filename = generate_verilog_filename(vm->base_filename, "_stimulus.mem");
+    fprintf(file, "// Stimulus records from a $readmemh file (+stimulus=FILE, default %s):\n", stimulus_filename);
+    fprintf(file, "// {cycle[31:0], one byte per input, input 0 lowest}, applied that many\n");
+    fprintf(file, "// cycles after reset. Words the file does not fill read as all ones,\n");
+    fprintf(file, "// which ends the stimulus.\n");
+    fprintf(file, "parameter STIM_DEPTH = %d;\n", VERILOG_STIMULUS_DEPTH);
+    fprintf(file, "localparam STIM_WIDTH = %d;\n", 32 + 8 * vm->input_count);
+    fprintf(file, "reg [STIM_WIDTH-1:0] stim_mem [0:STIM_DEPTH-1];\n");
+    fprintf(file, "reg [8*256-1:0] stim_file;\n");
+    fprintf(file, "reg [31:0] stim_cycle;\n");
+    fprintf(file, "integer stim_entry;\n\n");
     
-    // Test stimulus
-    fprintf(file, "// Test stimulus\n");
     fprintf(file, "initial begin\n");
     fprintf(file, "    // Initialize inputs\n");
     fprintf(file, "    rst = 1;\n");
@@ -237,37 +360,38 @@ void generate_verilog_testbench_file(VerilogModule* vm, const char* filename) {
         fprintf(file, "    %s = 0;\n", vm->input_names[i]);
     }
     
-    fprintf(file, "\n// Release reset\n");
-    fprintf(file, "#10 rst = 0;\n\n");
-    
-    fprintf(file, "// Test logical operations: if(a0 == 0 && a1 == 1)\n");
-    fprintf(file, "// Test pattern 1: a0=0, a1=1 (should satisfy condition)\n");
-    fprintf(file, "#10 a0 = 0; a1 = 1; a2 = 0;\n");
-    fprintf(file, "#20;\n\n");
-    
-    fprintf(file, "// Test pattern 2: a0=1, a1=1 (should not satisfy condition)\n");
-    fprintf(file, "#10 a0 = 1; a1 = 1; a2 = 0;\n");
-    fprintf(file, "#20;\n\n");
-    
-    fprintf(file, "// Test pattern 3: a0=0, a1=0 (should not satisfy condition)\n");
-    fprintf(file, "#10 a0 = 0; a1 = 0; a2 = 0;\n");
-    fprintf(file, "#20;\n\n");
-    
-    fprintf(file, "// Test pattern 4: a0=1, a1=0 (should not satisfy condition)\n");
-    fprintf(file, "#10 a0 = 1; a1 = 0; a2 = 0;\n");
-    fprintf(file, "#20;\n\n");
+    fprintf(file, "    for (stim_entry = 0; stim_entry < STIM_DEPTH; stim_entry = stim_entry + 1)\n");
+    fprintf(file, "        stim_mem[stim_entry] = {STIM_WIDTH{1'b1}};\n");
+    fprintf(file, "    if (!$value$plusargs(\"stimulus=%%s\", stim_file))\n");
+    fprintf(file, "        stim_file = \"%s\";\n", stimulus_filename);
+    fprintf(file, "    $readmemh(stim_file, stim_mem);\n\n");
+    
+    fprintf(file, "    // Release reset\n");
+    fprintf(file, "    #10 rst = 0;\n");
+    fprintf(file, "    stim_cycle = 0;\n");
+    fprintf(file, "    for (stim_entry = 0; stim_entry < STIM_DEPTH && stim_mem[stim_entry][STIM_WIDTH-1 -: 32] != 32'hFFFFFFFF;\n");
+    fprintf(file, "         stim_entry = stim_entry + 1) begin\n");
+    fprintf(file, "        while (stim_cycle < stim_mem[stim_entry][STIM_WIDTH-1 -: 32]) begin\n");
+    fprintf(file, "            @(posedge clk);\n");
+    fprintf(file, "            stim_cycle = stim_cycle + 1;\n");
+    fprintf(file, "        end\n");
+    for (int i = 0; i < vm->input_count; i++) {
+        fprintf(file, "        %s = stim_mem[stim_entry][%d:%d];\n", vm->input_names[i], 8 * i + 7, 8 * i);
+    }
+    fprintf(file, "    end\n\n");
+    free(stimulus_filename);
     
-    fprintf(file, "#200 $finish;\n");
+    fprintf(file, "    #200 $finish;\n");
     fprintf(file, "end\n\n");
     fprintf(file, "endmodule\n");
     
-    fclose(file);
+    output_file_close(file, filename);
 }
 
 // --- Simulation Makefile Generation ---
 
 void generate_simulation_makefile(VerilogModule* vm, const char* filename) {
-    FILE* file = fopen(filename, "w");
+    FILE* file = output_file_open(filename, "w");
     if (!file) {
         fprintf(stderr, "Error: Cannot create file '%s'\n", filename);
         return;
@@ -276,75 +400,149 @@ void generate_simulation_makefile(VerilogModule* vm, const char* filename) {
     fprintf(file, "# Auto-generated Makefile for %s simulation\n\n", vm->module_name);
     
     fprintf(file, "MODULE = %s\n", vm->module_name);
+    fprintf(file, "TEMPLATES = $(MODULE)_template.v");
+    for (int core = 0; core < vm->core_count; core++) {
+        fprintf(file, " $(MODULE)_p%d_template.v", core);
+    }
+    fprintf(file, "\n");
     fprintf(file, "SIMULATOR = verilator\n");
-    fprintf(file, "VIEWER = gtkwave\n\n");
+    fprintf(file, "VIEWER = gtkwave\n");
+    fprintf(file, "SOURCES = $(MODULE)_tb.v $(TEMPLATES) IP/hotstate.sv IP/microcode.sv IP/control.sv IP/next_address.sv IP/stack.sv IP/switch.sv IP/timer.sv IP/variable.sv\n");
+    fprintf(file, "THREADS ?= %d\n", verilog_sim_harness.threads);
+    fprintf(file, "STIMULUS_MEM ?= $(MODULE)_stimulus.mem\n\n");
     
     fprintf(file, "# Default target\n");
-    fprintf(file, "all: sim\n\n");
+    fprintf(file, "all: %s\n\n", verilog_sim_harness.fast ? "fast" : "sim");
     
-    fprintf(file, "# Compile and run simulation\n");
-    fprintf(file, "sim: $(MODULE)_tb.v $(MODULE)_template.v user.v sim_main.cpp verilator_sim.h\n");
-    fprintf(file, "\t$(SIMULATOR) --cc -Wno-fatal --exe --trace --trace-structs --build -I. sim_main.cpp $(MODULE)_tb.v $(MODULE)_template.v IP/hotstate.sv IP/microcode.sv IP/control.sv IP/next_address.sv IP/stack.sv IP/switch.sv IP/timer.sv IP/variable.sv --top $(MODULE)_tb\n");
+    fprintf(file, "# Compile and run simulation. The testbench reads $(STIMULUS_MEM) when it\n");
+    fprintf(file, "# runs, so `make run` replays new stimulus without compiling again.\n");
+    fprintf(file, "sim: $(MODULE)_tb.v $(TEMPLATES) sim_main.cpp verilator_sim.h\n");
+    fprintf(file, "\t$(SIMULATOR) --cc -Wno-fatal --exe --trace --trace-structs --build -I. sim_main.cpp $(SOURCES) --top $(MODULE)_tb\n");
     fprintf(file, "\t@echo \"Running simulation...\"\n");
-    fprintf(file, "\t./obj_dir/V$(MODULE)_tb\n");
+    fprintf(file, "\t./obj_dir/V$(MODULE)_tb +stimulus=$(STIMULUS_MEM)\n");
     fprintf(file, "\t@echo \"Simulation completed! Waveform saved to sim_wf.vcd\"\n\n");
     
+    fprintf(file, "# Throughput build without tracing: optimized C++, X values resolved\n");
+    fprintf(file, "# the fast way, and the model evaluated on $(THREADS) threads\n");
+    fprintf(file, "FAST_FLAGS = -O3 --x-assign fast --x-initial fast --threads $(THREADS) -CFLAGS -O3\n");
+    fprintf(file, "fast: $(MODULE)_tb.v $(TEMPLATES) sim_main.cpp verilator_sim.h\n");
+    fprintf(file, "\t$(SIMULATOR) --cc -Wno-fatal --exe --build $(FAST_FLAGS) --Mdir obj_fast -I. sim_main.cpp $(SOURCES) --top $(MODULE)_tb\n");
+    fprintf(file, "\t./obj_fast/V$(MODULE)_tb +stimulus=$(STIMULUS_MEM)\n\n");
+    
+    fprintf(file, "# Run the last build on $(STIMULUS_MEM), e.g. make run STIMULUS_MEM=other.mem\n");
+    fprintf(file, "run:\n");
+    fprintf(file, "\t./$(if $(wildcard obj_fast/V$(MODULE)_tb),obj_fast,obj_dir)/V$(MODULE)_tb +stimulus=$(STIMULUS_MEM)\n\n");
+    
+    fprintf(file, "# A hotstate_sim stimulus file as testbench stimulus\n");
+    fprintf(file, "%%.mem: %%.txt\n");
+    fprintf(file, "\t$(HOTSTATE_SIM)/bin/hotstate_sim -b $(MODULE) -s $< --convert-stimulus $@\n\n");
+    
     fprintf(file, "# Lint-only check\n");
-    fprintf(file, "lint: $(MODULE)_tb.v $(MODULE)_template.v\n");
-    fprintf(file, "\t$(SIMULATOR) --lint-only -Wall -Wno-WIDTH -Wno-UNUSED -Wno-DECLFILENAME -Wno-EOFNEWLINE -Wno-SYMRSVDWORD -Wno-PINMISSING -Wno-TIMESCALEMOD -Wno-LITENDIAN -Wno-SELRANGE -Wno-STMTDLY -Wno-PINCONNECTEMPTY -Wno-UNDRIVEN -Wno-BLKSEQ $(MODULE)_tb.v $(MODULE)_template.v IP/hotstate.sv IP/microcode.sv IP/control.sv IP/next_address.sv IP/stack.sv IP/switch.sv IP/timer.sv IP/variable.sv\n");
+    fprintf(file, "lint: $(MODULE)_tb.v $(TEMPLATES)\n");
+    fprintf(file, "\t$(SIMULATOR) --lint-only -Wall -Wno-WIDTH -Wno-UNUSED -Wno-DECLFILENAME -Wno-EOFNEWLINE -Wno-SYMRSVDWORD -Wno-PINMISSING -Wno-TIMESCALEMOD -Wno-LITENDIAN -Wno-SELRANGE -Wno-STMTDLY -Wno-PINCONNECTEMPTY -Wno-UNDRIVEN -Wno-BLKSEQ $(SOURCES)\n");
     fprintf(file, "\t@echo \"Verilog lint check successful!\"\n\n");
     
+    fprintf(file, "# Lockstep co-simulation against the C++ model in $(HOTSTATE_SIM),\n");
+    fprintf(file, "# stopping at the first cycle whose state or address differ\n");
+    fprintf(file, "HOTSTATE_SIM ?= sim\n");
+    fprintf(file, "COSIM_DIR = $(abspath $(HOTSTATE_SIM))\n");
+    fprintf(file, "COSIM_CFLAGS = -std=c++17 -I$(CURDIR) -I$(COSIM_DIR)/include -I$(COSIM_DIR)/../src\n");
+    fprintf(file, "COSIM_LIBS = $(COSIM_DIR)/bin/libhotstate_sim.a $(COSIM_DIR)/../bin/libhotstate.a -lm -ldl -pthread\n");
+    fprintf(file, "cosim: $(MODULE)_cosim.v $(TEMPLATES) verilator_cosim.h\n");
+    fprintf(file, "\t$(MAKE) -C $(HOTSTATE_SIM) lib\n");
+    fprintf(file, "\t$(SIMULATOR) --cc -Wno-fatal --exe --build -CFLAGS \"$(COSIM_CFLAGS)\" -LDFLAGS \"$(COSIM_LIBS)\" $(COSIM_DIR)/cosim/cosim_main.cpp $(MODULE)_cosim.v $(TEMPLATES) IP/hotstate.sv IP/microcode.sv IP/control.sv IP/next_address.sv IP/stack.sv IP/switch.sv IP/timer.sv IP/variable.sv --top $(MODULE)_cosim\n");
+    fprintf(file, "\t./obj_dir/V$(MODULE)_cosim -b $(MODULE) $(if $(STIMULUS),-s $(STIMULUS)) $(if $(CYCLES),-m $(CYCLES))\n\n");
+    
     fprintf(file, "# View waveforms\n");
     fprintf(file, "wave: sim\n");
     fprintf(file, "\t$(VIEWER) sim_wf.vcd\n\n");
     
     fprintf(file, "# Clean generated files\n");
     fprintf(file, "clean:\n");
-    fprintf(file, "\trm -rf obj_dir sim_wf.vcd sim_main.cpp verilator_sim.h\n\n");
+    fprintf(file, "\trm -rf obj_dir obj_fast sim_wf.vcd sim_main.cpp verilator_sim.h $(MODULE)_cosim.v verilator_cosim.h\n\n");
     
-    fprintf(file, ".PHONY: all sim wave clean\n");
+    fprintf(file, ".PHONY: all sim fast run cosim wave clean\n");
     
-    fclose(file);
+    output_file_close(file, filename);
 }
 
 // --- Simulation Support File Generation ---
 
+// The harness traces only when Verilator builds it with --trace (the `sim`
+// target), and then only the cycles the --trace-window and --trace-when
+// options select; the `fast` target builds it without any tracing
 void generate_sim_main_cpp(VerilogModule* vm, const char* filename) {
-    FILE* file = fopen(filename, "w");
+    FILE* file = output_file_open(filename, "w");
     if (!file) {
         fprintf(stderr, "Error: Cannot create file '%s'\n", filename);
         return;
     }
     
+    const SimHarnessOptions* harness = &verilog_sim_harness;
+    bool from_start = harness->trace_start <= 0;
+    bool to_end = harness->trace_end < 0;
+    
     fprintf(file, "#include <verilated.h>\n");
     fprintf(file, "#include <cstdlib>\n");
+    fprintf(file, "#if VM_TRACE\n");
     fprintf(file, "#include \"verilated_vcd_c.h\"\n");
+    fprintf(file, "#endif\n");
     fprintf(file, "#include \"verilator_sim.h\"\n\n");
     
-    fprintf(file, "#define VCD_FILE_DEFAULT \"sim_wf.vcd\"\n\n");
+    fprintf(file, "#define VCD_FILE_DEFAULT \"sim_wf.vcd\"\n");
+    if (!from_start) {
+        fprintf(file, "#define TRACE_START %ld  // First cycle traced\n", harness->trace_start);
+    }
+    if (!to_end) {
+        fprintf(file, "#define TRACE_END %ld    // Cycles from here on are not traced\n", harness->trace_end);
+    }
+    fprintf(file, "\n");
     
     fprintf(file, "int main(int argc, char **argv)\n");
     fprintf(file, "{\n");
+    fprintf(file, "    // Construct context object and design object\n");
+    fprintf(file, "    VerilatedContext *m_contextp = new VerilatedContext; // Context\n");
+    fprintf(file, "    m_contextp->commandArgs(argc, argv);   // +stimulus=FILE for the testbench\n");
+    fprintf(file, "    V_tb *m_duvp = new V_tb;                 // Design\n");
+    fprintf(file, "#if VM_TRACE\n");
     fprintf(file, "    const char* env_var_vcd = getenv(\"VCD_FILE\");\n");
     fprintf(file, "    if(!env_var_vcd)\n");
     fprintf(file, "       env_var_vcd = VCD_FILE_DEFAULT;\n");
-    fprintf(file, "    // Construct context object, design object, and trace object\n");
-    fprintf(file, "    VerilatedContext *m_contextp = new VerilatedContext; // Context\n");
-    fprintf(file, "    VerilatedVcdC *m_tracep = new VerilatedVcdC;         // Trace\n");
-    fprintf(file, "    V_tb *m_duvp = new V_tb;                 // Design\n");
     fprintf(file, "    // Trace configuration\n");
+    fprintf(file, "    VerilatedVcdC *m_tracep = new VerilatedVcdC;         // Trace\n");
     fprintf(file, "    m_contextp->traceEverOn(true);     // Turn on trace switch in context\n");
     fprintf(file, "    m_duvp->trace(m_tracep, 3);        // Set depth to 3\n");
     fprintf(file, "    m_tracep->open(env_var_vcd); // Open the VCD file to store data\n");
-    fprintf(file, "    // Write data to the waveform file with timeout\n");
-    fprintf(file, "    int max_cycles = 1000; // Timeout after 1000 cycles\n");
+    fprintf(file, "#endif\n");
+    fprintf(file, "    // Run with timeout\n");
+    fprintf(file, "    const char* env_var_cycles = getenv(\"MAX_CYCLES\");\n");
+    fprintf(file, "    int max_cycles = env_var_cycles ? atoi(env_var_cycles) : 1000; // Timeout, 1000 cycles by default\n");
     fprintf(file, "    int cycle = 0;\n");
     fprintf(file, "    while (!m_contextp->gotFinish() && cycle < max_cycles)\n");
     fprintf(file, "    {\n");
     fprintf(file, "        // Refresh circuit state\n");
     fprintf(file, "        m_duvp->eval();\n");
+    fprintf(file, "#if VM_TRACE\n");
+    
+    // Only the bounds and trigger in use are tested
+    char condition[256] = "";
+    if (!from_start) {
+        strcat(condition, "cycle >= TRACE_START");
+    }
+    if (!to_end) {
+        strcat(condition, condition[0] ? " && cycle < TRACE_END" : "cycle < TRACE_END");
+    }
+    if (vm->trace_output >= 0) {
+        strcat(condition, condition[0] ? " && m_duvp->trace_trigger" : "m_duvp->trace_trigger");
+    }
     fprintf(file, "        // Dump data\n");
-    fprintf(file, "        m_tracep->dump(m_contextp->time());\n");
+    if (condition[0]) {
+        fprintf(file, "        if (%s)\n", condition);
+        fprintf(file, "            m_tracep->dump(m_contextp->time());\n");
+    } else {
+        fprintf(file, "        m_tracep->dump(m_contextp->time());\n");
+    }
+    fprintf(file, "#endif\n");
     fprintf(file, "        // Increase simulation time\n");
     fprintf(file, "        m_contextp->timeInc(1);\n");
     fprintf(file, "        cycle++;\n");
@@ -354,18 +552,20 @@ void generate_sim_main_cpp(VerilogModule* vm, const char* filename) {
     fprintf(file, "    } else {\n");
     fprintf(file, "        printf(\"Simulation completed after %%d cycles\\n\", cycle);\n");
     fprintf(file, "    }\n");
+    fprintf(file, "#if VM_TRACE\n");
     fprintf(file, "    // Remember to close the trace object to save data in the file\n");
     fprintf(file, "    m_tracep->close();\n");
+    fprintf(file, "#endif\n");
     fprintf(file, "    // Free memory\n");
     fprintf(file, "    delete m_duvp;\n");
     fprintf(file, "    return 0;\n");
     fprintf(file, "}\n");
     
-    fclose(file);
+    output_file_close(file, filename);
 }
 
 void generate_verilator_sim_h(VerilogModule* vm, const char* filename) {
-    FILE* file = fopen(filename, "w");
+    FILE* file = output_file_open(filename, "w");
     if (!file) {
         fprintf(stderr, "Error: Cannot create file '%s'\n", filename);
         return;
@@ -374,27 +574,105 @@ void generate_verilator_sim_h(VerilogModule* vm, const char* filename) {
     fprintf(file, "#include \"V%s_tb.h\"\n", vm->module_name);
     fprintf(file, "typedef V%s_tb V_tb;\n", vm->module_name);
     
-    fclose(file);
+    output_file_close(file, filename);
 }
 
-// --- User Stimulus File Generation ---
+// --- Co-Simulation File Generation ---
 
-void generate_user_stimulus_file(VerilogModule* vm, const char* filename) {
-    FILE* file = fopen(filename, "w");
+// Top module for lockstep co-simulation (sim/cosim/cosim_main.cpp): the
+// generated module with its ports packed into buses the way HotstateModel
+// packs them, and the hotstate address brought out for comparison
+void generate_cosim_wrapper_file(VerilogModule* vm, const char* filename) {
+    FILE* file = output_file_open(filename, "w");
     if (!file) {
         fprintf(stderr, "Error: Cannot create file '%s'\n", filename);
         return;
     }
     
-    fprintf(file, "// User stimulus file for %s\n", vm->module_name);
-    fprintf(file, "// Add your custom test patterns here\n\n");
+    int var_bits = vm->input_count > 0 ? vm->input_count : 1;
+    int state_bits = vm->output_count > 0 ? vm->output_count : 1;
+    
+    fprintf(file, "// Auto-generated co-simulation wrapper for %s\n", vm->module_name);
+    fprintf(file, "`timescale 1ns / 1ps\n\n");
+    
+    fprintf(file, "module %s_cosim (\n", vm->module_name);
+    fprintf(file, "    input wire clk,\n");
+    fprintf(file, "    input wire rst,\n");
+    fprintf(file, "    input wire [%d:0] variables,\n", var_bits - 1);
+    fprintf(file, "    output wire [%d:0] states,\n", state_bits - 1);
+    fprintf(file, "    output wire [31:0] address\n");
+    fprintf(file, ");\n\n");
+    
+    // One port per variable on the generated module, bit 0 used. Variable
+    // names can be array elements, so the ports are connected in order.
+    for (int i = 0; i < vm->input_count; i++) {
+        fprintf(file, "wire [7:0] in_%d = {7'b0, variables[%d]};  // %s\n", i, i, vm->input_names[i]);
+    }
+    for (int i = 0; i < vm->output_count; i++) {
+        fprintf(file, "wire [7:0] out_%d;  // %s\n", i, vm->output_names[i]);
+        fprintf(file, "assign states[%d] = out_%d[0];\n", i, i);
+    }
+    fprintf(file, "\n");
     
-    fprintf(file, "// Example stimulus patterns:\n");
+    fprintf(file, "%s dut (clk, rst", vm->module_name);
     for (int i = 0; i < vm->input_count; i++) {
-        fprintf(file, "// %s = 8'h00; // Set %s to 0\n", vm->input_names[i], vm->input_names[i]);
+        fprintf(file, ", in_%d", i);
+    }
+    for (int i = 0; i < vm->output_count; i++) {
+        fprintf(file, ", out_%d", i);
+    }
+    fprintf(file, ");\n\n");
+    
+    fprintf(file, "assign address = dut.hotstate_inst.debug_adr;\n\n");
+    fprintf(file, "endmodule\n");
+    
+    output_file_close(file, filename);
+}
+
+void generate_verilator_cosim_h(VerilogModule* vm, const char* filename) {
+    FILE* file = output_file_open(filename, "w");
+    if (!file) {
+        fprintf(stderr, "Error: Cannot create file '%s'\n", filename);
+        return;
+    }
+    
+    fprintf(file, "#include \"V%s_cosim.h\"\n", vm->module_name);
+    fprintf(file, "typedef V%s_cosim V_cosim;\n", vm->module_name);
+    
+    output_file_close(file, filename);
+}
+
+// --- User Stimulus File Generation ---
+
+// A starting point for the testbench's stimulus file: the first input
+// combinations in binary order, each held for a few cycles. Replaced by
+// hotstate_sim --convert-stimulus, which writes the same format.
+void generate_user_stimulus_file(VerilogModule* vm, const char* filename) {
+    FILE* file = output_file_open(filename, "w");
+    if (!file) {
+        fprintf(stderr, "Error: Cannot create file '%s'\n", filename);
+        return;
+    }
+    
+    fprintf(file, "// User stimulus file for %s, read by %s_tb.v with $readmemh\n", vm->module_name, vm->module_name);
+    fprintf(file, "// One hex word per entry: the cycle (8 digits), then 2 digits per input:\n//");
+    for (int i = vm->input_count - 1; i >= 0; i--) {
+        fprintf(file, " %s", vm->input_names[i]);
+    }
+    fprintf(file, "%s\n", vm->input_count > 0 ? "" : " (no inputs)");
+    fprintf(file, "// Convert a hotstate_sim stimulus file with\n");
+    fprintf(file, "//   hotstate_sim -b %s -s stimulus.txt --convert-stimulus %s\n\n", vm->base_filename, filename);
+    
+    int patterns = vm->input_count < 4 ? 1 << vm->input_count : 16;
+    for (int pattern = 0; pattern < patterns; pattern++) {
+        fprintf(file, "%08x", pattern * VERILOG_STIMULUS_HOLD);
+        for (int i = vm->input_count - 1; i >= 0; i--) {
+            fprintf(file, "%02x", i < 4 ? (pattern >> i) & 1 : 0);
+        }
+        fprintf(file, "\n");
     }
     
-    fclose(file);
+    output_file_close(file, filename);
 }
 
 // --- Utility Functions ---
@@ -442,6 +720,7 @@ VerilogModule* create_verilog_module(HotstateMicrocode* mc, const char* source_f
     // Initialize basic fields
     vm->module_name = extract_module_name(source_filename);
     vm->base_filename = extract_module_name(source_filename);
+    vm->trace_output = -1;
     
     // Calculate hardware parameters
     calculate_hotstate_parameters(vm, mc);
@@ -516,11 +795,83 @@ void calculate_hotstate_parameters(VerilogModule* vm, HotstateMicrocode* mc) {
     vm->num_varsel = 16;
     vm->num_timers = 4;
     vm->num_ctl_bits = 8;
-    vm->stack_depth = 8;
+    vm->stack_depth = 0;  // Set from the call graph by generate_verilog_hdl
+    vm->core_count = 0;
     vm->num_switches = 4;
     vm->switch_mem_words = 16;
     vm->num_switch_bits = 4;
     vm->switch_offset_bits = 4;
+
+    // Each memory at the size the module instantiates it: smdata words as
+    // wide as its sm_tdata port, and the vardata file packed
+    // vardata_word_bits entries to a word
+    int state_count = mc->hw_ctx ? mc->hw_ctx->state_count : 0;
+    int input_count = mc->hw_ctx ? mc->hw_ctx->input_count : 0;
+    uint64_t lut_entries = vardata_file_entries(input_count);
+    vm->mc_mem_style = resolve_mem_style(mc->instruction_count, 2 * state_count + 19);
+    vm->vr_mem_style = resolve_mem_style((long long)((lut_entries + vardata_word_bits - 1) / vardata_word_bits),
+                                         vardata_word_bits);
+    vm->sw_mem_style = resolve_mem_style(vm->switch_mem_words, vm->num_adr_bits);
+}
+
+// The entries in the vardata file microcode_output.c writes for this
+// microcode. The CFG microcode builds no LUT (its varSel is an input number,
+// and max_varsel_val stays at its INT_MIN sentinel), so that is the zero
+// fill of input_count entries per input pattern. Inputs past 40 are clamped,
+// which is far beyond block RAM either way.
+static uint64_t vardata_file_entries(int input_count) {
+    if (input_count <= 0) {
+        return 1;
+    }
+    int inputs = input_count < 40 ? input_count : 40;
+    return (uint64_t)inputs << inputs;
+}
+
+MemStyle choose_mem_style(long long words, int width) {
+    if (words > MEM_STYLE_LUTRAM_DEPTH && words * width >= MEM_STYLE_BLOCK_BITS) {
+        return MEM_STYLE_BLOCK;
+    }
+    return MEM_STYLE_DISTRIBUTED;
+}
+
+// --mem-style when given, otherwise the size's choice
+static MemStyle resolve_mem_style(long long words, int width) {
+    return verilog_mem_style != MEM_STYLE_AUTO ? verilog_mem_style : choose_mem_style(words, width);
+}
+
+// The value of the IP's rom_style/ram_style attributes
+const char* mem_style_name(MemStyle style) {
+    switch (style) {
+        case MEM_STYLE_DISTRIBUTED: return "distributed";
+        case MEM_STYLE_BLOCK: return "block";
+        case MEM_STYLE_REGISTERS: return "registers";
+        default: return "auto";
+    }
+}
+
+bool parse_mem_style(const char* name, MemStyle* style) {
+    for (MemStyle s = MEM_STYLE_AUTO; s <= MEM_STYLE_REGISTERS; s++) {
+        if (strcmp(name, mem_style_name(s)) == 0) {
+            *style = s;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool parse_trace_window(const char* text, SimHarnessOptions* harness) {
+    char* end;
+    long start = strtol(text, &end, 10);
+    if (end == text || *end != ':' || start < 0) return false;
+    const char* rest = end + 1;
+    long stop = -1;
+    if (*rest) {
+        stop = strtol(rest, &end, 10);
+        if (*end || stop <= start) return false;
+    }
+    harness->trace_start = start;
+    harness->trace_end = stop;
+    return true;
 }
 
 int calculate_address_bits(int num_instructions) {
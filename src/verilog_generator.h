@@ -5,6 +5,22 @@
 #include <stdio.h>
 #include <stdbool.h>
 
+// Synthesis style of a hotstate memory, passed to the IP as its
+// MC_/VR_/SW_MEM_STYLE parameter. MEM_STYLE_AUTO chooses per memory from
+// its size (choose_mem_style).
+typedef enum {
+    MEM_STYLE_AUTO,
+    MEM_STYLE_DISTRIBUTED,   // LUT RAM: no read latency to absorb, costly when deep
+    MEM_STYLE_BLOCK,         // Block RAM: cheap when deep, needs the address register retimed into it
+    MEM_STYLE_REGISTERS      // Flip-flops and a read mux, for the smallest memories
+} MemStyle;
+
+// Auto: a memory goes to block RAM once it is deeper than one LUT RAM
+// primitive and holds at least a quarter of an 18Kb block; below that the
+// block would sit mostly empty and the LUT RAM costs fewer resources
+#define MEM_STYLE_LUTRAM_DEPTH 64
+#define MEM_STYLE_BLOCK_BITS 4608
+
 // Verilog module configuration
 typedef struct {
     char* module_name;
@@ -24,6 +40,11 @@ typedef struct {
     int switch_mem_words;
     int num_switch_bits;
     int switch_offset_bits;
+    int core_count;          // Partitioned cores the module instantiates; 0 for one hotstate
+    MemStyle mc_mem_style;   // smdata, vardata and switchdata memories
+    MemStyle vr_mem_style;
+    MemStyle sw_mem_style;
+    int trace_output;        // Output whose nonzero value gates the harness trace; -1 for none
     
     // File names
     char* smdata_filename;
@@ -43,8 +64,29 @@ typedef struct {
     bool generate_user_stim;   // Generate user stimulus file
     bool generate_makefile;    // Generate simulation Makefile
     bool generate_all;         // Generate all files
+    int stack_depth;           // Return stack entries (calculate_required_stack_depth); 0 has none
+    int core_count;            // --partition: the module instantiates <base>_p0 .. _p<N-1>; 0 for one core
+    const int* state_owner;    // With core_count: the core driving each output, in HardwareContext order
 } VerilogGenOptions;
 
+// Verilator harness (Makefile.sim, sim_main.cpp). sim_main.cpp only
+// traces when Verilator builds it with --trace, so the one harness serves
+// both the traced `sim` target and the untraced `fast` one.
+typedef struct {
+    bool fast;               // --sim-fast: the default target is the untraced throughput build
+    int threads;             // --sim-threads: Verilator threads for the `fast` build
+    long trace_start;        // --trace-window A:B: trace harness cycles A up to, not including, B
+    long trace_end;          // -1 for no upper bound
+    const char* trace_when;  // --trace-when NAME: trace only while output NAME is nonzero; NULL for always
+} SimHarnessOptions;
+
+#define SIM_HARNESS_THREADS 2
+
+// Testbench stimulus: entries the testbench's memory holds (STIM_DEPTH),
+// and the cycles between the generated file's patterns
+#define VERILOG_STIMULUS_DEPTH 65536
+#define VERILOG_STIMULUS_HOLD 4
+
 // --- Core HDL Generation Functions ---
 
 // Main generation function
@@ -54,6 +96,7 @@ void generate_verilog_hdl(HotstateMicrocode* mc, const char* source_filename, Ve
 VerilogModule* create_verilog_module(HotstateMicrocode* mc, const char* base_name);
 void generate_verilog_module_file(VerilogModule* vm, const char* filename);
 void generate_verilog_testbench_file(VerilogModule* vm, const char* filename);
+void generate_partition_module_file(VerilogModule* vm, const int* state_owner, const char* filename);
 
 // Module components
 void write_module_header(VerilogModule* vm, FILE* output);
@@ -76,6 +119,9 @@ void generate_simulation_makefile(VerilogModule* vm, const char* filename);
 void calculate_hotstate_parameters(VerilogModule* vm, HotstateMicrocode* mc);
 int calculate_address_bits(int num_instructions);
 int calculate_varsel_bits(int num_inputs);
+MemStyle choose_mem_style(long long words, int width);
+const char* mem_style_name(MemStyle style);
+bool parse_mem_style(const char* name, MemStyle* style);
 
 // --- Utility Functions ---
 
@@ -93,6 +139,13 @@ bool validate_verilog_module(VerilogModule* vm);
 bool check_port_names(VerilogModule* vm);
 bool check_parameter_ranges(VerilogModule* vm);
 
+// Global configuration variables
+extern MemStyle verilog_mem_style;   // --mem-style: every memory's style, or MEM_STYLE_AUTO to size each
+extern SimHarnessOptions verilog_sim_harness;
+
+// Parse --trace-window's A:B, or A: for no end, into the harness options
+bool parse_trace_window(const char* text, SimHarnessOptions* harness);
+
 // Simulation support files
 void generate_sim_main_cpp(VerilogModule* vm, const char* filename);
 void generate_verilator_sim_h(VerilogModule* vm, const char* filename);
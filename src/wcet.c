@@ -0,0 +1,566 @@
+#define _GNU_SOURCE  // For strndup
+#include "wcet.h"
+#include <limits.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+int report_wcet = 0;
+int wcet_loop_bound = 0;
+
+#define NOT_ANALYZED 0
+#define IN_PROGRESS 1
+#define ANALYZED 2
+
+// The word graph, built once. A call word's one successor is the word
+// after it; its callee is kept separately and costs the body's cycles.
+typedef struct {
+    CompactMicrocode* mc;
+    int count;
+    int* succ_start;   // Successors of word i: succ[succ_start[i] .. succ_start[i + 1])
+    int* succ;
+    int* callee;       // Per word: the entry a call word enters, or -1
+    long long* wait;   // Per word: clocks a delay's timer wait holds it past its first
+
+    // Helper bodies by entry address: cycles from the entry word through its return
+    long long* body_best;
+    long long* body_worst;
+    bool* body_unbounded;
+    unsigned char* body_state;
+} WcetGraph;
+
+// One function's cycle counts from its entry word
+typedef struct {
+    int entry;
+    long long* best;   // -1 where unreached
+    long long* worst;
+    int* pred;         // Predecessor on the worst path, -1 at the entry
+    bool* unbounded;   // After a loop with an exit and no --loop-bound, or a call that never returns
+} WcetRegion;
+
+static void* wcet_alloc(size_t count, size_t size) {
+    void* p = calloc(count > 0 ? count : 1, size);
+    if (!p) {
+        fprintf(stderr, "Error: Failed to allocate cycle analysis tables.\n");
+        exit(EXIT_FAILURE);
+    }
+    return p;
+}
+
+static bool is_call_word(const MCode* m) {
+    return m->sub && (m->branch || m->forced_jmp);
+}
+
+// A delay's wait word: it branches to itself until the timer the word
+// before it loaded runs out (emit_delay), so it only falls through
+static bool is_timer_wait(const CompactMicrocode* mc, int i) {
+    const MCode* m = &mc->instructions[i].uword.mcode;
+    if (i == 0 || !m->branch || !m->var_or_timer || !m->timerSel || m->timerLd || (int)m->jadr != i) {
+        return false;
+    }
+    const MCode* load = &mc->instructions[i - 1].uword.mcode;
+    return load->timerLd && load->timerSel == m->timerSel && (int)load->jadr < mc->timdata_count;
+}
+
+static void build_graph(WcetGraph* g, CompactMicrocode* mc) {
+    int count = mc->instruction_count;
+    int switch_words = 1 << mc->switch_offset_bits;
+    g->mc = mc;
+    g->count = count;
+    g->succ_start = wcet_alloc(count + 1, sizeof(int));
+    g->callee = wcet_alloc(count, sizeof(int));
+    g->wait = wcet_alloc(count, sizeof(long long));
+    g->body_best = wcet_alloc(count, sizeof(long long));
+    g->body_worst = wcet_alloc(count, sizeof(long long));
+    g->body_unbounded = wcet_alloc(count, sizeof(bool));
+    g->body_state = wcet_alloc(count, sizeof(unsigned char));
+
+    // Two passes, counting and then filling; switch words are matched to
+    // their tables in order, as process_switch_statement numbers them
+    int capacity = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        int edges = 0;
+        int switch_id = 0;
+        for (int i = 0; i < count; i++) {
+            const MCode* m = &mc->instructions[i].uword.mcode;
+            int targets[2];
+            int n = 0;
+            g->succ_start[i] = edges;
+            g->callee[i] = -1;
+            if (m->switch_adr && switch_id < mc->switch_count) {
+                const uint32_t* table = mc->switchmem + (size_t)switch_id++ * switch_words;
+                for (int k = 0; k < switch_words; k++) {
+                    bool seen = (int)table[k] >= count;
+                    for (int j = 0; j < k && !seen; j++) {
+                        seen = table[j] == table[k];
+                    }
+                    if (!seen) {
+                        if (pass == 1) {
+                            g->succ[edges] = (int)table[k];
+                        }
+                        edges++;
+                    }
+                }
+                continue;
+            }
+            if (is_call_word(m)) {
+                g->callee[i] = (int)m->jadr < count ? (int)m->jadr : -1;
+                targets[n++] = i + 1;
+            } else if (m->rtn) {
+                // Leaves the body; the caller's next word is counted there
+            } else if (m->forced_jmp) {
+                targets[n++] = (int)m->jadr;
+            } else if (is_timer_wait(mc, i)) {
+                // Once round per count, and round the delay slot too with --pipeline
+                uint32_t timer = mc->instructions[i - 1].uword.mcode.jadr;
+                g->wait[i] = (long long)mc->timdata[timer] * (mc->pipelined ? 2 : 1);
+                targets[n++] = i + 1;
+            } else if (m->branch) {
+                targets[n++] = (int)m->jadr;
+                if (i + 1 != (int)m->jadr) {
+                    targets[n++] = i + 1;
+                }
+            } else {
+                targets[n++] = i + 1;
+            }
+            for (int k = 0; k < n; k++) {
+                if (targets[k] < count) {
+                    if (pass == 1) {
+                        g->succ[edges] = targets[k];
+                    }
+                    edges++;
+                }
+            }
+        }
+        g->succ_start[count] = edges;
+        if (pass == 0) {
+            capacity = edges;
+            g->succ = wcet_alloc(capacity, sizeof(int));
+        }
+    }
+}
+
+static void free_graph(WcetGraph* g) {
+    free(g->succ_start);
+    free(g->succ);
+    free(g->callee);
+    free(g->wait);
+    free(g->body_best);
+    free(g->body_worst);
+    free(g->body_unbounded);
+    free(g->body_state);
+}
+
+static void free_region(WcetRegion* r) {
+    free(r->best);
+    free(r->worst);
+    free(r->pred);
+    free(r->unbounded);
+}
+
+static void analyze_region(WcetGraph* g, int entry, WcetRegion* r);
+
+// Cycles a call into entry takes, from the entry word through the return
+static void analyze_body(WcetGraph* g, int entry) {
+    if (g->body_state[entry] == ANALYZED) {
+        return;
+    }
+    if (g->body_state[entry] == IN_PROGRESS) {
+        // Recursion: the nesting, and so the time, has no static bound
+        g->body_unbounded[entry] = true;
+        return;
+    }
+    g->body_state[entry] = IN_PROGRESS;
+    WcetRegion body;
+    analyze_region(g, entry, &body);
+    long long best = -1, worst = -1;
+    bool unbounded = g->body_unbounded[entry];
+    for (int i = 0; i < g->count; i++) {
+        if (body.best[i] < 0 || !g->mc->instructions[i].uword.mcode.rtn) {
+            continue;
+        }
+        if (best < 0 || body.best[i] + 1 < best) {
+            best = body.best[i] + 1;
+        }
+        if (body.worst[i] + 1 > worst) {
+            worst = body.worst[i] + 1;
+        }
+        unbounded |= body.unbounded[i];
+    }
+    free_region(&body);
+    g->body_best[entry] = best < 0 ? 0 : best;
+    g->body_worst[entry] = worst < 0 ? 0 : worst;
+    g->body_unbounded[entry] = unbounded || best < 0;  // A body that never returns holds the caller forever
+    g->body_state[entry] = ANALYZED;
+}
+
+static long long saturating_add(long long a, long long b) {
+    return a > LLONG_MAX - b ? LLONG_MAX : a + b;
+}
+
+static void analyze_region(WcetGraph* g, int entry, WcetRegion* r) {
+    int count = g->count;
+    int edges = g->succ_start[count];
+    r->entry = entry;
+    r->best = wcet_alloc(count, sizeof(long long));
+    r->worst = wcet_alloc(count, sizeof(long long));
+    r->pred = wcet_alloc(count, sizeof(int));
+    r->unbounded = wcet_alloc(count, sizeof(bool));
+    for (int i = 0; i < count; i++) {
+        r->best[i] = -1;
+        r->pred[i] = -1;
+    }
+
+    // Depth-first search from the entry: postorder, and the back edges
+    // (to a word still on the stack) that close loops
+    bool* back = wcet_alloc(edges, sizeof(bool));
+    unsigned char* mark = wcet_alloc(count, sizeof(unsigned char));  // 1 on the stack, 2 finished
+    int* stack = wcet_alloc(count, sizeof(int));
+    int* next_edge = wcet_alloc(count, sizeof(int));
+    int* postorder = wcet_alloc(count, sizeof(int));
+    int reached = 0;
+    int depth = 0;
+    stack[depth++] = entry;
+    mark[entry] = 1;
+    next_edge[entry] = g->succ_start[entry];
+    while (depth > 0) {
+        int u = stack[depth - 1];
+        if (next_edge[u] < g->succ_start[u + 1]) {
+            int e = next_edge[u]++;
+            int v = g->succ[e];
+            if (mark[v] == 1) {
+                back[e] = true;
+            } else if (mark[v] == 0) {
+                mark[v] = 1;
+                next_edge[v] = g->succ_start[v];
+                stack[depth++] = v;
+            }
+        } else {
+            mark[u] = 2;
+            postorder[reached++] = u;
+            depth--;
+        }
+    }
+
+    // Helper bodies first, so every call's cost is known
+    for (int k = 0; k < reached; k++) {
+        int callee = g->callee[postorder[k]];
+        if (callee >= 0) {
+            analyze_body(g, callee);
+        }
+    }
+
+    // Predecessors over every edge, for the natural loops
+    int* pred_start = wcet_alloc(count + 1, sizeof(int));
+    int* preds = wcet_alloc(edges, sizeof(int));
+    for (int u = 0; u < count; u++) {
+        if (mark[u]) {
+            for (int e = g->succ_start[u]; e < g->succ_start[u + 1]; e++) {
+                pred_start[g->succ[e] + 1]++;
+            }
+        }
+    }
+    for (int i = 0; i < count; i++) {
+        pred_start[i + 1] += pred_start[i];
+    }
+    int* fill = wcet_alloc(count, sizeof(int));
+    for (int u = 0; u < count; u++) {
+        if (mark[u]) {
+            for (int e = g->succ_start[u]; e < g->succ_start[u + 1]; e++) {
+                int v = g->succ[e];
+                preds[pred_start[v] + fill[v]++] = u;
+            }
+        }
+    }
+
+    // Loops by header, innermost (smallest) first. The words of a loop
+    // are counted on their first pass; a loop with an exit adds its
+    // iterations to the edges (and returns) that leave it, and without
+    // --loop-bound whatever they lead to is unbounded.
+    long long* edge_extra = wcet_alloc(edges, sizeof(long long));
+    bool* edge_unbounded = wcet_alloc(edges, sizeof(bool));
+    long long* return_extra = wcet_alloc(count, sizeof(long long));
+    bool* return_unbounded = wcet_alloc(count, sizeof(bool));
+    int* headers = wcet_alloc(count, sizeof(int));
+    int* sizes = wcet_alloc(count, sizeof(int));
+    int header_count = 0;
+    for (int u = 0; u < count; u++) {
+        for (int e = g->succ_start[u]; mark[u] && e < g->succ_start[u + 1]; e++) {
+            int h = g->succ[e];
+            if (back[e] && sizes[h] == 0) {
+                sizes[h] = -1;
+                headers[header_count++] = h;
+            }
+        }
+    }
+
+    int* in_loop = wcet_alloc(count, sizeof(int));  // Header + 1 of the loop being collected
+    int* body = wcet_alloc(count, sizeof(int));
+    int* body_of = wcet_alloc(header_count, sizeof(int));  // Body words per header
+    int** bodies = wcet_alloc(header_count, sizeof(int*));
+    for (int k = 0; k < header_count; k++) {
+        int h = headers[k];
+        int n = 0;
+        in_loop[h] = h + 1;
+        body[n++] = h;
+        for (int pe = pred_start[h]; pe < pred_start[h + 1]; pe++) {
+            int t = preds[pe];
+            bool closes = false;
+            for (int e = g->succ_start[t]; e < g->succ_start[t + 1]; e++) {
+                closes |= back[e] && g->succ[e] == h;
+            }
+            if (closes && in_loop[t] != h + 1) {
+                in_loop[t] = h + 1;
+                body[n++] = t;
+            }
+        }
+        for (int j = 1; j < n; j++) {
+            int v = body[j];
+            for (int pe = pred_start[v]; pe < pred_start[v + 1]; pe++) {
+                int u = preds[pe];
+                if (in_loop[u] != h + 1) {
+                    in_loop[u] = h + 1;
+                    body[n++] = u;
+                }
+            }
+        }
+        bodies[k] = wcet_alloc(n, sizeof(int));
+        memcpy(bodies[k], body, sizeof(int) * n);
+        body_of[k] = n;
+        sizes[h] = n;
+    }
+    // Insertion sort by size; loops are few
+    for (int k = 1; k < header_count; k++) {
+        for (int j = k; j > 0 && body_of[j] < body_of[j - 1]; j--) {
+            int th = headers[j]; headers[j] = headers[j - 1]; headers[j - 1] = th;
+            int tn = body_of[j]; body_of[j] = body_of[j - 1]; body_of[j - 1] = tn;
+            int* tb = bodies[j]; bodies[j] = bodies[j - 1]; bodies[j - 1] = tb;
+        }
+    }
+
+    long long* dist = wcet_alloc(count, sizeof(long long));
+    for (int k = 0; k < header_count; k++) {
+        int h = headers[k];
+        int n = body_of[k];
+        for (int j = 0; j < n; j++) {
+            in_loop[bodies[k][j]] = -(h + 1);
+        }
+        bool has_exit = false;
+        for (int j = 0; j < n && !has_exit; j++) {
+            int u = bodies[k][j];
+            const MCode* m = &g->mc->instructions[u].uword.mcode;
+            has_exit = m->rtn || (g->callee[u] >= 0 && g->body_unbounded[g->callee[u]]);
+            for (int e = g->succ_start[u]; e < g->succ_start[u + 1] && !has_exit; e++) {
+                has_exit = in_loop[g->succ[e]] != -(h + 1);
+            }
+        }
+        if (!has_exit) {
+            continue;  // Repeats what the first pass through it counted
+        }
+        // One iteration: the longest path from the header back to it,
+        // through the loop's words in topological (reverse post-) order
+        long long iteration = 0;
+        bool unbounded = wcet_loop_bound <= 0;
+        for (int j = 0; j < n; j++) {
+            int u = bodies[k][j];
+            dist[u] = -1;
+            unbounded |= g->callee[u] >= 0 && g->body_unbounded[g->callee[u]];
+            for (int e = g->succ_start[u]; e < g->succ_start[u + 1]; e++) {
+                unbounded |= edge_unbounded[e];
+            }
+        }
+        dist[h] = 0;
+        for (int p = reached - 1; p >= 0; p--) {
+            int u = postorder[p];
+            if (in_loop[u] != -(h + 1) || dist[u] < 0) {
+                continue;
+            }
+            long long step = 1 + g->wait[u] + (g->callee[u] >= 0 ? g->body_worst[g->callee[u]] : 0);
+            for (int e = g->succ_start[u]; e < g->succ_start[u + 1]; e++) {
+                int v = g->succ[e];
+                long long d = saturating_add(saturating_add(dist[u], step), edge_extra[e]);
+                if (back[e] && v == h) {
+                    if (d > iteration) {
+                        iteration = d;
+                    }
+                } else if (!back[e] && in_loop[v] == -(h + 1) && d > dist[v]) {
+                    dist[v] = d;
+                }
+            }
+        }
+        long long spins = 0;
+        if (!unbounded) {
+            spins = iteration > LLONG_MAX / wcet_loop_bound ? LLONG_MAX : iteration * wcet_loop_bound;
+        }
+        for (int j = 0; j < n; j++) {
+            int u = bodies[k][j];
+            if (g->mc->instructions[u].uword.mcode.rtn) {
+                return_extra[u] = saturating_add(return_extra[u], spins);
+                return_unbounded[u] |= unbounded;
+            }
+            for (int e = g->succ_start[u]; e < g->succ_start[u + 1]; e++) {
+                if (in_loop[g->succ[e]] != -(h + 1)) {
+                    edge_extra[e] = saturating_add(edge_extra[e], spins);
+                    edge_unbounded[e] |= unbounded;
+                }
+            }
+        }
+    }
+
+    // Shortest and longest paths over the edges that are not back edges
+    r->best[entry] = 0;
+    r->worst[entry] = 0;
+    for (int p = reached - 1; p >= 0; p--) {
+        int u = postorder[p];
+        if (r->best[u] < 0) {
+            continue;
+        }
+        int callee = g->callee[u];
+        long long best_step = 1 + g->wait[u] + (callee >= 0 ? g->body_best[callee] : 0);
+        long long worst_step = 1 + g->wait[u] + (callee >= 0 ? g->body_worst[callee] : 0);
+        bool unbounded = r->unbounded[u] || (callee >= 0 && g->body_unbounded[callee]);
+        if (g->mc->instructions[u].uword.mcode.rtn) {
+            r->worst[u] = saturating_add(r->worst[u], return_extra[u]);
+            r->unbounded[u] |= return_unbounded[u];
+        }
+        for (int e = g->succ_start[u]; e < g->succ_start[u + 1]; e++) {
+            if (back[e]) {
+                continue;
+            }
+            int v = g->succ[e];
+            long long b = r->best[u] + best_step;
+            long long w = saturating_add(saturating_add(r->worst[u], worst_step), edge_extra[e]);
+            if (r->best[v] < 0 || b < r->best[v]) {
+                r->best[v] = b;
+            }
+            if (r->pred[v] < 0 || w > r->worst[v]) {
+                r->worst[v] = w;
+                r->pred[v] = u;
+            }
+            r->unbounded[v] |= unbounded || edge_unbounded[e];
+        }
+    }
+    r->pred[entry] = -1;
+
+    for (int k = 0; k < header_count; k++) {
+        free(bodies[k]);
+    }
+    free(bodies);
+    free(body_of);
+    free(body);
+    free(in_loop);
+    free(dist);
+    free(sizes);
+    free(headers);
+    free(return_unbounded);
+    free(return_extra);
+    free(edge_unbounded);
+    free(edge_extra);
+    free(fill);
+    free(preds);
+    free(pred_start);
+    free(postorder);
+    free(next_edge);
+    free(stack);
+    free(mark);
+    free(back);
+}
+
+static const char* word_label(CompactMicrocode* mc, int addr) {
+    const char* label = compact_word_label(mc, addr);
+    return label ? label : "";
+}
+
+// State assignments and the exit word; a point the worst path ends on
+static bool is_timing_point(CompactMicrocode* mc, int addr) {
+    const MCode* m = &mc->instructions[addr].uword.mcode;
+    return (m->state_capture && m->mask != 0) || addr == mc->exit_address;
+}
+
+static void print_region(WcetGraph* g, WcetRegion* r, const char* name, FILE* output) {
+    CompactMicrocode* mc = g->mc;
+    fprintf(output, "\n%s, from 0x%02X:\n", name, r->entry);
+    fprintf(output, "%-6s %8s %10s  %s\n", "Addr", "Best", "Worst", "Word");
+    int critical = -1;
+    for (int i = 0; i < g->count; i++) {
+        if (r->best[i] < 0 || !is_timing_point(mc, i)) {
+            continue;
+        }
+        if (r->unbounded[i]) {
+            fprintf(output, "0x%04X %8lld %10s  %s\n", i, r->best[i], "unbounded", word_label(mc, i));
+            continue;
+        }
+        fprintf(output, "0x%04X %8lld %10lld  %s\n", i, r->best[i], r->worst[i], word_label(mc, i));
+        if (critical < 0 || r->worst[i] > r->worst[critical]) {
+            critical = i;
+        }
+    }
+    if (critical < 0 || r->worst[critical] == 0) {
+        return;
+    }
+
+    // The worst path, entry first
+    int length = 0;
+    for (int v = critical; v >= 0; v = r->pred[v]) {
+        length++;
+    }
+    int* path = wcet_alloc(length, sizeof(int));
+    int k = length;
+    for (int v = critical; v >= 0; v = r->pred[v]) {
+        path[--k] = v;
+    }
+    fprintf(output, "Critical path, %lld cycles to 0x%04X:\n", r->worst[critical], critical);
+    for (k = 0; k < length; k++) {
+        fprintf(output, "  0x%04X %8lld  %s\n", path[k], r->worst[path[k]], word_label(mc, path[k]));
+    }
+    free(path);
+}
+
+void print_wcet_analysis(CompactMicrocode* mc, FILE* output) {
+    fprintf(output, "\n=== Worst-Case Cycle Analysis ===\n");
+    fprintf(output, "Cycle each state assignment can run on, one word per cycle\n");
+    if (wcet_loop_bound > 0) {
+        fprintf(output, "Loops with an exit: at most %d iterations (--loop-bound)\n", wcet_loop_bound);
+    } else {
+        fprintf(output, "Loops with an exit: unbounded (cap them with --loop-bound N)\n");
+    }
+    if (mc->instruction_count == 0) {
+        return;
+    }
+
+    WcetGraph g;
+    build_graph(&g, mc);
+    WcetRegion main_region;
+    analyze_region(&g, 0, &main_region);
+    print_region(&g, &main_region, mc->function_name ? mc->function_name : "main", output);
+    free_region(&main_region);
+
+    // Shared helper bodies, each from its own entry; a call word is
+    // labelled "name();"
+    for (int entry = 0; entry < g.count; entry++) {
+        if (g.body_state[entry] != ANALYZED) {
+            continue;
+        }
+        char* name = NULL;
+        for (int i = 0; i < g.count && !name; i++) {
+            if (g.callee[i] == entry) {
+                const char* label = word_label(mc, i);
+                const char* paren = strchr(label, '(');
+                name = paren ? strndup(label, paren - label) : strdup(label);
+            }
+        }
+        WcetRegion body;
+        analyze_region(&g, entry, &body);
+        char heading[160];
+        if (g.body_unbounded[entry]) {
+            snprintf(heading, sizeof(heading), "%s() (unbounded per call)", name ? name : "helper");
+        } else {
+            snprintf(heading, sizeof(heading), "%s() (%lld-%lld cycles per call)", name ? name : "helper",
+                     1 + g.body_best[entry], 1 + g.body_worst[entry]);
+        }
+        print_region(&g, &body, heading, output);
+        free_region(&body);
+        free(name);
+    }
+    free_graph(&g);
+}
@@ -0,0 +1,23 @@
+#ifndef WCET_H
+#define WCET_H
+
+#include "ast_to_microcode.h"
+#include <stdio.h>
+
+// Static cycle counts over the compact microcode (--wcet). Every word takes
+// one clock, so the best and worst cycle on which a word can run, counted
+// from reset, are the shortest and longest paths to it through the word
+// graph; a call costs its word plus the helper's body up to its return.
+//
+// A loop nothing leaves (the program's while (1)) only repeats what has
+// been counted, and adds nothing. A loop with an exit spins for as long as
+// its inputs say, so what comes after it is unbounded unless --loop-bound
+// caps its iterations. A delay's wait on its timer is no such loop: it
+// holds for the count the delay loaded.
+
+extern int report_wcet;      // --wcet
+extern int wcet_loop_bound;  // --loop-bound N; 0 leaves loops with an exit unbounded
+
+void print_wcet_analysis(CompactMicrocode* mc, FILE* output);
+
+#endif // WCET_H
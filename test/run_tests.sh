@@ -62,6 +62,29 @@ run_detailed_test() {
     echo
 }
 
+# Function to check the memory styles a --verilog module picks for a program
+run_mem_style_test() {
+    local test_name="$1"
+    local test_file="$2"
+    local expected_style="$3"
+
+    echo -n "Testing $test_name... "
+    TESTS_RUN=$((TESTS_RUN + 1))
+
+    local template="${test_file%.c}_template.v"
+    rm -f "$template"
+    ../bin/c_parser "$test_file" --verilog > /dev/null 2>&1
+    local matches
+    matches=$(grep -c "_MEM_STYLE(\"$expected_style\")" "$template" 2>/dev/null)
+    if [ "$matches" = "3" ]; then
+        echo -e "${GREEN}PASS${NC}"
+        TESTS_PASSED=$((TESTS_PASSED + 1))
+    else
+        echo -e "${RED}FAIL${NC} (expected MC, VR and SW memories to be \"$expected_style\")"
+        TESTS_FAILED=$((TESTS_FAILED + 1))
+    fi
+}
+
 # Change to test directory
 cd "$(dirname "$0")"
 
@@ -97,6 +120,12 @@ run_test "All loops" "test_all_loops.c" "pass"
 # Test for switch with varnum
 run_test "Switch with varnum" "test_switch_varnum.c" "pass"
 
+# Test for a switch inside an interrupt handler
+run_test "Switch in interrupt handler" "test_isr_switch.c" "pass"
+
+# Test that a small program's memories all default to LUT RAM
+run_mem_style_test "Memory styles for a small program" "test_hardware_local.c" "distributed"
+
 echo
 echo "=== Test Summary ==="
 echo "Tests run: $TESTS_RUN"
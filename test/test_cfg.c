@@ -35,7 +35,7 @@ void test_simple_function() {
     lexer_destroy(lexer);
     
     // Parse the code
-    Parser* parser = parser_create(tokens, token_count);
+    Parser* parser = parser_create(code, tokens, token_count);
     Node* ast = parse(parser);
     
     if (!ast) {
@@ -102,7 +102,7 @@ void test_if_statement() {
     lexer_destroy(lexer);
     
     // Parse the code
-    Parser* parser = parser_create(tokens, token_count);
+    Parser* parser = parser_create(code, tokens, token_count);
     Node* ast = parse(parser);
     
     if (!ast) {
@@ -167,7 +167,7 @@ void test_while_loop() {
     lexer_destroy(lexer);
     
     // Parse the code
-    Parser* parser = parser_create(tokens, token_count);
+    Parser* parser = parser_create(code, tokens, token_count);
     Node* ast = parse(parser);
     
     if (!ast) {
@@ -230,7 +230,7 @@ void test_for_loop() {
     lexer_destroy(lexer);
     
     // Parse the code
-    Parser* parser = parser_create(tokens, token_count);
+    Parser* parser = parser_create(code, tokens, token_count);
     Node* ast = parse(parser);
     
     if (!ast) {
@@ -303,7 +303,7 @@ void test_arrays_and_booleans() {
     lexer_destroy(lexer);
     
     // Parse the code
-    Parser* parser = parser_create(tokens, token_count);
+    Parser* parser = parser_create(code, tokens, token_count);
     Node* ast = parse(parser);
     
     if (!ast) {
@@ -0,0 +1,25 @@
+// A switch inside an interrupt handler sizes the switch memory even though
+// main has none and nothing calls the handler
+bool LED0 = 0;
+bool LED1 = 0;
+int sel;
+
+void isr_tick() {
+    switch (sel) {
+        case 0:
+            LED0 = 1;
+            break;
+        case 5:
+            LED1 = 1;
+            break;
+        case 300:
+            LED0 = 0;
+            break;
+    }
+}
+
+int main() {
+    while (1) {
+    }
+    return 0;
+}